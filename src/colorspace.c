@@ -18,6 +18,7 @@
 #include <math.h>
 
 #include "common.h"
+#include "colorspace.h"
 
 bool pl_color_system_is_ycbcr_like(enum pl_color_system sys)
 {
@@ -359,6 +360,90 @@ void pl_color_space_infer(struct pl_color_space *space)
         space->sig_avg = sdr_avg / space->sig_scale;
 }
 
+void pl_color_map_infer(struct pl_color_space *src, struct pl_color_space *dst)
+{
+    // Default the source color space to reasonable values
+    pl_color_space_infer(src);
+
+    // To be as conservative as possible, color mapping is disabled by default
+    // except for special cases which are considered to be "sufficiently
+    // different" from the source space. For primaries, this means anything
+    // wide gamut; and for transfers, this means anything radically different
+    // from the typical SDR curves.
+    if (!dst->primaries) {
+        dst->primaries = src->primaries;
+        if (pl_color_primaries_is_wide_gamut(dst->primaries))
+            dst->primaries = PL_COLOR_PRIM_BT_709;
+    }
+
+    if (!dst->transfer) {
+        dst->transfer = src->transfer;
+        if (pl_color_transfer_is_hdr(dst->transfer) ||
+            dst->transfer == PL_COLOR_TRC_LINEAR)
+        {
+            dst->transfer = PL_COLOR_TRC_GAMMA22;
+        }
+    }
+
+    // Defaults the dest average based on the source average, unless the source
+    // is HDR and the destination is not
+    if (!dst->sig_avg) {
+        bool src_hdr = pl_color_space_is_hdr(*src);
+        bool dst_hdr = pl_color_space_is_hdr(*dst);
+        if (!(src_hdr && !dst_hdr))
+            dst->sig_avg = src->sig_avg;
+    }
+
+    // Infer the remaining fields after making the above choices
+    pl_color_space_infer(dst);
+}
+
+// CPU version of the per-channel tone mapping curves in `pl_shader_tone_map`,
+// with `x` and `peak` already scaled by the slope
+float pl_tone_map_curve(enum pl_tone_mapping_algorithm algo, float param,
+                        float x, float peak)
+{
+    switch (algo) {
+    case PL_TONE_MAPPING_CLIP:
+        return x * PL_DEF(param, 1.0);
+
+    case PL_TONE_MAPPING_MOBIUS: {
+        float j = PL_DEF(param, 0.3);
+        if (peak <= 1.0 + 1e-6 || x <= j)
+            return x;
+        float a = -j*j * (peak - 1.0) / (j*j - 2.0*j + peak);
+        float b = (j*j - 2.0*j*peak + peak) / PL_MAX(1e-6, peak - 1.0);
+        float scale = (b*b + 2.0*b*j + j*j) / (b-a);
+        return scale * (x + a) / (x + b);
+    }
+
+    case PL_TONE_MAPPING_REINHARD: {
+        float contrast = PL_DEF(param, 0.5),
+              offset = (1.0 - contrast) / contrast;
+        return x / (x + offset) * (peak + offset) / peak;
+    }
+
+    case PL_TONE_MAPPING_HABLE: {
+#define HABLE(x) (((x) * (0.15 * (x) + 0.05) + 0.004) / \
+                  ((x) * (0.15 * (x) + 0.50) + 0.06) - 0.02 / 0.30)
+        return HABLE(x) / HABLE(peak);
+#undef HABLE
+    }
+
+    case PL_TONE_MAPPING_GAMMA: {
+        const float cutoff = 0.05, gamma = 1.0 / PL_DEF(param, 1.8);
+        if (x > cutoff)
+            return powf(x / peak, gamma);
+        return powf(cutoff / peak, gamma) / cutoff * x;
+    }
+
+    case PL_TONE_MAPPING_LINEAR:
+        return x * PL_DEF(param, 1.0) / peak;
+
+    default: abort();
+    }
+}
+
 const struct pl_color_adjustment pl_color_adjustment_neutral = {
     .brightness = 0.0,
     .contrast   = 1.0,
@@ -809,6 +894,13 @@ static struct pl_matrix3x3 luma_coeffs(float lr, float lg, float lb)
     }};
 }
 
+// Inverted from the matrix in the spec
+const struct pl_matrix3x3 pl_bt2100_lms2rgb = {{
+    {  3.43661,  -2.50645,  0.0698454 },
+    { -0.79133,    1.9836,  -0.192271 },
+    { -0.0259499, -0.0989137, 1.12486 },
+}};
+
 struct pl_transform3x3 pl_color_repr_decode(struct pl_color_repr *repr,
                                     const struct pl_color_adjustment *params)
 {
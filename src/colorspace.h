@@ -0,0 +1,61 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+// Internal helpers shared between the color conversion shaders and their CPU
+// counterparts in utils/convert.c, which must produce the same results.
+
+// Common constants for SMPTE ST.2084 (PQ)
+static const float PQ_M1 = 2610./4096 * 1./4,
+                   PQ_M2 = 2523./4096 * 128,
+                   PQ_C1 = 3424./4096,
+                   PQ_C2 = 2413./4096 * 32,
+                   PQ_C3 = 2392./4096 * 32;
+
+// Common constants for ARIB STD-B67 (HLG)
+static const float HLG_A = 0.17883277,
+                   HLG_B = 0.28466892,
+                   HLG_C = 0.55991073;
+
+// Common constants for Panasonic V-Log
+static const float VLOG_B = 0.00873,
+                   VLOG_C = 0.241514,
+                   VLOG_D = 0.598206;
+
+// Common constants for Sony S-Log
+static const float SLOG_A = 0.432699,
+                   SLOG_B = 0.037584,
+                   SLOG_C = 0.616596 + 0.03,
+                   SLOG_P = 3.538813,
+                   SLOG_Q = 0.030001,
+                   SLOG_K2 = 155.0 / 219.0;
+
+// Inverse of the BT.2100 RGB->LMS matrix, used for decoding ICtCp
+extern const struct pl_matrix3x3 pl_bt2100_lms2rgb;
+
+// Fills in the missing fields of `src` and `dst` the way `pl_shader_color_map`
+// does, i.e. only picking a different target space if the source is wide
+// gamut / HDR.
+void pl_color_map_infer(struct pl_color_space *src, struct pl_color_space *dst);
+
+// CPU version of the per-channel tone mapping curves in `pl_shader_tone_map`,
+// with `x` and `peak` already scaled by the slope
+float pl_tone_map_curve(enum pl_tone_mapping_algorithm algo, float param,
+                        float x, float peak);
@@ -23,6 +23,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include "config.h"
 #include "config_internal.h"
@@ -49,6 +50,9 @@
 #include "include/libplacebo/shaders/colorspace.h"
 #include "include/libplacebo/shaders/sampling.h"
 #include "include/libplacebo/swapchain.h"
+#include "include/libplacebo/utils/convert.h"
+#include "include/libplacebo/utils/multi_gpu.h"
+#include "include/libplacebo/utils/render_queue.h"
 #include "include/libplacebo/utils/upload.h"
 
 #if PL_HAVE_VULKAN
@@ -67,6 +71,9 @@
 // Returns the log base 2 of an unsigned long long
 #define PL_LOG2(x) ((unsigned) (8*sizeof (unsigned long long) - __builtin_clzll((x)) - 1))
 
+// Right shift, rounding up (e.g. for subsampled plane sizes)
+#define PL_RSHIFT_UP(x, s) (((x) + (1 << (s)) - 1) >> (s))
+
 // Returns whether or not a number is a power of two (or zero)
 #define PL_ISPOT(x) (((x) & ((x) - 1)) == 0)
 
@@ -125,3 +132,11 @@ static inline size_t pl_lcm(size_t x, size_t y)
     assert(x && y);
     return x * (y / pl_gcd(x, y));
 }
+
+// Returns the current time of the monotonic clock, in nanoseconds
+static inline uint64_t pl_clock_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LLU + ts.tv_nsec;
+}
@@ -51,6 +51,91 @@ static void global_uninit(void)
 #endif
 }
 
+// Maximum number of messages queued up for the logging thread
+#define LOG_QUEUE_SIZE 256
+
+struct log_msg {
+    void (*log_cb)(void *log_priv, enum pl_log_level level, const char *msg);
+    void *log_priv;
+    enum pl_log_level lev;
+    struct bstr str; // not attached to the context, like `logbuffer`
+};
+
+static void *log_thread(void *arg)
+{
+    struct pl_context *ctx = arg;
+    struct bstr spare = {0};
+
+    pthread_mutex_lock(&ctx->lock);
+    for (;;) {
+        while (!ctx->log_count && !ctx->log_quit)
+            pthread_cond_wait(&ctx->log_wakeup, &ctx->lock);
+        if (!ctx->log_count)
+            break; // only quit once the queue has been drained
+
+        // Swap the message's buffer out of the queue, so the callback can
+        // run without holding the lock
+        struct log_msg *slot = &ctx->log_queue[ctx->log_head];
+        struct log_msg msg = *slot;
+        slot->str = spare;
+        ctx->log_head = (ctx->log_head + 1) % LOG_QUEUE_SIZE;
+        ctx->log_count--;
+
+        uint64_t dropped = ctx->log_dropped;
+        ctx->log_dropped = 0;
+        pthread_mutex_unlock(&ctx->lock);
+
+        const char *str = msg.str.len ? (char *) msg.str.start : "";
+        msg.log_cb(msg.log_priv, msg.lev, str);
+        if (dropped) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "Dropped %"PRIu64" log messages "
+                     "(queue full)", dropped);
+            msg.log_cb(msg.log_priv, PL_LOG_WARN, buf);
+        }
+
+        spare = msg.str;
+        pthread_mutex_lock(&ctx->lock);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    talloc_free(spare.start);
+    return NULL;
+}
+
+static void log_thread_start(struct pl_context *ctx)
+{
+    if (ctx->log_thread_running)
+        return;
+
+    if (!ctx->log_queue)
+        ctx->log_queue = talloc_zero_array(ctx, struct log_msg, LOG_QUEUE_SIZE);
+
+    ctx->log_quit = false;
+    if (pthread_create(&ctx->log_thread, NULL, log_thread, ctx) != 0) {
+        ctx->params.log_async = false;
+        pl_warn(ctx, "Failed creating logging thread, falling back to "
+                "synchronous logging");
+        return;
+    }
+
+    ctx->log_thread_running = true;
+}
+
+static void log_thread_stop(struct pl_context *ctx)
+{
+    if (!ctx->log_thread_running)
+        return;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->log_quit = true;
+    pthread_cond_signal(&ctx->log_wakeup);
+    pthread_mutex_unlock(&ctx->lock);
+
+    pthread_join(ctx->log_thread, NULL);
+    ctx->log_thread_running = false;
+}
+
 struct pl_context *pl_context_create(int api_ver,
                                      const struct pl_context_params *params)
 {
@@ -73,14 +158,36 @@ struct pl_context *pl_context_create(int api_ver,
 
     struct pl_context *ctx = talloc_zero(NULL, struct pl_context);
     ctx->params = *PL_DEF(params, &pl_context_default_params);
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_mutex_init(&ctx->filter_lock, NULL);
+    pthread_mutex_init(&ctx->trace_lock, NULL);
+    pthread_cond_init(&ctx->log_wakeup, NULL);
+    if (ctx->params.log_async)
+        log_thread_start(ctx);
     return ctx;
 }
 
 const struct pl_context_params pl_context_default_params = {0};
 
-void pl_context_destroy(struct pl_context **ctx)
+void pl_context_destroy(struct pl_context **pctx)
 {
-    TA_FREEP(ctx);
+    struct pl_context *ctx = *pctx;
+    if (ctx) {
+        log_thread_stop(ctx);
+        pthread_cond_destroy(&ctx->log_wakeup);
+        pthread_mutex_destroy(&ctx->lock);
+        pthread_mutex_destroy(&ctx->filter_lock);
+        pthread_mutex_destroy(&ctx->trace_lock);
+        talloc_free(ctx->logbuffer.start);
+        talloc_free(ctx->spans);
+        for (int i = 0; i < ctx->num_filters; i++)
+            talloc_free(ctx->filters[i]); // not attached to the context
+        talloc_free(ctx->filters);
+        for (int i = 0; ctx->log_queue && i < LOG_QUEUE_SIZE; i++)
+            talloc_free(ctx->log_queue[i].str.start);
+    }
+
+    TA_FREEP(pctx);
 
     // Do global uninitialization only when refcount reaches 0
     pthread_mutex_lock(&pl_ctx_mutex);
@@ -92,7 +199,191 @@ void pl_context_destroy(struct pl_context **ctx)
 void pl_context_update(struct pl_context *ctx,
                        const struct pl_context_params *params)
 {
-    ctx->params = *PL_DEF(params, &pl_context_default_params);
+    params = PL_DEF(params, &pl_context_default_params);
+
+    // Flush the queue before switching to synchronous logging, so messages
+    // can't be delivered out of order
+    if (!params->log_async)
+        log_thread_stop(ctx);
+
+    ctx->params = *params;
+    if (params->log_async)
+        log_thread_start(ctx);
+}
+
+// Maximum number of spans recorded per trace, to bound the memory usage if
+// tracing is left enabled for a long time
+#define TRACE_MAX_SPANS (1 << 20)
+
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static int trace_num_threads; // guarded by `pl_ctx_mutex`
+
+static void trace_key_init(void)
+{
+    pthread_key_create(&trace_key, NULL);
+}
+
+// Returns a small, nonzero integer identifying the calling thread. Unlike
+// the raw `pthread_t`, these are stable across all contexts and make for
+// readable thread IDs in the exported trace.
+static int trace_thread_id(void)
+{
+    pthread_once(&trace_key_once, trace_key_init);
+    intptr_t id = (intptr_t) pthread_getspecific(trace_key);
+    if (id)
+        return id;
+
+    pthread_mutex_lock(&pl_ctx_mutex);
+    id = ++trace_num_threads;
+    pthread_mutex_unlock(&pl_ctx_mutex);
+    pthread_setspecific(trace_key, (void *) id);
+    return id;
+}
+
+static void add_span(struct pl_context *ctx, struct pl_span span)
+{
+    pthread_mutex_lock(&ctx->trace_lock);
+    if (!ctx->tracing || span.end < ctx->trace_start) {
+        // Raced with the start or end of the trace, just drop it
+    } else if (ctx->num_spans >= TRACE_MAX_SPANS) {
+        ctx->spans_dropped++;
+    } else {
+        TARRAY_APPEND(NULL, ctx->spans, ctx->num_spans, span); // not attached to ctx
+    }
+    pthread_mutex_unlock(&ctx->trace_lock);
+}
+
+uint64_t pl_span_end(struct pl_context *ctx, const char *name, uint64_t start)
+{
+    if (!start)
+        return 0;
+
+    uint64_t end = pl_clock_ns();
+    add_span(ctx, (struct pl_span) {
+        .name = name,
+        .thread = trace_thread_id(),
+        .start = start,
+        .end = end,
+    });
+
+    return end;
+}
+
+void pl_span_add(struct pl_context *ctx, const char *track, const char *name,
+                 uint64_t start, uint64_t end)
+{
+    if (!ctx->tracing)
+        return;
+
+    add_span(ctx, (struct pl_span) {
+        .name = name,
+        .track = track,
+        .start = start,
+        .end = PL_MAX(start, end),
+    });
+}
+
+void pl_context_trace_start(struct pl_context *ctx)
+{
+    pthread_mutex_lock(&ctx->trace_lock);
+    ctx->num_spans = 0;
+    ctx->spans_dropped = 0;
+    ctx->trace_start = pl_clock_ns();
+    ctx->tracing = true;
+    pthread_mutex_unlock(&ctx->trace_lock);
+}
+
+// Returns the index of `track` in `tracks`, appending it if necessary
+static int find_track(void *tmp, const char ***tracks, int *num_tracks,
+                      const char *track)
+{
+    for (int i = 0; i < *num_tracks; i++) {
+        if (strcmp((*tracks)[i], track) == 0)
+            return i;
+    }
+
+    TARRAY_APPEND(tmp, *tracks, *num_tracks, track);
+    return *num_tracks - 1;
+}
+
+// Process IDs used for the two groups of tracks in the exported trace
+enum {
+    TRACE_PID_CPU = 1,
+    TRACE_PID_OTHER = 2,
+};
+
+bool pl_context_trace_stop(struct pl_context *ctx, void *stream)
+{
+    pthread_mutex_lock(&ctx->trace_lock);
+    ctx->tracing = false;
+    struct pl_span *spans = ctx->spans;
+    int num_spans = ctx->num_spans;
+    uint64_t dropped = ctx->spans_dropped;
+    uint64_t base = ctx->trace_start;
+    ctx->spans = NULL;
+    ctx->num_spans = 0;
+    pthread_mutex_unlock(&ctx->trace_lock);
+
+    if (dropped)
+        pl_warn(ctx, "Dropped %"PRIu64" spans (trace too long)", dropped);
+
+    bool ok = true;
+    FILE *f = stream;
+    if (!f)
+        goto done;
+
+    void *tmp = talloc_new(NULL);
+    const char **tracks = NULL;
+    int num_tracks = 0;
+    int *threads = NULL;
+    int num_threads = 0;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"args\":{\"name\":\"CPU\"}}", TRACE_PID_CPU);
+    fprintf(f, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"args\":{\"name\":\"GPU\"}}", TRACE_PID_OTHER);
+
+    for (int i = 0; i < num_spans; i++) {
+        const struct pl_span *span = &spans[i];
+        int pid = TRACE_PID_CPU, tid = span->thread;
+        if (span->track) {
+            pid = TRACE_PID_OTHER;
+            int num_old = num_tracks;
+            tid = find_track(tmp, &tracks, &num_tracks, span->track) + 1;
+            if (num_tracks > num_old) {
+                fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                        "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                        pid, tid, span->track);
+            }
+        } else {
+            bool found = false;
+            for (int n = 0; n < num_threads && !found; n++)
+                found = threads[n] == tid;
+            if (!found) {
+                TARRAY_APPEND(tmp, threads, num_threads, tid);
+                fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                        "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":"
+                        "\"Thread %d\"}}", pid, tid, tid);
+            }
+        }
+
+        // Spans on other tracks may start slightly before the trace did,
+        // due to clock calibration errors, so use signed offsets here
+        double ts = ((int64_t) (span->start - base)) / 1e3;
+        double dur = (span->end - span->start) / 1e3;
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f}", span->name, pid, tid, ts, dur);
+    }
+
+    fprintf(f, "\n]}\n");
+    ok = !ferror(f);
+    talloc_free(tmp);
+
+done:
+    talloc_free(spans);
+    return ok;
 }
 
 static FILE *default_stream(void *stream, enum pl_log_level level)
@@ -138,15 +429,65 @@ void pl_msg(struct pl_context *ctx, enum pl_log_level lev, const char *fmt, ...)
     va_end(va);
 }
 
+static void msg_async(struct pl_context *ctx, enum pl_log_level lev,
+                      const char *fmt, va_list va)
+{
+    // Format the message before taking the lock, so concurrent threads only
+    // contend over the (short) copy into the queue
+    char buf[256];
+    char *str = buf;
+    va_list copy;
+    va_copy(copy, va);
+    int len = vsnprintf(buf, sizeof(buf), fmt, copy);
+    va_end(copy);
+    if (len < 0)
+        return;
+
+    if (len >= sizeof(buf)) {
+        str = malloc(len + 1);
+        if (!str)
+            return;
+        vsnprintf(str, len + 1, fmt, va);
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->log_count == LOG_QUEUE_SIZE) {
+        ctx->log_dropped++;
+    } else {
+        int idx = (ctx->log_head + ctx->log_count++) % LOG_QUEUE_SIZE;
+        struct log_msg *msg = &ctx->log_queue[idx];
+        msg->log_cb = ctx->params.log_cb;
+        msg->log_priv = ctx->params.log_priv;
+        msg->lev = lev;
+        msg->str.len = 0;
+        bstr_xappend(NULL, &msg->str, (struct bstr) { str, len });
+        pthread_cond_signal(&ctx->log_wakeup);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (str != buf)
+        free(str);
+}
+
 void pl_msg_va(struct pl_context *ctx, enum pl_log_level lev, const char *fmt,
                va_list va)
 {
     if (!pl_msg_test(ctx, lev))
         return;
 
+    if (ctx->params.log_async) {
+        msg_async(ctx, lev, fmt, va);
+        return;
+    }
+
+    // The log buffer is deliberately allocated without a parent, since
+    // reallocating it could otherwise race against unrelated allocations
+    // on the context made by other threads
+    pthread_mutex_lock(&ctx->lock);
     ctx->logbuffer.len = 0;
-    bstr_xappend_vasprintf(ctx, &ctx->logbuffer, fmt, va);
+    bstr_xappend_vasprintf(NULL, &ctx->logbuffer, fmt, va);
     ctx->params.log_cb(ctx->params.log_priv, lev, ctx->logbuffer.start);
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 void pl_msg_source(struct pl_context *ctx, enum pl_log_level lev, const char *src)
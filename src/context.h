@@ -18,13 +18,40 @@
 #pragma once
 
 #include <stdarg.h>
+#include <pthread.h>
 #include "common.h"
 
 struct pl_context {
     struct pl_context_params params;
-    struct bstr logbuffer;
+    pthread_mutex_t lock; // guards `logbuffer`, so messages may come from any thread
+    struct bstr logbuffer; // not attached to the context (see pl_msg_va)
+
+    // Asynchronous logging (see `pl_context_params.log_async`), also
+    // guarded by `lock`
+    pthread_t log_thread;
+    pthread_cond_t log_wakeup;
+    bool log_thread_running;
+    bool log_quit;
+    struct log_msg *log_queue; // ring buffer of fixed size
+    int log_head;
+    int log_count;
+    uint64_t log_dropped;
+
     // Provide a place for implementations to track suppression of errors
     uint64_t suppress_errors_for_object;
+
+    // Recently generated filters, shared by all users (see filters.c)
+    pthread_mutex_t filter_lock;
+    struct cached_filter **filters; // least recently used first
+    int num_filters;
+
+    // Timeline of recorded spans (see `pl_context_trace_start`)
+    bool tracing; // read without holding `trace_lock`, see `pl_span_begin`
+    pthread_mutex_t trace_lock;
+    struct pl_span *spans;
+    int num_spans;
+    uint64_t spans_dropped;
+    uint64_t trace_start;
 };
 
 // Logging-related functions
@@ -38,15 +65,49 @@ void pl_msg(struct pl_context *ctx, enum pl_log_level lev, const char *fmt, ...)
 void pl_msg_va(struct pl_context *ctx, enum pl_log_level lev, const char *fmt,
                va_list va);
 
-// Convenience macros
-#define pl_fatal(log, ...)      pl_msg(ctx, PL_LOG_FATAL, __VA_ARGS__)
-#define pl_err(log, ...)        pl_msg(ctx, PL_LOG_ERR, __VA_ARGS__)
-#define pl_warn(log, ...)       pl_msg(ctx, PL_LOG_WARN, __VA_ARGS__)
-#define pl_info(log, ...)       pl_msg(ctx, PL_LOG_INFO, __VA_ARGS__)
-#define pl_debug(log, ...)      pl_msg(ctx, PL_LOG_DEBUG, __VA_ARGS__)
-#define pl_trace(log, ...)      pl_msg(ctx, PL_LOG_TRACE, __VA_ARGS__)
+// Tracing-related functions. A span is a named interval of time, either of
+// CPU work (attributed to the calling thread) or of work on some other
+// `track`, e.g. a GPU queue. `name` and `track` must be static strings.
+// Timestamps are in the time base of `pl_clock_ns`.
+struct pl_span {
+    const char *name;
+    const char *track; // or NULL for CPU spans
+    int thread;        // for CPU spans, a small integer identifying the thread
+    uint64_t start, end;
+};
+
+// Returns the start time for `pl_span_end`, or 0 if not currently tracing.
+// This is cheap enough to leave in hot paths unconditionally. (Reading
+// `ctx->tracing` without locking is fine, since a span that races with
+// `pl_context_trace_start` or `pl_context_trace_stop` may be dropped either way)
+static inline uint64_t pl_span_begin(struct pl_context *ctx)
+{
+    return ctx->tracing ? pl_clock_ns() : 0;
+}
+
+// Records a CPU span on the calling thread, from `start` until now. Does
+// nothing if `start` is 0. Returns the end time (or 0).
+uint64_t pl_span_end(struct pl_context *ctx, const char *name, uint64_t start);
+
+// Records a span with explicit timestamps on the given track. This is a
+// no-op while not tracing.
+void pl_span_add(struct pl_context *ctx, const char *track, const char *name,
+                 uint64_t start, uint64_t end);
+
+// Convenience macros. These test the log level before calling `pl_msg`, so
+// that the arguments of filtered messages are never even evaluated. (This
+// matters for e.g. debug messages involving expensive helper functions)
+#define pl_msg_lev(ctx, lev, ...) \
+    (pl_msg_test(ctx, lev) ? pl_msg(ctx, lev, __VA_ARGS__) : (void) 0)
+
+#define pl_fatal(log, ...)      pl_msg_lev(ctx, PL_LOG_FATAL, __VA_ARGS__)
+#define pl_err(log, ...)        pl_msg_lev(ctx, PL_LOG_ERR, __VA_ARGS__)
+#define pl_warn(log, ...)       pl_msg_lev(ctx, PL_LOG_WARN, __VA_ARGS__)
+#define pl_info(log, ...)       pl_msg_lev(ctx, PL_LOG_INFO, __VA_ARGS__)
+#define pl_debug(log, ...)      pl_msg_lev(ctx, PL_LOG_DEBUG, __VA_ARGS__)
+#define pl_trace(log, ...)      pl_msg_lev(ctx, PL_LOG_TRACE, __VA_ARGS__)
 
-#define PL_MSG(obj, lev, ...)   pl_msg((obj)->ctx, lev, __VA_ARGS__)
+#define PL_MSG(obj, lev, ...)   pl_msg_lev((obj)->ctx, lev, __VA_ARGS__)
 
 #define PL_FATAL(obj, ...)      PL_MSG(obj, PL_LOG_FATAL, __VA_ARGS__)
 #define PL_ERR(obj, ...)        PL_MSG(obj, PL_LOG_ERR, __VA_ARGS__)
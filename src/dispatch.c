@@ -15,6 +15,9 @@
  * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+#include <unistd.h>
+
 #include "common.h"
 #include "context.h"
 #include "shaders.h"
@@ -26,12 +29,15 @@ enum {
     TMP_MAIN,      // main GLSL shader body
     TMP_VERT_HEAD, // vertex shader inputs/outputs
     TMP_VERT_BODY, // vertex shader body
+    TMP_CONSTANTS, // values of all compile-time constants
     TMP_COUNT,
 };
 
 struct pl_dispatch {
     struct pl_context *ctx;
     const struct pl_gpu *gpu;
+    struct pl_dispatch_params params;
+    struct program_cache *programs; // shared with other dispatch objects
     uint8_t current_ident;
     uint8_t current_index;
 
@@ -42,21 +48,65 @@ struct pl_dispatch {
     // cache of compiled passes
     struct pass **passes;
     int num_passes;
+    size_t pass_memory; // sum of pass->memory
+    uint64_t use_count; // incremented on every pass lookup
+
+    // clip rect for all passes rendering to `clip_tex` (`pl_dispatch_set_clip`)
+    const struct pl_tex *clip_tex;
+    struct pl_rect2d clip;
+
+    // hash table over `passes`, indexed by `pass->key`. The number of buckets
+    // is always a power of two, and each bucket is a singly linked list
+    struct pass **buckets;
+    int num_buckets;
+
+    // programs loaded by `pl_dispatch_load`, for passes not created yet
+    struct cached_pass *cached_passes;
+    int num_cached_passes;
+
+    // background compilation of passes (`async_compile`)
+    bool async;       // whether new passes are currently compiled async
+    bool pending;     // whether the last dispatch was skipped due to this
+    pthread_t *threads;     // pool of compile threads, grown on demand
+    int num_threads;
+    int max_threads;
+    pthread_mutex_t lock;   // protects everything below, and `pass->async_*`
+    pthread_cond_t wakeup;  // signalled when a pass is added to the queue
+    pthread_cond_t done;    // signalled when a pass finished compiling
+    struct pass **queue;    // passes waiting to be compiled (FIFO)
+    int num_queue;
+    int idle_threads;       // threads currently waiting for work
+    bool exit_thread;
+
+    // ring of host-mapped UBOs, which all passes sub-allocate their uniform
+    // buffer contents from on every run
+    struct pl_buf_pool ubo_ring;
+    const struct pl_buf *ubo_buf; // current buffer from `ubo_ring`
+    size_t ubo_offset;            // first free byte in `ubo_buf`
+    bool disable_ubo_ring;
 
     // temporary buffers to help avoid re_allocations during pass creation
     struct bstr tmp[TMP_COUNT];
+    void *arena; // for the other temporary allocations of `find_pass`
+};
+
+struct cached_pass {
+    uint64_t signature;
+    const uint8_t *cached_program;
+    size_t cached_program_len;
 };
 
 enum pass_var_type {
     PASS_VAR_NONE = 0,
     PASS_VAR_GLOBAL, // regular/global uniforms (PL_GPU_CAP_INPUT_VARIABLES)
     PASS_VAR_UBO,    // uniform buffers
-    PASS_VAR_PUSHC   // push constants
+    PASS_VAR_PUSHC,  // push constants
+    PASS_VAR_CONST,  // compile-time constants (specialization constants)
 };
 
 // Cached metadata about a variable's effective placement / update method
 struct pass_var {
-    int index; // for pl_var_update
+    int index; // for pl_var_update, or the first constant ID for PASS_VAR_CONST
     enum pass_var_type type;
     struct pl_var_layout layout;
     void *cached_data;
@@ -64,14 +114,44 @@ struct pass_var {
 
 struct pass {
     uint64_t signature; // as returned by pl_shader_signature
+    uint64_t key; // signature combined with the target format / blend state
     const struct pl_pass *pass;
     bool failed;
 
+    struct pass *hash_next; // next pass in the same hash bucket
+    uint64_t last_use; // value of `dp->use_count` when this was last used
+    size_t memory; // estimated memory footprint, for `max_pass_memory`
+
+    // If this is set, the pass is being compiled in the background, and
+    // `pass` is not valid yet. `async_params` is owned by the pass, while
+    // `async_result` and `async_done` are set by the compile thread.
+    bool pending;
+    struct pl_pass_params async_params;
+    const struct pl_pass *async_result;
+    bool async_done;
+
+    // for `pl_dispatch_timings`. `samples` is a ring buffer indexed by
+    // `num_samples`, which counts the total number of measurements
+    char *label;
+    struct pl_timer *timer;
+    uint64_t samples[PL_DISPATCH_TIMING_SAMPLES];
+    int num_samples;
+
     // contains cached data and update metadata, same order as pl_shader
     struct pass_var *vars;
 
-    // for uniform buffer updates
+    // values of all compile-time constants baked into this pass
+    struct bstr constants;
+    int num_constants; // number of components placed so far
+
+    // for uniform buffer updates. The contents are staged in `ubo_data` and
+    // uploaded once per run, preferably into `dp->ubo_ring`. `ubo` is only
+    // used as a fallback if the ring buffer is unavailable.
+    uint8_t *ubo_data;
+    size_t ubo_size;
+    int ubo_index; // index of the UBO in `run_params.desc_bindings`
     const struct pl_buf *ubo;
+    bool ubo_dirty; // whether `ubo` needs to be updated from `ubo_data`
     struct pl_shader_desc ubo_desc; // temporary
 
     // Cached pl_pass_run_params. This will also contain mutable allocations
@@ -85,32 +165,210 @@ static void pass_destroy(struct pl_dispatch *dp, struct pass *pass)
     if (!pass)
         return;
 
+    // Pending passes are never evicted, so this can only happen on
+    // `pl_dispatch_destroy`, after the compile thread has been stopped
+    if (pass->pending)
+        pl_pass_destroy(dp->gpu, &pass->async_result);
+
     pl_buf_destroy(dp->gpu, &pass->ubo);
     pl_pass_destroy(dp->gpu, &pass->pass);
+    pl_timer_destroy(dp->gpu, &pass->timer);
     talloc_free(pass);
 }
 
-struct pl_dispatch *pl_dispatch_create(struct pl_context *ctx,
-                                       const struct pl_gpu *gpu)
+// Compiled programs are shared between all dispatch objects on the same GPU,
+// keyed by the shader signature. This lets e.g. renderers running on other
+// threads re-use each other's compiled shaders, without having to go through
+// `pl_dispatch_save` and `pl_dispatch_load`. The cache for each GPU lives as
+// long as any dispatch object using it.
+#define PROGRAM_CACHE_SIZE 256
+
+struct shared_program {
+    uint64_t signature;
+    uint8_t *program;
+    size_t program_len;
+};
+
+struct program_cache {
+    const struct pl_gpu *gpu;
+    int refcount;
+    struct shared_program *programs; // least recently used first
+    int num_programs;
+};
+
+static pthread_mutex_t program_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct program_cache **program_caches;
+static int num_program_caches;
+
+static struct program_cache *program_cache_acquire(const struct pl_gpu *gpu)
+{
+    struct program_cache *pc = NULL;
+
+    pthread_mutex_lock(&program_cache_lock);
+    for (int i = 0; i < num_program_caches; i++) {
+        if (program_caches[i]->gpu == gpu) {
+            pc = program_caches[i];
+            pc->refcount++;
+            goto done;
+        }
+    }
+
+    pc = talloc_ptrtype(NULL, pc);
+    *pc = (struct program_cache) {
+        .gpu = gpu,
+        .refcount = 1,
+    };
+
+    TARRAY_APPEND(NULL, program_caches, num_program_caches, pc);
+
+done:
+    pthread_mutex_unlock(&program_cache_lock);
+    return pc;
+}
+
+static void program_cache_release(struct program_cache **cache)
+{
+    struct program_cache *pc = *cache;
+    if (!pc)
+        return;
+
+    pthread_mutex_lock(&program_cache_lock);
+    if (--pc->refcount == 0) {
+        for (int i = 0; i < num_program_caches; i++) {
+            if (program_caches[i] == pc) {
+                TARRAY_REMOVE_AT(program_caches, num_program_caches, i);
+                break;
+            }
+        }
+
+        if (!num_program_caches)
+            TA_FREEP(&program_caches);
+
+        talloc_free(pc);
+    }
+    pthread_mutex_unlock(&program_cache_lock);
+    *cache = NULL;
+}
+
+// Looks up a program in the shared cache. Since the entry may be evicted by
+// another thread at any time, the result is copied into `tmp`
+static bool program_cache_get(struct program_cache *pc, void *tmp, uint64_t sig,
+                              struct pl_pass_params *params)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&program_cache_lock);
+    for (int i = pc->num_programs - 1; i >= 0; i--) {
+        struct shared_program prog = pc->programs[i];
+        if (prog.signature != sig)
+            continue;
+
+        // Move to the end of the list, to mark it as recently used
+        TARRAY_REMOVE_AT(pc->programs, pc->num_programs, i);
+        TARRAY_APPEND(pc, pc->programs, pc->num_programs, prog);
+        params->cached_program = talloc_memdup(tmp, prog.program, prog.program_len);
+        params->cached_program_len = prog.program_len;
+        found = true;
+        break;
+    }
+    pthread_mutex_unlock(&program_cache_lock);
+    return found;
+}
+
+static void program_cache_add(struct program_cache *pc, uint64_t sig,
+                              const uint8_t *program, size_t program_len)
+{
+    pthread_mutex_lock(&program_cache_lock);
+    for (int i = 0; i < pc->num_programs; i++) {
+        if (pc->programs[i].signature == sig)
+            goto done; // already added by another dispatch object
+    }
+
+    if (pc->num_programs == PROGRAM_CACHE_SIZE) {
+        talloc_free(pc->programs[0].program);
+        TARRAY_REMOVE_AT(pc->programs, pc->num_programs, 0);
+    }
+
+    struct shared_program prog = {
+        .signature = sig,
+        .program = talloc_memdup(pc, program, program_len),
+        .program_len = program_len,
+    };
+
+    TARRAY_APPEND(pc, pc->programs, pc->num_programs, prog);
+
+done:
+    pthread_mutex_unlock(&program_cache_lock);
+}
+
+const struct pl_dispatch_params pl_dispatch_default_params = {
+    .max_passes = 256,
+};
+
+struct pl_dispatch *pl_dispatch_create_ex(struct pl_context *ctx,
+                                          const struct pl_gpu *gpu,
+                                          const struct pl_dispatch_params *params)
 {
     pl_assert(ctx);
-    struct pl_dispatch *dp = talloc_zero(ctx, struct pl_dispatch);
+    // Like all objects derived from the context, this is deliberately
+    // allocated without a parent, so that dispatch objects can be created
+    // and destroyed from different threads
+    struct pl_dispatch *dp = talloc_zero(NULL, struct pl_dispatch);
     dp->ctx = ctx;
     dp->gpu = gpu;
+    dp->arena = talloc_new_arena(dp);
+    dp->programs = program_cache_acquire(gpu);
+    dp->params = *PL_DEF(params, &pl_dispatch_default_params);
+    dp->async = dp->params.async_compile;
+    dp->max_threads = dp->params.compile_threads;
+    if (!dp->max_threads) {
+#ifdef _SC_NPROCESSORS_ONLN
+        dp->max_threads = PL_MIN(sysconf(_SC_NPROCESSORS_ONLN), 16);
+#endif
+        dp->max_threads = PL_MAX(dp->max_threads, 1);
+    }
+    dp->disable_ubo_ring = !gpu->limits.align_ubo_offset ||
+                           !(gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS);
+    pthread_mutex_init(&dp->lock, NULL);
+    pthread_cond_init(&dp->wakeup, NULL);
+    pthread_cond_init(&dp->done, NULL);
 
     return dp;
 }
 
+struct pl_dispatch *pl_dispatch_create(struct pl_context *ctx,
+                                       const struct pl_gpu *gpu)
+{
+    return pl_dispatch_create_ex(ctx, gpu, NULL);
+}
+
 void pl_dispatch_destroy(struct pl_dispatch **ptr)
 {
     struct pl_dispatch *dp = *ptr;
     if (!dp)
         return;
 
+    if (dp->num_threads) {
+        // Drop all queued passes, and wait for the current ones to finish
+        pthread_mutex_lock(&dp->lock);
+        dp->num_queue = 0;
+        dp->exit_thread = true;
+        pthread_cond_broadcast(&dp->wakeup);
+        pthread_mutex_unlock(&dp->lock);
+        for (int i = 0; i < dp->num_threads; i++)
+            pthread_join(dp->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&dp->lock);
+    pthread_cond_destroy(&dp->wakeup);
+    pthread_cond_destroy(&dp->done);
+
     for (int i = 0; i < dp->num_passes; i++)
         pass_destroy(dp, dp->passes[i]);
     for (int i = 0; i < dp->num_shaders; i++)
         pl_shader_free(&dp->shaders[i]);
+    pl_buf_pool_uninit(dp->gpu, &dp->ubo_ring);
+    program_cache_release(&dp->programs);
 
     talloc_free(dp);
     *ptr = NULL;
@@ -122,6 +380,7 @@ struct pl_shader *pl_dispatch_begin_ex(struct pl_dispatch *dp, bool unique)
         .id = unique ? dp->current_ident++ : 0,
         .gpu = dp->gpu,
         .index = dp->current_index,
+        .float16 = dp->params.float16,
     };
 
     struct pl_shader *sh;
@@ -144,6 +403,61 @@ struct pl_shader *pl_dispatch_begin(struct pl_dispatch *dp)
     return pl_dispatch_begin_ex(dp, false);
 }
 
+void pl_dispatch_set_async(struct pl_dispatch *dp, bool async)
+{
+    dp->async = async;
+}
+
+bool pl_dispatch_pending(const struct pl_dispatch *dp)
+{
+    return dp->pending;
+}
+
+void pl_dispatch_set_clip(struct pl_dispatch *dp, const struct pl_tex *target,
+                          const struct pl_rect2d *rc)
+{
+    dp->clip_tex = rc ? target : NULL;
+    if (rc) {
+        dp->clip = *rc;
+        pl_rect2d_normalize(&dp->clip);
+    }
+}
+
+static void *compile_thread(void *arg)
+{
+    struct pl_dispatch *dp = arg;
+
+    pthread_mutex_lock(&dp->lock);
+    while (!dp->exit_thread) {
+        if (!dp->num_queue) {
+            dp->idle_threads++;
+            pthread_cond_wait(&dp->wakeup, &dp->lock);
+            dp->idle_threads--;
+            continue;
+        }
+
+        struct pass *pass = dp->queue[0];
+        TARRAY_REMOVE_AT(dp->queue, dp->num_queue, 0);
+        pthread_mutex_unlock(&dp->lock);
+
+        const struct pl_pass *result = pl_pass_create(dp->gpu, &pass->async_params);
+
+        pthread_mutex_lock(&dp->lock);
+        pass->async_result = result;
+        pass->async_done = true;
+        pthread_cond_broadcast(&dp->done);
+    }
+    pthread_mutex_unlock(&dp->lock);
+
+    return NULL;
+}
+
+// Whether a variable gets baked into the pass as a compile-time constant
+static bool is_constant(const struct pl_shader_var *sv)
+{
+    return sv->compile_time && sv->var.dim_m == 1 && sv->var.dim_a == 1;
+}
+
 static bool add_pass_var(struct pl_dispatch *dp, void *tmp, struct pass *pass,
                          struct pl_pass_params *params,
                          const struct pl_shader_var *sv, struct pass_var *pv,
@@ -153,6 +467,30 @@ static bool add_pass_var(struct pl_dispatch *dp, void *tmp, struct pass *pass,
     if (pv->type)
         return true;
 
+    // Constants are laid out exactly as in `pass->constants`, one 4-byte
+    // specialization constant per vector component
+    if (is_constant(sv)) {
+        pv->type = PASS_VAR_CONST;
+        pv->index = pass->num_constants;
+        pv->layout = pl_var_host_layout(4 * pass->num_constants, &sv->var);
+        pass->num_constants += sv->var.dim_v;
+
+        // Without specialization constants, the values are hard-coded into
+        // the shader as literals instead (see `add_constant`)
+        if (!(gpu->caps & PL_GPU_CAP_SPEC_CONSTANTS))
+            return true;
+
+        for (int c = 0; c < sv->var.dim_v; c++) {
+            struct pl_constant cons = {
+                .type   = sv->var.type,
+                .offset = pv->layout.offset + 4 * c,
+                .id     = pv->index + c,
+            };
+            TARRAY_APPEND(tmp, params->constants, params->num_constants, cons);
+        }
+        return true;
+    }
+
     // Try not to use push constants for "large" values like matrices in the
     // first pass, since this is likely to exceed the VGPR/pushc size budgets
     bool try_pushc = greedy || (sv->var.dim_m == 1 && sv->var.dim_a == 1) || sv->dynamic;
@@ -228,6 +566,56 @@ static void add_buffer_vars(struct pl_dispatch *dp, struct bstr *body,
     ADD(body, "};\n");
 }
 
+static void add_constant(struct pl_dispatch *dp, struct bstr *body,
+                         const struct pass *pass, const struct pl_var *var,
+                         const struct pass_var *pv)
+{
+    bool spec = dp->gpu->caps & PL_GPU_CAP_SPEC_CONSTANTS;
+    const char *type = pl_var_glsl_type_name(*var);
+
+    // Declare one specialization constant per component. The default values
+    // are deliberately left at zero, so that the resulting GLSL (and SPIR-V)
+    // does not depend on the actual values and can be shared between passes
+    if (spec) {
+        static const char *types[PL_VAR_TYPE_COUNT] = {
+            [PL_VAR_SINT]  = "int",
+            [PL_VAR_UINT]  = "uint",
+            [PL_VAR_FLOAT] = "float",
+        };
+
+        static const char *zero[PL_VAR_TYPE_COUNT] = {
+            [PL_VAR_SINT]  = "0",
+            [PL_VAR_UINT]  = "0u",
+            [PL_VAR_FLOAT] = "0.0",
+        };
+
+        for (int c = 0; c < var->dim_v; c++) {
+            ADD(body, "layout(constant_id=%d) const %s %s_c%d = %s;\n",
+                pv->index + c, types[var->type], var->name, c, zero[var->type]);
+        }
+    }
+
+    // Otherwise, fall back to hard-coding the values as literals
+    ADD(body, "const %s %s = %s(", type, var->name, type);
+    const uint8_t *data = pass->constants.start + pv->layout.offset;
+    for (int c = 0; c < var->dim_v; c++) {
+        const char *sep = c > 0 ? ", " : "";
+        if (spec) {
+            ADD(body, "%s%s_c%d", sep, var->name, c);
+            continue;
+        }
+
+        // Only conversions supported by `bstr_xappend_asprintf_c` here
+        switch (var->type) {
+        case PL_VAR_SINT:  ADD(body, "%s%d", sep, ((const int *) data)[c]); break;
+        case PL_VAR_UINT:  ADD(body, "%s%zuu", sep, (size_t) ((const unsigned *) data)[c]); break;
+        case PL_VAR_FLOAT: ADD(body, "%s%f", sep, ((const float *) data)[c]); break;
+        default: abort();
+        }
+    }
+    ADD(body, ");\n");
+}
+
 static ident_t sh_var_from_va(struct pl_shader *sh, const char *name,
                               const struct pl_vertex_attrib *va,
                               const void *data)
@@ -249,6 +637,12 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
     ADD(pre, "#version %d%s\n", gpu->glsl.version, gpu->glsl.gles ? " es" : "");
     if (params->type == PL_PASS_COMPUTE)
         ADD(pre, "#extension GL_ARB_compute_shader : enable\n");
+    if (sh->float16)
+        ADD(pre, "#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require\n");
+    if (sh->subgroups) {
+        ADD(pre, "#extension GL_KHR_shader_subgroup_basic : require\n"
+                 "#extension GL_KHR_shader_subgroup_arithmetic : require\n");
+    }
 
     if (gpu->glsl.gles) {
         ADD(pre, "precision mediump float;\n");
@@ -269,13 +663,23 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
     const char *out_color = "gl_FragColor";
     switch(params->type) {
     case PL_PASS_RASTER: {
-        pl_assert(vert_pos);
         struct bstr *vert_head = &dp->tmp[TMP_VERT_HEAD];
         struct bstr *vert_body = &dp->tmp[TMP_VERT_BODY];
 
         // Set up a trivial vertex shader
         ADD_BSTR(vert_head, *pre);
         ADD(vert_body, "void main() {\n");
+        if (!vert_pos) {
+            // Generate a single triangle covering the entire viewport from
+            // the vertex index alone, see `translate_fullscreen_shader`
+            ADD(vert_head, "layout(location=0) %s vec2 frag_ndc;\n", vert_out);
+            ADD(vert_body, "int id = %s;\n"
+                           "frag_ndc = vec2((id & 1) << 2, (id & 2) << 1) - vec2(1.0);\n"
+                           "gl_Position = vec4(frag_ndc, 0.0, 1.0);\n",
+                gpu->glsl.vulkan ? "gl_VertexIndex" : "gl_VertexID");
+            ADD(glsl, "layout(location=0) %s vec2 frag_ndc;\n", frag_in);
+        }
+
         for (int i = 0; i < res->num_vertex_attribs; i++) {
             const struct pl_vertex_attrib *va = &params->vertex_attribs[i];
             const struct pl_shader_va *sva = &res->vertex_attribs[i];
@@ -334,6 +738,22 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
         ADD(glsl, "};\n");
     }
 
+    static const char *sampler_types[] = {
+        [1] = "sampler1D",
+        [2] = "sampler2D",
+        [3] = "sampler3D",
+    };
+
+    // Sampled textures are all accessed via the global texture heap, see
+    // `translate_bindless`
+    if (params->bindless) {
+        for (int dims = 1; dims <= 3; dims++) {
+            ADD(glsl, "layout(set=1, binding=%d) uniform %s pl_bindless_%dd[%d];\n",
+                dims - 1, sampler_types[dims], dims,
+                (int) gpu->limits.max_bindless_tex);
+        }
+    }
+
     // Add all of the required descriptors
     for (int i = 0; i < res->num_descriptors; i++) {
         const struct pl_shader_desc *sd = &res->descriptors[i];
@@ -341,11 +761,8 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
 
         switch (desc->type) {
         case PL_DESC_SAMPLED_TEX: {
-            static const char *types[] = {
-                [1] = "sampler1D",
-                [2] = "sampler2D",
-                [3] = "sampler3D",
-            };
+            if (params->bindless)
+                break;
 
             // Vulkan requires explicit bindings; GL always sets the
             // bindings manually to avoid relying on the user doing so
@@ -354,7 +771,7 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
 
             const struct pl_tex *tex = sd->object;
             int dims = pl_tex_params_dimension(tex->params);
-            ADD(glsl, "uniform %s %s;\n", types[dims], desc->name);
+            ADD(glsl, "uniform %s %s;\n", sampler_types[dims], desc->name);
             break;
         }
 
@@ -416,6 +833,13 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
         }
     }
 
+    // Add all of the compile-time constants
+    for (int i = 0; i < res->num_variables; i++) {
+        const struct pass_var *pv = &pass->vars[i];
+        if (pv->type == PASS_VAR_CONST)
+            add_constant(dp, glsl, pass, &res->variables[i].var, pv);
+    }
+
     // Add all of the remaining variables
     for (int i = 0; i < res->num_variables; i++) {
         const struct pl_var *var = &res->variables[i].var;
@@ -462,166 +886,591 @@ static bool blend_equal(const struct pl_blend_params *a,
            a->src_alpha == b->src_alpha && a->dst_alpha == b->dst_alpha;
 }
 
-static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
-                              const struct pl_tex *target, ident_t vert_pos,
-                              const struct pl_blend_params *blend)
+// Combines the shader signature with the state that the pass depends on, so
+// that passes differing only in their constants, target format or blend mode
+// end up in (most likely) different hash buckets
+static uint64_t pass_key(uint64_t sig, struct bstr constants,
+                         const struct pl_tex *target,
+                         const struct pl_blend_params *blend)
 {
-    uint64_t sig = pl_shader_signature(sh);
+    uint64_t key = sig;
+    if (constants.len)
+        key ^= siphash64(constants.start, constants.len);
 
-    for (int i = 0; i < dp->num_passes; i++) {
-        const struct pass *p = dp->passes[i];
-        if (p->signature != sig)
-            continue;
+    if (!target)
+        return key; // no special requirements besides the signature
 
-        if (pl_shader_is_compute(sh)) {
-            // no special requirements besides the signature
-            return dp->passes[i];
-        } else {
-            pl_assert(target);
-            const struct pl_fmt *tfmt;
-            tfmt = p->pass->params.target_dummy.params.format;
-            bool raster_ok = target->params.format == tfmt;
-            raster_ok &= blend_equal(p->pass->params.blend_params, blend);
-            if (raster_ok)
-                return dp->passes[i];
-        }
+    key ^= (uintptr_t) target->params.format * 0x9E3779B97F4A7C15LLU;
+    if (blend) {
+        uint64_t mode = blend->src_rgb | blend->dst_rgb << 8 |
+                        blend->src_alpha << 16 | blend->dst_alpha << 24;
+        key ^= (mode + 1) * 0xBF58476D1CE4E5B9LLU;
     }
 
-    void *tmp = talloc_new(NULL); // for resources attached to `params`
+    return key;
+}
 
-    struct pass *pass = talloc_zero(dp, struct pass);
-    pass->signature = sig;
-    pass->failed = true; // will be set to false on success
-    pass->ubo_desc = (struct pl_shader_desc) {
-        .desc = {
-            .name = "UBO",
-            .type = PL_DESC_BUF_UNIFORM,
-        },
-    };
+static bool pass_matches(const struct pass *p, uint64_t sig,
+                         struct bstr constants, bool compute,
+                         const struct pl_tex *target,
+                         const struct pl_blend_params *blend)
+{
+    if (p->signature != sig)
+        return false;
+    if (!bstr_equals(p->constants, constants))
+        return false;
 
-    struct pl_shader_res *res = &sh->res;
+    if (compute)
+        return true;
 
-    struct pl_pass_run_params *rparams = &pass->run_params;
-    struct pl_pass_params params = {
-        .type = pl_shader_is_compute(sh) ? PL_PASS_COMPUTE : PL_PASS_RASTER,
-        .num_descriptors = res->num_descriptors,
-        .blend_params = blend, // set this for all pass types (for caching)
-    };
+    // Failed passes have no pl_pass to compare against, so we only keep them
+    // around for the exact same key (to avoid retrying them every frame)
+    if (!p->pass)
+        return p->key == pass_key(sig, constants, target, blend);
 
-    if (params.type == PL_PASS_RASTER) {
-        assert(target);
-        params.target_dummy = *target;
+    pl_assert(target);
+    const struct pl_fmt *tfmt = p->pass->params.target_dummy.params.format;
+    return target->params.format == tfmt &&
+           blend_equal(p->pass->params.blend_params, blend);
+}
 
-        // Fill in the vertex attributes array
-        params.num_vertex_attribs = res->num_vertex_attribs;
-        params.vertex_attribs = talloc_zero_array(tmp, struct pl_vertex_attrib,
-                                                  res->num_vertex_attribs);
+static void hash_insert(struct pl_dispatch *dp, struct pass *pass)
+{
+    int idx = pass->key & (dp->num_buckets - 1);
+    pass->hash_next = dp->buckets[idx];
+    dp->buckets[idx] = pass;
+}
 
-        int va_loc = 0;
-        for (int i = 0; i < res->num_vertex_attribs; i++) {
-            struct pl_vertex_attrib *va = &params.vertex_attribs[i];
-            *va = res->vertex_attribs[i].attr;
+static void hash_remove(struct pl_dispatch *dp, struct pass *pass)
+{
+    struct pass **link = &dp->buckets[pass->key & (dp->num_buckets - 1)];
+    while (*link != pass) {
+        pl_assert(*link);
+        link = &(*link)->hash_next;
+    }
 
-            // Mangle the name to make sure it doesn't conflict with the
-            // fragment shader input
-            va->name = talloc_asprintf(tmp, "vert%s", va->name);
+    *link = pass->hash_next;
+    pass->hash_next = NULL;
+}
 
-            // Place the vertex attribute
-            va->offset = params.vertex_stride;
-            va->location = va_loc;
-            params.vertex_stride += va->fmt->texel_size;
+// Must be called after appending `pass` to `dp->passes`
+static void hash_add(struct pl_dispatch *dp, struct pass *pass)
+{
+    if (dp->num_passes <= dp->num_buckets) {
+        hash_insert(dp, pass);
+        return;
+    }
 
-            // The number of vertex attribute locations consumed by a vertex
-            // attribute is the number of vec4s it consumes, rounded up
-            const size_t va_loc_size = sizeof(float[4]);
-            va_loc += (va->fmt->texel_size + va_loc_size - 1) / va_loc_size;
-        }
+    // Keep the load factor below 1 by doubling the number of buckets
+    dp->num_buckets = PL_MAX(dp->num_buckets * 2, 16);
+    talloc_free(dp->buckets);
+    dp->buckets = talloc_zero_array(dp, struct pass *, dp->num_buckets);
+    for (int i = 0; i < dp->num_passes; i++)
+        hash_insert(dp, dp->passes[i]);
+}
 
-        // Generate the vertex array placeholder
-        params.vertex_type = PL_PRIM_TRIANGLE_STRIP;
-        rparams->vertex_count = 4; // single quad
-        size_t vert_size = rparams->vertex_count * params.vertex_stride;
-        rparams->vertex_data = talloc_zero_size(pass, vert_size);
-    }
+static size_t pass_memory(const struct pass *pass)
+{
+    const struct pl_pass_params *params = &pass->pass->params;
+    size_t size = params->cached_program_len + params->push_constants_size;
+    size += pass->ubo_size;
+    if (pass->run_params.vertex_data)
+        size += pass->run_params.vertex_count * params->vertex_stride;
+    return size;
+}
 
-    // Place all the variables; these will dynamically end up in different
-    // locations based on what the underlying GPU supports (UBOs, pushc, etc.)
-    //
-    // We go through the list twice, once to place stuff that we definitely
-    // want inside PCs, and then a second time to opportunistically place the rest.
-    pass->vars = talloc_zero_array(pass, struct pass_var, res->num_variables);
-    for (int i = 0; i < res->num_variables; i++) {
-        if (!add_pass_var(dp, tmp, pass, &params, &res->variables[i], &pass->vars[i], false))
-            goto error;
+// Installs the compiled `pl_pass`, or marks the pass as failed
+static void pass_install(struct pl_dispatch *dp, struct pass *pass,
+                         const struct pl_pass *pl_pass)
+{
+    pass->pass = pass->run_params.pass = pl_pass;
+    if (!pass->pass) {
+        PL_ERR(dp, "Failed creating render pass for dispatch");
+        pass->failed = true;
+        return;
     }
 
-    for (int i = 0; i < res->num_variables; i++) {
-        if (!add_pass_var(dp, tmp, pass, &params, &res->variables[i], &pass->vars[i], true))
-            goto error;
+    pass->failed = false;
+    pass->memory = pass_memory(pass);
+    dp->pass_memory += pass->memory;
+
+    // Share the compiled program with other dispatch objects. Programs with
+    // constants hard-coded as literals depend on more than just the
+    // signature, so these are never looked up (see `find_pass`)
+    const struct pl_pass_params *params = &pl_pass->params;
+    bool literals = pass->constants.len &&
+                    !(dp->gpu->caps & PL_GPU_CAP_SPEC_CONSTANTS);
+    if (params->cached_program_len && !literals) {
+        program_cache_add(dp->programs, pass->signature, params->cached_program,
+                          params->cached_program_len);
     }
+}
 
-    // Create and attach the UBO if necessary
-    int ubo_index = -1;
-    size_t ubo_size = sh_buf_desc_size(&pass->ubo_desc);
-    if (ubo_size) {
-        pass->ubo = pl_buf_create(dp->gpu, &(struct pl_buf_params) {
-            .type = PL_BUF_UNIFORM,
-            .size = ubo_size,
-            .host_writable = true,
-        });
+static bool spawn_thread(struct pl_dispatch *dp)
+{
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, compile_thread, dp))
+        return false;
 
-        if (!pass->ubo) {
-            PL_ERR(dp, "Failed creating uniform buffer for dispatch");
-            goto error;
-        }
+    TARRAY_APPEND(dp, dp->threads, dp->num_threads, thread);
+    return true;
+}
 
-        ubo_index = res->num_descriptors;
-        pass->ubo_desc.object = pass->ubo;
-        sh_desc(sh, pass->ubo_desc);
+static void pass_queue(struct pl_dispatch *dp, struct pass *pass)
+{
+    if (!dp->num_threads && !spawn_thread(dp)) {
+        PL_WARN(dp, "Failed creating shader compilation thread, falling "
+                "back to synchronous compilation!");
+        dp->async = dp->params.async_compile = false;
+        pass_install(dp, pass, pl_pass_create(dp->gpu, &pass->async_params));
+        return;
     }
 
-    // Place and fill in the descriptors
-    int num = res->num_descriptors;
-    int binding[PL_DESC_TYPE_COUNT] = {0};
-    params.num_descriptors = num;
-    params.descriptors = talloc_zero_array(tmp, struct pl_desc, num);
-    rparams->desc_bindings = talloc_zero_array(pass, struct pl_desc_binding, num);
-    for (int i = 0; i < num; i++) {
-        struct pl_desc *desc = &params.descriptors[i];
-        *desc = res->descriptors[i].desc;
-        desc->binding = binding[pl_desc_namespace(dp->gpu, desc->type)]++;
-    }
+    pass->pending = true;
+    pthread_mutex_lock(&dp->lock);
+    TARRAY_APPEND(dp, dp->queue, dp->num_queue, pass);
+    bool grow = dp->num_queue > dp->idle_threads;
+    pthread_cond_signal(&dp->wakeup);
+    pthread_mutex_unlock(&dp->lock);
+
+    // Start another thread if all of the existing ones are busy. Failing to
+    // do so is harmless, the pass just waits for a free thread instead.
+    if (grow && dp->num_threads < dp->max_threads)
+        spawn_thread(dp);
+}
 
-    // Pre-fill the desc_binding for the UBO
-    if (pass->ubo) {
-        pl_assert(ubo_index >= 0);
-        rparams->desc_bindings[ubo_index].object = pass->ubo;
-    }
+// Checks whether a pending pass has finished compiling. If `block` is true,
+// this waits for the compilation to finish (compiling the pass on the calling
+// thread if it hasn't been started yet). Returns whether the pass is ready.
+static bool pass_poll(struct pl_dispatch *dp, struct pass *pass, bool block)
+{
+    if (!pass->pending)
+        return true;
 
-    // Create the push constants region
-    params.push_constants_size = PL_ALIGN2(params.push_constants_size, 4);
-    rparams->push_constants = talloc_zero_size(pass, params.push_constants_size);
+    bool compile_now = false;
+    pthread_mutex_lock(&dp->lock);
+    if (block && !pass->async_done) {
+        for (int i = 0; i < dp->num_queue; i++) {
+            if (dp->queue[i] == pass) {
+                TARRAY_REMOVE_AT(dp->queue, dp->num_queue, i);
+                compile_now = true;
+                break;
+            }
+        }
 
-    // Finally, finalize the shaders and create the pass itself
-    generate_shaders(dp, pass, &params, sh, vert_pos);
-    pass->pass = rparams->pass = pl_pass_create(dp->gpu, &params);
-    if (!pass->pass) {
-        PL_ERR(dp, "Failed creating render pass for dispatch");
-        goto error;
+        while (!compile_now && !pass->async_done)
+            pthread_cond_wait(&dp->done, &dp->lock);
     }
+    bool done = pass->async_done;
+    pthread_mutex_unlock(&dp->lock);
 
-    pass->failed = false;
+    if (compile_now) {
+        pass->async_result = pl_pass_create(dp->gpu, &pass->async_params);
+        done = true;
+    }
 
-error:
-    pass->ubo_desc = (struct pl_shader_desc) {0}; // contains temporary pointers
+    if (!done)
+        return false;
+
+    pass->pending = false;
+    pass_install(dp, pass, pass->async_result);
+    pass->async_result = NULL;
+    pass->async_params = (struct pl_pass_params) {0};
+    return true;
+}
+
+// Evict the least recently used passes until the cache fits inside the limits
+// again, except for `keep` (the pass we are about to use)
+static void evict_passes(struct pl_dispatch *dp, const struct pass *keep)
+{
+    const struct pl_dispatch_params *params = &dp->params;
+
+    while (dp->num_passes > 1) {
+        bool over_count = params->max_passes && dp->num_passes > params->max_passes;
+        bool over_mem = params->max_pass_memory &&
+                        dp->pass_memory > params->max_pass_memory;
+        if (!over_count && !over_mem)
+            return;
+
+        // This is a linear scan, but it only happens after compiling a new
+        // pass, which is orders of magnitude more expensive anyway
+        int oldest = -1;
+        for (int i = 0; i < dp->num_passes; i++) {
+            const struct pass *p = dp->passes[i];
+            if (p == keep || p->pending)
+                continue;
+            if (oldest < 0 || p->last_use < dp->passes[oldest]->last_use)
+                oldest = i;
+        }
+
+        if (oldest < 0)
+            return; // everything else is still being compiled
+
+        struct pass *pass = dp->passes[oldest];
+        PL_TRACE(dp, "Evicting pass 0x%"PRIx64" from the pass cache "
+                 "(%d passes, %zu bytes)", pass->signature, dp->num_passes,
+                 dp->pass_memory);
+
+        hash_remove(dp, pass);
+        dp->pass_memory -= pass->memory;
+        TARRAY_REMOVE_AT(dp->passes, dp->num_passes, oldest);
+        pass_destroy(dp, pass);
+    }
+}
+
+static void find_cached_program(struct pl_dispatch *dp, void *tmp, uint64_t sig,
+                                struct pl_pass_params *params)
+{
+    // Prefer the programs of live passes (e.g. same shader, different target
+    // format), since these were definitely generated by the current backend
+    for (int i = 0; i < dp->num_passes; i++) {
+        const struct pass *p = dp->passes[i];
+        if (p->signature == sig && p->pass && p->pass->params.cached_program_len) {
+            params->cached_program = p->pass->params.cached_program;
+            params->cached_program_len = p->pass->params.cached_program_len;
+            return;
+        }
+    }
+
+    for (int i = 0; i < dp->num_cached_passes; i++) {
+        const struct cached_pass *cp = &dp->cached_passes[i];
+        if (cp->signature == sig) {
+            params->cached_program = cp->cached_program;
+            params->cached_program_len = cp->cached_program_len;
+            return;
+        }
+    }
+
+    // Fall back to programs compiled by other dispatch objects
+    program_cache_get(dp->programs, tmp, sig, params);
+}
+
+static char *pass_label(struct pass *pass, const struct pl_shader *sh)
+{
+    if (!sh->num_steps)
+        return talloc_strdup(pass, "(unknown)");
+
+    char *label = talloc_strdup(pass, sh->steps[0]);
+    for (int i = 1; i < sh->num_steps; i++)
+        label = talloc_asprintf_append(label, ", %s", sh->steps[i]);
+    return label;
+}
+
+// Collect all completed timer measurements for this pass
+static void pass_poll_timer(struct pl_dispatch *dp, struct pass *pass)
+{
+    uint64_t ns;
+    while ((ns = pl_timer_query(dp->gpu, pass->timer))) {
+        int idx = pass->num_samples++ % PL_DISPATCH_TIMING_SAMPLES;
+        pass->samples[idx] = ns;
+    }
+}
+
+// Sub-allocates `size` bytes from the UBO ring, returning the buffer and the
+// offset of the allocated region
+static bool ubo_ring_alloc(struct pl_dispatch *dp, size_t size,
+                           const struct pl_buf **out_buf, size_t *out_offset)
+{
+    const struct pl_gpu *gpu = dp->gpu;
+    size_t offset = PL_ALIGN(dp->ubo_offset, gpu->limits.align_ubo_offset);
+    if (!dp->ubo_buf || offset + size > dp->ubo_buf->params.size) {
+        // Switch to the next buffer in the ring. Since the pool only hands
+        // out buffers not in use by the GPU, this never overwrites UBO
+        // contents of passes that are still pending
+        size_t ring_size = PL_MIN(gpu->limits.max_ubo_size, 64 * 1024);
+        if (size > ring_size)
+            return false;
+
+        dp->ubo_buf = pl_buf_pool_get(gpu, &dp->ubo_ring, &(struct pl_buf_params) {
+            .type = PL_BUF_UNIFORM,
+            .size = ring_size,
+            .host_mapped = true,
+        });
+
+        if (!dp->ubo_buf)
+            return false;
+        offset = 0;
+    }
+
+    *out_buf = dp->ubo_buf;
+    *out_offset = offset;
+    dp->ubo_offset = offset + size;
+    return true;
+}
+
+// Uploads the staged UBO contents and binds the resulting buffer region
+static bool pass_update_ubo(struct pl_dispatch *dp, struct pass *pass)
+{
+    if (!pass->ubo_size)
+        return true;
+
+    struct pl_desc_binding *db = &pass->run_params.desc_bindings[pass->ubo_index];
+    if (!dp->disable_ubo_ring) {
+        const struct pl_buf *buf;
+        size_t offset;
+        if (ubo_ring_alloc(dp, pass->ubo_size, &buf, &offset)) {
+            memcpy(buf->data + offset, pass->ubo_data, pass->ubo_size);
+            db->object = buf;
+            db->buf_offset = offset;
+            return true;
+        }
+
+        PL_WARN(dp, "Failed allocating from the UBO ring buffer, falling back "
+                "to per-pass uniform buffers");
+        pl_buf_pool_uninit(dp->gpu, &dp->ubo_ring);
+        dp->ubo_buf = NULL;
+        dp->disable_ubo_ring = true;
+    }
+
+    if (!pass->ubo) {
+        pass->ubo = pl_buf_create(dp->gpu, &(struct pl_buf_params) {
+            .type = PL_BUF_UNIFORM,
+            .size = pass->ubo_size,
+            .host_writable = true,
+        });
+
+        if (!pass->ubo) {
+            PL_ERR(dp, "Failed creating uniform buffer for dispatch");
+            return false;
+        }
+
+        pass->ubo_dirty = true;
+    }
+
+    if (pass->ubo_dirty) {
+        pl_buf_write(dp->gpu, pass->ubo, 0, pass->ubo_data, pass->ubo_size);
+        pass->ubo_dirty = false;
+    }
+
+    db->object = pass->ubo;
+    db->buf_offset = 0;
+    return true;
+}
+
+static bool pass_run(struct pl_dispatch *dp, struct pass *pass)
+{
+    if (!pass_update_ubo(dp, pass))
+        return false;
+
+    if (pass->timer)
+        pass_poll_timer(dp, pass);
+
+    pl_pass_run(dp->gpu, &pass->run_params);
+    return true;
+}
+
+// Returns whether all of the sampled textures used by a shader can be read
+// from the global texture heap instead (see `pl_pass_params.bindless`)
+static bool use_bindless(const struct pl_gpu *gpu, const struct pl_shader_res *res)
+{
+    if (!(gpu->caps & PL_GPU_CAP_BINDLESS))
+        return false;
+
+    int num_tex = 0;
+    for (int i = 0; i < res->num_descriptors; i++) {
+        const struct pl_shader_desc *sd = &res->descriptors[i];
+        if (sd->desc.type != PL_DESC_SAMPLED_TEX)
+            continue;
+        const struct pl_tex *tex = sd->object;
+        if (!tex->bindless_index)
+            return false;
+        num_tex++;
+    }
+
+    return num_tex > 0;
+}
+
+static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
+                              const struct pl_tex *target, ident_t vert_pos,
+                              const struct pl_blend_params *blend)
+{
+    uint64_t sig = pl_shader_signature(sh);
+    bool compute = pl_shader_is_compute(sh);
+    struct pl_shader_res *res = &sh->res;
+
+    // Gather the values of all compile-time constants, since these are part
+    // of the pass itself
+    struct bstr *constants = &dp->tmp[TMP_CONSTANTS];
+    for (int i = 0; i < res->num_variables; i++) {
+        const struct pl_shader_var *sv = &res->variables[i];
+        if (!is_constant(sv))
+            continue;
+        size_t size = pl_var_host_layout(0, &sv->var).size;
+        bstr_xappend(dp, constants, (struct bstr) { (uint8_t *) sv->data, size });
+    }
+
+    uint64_t key = pass_key(sig, *constants, compute ? NULL : target, blend);
+    dp->use_count++;
+
+    if (dp->num_buckets) {
+        struct pass *p = dp->buckets[key & (dp->num_buckets - 1)];
+        for (; p; p = p->hash_next) {
+            if (p->key == key &&
+                pass_matches(p, sig, *constants, compute, target, blend))
+            {
+                p->last_use = dp->use_count;
+                pass_poll(dp, p, !dp->async);
+                return p;
+            }
+        }
+    }
+
+    void *tmp = talloc_new(dp->arena); // for resources attached to `params`
+
+    struct pass *pass = talloc_zero(dp, struct pass);
+    pass->signature = sig;
+    pass->key = key;
+    pass->last_use = dp->use_count;
+    pass->label = pass_label(pass, sh);
+    pass->failed = true; // will be set to false on success
+    pass->constants = bstrdup(pass, *constants);
+    pass->ubo_desc = (struct pl_shader_desc) {
+        .desc = {
+            .name = "UBO",
+            .type = PL_DESC_BUF_UNIFORM,
+        },
+    };
+
+    struct pl_pass_run_params *rparams = &pass->run_params;
+    if (dp->params.timing) {
+        pass->timer = pl_timer_create(dp->gpu);
+        rparams->timer = pass->timer;
+    }
+
+    struct pl_pass_params params = {
+        .type = pl_shader_is_compute(sh) ? PL_PASS_COMPUTE : PL_PASS_RASTER,
+        .num_descriptors = res->num_descriptors,
+        .constant_data = pass->constants.start,
+        .blend_params = blend, // set this for all pass types (for caching)
+        .optimize = dp->params.optimize,
+        .bindless = use_bindless(dp->gpu, res),
+    };
+
+    if (params.type == PL_PASS_RASTER && !vert_pos) {
+        assert(target);
+        params.target_dummy = *target;
+
+        // No vertex data, the vertex shader generates a single triangle
+        params.vertex_type = PL_PRIM_TRIANGLE_LIST;
+        rparams->vertex_count = 3;
+    } else if (params.type == PL_PASS_RASTER) {
+        assert(target);
+        params.target_dummy = *target;
+
+        // Fill in the vertex attributes array
+        params.num_vertex_attribs = res->num_vertex_attribs;
+        params.vertex_attribs = talloc_zero_array(tmp, struct pl_vertex_attrib,
+                                                  res->num_vertex_attribs);
+
+        int va_loc = 0;
+        for (int i = 0; i < res->num_vertex_attribs; i++) {
+            struct pl_vertex_attrib *va = &params.vertex_attribs[i];
+            *va = res->vertex_attribs[i].attr;
+
+            // Mangle the name to make sure it doesn't conflict with the
+            // fragment shader input
+            va->name = talloc_asprintf(tmp, "vert%s", va->name);
+
+            // Place the vertex attribute
+            va->offset = params.vertex_stride;
+            va->location = va_loc;
+            params.vertex_stride += va->fmt->texel_size;
+
+            // The number of vertex attribute locations consumed by a vertex
+            // attribute is the number of vec4s it consumes, rounded up
+            const size_t va_loc_size = sizeof(float[4]);
+            va_loc += (va->fmt->texel_size + va_loc_size - 1) / va_loc_size;
+        }
+
+        // Generate the vertex array placeholder
+        params.vertex_type = PL_PRIM_TRIANGLE_STRIP;
+        rparams->vertex_count = 4; // single quad
+        size_t vert_size = rparams->vertex_count * params.vertex_stride;
+        rparams->vertex_data = talloc_zero_size(pass, vert_size);
+    }
+
+    // Place all the variables; these will dynamically end up in different
+    // locations based on what the underlying GPU supports (UBOs, pushc, etc.)
+    //
+    // We go through the list twice, once to place stuff that we definitely
+    // want inside PCs, and then a second time to opportunistically place the rest.
+    pass->vars = talloc_zero_array(pass, struct pass_var, res->num_variables);
+    for (int i = 0; i < res->num_variables; i++) {
+        if (!add_pass_var(dp, tmp, pass, &params, &res->variables[i], &pass->vars[i], false))
+            goto error;
+    }
+
+    for (int i = 0; i < res->num_variables; i++) {
+        if (!add_pass_var(dp, tmp, pass, &params, &res->variables[i], &pass->vars[i], true))
+            goto error;
+    }
+
+    // Attach the UBO if necessary. The actual buffer is bound on every run
+    pass->ubo_size = sh_buf_desc_size(&pass->ubo_desc);
+    if (pass->ubo_size) {
+        pass->ubo_index = res->num_descriptors;
+        pass->ubo_data = talloc_zero_size(pass, pass->ubo_size);
+        sh_desc(sh, pass->ubo_desc);
+    }
+
+    // Place and fill in the descriptors
+    int num = res->num_descriptors;
+    int binding[PL_DESC_TYPE_COUNT] = {0};
+    params.num_descriptors = num;
+    params.descriptors = talloc_zero_array(tmp, struct pl_desc, num);
+    rparams->desc_bindings = talloc_zero_array(pass, struct pl_desc_binding, num);
+    for (int i = 0; i < num; i++) {
+        struct pl_desc *desc = &params.descriptors[i];
+        *desc = res->descriptors[i].desc;
+        desc->binding = binding[pl_desc_namespace(dp->gpu, desc->type)]++;
+    }
+
+    // Create the push constants region
+    params.push_constants_size = PL_ALIGN2(params.push_constants_size, 4);
+    rparams->push_constants = talloc_zero_size(pass, params.push_constants_size);
+
+    // Re-use a previously compiled program for this signature, if possible.
+    // Constants hard-coded as literals make the program depend on more than
+    // just the signature, so skip the cache in that case
+    if (!constants->len || (dp->gpu->caps & PL_GPU_CAP_SPEC_CONSTANTS))
+        find_cached_program(dp, tmp, sig, &params);
+
+    // Finally, finalize the shaders and create the pass itself
+    uint64_t start = pl_span_begin(dp->ctx);
+    generate_shaders(dp, pass, &params, sh, vert_pos);
+    pl_span_end(dp->ctx, "generate shaders", start);
+    if (dp->async) {
+        // Everything in `params` is temporary, so make a deep copy for the
+        // compile thread to use
+        pass->async_params = pl_pass_params_copy(pass, &params);
+        if (params.cached_program_len) {
+            pass->async_params.cached_program = talloc_memdup(pass,
+                    params.cached_program, params.cached_program_len);
+            pass->async_params.cached_program_len = params.cached_program_len;
+        }
+
+        pass->failed = false;
+        pass_queue(dp, pass);
+    } else {
+        pass_install(dp, pass, pl_pass_create(dp->gpu, &params));
+    }
+
+error:
+    pass->ubo_desc = (struct pl_shader_desc) {0}; // contains temporary pointers
     talloc_free(tmp);
+    talloc_arena_reset(dp->arena);
     TARRAY_APPEND(dp, dp->passes, dp->num_passes, pass);
+    hash_add(dp, pass);
+    evict_passes(dp, pass);
     return pass;
 }
 
 static void update_pass_var(struct pl_dispatch *dp, struct pass *pass,
                             const struct pl_shader_var *sv, struct pass_var *pv)
 {
+    if (pv->type == PASS_VAR_CONST)
+        return; // already baked into the pass
+
     struct pl_var_layout host_layout = pl_var_host_layout(0, &sv->var);
     pl_assert(host_layout.size);
 
@@ -635,6 +1484,7 @@ static void update_pass_var(struct pl_dispatch *dp, struct pass *pass,
     struct pl_pass_run_params *rparams = &pass->run_params;
     switch (pv->type) {
     case PASS_VAR_NONE:
+    case PASS_VAR_CONST:
         abort();
     case PASS_VAR_GLOBAL: {
         struct pl_var_update vu = {
@@ -644,18 +1494,11 @@ static void update_pass_var(struct pl_dispatch *dp, struct pass *pass,
         TARRAY_APPEND(pass, rparams->var_updates, rparams->num_var_updates, vu);
         break;
     }
-    case PASS_VAR_UBO: {
-        pl_assert(pass->ubo);
-        uintptr_t src = (uintptr_t) sv->data;
-        uintptr_t end = src + (ptrdiff_t) host_layout.size;
-        size_t dst = pv->layout.offset;
-        while (src < end) {
-            pl_buf_write(dp->gpu, pass->ubo, dst, (void *) src, host_layout.stride);
-            src += host_layout.stride;
-            dst += pv->layout.stride;
-        }
+    case PASS_VAR_UBO:
+        pl_assert(pass->ubo_data);
+        memcpy_layout(pass->ubo_data, pv->layout, sv->data, host_layout);
+        pass->ubo_dirty = true;
         break;
-    }
     case PASS_VAR_PUSHC:
         pl_assert(rparams->push_constants);
         memcpy_layout(rparams->push_constants, pv->layout, sv->data, host_layout);
@@ -663,25 +1506,39 @@ static void update_pass_var(struct pl_dispatch *dp, struct pass *pass,
     };
 }
 
-static void translate_compute_shader(struct pl_dispatch *dp,
-                                     struct pl_shader *sh,
-                                     const struct pl_tex *target,
-                                     const struct pl_rect2d *rc,
-                                     const struct pl_blend_params *blend)
+// Turns every sampled texture into an index into the global texture heap,
+// passed in as a dynamic variable. This way, switching between textures
+// only changes the value of a push constant rather than any descriptors.
+static void translate_bindless(struct pl_dispatch *dp, struct pl_shader *sh)
 {
-    // Simulate vertex attributes using global definitions
-    int width = abs(pl_rect_w(*rc)), height = abs(pl_rect_h(*rc));
-    ident_t out_scale = sh_var(sh, (struct pl_shader_var) {
-        .var     = pl_var_vec2("out_scale"),
-        .data    = &(float[2]){ 1.0 / width, 1.0 / height },
-        .dynamic = true,
-    });
+    const struct pl_shader_res *res = &sh->res;
+    if (!use_bindless(dp->gpu, res))
+        return;
 
-    GLSLP("#define frag_pos(id) (vec2(id) + vec2(0.5)) \n"
-          "#define frag_map(id) (%s * frag_pos(id))    \n"
-          "#define gl_FragCoord vec4(frag_pos(gl_GlobalInvocationID), 0.0, 1.0) \n",
-          out_scale);
+    for (int i = 0; i < res->num_descriptors; i++) {
+        if (res->descriptors[i].desc.type != PL_DESC_SAMPLED_TEX)
+            continue;
+
+        const struct pl_tex *tex = res->descriptors[i].object;
+        int dims = pl_tex_params_dimension(tex->params);
+        ident_t idx = sh_var(sh, (struct pl_shader_var) {
+            .var = pl_var_uint("tex_idx"),
+            .data = &tex->bindless_index,
+            .dynamic = true,
+        });
+
+        GLSLP("#define %s pl_bindless_%dd[%s]\n",
+              res->descriptors[i].desc.name, dims, idx);
+    }
+}
 
+// Replaces the vertex attributes of a shader by global definitions which
+// interpolate between the values at the four corners of the quad. Each
+// attribute `name` becomes available as `name_map(id)`, for any `id` accepted
+// by `frag_map`, which must map it to the (0,0)-(1,1) range of the quad. The
+// attribute itself is defined as its value at `pos`.
+static void emulate_vertex_attribs(struct pl_shader *sh, const char *pos)
+{
     for (int n = 0; n < sh->res.num_vertex_attribs; n++) {
         const struct pl_shader_va *sva = &sh->res.vertex_attribs[n];
 
@@ -696,11 +1553,34 @@ static void translate_compute_shader(struct pl_dispatch *dp,
              "(mix(mix(%s, %s, frag_map(id).x), "
              "     mix(%s, %s, frag_map(id).x), "
              "frag_map(id).y))\n"
-             "#define %s (%s_map(gl_GlobalInvocationID))\n",
+             "#define %s (%s_map(%s))\n",
              sva->attr.name,
              points[0], points[1], points[2], points[3],
-             sva->attr.name, sva->attr.name);
+             sva->attr.name, sva->attr.name, pos);
     }
+}
+
+static void translate_compute_shader(struct pl_dispatch *dp,
+                                     struct pl_shader *sh,
+                                     const struct pl_tex *target,
+                                     const struct pl_rect2d *rc,
+                                     const struct pl_rect2d *clip,
+                                     const struct pl_blend_params *blend)
+{
+    // Simulate vertex attributes using global definitions
+    int width = abs(pl_rect_w(*rc)), height = abs(pl_rect_h(*rc));
+    ident_t out_scale = sh_var(sh, (struct pl_shader_var) {
+        .var     = pl_var_vec2("out_scale"),
+        .data    = &(float[2]){ 1.0 / width, 1.0 / height },
+        .dynamic = true,
+    });
+
+    GLSLP("#define frag_pos(id) (vec2(id) + vec2(0.5)) \n"
+          "#define frag_map(id) (%s * frag_pos(id))    \n"
+          "#define gl_FragCoord vec4(frag_pos(gl_GlobalInvocationID), 0.0, 1.0) \n",
+          out_scale);
+
+    emulate_vertex_attribs(sh, "gl_GlobalInvocationID");
 
     // Simulate a framebuffer using storage images
     pl_assert(target->params.storable);
@@ -727,11 +1607,28 @@ static void translate_compute_shader(struct pl_dispatch *dp,
         },
     });
 
+    // Simulate the scissors, see `pl_dispatch_set_clip`
+    ident_t bounds = sh_var(sh, (struct pl_shader_var) {
+        .data    = &(int[4]){ clip->x0, clip->y0, clip->x1, clip->y1 },
+        .dynamic = true,
+        .var     = {
+            .name  = "clip",
+            .type  = PL_VAR_SINT,
+            .dim_v = 4,
+            .dim_m = 1,
+            .dim_a = 1,
+        },
+    });
+
     int dx = rc->x0 > rc->x1 ? -1 : 1, dy = rc->y0 > rc->y1 ? -1 : 1;
     GLSL("ivec2 dir = ivec2(%d, %d);\n", dx, dy); // hard-code, not worth var
     GLSL("ivec2 pos = %s + dir * ivec2(gl_GlobalInvocationID);\n", base);
     GLSL("vec2 fpos = %s * vec2(gl_GlobalInvocationID);\n", out_scale);
-    GLSL("if (max(fpos.x, fpos.y) < 1.0) {\n");
+    GLSL("if (max(fpos.x, fpos.y) < 1.0 &&                  \n"
+         "    all(greaterThanEqual(pos, %s.xy)) &&           \n"
+         "    all(lessThan(pos, %s.zw)))                     \n"
+         "{                                                  \n",
+         bounds, bounds);
     if (blend) {
         GLSL("vec4 orig = imageLoad(%s, pos);\n", fbo);
 
@@ -752,13 +1649,97 @@ static void translate_compute_shader(struct pl_dispatch *dp,
     sh->res.output = PL_SHADER_SIG_NONE;
 }
 
-bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
-                        const struct pl_tex *target, const struct pl_rect2d *rc,
-                        const struct pl_blend_params *blend)
+// Simulates the vertex attributes of a single quad covering `rc`, for raster
+// passes drawn without any vertex data. The vertex shader emits the NDC
+// position of an oversized triangle as `frag_ndc`, which is mapped back to
+// the (0,0)-(1,1) range of `rc` here, and clipped to `rc` by the scissors.
+static void translate_fullscreen_shader(struct pl_shader *sh,
+                                        const struct pl_tex *target,
+                                        const struct pl_rect2d *rc)
+{
+    const struct pl_tex_params *tpars = &target->params;
+    float x0 = 2.0 * rc->x0 / tpars->w - 1.0,
+          y0 = 2.0 * rc->y0 / tpars->h - 1.0,
+          x1 = 2.0 * rc->x1 / tpars->w - 1.0,
+          y1 = 2.0 * rc->y1 / tpars->h - 1.0;
+
+    ident_t out_map = sh_var(sh, (struct pl_shader_var) {
+        .var     = pl_var_vec4("out_map"),
+        .data    = &(float[4]){
+            1.0 / (x1 - x0), 1.0 / (y1 - y0),
+            x0 / (x0 - x1),  y0 / (y0 - y1),
+        },
+        .dynamic = true,
+    });
+
+    GLSLP("#define frag_map(ndc) (%s.xy * (ndc) + %s.zw)\n", out_map, out_map);
+    emulate_vertex_attribs(sh, "frag_ndc");
+
+    // The attributes are now fully described by variables
+    sh->res.num_vertex_attribs = 0;
+}
+
+// Writes the vertex data for a single quad, starting at vertex `base`. `attrs`
+// contains the values for all vertex attributes except the trailing position
+// attribute, which is given by `pos`. If `attrs` is NULL, the values attached
+// to the shader's vertex attributes are used instead.
+static void write_quad(struct pass *pass, const struct pl_shader_res *res,
+                       int base, const struct pl_rect2df *attrs,
+                       const struct pl_rect2df *pos)
+{
+    const struct pl_pass_run_params *rparams = &pass->run_params;
+    uintptr_t vert_base = (uintptr_t) rparams->vertex_data;
+    size_t stride = rparams->pass->params.vertex_stride;
+    for (int i = 0; i < res->num_vertex_attribs; i++) {
+        struct pl_shader_va *sva = &res->vertex_attribs[i];
+        struct pl_vertex_attrib *va = &rparams->pass->params.vertex_attribs[i];
+        uintptr_t va_base = vert_base + va->offset; // use placed offset
+
+        const struct pl_rect2df *rc = pos;
+        if (i < res->num_vertex_attribs - 1)
+            rc = attrs ? &attrs[i] : NULL;
+
+        if (!rc) {
+            size_t size = sva->attr.fmt->texel_size;
+            for (int n = 0; n < 4; n++)
+                memcpy((void *) (va_base + (base + n) * stride), sva->data[n], size);
+            continue;
+        }
+
+        // Same vertex order as `sh_attr_vec2`
+        const float vals[4][2] = {
+            { rc->x0, rc->y0 },
+            { rc->x1, rc->y0 },
+            { rc->x0, rc->y1 },
+            { rc->x1, rc->y1 },
+        };
+
+        for (int n = 0; n < 4; n++)
+            memcpy((void *) (va_base + (base + n) * stride), vals[n], sizeof(vals[n]));
+    }
+}
+
+// Copies vertex `src` to vertex `dst`, to generate degenerate triangles
+static void copy_vertex(struct pass *pass, int dst, int src)
+{
+    const struct pl_pass_run_params *rparams = &pass->run_params;
+    size_t stride = rparams->pass->params.vertex_stride;
+    uint8_t *data = rparams->vertex_data;
+    memcpy(data + dst * stride, data + src * stride, stride);
+}
+
+// Shared implementation of `pl_dispatch_finish` and `pl_dispatch_finish_quads`.
+// If `num_quads` is 0, renders a single quad covering `rc`.
+static bool dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
+                            const struct pl_tex *target, const struct pl_rect2d *rc,
+                            const struct pl_blend_params *blend,
+                            const struct pl_rect2d *rects,
+                            const struct pl_rect2df *attrs, int num_quads)
 {
     struct pl_shader *sh = *psh;
     const struct pl_shader_res *res = &sh->res;
     bool ret = false;
+    dp->pending = false;
 
     if (sh->failed) {
         PL_ERR(sh, "Trying to dispatch a failed shader.");
@@ -776,12 +1757,31 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
     }
 
     const struct pl_tex_params *tpars = &target->params;
-    if (pl_tex_params_dimension(*tpars) != 2 || !tpars->renderable) {
+    if (pl_tex_params_dimension(*tpars) != 2 ||
+        !(tpars->renderable || tpars->storable))
+    {
         PL_ERR(dp, "Trying to dispatch a shader using an invalid target "
-               "texture. The target must be a renderable 2D texture.");
+               "texture. The target must be a renderable or storable 2D "
+               "texture.");
         goto error;
     }
 
+    // Targets which can't be rendered to (e.g. on compute-only devices) can
+    // still be drawn to by turning the shader into a compute shader
+    if (!tpars->renderable && !pl_shader_is_compute(sh)) {
+        if (num_quads) {
+            PL_ERR(dp, "Trying to dispatch multiple quads to a non-renderable "
+                   "target. This is only supported for raster shaders.");
+            goto error;
+        }
+
+        if (!sh_try_compute(sh, 32, 8, true, 0)) {
+            PL_ERR(dp, "Trying to dispatch a shader to a non-renderable "
+                   "target, but it can't be turned into a compute shader!");
+            goto error;
+        }
+    }
+
     if (pl_shader_is_compute(sh) && !tpars->storable) {
         PL_ERR(dp, "Trying to dispatch using a compute shader with a "
                "non-storable target texture.");
@@ -791,6 +1791,39 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
     struct pl_rect2d full = {0, 0, tpars->w, tpars->h};
     rc = PL_DEF(rc, &full);
 
+    if (num_quads) {
+        if (pl_shader_is_compute(sh)) {
+            PL_ERR(dp, "Trying to dispatch multiple quads using a compute "
+                   "shader. This is only supported for raster shaders.");
+            goto error;
+        }
+
+        // The bounding box of all quads, for the scissors
+        full = rects[0];
+        pl_rect2d_normalize(&full);
+        for (int i = 1; i < num_quads; i++) {
+            struct pl_rect2d r = rects[i];
+            pl_rect2d_normalize(&r);
+            full.x0 = PL_MIN(full.x0, r.x0);
+            full.y0 = PL_MIN(full.y0, r.y0);
+            full.x1 = PL_MAX(full.x1, r.x1);
+            full.y1 = PL_MAX(full.y1, r.y1);
+        }
+        rc = &full;
+    }
+
+    struct pl_rect2d clip = {0, 0, tpars->w, tpars->h};
+    if (dp->clip_tex == target) {
+        clip.x0 = PL_MAX(clip.x0, dp->clip.x0);
+        clip.y0 = PL_MAX(clip.y0, dp->clip.y0);
+        clip.x1 = PL_MIN(clip.x1, dp->clip.x1);
+        clip.y1 = PL_MIN(clip.y1, dp->clip.y1);
+        if (clip.x0 >= clip.x1 || clip.y0 >= clip.y1) {
+            ret = true; // nothing to draw
+            goto error;
+        }
+    }
+
     int w, h, tw = abs(pl_rect_w(*rc)), th = abs(pl_rect_h(*rc));
     if (pl_shader_output_size(sh, &w, &h) && (w != tw || h != th))
     {
@@ -801,10 +1834,15 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
     }
 
     ident_t vert_pos = NULL;
+    translate_bindless(dp, sh);
 
     if (pl_shader_is_compute(sh)) {
         // Translate the compute shader to simulate vertices etc.
-        translate_compute_shader(dp, sh, target, rc, blend);
+        translate_compute_shader(dp, sh, target, rc, &clip, blend);
+    } else if (!num_quads && dp->gpu->glsl.version >= 130) {
+        // Single quads don't need any vertex data, as long as the vertex
+        // shader can tell the vertices apart
+        translate_fullscreen_shader(sh, target, rc);
     } else {
         // Add the vertex information encoding the position
         vert_pos = sh_attr_vec2(sh, "position", &(const struct pl_rect2df) {
@@ -821,6 +1859,12 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
     if (pass->failed)
         goto error;
 
+    // Skip passes that are still being compiled in the background
+    if (pass->pending) {
+        dp->pending = true;
+        goto error;
+    }
+
     struct pl_pass_run_params *rparams = &pass->run_params;
 
     // Update the descriptor bindings
@@ -833,17 +1877,35 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
         update_pass_var(dp, pass, &res->variables[i], &pass->vars[i]);
 
     // Update the vertex data
-    if (rparams->vertex_data) {
-        uintptr_t vert_base = (uintptr_t) rparams->vertex_data;
-        size_t stride = rparams->pass->params.vertex_stride;
-        for (int i = 0; i < res->num_vertex_attribs; i++) {
-            struct pl_shader_va *sva = &res->vertex_attribs[i];
-            struct pl_vertex_attrib *va = &rparams->pass->params.vertex_attribs[i];
+    if (rparams->vertex_data && !num_quads) {
+        rparams->vertex_count = 4;
+        write_quad(pass, res, 0, NULL, NULL);
+    } else if (rparams->vertex_data) {
+        // Draw all quads as a single triangle strip, joined by degenerate
+        // triangles; i.e. repeating the last vertex of every quad and the
+        // first vertex of the next one. This preserves the winding order,
+        // since every quad starts on an even vertex index
+        int num_attrs = res->num_vertex_attribs - 1; // excluding `vert_pos`
+        int count = 4 + 6 * (num_quads - 1);
+        size_t size = count * rparams->pass->params.vertex_stride;
+        if (talloc_get_size(rparams->vertex_data) < size)
+            rparams->vertex_data = talloc_realloc_size(pass, rparams->vertex_data, size);
+        rparams->vertex_count = count;
+
+        for (int i = 0, base = 0; i < num_quads; i++, base += 6) {
+            const struct pl_rect2d *r = &rects[i];
+            struct pl_rect2df pos = {
+                .x0 = 2.0 * r->x0 / tpars->w - 1.0,
+                .y0 = 2.0 * r->y0 / tpars->h - 1.0,
+                .x1 = 2.0 * r->x1 / tpars->w - 1.0,
+                .y1 = 2.0 * r->y1 / tpars->h - 1.0,
+            };
 
-            size_t size = sva->attr.fmt->texel_size;
-            uintptr_t va_base = vert_base + va->offset; // use placed offset
-            for (int n = 0; n < 4; n++)
-                memcpy((void *) (va_base + n * stride), sva->data[n], size);
+            write_quad(pass, res, base, &attrs[i * num_attrs], &pos);
+            if (i > 0) {
+                copy_vertex(pass, base - 2, base - 3);
+                copy_vertex(pass, base - 1, base);
+            }
         }
     }
 
@@ -862,14 +1924,22 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
         rparams->compute_groups[2] = 1;
     } else {
         // Update the scissors for performance
-        rparams->scissors = *rc;
-        pl_rect2d_normalize(&rparams->scissors);
+        struct pl_rect2d *sc = &rparams->scissors;
+        *sc = *rc;
+        pl_rect2d_normalize(sc);
+        sc->x0 = PL_MAX(sc->x0, clip.x0);
+        sc->y0 = PL_MAX(sc->y0, clip.y0);
+        sc->x1 = PL_MIN(sc->x1, clip.x1);
+        sc->y1 = PL_MIN(sc->y1, clip.y1);
+        if (sc->x0 >= sc->x1 || sc->y0 >= sc->y1) {
+            ret = true; // entirely clipped
+            goto error;
+        }
     }
 
     // Dispatch the actual shader
     rparams->target = target;
-    pl_pass_run(dp->gpu, &pass->run_params);
-    ret = true;
+    ret = pass_run(dp, pass);
 
 error:
     // Reset the temporary buffers which we use to build the shader
@@ -880,12 +1950,35 @@ error:
     return ret;
 }
 
-bool pl_dispatch_compute(struct pl_dispatch *dp, struct pl_shader **psh,
-                         int dispatch_size[3])
+bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **psh,
+                        const struct pl_tex *target, const struct pl_rect2d *rc,
+                        const struct pl_blend_params *blend)
+{
+    return dispatch_finish(dp, psh, target, rc, blend, NULL, NULL, 0);
+}
+
+bool pl_dispatch_finish_quads(struct pl_dispatch *dp, struct pl_shader **psh,
+                              const struct pl_tex *target,
+                              const struct pl_rect2d *rects,
+                              const struct pl_rect2df *attrs, int num_quads,
+                              const struct pl_blend_params *blend)
+{
+    if (!num_quads) {
+        pl_dispatch_abort(dp, psh);
+        return true;
+    }
+
+    return dispatch_finish(dp, psh, target, NULL, blend, rects, attrs, num_quads);
+}
+
+static bool dispatch_compute(struct pl_dispatch *dp, struct pl_shader **psh,
+                             const int dispatch_size[3],
+                             const struct pl_buf *indirect, size_t offset)
 {
     struct pl_shader *sh = *psh;
     const struct pl_shader_res *res = &sh->res;
     bool ret = false;
+    dp->pending = false;
 
     if (sh->failed) {
         PL_ERR(sh, "Trying to dispatch a failed shader.");
@@ -914,12 +2007,19 @@ bool pl_dispatch_compute(struct pl_dispatch *dp, struct pl_shader **psh,
         goto error;
     }
 
+    translate_bindless(dp, sh);
     struct pass *pass = find_pass(dp, sh, NULL, NULL, NULL);
 
     // Silently return on failed passes
     if (pass->failed)
         goto error;
 
+    // Skip passes that are still being compiled in the background
+    if (pass->pending) {
+        dp->pending = true;
+        goto error;
+    }
+
     struct pl_pass_run_params *rparams = &pass->run_params;
 
     // Update the descriptor bindings
@@ -933,11 +2033,12 @@ bool pl_dispatch_compute(struct pl_dispatch *dp, struct pl_shader **psh,
 
     // Update the dispatch size
     for (int i = 0; i < 3; i++)
-        rparams->compute_groups[i] = dispatch_size[i];
+        rparams->compute_groups[i] = indirect ? 0 : dispatch_size[i];
+    rparams->compute_indirect = indirect;
+    rparams->compute_indirect_offset = offset;
 
     // Dispatch the actual shader
-    pl_pass_run(dp->gpu, &pass->run_params);
-    ret = true;
+    ret = pass_run(dp, pass);
 
 error:
     // Reset the temporary buffers which we use to build the shader
@@ -948,6 +2049,28 @@ error:
     return ret;
 }
 
+bool pl_dispatch_compute(struct pl_dispatch *dp, struct pl_shader **psh,
+                         int dispatch_size[3])
+{
+    return dispatch_compute(dp, psh, dispatch_size, NULL, 0);
+}
+
+bool pl_dispatch_compute_indirect(struct pl_dispatch *dp, struct pl_shader **psh,
+                                  const struct pl_buf *buf, size_t offset)
+{
+    return dispatch_compute(dp, psh, NULL, buf, offset);
+}
+
+void pl_dispatch_batch_begin(struct pl_dispatch *dp)
+{
+    pl_gpu_batch(dp->gpu, true);
+}
+
+void pl_dispatch_batch_end(struct pl_dispatch *dp)
+{
+    pl_gpu_batch(dp->gpu, false);
+}
+
 void pl_dispatch_abort(struct pl_dispatch *dp, struct pl_shader **psh)
 {
     struct pl_shader *sh = *psh;
@@ -958,3 +2081,267 @@ void pl_dispatch_abort(struct pl_dispatch *dp, struct pl_shader **psh)
     TARRAY_APPEND(dp, dp->shaders, dp->num_shaders, sh);
     *psh = NULL;
 }
+
+// Serialized cache format: a `struct cache_header`, followed by `num_entries`
+// instances of `struct cache_entry`, each directly followed by the program
+static const char cache_magic[4] = {'P','L','D','P'};
+static const int cache_version = 1;
+
+struct cache_header {
+    char magic[sizeof(cache_magic)];
+    int cache_version;
+    uint8_t gpu_uuid[16];
+    uint32_t num_entries;
+    uint64_t total_size; // including this header
+};
+
+struct cache_entry {
+    uint64_t signature;
+    uint64_t size;
+    uint64_t hash; // bstr_hash64 of the data, to detect corruption
+};
+
+static size_t write_entry(uint8_t *out, size_t pos, uint64_t sig,
+                          const uint8_t *data, size_t size)
+{
+    if (out) {
+        struct cache_entry entry = {
+            .signature = sig,
+            .size = size,
+            .hash = bstr_hash64((struct bstr) { (uint8_t *) data, size }),
+        };
+
+        memcpy(out + pos, &entry, sizeof(entry));
+        memcpy(out + pos + sizeof(entry), data, size);
+    }
+
+    return pos + sizeof(struct cache_entry) + size;
+}
+
+void pl_dispatch_set_float16(struct pl_dispatch *dp, bool float16)
+{
+    dp->params.float16 = float16;
+}
+
+void pl_dispatch_set_timing(struct pl_dispatch *dp, bool timing)
+{
+    if (dp->params.timing == timing)
+        return;
+
+    dp->params.timing = timing;
+    for (int i = 0; i < dp->num_passes; i++) {
+        struct pass *pass = dp->passes[i];
+        if (timing) {
+            pass->timer = pl_timer_create(dp->gpu);
+        } else {
+            pl_timer_destroy(dp->gpu, &pass->timer);
+            pass->num_samples = 0;
+        }
+        pass->run_params.timer = pass->timer;
+    }
+}
+
+uint64_t pl_dispatch_mark(const struct pl_dispatch *dp)
+{
+    return dp->use_count;
+}
+
+uint64_t pl_dispatch_gpu_time(struct pl_dispatch *dp, uint64_t start,
+                              uint64_t end)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < dp->num_passes; i++) {
+        struct pass *pass = dp->passes[i];
+        if (!pass->timer || pass->last_use <= start || pass->last_use > end)
+            continue;
+
+        pass_poll_timer(dp, pass);
+        if (pass->num_samples) {
+            int last = (pass->num_samples - 1) % PL_DISPATCH_TIMING_SAMPLES;
+            total += pass->samples[last];
+        }
+    }
+
+    return total;
+}
+
+int pl_dispatch_timings(struct pl_dispatch *dp, struct pl_dispatch_timing *out,
+                        int max_out)
+{
+    int num = 0;
+    for (int i = 0; i < dp->num_passes; i++) {
+        struct pass *pass = dp->passes[i];
+        if (!pass->timer)
+            continue;
+
+        pass_poll_timer(dp, pass);
+        if (!pass->num_samples)
+            continue;
+
+        if (num < max_out) {
+            int count = PL_MIN(pass->num_samples, PL_DISPATCH_TIMING_SAMPLES);
+            int last = (pass->num_samples - 1) % PL_DISPATCH_TIMING_SAMPLES;
+            struct pl_dispatch_timing *info = &out[num];
+            *info = (struct pl_dispatch_timing) {
+                .signature = pass->signature,
+                .label = pass->label,
+                .count = pass->num_samples,
+                .last = pass->samples[last],
+            };
+
+            uint64_t sum = 0;
+            for (int n = 0; n < count; n++) {
+                sum += pass->samples[n];
+                info->peak = PL_MAX(info->peak, pass->samples[n]);
+            }
+            info->average = sum / count;
+        }
+
+        num++;
+    }
+
+    return num;
+}
+
+size_t pl_dispatch_save(struct pl_dispatch *dp, uint8_t *out)
+{
+    size_t pos = sizeof(struct cache_header);
+    uint32_t num_entries = 0;
+
+    for (int i = 0; i < dp->num_passes; i++) {
+        const struct pass *p = dp->passes[i];
+        if (!p->pass || !p->pass->params.cached_program_len)
+            continue;
+
+        // Only save the first pass for each signature
+        bool dupe = false;
+        for (int j = 0; j < i; j++) {
+            const struct pass *o = dp->passes[j];
+            dupe |= o->signature == p->signature && o->pass &&
+                    o->pass->params.cached_program_len;
+        }
+        if (dupe)
+            continue;
+
+        pos = write_entry(out, pos, p->signature, p->pass->params.cached_program,
+                          p->pass->params.cached_program_len);
+        num_entries++;
+    }
+
+    // Also preserve loaded programs that are not currently used by any pass
+    for (int i = 0; i < dp->num_cached_passes; i++) {
+        const struct cached_pass *cp = &dp->cached_passes[i];
+        bool live = false;
+        for (int j = 0; j < dp->num_passes; j++) {
+            const struct pass *p = dp->passes[j];
+            live |= p->signature == cp->signature && p->pass &&
+                    p->pass->params.cached_program_len;
+        }
+        if (live)
+            continue;
+
+        pos = write_entry(out, pos, cp->signature, cp->cached_program,
+                          cp->cached_program_len);
+        num_entries++;
+    }
+
+    if (out) {
+        struct cache_header header = {
+            .cache_version = cache_version,
+            .num_entries = num_entries,
+            .total_size = pos,
+        };
+
+        memcpy(header.magic, cache_magic, sizeof(cache_magic));
+        memcpy(header.gpu_uuid, dp->gpu->uuid, sizeof(header.gpu_uuid));
+        memcpy(out, &header, sizeof(header));
+        PL_DEBUG(dp, "Saved %"PRIu32" programs (%zu bytes) to dispatch cache",
+                 num_entries, pos);
+    }
+
+    return pos;
+}
+
+void pl_dispatch_load(struct pl_dispatch *dp, const uint8_t *cache,
+                      size_t size)
+{
+    struct cache_header header;
+    if (size < sizeof(header)) {
+        PL_WARN(dp, "Failed loading dispatch cache: truncated header");
+        return;
+    }
+
+    memcpy(&header, cache, sizeof(header));
+
+    if (strncmp(header.magic, cache_magic, sizeof(cache_magic)) != 0) {
+        PL_WARN(dp, "Failed loading dispatch cache: invalid magic bytes");
+        return;
+    }
+
+    if (header.cache_version != cache_version) {
+        PL_INFO(dp, "Failed loading dispatch cache: wrong version (got %d, "
+                "expected %d)", header.cache_version, cache_version);
+        return;
+    }
+
+    if (memcmp(header.gpu_uuid, dp->gpu->uuid, sizeof(header.gpu_uuid)) != 0) {
+        PL_INFO(dp, "Failed loading dispatch cache: GPU UUID mismatch");
+        return;
+    }
+
+    // All further bounds checks are against `total_size`, so make sure the
+    // blob actually contains that much data
+    if (header.total_size < sizeof(header) || header.total_size > size) {
+        PL_WARN(dp, "Failed loading dispatch cache: truncated data (got %zu "
+                "bytes, expected %zu)", size, (size_t) header.total_size);
+        return;
+    }
+
+    size_t pos = sizeof(header);
+    int num_loaded = 0;
+    for (uint32_t n = 0; n < header.num_entries; n++) {
+        struct cache_entry entry;
+        if (sizeof(entry) > header.total_size - pos) {
+            PL_WARN(dp, "Failed loading dispatch cache: truncated data");
+            return;
+        }
+
+        memcpy(&entry, cache + pos, sizeof(entry));
+        pos += sizeof(entry);
+        if (entry.size > header.total_size - pos) {
+            PL_WARN(dp, "Failed loading dispatch cache: truncated data");
+            return;
+        }
+
+        struct bstr data = { (uint8_t *) cache + pos, entry.size };
+        pos += entry.size;
+        if (bstr_hash64(data) != entry.hash) {
+            PL_WARN(dp, "Skipping corrupt program 0x%"PRIx64" in dispatch "
+                    "cache", entry.signature);
+            continue;
+        }
+
+        struct cached_pass *cp = NULL;
+        for (int i = 0; i < dp->num_cached_passes; i++) {
+            if (dp->cached_passes[i].signature == entry.signature) {
+                cp = &dp->cached_passes[i];
+                talloc_free((void *) cp->cached_program);
+                break;
+            }
+        }
+
+        if (!cp) {
+            TARRAY_GROW(dp, dp->cached_passes, dp->num_cached_passes);
+            cp = &dp->cached_passes[dp->num_cached_passes++];
+        }
+
+        *cp = (struct cached_pass) {
+            .signature = entry.signature,
+            .cached_program = talloc_memdup(dp, data.start, data.len),
+            .cached_program_len = data.len,
+        };
+        num_loaded++;
+    }
+
+    PL_DEBUG(dp, "Loaded %d programs from dispatch cache", num_loaded);
+}
@@ -33,3 +33,56 @@ struct pl_shader *pl_dispatch_begin_ex(struct pl_dispatch *dp, bool unique);
 //
 // This is a private API since it's only relevant if using `pl_dispatch_begin_ex`
 void pl_dispatch_reset_frame(struct pl_dispatch *dp);
+
+// Enables or disables background compilation of new passes, overriding
+// `pl_dispatch_params.async_compile`. When disabled, dispatching a shader
+// whose pass is still being compiled will block until it's done.
+void pl_dispatch_set_async(struct pl_dispatch *dp, bool async);
+
+// Returns true if the most recent `pl_dispatch_finish` / `pl_dispatch_compute`
+// failed only because its pass is still being compiled in the background.
+bool pl_dispatch_pending(const struct pl_dispatch *dp);
+
+// Restricts all passes rendering to `target` to only modify pixels inside
+// `rc`, in addition to their own target rect. This applies to both raster
+// shaders (via the scissors) and compute shaders. Passes that would be
+// entirely clipped are skipped, successfully. If `rc` is NULL, the previous
+// restriction is lifted.
+void pl_dispatch_set_clip(struct pl_dispatch *dp, const struct pl_tex *target,
+                          const struct pl_rect2d *rc);
+
+// Like `pl_dispatch_finish`, but draws `num_quads` separate quads in a single
+// pass, one for each target rect in `rects`; rather than a single quad. All
+// vertex attributes of `sh` must have been added using `sh_attr_vec2`, and
+// the values attached to them are replaced by the per-quad values in `attrs`:
+// for quad `i`, the value of the `n`-th attribute is `attrs[i * num + n]`,
+// where `num` is the number of vertex attributes of `sh`. Only supported for
+// raster shaders.
+bool pl_dispatch_finish_quads(struct pl_dispatch *dp, struct pl_shader **sh,
+                              const struct pl_tex *target,
+                              const struct pl_rect2d *rects,
+                              const struct pl_rect2df *attrs, int num_quads,
+                              const struct pl_blend_params *blend);
+
+// Enables or disables 16-bit float arithmetic for all subsequently created
+// shaders, overriding `pl_dispatch_params.float16`.
+void pl_dispatch_set_float16(struct pl_dispatch *dp, bool float16);
+
+// Enables or disables GPU timing of all passes, overriding
+// `pl_dispatch_params.timing`. Passes that are already cached get their
+// timers created (or destroyed) immediately.
+void pl_dispatch_set_timing(struct pl_dispatch *dp, bool timing);
+
+// Returns an opaque marker for the current point in the stream of dispatched
+// passes, for use with `pl_dispatch_gpu_time`.
+uint64_t pl_dispatch_mark(const struct pl_dispatch *dp);
+
+// Estimates the total GPU execution time (in nanoseconds) of all passes
+// dispatched after `start` and up to (including) `end`, which are markers
+// returned by `pl_dispatch_mark`. This is based on the most recent completed
+// measurement of each pass. Passes dispatched multiple times are only counted
+// once, as part of the range containing their last use; and passes without
+// any measurement yet are skipped. Returns 0 if no measurements are
+// available, e.g. because timing is disabled.
+uint64_t pl_dispatch_gpu_time(struct pl_dispatch *dp, uint64_t start,
+                              uint64_t end);
@@ -30,6 +30,7 @@
 #include <math.h>
 
 #include "common.h"
+#include "dither.h"
 
 void pl_generate_bayer_matrix(float *data, int size)
 {
@@ -66,7 +67,7 @@ struct ctx {
     unsigned int gauss_radius;
     unsigned int gauss_middle;
     uint64_t gauss[MAX_SIZE2];
-    index_t randomat[MAX_SIZE2];
+    uint64_t prng;
     bool calcmat[MAX_SIZE2];
     uint64_t gaussmat[MAX_SIZE2];
     index_t unimat[MAX_SIZE2];
@@ -116,58 +117,431 @@ static void makegauss(struct ctx *k, unsigned int sizeb)
     }
 }
 
-static void setbit(struct ctx *k, index_t c)
+// Fixed-seed PRNG (splitmix64), so the resulting matrices are deterministic
+static uint64_t prng(struct ctx *k)
 {
-    if (k->calcmat[c])
-        return;
-    k->calcmat[c] = true;
-    uint64_t *m = k->gaussmat;
-    uint64_t *me = k->gaussmat + k->size2;
-    uint64_t *g = k->gauss + WRAP_SIZE2(k, k->gauss_middle + k->size2 - c);
-    uint64_t *ge = k->gauss + k->size2;
-    while (g < ge)
-        *m++ += *g++;
-    g = k->gauss;
-    while (m < me)
-        *m++ += *g++;
+    uint64_t z = (k->prng += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
 }
 
-static index_t getmin(struct ctx *k)
+struct minpos {
+    uint64_t min;
+    index_t pos;
+    unsigned int ties;
+};
+
+// Adds `num` gaussian weights to the energy matrix starting at `start`, while
+// keeping track of the (randomly chosen, on ties) unset position with the
+// lowest total energy
+static inline void accumulate(struct ctx *k, struct minpos *mp, index_t start,
+                              const uint64_t *g, index_t num)
 {
-    uint64_t min = UINT64_MAX;
-    index_t resnum = 0;
-    unsigned int size2 = k->size2;
-    for (index_t c = 0; c < size2; c++) {
-        if (k->calcmat[c])
+    uint64_t *m = k->gaussmat + start;
+    const bool *set = k->calcmat + start;
+    for (index_t i = 0; i < num; i++) {
+        uint64_t total = m[i] += g[i];
+        if (total > mp->min || set[i])
             continue;
-        uint64_t total = k->gaussmat[c];
-        if (total <= min) {
-            if (total != min) {
-                min = total;
-                resnum = 0;
-            }
-            k->randomat[resnum++] = c;
+
+        if (total < mp->min) {
+            mp->min = total;
+            mp->pos = start + i;
+            mp->ties = 1;
+        } else if (prng(k) % ++mp->ties == 0) {
+            mp->pos = start + i;
         }
     }
-    assert(resnum > 0);
-    if (resnum == 1)
-        return k->randomat[0];
-    if (resnum == size2)
-        return size2 / 2;
-    return k->randomat[rand() % resnum];
+}
+
+// Adds the gaussian centered at `c` to the energy matrix, and returns the
+// unset position with the lowest total energy afterwards. This is done in a
+// single pass over the matrix, rather than updating and then scanning it.
+// Returns `size2` if no unset positions are left.
+static index_t setbit_getmin(struct ctx *k, index_t c)
+{
+    k->calcmat[c] = true;
+    const index_t off = WRAP_SIZE2(k, k->gauss_middle + k->size2 - c);
+    const index_t split = k->size2 - off;
+
+    struct minpos mp = { .min = UINT64_MAX, .pos = k->size2 };
+    accumulate(k, &mp, 0, k->gauss + off, split);
+    accumulate(k, &mp, split, k->gauss, off);
+    return mp.pos;
 }
 
 static void makeuniform(struct ctx *k)
 {
-    unsigned int size2 = k->size2;
-    for (index_t c = 0; c < size2; c++) {
-        index_t r = getmin(k);
-        setbit(k, r);
+    // The first position is arbitrary, since the energy matrix is still empty
+    index_t r = k->size2 / 2;
+    for (index_t c = 0; c < k->size2; c++) {
         k->unimat[r] = c;
+        r = setbit_getmin(k, r);
     }
 }
 
+// Precomputed result of `makeuniform` for size 64, which is the default size
+// used by `pl_shader_dither`. This must be regenerated whenever the algorithm
+// above changes (checked by the dither test).
+static const uint16_t blue_noise_64[64 * 64] = {
+    3902, 2179,  733, 2663,  970, 2775, 2206,  521, 3463, 2079, 1066, 3758,
+    1644, 2155, 3217, 1898,  531, 2379,  239, 3521, 1356, 3949, 1639, 3409,
+     737, 1729, 3010, 1469,  595, 3784, 1607, 2059, 3064, 1281, 3202, 1052,
+    2889,   32, 2695,  681, 3118,  226, 2456, 3897,  321, 2600,  932, 2101,
+    3632, 1171,  228, 3707, 1844, 2158,  155, 2294,  598, 2042, 3431, 1402,
+    3737,  987, 3545,  893, 2688, 1252, 3223, 1684, 3542,   30, 3925, 1865,
+     914, 3178, 2507,  638, 2869,  413, 1271, 3637, 2771, 1611, 2962, 1062,
+    2635,  512, 2330, 1226, 2914, 2124, 1028, 3472, 2242, 1304, 2882,  931,
+    2392, 1857,  722, 3956, 1603, 3506, 1174, 2228, 1397, 3662,  924, 2052,
+    3334, 1323, 3512,    2, 1634, 3214, 1949, 2617, 1000, 3520, 1535, 3853,
+    3056, 1286,   28, 2932, 1951, 2347,  174, 3171,  479, 3633,  257, 2425,
+    1399, 2951, 1085, 2570, 3673,  402, 1390, 3482, 1516, 4010, 2232,  147,
+    1007, 3347,  605, 3794, 2016, 3296,  885, 3701,  207, 4006,  490, 2462,
+     176, 3284,  468, 4061,   95, 3642, 2753,  334, 2512,  856, 2943, 4046,
+     466, 1914, 2934, 1454,  539, 2789,  820, 3096, 2455,  702, 3944,  378,
+    3263,  720, 2797,  362, 1774, 2559, 3953, 1118,  596, 3873, 1735, 2485,
+    1442, 2282, 1027, 4071,  585, 2121, 3414,  267, 1668, 2997, 2306,   68,
+    2599, 1044, 3015, 1845, 3916, 1406, 2540, 1712,   45, 1426, 2740, 1752,
+    2554, 1398, 3073, 1619, 3736, 1172, 2532, 1742, 3029,  825, 2169, 1305,
+    3343, 2095,  254, 1820, 2619, 3378,  101, 3811, 2323, 1588, 3967, 1996,
+    1233, 2820, 1562, 2351, 1350, 3006, 2218, 1089, 3209,  781, 2254, 1818,
+    3043, 1312, 3299,  941, 3805, 1813, 2801, 1334, 3290, 1780,  799, 2397,
+    4017,  658, 1970, 3722,  829, 3244,  445, 2486,  710, 3128,  339, 3585,
+    2238, 4034,  422, 3527,  665, 3424, 1114, 2681,  707, 1958, 3130, 1008,
+    2303, 1501, 3184, 1910,  545, 3834, 1540, 3537,  612, 1297, 2193, 1115,
+    3182,  262, 2227,  477, 3763,  177, 3534,  622, 3370,   80, 1918, 3747,
+    1478, 3531,  447, 3360,  269, 2601,  536, 2911,   65, 3393,  517, 3051,
+     160, 2621, 3572, 1575,  965, 3149, 1251, 2736, 1720, 2131, 3817, 1225,
+    3492, 2180, 1095, 2655,  696, 1941, 3036, 1311, 2350, 2050,   81, 3904,
+    2178, 3455,  247, 3813,  520, 3497,  158, 3739, 2431, 1112, 2731,  985,
+    2402, 3674, 2835,  715, 1824, 3625, 2857, 1037, 1850, 3113, 1147, 2581,
+    1709, 3979,  753, 2715,  199, 1966, 2827, 1230, 3704, 1931, 4020, 1155,
+    2256,  887, 2517, 1723, 3712, 1268,  443, 2930, 2084,  178, 3844,  527,
+    3363,  276, 1559, 2871,  102, 1737, 2985, 1375, 3185,  979, 2510,  252,
+    3798,  958, 3205, 1710,  505, 1342, 2828, 1686, 2495, 1232, 2666,  925,
+    1749, 3085,   60, 3308, 1701,  351, 1429, 4028, 2526,  582, 1346, 3469,
+    2624,  559, 1987, 3684,  945, 2157, 3143, 1018, 2381, 4080,  969, 2477,
+    1543,  815, 2383, 1705, 3489, 1475, 3968,  972, 2311, 1950, 3931, 1121,
+    3429, 2646, 1379, 2430, 1144, 2679, 3643,  912, 2058, 3952,  564, 3623,
+     165, 3891, 1706, 3333, 1522, 2879,  607, 2632, 3589, 2370,  953, 3289,
+     736, 4031, 1947, 2983,  437, 3970, 2268,  746, 3874, 2009, 3219,  145,
+    1561, 3102, 2154,   66, 1444, 4063, 2320,  218, 2926,  457, 1637, 3586,
+    1438,  557, 3197,   89, 2886, 3583,  238, 2798,  470, 2933,  216, 3154,
+     644, 2840,   79, 2491,  726, 1869, 3539,  804, 4076, 2010,  504, 2390,
+    3105,  988, 2733, 1544, 2413, 2074,  628, 2766,  389, 1896, 4079, 1425,
+     289, 1822, 3923,   10, 2939, 1552,  302, 3446, 2111,  840, 1843, 2890,
+    1200, 2649,  915, 2348, 3498,  983, 3888, 1878, 3018,  862, 1608, 3427,
+    1391, 3898, 2442,  310, 2936, 1833, 2177, 3840,  723, 1989, 3265,  992,
+    3756, 1804, 2168, 1213, 3652, 1596, 3346, 1291, 3772,  358, 2165, 3160,
+      17, 1431, 3437, 1626,  235, 3366, 1895,  370, 3281, 1168, 3496, 1327,
+    2233, 3411, 1071, 2136, 3190, 2577,  810, 2289, 1162, 3647, 2426, 1061,
+    2752, 1507, 3274,  259, 3532,  501, 3787, 1933,  416, 2584,  676, 2717,
+     373, 3605, 2492,  636, 2767, 1057, 1873, 3301, 1189, 3734,  868, 1589,
+    2711, 1206, 2286, 1627, 2498,  906, 3863, 2604,  396, 2373,  778, 2873,
+    1651, 3079,  997, 1773, 2270, 2945,  635, 2545, 3746, 1285, 2295, 4053,
+     845, 2582,   33, 3864,  747, 2518,  132, 3695,  652, 1383, 3435, 1760,
+    2739,  493, 1721, 3896,  109, 3621, 1283, 2514, 2086, 1599, 2777, 1125,
+    3068, 1807, 3650, 1045, 3248, 2063, 1235, 3129, 2025,   23, 3783,  760,
+    2699,  167, 2433, 3481,  291, 4005,  551, 3536,    7, 3312,  597, 1679,
+    3515, 1370, 3983, 2212,  236, 2414, 3885,  478, 3476, 1205, 3966, 2027,
+     878, 2999,  687, 1690, 3063, 1448, 2931, 1728, 3165, 1367, 3035, 1800,
+    2805, 3818,  347, 3031,  944, 3175, 2144,  758, 3134, 2015,  524, 4092,
+     697, 3110,   21, 2269, 4014,  229, 1384, 2428, 1698,  151, 3948,  465,
+    3543, 1332, 2893, 2128, 1525, 3107, 1920, 1116, 3181, 1757, 2921, 1449,
+    2779, 1240, 2030, 2981,  149, 3200,  550, 1158, 3575, 1335, 1956, 2625,
+     957, 2831,  284, 1532, 2694,   94, 3461, 2423,  290, 3721,  991, 2307,
+     357, 3626, 1021,  463, 2067, 1193, 2365, 1581, 4009,  185, 3500, 1459,
+    2466, 1023, 2979, 1815, 3374, 1043, 3616,  785, 1511, 2845, 3385,  566,
+    3766, 2916,  946, 2368, 1688, 2546,  388, 3576,  618, 3958,  419, 2762,
+     662, 2357, 1019, 3849,  489, 2422, 4091,  967, 2732, 1744, 2114, 3106,
+    1825,  593, 3276,  159, 3774, 1707, 2216, 3349, 1122, 3867, 2046, 1040,
+    3316, 1861,  525, 4013, 2821, 1553, 2215, 3973, 2696,   96, 3203,  698,
+    1917, 2669, 1074, 2851,  369, 3729, 2273,  162, 1378, 2483, 1714, 2964,
+    2148, 1001, 1952, 2658, 1153, 2185, 1545, 3438,  790, 4029, 1136, 1974,
+    2578, 1422, 2102, 3682, 1338, 3454,  195, 2076, 3148, 1413,  283, 3249,
+    2284,  836, 3835,   43, 2755, 4048,  905, 3016, 2040,  670, 3687,  398,
+    3050, 1652,  469, 2876, 1306, 2698, 2202, 1228, 2007,  203, 3319,  629,
+    1630, 3507, 1322, 3750, 2411,  553, 3825, 1982, 3322,  847, 1571, 3906,
+    2725,  446, 3836,  268, 3468,  495, 3815,   78, 3504,  630, 2772,  227,
+    2984, 2115, 3251,  135, 3410,  745, 3012,   62, 2014, 2606, 1585, 3590,
+     617, 1992, 3728, 1635,  434, 3467, 1489, 2505, 1108, 2183, 1683, 2453,
+    1133, 3179, 1313, 2770,  939, 2265, 3517,  779, 3922,  108, 3584,  648,
+    3443, 2587, 1180, 3092, 2331,  861, 2861,  281, 1435, 2961, 1653,   40,
+    1262, 2140, 3241,  717, 1955, 3145, 1185, 2386, 1432, 2785, 1665, 2407,
+    1345, 3166, 1782, 3857, 1408,  503, 1708, 2848, 1224, 3830, 2245, 1149,
+    4054,  809, 2860, 1101, 2478, 3028,  999, 2703, 2164, 1242, 3009,  685,
+    3354,  288, 3516,  508, 3938,   71, 2490, 1926, 4042,  210, 2571, 1747,
+    2133, 3124, 1389, 2942, 1649,  818, 3854, 1940,  354, 3646, 1781, 2130,
+    3362,  995, 3600, 2090, 4016, 2583,  278, 2915,  948, 2159, 3416,  599,
+    3964, 1064, 3305,  693, 4074,  380, 2343, 1055, 2683, 2011, 3768,  943,
+    2437, 1647,  471, 3104, 1796, 3302,  372, 3781, 1726,   76, 3478,  679,
+    3890,  169, 1876, 3705, 1368, 2580, 1526, 2917, 2249, 1663, 3611,  486,
+    1512, 3271,  875, 3755,  412, 1058, 2550,  366, 3726, 2377,   39, 2888,
+    1455, 2708, 1070, 4069,  741, 2718,  399, 3005,  621, 1420, 3456, 1655,
+    3796,   90, 1563, 2887, 1889,  164, 2109, 2671, 1524, 2970,  822, 3698,
+      47, 3310,  678, 3084,  212, 2748, 3645, 1467,  279, 2374, 1969,  773,
+    3245, 2328, 1318, 2898, 1560, 3311, 2258,  400, 2839,  928, 3855,  754,
+    1245, 3055,  955, 3372, 2222, 1201, 2813, 1565, 3350, 1872, 4089, 2187,
+     899, 1763, 3213, 1020, 3920,  567, 2484,  120, 3099, 2250, 1802, 1186,
+    3541, 2012,  817, 2742, 1139, 2461, 3653,  977, 2573, 3553, 1237, 3671,
+     245, 2070, 3400, 1598, 2810, 1210, 2363, 1352, 3940, 1944,  688, 2552,
+    3518,  952, 3947, 2662, 1223,  554, 4039, 2066,  356, 2641,  869, 3982,
+    1654, 3256,  122, 2119, 3693,  341, 1882, 2551,  703, 3082,    4, 2451,
+     691, 2909,  144, 1504, 2808, 3525,  708, 2235, 1687, 3341, 1243, 3579,
+    1554,  866, 3851, 2656,  136, 2523, 3912,  330, 3193, 1789,  569, 3065,
+     377, 2244,  728, 1832, 3094, 1005, 2508,  429, 1839, 4043,  308, 3356,
+    2161, 1098, 3282, 1241, 2097, 2878,  133, 1555, 3676, 1922, 2502,  930,
+    3649, 1182, 3061, 2023,  586, 2444, 1809, 2795, 1373, 2191, 4004,  194,
+    3511, 1834, 3959, 1269, 3599, 1120, 2327, 3260, 1256,  297, 2596, 3680,
+     190, 2113, 2918,  487, 2019, 3318,  328, 2080, 3231, 1128, 1814, 2225,
+     749, 4062, 2291, 1520, 3324, 1414, 4003, 2589,  548, 3910, 1344, 3533,
+    2952,  919, 2623, 1764,  568, 3004,   16, 3771,  541, 1440, 3089, 2200,
+     438, 3204,  209, 3401, 1856, 2539,   19, 3457, 1250, 3745, 1030, 3535,
+     475, 3123, 1060, 2687, 1527,  903, 2174, 3198,  385, 1968, 3848,  515,
+    2120, 3998, 1830, 1329, 3146,  786, 1615, 3957, 2465, 1267, 2865, 1530,
+     562, 3675,  897, 3394, 2616, 1261,  208, 3740,  792, 2841,    6, 1568,
+    3283, 2006,  154, 2195,  655, 2110, 3569, 1034, 3860, 2318, 1541, 2597,
+    1884, 3887, 1010, 3551, 1816, 1159, 2776, 1602,  645, 3843, 1433, 2375,
+    1963,  272, 3083,  816, 2558, 1670, 3458,  774, 3793, 2963,  500, 1633,
+    2421, 3030,  888, 1779, 3375,  838, 3013,  455, 2274, 3753, 2761, 1084,
+      12, 3524,  735, 4040, 2276, 1932, 2901,   44, 1601, 3503, 2712, 1759,
+    2418, 1308, 3430, 2339,  871, 2906, 1483, 2704, 3827, 1549,  117, 3121,
+    1924,  364, 3557,  769, 3239,  295, 2757,  744, 2548, 4000,  572, 3047,
+    2184, 1016, 3262,  518, 4077, 2670, 1294, 2231, 3881,   50, 2056, 2410,
+     271, 1928, 2630, 3900,  168, 1417, 3689, 2223,   64, 2543, 1051, 3560,
+    1880, 1199,  382, 2091, 3066, 1855, 2553, 1161, 3097,  383, 1387, 3869,
+    2160,  499, 1029, 3242,  322, 3865,  590, 1897, 3808,  359, 3604, 1056,
+     456, 3277, 2520,  793, 2850, 1086, 2209, 2947, 1382, 2364, 1716, 3303,
+      51, 1978, 1376, 3691,  172, 2705, 1636, 2927,  976, 1765, 3603,  435,
+    1498, 2903, 1175, 3285, 1458, 3564,  656, 1320, 3418, 2579,  571, 2824,
+    1482, 3822, 1718, 2800,  128, 3291, 2405, 3880, 1385,  549, 3779,  157,
+    1754, 3578, 2476,  637, 3040, 1890, 3974, 1386, 2986, 1984, 1141, 3071,
+    1288, 2443, 1662, 2958, 1852, 2229, 1209, 3927, 1499, 3713, 1731,  142,
+    4086, 1106, 3620,  940, 2285, 3510, 2627,  794, 2299, 3932,  348, 2069,
+    3313,  121, 2488, 1887, 3199,  669, 4041,  423, 2782, 1014, 3136, 2106,
+     795, 2001, 3250,  989, 3087,  404, 2356,  767, 4045, 1983, 1321,  802,
+    3399, 2234, 1491, 3252, 2639,  876, 2035, 3300, 1190, 2530,  116, 2677,
+     808, 2288, 3396,  189, 2764,  709, 3259,   55, 4023,  674, 3412,  225,
+    2406,  546, 3293, 2048,  716, 2700,  441, 2884, 1642,  379, 1148, 3404,
+    1819, 1093, 3475,  891, 2257, 3800,  917, 3445, 1067, 2591, 1621, 2329,
+    1894, 3752,   84, 2533, 4065, 1361,  255, 3735, 2146, 1315, 3169, 1600,
+    2515,  482, 3216, 2592,  249, 2905,  727, 2141,  473, 3991, 1317,  217,
+    3792,  949, 3466, 1704, 3688,  451, 1529, 4082, 1758, 3724, 1130, 2335,
+    1404, 2651, 1957, 3025, 1276, 2816,  980, 2566, 3479, 1347, 3809, 1208,
+    3109, 3914, 2137, 2829,  454, 3023, 1481, 2791,  560, 1587, 2925,  319,
+    1994, 3672,  184, 3338,  604, 1418, 2982, 1583,  464, 3342, 2614, 1883,
+     601, 3960,  188, 3436,  895, 3664, 1798, 1073, 3587, 1616, 3725, 1192,
+    3367, 1579, 2971, 2262, 1656, 2877,  713, 2354, 1123, 3138, 2567,  886,
+    2376,  439, 1990, 3548,  381, 3686, 1046,  497, 3371, 1591, 3841,  355,
+    1899, 2319,  113, 2481,  732, 1937,  153, 1360, 3795, 1991,   46, 3999,
+    1912, 2673, 1198, 3936, 2287,  846, 2852, 1246, 3859, 2083,  880, 3598,
+    2211, 1794, 1015, 3019, 1546, 2720, 2259, 1163, 2899, 2170,   49, 3126,
+    2000,  365, 2773, 2325,   85, 2665,  682, 3639,  440, 2026, 3258,  314,
+    3884, 2060,   87, 3007, 1258, 3212, 2607,  872, 2891, 1576, 2204, 3984,
+    1864,   41, 2190, 3116,  759, 2990, 1685, 3235, 1515, 2710, 3591, 2313,
+     839, 3344, 2471,  937, 3268,  204, 3095,  647, 1411, 3264, 1695, 2509,
+     315, 3093, 2399,  221, 2786,  675, 3892,   26, 3609,  841, 1827, 3810,
+     436, 1471, 3909, 2304,  994, 4059,  898, 1828, 3765, 1092, 3125, 1801,
+    1219, 4033, 1365, 2809, 1629,  971, 3635, 1734, 3939,  220, 1461, 3368,
+    1893,  152, 3141,  837, 2501, 3641,  908, 1719, 4025, 1024, 3613,  408,
+    3969,  623, 1124, 3139, 1787,  519, 1551, 3602, 1303, 2345, 1645, 3460,
+    2463,   14, 3995,  724, 3488,  964, 1853, 3975, 1341, 3390, 1979, 2436,
+    1395, 3320,  294, 2790, 1965, 3072, 1278,  577, 2975, 2117, 3174,  449,
+    2562, 1972,  304, 3403, 2685,   29, 2396,  796, 3530, 2496,  514, 2654,
+     772, 2260, 3776,  556, 2353, 3868, 1165, 2758,  406, 1473, 3287, 2590,
+     205, 2746, 2150, 1302, 2283, 3008, 2003,  287, 4047, 2073, 2998,  312,
+    2754,  780, 3767,  417, 1788, 3022, 1183, 1977, 2729, 1436, 3255,  765,
+    2995,  361, 1088, 3078,  532, 2108, 2536, 1065, 3683,  764, 2503, 3513,
+    1658,  173, 1456, 3540, 1272, 3941, 2438,  966, 2085, 3730, 1042, 2977,
+     266, 1823, 3386, 1428, 3499, 1048, 1689, 2949, 1354,  719, 3340, 1677,
+    3042, 2230,  561, 1363, 3453, 1849,  594, 3526,    0, 1423, 3415, 2398,
+    1284, 2613,  909, 3908, 1953, 3196, 1381, 2127, 2721,  951, 3634, 2280,
+     467, 3788,  100, 2675, 1674, 2203, 3839, 1566, 3574,  933, 4084, 1741,
+     118, 3407, 1783,  340, 2647, 3775, 2049,  942, 3011,  725, 1606, 3568,
+     660, 1711, 3292, 1405, 3980, 2153, 1091, 2908,  344, 3101, 2487,   15,
+    3629, 2569, 2077,  260, 3696,  986, 3937, 2403,  853, 2960, 1453, 2802,
+    1879, 3820,  534,  998, 3227,  106, 3384, 1727,  547, 2538,  125, 4093,
+     712, 3295,  273, 1531, 3173, 1725, 2346, 1239, 3699,  870, 2480,  140,
+    1885, 2913,  391, 3201, 2628, 1099, 2264, 3993, 1221,  798, 3323, 2686,
+     119, 2296, 3208,  232, 2938, 2563,  410, 2341,  730, 2826,  107, 1778,
+    3797, 2038,  800, 3215, 1810,  494, 4068, 1236, 1995, 2644,   92, 1904,
+    3668,  318, 3882,  788, 2469, 1096, 2657, 3669, 1624, 2892, 1191, 2336,
+    3751, 1151, 3417, 1660, 2883, 1264, 2395, 3919,  791, 2922,  956, 3144,
+     325, 3266, 1326, 2765, 3423, 1109, 2359,  782, 1948, 3288,  663, 1523,
+    3037, 2309,  511, 1577, 3862, 1915, 1314, 4095, 1964, 1167, 3814, 1605,
+    3487, 1287, 3697, 2446,  579, 1274, 3950, 2219,  961, 3024, 1488, 2812,
+     606, 3547, 1574, 3210, 1077, 2261, 1669, 3074,  253, 3306, 2024,  371,
+    2224,  750, 3580,  346, 1580, 2957,  627, 2199,  442, 3565, 1993, 1082,
+    2637,  230, 4057, 1962, 2706,  721, 3988, 2093,  651, 1772, 3757, 1463,
+    3929,  277, 2781, 3608,    3, 1791, 3529, 2528,  867, 3062,  485, 2404,
+     700, 3117,  138, 2643,  526, 3069, 1976,  918, 3272, 2668, 1548,  332,
+    3395, 1923,  127, 3309, 2105, 1196, 2885,  491, 2572, 3359,  947, 2142,
+    4078, 1339,  814, 2796, 3915, 1380, 2602, 1919, 3352,  923, 2435, 3886,
+    1465, 2535,   75, 3218, 1891, 3477,  641, 1359, 2221, 3026, 1188,  292,
+    3614, 2609,   69, 2974, 1254, 2419, 1998,  813, 2489, 3180, 1295,  345,
+    3631, 1132, 2763, 1497, 3434, 2239, 1743, 3325, 1143, 2182,  353, 4051,
+    1866,  143, 3581, 2475, 1169, 3748, 2372,  874, 3838,  275, 2192, 4019,
+    1466,  139, 3610,  642, 1761, 2527, 3711, 1848,  187, 3232,  614, 4024,
+      35, 2716, 1838,  243, 3278,  907, 3694,  705, 1340, 2380, 1795, 3187,
+      38, 1595, 3326, 1847, 2271,  858, 3452, 1863,  498, 3522, 1026, 3850,
+    1648,  904, 4018, 2237, 1835, 3275,   53, 3789, 1047,  335, 3996,  752,
+    2504, 3651, 1409, 2806, 1117, 3080, 1997,  714, 2794,  516, 1622, 2678,
+    1424, 2989, 1784,  619, 3041, 2029, 1234, 2818, 3237,   58, 1134, 3034,
+    1570, 2099, 2427,  996, 3054, 1111, 3157, 1349, 2112, 2645, 1586, 2859,
+    3826,  409, 3406,  848, 3807, 2458,  461, 3883, 1388, 3112, 1131, 2197,
+    2825, 1494, 3158,  386, 2944, 2129,  214, 2836,  686, 1393, 2576, 1696,
+    2902, 2135, 1257, 3048, 1945,   37, 3402,  666, 2333,  405, 3907, 1301,
+    3483, 1973, 3997,  336, 3379, 1003, 3770, 2454, 1038, 3731, 2544,  426,
+    1495, 3561, 2394,  711, 3413,  394, 3624, 1450, 2044, 3846,  510, 3595,
+     664, 4036,  285, 1981, 1013, 2598, 1247, 2819, 1911, 1035, 2875,  734,
+    2741,  215, 3972,  667, 3678,  124, 1927, 2575,  704, 3733, 1564, 3449,
+    2020, 3942,  427, 3353,  771, 3708, 1841,  458, 3901, 1542, 2564, 1748,
+    3151, 1468, 2652, 1817,   67, 3108, 1100, 2853,  742, 2342,   34, 1666,
+    3314,  282, 1739, 3933, 2173,  580, 1954, 4007, 1218, 2634,  789, 2920,
+     293, 2308, 1517, 2778, 1930,  982, 3132, 2312, 3528,  146, 3971, 2194,
+     363, 3718, 2107, 3439, 1231, 2474, 1613, 2648, 1220, 2367, 4049, 1079,
+    3076, 1279, 2542,  496, 1166, 2959, 2253,  974, 2521,  131, 2844, 2316,
+    1078, 3225,  317, 3847,  910, 3660,  761, 3243, 2207,  677, 2547, 1877,
+    3471, 1142, 3594, 2642,  901, 2297, 3127,  978, 2910, 1277, 2759,  264,
+    3000, 1617, 3785, 1769, 3493,  877, 3267,  114, 2450, 3428, 1691,  591,
+    1371, 3088, 1751,  690, 3001, 1502,  111, 1693, 3156,  892, 3577,  395,
+    3369, 1702,  333, 3425, 1842,   77, 3238, 2094, 3657,  179, 1594, 3833,
+    1217, 3419, 1374, 3573,  589, 2246, 1280, 2760, 2081,  166, 2519, 1080,
+    3945, 1441, 3638,  219, 1472, 2907, 2054,  393, 3963, 1578,  634, 3502,
+     175, 3790, 1671, 3253,  884, 2337,  103, 2497, 1203, 2862, 1740, 3911,
+    1307,  414, 2724, 3889, 2064,  801, 2499, 3667, 1202, 3470, 2002, 4075,
+     450, 2226, 1892, 2950,  833, 2854, 2116,  763, 2769, 3782, 1496,  632,
+    2608, 1860, 2832,  552, 3038, 2162,  342, 1766, 2941, 3706, 1859,  610,
+    3298, 1618, 3556, 1909,  305, 2928,  854, 2358, 4090,  528, 1628, 3247,
+    1227, 2968, 1942, 2344, 1447, 2524,  609, 2149, 3895, 1357, 3391,  739,
+    4072,  324, 2568,  624, 2143, 3567, 1479,    8, 2638, 3345, 1446,  242,
+    2784,  775, 2452, 1157, 2622, 3754,   27, 1506, 3926, 1164, 3714, 1452,
+    2240,  963, 2447, 3501, 1006, 4070, 1270, 3462, 1925,  828, 4011, 2482,
+    1146,  104, 2176, 4066, 1004, 2946,  506, 2252, 3447, 1593, 2098, 3172,
+     968, 2210, 3709,  844, 2727,   99, 3837,  452, 3387, 1012, 3563, 1871,
+     421, 2653, 1036, 3017, 1960, 1292, 3331, 1623, 3070, 1002, 2369, 3723,
+    1176,  474, 4032, 2163, 1672, 3176,  331, 2987,  657, 1394, 3122, 2281,
+     538, 2702,  163, 3304,  480, 3977,  250, 1692, 3194,  392, 2332,   18,
+    2680, 1556, 2881,  731, 3332, 1513, 2817,  352, 2674, 1293, 3852,  934,
+    2565,  587, 3802,  105, 1799, 3057,  251, 2393, 1392, 3189, 1135, 2585,
+    1612, 2940,   13, 2823, 1474, 3702, 2220,  453, 3630, 2382,  863, 3700,
+     224, 2788,  659, 1661, 2955, 1867, 2400,  950, 3601, 1053, 3831, 1811,
+    3328, 2039,  913, 3619, 1746, 2156, 3067, 1638, 2615, 1358, 2994, 2062,
+     803, 2751, 1730, 3812, 1184, 3588,  246, 1903, 2293, 3764,  832, 3491,
+    1750, 2391,    5, 3161, 1316, 2870, 1150, 2018, 3465, 1212, 2667, 1673,
+    4012,  776, 2104, 3666,  683, 2037, 4055,  859, 3297,  231, 1846, 2868,
+    1434,   48, 2744, 2089, 1355, 3992, 1959, 3441,  201, 3261,  639, 2874,
+      72, 2684, 2198, 1275,  181, 3965, 2799,  323, 3279, 1054,  603, 3659,
+    1127, 3473,  578, 2366, 3749, 1059, 3021,  484, 3188,  865, 2217, 3924,
+     448, 1260, 3032, 2068,  689, 3715, 1558, 2033, 4021,  286, 3380, 2707,
+     425, 3870,  694, 3317,  326, 1862, 3052,  186, 3221, 1113, 2310, 1736,
+    2472, 1194, 3976,  615, 3474, 1881, 3921,  573, 3254,  403, 2340,  883,
+    2594, 1572, 3879, 1290, 3337, 1597,  540, 3514, 2324,  701, 1609, 2417,
+    1343, 4064, 1929, 2378,   42, 1886, 3163, 1427,  134, 3335, 1366, 2493,
+    2055, 1650, 2969, 1126, 3211, 1808, 2473,  202, 3230, 1094, 2991,  751,
+    2439, 1632, 2243,  916, 1753, 2167, 2956, 1110, 2531, 3743, 1238, 2387,
+    1682, 3780,  299, 3494,  654, 3164, 1528, 2556,  962, 3114, 1103, 1777,
+    2620, 1493, 3538, 1216, 3769,  428, 1905, 2506,  889, 3987, 1988, 2866,
+     936, 3240, 2650,  864, 2966,  237, 2780,  849, 3828, 2846,  881, 3928,
+    2588, 1870,  625, 4026,  180, 3397,  563, 2689,   52, 3663,  890, 3985,
+    1640, 2692,  313, 3420, 1049, 3627,  671, 3760, 2793, 1296,   36, 3558,
+    2034,  502, 2894,  834, 2756,  959, 2612, 1259, 2834, 2045,  123, 3270,
+    2103,  349, 2298, 3636,  811, 3137,   88, 2847, 1443, 2147, 3046,  307,
+    3150, 2275,  244, 1331, 3871, 1762,   83, 3801, 2088, 3490, 1204, 3327,
+    1537,  492, 2263, 1771,  384, 3523, 2186, 1509, 2661,  975, 3829, 1445,
+    2388, 1324, 2783, 2004,  583, 2123, 3824, 1831, 2629,  115, 3045, 1986,
+     337, 4050, 2355, 1793,  911, 3234, 1534, 3954,  430, 3405, 2008, 3615,
+     476, 3903, 1821,  900, 3799, 1590, 3020,  191, 2201, 1836, 4044, 2278,
+     748, 3495, 1087, 3710,  766, 1500, 3648, 2714,  460, 2214, 3382, 1410,
+     513, 1646, 2525,  327, 2021, 2701, 3665,  960, 2830, 1102, 3060,  896,
+    3570, 1770, 2138, 3039,  673, 3388,  367, 3273, 1415, 2919, 1222,  542,
+    3294, 1584, 2389, 1076, 3142, 1514, 3307,  375, 3894, 2290,  126, 1916,
+    3086, 1407,   61, 1657, 2415, 1160, 2722, 3448,  522, 2537, 1009, 3877,
+    2774, 1069,  481, 1713, 2978,  150, 2737, 1840, 2175, 2937,  990, 2118,
+    1457, 3003, 1025, 2738, 1971, 3690,  929, 2880, 3990, 1265,  171, 3133,
+    1943, 3961,   63, 2529,  472, 3167,  270, 1152, 4088, 1921, 2321,  926,
+    3918,   86, 3191, 2301, 1299, 3994,  830, 3554, 1854,  575, 1170, 2864,
+    2092, 1253, 3656, 2633,  643, 2334, 4035, 2897,  842, 3348,  263, 2196,
+    1400, 3100, 1935,  672, 1437, 3562, 2043, 3389, 1187, 3899, 1550,  588,
+    4081,   20, 3373,  680, 3571,  206, 4027,  740, 3053,  141, 3186, 1790,
+     576, 2125, 3398, 1487,  543, 2317, 1631, 3791, 2032, 1416, 3655, 2749,
+    1536,  156, 3549, 1614, 2441, 1875,  852, 3566,  301, 1900, 2611,  213,
+    2815, 2072, 3732, 1620,  699, 2980,  935, 1592, 3546, 1031, 1902,  411,
+    3777, 1505, 2626,  993, 4085,   25, 3505, 2361, 3153,  265, 2713,  787,
+    2384,  397, 2557, 3119, 1319, 2460, 1573, 2904, 2326, 1681, 2051, 2560,
+    1364, 3823, 2100, 1129, 3552, 2494,  784, 2640, 3640, 1289, 3246, 1011,
+    2972,  823, 2248,  535, 2513, 3155,  783, 2709,  433, 3677, 2811, 1439,
+    2236, 3027,  684, 3905,  938, 3183,   98, 2593, 3832,  306, 3339, 2424,
+     222, 3120, 2697, 1369, 2213, 2996,  565, 3224, 2071, 2822, 1215,  462,
+    1694, 3962, 1325, 3703, 1610, 3286, 1975, 1017, 3442,  523, 3778, 1068,
+     360, 3717,  640, 3408,  418, 2322,  756, 2803,    9, 1412, 3893, 2031,
+     261, 2730,  613, 2434,  198, 3383, 1641, 3875, 1033, 1806, 3742, 1309,
+    3330, 1119, 2047,  602, 3744, 1145, 3315, 1336, 2338, 1460, 3432, 1063,
+    2126, 1732, 2017,  812, 3719, 2078,  608, 3440,  110, 1214, 3738, 1803,
+     757, 1484, 3816, 2013, 2965,  650, 2300,   54, 2631,  692, 3821,  234,
+    1792, 2842, 2151, 1908, 3228, 1401, 2863, 1140, 1868, 3509, 1557, 4058,
+    1858, 3090,  459, 1675, 3336, 1156, 3720, 1797, 4030, 1249, 2814,   22,
+    3058, 2279,  320, 2867, 2152,  170, 4056, 2659, 1786,   31, 1961, 2726,
+     338, 2912,  806, 2457, 3508,  600, 4002, 2676, 1486, 1097, 3913, 1717,
+    3168, 1938, 2440,  300, 3618, 2693,  200, 3233, 1154, 2660, 1775, 3426,
+    1195, 3044, 1476, 2266, 3597, 1178,  161, 3934,  770, 2408,   57, 3955,
+    2500,  274, 2988,  649, 2555, 1107, 3444, 2449,  835, 2948, 2181,  415,
+    2664,  633, 2132, 3592, 1490,  668, 3943,  894, 1539, 3222, 1678,  483,
+    3433, 2432, 3856,  879, 3544, 1851, 4087,  240, 1430, 3059, 1310,   11,
+    3269, 2362,  298, 2747,  807, 4001,  954, 2872, 1072, 1906, 2409,  827,
+    3464,  368, 3014,  851, 4038, 2122,  424, 2923,  646, 2511, 3077, 1333,
+    2719, 1724, 3170, 2061,  850, 3280, 1328, 2205, 3670,  223, 2082, 1298,
+    3786,   93, 1533, 3358, 1362, 3207, 1733,  920, 2468, 3392, 1273, 2534,
+    3612,  718, 2349, 3115, 1348,  729, 1480, 3098, 2208,  555, 1582, 3147,
+    2255,  420, 2145, 3628, 1697,  706, 3075, 1569, 2305,  407, 3103, 2057,
+    3485,  530, 3981, 1625, 2172, 3804, 1032, 2416,  197, 1699, 3364, 1353,
+    3989, 1812,  824, 3351,  401, 3661,  695, 1508, 3559, 1039, 2750,  431,
+    1464, 2682, 3930,  558, 2792, 2028, 3582,  738, 2385,  241, 3727, 2895,
+     296, 1756, 3131,   97, 1829, 2953, 1282,  248, 3685, 2139, 2837,  192,
+    1197, 3761, 2549,  855, 3866, 1755, 2858,  984, 2464, 3845, 1022, 3459,
+    1255, 3644, 1643,   56, 1351, 3192, 1177, 2900,  112, 1503, 3195, 1337,
+    2787, 3654,  797, 2728,   74, 2251, 3741, 1664, 2352, 1263, 3002, 2603,
+     148, 2272, 3878, 1874, 3365,  922, 1715, 3159, 1421,  882, 2586, 1700,
+    3861, 1173, 2036,  777, 4008, 2189, 1083, 3806, 2292,  529, 3978, 2574,
+    1604,  509, 3951, 1768, 3220, 1967,   82, 2743, 1090, 3422,  755, 3226,
+     316, 1888, 2843,  137, 2636,  631, 2467, 3858, 2833, 2188,  343, 3716,
+    2041, 2672,  444, 3917,  611, 1946, 2459, 1248, 3135, 1485,  488, 2929,
+     193, 4067,  570, 1776, 3759, 1396,  616, 2935,   70, 2412, 3519,  309,
+    2247, 4073,  182, 2973,  584, 3257, 2734, 1462, 2618,  432, 2924,  743,
+    1419, 3091, 1703,  921, 3484, 2690, 1081, 2445,  762, 3480, 1300, 3658,
+    2096,  196, 2522, 1519, 3679,  653, 2053, 4037, 1492, 3355, 1985, 1105,
+     592, 1738, 2745, 1403,  661, 3555, 1767, 2302, 1547, 3229,  311, 3842,
+     626, 3550, 2561,  981, 3206, 1538, 2171, 3361,  390, 3111, 2134, 1659,
+    4015,  768, 2022, 1207, 3049, 1785, 3321, 1330, 2314, 1907,   73, 3381,
+    1211, 3681, 1939, 3450, 2610,  303, 3377, 2087,   59, 2005, 3617,  374,
+    2954, 1521, 2401,  581, 3081, 1680, 3986, 1050, 2277, 3140, 1138, 2371,
+     821, 2992,  280, 3593, 2315, 4060,  860, 3376, 2448, 1137, 3033,    1,
+    3451,  927, 2856, 1676, 2360, 1980, 1179, 3819, 1936,  831, 2804, 1104,
+    2479,  902, 3596, 1075, 2541, 1518, 2768, 3622,  533,  973, 2470,  387,
+    3946, 1041, 3607, 2166,  620, 2420,  183, 1244, 1837, 3872,  857, 2516,
+    3236, 1470,  843, 3177, 1826,  256, 4022, 1999, 1229, 3357,  537, 2976,
+      91, 1745, 3486,  350, 3773, 1805, 1266, 2896, 1451,  129, 2967, 1913,
+     258, 3876,  826, 2691, 1377, 4094, 2075,  819, 3162,  130, 2849,  376,
+    2429, 3606,   24, 3935, 1901, 2723,  233, 3329,  507, 3762,  211, 2267,
+    1934, 3803, 1477, 3421, 1722, 2807,  805, 1667, 3152, 1510, 4083, 2855,
+     574, 2241, 2993, 1372,  544, 4052, 2735, 1181, 3692, 2605,  873, 2838,
+     329, 2595, 2065, 1567
+};
+
 void pl_generate_blue_noise(float *data, int size)
+{
+    pl_assert(size > 0);
+    if (size == 64) {
+        for (int i = 0; i < PL_ARRAY_SIZE(blue_noise_64); i++)
+            data[i] = blue_noise_64[i] / (float) (64 * 64);
+        return;
+    }
+
+    pl_compute_blue_noise(data, size);
+}
+
+void pl_compute_blue_noise(float *data, int size)
 {
     pl_assert(size > 0);
     int shift = PL_LOG2(size);
@@ -45,6 +45,7 @@ const struct pl_gpu_dummy_params pl_gpu_dummy_default_params = {
         .max_dispatch       = { UINT32_MAX, UINT32_MAX, UINT32_MAX },
         .align_tex_xfer_stride = 1,
         .align_tex_xfer_offset = 1,
+        .align_ubo_offset      = 1,
     },
 };
 
@@ -53,8 +54,39 @@ static const struct pl_gpu_fns pl_fns_dummy;
 struct priv {
     struct pl_gpu_fns impl;
     struct pl_gpu_dummy_params params;
+    struct pl_gpu_dummy_stats stats;
+    uint64_t pass_destroys; // for `pl_gpu_stats`, reset alongside `stats`
+    uint32_t bindless_next; // last texture heap slot handed out
 };
 
+// Accounts the time spent inside a backend call, see `stats.backend_ns`
+static inline uint64_t stats_begin(void)
+{
+    return pl_clock_ns();
+}
+
+static inline struct pl_gpu_dummy_stats *stats_end(const struct pl_gpu *gpu,
+                                                   uint64_t start)
+{
+    struct priv *p = TA_PRIV(gpu);
+    p->stats.backend_ns += pl_clock_ns() - start;
+    return &p->stats;
+}
+
+void pl_gpu_dummy_get_stats(const struct pl_gpu *gpu,
+                            struct pl_gpu_dummy_stats *out)
+{
+    struct priv *p = TA_PRIV(gpu);
+    *out = p->stats;
+}
+
+void pl_gpu_dummy_reset_stats(const struct pl_gpu *gpu)
+{
+    struct priv *p = TA_PRIV(gpu);
+    p->stats = (struct pl_gpu_dummy_stats) {0};
+    p->pass_destroys = 0;
+}
+
 const struct pl_gpu *pl_gpu_dummy_create(struct pl_context *ctx,
                                          const struct pl_gpu_dummy_params *params)
 {
@@ -73,6 +105,7 @@ const struct pl_gpu *pl_gpu_dummy_create(struct pl_context *ctx,
     // Forcibly override these, because we know for sure what the values are
     gpu->limits.align_tex_xfer_stride = 1;
     gpu->limits.align_tex_xfer_offset = 1;
+    gpu->limits.align_ubo_offset = 1;
 
     // Set up the dummy formats, add one for each possible format type that we
     // can represent on the host
@@ -194,17 +227,21 @@ uint8_t *pl_buf_dummy_data(const struct pl_buf *buf)
 static void dumb_buf_write(const struct pl_gpu *gpu, const struct pl_buf *buf,
                            size_t buf_offset, const void *data, size_t size)
 {
+    uint64_t start = stats_begin();
     struct buf_priv *p = TA_PRIV(buf);
     uint8_t *dst = p->data;
     memcpy(&dst[buf_offset], data, size);
+    stats_end(gpu, start)->bytes_uploaded += size;
 }
 
 static bool dumb_buf_read(const struct pl_gpu *gpu, const struct pl_buf *buf,
                           size_t buf_offset, void *dest, size_t size)
 {
+    uint64_t start = stats_begin();
     struct buf_priv *p = TA_PRIV(buf);
     const uint8_t *src = p->data;
     memcpy(dest, &src[buf_offset], size);
+    stats_end(gpu, start)->bytes_downloaded += size;
     return true;
 }
 
@@ -223,6 +260,7 @@ static size_t tex_size(const struct pl_gpu *gpu, const struct pl_tex *tex)
 static const struct pl_tex *dumb_tex_create(const struct pl_gpu *gpu,
                                             const struct pl_tex_params *params)
 {
+    uint64_t start = stats_begin();
     struct pl_tex *tex = talloc_zero_priv(NULL, struct pl_tex, void *);
     tex->params = *params;
     tex->params.initial_data = NULL;
@@ -238,6 +276,16 @@ static const struct pl_tex *dumb_tex_create(const struct pl_gpu *gpu,
     if (params->initial_data)
         memcpy(p->data, params->initial_data, tex_size(gpu, tex));
 
+    // Hand out heap slots without ever reusing them, since nothing actually
+    // gets bound to them anyway
+    struct priv *priv = TA_PRIV(gpu);
+    if ((gpu->caps & PL_GPU_CAP_BINDLESS) && params->sampleable &&
+        priv->bindless_next + 1 < gpu->limits.max_bindless_tex)
+    {
+        tex->bindless_index = ++priv->bindless_next;
+    }
+
+    stats_end(gpu, start)->tex_creates++;
     return tex;
 }
 
@@ -283,6 +331,7 @@ static void dumb_tex_clear(const struct pl_gpu *gpu, const struct pl_tex *tex,
     const struct pl_fmt *fmt = tex->params.format;
     struct tex_priv *p = TA_PRIV(tex);
     pl_assert(p->data);
+    uint64_t start = stats_begin();
 
     // Convert from float[4] to whatever internal representation we need
     union {
@@ -345,12 +394,13 @@ static void dumb_tex_clear(const struct pl_gpu *gpu, const struct pl_tex *tex,
 
     if (fast_path) {
         memset(p->data, data.bytes[0], tex_size(gpu, tex));
-        return;
+    } else {
+        uint8_t *dst = p->data;
+        for (size_t pos = 0; pos < tex_size(gpu, tex); pos += fmt->texel_size)
+            memcpy(&dst[pos], &data.bytes[0], fmt->texel_size);
     }
 
-    uint8_t *dst = p->data;
-    for (size_t pos = 0; pos < tex_size(gpu, tex); pos += fmt->texel_size)
-        memcpy(&dst[pos], &data.bytes[0], fmt->texel_size);
+    stats_end(gpu, start)->tex_clears++;
 }
 
 static bool dumb_tex_upload(const struct pl_gpu *gpu,
@@ -359,6 +409,7 @@ static bool dumb_tex_upload(const struct pl_gpu *gpu,
     const struct pl_tex *tex = params->tex;
     struct tex_priv *p = TA_PRIV(tex);
     pl_assert(p->data);
+    uint64_t start = stats_begin();
 
     const uint8_t *src = params->ptr;
     uint8_t *dst = p->data;
@@ -370,16 +421,21 @@ static bool dumb_tex_upload(const struct pl_gpu *gpu,
     size_t texel_size = tex->params.format->texel_size;
     size_t row_size = pl_rect_w(params->rc) * texel_size;
     for (int z = params->rc.z0; z < params->rc.z1; z++) {
-        size_t src_plane = z * params->stride_h * params->stride_w * texel_size;
+        size_t src_plane = (z - params->rc.z0) * params->stride_h *
+                           params->stride_w * texel_size;
         size_t dst_plane = z * tex->params.h * tex->params.w * texel_size;
         for (int y = params->rc.y0; y < params->rc.y1; y++) {
-            size_t src_row = src_plane + y * params->stride_w * texel_size;
+            size_t src_row = src_plane +
+                             (y - params->rc.y0) * params->stride_w * texel_size;
             size_t dst_row = dst_plane + y * tex->params.w * texel_size;
             size_t pos = params->rc.x0 * texel_size;
-            memcpy(&dst[dst_row + pos], &src[src_row + pos], row_size);
+            memcpy(&dst[dst_row + pos], &src[src_row], row_size);
         }
     }
 
+    struct pl_gpu_dummy_stats *stats = stats_end(gpu, start);
+    stats->tex_uploads++;
+    stats->bytes_uploaded += row_size * pl_rect_h(params->rc) * pl_rect_d(params->rc);
     return true;
 }
 
@@ -389,6 +445,7 @@ static bool dumb_tex_download(const struct pl_gpu *gpu,
     const struct pl_tex *tex = params->tex;
     struct tex_priv *p = TA_PRIV(tex);
     pl_assert(p->data);
+    uint64_t start = stats_begin();
 
     const uint8_t *src = p->data;
     uint8_t *dst = params->ptr;
@@ -401,15 +458,25 @@ static bool dumb_tex_download(const struct pl_gpu *gpu,
     size_t row_size = pl_rect_w(params->rc) * texel_size;
     for (int z = params->rc.z0; z < params->rc.z1; z++) {
         size_t src_plane = z * tex->params.h * tex->params.w * texel_size;
-        size_t dst_plane = z * params->stride_h * params->stride_w * texel_size;
+        size_t dst_plane = (z - params->rc.z0) * params->stride_h *
+                           params->stride_w * texel_size;
         for (int y = params->rc.y0; y < params->rc.y1; y++) {
             size_t src_row = src_plane + y * tex->params.w * texel_size;
-            size_t dst_row = dst_plane + y * params->stride_w * texel_size;
+            size_t dst_row = dst_plane +
+                             (y - params->rc.y0) * params->stride_w * texel_size;
             size_t pos = params->rc.x0 * texel_size;
-            memcpy(&dst[dst_row + pos], &src[src_row + pos], row_size);
+            memcpy(&dst[dst_row], &src[src_row + pos], row_size);
         }
     }
 
+    struct pl_gpu_dummy_stats *stats = stats_end(gpu, start);
+    stats->tex_downloads++;
+    stats->bytes_downloaded += row_size * pl_rect_h(params->rc) * pl_rect_d(params->rc);
+
+    // Downloads complete synchronously, so just fire the callback immediately
+    if (params->callback)
+        params->callback(params->priv);
+
     return true;
 }
 
@@ -421,19 +488,39 @@ static int dumb_desc_namespace(const struct pl_gpu *gpu, enum pl_desc_type type)
 static const struct pl_pass *dumb_pass_create(const struct pl_gpu *gpu,
                                               const struct pl_pass_params *params)
 {
-    PL_ERR(gpu, "Creating render passes is not supported for dummy GPUs");
-    return NULL;
+    struct priv *p = TA_PRIV(gpu);
+    if (!p->params.accept_passes) {
+        PL_ERR(gpu, "Creating render passes is not supported for dummy GPUs");
+        return NULL;
+    }
+
+    // The shaders are never compiled, so the pass only needs its params
+    uint64_t start = stats_begin();
+    struct pl_pass *pass = talloc_zero(NULL, struct pl_pass);
+    pass->params = pl_pass_params_copy(pass, params);
+    stats_end(gpu, start)->pass_creates++;
+    return pass;
 }
 
 static void dumb_pass_destroy(const struct pl_gpu *gpu, const struct pl_pass *pass)
 {
-    pl_assert(!"unreachable");
+    struct priv *p = TA_PRIV(gpu);
+    p->pass_destroys++;
+    talloc_free((void *) pass);
 }
 
 static void dumb_pass_run(const struct pl_gpu *gpu,
                           const struct pl_pass_run_params *params)
 {
-    pl_assert(!"unreachable");
+    // Nothing to execute, so only count what would have been submitted
+    const struct pl_pass *pass = params->pass;
+    struct priv *p = TA_PRIV(gpu);
+    struct pl_gpu_dummy_stats *stats = &p->stats;
+    stats->pass_runs++;
+    stats->desc_bindings += pass->params.num_descriptors;
+    stats->var_updates += params->num_var_updates;
+    if (pass->params.type == PL_PASS_RASTER)
+        stats->bytes_uploaded += params->vertex_count * pass->params.vertex_stride;
 }
 
 static void dumb_gpu_finish(const struct pl_gpu *gpu)
@@ -441,6 +528,23 @@ static void dumb_gpu_finish(const struct pl_gpu *gpu)
     // no-op
 }
 
+static bool dumb_gpu_stats(const struct pl_gpu *gpu, struct pl_gpu_stats *out)
+{
+    struct priv *p = TA_PRIV(gpu);
+    *out = (struct pl_gpu_stats) {
+        .passes_created = p->stats.pass_creates,
+        .passes_destroyed = p->pass_destroys,
+        .pass_runs = p->stats.pass_runs,
+        .desc_updates = p->stats.desc_bindings,
+        .var_updates = p->stats.var_updates,
+        .tex_uploads = p->stats.tex_uploads,
+        .tex_downloads = p->stats.tex_downloads,
+        .bytes_uploaded = p->stats.bytes_uploaded,
+        .bytes_downloaded = p->stats.bytes_downloaded,
+    };
+    return true;
+}
+
 static const struct pl_gpu_fns pl_fns_dummy = {
     .destroy = dumb_destroy,
     .buf_create = dumb_buf_create,
@@ -457,4 +561,5 @@ static const struct pl_gpu_fns pl_fns_dummy = {
     .pass_destroy = dumb_pass_destroy,
     .pass_run = dumb_pass_run,
     .gpu_finish = dumb_gpu_finish,
+    .gpu_stats = dumb_gpu_stats,
 };
@@ -101,7 +101,7 @@ double pl_filter_sample(const struct pl_filter_config *c, double x)
 
 // Calculate a single filter row of a 1D filter, for a given phase value /
 // subpixel offset `offset`. Writes exactly f->row_size values to *out.
-static void compute_row(struct pl_filter *f, double offset, float *out)
+static void compute_row(const struct pl_filter *f, double offset, float *out)
 {
     pl_assert(f->row_size > 0);
     double sum = 0;
@@ -126,6 +126,73 @@ static struct pl_filter_function *dupfilter(void *tactx,
     return f ? talloc_memdup(tactx, (void *)f, sizeof(*f)) : NULL;
 }
 
+// Generated filters are immutable, so identical ones can be shared between
+// all users of a context, e.g. multiple renderers, or a renderer flipping
+// back and forth between scaling ratios. Each filter is reference counted,
+// with the cache itself holding one reference to each of the (at most)
+// FILTER_CACHE_SIZE most recently requested filters. Neither the filters nor
+// the array holding them are attached to the context, since other threads may
+// concurrently be allocating on it.
+#define FILTER_CACHE_SIZE 16
+
+struct cached_filter {
+    struct pl_filter filter; // must be the first member, see `pl_filter_free`
+    struct pl_context *ctx;
+    int refs; // protected by `ctx->filter_lock`
+};
+
+static bool filter_params_eq(const struct pl_filter_params *a,
+                             const struct pl_filter_params *b)
+{
+    return pl_filter_config_eq(&a->config, &b->config) &&
+           a->lut_entries       == b->lut_entries &&
+           a->filter_scale      == b->filter_scale &&
+           a->cutoff            == b->cutoff &&
+           a->max_row_size      == b->max_row_size &&
+           a->row_stride_align  == b->row_stride_align;
+}
+
+// Must be called with `ctx->filter_lock` held
+static void filter_unref(struct cached_filter *cf)
+{
+    pl_assert(cf->refs > 0);
+    if (--cf->refs == 0)
+        talloc_free(cf);
+}
+
+static const struct pl_filter *filter_cache_get(struct pl_context *ctx,
+                                                const struct pl_filter_params *params)
+{
+    const struct pl_filter *ret = NULL;
+    pthread_mutex_lock(&ctx->filter_lock);
+    for (int i = ctx->num_filters - 1; i >= 0; i--) {
+        struct cached_filter *cf = ctx->filters[i];
+        if (filter_params_eq(&cf->filter.params, params)) {
+            // Move to the end of the list, to mark it as recently used
+            TARRAY_REMOVE_AT(ctx->filters, ctx->num_filters, i);
+            TARRAY_APPEND(NULL, ctx->filters, ctx->num_filters, cf);
+            cf->refs++;
+            ret = &cf->filter;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ctx->filter_lock);
+    return ret;
+}
+
+static void filter_cache_add(struct pl_context *ctx, struct cached_filter *cf)
+{
+    pthread_mutex_lock(&ctx->filter_lock);
+    if (ctx->num_filters == FILTER_CACHE_SIZE) {
+        filter_unref(ctx->filters[0]);
+        TARRAY_REMOVE_AT(ctx->filters, ctx->num_filters, 0);
+    }
+
+    cf->refs++;
+    TARRAY_APPEND(NULL, ctx->filters, ctx->num_filters, cf);
+    pthread_mutex_unlock(&ctx->filter_lock);
+}
+
 const struct pl_filter *pl_filter_generate(struct pl_context *ctx,
                                        const struct pl_filter_params *params)
 {
@@ -135,7 +202,17 @@ const struct pl_filter *pl_filter_generate(struct pl_context *ctx,
         return NULL;
     }
 
-    struct pl_filter *f = talloc_zero(ctx, struct pl_filter);
+    const struct pl_filter *cached = filter_cache_get(ctx, params);
+    if (cached)
+        return cached;
+
+    // Allocated without a parent, since other threads may concurrently be
+    // using the context. Freed by `pl_context_destroy` at the latest
+    struct cached_filter *cf = talloc_zero(NULL, struct cached_filter);
+    cf->ctx = ctx;
+    cf->refs = 1;
+
+    struct pl_filter *f = &cf->filter;
     f->params = *params;
     f->params.config.kernel = dupfilter(f, params->config.kernel);
     f->params.config.window = dupfilter(f, params->config.window);
@@ -169,21 +246,37 @@ const struct pl_filter *pl_filter_generate(struct pl_context *ctx,
         }
         f->row_stride = PL_ALIGN(f->row_size, params->row_stride_align);
 
-        // Compute a 2D array indexed by the subpixel position
-        weights = talloc_zero_array(f, float, params->lut_entries * f->row_stride);
-        for (int i = 0; i < params->lut_entries; i++) {
-            compute_row(f, i / (double)(params->lut_entries - 1),
-                        weights + f->row_stride * i);
+        // Compute a 2D array indexed by the subpixel position. Since all
+        // filters are symmetric, the row for offset `1 - x` is exactly the
+        // row for offset `x` in reverse, so only half of them are computed
+        int entries = params->lut_entries;
+        weights = talloc_zero_array(f, float, entries * f->row_stride);
+        for (int i = 0; i < (entries + 1) / 2; i++) {
+            float *row = weights + f->row_stride * i;
+            compute_row(f, i / (double)(entries - 1), row);
+
+            float *mirror = weights + f->row_stride * (entries - 1 - i);
+            for (int n = 0; mirror != row && n < f->row_size; n++)
+                mirror[n] = row[f->row_size - 1 - n];
         }
     }
 
     f->weights = weights;
+    filter_cache_add(ctx, cf);
     return f;
 }
 
 void pl_filter_free(const struct pl_filter **filter)
 {
-    TA_FREEP((void **) filter);
+    if (!*filter)
+        return;
+
+    struct cached_filter *cf = (struct cached_filter *) *filter;
+    struct pl_context *ctx = cf->ctx;
+    pthread_mutex_lock(&ctx->filter_lock);
+    filter_unref(cf);
+    pthread_mutex_unlock(&ctx->filter_lock);
+    *filter = NULL;
 }
 
 const struct pl_named_filter_function *pl_find_named_filter_function(const char *name)
@@ -60,12 +60,13 @@ void pl_glslang_uninit()
 }
 
 #define GLSL_VERSION EShTargetVulkan_1_0
-#define SPIRV_VERSION EShTargetSpv_1_0
 
 extern const TBuiltInResource DefaultTBuiltInResource;
 
 struct pl_glslang_res *pl_glslang_compile(const char *glsl,
-                                          enum pl_glslang_stage stage)
+                                          uint32_t api_version,
+                                          enum pl_glslang_stage stage,
+                                          enum pl_glslang_opt opt)
 {
     struct pl_glslang_res *res = talloc_zero(NULL, struct pl_glslang_res);
 
@@ -77,8 +78,13 @@ struct pl_glslang_res *pl_glslang_compile(const char *glsl,
 
     assert(pl_glslang_refcount);
     TShader *shader = new TShader(lang[stage]);
-    shader->setEnvClient(EShClientVulkan, GLSL_VERSION);
-    shader->setEnvTarget(EShTargetSpv, SPIRV_VERSION);
+    if (api_version >= EShTargetVulkan_1_1) {
+        shader->setEnvClient(EShClientVulkan, EShTargetVulkan_1_1);
+        shader->setEnvTarget(EShTargetSpv, EShTargetSpv_1_3);
+    } else {
+        shader->setEnvClient(EShClientVulkan, EShTargetVulkan_1_0);
+        shader->setEnvTarget(EShTargetSpv, EShTargetSpv_1_0);
+    }
     shader->setStrings(&glsl, 1);
     if (!shader->parse(&DefaultTBuiltInResource, GLSL_VERSION, true, EShMsgDefault)) {
         res->error_msg = talloc_strdup(res, shader->getInfoLog());
@@ -95,8 +101,12 @@ struct pl_glslang_res *pl_glslang_compile(const char *glsl,
         return res;
     }
 
+    SpvOptions spv_opts;
+    spv_opts.disableOptimizer = opt == PL_GLSLANG_OPT_NONE;
+    spv_opts.optimizeSize = opt == PL_GLSLANG_OPT_SIZE;
+
     std::vector<unsigned int> spirv;
-    GlslangToSpv(*prog->getIntermediate(lang[stage]), spirv);
+    GlslangToSpv(*prog->getIntermediate(lang[stage]), spirv, &spv_opts);
 
     res->success = true;
     res->size = spirv.size() * sizeof(unsigned int);
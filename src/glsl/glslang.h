@@ -19,6 +19,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -44,10 +45,24 @@ enum pl_glslang_stage {
     PL_GLSLANG_COMPUTE,
 };
 
+enum pl_glslang_opt {
+    PL_GLSLANG_OPT_NONE,
+    PL_GLSLANG_OPT_SIZE,
+    PL_GLSLANG_OPT_PERFORMANCE,
+};
+
 // Compile GLSL into a SPIRV stream, if possible. The resulting
 // pl_glslang_res can simply be freed with talloc_free() when done.
+//
+// `api_version` is the targeted vulkan version (as in VK_MAKE_VERSION).
+// Vulkan 1.1 is used if supported, which also selects SPIR-V 1.3.
+//
+// Optimization requires glslang to be built with SPIRV-Tools support, and
+// is silently skipped otherwise.
 struct pl_glslang_res *pl_glslang_compile(const char *glsl,
-                                          enum pl_glslang_stage stage);
+                                          uint32_t api_version,
+                                          enum pl_glslang_stage stage,
+                                          enum pl_glslang_opt opt);
 
 #ifdef __cplusplus
 }
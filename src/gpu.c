@@ -78,6 +78,11 @@ void pl_gpu_print_info(const struct pl_gpu *gpu, enum pl_log_level lev)
 
     LOG(PRIu32, align_tex_xfer_stride);
     LOG("zu", align_tex_xfer_offset);
+    LOG("zu", align_ubo_offset);
+    if (gpu->caps & PL_GPU_CAP_BINDLESS)
+        LOG(PRIu32, max_bindless_tex);
+    if (gpu->import_caps.buf & PL_HANDLE_HOST_PTR)
+        LOG("zu", align_host_ptr);
 #undef LOG
 
     if (pl_gpu_supports_interop(gpu)) {
@@ -180,6 +185,15 @@ void pl_gpu_verify_formats(struct pl_gpu *gpu)
             pl_assert(fmt->emulated);
         if (fmt->caps & (PL_FMT_CAP_STORABLE | PL_FMT_CAP_TEXEL_STORAGE))
             pl_assert(fmt->glsl_format);
+
+        if (fmt->num_planes) {
+            pl_assert(fmt->opaque);
+            pl_assert(!(fmt->caps & texel_caps));
+            for (int i = 0; i < fmt->num_planes; i++) {
+                const struct pl_fmt *pfmt = fmt->planes[i].format;
+                pl_assert(pfmt && !pfmt->opaque && !pfmt->num_planes);
+            }
+        }
     }
 }
 
@@ -338,6 +352,8 @@ const struct pl_fmt *pl_find_fmt(const struct pl_gpu *gpu, enum pl_fmt_type type
             continue;
         if ((fmt->caps & caps) != caps)
             continue;
+        if (fmt->num_planes)
+            continue;
 
         // When specifying some particular host representation, ensure the
         // format is non-opaque, ordered and unpadded
@@ -429,8 +445,8 @@ const struct pl_tex *pl_tex_create(const struct pl_gpu *gpu,
 
     const struct pl_fmt *fmt = params->format;
     require(fmt);
-    require(!params->host_readable || !fmt->opaque);
-    require(!params->host_writable || !fmt->opaque);
+    require(!params->host_readable || !fmt->opaque || fmt->num_planes);
+    require(!params->host_writable || !fmt->opaque || fmt->num_planes);
     require(!params->sampleable || fmt->caps & PL_FMT_CAP_SAMPLEABLE);
     require(!params->renderable || fmt->caps & PL_FMT_CAP_RENDERABLE);
     require(!params->storable   || fmt->caps & PL_FMT_CAP_STORABLE);
@@ -438,6 +454,27 @@ const struct pl_tex *pl_tex_create(const struct pl_gpu *gpu,
     require(!params->blit_dst   || fmt->caps & PL_FMT_CAP_BLITTABLE);
     require(params->sample_mode != PL_TEX_SAMPLE_LINEAR || fmt->caps & PL_FMT_CAP_LINEAR);
 
+    if (fmt->num_planes) {
+        require(pl_tex_params_dimension(*params) == 2);
+        require(!params->renderable && !params->storable);
+        require(!params->blit_src && !params->blit_dst);
+        for (int i = 0; i < fmt->num_planes; i++) {
+            const struct pl_fmt_plane *plane = &fmt->planes[i];
+            require(params->w % (1 << plane->shift_x) == 0);
+            require(params->h % (1 << plane->shift_y) == 0);
+        }
+    }
+
+    if (params->import_handle == PL_HANDLE_DMA_BUF && fmt->num_modifiers) {
+        const struct pl_shared_mem *shmem = &params->shared_mem;
+        bool found = false;
+        for (int i = 0; i < fmt->num_modifiers; i++)
+            found |= fmt->modifiers[i] == shmem->drm_format_mod;
+        require(found);
+        require(pl_tex_params_dimension(*params) == 2);
+        require(!shmem->pitch || shmem->pitch >= params->w * fmt->texel_size);
+    }
+
     const struct pl_gpu_fns *impl = TA_PRIV(gpu);
     return impl->tex_create(gpu, params);
 
@@ -580,6 +617,15 @@ error:
 size_t pl_tex_transfer_size(const struct pl_tex_transfer_params *par)
 {
     const struct pl_tex *tex = par->tex;
+    if (tex->num_planes) {
+        size_t size = 0;
+        for (int i = 0; i < tex->num_planes; i++) {
+            struct pl_tex_transfer_params plane = pl_tex_transfer_plane(par, i);
+            size += pl_tex_transfer_size(&plane);
+        }
+        return size;
+    }
+
     int w = pl_rect_w(par->rc), h = pl_rect_h(par->rc), d = pl_rect_d(par->rc);
 
     // This generates the absolute bare minimum size of a buffer required to
@@ -589,6 +635,42 @@ size_t pl_tex_transfer_size(const struct pl_tex_transfer_params *par)
     return texels * tex->params.format->texel_size;
 }
 
+struct pl_tex_transfer_params pl_tex_transfer_plane(const struct pl_tex_transfer_params *par,
+                                                    int idx)
+{
+    const struct pl_tex *tex = par->tex;
+    const struct pl_fmt *fmt = tex->params.format;
+    struct pl_tex_transfer_params ret;
+    size_t offset = 0;
+
+    for (int i = 0; i <= idx; i++) {
+        const struct pl_fmt_plane *plane = &fmt->planes[i];
+        int sx = plane->shift_x, sy = plane->shift_y;
+        ret = *par;
+        ret.tex = tex->planes[i];
+        ret.rc = (struct pl_rect3d) {
+            .x0 = par->rc.x0 >> sx,
+            .y0 = par->rc.y0 >> sy,
+            .z0 = par->rc.z0,
+            .x1 = PL_RSHIFT_UP(par->rc.x1, sx),
+            .y1 = PL_RSHIFT_UP(par->rc.y1, sy),
+            .z1 = par->rc.z1,
+        };
+        ret.stride_w = PL_RSHIFT_UP(par->stride_w, sx);
+        ret.stride_h = PL_RSHIFT_UP(par->stride_h, sy);
+        if (i < idx)
+            offset += pl_tex_transfer_size(&ret);
+    }
+
+    if (ret.buf) {
+        ret.buf_offset += offset;
+    } else {
+        ret.ptr = (uint8_t *) par->ptr + offset;
+    }
+
+    return ret;
+}
+
 static bool fix_tex_transfer(const struct pl_gpu *gpu,
                              struct pl_tex_transfer_params *params)
 {
@@ -639,6 +721,14 @@ static bool fix_tex_transfer(const struct pl_gpu *gpu,
         break;
     }
 
+    for (int i = 0; i < tex->num_planes; i++) {
+        const struct pl_fmt_plane *plane = &tex->params.format->planes[i];
+        int mask_x = (1 << plane->shift_x) - 1, mask_y = (1 << plane->shift_y) - 1;
+        require(!(rc.x0 & mask_x) && !(rc.x1 & mask_x));
+        require(!(rc.y0 & mask_y) && !(rc.y1 & mask_y));
+        require(!(params->stride_w & mask_x) && !(params->stride_h & mask_y));
+    }
+
     require(!params->buf ^ !params->ptr); // exactly one
     if (params->buf) {
         const struct pl_buf *buf = params->buf;
@@ -660,6 +750,7 @@ bool pl_tex_upload(const struct pl_gpu *gpu,
     const struct pl_tex *tex = params->tex;
     require(tex);
     require(tex->params.host_writable);
+    require(!params->callback);
 
     struct pl_tex_transfer_params fixed = *params;
     if (!fix_tex_transfer(gpu, &fixed))
@@ -678,6 +769,7 @@ bool pl_tex_download(const struct pl_gpu *gpu,
     const struct pl_tex *tex = params->tex;
     require(tex);
     require(tex->params.host_readable);
+    require(!params->callback || !tex->num_planes);
 
     struct pl_tex_transfer_params fixed = *params;
     if (!fix_tex_transfer(gpu, &fixed))
@@ -693,11 +785,25 @@ error:
 const struct pl_buf *pl_buf_create(const struct pl_gpu *gpu,
                                    const struct pl_buf_params *params)
 {
+    require(!params->import_handle || !params->handle_type);
     if (params->handle_type) {
         require(params->handle_type & gpu->export_caps.buf);
         require(PL_ISPOT(params->handle_type));
     }
 
+    if (params->import_handle) {
+        require(params->import_handle & gpu->import_caps.buf);
+        require(PL_ISPOT(params->import_handle));
+        const struct pl_shared_mem *shmem = &params->shared_mem;
+        require(shmem->offset + params->size <= shmem->size);
+        if (params->import_handle == PL_HANDLE_HOST_PTR) {
+            size_t align = gpu->limits.align_host_ptr;
+            require(shmem->handle.ptr);
+            require((uintptr_t) shmem->handle.ptr % align == 0);
+            require(shmem->size % align == 0);
+        }
+    }
+
     switch (params->type) {
     case PL_BUF_TEX_TRANSFER:
         require(gpu->limits.max_xfer_size);
@@ -760,6 +866,11 @@ bool pl_buf_recreate(const struct pl_gpu *gpu, const struct pl_buf **buf,
         return false;
     }
 
+    if (params->import_handle) {
+        PL_ERR(gpu, "pl_buf_recreate may not be used with `import_handle`!");
+        return false;
+    }
+
     if (*buf && pl_buf_params_superset((*buf)->params, *params))
         return true;
 
@@ -1016,6 +1127,8 @@ const struct pl_pass *pl_pass_create(const struct pl_gpu *gpu,
                                      const struct pl_pass_params *params)
 {
     require(params->glsl_shader);
+    require(params->optimize >= 0 && params->optimize < PL_SHADER_OPT_COUNT);
+    require(!params->bindless || gpu->caps & PL_GPU_CAP_BINDLESS);
     switch(params->type) {
     case PL_PASS_RASTER:
         require(params->vertex_shader);
@@ -1051,11 +1164,23 @@ const struct pl_pass *pl_pass_create(const struct pl_gpu *gpu,
         // TODO: enforce disjoint bindings if possible?
     }
 
+    require(!params->num_constants || params->constant_data);
+    for (int i = 0; i < params->num_constants; i++) {
+        require(gpu->caps & PL_GPU_CAP_SPEC_CONSTANTS);
+        struct pl_constant cons = params->constants[i];
+        require(cons.type == PL_VAR_SINT || cons.type == PL_VAR_UINT ||
+                cons.type == PL_VAR_FLOAT);
+        require(cons.offset == PL_ALIGN2(cons.offset, 4));
+    }
+
     require(params->push_constants_size <= gpu->limits.max_pushc_size);
     require(params->push_constants_size == PL_ALIGN2(params->push_constants_size, 4));
 
     const struct pl_gpu_fns *impl = TA_PRIV(gpu);
-    return impl->pass_create(gpu, params);
+    uint64_t start = pl_span_begin(gpu->ctx);
+    const struct pl_pass *pass = impl->pass_create(gpu, params);
+    pl_span_end(gpu->ctx, "pl_pass_create", start);
+    return pass;
 
 error:
     return NULL;
@@ -1080,10 +1205,12 @@ void pl_pass_run(const struct pl_gpu *gpu, const struct pl_pass_run_params *para
         struct pl_desc desc = pass->params.descriptors[i];
         struct pl_desc_binding db = params->desc_bindings[i];
         require(db.object);
+        require(!db.buf_offset || desc.type == PL_DESC_BUF_UNIFORM);
         switch (desc.type) {
         case PL_DESC_SAMPLED_TEX: {
             const struct pl_tex *tex = db.object;
             require(tex->params.sampleable);
+            require(!pass->params.bindless || tex->bindless_index);
             break;
         }
         case PL_DESC_STORAGE_IMG: {
@@ -1094,6 +1221,11 @@ void pl_pass_run(const struct pl_gpu *gpu, const struct pl_pass_run_params *para
         case PL_DESC_BUF_UNIFORM: {
             const struct pl_buf *buf = db.object;
             require(buf->params.type == PL_BUF_UNIFORM);
+            if (db.buf_offset) {
+                size_t align = gpu->limits.align_ubo_offset;
+                require(align && db.buf_offset % align == 0);
+                require(db.buf_offset < buf->params.size);
+            }
             break;
         }
         case PL_DESC_BUF_STORAGE: {
@@ -1126,7 +1258,7 @@ void pl_pass_run(const struct pl_gpu *gpu, const struct pl_pass_run_params *para
 
     switch (pass->params.type) {
     case PL_PASS_RASTER: {
-        require(params->vertex_data);
+        require(params->vertex_data || !pass->params.num_vertex_attribs);
         switch (pass->params.vertex_type) {
         case PL_PRIM_TRIANGLE_LIST:
             require(params->vertex_count % 3 == 0);
@@ -1179,6 +1311,14 @@ void pl_pass_run(const struct pl_gpu *gpu, const struct pl_pass_run_params *para
             require(params->compute_groups[i] >= 0);
             require(params->compute_groups[i] <= gpu->limits.max_dispatch[i]);
         }
+
+        const struct pl_buf *indirect = params->compute_indirect;
+        if (indirect) {
+            size_t offset = params->compute_indirect_offset;
+            require(indirect->params.type == PL_BUF_STORAGE);
+            require(offset == PL_ALIGN2(offset, 4));
+            require(offset + 3 * sizeof(uint32_t) <= indirect->params.size);
+        }
         break;
     default: abort();
     }
@@ -1193,6 +1333,41 @@ error:
     return;
 }
 
+struct pl_timer *pl_timer_create(const struct pl_gpu *gpu)
+{
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    if (!impl->timer_create)
+        return NULL;
+
+    return impl->timer_create(gpu);
+}
+
+void pl_timer_destroy(const struct pl_gpu *gpu, struct pl_timer **timer)
+{
+    if (!*timer)
+        return;
+
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    impl->timer_destroy(gpu, *timer);
+    *timer = NULL;
+}
+
+uint64_t pl_timer_query(const struct pl_gpu *gpu, struct pl_timer *timer)
+{
+    if (!timer)
+        return 0;
+
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    return impl->timer_query(gpu, timer);
+}
+
+void pl_gpu_batch(const struct pl_gpu *gpu, bool begin)
+{
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    if (impl->gpu_batch)
+        impl->gpu_batch(gpu, begin);
+}
+
 void pl_gpu_flush(const struct pl_gpu *gpu)
 {
     const struct pl_gpu_fns *impl = TA_PRIV(gpu);
@@ -1206,70 +1381,177 @@ void pl_gpu_finish(const struct pl_gpu *gpu)
     impl->gpu_finish(gpu);
 }
 
+void pl_gpu_trim(const struct pl_gpu *gpu)
+{
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    if (impl->gpu_trim)
+        impl->gpu_trim(gpu);
+}
+
+bool pl_gpu_memory_stats(const struct pl_gpu *gpu,
+                         struct pl_gpu_memory_stats *out)
+{
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    *out = (struct pl_gpu_memory_stats) {0};
+    if (!impl->gpu_memory_stats)
+        return false;
+
+    return impl->gpu_memory_stats(gpu, out);
+}
+
+bool pl_gpu_stats(const struct pl_gpu *gpu, struct pl_gpu_stats *out)
+{
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    *out = (struct pl_gpu_stats) {0};
+    if (!impl->gpu_stats)
+        return false;
+
+    return impl->gpu_stats(gpu, out);
+}
+
 // GPU-internal helpers
 
 void pl_buf_pool_uninit(const struct pl_gpu *gpu, struct pl_buf_pool *pool)
 {
-    for (int i = 0; i < pool->num_buffers; i++)
-        pl_buf_destroy(gpu, &pool->buffers[i]);
+    const struct pl_buf_pool_stats *st = &pool->stats;
+    if (st->misses) {
+        PL_DEBUG(gpu, "Buffer pool stats: %"PRIu64" hits, %"PRIu64" misses, "
+                 "%"PRIu64" blocks, %"PRIu64" evictions", st->hits, st->misses,
+                 st->blocks, st->evictions);
+    }
 
-    talloc_free(pool->buffers);
+    for (int i = 0; i < pool->num_entries; i++)
+        pl_buf_destroy(gpu, &pool->entries[i].buf);
+
+    talloc_free(pool->entries);
     *pool = (struct pl_buf_pool) {0};
 }
 
-static bool pl_buf_pool_grow(const struct pl_gpu *gpu, struct pl_buf_pool *pool)
+// Round buffer sizes up to the next quarter power of two, which bounds the
+// wasted space to 25% while letting slightly differently sized requests
+// share buffers
+static size_t pl_buf_pool_size_class(const struct pl_gpu *gpu,
+                                     const struct pl_buf_params *params)
 {
-    const struct pl_buf *buf = pl_buf_create(gpu, &pool->current_params);
-    if (!buf)
-        return false;
+    size_t limit;
+    switch (params->type) {
+    case PL_BUF_TEX_TRANSFER: limit = gpu->limits.max_xfer_size; break;
+    case PL_BUF_UNIFORM:      limit = gpu->limits.max_ubo_size; break;
+    case PL_BUF_STORAGE:      limit = gpu->limits.max_ssbo_size; break;
+    default: return params->size; // texel buffers are sized in texels
+    }
 
-    TARRAY_INSERT_AT(NULL, pool->buffers, pool->num_buffers, pool->index, buf);
-    PL_DEBUG(gpu, "Resized buffer pool of type %u to size %d",
-             pool->current_params.type, pool->num_buffers);
-    return true;
+    size_t size = params->size, step = 1;
+    while (step <= size / 8)
+        step <<= 1;
+
+    size_t rounded = PL_ALIGN(size, step);
+    return rounded <= limit ? rounded : size;
 }
 
-const struct pl_buf *pl_buf_pool_get(const struct pl_gpu *gpu,
-                                     struct pl_buf_pool *pool,
-                                     const struct pl_buf_params *params)
+static void pl_buf_pool_remove(const struct pl_gpu *gpu,
+                               struct pl_buf_pool *pool, int idx)
 {
+    pl_buf_destroy(gpu, &pool->entries[idx].buf);
+    TARRAY_REMOVE_AT(pool->entries, pool->num_entries, idx);
+    pool->stats.evictions++;
+}
+
+// Marks the entry as most recently used and returns its buffer
+static const struct pl_buf *pl_buf_pool_take(struct pl_buf_pool *pool, int idx)
+{
+    struct pl_buf_pool_entry entry = pool->entries[idx];
+    TARRAY_REMOVE_AT(pool->entries, pool->num_entries, idx);
+    entry.last_use = pool->age;
+    TARRAY_APPEND(NULL, pool->entries, pool->num_entries, entry);
+    return entry.buf;
+}
+
+const struct pl_buf *pl_buf_pool_try_get(const struct pl_gpu *gpu,
+                                         struct pl_buf_pool *pool,
+                                         const struct pl_buf_params *params,
+                                         bool *blocked)
+{
+    *blocked = false;
     require(!params->initial_data);
+    pool->age++;
 
-    if (!pl_buf_params_superset(pool->current_params, *params)) {
-        pl_buf_pool_uninit(gpu, pool);
-        pool->current_params = *params;
+    // Release buffers that have gone unused for a while, since the in-flight
+    // depth (or the set of requested sizes) evidently no longer needs them.
+    // Since the entries are sorted by age, these are all at the front
+    while (pool->num_entries &&
+           pool->age - pool->entries[0].last_use > PL_BUF_POOL_MAX_AGE)
+    {
+        pl_buf_pool_remove(gpu, pool, 0);
     }
 
-    // Make sure we have at least one buffer available
-    if (!pool->buffers && !pl_buf_pool_grow(gpu, pool))
-        return NULL;
-
-    bool usable = !pl_buf_poll(gpu, pool->buffers[pool->index], 0);
-    if (usable)
-        goto done;
+    // Try the compatible buffers in order of least recent use, since those
+    // are the most likely to have completed
+    int num_compatible = 0;
+    for (int i = 0; i < pool->num_entries; i++) {
+        const struct pl_buf *buf = pool->entries[i].buf;
+        if (!pl_buf_params_superset(buf->params, *params))
+            continue;
+        num_compatible++;
+        if (!pl_buf_poll(gpu, buf, 0)) {
+            pool->stats.hits++;
+            return pl_buf_pool_take(pool, i);
+        }
+    }
 
-    if (pool->num_buffers < PL_BUF_POOL_MAX_BUFFERS) {
-        if (pl_buf_pool_grow(gpu, pool))
-            goto done;
+    if (pool->num_entries == PL_BUF_POOL_MAX_BUFFERS) {
+        if (num_compatible == pool->num_entries) {
+            pool->stats.blocks++;
+            *blocked = true;
+            return NULL;
+        }
 
-        // Failed growing the buffer pool, so just error out early
-        return NULL;
+        // Make room by evicting the least recently used incompatible buffer
+        for (int i = 0; i < pool->num_entries; i++) {
+            if (!pl_buf_params_superset(pool->entries[i].buf->params, *params)) {
+                pl_buf_pool_remove(gpu, pool, i);
+                break;
+            }
+        }
     }
 
-    // Can't resize any further, so just loop until the buffer is usable
-    while (pl_buf_poll(gpu, pool->buffers[pool->index], 1000000000)) // 1s
-        PL_TRACE(gpu, "Blocked on buffer pool availability! (slow path)");
+    struct pl_buf_params new_params = *params;
+    new_params.size = pl_buf_pool_size_class(gpu, params);
+    const struct pl_buf *buf = pl_buf_create(gpu, &new_params);
+    if (!buf)
+        return NULL;
 
-done: ;
-    const struct pl_buf *buf = pool->buffers[pool->index++];
-    pool->index %= pool->num_buffers;
+    pool->stats.misses++;
+    TARRAY_APPEND(NULL, pool->entries, pool->num_entries, (struct pl_buf_pool_entry) {
+        .buf = buf,
+        .last_use = pool->age,
+    });
 
+    PL_DEBUG(gpu, "Resized buffer pool of type %u to size %d",
+             params->type, pool->num_entries);
     return buf;
 
 error:
     return NULL;
 }
 
+const struct pl_buf *pl_buf_pool_get(const struct pl_gpu *gpu,
+                                     struct pl_buf_pool *pool,
+                                     const struct pl_buf_params *params)
+{
+    bool blocked;
+    const struct pl_buf *buf = pl_buf_pool_try_get(gpu, pool, params, &blocked);
+    if (buf || !blocked)
+        return buf;
+
+    // Every buffer is compatible but busy, so wait for the oldest one
+    buf = pool->entries[0].buf;
+    while (pl_buf_poll(gpu, buf, 1000000000)) // 1s
+        PL_TRACE(gpu, "Blocked on buffer pool availability! (slow path)");
+
+    return pl_buf_pool_take(pool, 0);
+}
+
 bool pl_tex_upload_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
                        const struct pl_tex_transfer_params *params)
 {
@@ -1479,6 +1761,13 @@ struct pl_pass_params pl_pass_params_copy(void *tactx,
 
 #undef DUPNAMES
 
+    size_t constant_size = 0;
+    for (int i = 0; i < new.num_constants; i++)
+        constant_size = PL_MAX(constant_size, new.constants[i].offset + 4);
+    new.constants = TARRAY_DUP(tactx, new.constants, new.num_constants);
+    if (constant_size)
+        new.constant_data = talloc_memdup(tactx, new.constant_data, constant_size);
+
     return new;
 }
 
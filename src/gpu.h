@@ -33,6 +33,11 @@ struct pl_gpu_fns {
     void (*buf_destroy)(const struct pl_gpu *, const struct pl_buf *);
     void (*pass_destroy)(const struct pl_gpu *, const struct pl_pass *);
     void (*sync_destroy)(const struct pl_gpu *, const struct pl_sync *);
+    void (*timer_destroy)(const struct pl_gpu *, const struct pl_timer *);
+
+    // Optional: called when a batch of passes begins or ends (see
+    // `pl_dispatch_batch_begin`). Calls are balanced, but may be nested.
+    void (*gpu_batch)(const struct pl_gpu *, bool begin);
 
     GPU_PFN(tex_create);
     GPU_PFN(tex_invalidate); // optional
@@ -48,10 +53,15 @@ struct pl_gpu_fns {
     GPU_PFN(desc_namespace);
     GPU_PFN(pass_create);
     GPU_PFN(pass_run);
+    GPU_PFN(timer_create); // optional: if NULL timers are unsupported
+    GPU_PFN(timer_query);
     GPU_PFN(sync_create); // optional if !gpu->export_caps.sync
     GPU_PFN(tex_export); // optional if !gpu->export_caps.sync
     GPU_PFN(gpu_flush); // optional
     GPU_PFN(gpu_finish);
+    GPU_PFN(gpu_trim); // optional
+    GPU_PFN(gpu_memory_stats); // optional
+    GPU_PFN(gpu_stats); // optional
 };
 #undef GPU_PFN
 
@@ -71,6 +81,10 @@ static inline bool pl_gpu_supports_interop(const struct pl_gpu *gpu)
            gpu->import_caps.sync;
 }
 
+// Marks the beginning or end of a batch of passes, which the GPU may record
+// into as few command buffers as possible. No-op if unsupported.
+void pl_gpu_batch(const struct pl_gpu *gpu, bool begin);
+
 // GPU-internal helpers: these should not be used outside of GPU implementations
 
 // Log some metadata about the created GPU
@@ -96,24 +110,56 @@ const char *pl_fmt_glsl_format(const struct pl_fmt *fmt, int components);
 // Compute the total size (in bytes) of a texture transfer operation
 size_t pl_tex_transfer_size(const struct pl_tex_transfer_params *par);
 
+// Returns the transfer params for plane `idx` of a planar texture transfer.
+// (`par` must already be normalized, i.e. have `rc` and the strides set)
+struct pl_tex_transfer_params pl_tex_transfer_plane(const struct pl_tex_transfer_params *par,
+                                                    int idx);
+
 // A hard-coded upper limit on a pl_buf_pool's size, to prevent OOM loops
 #define PL_BUF_POOL_MAX_BUFFERS 8
 
-// A pool of buffers, which can grow as needed
+// Number of `pl_buf_pool_get` calls after which an unused buffer is released
+// again. This lets pools shrink back down once the in-flight depth drops.
+#define PL_BUF_POOL_MAX_AGE 64
+
+struct pl_buf_pool_stats {
+    uint64_t hits;      // an existing buffer was reused
+    uint64_t misses;    // a new buffer had to be created
+    uint64_t blocks;    // all compatible buffers were busy and the pool full
+    uint64_t evictions; // a buffer was released to make room or for being idle
+};
+
+struct pl_buf_pool_entry {
+    const struct pl_buf *buf;
+    uint64_t last_use;
+};
+
+// A pool of buffers, which can grow and shrink as needed. Buffers of
+// different sizes (and params) can coexist; sizes are rounded up to a small
+// number of size classes to make reuse more likely.
 struct pl_buf_pool {
-    struct pl_buf_params current_params;
-    const struct pl_buf **buffers;
-    int num_buffers;
-    int index;
+    struct pl_buf_pool_entry *entries; // sorted by `last_use`, oldest first
+    int num_entries;
+    uint64_t age;
+    struct pl_buf_pool_stats stats;
 };
 
 void pl_buf_pool_uninit(const struct pl_gpu *gpu, struct pl_buf_pool *pool);
 
-// Note: params->initial_data is *not* supported
+// Returns a buffer that is not currently in use by the GPU, blocking if
+// necessary. Note: params->initial_data is *not* supported
 const struct pl_buf *pl_buf_pool_get(const struct pl_gpu *gpu,
                                      struct pl_buf_pool *pool,
                                      const struct pl_buf_params *params);
 
+// Like `pl_buf_pool_get`, but never blocks. If every compatible buffer is
+// still in use and the pool can't grow any further, this returns NULL and
+// sets `*blocked` to true. (On other errors, `*blocked` is set to false)
+const struct pl_buf *pl_buf_pool_try_get(const struct pl_gpu *gpu,
+                                         struct pl_buf_pool *pool,
+                                         const struct pl_buf_params *params,
+                                         bool *blocked);
+
 // Helper that wraps pl_tex_upload/download using texture upload buffers to
 // ensure that params->buf is always set.
 bool pl_tex_upload_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
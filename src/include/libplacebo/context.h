@@ -21,11 +21,15 @@
 #include "config.h"
 
 // Meta-object to serve as a global entrypoint for the purposes of resource
-// allocation, logging, etc.. Note on thread safety: the pl_context and
-// everything allocated from it are *not* thread-safe except where otherwise
-// noted. That is, multiple pl_context objects are safe to use from multiple
-// threads, but a single pl_context and all of its derived resources and
-// contexts must be used from a single thread at all times.
+// allocation, logging, etc.. Note on thread safety: objects allocated from a
+// pl_context (renderers, dispatch objects, shaders, etc.) are *not*
+// thread-safe except where otherwise noted, i.e. each individual object must
+// only be used by one thread at a time. However, different objects derived
+// from the same pl_context may be created, used and destroyed from different
+// threads concurrently, as long as the `pl_gpu` they use is itself
+// thread-safe (see e.g. `pl_vulkan_params.thread_safe`). The only exception
+// is `pl_context_update`, which must not be called concurrently with
+// anything else using the same pl_context.
 struct pl_context;
 
 // The log level associated with a given log message.
@@ -54,6 +58,19 @@ struct pl_context_params {
     // in increased CPU usage as it may enable extra debug paths based on the
     // configured log level.
     enum pl_log_level log_level;
+
+    // If true, `log_cb` is called from a dedicated background thread instead
+    // of the thread generating the message. Messages are still formatted
+    // immediately, but the thread logging them only needs to copy the result
+    // into a fixed-size queue, so slow callbacks (e.g. writing to a file or
+    // terminal) do not stall rendering. Messages are delivered in order, and
+    // all pending messages are flushed by `pl_context_destroy` (and by
+    // `pl_context_update` when disabling this). If the queue overflows, excess
+    // messages are dropped, and a warning with the number of dropped messages
+    // is logged instead.
+    //
+    // Note: The callback must be safe to call from a different thread.
+    bool log_async;
 };
 
 // Creates a new, blank pl_context. The argument `api_ver` must be given as
@@ -94,4 +111,25 @@ void pl_context_update(struct pl_context *ctx,
 void pl_log_simple(void *stream, enum pl_log_level level, const char *msg);
 void pl_log_color(void *stream, enum pl_log_level level, const char *msg);
 
+// Tracing, intended for diagnosing stutter and scheduling issues. While
+// enabled, libplacebo records a timeline of the CPU work done by each thread
+// (e.g. generating shaders, compiling passes, submitting commands, waiting
+// for the GPU, or acquiring and presenting swapchain images) and, where
+// supported by the backend, of the work executed by each GPU queue (e.g.
+// individual passes and transfers). The latter makes it possible to see how
+// well the work on different queues overlaps.
+//
+// Starts recording a new trace, discarding any spans recorded so far.
+void pl_context_trace_start(struct pl_context *ctx);
+
+// Stops recording and writes the trace to `stream` (a FILE*, may be NULL to
+// discard it) in the Chrome trace event JSON format, which can be loaded by
+// e.g. chrome://tracing or https://ui.perfetto.dev. Returns whether writing
+// the trace succeeded.
+//
+// Note: GPU timestamps are aligned against the CPU clock based on when the
+// CPU notices the work completing, so GPU spans may appear slightly later
+// than they actually executed. Their relative timing is exact.
+bool pl_context_trace_stop(struct pl_context *ctx, void *stream);
+
 #endif // LIBPLACEBO_CONTEXT_H_
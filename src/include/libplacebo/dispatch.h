@@ -23,12 +23,75 @@
 
 struct pl_dispatch;
 
+struct pl_dispatch_params {
+    // Upper bound on the number of compiled passes kept in the internal pass
+    // cache. When exceeded, the least recently used passes are evicted. A
+    // value of 0 means the cache is unbounded.
+    int max_passes;
+
+    // Upper bound on the (estimated) total memory consumed by the cached
+    // passes, in bytes. This counts the uniform buffers, push constant
+    // storage, vertex data and the size of the compiled program. As with
+    // `max_passes`, the least recently used passes are evicted first, and a
+    // value of 0 disables this limit.
+    size_t max_pass_memory;
+
+    // If true, new passes are compiled on a background thread instead of
+    // blocking the calling thread. While a pass is still being compiled,
+    // `pl_dispatch_finish` and `pl_dispatch_compute` will discard the shader
+    // and return false without dispatching anything. The caller can simply
+    // retry on the next frame, or use a cheaper shader in the meantime.
+    //
+    // Note: This requires `pl_pass_create` to be safe to call concurrently
+    // with other operations on the same `pl_gpu` (including itself), which
+    // is the case for the vulkan backend.
+    bool async_compile;
+
+    // Upper bound on the number of background threads used for
+    // `async_compile`. Threads are only started as needed, so passes queued
+    // in quick succession (e.g. while warming up a renderer) are compiled
+    // in parallel. A value of 0 picks the number of CPU cores.
+    int compile_threads;
+
+    // If true, the GPU execution time of every dispatched pass is measured
+    // using timer queries (see `pl_timer_create`). The results can be
+    // retrieved with `pl_dispatch_timings`. Has no effect if the GPU does not
+    // support timers. This adds a small amount of overhead to each pass.
+    bool timing;
+
+    // Optimization level used for all passes compiled by this dispatch
+    // object. See `pl_pass_params.optimize`. Passes loaded from a cache
+    // produced with a different level are recompiled.
+    enum pl_shader_opt optimize;
+
+    // Sets `pl_shader_params.float16` for all shaders created by this
+    // dispatch object.
+    bool float16;
+};
+
+// Default parameters, used by `pl_dispatch_create`. These limit the cache to
+// a generous number of passes, but place no bound on their memory usage.
+extern const struct pl_dispatch_params pl_dispatch_default_params;
+
 // Creates a new shader dispatch object. This object provides a translation
 // layer between generated shaders (pl_shader) and the ra context such that it
 // can be used to execute shaders. This dispatch object will also provide
 // shader caching (for efficient re-use).
+//
+// Compiled programs are additionally shared between all dispatch objects on
+// the same `pl_gpu`, so the same shader is only ever compiled once (at most
+// `pl_pass_create` is repeated using the cached program). This shared cache is
+// thread-safe, so dispatch objects may be used from different threads, as
+// long as each individual dispatch object is only used by one thread at a
+// time.
 struct pl_dispatch *pl_dispatch_create(struct pl_context *ctx,
                                        const struct pl_gpu *gpu);
+
+// Like `pl_dispatch_create`, but allows controlling the size of the internal
+// pass cache. If `params` is NULL, defaults to `&pl_dispatch_default_params`.
+struct pl_dispatch *pl_dispatch_create_ex(struct pl_context *ctx,
+                                          const struct pl_gpu *gpu,
+                                          const struct pl_dispatch_params *params);
 void pl_dispatch_destroy(struct pl_dispatch **dp);
 
 // Returns a blank pl_shader object, suitable for recording rendering commands.
@@ -41,6 +104,10 @@ struct pl_shader *pl_dispatch_begin(struct pl_dispatch *dp);
 // pl_shader passed to it, and return it back to the internal pool.
 // If `rc` is NULL, renders to the entire texture.
 // If set, `blend_params` enables and controls blending for this pass.
+//
+// `target` must be renderable or storable. Non-renderable (but storable)
+// targets, as found on e.g. compute-only devices, are drawn to by executing
+// the shader as a compute shader.
 bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **sh,
                         const struct pl_tex *target, const struct pl_rect2d *rc,
                         const struct pl_blend_params *blend_params);
@@ -54,8 +121,72 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, struct pl_shader **sh,
 bool pl_dispatch_compute(struct pl_dispatch *dp, struct pl_shader **sh,
                          int dispatch_size[3]);
 
+// Like `pl_dispatch_compute`, but the number of work groups is read from
+// `buf` by the GPU at execution time, as three consecutive uint32_t values
+// starting at `offset`. This lets a previous pass decide how much work to
+// dispatch, without having to read anything back to the host. See
+// `pl_pass_run_params.compute_indirect` for the requirements on `buf`.
+bool pl_dispatch_compute_indirect(struct pl_dispatch *dp, struct pl_shader **sh,
+                                  const struct pl_buf *buf, size_t offset);
+
+// Begin or end a batch of passes. While a batch is active, all passes
+// dispatched on the same `pl_gpu` are recorded into as few command buffers
+// as possible, rather than being flushed to the GPU individually. This
+// reduces the CPU overhead of long chains of small passes, at the cost of
+// delaying GPU execution until the batch ends (or until a flush is required
+// for some other reason, e.g. switching to a different queue). Batches may
+// be nested; only the outermost `pl_dispatch_batch_end` flushes. Every
+// `pl_dispatch_batch_begin` must be matched by a `pl_dispatch_batch_end`.
+void pl_dispatch_batch_begin(struct pl_dispatch *dp);
+void pl_dispatch_batch_end(struct pl_dispatch *dp);
+
 // Cancel an active shader without submitting anything. Useful, for example,
 // if the shader was instead merged into a different shader.
 void pl_dispatch_abort(struct pl_dispatch *dp, struct pl_shader **sh);
 
+// Number of most recent measurements considered for the per-pass statistics
+#define PL_DISPATCH_TIMING_SAMPLES 32
+
+// Summary of the GPU execution time of a single cached pass. All times are
+// in nanoseconds.
+struct pl_dispatch_timing {
+    uint64_t signature; // as returned by `pl_shader_signature`
+    const char *label;  // human-readable description of the shader's steps
+    int count;          // total number of completed measurements
+    uint64_t last;      // most recent measurement
+    uint64_t average;   // average over the last PL_DISPATCH_TIMING_SAMPLES
+    uint64_t peak;      // peak over the last PL_DISPATCH_TIMING_SAMPLES
+};
+
+// Collect timing statistics for the cached passes, as enabled by
+// `pl_dispatch_params.timing`. Writes up to `max_out` entries to `out` (which
+// may be NULL if `max_out` is 0), and returns the total number of passes with
+// at least one completed measurement. Passes that have been evicted from the
+// cache are no longer reported. The `label` strings remain valid until the
+// next call to a `pl_dispatch` function on `dp`.
+//
+// Note: Measurements only complete asynchronously, so the results typically
+// lag behind by a few frames.
+int pl_dispatch_timings(struct pl_dispatch *dp, struct pl_dispatch_timing *out,
+                        int max_out);
+
+// Serialize the compiled programs of all cached passes into an opaque blob,
+// which can be e.g. saved to disk and loaded again by a future process (using
+// `pl_dispatch_load`) in order to skip shader compilation and pipeline
+// creation on startup. Returns the size of the serialized data in bytes. If
+// `out` is NULL, nothing is written, and only the required size is returned.
+// Otherwise, `out` must point to a buffer of at least this size.
+//
+// Note: The resulting cache is tied to the specific GPU (UUID) it was
+// generated on. Loading it on a different device will simply have no effect.
+size_t pl_dispatch_save(struct pl_dispatch *dp, uint8_t *out);
+
+// Load the result of a previous `pl_dispatch_save` call, `size` bytes long.
+// Programs in `cache` will be used to speed up the creation of passes with
+// matching shader signatures. This may be called multiple times; programs
+// with the same signature replace any previously loaded entries. Invalid,
+// truncated, corrupt or mismatched caches are ignored (with a warning).
+void pl_dispatch_load(struct pl_dispatch *dp, const uint8_t *cache,
+                      size_t size);
+
 #endif // LIBPLACEBO_DISPATCH_H
@@ -23,13 +23,17 @@
 // The functions in this file allow creating and manipulating "dummy" contexts.
 // A dummy context isn't actually mapped by the GPU, all data exists purely on
 // the CPU. It also isn't capable of compiling or executing any shaders, any
-// attempts to do so will simply fail.
+// attempts to do so will simply fail (unless `accept_passes` is set).
 //
 // The main use case for this dummy context is for users who want to generate
 // advanced shaders that depend on specific GLSL features or support for
 // certain types of GPU resources (e.g. LUTs). This dummy context allows such
 // shaders to be generated, with all of the referenced shader objects and
 // textures simply containing their data in a host-accessible way.
+//
+// A secondary use case is measuring the CPU overhead of libplacebo itself
+// (e.g. of `pl_renderer`) without real hardware, by enabling `accept_passes`
+// and inspecting the statistics from `pl_gpu_dummy_get_stats`.
 
 struct pl_gpu_dummy_params {
     // These GPU parameters correspond to their equialents in struct `pl_gpu`,
@@ -44,6 +48,11 @@ struct pl_gpu_dummy_params {
     pl_gpu_caps caps;
     struct pl_glsl_desc glsl;
     struct pl_gpu_limits limits;
+
+    // If enabled, `pl_pass_create` succeeds, but the resulting passes are
+    // never compiled and do nothing when run. Any textures rendered to will
+    // therefore have undefined contents. Disabled by default.
+    bool accept_passes;
 };
 
 extern const struct pl_gpu_dummy_params pl_gpu_dummy_default_params;
@@ -59,6 +68,32 @@ const struct pl_gpu *pl_gpu_dummy_create(struct pl_context *ctx,
 
 void pl_gpu_dummy_destroy(const struct pl_gpu **gpu);
 
+// Counters for all of the work submitted to a dummy GPU, since its creation
+// or the last call to `pl_gpu_dummy_reset_stats`. The same counters are also
+// reported by `pl_gpu_stats` (which is reset along with these).
+struct pl_gpu_dummy_stats {
+    uint64_t pass_creates;      // number of passes created
+    uint64_t pass_runs;         // number of passes executed
+    uint64_t desc_bindings;     // total descriptors bound, over all pass runs
+    uint64_t var_updates;       // total variable updates, over all pass runs
+    uint64_t tex_uploads;
+    uint64_t tex_downloads;
+    uint64_t tex_clears;
+    uint64_t tex_creates;       // excluding `pl_tex_dummy_create`
+    uint64_t bytes_uploaded;    // texture uploads, buffer writes and vertices
+    uint64_t bytes_downloaded;  // texture downloads and buffer reads
+
+    // Total wall clock time spent inside the dummy backend, i.e. standing in
+    // for the time a real GPU driver would spend on these calls. Subtracting
+    // this from the total time of e.g. `pl_render_image` gives the time spent
+    // in libplacebo itself.
+    uint64_t backend_ns;
+};
+
+void pl_gpu_dummy_get_stats(const struct pl_gpu *gpu,
+                            struct pl_gpu_dummy_stats *out);
+void pl_gpu_dummy_reset_stats(const struct pl_gpu *gpu);
+
 // Back-doors into the `pl_tex` and `pl_buf` representations. These allow you
 // to access the raw data backing this object. Textures are always laid out in
 // a tightly packed manner.
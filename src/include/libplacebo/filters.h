@@ -312,6 +312,11 @@ struct pl_filter {
 // (i.e. missing a required parameter).
 // The resulting pl_filter is implicitly destroyed when the pl_context is
 // destroyed.
+//
+// Note: Recently generated filters are cached on the `pl_context`, so calling
+// this again with identical parameters (e.g. from a different renderer) may
+// return the same, shared object. It's safe to call this from multiple
+// threads sharing the same context.
 const struct pl_filter *pl_filter_generate(struct pl_context *ctx,
                                        const struct pl_filter_params *params);
 
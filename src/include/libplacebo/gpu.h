@@ -47,6 +47,10 @@ enum {
     PL_GPU_CAP_PARALLEL_COMPUTE = 1 << 1, // supports multiple compute queues
     PL_GPU_CAP_INPUT_VARIABLES  = 1 << 2, // supports shader input variables
     PL_GPU_CAP_MAPPED_BUFFERS   = 1 << 3, // supports host-mapped buffers
+    PL_GPU_CAP_SPEC_CONSTANTS   = 1 << 4, // supports specialization constants
+    PL_GPU_CAP_BINDLESS         = 1 << 5, // supports bindless sampled textures
+    PL_GPU_CAP_FLOAT16          = 1 << 6, // supports 16-bit float arithmetic
+    PL_GPU_CAP_SUBGROUPS        = 1 << 7, // supports compute subgroup arithmetic
 };
 
 // Some `pl_gpu` operations allow sharing GPU resources with external APIs -
@@ -59,6 +63,7 @@ enum pl_handle_type {
     PL_HANDLE_WIN32     = (1 << 1), // `HANDLE` for win32 API
     PL_HANDLE_WIN32_KMT = (1 << 2), // `HANDLE` for pre-Windows-8 win32 API
     PL_HANDLE_DMA_BUF   = (1 << 3), // 'int fd' for a dma_buf fd
+    PL_HANDLE_HOST_PTR  = (1 << 4), // `void *ptr` for host memory (import only)
 };
 
 struct pl_gpu_handle_caps {
@@ -77,6 +82,7 @@ struct pl_gpu_handle_caps {
 union pl_handle {
     int fd;         // PL_HANDLE_FD / PL_HANDLE_DMA_BUF
     void *handle;   // PL_HANDLE_WIN32 / PL_HANDLE_WIN32_KMT
+    void *ptr;      // PL_HANDLE_HOST_PTR
 };
 
 // Structure encapsulating memory that is shared between libplacebo and the
@@ -89,6 +95,16 @@ struct pl_shared_mem {
     union pl_handle handle;
     size_t size;   // the total size of the memory referenced by this handle
     size_t offset; // the offset of the object within the referenced memory
+
+    // For PL_HANDLE_DMA_BUF textures, this describes the layout of the image
+    // in memory: the DRM format modifier, and the row pitch (in bytes) of the
+    // single memory plane, or 0 for tightly packed rows. When importing, the
+    // modifier must be one of `pl_fmt.modifiers`. If the format lists no
+    // modifiers, both fields are ignored, and the memory is assumed to be in
+    // the implementation's internal layout (e.g. exported by a `pl_tex` on the
+    // same device). For exported textures, these are filled in accordingly.
+    uint64_t drm_format_mod;
+    size_t pitch;
 };
 
 // Structure defining the physical limits of this GPU instance. If a limit is
@@ -111,12 +127,29 @@ struct pl_gpu_limits {
     uint32_t max_group_size[3]; // maximum work group size per dimension
     uint32_t max_dispatch[3];   // maximum dispatch size per dimension
 
+    // Number of threads per compute subgroup. Always available (non-zero)
+    // if PL_GPU_CAP_SUBGROUPS is set.
+    uint32_t subgroup_size;
+
     // These don't represent hard limits but indicate performance hints for
     // optimal alignment. For best performance, the corresponding field
     // should be aligned to a multiple of these. They will always be a power
     // of two.
     uint32_t align_tex_xfer_stride; // optimal `pl_tex_transfer_params.stride_w/h`
     size_t align_tex_xfer_offset;   // optimal `pl_tex_transfer_params.buf_offset`
+
+    // Required alignment of `pl_desc_binding.buf_offset`. If this is 0,
+    // binding uniform buffers at an offset is unsupported.
+    size_t align_ubo_offset;
+
+    // Number of slots in the global texture heap. Always available (non-zero)
+    // if PL_GPU_CAP_BINDLESS is set. (See `pl_pass_params.bindless`)
+    uint32_t max_bindless_tex;
+
+    // Required alignment of both the pointer and the size of host memory
+    // imported via PL_HANDLE_HOST_PTR. Always available (non-zero) if
+    // `pl_gpu.import_caps.buf` includes PL_HANDLE_HOST_PTR.
+    size_t align_host_ptr;
 };
 
 // Abstract device context which wraps an underlying graphics context and can
@@ -173,6 +206,12 @@ enum pl_fmt_caps {
     // - PL_FMT_CAP_VERTEX implies that the format is non-opaque
 };
 
+// Describes one plane of a planar format.
+struct pl_fmt_plane {
+    const struct pl_fmt *format; // single-plane format of this plane
+    int shift_x, shift_y;        // log2 of the subsampling factors
+};
+
 // Structure describing a texel/vertex format.
 struct pl_fmt {
     const char *name;       // symbolic name for this format (e.g. rgba32f)
@@ -208,6 +247,20 @@ struct pl_fmt {
     // (PL_FMT_CAP_STORABLE / PL_FMT_CAP_TEXEL_STORAGE), this gives the GLSL
     // texel format corresponding to the format. (e.g. rgba16ui)
     const char *glsl_format;
+
+    // The DRM format modifiers with which sampleable textures of this format
+    // can be imported from a PL_HANDLE_DMA_BUF. (See `pl_shared_mem`)
+    const uint64_t *modifiers;
+    int num_modifiers;
+
+    // If nonzero, this is a planar (multi-planar, e.g. NV12) format, whose
+    // textures consist of several planes sharing a single allocation. Such
+    // formats are always `opaque`; the host representation is instead given
+    // by the individual planes, which are exposed as separate textures. (See
+    // `pl_tex.planes`) The `caps` describe what the planes can be used for.
+    // Planar formats are never returned by `pl_find_fmt`.
+    int num_planes;
+    struct pl_fmt_plane planes[4];
 };
 
 // Returns whether or not a pl_fmt's components are ordered sequentially
@@ -317,6 +370,23 @@ struct pl_tex {
     // While this texture is not in an "exported" state, the contents of the
     // memory are undefined. (See: `pl_tex_export`)
     struct pl_shared_mem shared_mem;
+
+    // If PL_GPU_CAP_BINDLESS is set and this texture is sampleable, this is
+    // the slot it occupies in the global texture heap. The heap is finite,
+    // so this may also be 0 (which never refers to a valid texture), in
+    // which case the texture can only be bound the normal way.
+    uint32_t bindless_index;
+
+    // For textures with a planar format, these are the individual planes.
+    // They behave like regular textures (with `params` inherited from the
+    // parent, as far as applicable), e.g. they can be sampled from or used
+    // for per-plane transfers, but are owned by the parent texture and must
+    // not be destroyed individually. The parent texture itself can't be
+    // bound to shaders, but it can be used with `pl_tex_upload` and
+    // `pl_tex_download` to transfer all planes at once. (See
+    // `pl_tex_transfer_params`)
+    const struct pl_tex *planes[4];
+    int num_planes;
 };
 
 // Create a texture (with undefined contents). Returns NULL on failure. This is
@@ -413,6 +483,28 @@ struct pl_tex_transfer_params {
     // When performing a texture transfer using a buffer, the buffer may be
     // marked as "in use" and should not used for a different type of operation
     // until pl_buf_poll returns false.
+
+    // For planar textures, the data of all planes is stored consecutively,
+    // in plane order. The `rc` and strides refer to the full-resolution
+    // texture and must be aligned to the subsampling factors of every plane;
+    // they are scaled down accordingly for each plane.
+
+    // For downloads only: If set, the download is performed asynchronously,
+    // and this callback is invoked (with `priv`) once the data is available.
+    // When downloading to `ptr`, this memory must remain valid until then;
+    // the data is staged through an internal pool of host-mapped buffers and
+    // copied to `ptr` just before the callback runs. When downloading to a
+    // `buf`, the buffer contents may be accessed (e.g. via `buf->data`)
+    // directly from within the callback, or at any point after it has run.
+    //
+    // Note: The callback may run from within any later call into the same
+    // `pl_gpu` (e.g. `pl_buf_poll`, `pl_gpu_flush` or `pl_gpu_finish`), and
+    // possibly from a different thread. It must not call back into the
+    // `pl_gpu` itself. To ensure the callback runs eventually, the download
+    // must have been flushed, e.g. with `pl_gpu_flush`. Not supported for
+    // planar textures.
+    void (*callback)(void *priv);
+    void *priv;
 };
 
 // Upload data to a texture. Returns whether successful.
@@ -467,6 +559,26 @@ struct pl_buf_params {
     // `pl_gpu.export_caps.buf`.
     enum pl_handle_type handle_type;
 
+    // Setting this indicates that the memory backing this buffer will be
+    // imported from an external API, instead of being allocated. If so, this
+    // must be exactly *one* of `pl_gpu.import_caps.buf`. At most one of
+    // `handle_type` and `import_handle` can be set for a buffer.
+    //
+    // For PL_HANDLE_HOST_PTR, the buffer is backed directly by the given host
+    // memory, which allows e.g. texture uploads from this buffer to read the
+    // data without any intermediate copies. The memory must remain valid, and
+    // must not be modified while the buffer is in use (see `pl_buf_poll`),
+    // until the buffer is destroyed. Imported host memory is always mapped,
+    // i.e. `pl_buf.data` is available regardless of `host_mapped`.
+    enum pl_handle_type import_handle;
+
+    // If the shared memory is being imported, the import handle must be
+    // specified here. Otherwise, this is ignored. The buffer covers the range
+    // starting at `shared_mem.offset`, which must have room for `size` bytes.
+    // For PL_HANDLE_HOST_PTR, `shared_mem.handle.ptr` and `shared_mem.size`
+    // must be aligned to `pl_gpu_limits.align_host_ptr`.
+    struct pl_shared_mem shared_mem;
+
     // If non-NULL, the buffer will be created with these contents. Otherwise,
     // the initial data is undefined. Using this does *not* require setting
     // host_writable.
@@ -516,8 +628,8 @@ const struct pl_buf *pl_buf_create(const struct pl_gpu *gpu,
 //
 // Note: Due to its unpredictability, it's not allowed to use this with
 // `params->initial_data` being set. Similarly, it's not allowed on a buffer
-// with `params->handle_type`. since this may invalidate the corresponding
-// external API's handle. Conversely, it *is* allowed on a buffer with
+// with `params->handle_type` or `params->import_handle`. since this may
+// invalidate the corresponding external API's handle. Conversely, it *is* allowed on a buffer with
 // `params->host_mapped`, and the corresponding `buf->data` pointer *may*
 // change as a result of doing so.
 //
@@ -819,6 +931,26 @@ enum pl_prim_type {
     PL_PRIM_TRIANGLE_FAN,
 };
 
+// Describes a specialization constant, i.e. a shader constant whose value is
+// only provided at pass creation time. The shader must declare it as
+// `layout(constant_id = N) const T name = default;`.
+struct pl_constant {
+    enum pl_var_type type; // scalar type (PL_VAR_SINT, PL_VAR_UINT or PL_VAR_FLOAT)
+    size_t offset;         // byte offset of the value inside `constant_data`
+    int id;                // constant ID (`constant_id` in the shader)
+};
+
+// Controls how aggressively the backend optimizes a pass's shaders while
+// compiling them. Higher levels produce smaller and/or faster code, at the
+// cost of spending more time inside `pl_pass_create`.
+enum pl_shader_opt {
+    PL_SHADER_OPT_DEFAULT = 0,  // backend-specific default
+    PL_SHADER_OPT_NONE,         // no optimization (fastest compilation)
+    PL_SHADER_OPT_SIZE,         // optimize for code size
+    PL_SHADER_OPT_PERFORMANCE,  // optimize for execution speed
+    PL_SHADER_OPT_COUNT,
+};
+
 enum pl_pass_type {
     PL_PASS_INVALID = 0,
     PL_PASS_RASTER,  // vertex+fragment shader
@@ -844,6 +976,13 @@ struct pl_pass_params {
     // Push constant region. Must be be a multiple of 4 <= limits.max_pushc_size
     size_t push_constants_size;
 
+    // Specialization constants. Only supported if PL_GPU_CAP_SPEC_CONSTANTS
+    // is set. Otherwise, num_constants must be 0. Each constant occupies 4
+    // bytes inside `constant_data`, at the offset given by `pl_constant`.
+    struct pl_constant *constants;
+    int num_constants;
+    const void *constant_data;
+
     // The shader text in GLSL. For PL_PASS_RASTER, this is interpreted
     // as a fragment shader. For PL_PASS_COMPUTE, this is interpreted as
     // a compute shader.
@@ -860,6 +999,28 @@ struct pl_pass_params {
     const uint8_t *cached_program;
     size_t cached_program_len;
 
+    // Optimization level used when compiling `glsl_shader` (and
+    // `vertex_shader`). Backends which don't compile shaders themselves, or
+    // whose compiler does not support a particular level, may ignore this.
+    enum pl_shader_opt optimize;
+
+    // If true, sampled textures are read from the global texture heap rather
+    // than being bound individually, so changing the textures a pass reads
+    // from never requires updating any descriptors. Requires
+    // PL_GPU_CAP_BINDLESS, and every PL_DESC_SAMPLED_TEX descriptor must be
+    // bound to a texture with a nonzero `bindless_index`.
+    //
+    // The shader must not declare these descriptors itself. Instead, it
+    // declares the heap, which contains one array per texture dimension N:
+    //
+    //   layout(set=1, binding=N-1) uniform samplerND pl_bindless_Nd[M];
+    //
+    // where M is `limits.max_bindless_tex`, indexed by `bindless_index`
+    // (which must be dynamically uniform, e.g. a push constant). The
+    // descriptors must still be present in `pl_pass_run_params.desc_bindings`,
+    // since they are needed to synchronize access to the textures.
+    bool bindless;
+
     // --- type==PL_PASS_RASTER only
 
     // Describes the interpretation and layout of the vertex data.
@@ -912,6 +1073,12 @@ void pl_pass_destroy(const struct pl_gpu *gpu, const struct pl_pass **pass);
 
 struct pl_desc_binding {
     const void *object; // pl_* object with type corresponding to pl_desc_type
+
+    // For PL_DESC_BUF_UNIFORM only: bind the buffer starting at this byte
+    // offset rather than at the beginning. Must be a multiple of
+    // `limits.align_ubo_offset`. This allows many small uniform blocks to
+    // share a single buffer. (Optional)
+    size_t buf_offset;
 };
 
 struct pl_var_update {
@@ -951,7 +1118,10 @@ struct pl_pass_run_params {
     struct pl_rect2d viewport; // screen space viewport (must be normalized)
     struct pl_rect2d scissors; // target render scissors (must be normalized)
 
-    void *vertex_data;  // raw pointer to vertex data
+    // Raw pointer to the vertex data. May be NULL for passes without any
+    // vertex attributes, in which case the vertex shader is expected to
+    // generate its outputs from `gl_VertexIndex` (or `gl_VertexID`) alone.
+    void *vertex_data;
     int vertex_count;   // number of vertices to render
 
     // --- pass->params.type==PL_PASS_COMPUTE only
@@ -959,11 +1129,47 @@ struct pl_pass_run_params {
     // Number of work groups to dispatch per dimension (X/Y/Z). Must be <= the
     // corresponding index of limits.max_dispatch
     int compute_groups[3];
+
+    // If set, the number of work groups is instead read from this buffer by
+    // the GPU when executing the pass, as three consecutive uint32_t values
+    // (X/Y/Z) starting at `compute_indirect_offset`. This allows a previous
+    // pass to decide the dispatch size without a round trip to the host. The
+    // buffer must be of type PL_BUF_STORAGE, and must not also be bound as a
+    // descriptor of this pass. The offset must be a multiple of 4. (Optional)
+    //
+    // Note: The values are not validated, so exceeding limits.max_dispatch
+    // is undefined behavior.
+    const struct pl_buf *compute_indirect;
+    size_t compute_indirect_offset;
+
+    // If set, the GPU time taken to execute this pass will be recorded into
+    // this timer object. (Optional)
+    struct pl_timer *timer;
 };
 
 // Execute a render pass.
 void pl_pass_run(const struct pl_gpu *gpu, const struct pl_pass_run_params *params);
 
+// Timer objects, which can be used to measure the GPU execution time of
+// operations such as `pl_pass_run`. Timers are measured asynchronously, i.e.
+// the result of a measurement only becomes available some time after the
+// corresponding operation has actually finished executing on the GPU.
+struct pl_timer;
+
+// Creates a new timer object. Returns NULL if the GPU does not support timer
+// queries (which is not considered an error).
+struct pl_timer *pl_timer_create(const struct pl_gpu *gpu);
+void pl_timer_destroy(const struct pl_gpu *gpu, struct pl_timer **);
+
+// Queries the result of the oldest completed measurement recorded by this
+// timer, in nanoseconds, and removes it from the timer. Returns 0 if no
+// measurement is available (yet). Measurements are consumed in the order they
+// were recorded, so users should call this repeatedly (until it returns 0)
+// to drain all completed measurements. Timers only have room for a limited
+// number of outstanding measurements - operations recorded while the timer is
+// full will simply not be measured.
+uint64_t pl_timer_query(const struct pl_gpu *gpu, struct pl_timer *);
+
 // A generic synchronization object intended for use with an external API. This
 // is not required when solely using libplacebo API functions, as all required
 // synchronisation is done internally. This comes in the form of a pair of
@@ -1048,4 +1254,71 @@ void pl_gpu_flush(const struct pl_gpu *gpu);
 // renders to a `pl_swapchain`.
 void pl_gpu_finish(const struct pl_gpu *gpu);
 
+// Releases all currently unused memory held by internal allocators back to
+// the device. Memory that becomes unused is otherwise released automatically
+// after a short grace period (checked during `pl_gpu_flush`), so this is only
+// needed to return memory immediately, e.g. after a spike in usage. This
+// does not affect any objects still in use.
+void pl_gpu_trim(const struct pl_gpu *gpu);
+
+// Memory usage statistics of a single device memory heap. All sizes are in
+// bytes.
+struct pl_gpu_mem_heap {
+    bool device_local;   // heap is local to the device (i.e. VRAM)
+    size_t size;         // total size of the heap
+    size_t budget;       // driver-reported budget for this process, or 0
+    size_t driver_usage; // driver-reported usage by this process, or 0
+    size_t reserved;     // memory allocated from the heap by libplacebo
+    size_t used;         // ... of which is currently in use by objects
+    size_t largest_free; // largest contiguous free region inside `reserved`
+    int num_slabs;       // number of distinct device allocations
+    size_t dedicated;    // memory in allocations made for a single object
+    int num_dedicated;   // ... and the number of such allocations
+};
+
+#define PL_GPU_MAX_HEAPS 16
+
+struct pl_gpu_memory_stats {
+    int num_heaps;
+    struct pl_gpu_mem_heap heaps[PL_GPU_MAX_HEAPS];
+};
+
+// Queries the current memory usage of the GPU's internal allocators. The
+// difference between `reserved` and `used` is memory lost to fragmentation
+// or held for future allocations (see `pl_gpu_trim`). `budget` and
+// `driver_usage` are only available if the driver reports them (e.g. via
+// VK_EXT_memory_budget), and include allocations made outside of libplacebo.
+// When available, the allocator also avoids heaps that would exceed their
+// budget. Returns false (and zeroes `out`) if unsupported.
+bool pl_gpu_memory_stats(const struct pl_gpu *gpu,
+                         struct pl_gpu_memory_stats *out);
+
+// Cumulative counters of the work performed by the GPU since its creation.
+// Counters which do not apply to a given backend always remain at 0.
+struct pl_gpu_stats {
+    uint64_t passes_created;
+    uint64_t passes_destroyed;
+    uint64_t pass_compile_ns;  // total time spent in `pl_pass_create`
+    uint64_t pass_runs;
+    uint64_t desc_updates;     // descriptors bound, summed over all pass runs
+    uint64_t var_updates;      // variables updated, summed over all pass runs
+    uint64_t tex_uploads;
+    uint64_t tex_downloads;
+    uint64_t bytes_uploaded;   // data transferred from the host
+    uint64_t bytes_downloaded; // data transferred back to the host
+    uint64_t queue_submits;    // submissions to the device (e.g. vkQueueSubmit)
+    uint64_t cmd_buffers;      // command buffers contained in those
+    uint64_t staging_allocs;   // staging buffers allocated for transfers
+    uint64_t staging_blocks;   // transfers that had to wait for a staging buffer
+    uint64_t barriers;         // pipeline barriers, counted per resource
+};
+
+// Takes a snapshot of the GPU's counters. This is cheap enough to call every
+// frame, and the difference between two snapshots gives the work done in
+// between. For example, a steadily increasing `passes_created` indicates that
+// the pass cache is thrashing. Returns false (and zeroes `out`) if
+// unsupported. If the GPU is used from multiple threads at the same time, the
+// snapshot may miss operations that are still in progress.
+bool pl_gpu_stats(const struct pl_gpu *gpu, struct pl_gpu_stats *out);
+
 #endif // LIBPLACEBO_GPU_H_
@@ -30,6 +30,12 @@ struct pl_renderer;
 // Creates a new renderer object, which is backed by a GPU context. This is a
 // high-level object that takes care of the rendering chain as a whole, from
 // the source textures to the finished frame.
+//
+// Every renderer owns its own `pl_dispatch`, shader objects and scratch
+// resources, so multiple renderers sharing one (thread-safe) `pl_gpu` can
+// render from different threads in parallel, without any external locking.
+// Compiled shaders and LUT textures are shared between all renderers on the
+// same GPU automatically.
 struct pl_renderer *pl_renderer_create(struct pl_context *ctx,
                                        const struct pl_gpu *gpu);
 void pl_renderer_destroy(struct pl_renderer **rr);
@@ -43,6 +49,65 @@ void pl_renderer_destroy(struct pl_renderer **rr);
 // `pl_image.signature`.
 void pl_renderer_flush_cache(struct pl_renderer *rr);
 
+// Save/load the compiled shader programs of this renderer, analogous to
+// `pl_dispatch_save` and `pl_dispatch_load`. Loading a cache produced by a
+// previous run (or by the `bundle` tool, see `meson_options.txt`) before
+// rendering the first frame allows skipping shader compilation entirely for
+// all renderer configurations that are contained in it.
+size_t pl_renderer_save(struct pl_renderer *rr, uint8_t *out);
+void pl_renderer_load(struct pl_renderer *rr, const uint8_t *cache,
+                      size_t size);
+
+// The individual stages of the rendering pipeline, in processing order
+enum pl_render_stage {
+    PL_RENDER_STAGE_READ,        // reading, decoding and merging the planes
+    PL_RENDER_STAGE_DEBAND,      // separate debanding passes
+    PL_RENDER_STAGE_PEAK_DETECT, // HDR peak detection
+    PL_RENDER_STAGE_SCALE,       // main scaler (and separated scaler passes)
+    PL_RENDER_STAGE_COLOR_MAP,   // color mapping to an intermediate FBO
+    PL_RENDER_STAGE_OVERLAYS,    // image and target overlays
+    PL_RENDER_STAGE_OUTPUT,      // final pass(es) rendering to the target
+    PL_RENDER_STAGE_COUNT,
+};
+
+struct pl_render_stage_stats {
+    uint64_t gpu_time; // GPU execution time in nanoseconds
+    int num_passes;    // number of shader passes dispatched
+};
+
+// Per-frame breakdown of the rendering work, see `pl_render_params.frame_stats`
+struct pl_render_stats {
+    struct pl_render_stage_stats stages[PL_RENDER_STAGE_COUNT];
+    uint64_t gpu_time; // total over all stages
+    int num_passes;    // total over all stages
+};
+
+// Retrieves the statistics of the most recently rendered frame. Returns false
+// if no statistics are available, e.g. because `frame_stats` was disabled for
+// that frame or the GPU does not support timer queries.
+//
+// Since libplacebo merges as much work as possible into as few shader passes
+// as possible, work belonging to multiple stages often ends up in a single
+// pass, whose cost is then attributed entirely to the last stage it contains.
+// For example, the final pass onto the target typically also performs the
+// main scaling and color mapping, and is counted as PL_RENDER_STAGE_OUTPUT,
+// while PL_RENDER_STAGE_PEAK_DETECT covers the pass reading the planes
+// whenever peak detection is merged into it.
+//
+// Note: GPU times are measured asynchronously, so they are based on the most
+// recent completed measurement of each pass, which typically lags behind by
+// a few frames. Passes without any measurement yet count as 0 ns. Blits (e.g.
+// from the redraw cache) are not counted. If a frame renders the same pass
+// multiple times, its cost is only counted once.
+bool pl_renderer_get_stats(const struct pl_renderer *rr,
+                           struct pl_render_stats *out);
+
+// Retrieves the histogram measured by HDR peak detection, if enabled via
+// `pl_peak_detect_params.histogram_bins`. Never blocks. Returns false if no
+// results are available (yet). See `pl_get_detected_histogram`.
+bool pl_renderer_get_histogram(const struct pl_renderer *rr,
+                               struct pl_peak_histogram *out);
+
 // Represents the options used for rendering. These affect the quality of
 // the result.
 struct pl_render_params {
@@ -110,7 +175,8 @@ struct pl_render_params {
     const struct pl_dither_params *dither_params;
 
     // Configures the settings used to generate a 3DLUT, if required. If NULL,
-    // defaults to `&pl_3dlut_default_params`.
+    // defaults to `&pl_3dlut_default_params`. If `async` is set, frames are
+    // rendered without the 3DLUT (and not cached) until it's ready.
     const struct pl_3dlut_params *lut3d_params;
 
     // Configures the settings used to simulate color blindness, if desired.
@@ -146,6 +212,29 @@ struct pl_render_params {
     // params->peak_detect_params is set and the source is HDR).
     bool allow_delayed_peak_detect;
 
+    // If nonzero, enables automatic quality scaling. The renderer measures the
+    // GPU time spent on each frame (using timer queries), and whenever this
+    // repeatedly exceeds `frame_budget` (in milliseconds), it progressively
+    // degrades the quality: polar scalers are replaced by orthogonal ones,
+    // then by bicubic, then by bilinear sampling; followed by disabling
+    // debanding, using cheaper tone mapping (and no sigmoidization), and
+    // finally skipping peak detection. Once enough headroom is available
+    // again for a while, the quality is gradually restored. The remaining
+    // fields of this struct act as the upper bound on the quality.
+    //
+    // Note: Measurements are asynchronous, so the renderer reacts to changes
+    // in load with a delay of several frames. Has no effect if the GPU does
+    // not support timer queries.
+    float frame_budget;
+
+    // Allows the use of 16-bit float arithmetic for the precision-tolerant
+    // parts of rendering SDR content, such as the weighted sums of the
+    // orthogonal scalers and debanding (see `pl_shader_params.float16`). This
+    // can speed up these shaders considerably on GPUs with fast FP16, e.g.
+    // mobile GPUs, at the cost of a small loss of precision. Has no effect
+    // for HDR content, or if the GPU lacks PL_GPU_CAP_FLOAT16.
+    bool float16;
+
     // --- Performance tuning / debugging options
     // These may affect performance or may make debugging problems easier,
     // but shouldn't have any effect on the quality.
@@ -165,7 +254,14 @@ struct pl_render_params {
     // It's also worth pointing out that this option being `false` does not
     // guarantee the use of a redraw cache. It will be implicitly disabled, for
     // example, if the hardware does not support the required features
-    // (typically the presence of blittable texture formats).
+    // (typically the presence of blittable texture formats). In particular,
+    // the target's `fbo` must be created with `blit_dst` enabled.
+    //
+    // The cache currently only retains the most recently rendered image:
+    // rendering the same image to the same target with the same parameters
+    // twice in a row (e.g. while paused) replaces any further such renders
+    // by a single blit, until something changes. Target overlays are never
+    // cached, and are always drawn on top of the result.
     bool skip_redraw_caching;
 
     // Disables linearization / sigmoidization before scaling. This might be
@@ -179,10 +275,45 @@ struct pl_render_params {
     // general-purpose ones.
     bool disable_builtin_scalers;
 
+    // Disables the prefiltering step for extreme downscaling ratios. Normally,
+    // when downscaling by more than 4x, libplacebo first reduces the image
+    // using a cheap pyramid of 2x2 box filters until it's within 2x of the
+    // target size, before applying the actual downscaler. This avoids having
+    // to widen the filter kernel (and thus the number of taps) by the full
+    // downscaling ratio, at a negligible loss of quality.
+    bool disable_downscaling_prefilter;
+
     // Forces the use of a 3DLUT, even in cases where the use of one is
     // unnecessary. This is slower, but may improve the quality of the gamut
     // reduction step, if one is performed.
     bool force_3dlut;
+
+    // If set, bakes the entire color mapping step (linearization, tone and
+    // gamut mapping, and re-encoding to the target transfer) into a single
+    // 3DLUT with this many entries per dimension, which is then applied with
+    // one trilinear lookup per pixel. The LUT is computed on the GPU, and only
+    // recomputed when the color spaces or `color_map_params` change, trading
+    // a one-time cost for cheaper per-pixel work. Input values outside the
+    // [0,1] range get clipped. Ignored while peak detection is active, when
+    // using a 3DLUT for ICC profiles, and for linear light sources or
+    // targets. 33 or 64 are reasonable values. Defaults to 0 (disabled).
+    int color_map_3dlut_size;
+
+    // Compiles new shaders on a background thread instead of stalling the
+    // render call. (See `pl_dispatch_params.async_compile`) While the
+    // shaders required by these parameters are still being compiled, frames
+    // are instead rendered with a cheaper fallback configuration (built-in
+    // GPU sampling, no debanding, peak detection or 3DLUTs). This avoids
+    // dropped frames when e.g. switching scalers, at the cost of briefly
+    // reduced quality.
+    bool async_compile;
+
+    // Collects a breakdown of the GPU time spent on each stage of the
+    // rendering pipeline, which can be retrieved after each frame using
+    // `pl_renderer_get_stats`. This enables timer queries for all passes,
+    // which may have a small performance cost. Has no effect if the GPU does
+    // not support timer queries.
+    bool frame_stats;
 };
 
 // This contains the default/recommended options for reasonable image quality,
@@ -252,6 +383,12 @@ enum pl_overlay_mode {
 
 // A struct representing an image overlay (e.g. for subtitles or on-screen
 // status messages, controls, ...)
+//
+// Note: Consecutive overlays which are drawn unscaled, without `shift_x/y`,
+// and which share the same texture format, mode, components, `repr` and
+// `color`, are copied into a shared atlas texture and drawn using a single
+// pass. This requires `blit_src` on the overlay textures, and drastically
+// reduces the overhead of drawing many small overlays (e.g. subtitle glyphs).
 struct pl_overlay {
     // The plane to overlay. Multi-plane overlays are not supported. If
     // necessary, multiple planes can be combined by treating them as separate
@@ -362,6 +499,18 @@ struct pl_render_target {
     // partially or wholly outside the bounds of the fbo. (Optional)
     struct pl_rect2d dst_rect;
 
+    // If set, only the pixels of `fbo` inside this rectangle are updated, and
+    // the rest of the `fbo` is left untouched. This can be used to re-render
+    // only the part of the target that actually changed since the previous
+    // frame (e.g. the region of an updated overlay), with all passes being
+    // restricted to this region where possible. The contents inside the
+    // damaged region are the same as if the entire target was re-rendered.
+    // May be flipped, and is clipped to the bounds of the fbo. (Optional)
+    //
+    // Note: All `overlays` of this target overlapping the damaged region
+    // still need to be included, since the damaged region is fully redrawn.
+    struct pl_rect2d damage;
+
     // The color representation and space of the output. If this does not match
     // the color space of the source, libplacebo will convert the colors
     // automatically.
@@ -388,6 +537,12 @@ void pl_render_target_from_swapchain(struct pl_render_target *out_target,
 // internally detect and flush whatever caches are invalidated as a result of
 // changing colorspace, size etc.
 //
+// If the image would be passed through unmodified (a single plane with the
+// same format, size, color representation and color space as the target, and
+// no processing requested), it will be copied to the target using a blit,
+// without running any shaders. This requires `blit_src` on the plane texture
+// and `blit_dst` on the target.
+//
 // Note on lifetime: Once this call returns, the passed structures may be
 // freely overwritten or discarded by the caller, even the referenced
 // `pl_tex` objects may be freely reused.
@@ -395,7 +550,16 @@ bool pl_render_image(struct pl_renderer *rr, const struct pl_image *image,
                      const struct pl_render_target *target,
                      const struct pl_render_params *params);
 
-/* TODO
+// Render a single image to multiple targets at once, e.g. a full-screen
+// output, a preview thumbnail and an encoder target. This is equivalent to
+// calling `pl_render_image` for each target in turn, except that the work
+// common to all targets (reading and merging the planes, debanding, color
+// decoding and peak detection) is only performed once. Scaling and output
+// encoding is done separately for each target. The output caching and
+// passthrough fast paths of `pl_render_image` are not used here.
+bool pl_render_image_multi(struct pl_renderer *rr, const struct pl_image *image,
+                           const struct pl_render_target *targets, int num_targets,
+                           const struct pl_render_params *params);
 
 // Represents a mixture of input images, distributed temporally.
 //
@@ -444,14 +608,14 @@ struct pl_image_mix {
     float vsync_duration;
 
     // Explanation of the frame mixing radius: The algorithm chosen in
-    // `pl_render_params.frame_mixing` has a canonical radius equal to
+    // `pl_render_params.frame_mixer` has a canonical radius equal to
     // `pl_filter_config.kernel->radius`. This means that the frame mixing
     // algorithm will (only) need to consult all of the frames that have a
     // distance within the interval [-radius, radius]. As such, the user should
     // include all such frames in `images`, but may prune or omit frames that
     // lie outside it.
     //
-    // The built-in frame mixing (`pl_render_params.frame_mixing == NULL`) has
+    // The built-in frame mixing (`pl_render_params.frame_mixer == NULL`) has
     // a canonical radius equal to `vsync_duration/2`.
 };
 
@@ -466,9 +630,18 @@ struct pl_image_mix {
 // of pl_render_image_mix, where num_images = 1, that frame's distance is 0.0,
 // and the vsync_duration is 0.0. (But using `pl_render_image` instead of
 // `pl_render_image_mix` in such an example can still be more efficient)
+//
+// Each image is rendered (scaled, color converted etc.) to an intermediate
+// texture in the target's color space only once, and cached based on its
+// `signature`. Subsequent mixes containing the same image re-use this result,
+// so the cost of mixing is roughly a single render per *source* frame, plus a
+// cheap blending pass per output frame. Frames no longer part of the mix are
+// dropped from the cache. Changing the target size, color space or the
+// rendering params invalidates all cached frames. (Note: changes to the
+// contents of structs referenced by `params` are not detected; use
+// `pl_renderer_flush_cache` in that case)
 bool pl_render_image_mix(struct pl_renderer *rr, const struct pl_image_mix *mix,
                          const struct pl_render_target *target,
                          const struct pl_render_params *params);
-*/
 
 #endif // LIBPLACEBO_RENDERER_H_
@@ -55,6 +55,13 @@ struct pl_shader_params {
     // determine the effective GLSL mode and capabilities. If `gpu` is also
     // set, then this overrides `gpu->glsl`.
     struct pl_glsl_desc glsl;
+
+    // If true, and the GPU supports PL_GPU_CAP_FLOAT16, shaders may perform
+    // precision-tolerant arithmetic (such as the weighted sums of SDR scaling
+    // or debanding) using 16-bit floats, which can have up to double the
+    // throughput on some GPUs. Calculations requiring high precision, such as
+    // transfer functions or dithering, are always done in 32-bit floats.
+    bool float16;
 };
 
 // Creates a new, blank, mutable pl_shader object.
@@ -103,8 +110,10 @@ bool pl_shader_output_size(const struct pl_shader *sh, int *w, int *h);
 // Compatibility in this context means that they differ only in the contents
 // of variables, vertex attributes or descriptor bindings. The structure,
 // shader text and number/names of input variables/descriptors/attributes must
-// be the same. Note that computing this function takes some time, so the
-// results should be re-used where possible.
+// be the same. This covers the type and layout of all variables, as well as
+// the type, access mode and dimensions of all descriptors. The signature is
+// accumulated incrementally as the shader is built, so this function is cheap
+// to call.
 uint64_t pl_shader_signature(const struct pl_shader *sh);
 
 // Indicates the type of signature that is associated with a shader result.
@@ -171,6 +180,13 @@ struct pl_shader_var {
     struct pl_var var;  // the underlying variable description
     const void *data;   // the raw data (interpretation as with pl_var_update)
     bool dynamic;       // if true, the value is expected to change frequently
+
+    // If true, the value is baked into the compiled pass instead of being
+    // updated on every run, which lets the shader compiler constant-fold it.
+    // Different values result in different passes, so this should only be
+    // used for values that rarely change. Only honored for non-array scalars
+    // and vectors, and mutually exclusive with `dynamic`.
+    bool compile_time;
 };
 
 struct pl_buffer_var {
@@ -105,8 +105,17 @@ struct pl_peak_detect_params {
     // entirely, set either one to a negative value.
     float scene_threshold_low;
     float scene_threshold_high;
+
+    // If nonzero, additionally accumulate a histogram of the per-pixel signal
+    // level (the brightest component, relative to PL_COLOR_REF_WHITE), with
+    // this many logarithmically spaced bins. The results can be retrieved
+    // with `pl_get_detected_histogram`. Must not exceed
+    // PL_PEAK_HISTOGRAM_MAX_BINS. Defaults to 0 (disabled).
+    int histogram_bins;
 };
 
+#define PL_PEAK_HISTOGRAM_MAX_BINS 256
+
 extern const struct pl_peak_detect_params pl_peak_detect_default_params;
 
 // This function can be used to measure the `sig_peak` and `sig_avg` of a
@@ -140,6 +149,46 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
 bool pl_get_detected_peak(const struct pl_shader_obj **state,
                           float *out_peak, float *out_avg);
 
+// Results of the histogram measured by `pl_shader_detect_peak`, see
+// `pl_peak_detect_params.histogram_bins`.
+struct pl_peak_histogram {
+    // The frame these results were measured on, counting the frames fully
+    // processed by the peak detection shader, starting at 1.
+    uint64_t frame;
+
+    // The smoothed `sig_peak` and `sig_avg` as of this frame, i.e. the values
+    // used for tone mapping.
+    float peak, avg;
+
+    // Difference between the average brightness of this frame and the
+    // smoothed average of the preceding frames, in dB. Large values indicate
+    // a scene change. (See `pl_peak_detect_params.scene_threshold_low`)
+    float scene_delta;
+
+    // Bin `i` counts the pixels with a signal level between
+    // `min_level * pow(max_level / min_level, i / num_bins)` and the same for
+    // `i + 1`. Values outside this range are counted in the first or last bin.
+    float min_level, max_level;
+    const uint32_t *bins;
+    int num_bins;
+    uint64_t total; // sum of all bins
+};
+
+// Returns the most recent histogram result that has already been read back
+// from the GPU, without ever blocking. Results typically lag behind the
+// most recently dispatched frame by a few frames, and individual frames may
+// be skipped. Returns false if no results are available yet. The returned
+// `bins` remain valid until the next call to this function, or until the
+// state object is destroyed.
+bool pl_get_detected_histogram(const struct pl_shader_obj **state,
+                               struct pl_peak_histogram *out);
+
+// Returns the signal level below which `percentile` (0-100) percent of all
+// pixels in `hist` lie, interpolating logarithmically within bins. Useful
+// for e.g. robust peak estimation, by ignoring the brightest 0.1% of pixels.
+float pl_peak_histogram_percentile(const struct pl_peak_histogram *hist,
+                                   float percentile);
+
 // A collection of various tone mapping algorithms supported by libplacebo.
 enum pl_tone_mapping_algorithm {
     // Performs no tone-mapping, just clips out-of-gamut colors. Retains perfect
@@ -240,6 +289,20 @@ struct pl_color_map_params {
     // all out-of-gamut colors (by inverting them), if they would have been
     // clipped as a result of gamut or tone mapping.
     bool gamut_warning;
+
+    // If set, the tone mapping curve is precomputed into a 1D LUT with this
+    // many entries, which is then applied using a single interpolated lookup
+    // per channel instead of evaluating the curve for every pixel. The LUT is
+    // only regenerated when the curve itself changes, e.g. due to a different
+    // source peak. This requires `tone_mapping_lut` to be set, and has no
+    // effect while using dynamic peak detection (since the signal peak is
+    // then only known to the GPU). 256 is a reasonable value. Defaults to 0
+    // (disabled).
+    int tone_mapping_lut_size;
+
+    // State object holding the LUT for `tone_mapping_lut_size`. Ignored if
+    // that field is unset.
+    struct pl_shader_obj **tone_mapping_lut;
 };
 
 extern const struct pl_color_map_params pl_color_map_default_params;
@@ -312,6 +375,14 @@ struct pl_dither_params {
     // artifacts by perturbing the dithering matrix per frame.
     // Warning: This can cause nasty aliasing artifacts on some LCD screens.
     bool temporal;
+
+    // For temporal dithering with PL_DITHER_BLUE_NOISE, setting this to a
+    // nonzero value precomputes this many mutually decorrelated blue noise
+    // frames into a 3D LUT, which are cycled through instead of rotating a
+    // single matrix. This gives better temporal noise distribution at the
+    // cost of some texture memory, but requires support for 3D textures. A
+    // good value is 16. Must not be larger than 64. Ignored otherwise.
+    int temporal_frames;
 };
 
 extern const struct pl_dither_params pl_dither_default_params;
@@ -345,8 +416,32 @@ struct pl_3dlut_params {
     enum pl_rendering_intent intent;
 
     // The size of the 3DLUT to generate. If left as NULL, these individually
-    // default to 64, which is the recommended default for all three.
+    // default to 64 (or 33 with `tetrahedral`), which is the recommended
+    // default for all three.
     size_t size_r, size_g, size_b;
+
+    // If true, the 3DLUT is sampled using tetrahedral interpolation instead
+    // of hardware trilinear filtering. This is slightly more expensive to
+    // apply, but much more accurate for a given LUT size, so it allows using
+    // a far smaller (and faster to generate) LUT for the same quality.
+    bool tetrahedral;
+
+    // The number of CPU threads to use for computing the 3DLUT. If left as 0,
+    // this defaults to the number of available CPU cores. Set to 1 to disable
+    // multithreading.
+    int threads;
+
+    // If true, the 3DLUT is computed on a background thread instead of
+    // stalling `pl_3dlut_update` until it's done. While this is in progress,
+    // `pl_3dlut_update` returns false with `pl_3dlut_result.pending` set,
+    // and the caller should fall back to `pl_shader_color_map` for the time
+    // being.
+    bool async;
+
+    // If set, computed 3DLUTs are persisted to (and loaded from) files in
+    // this directory, indexed by a hash of the color profiles, intent and
+    // LUT size. The directory must already exist. (Optional)
+    const char *cache_dir;
 };
 
 extern const struct pl_3dlut_params pl_3dlut_default_params;
@@ -379,6 +474,10 @@ struct pl_3dlut_result {
     // The destination color space. This is the color space that the colors
     // will (nominally) be in at the time they exit the 3DLUT.
     struct pl_color_space dst_color;
+
+    // Set if `pl_3dlut_update` failed only because the 3DLUT is still being
+    // computed in the background. (See `pl_3dlut_params.async`)
+    bool pending;
 };
 
 #if PL_HAVE_LCMS
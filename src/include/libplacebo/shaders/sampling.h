@@ -34,6 +34,13 @@ struct pl_sample_src {
     int components;           // number of components to sample (optional)
     int new_w, new_h;         // dimensions of the resulting output (optional)
     float scale;              // factor to multiply into sampled signal (optional)
+
+    // If set, only this part of the texture is considered valid: sampling
+    // behaves as if the texture ended at the edges of this rect, so texels
+    // outside of it are never read. This is useful for textures which are
+    // larger than the image they contain. If `rect` is left unset, it
+    // defaults to this rect. (optional)
+    struct pl_rect2d valid_rect;
 };
 
 struct pl_deband_params {
@@ -75,6 +82,20 @@ extern const struct pl_deband_params pl_deband_default_params;
 void pl_shader_deband(struct pl_shader *sh, const struct pl_sample_src *src,
                       const struct pl_deband_params *params);
 
+// Equivalent to `pl_shader_deband`, but uses a compute shader which first
+// loads the pixels surrounding each work group (up to the maximum debanding
+// radius) into shared memory, so the randomized samples of every iteration
+// can be served from there instead of the texture. The resulting shader is
+// always a compute shader, so it can only be dispatched to storable textures.
+//
+// Returns false if this is not possible, e.g. because compute shaders are
+// unavailable, `src` implies scaling (or a fractional/flipped crop), or the
+// radius is too large to fit into shared memory. In this case, the shader is
+// left unmodified, and the caller should fall back to `pl_shader_deband`.
+bool pl_shader_deband_compute(struct pl_shader *sh,
+                              const struct pl_sample_src *src,
+                              const struct pl_deband_params *params);
+
 // Performs direct / native texture sampling. This uses whatever built-in GPU
 // sampling is built into the GPU and specified using src->params.sample_mode.
 //
@@ -84,6 +105,14 @@ void pl_shader_deband(struct pl_shader *sh, const struct pl_sample_src *src,
 // upscaling with PL_TEX_SAMPLE_NEAREST.
 bool pl_shader_sample_direct(struct pl_shader *sh, const struct pl_sample_src *src);
 
+// Performs nearest-neighbour sampling, regardless of the texture's
+// sample_mode. This snaps the sampling position to the nearest texel center,
+// so it results in only a single texel fetch even for PL_TEX_SAMPLE_LINEAR
+// textures. This is equivalent to (but much faster than) using
+// `pl_filter_box` with the generalized sampling routines for upscaling, and
+// mainly useful for e.g. pixel art or exact integer upscaling.
+bool pl_shader_sample_nearest(struct pl_shader *sh, const struct pl_sample_src *src);
+
 // Performs hardware-accelerated / efficient bicubic sampling. This is more
 // efficient than using the generalized sampling routines and
 // pl_filter_function_bicubic. Requires the source texture to be set up with
@@ -147,4 +176,24 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
                             const struct pl_sample_src *src,
                             const struct pl_sample_filter_params *params);
 
+// Performs both passes of orthogonal sampling at once, using a compute shader
+// which keeps the input tile as well as the intermediate (vertically scaled)
+// result in shared memory. This avoids the intermediate texture required when
+// calling `pl_shader_sample_ortho` twice, and allows merging further
+// operations (e.g. color mapping) into the same dispatch. The resulting
+// shader is always a compute shader, so it can only be dispatched to
+// storable textures. For large filters (or strong downscaling), the work
+// group size is reduced as needed to fit the tile into shared memory.
+//
+// Returns false if this is not possible, e.g. because compute shaders are
+// unavailable (or disabled via `params->no_compute`), the `src->rect` is
+// flipped, or the filter is too large to fit into shared memory. In this
+// case, the shader is left unmodified, and the caller should fall back to
+// `pl_shader_sample_ortho`, unless the shader is in a "failed" state (see
+// `pl_shader_is_failed`) due to a genuine error. `params->lut` may be shared
+// between both functions.
+bool pl_shader_sample_ortho2d(struct pl_shader *sh,
+                              const struct pl_sample_src *src,
+                              const struct pl_sample_filter_params *params);
+
 #endif // LIBPLACEBO_SHADERS_SAMPLING_H_
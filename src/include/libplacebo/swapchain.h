@@ -82,6 +82,11 @@ struct pl_swapchain_frame {
     // and alpha handling (where available).
     struct pl_color_repr color_repr;
     struct pl_color_space color_space;
+
+    // A unique, monotonically increasing identifier for this frame, or 0 if
+    // unsupported by the swapchain implementation. Matches
+    // `pl_swapchain_frame_timing.id`.
+    uint64_t id;
 };
 
 // Retrieve a new frame from the swapchain. Returns whether successful. It's
@@ -141,4 +146,42 @@ bool pl_swapchain_submit_frame(const struct pl_swapchain *sw);
 // `start_frame` blocked for should also be included).
 void pl_swapchain_swap_buffers(const struct pl_swapchain *sw);
 
+// Presentation feedback for a single frame
+struct pl_swapchain_frame_timing {
+    uint64_t id;            // same as `pl_swapchain_frame.id`
+    uint64_t present_time;  // time the frame was actually displayed (ns)
+    uint64_t present_margin; // how early the frame was ready (ns)
+};
+
+struct pl_swapchain_timing {
+    // The duration of a single display refresh cycle (in nanoseconds), or 0
+    // if unknown.
+    uint64_t refresh_duration;
+
+    // Running totals over the lifetime of the swapchain. A "missed vsync" is
+    // counted for every refresh cycle that a frame remained on-screen for
+    // longer than one, i.e. every time the previous frame had to be repeated
+    // because the next one was late (or was never submitted in time).
+    uint64_t frames_presented;
+    uint64_t missed_vsyncs;
+
+    // Feedback for all frames that were presented since the previous call to
+    // `pl_swapchain_timing`, oldest first. May be empty, even for frames that
+    // were presented, if the platform has not reported them yet. This array
+    // is owned by the swapchain and remains valid until the next call.
+    //
+    // Note: `present_time` is in the time domain of the presentation engine,
+    // which is typically CLOCK_MONOTONIC on POSIX platforms.
+    const struct pl_swapchain_frame_timing *frames;
+    int num_frames;
+};
+
+// Queries the presentation timing statistics of the swapchain. Returns false
+// (and zeroes `out`) if this is not supported by the swapchain. This can be
+// used to adapt frame pacing, e.g. by reducing the render-ahead or by dropping
+// frames proactively when vsyncs start getting missed. Intended to be called
+// once per frame, e.g. after `pl_swapchain_swap_buffers`.
+bool pl_swapchain_timing(const struct pl_swapchain *sw,
+                         struct pl_swapchain_timing *out);
+
 #endif // LIBPLACEBO_SWAPCHAIN_H_
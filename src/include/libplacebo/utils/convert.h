@@ -0,0 +1,86 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+
+#include <libplacebo/colorspace.h>
+#include <libplacebo/shaders/colorspace.h>
+
+#ifndef LIBPLACEBO_CONVERT_H_
+#define LIBPLACEBO_CONVERT_H_
+
+// This file contains a CPU implementation of the color conversion performed
+// by `pl_shader_decode_color` followed by `pl_shader_color_map`, for use as a
+// software fallback, for generating thumbnails without a GPU, or for verifying
+// the results of the GPU shaders. It operates on planar images, and produces
+// results which match the GPU shaders up to floating point precision.
+//
+// Some caveats apply:
+//  - all three planes must have the same size (no chroma subsampling)
+//  - there is no alpha channel, so `repr.alpha` is ignored
+//  - peak detection is not supported, the tone mapping is based on the
+//    static metadata only (as if `peak_detect_state` was NULL)
+//  - the result is always encoded as full range RGB
+
+// Sample formats supported for the planes
+enum pl_convert_type {
+    PL_CONVERT_FLOAT = 0, // native 32-bit float, nominally 0.0 - 1.0
+    PL_CONVERT_U16,       // unsigned normalized 16-bit integers
+};
+
+// Description of a single plane of host memory.
+struct pl_convert_plane {
+    enum pl_convert_type type;
+    void *data;     // may be const for the source planes
+    size_t stride;  // offset in bytes between rows
+};
+
+struct pl_convert_params {
+    // The representation and color space of the source planes, with the
+    // same meaning as the corresponding fields in `pl_image`. Note that for
+    // U16 data, `repr.bits` should describe how the values are stored within
+    // the 16 bits, exactly as if the plane was uploaded as a 16-bit texture.
+    struct pl_color_repr repr;
+    struct pl_color_space src;
+
+    // The color space to convert to, with the same meaning as `dst` in
+    // `pl_shader_color_map`. Unset fields are inferred in the same way.
+    struct pl_color_space dst;
+
+    // Optional color adjustment and color mapping parameters. If left NULL,
+    // these default to `pl_color_adjustment_neutral` and
+    // `pl_color_map_default_params`, respectively.
+    const struct pl_color_adjustment *adjustment;
+    const struct pl_color_map_params *color_map_params;
+
+    // Split the image into groups of rows processed by this many threads in
+    // parallel. 0 picks the number of online CPUs, 1 disables threading.
+    int threads;
+};
+
+// Converts the `w` x `h` image given by the three planes of `src` (in the
+// channel order of `params->repr.sys`) into the three planes of `dst`, which
+// receive the R, G and B channels, respectively. `src` and `dst` may point to
+// the same memory, as long as the planes are of the same type and stride.
+// Returns whether successful.
+bool pl_convert_planes(struct pl_context *ctx,
+                       const struct pl_convert_params *params,
+                       const struct pl_convert_plane src[3],
+                       const struct pl_convert_plane dst[3],
+                       int w, int h);
+
+#endif // LIBPLACEBO_CONVERT_H_
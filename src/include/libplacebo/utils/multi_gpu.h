@@ -0,0 +1,128 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+
+#include <libplacebo/gpu.h>
+#include <libplacebo/renderer.h>
+#include <libplacebo/utils/upload.h>
+
+#ifndef LIBPLACEBO_MULTI_GPU_H_
+#define LIBPLACEBO_MULTI_GPU_H_
+
+// This file contains a utility for spreading work across multiple GPUs (e.g.
+// one `pl_vulkan` instance per physical device), in one of two ways:
+//
+// - Multi-stream: independent streams (e.g. transcoding jobs) are each pinned
+//   to a single GPU, picking the least loaded one when the stream is opened.
+//   Renderers on the same GPU share their compiled shaders, so later streams
+//   start without recompiling anything.
+//
+// - Split-frame: a single (very large) frame is split into horizontal bands,
+//   each of which is uploaded, rendered and downloaded by a different GPU,
+//   all in parallel.
+//
+// Note: Compiled shaders are tied to the device they were compiled for, so
+// they can only be shared between streams on the same GPU. To share the
+// shader compilation itself between devices, set the same
+// `pl_vulkan_params.spirv_cache_dir` for all of them.
+
+struct pl_multi_gpu;
+
+struct pl_multi_gpu_params {
+    // The GPUs to use. These must outlive the `pl_multi_gpu`. If streams are
+    // used from multiple threads at the same time, GPUs shared by more than
+    // one of these threads must be thread-safe (see e.g.
+    // `pl_vulkan_params.thread_safe`).
+    const struct pl_gpu **gpus;
+    int num_gpus;
+
+    // Relative throughput of each GPU, used to balance the streams and bands
+    // among them. Optional, if NULL then all GPUs are weighted equally.
+    const float *weights;
+};
+
+struct pl_multi_gpu *pl_multi_gpu_create(struct pl_context *ctx,
+                                         const struct pl_multi_gpu_params *params);
+
+// All streams must be closed before destroying the `pl_multi_gpu`.
+void pl_multi_gpu_destroy(struct pl_multi_gpu **mg);
+
+// A single stream, pinned to one of the GPUs.
+struct pl_multi_stream {
+    int index;                  // index into `pl_multi_gpu_params.gpus`
+    const struct pl_gpu *gpu;
+    struct pl_renderer *rr;     // a renderer owned by this stream
+};
+
+// Opens a new stream on the GPU with the lowest number of open streams
+// (relative to its weight), and creates a renderer for it. Returns whether
+// successful. This function is thread-safe.
+bool pl_multi_gpu_open_stream(struct pl_multi_gpu *mg,
+                              struct pl_multi_stream *out);
+
+// Closes a stream, destroying its renderer. Shaders compiled by this renderer
+// are retained for future streams on the same GPU. This function is
+// thread-safe.
+void pl_multi_gpu_close_stream(struct pl_multi_gpu *mg,
+                               struct pl_multi_stream *stream);
+
+// Description of a single frame to be rendered in split-frame mode.
+struct pl_multi_gpu_frame {
+    // The source planes, which are uploaded to every GPU involved. Only host
+    // memory (`pl_plane_data.pixels`) is supported here.
+    const struct pl_plane_data *planes;
+    int num_planes;
+
+    // Metadata for the source image, with the same semantics as
+    // `pl_render_queue_frame.image`.
+    struct pl_image image;
+
+    // The output format, e.g. PL_FMT_UNORM with 4 components of 8 bits. The
+    // output is stored in host memory as `out_comps` components of
+    // `out_depth` bits each, per pixel.
+    enum pl_fmt_type out_type;
+    int out_comps;
+    int out_depth;
+
+    // The output size and memory. `out_stride` is the offset in bytes
+    // between rows of `out_data`.
+    int out_w, out_h;
+    void *out_data;
+    size_t out_stride;
+
+    // Metadata for the output. The `fbo` and `dst_rect` fields are filled in
+    // internally; the frame always covers all of `out_data`.
+    struct pl_render_target target;
+
+    // Rendering parameters to use for all bands. May be NULL (defaults).
+    // Peak detection is always disabled, since every band would otherwise
+    // end up tone mapped differently.
+    const struct pl_render_params *params;
+};
+
+// Renders a frame by splitting it into horizontal bands, one per GPU, and
+// waits for the result. Returns whether successful. Note that since every
+// band is rendered separately, position-dependent effects (e.g. dithering
+// patterns) may not line up perfectly across the band boundaries.
+//
+// This uses internal resources (and renderers) which are separate from any
+// streams, but it must not be called from multiple threads at the same time.
+bool pl_multi_gpu_render_split(struct pl_multi_gpu *mg,
+                               const struct pl_multi_gpu_frame *frame);
+
+#endif // LIBPLACEBO_MULTI_GPU_H_
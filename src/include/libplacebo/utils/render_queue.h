@@ -0,0 +1,129 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include <libplacebo/gpu.h>
+#include <libplacebo/renderer.h>
+#include <libplacebo/utils/upload.h>
+
+#ifndef LIBPLACEBO_RENDER_QUEUE_H_
+#define LIBPLACEBO_RENDER_QUEUE_H_
+
+// This file contains a utility for streaming frames from host memory, through
+// `pl_render_image`, and back into host memory, e.g. for offline transcoding.
+//
+// Doing upload -> render -> download one frame at a time forces each frame to
+// fully complete before the next one can begin. Instead, the render queue
+// keeps up to `depth` frames in flight, each with its own set of textures and
+// download buffer, so that the upload of one frame, the rendering of the
+// previous frame and the download of the one before that may all execute
+// concurrently (e.g. on the separate transfer, compute and graphics queues of
+// a vulkan device). Frames are always returned in the order they were pushed.
+//
+// A typical usage loop would look something like this:
+//
+// while (get_frame(&frame)) {
+//     while (pl_render_queue_full(queue)) {
+//         pl_render_queue_pop(queue, &out, UINT64_MAX);
+//         write_frame(&out);
+//     }
+//
+//     pl_render_queue_push(queue, &frame);
+//     while (pl_render_queue_pop(queue, &out, 0))
+//         write_frame(&out);
+// }
+//
+// while (pl_render_queue_pop(queue, &out, UINT64_MAX))
+//     write_frame(&out);
+
+struct pl_render_queue;
+
+// Creates a new render queue, using the given renderer for all frames. The
+// renderer must outlive the queue. `depth` is the maximum number of frames in
+// flight at any given time, or 0 to pick a reasonable default.
+struct pl_render_queue *pl_render_queue_create(struct pl_context *ctx,
+                                               const struct pl_gpu *gpu,
+                                               struct pl_renderer *rr,
+                                               int depth);
+
+// Destroys the queue, waiting for (and discarding) any frames still in flight.
+void pl_render_queue_destroy(struct pl_render_queue **queue);
+
+// Description of a single frame to be pushed into the queue.
+struct pl_render_queue_frame {
+    // The source planes, which are uploaded with `pl_upload_plane`. When
+    // uploading from a `pl_buf`, the buffer must not be modified until this
+    // frame has been returned by `pl_render_queue_pop`. Host memory (i.e.
+    // `pl_plane_data.pixels`) may be reused as soon as the push returns.
+    const struct pl_plane_data *planes;
+    int num_planes;
+
+    // Metadata for the source image. The `texture`, `components` and
+    // `component_mapping` fields of each plane are filled in from the
+    // uploaded textures; everything else (including `num_planes`, which
+    // must match the above) is used as-is.
+    struct pl_image image;
+
+    // The output format and size. The format must be renderable (or storable,
+    // on devices without any renderable formats), and described by a single
+    // (non-planar) `pl_fmt`.
+    const struct pl_fmt *out_fmt;
+    int out_w, out_h;
+
+    // Metadata for the output. The `fbo` field is filled in internally.
+    struct pl_render_target target;
+
+    // Rendering parameters to use for this frame. May be NULL (defaults).
+    const struct pl_render_params *params;
+
+    // Arbitrary user data, returned as-is alongside the rendered result.
+    void *priv;
+};
+
+// A rendered frame, as returned by `pl_render_queue_pop`.
+struct pl_render_queue_result {
+    void *priv;             // the `pl_render_queue_frame.priv` of this frame
+    int w, h;               // dimensions of the image
+    const struct pl_fmt *fmt;
+    const uint8_t *data;    // the downloaded image data
+    size_t row_stride;      // offset in bytes between rows
+    size_t size;            // total size of `data`, in bytes
+};
+
+// Uploads, renders and starts downloading a frame, without waiting for any
+// of these operations to complete. Returns whether successful. It's an error
+// to push a frame while the queue is full, see `pl_render_queue_full`.
+bool pl_render_queue_push(struct pl_render_queue *queue,
+                          const struct pl_render_queue_frame *frame);
+
+// Returns the oldest frame in the queue, waiting for up to `timeout`
+// nanoseconds for it to finish downloading. Returns false if the queue is
+// empty, if the timeout expired, or if reading back the frame failed (in which
+// case the frame is dropped). The returned data remains valid until the next
+// call to `pl_render_queue_push` or `pl_render_queue_destroy`.
+bool pl_render_queue_pop(struct pl_render_queue *queue,
+                         struct pl_render_queue_result *out, uint64_t timeout);
+
+// Returns whether all `depth` slots are in use, i.e. whether the oldest frame
+// needs to be popped before another one can be pushed.
+bool pl_render_queue_full(const struct pl_render_queue *queue);
+
+// Returns the number of frames currently in flight.
+int pl_render_queue_pending(const struct pl_render_queue *queue);
+
+#endif // LIBPLACEBO_RENDER_QUEUE_H_
@@ -17,6 +17,7 @@
 
 #include <stdint.h>
 
+#include <libplacebo/dispatch.h>
 #include <libplacebo/gpu.h>
 #include <libplacebo/renderer.h>
 
@@ -49,6 +50,15 @@ struct pl_plane_data {
     size_t buf_offset;          // offset of data within buffer, must be a
                                 // multiple of `pixel_stride` as well as of 4
 
+    // If set, only these regions (in pixels) of the plane are uploaded, and
+    // the rest of the texture keeps its previous contents. This can save a
+    // lot of bandwidth for content where little changes from frame to frame
+    // (e.g. desktop capture). `pixels` / `buf` still refer to the whole
+    // plane. Ignored (i.e. the whole plane is uploaded) whenever the texture
+    // needs to be (re)created, or if the regions cover most of the plane.
+    const struct pl_rect2d *rects;
+    int num_rects;
+
     // Note: When using this together with `pl_image`, there is some amount of
     // overlap between `component_pad` and `pl_color_repr.bits`. Some key
     // differences between the two:
@@ -110,4 +120,85 @@ const struct pl_fmt *pl_plane_find_fmt(const struct pl_gpu *gpu, int out_map[4],
 bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
                      const struct pl_tex **tex, const struct pl_plane_data *data);
 
+// Upload multiple image planes (e.g. all planes of a frame, or even multiple
+// frames) at once. This is equivalent to calling `pl_upload_plane` on every
+// element of `data`, `tex` and `out_planes` (optional), except that all of the
+// planes uploaded from host memory are first copied into a single staging
+// buffer, and all of the resulting transfers are recorded together. This
+// reduces the per-plane overhead compared to uploading them individually.
+// Returns whether all uploads succeeded.
+bool pl_upload_planes(const struct pl_gpu *gpu, struct pl_plane out_planes[],
+                      const struct pl_tex *tex[],
+                      const struct pl_plane_data data[], int num_planes);
+
+// A ring of persistently mapped upload buffers, which the application (e.g.
+// a decoder) can write pixel data into directly, and then upload from by
+// setting `pl_plane_data.buf` / `buf_offset` (or the equivalent fields of
+// `pl_tex_transfer_params`). This avoids the extra copy into a staging buffer
+// which uploading from host memory would otherwise require.
+//
+// The ring consists of a number of equally sized buffers ("chunks"), which
+// regions are allocated from in order. Once a chunk is full, the ring moves
+// on to the next one, waiting for the GPU to finish using it if necessary.
+// Requires PL_GPU_CAP_MAPPED_BUFFERS.
+struct pl_upload_ring;
+
+struct pl_upload_ring_params {
+    // The size of each chunk, which is also the maximum size of a single
+    // region. Required. This should normally be big enough to hold all of the
+    // planes of at least one frame.
+    size_t chunk_size;
+
+    // The number of chunks in the ring. Defaults to 4 if left as 0.
+    int num_chunks;
+};
+
+struct pl_upload_ring *pl_upload_ring_create(const struct pl_gpu *gpu,
+                                             const struct pl_upload_ring_params *params);
+
+// Destroys the ring, including all of its buffers. Any uploads still using
+// them will complete normally.
+void pl_upload_ring_destroy(struct pl_upload_ring **ring);
+
+struct pl_upload_region {
+    const struct pl_buf *buf; // buffer containing the region
+    size_t offset;            // offset of the region within `buf`
+    uint8_t *data;            // host mapped pointer to the region
+    size_t size;
+};
+
+// Allocates a region of `size` bytes from the ring, with its offset aligned to
+// a multiple of `align` (e.g. the `pixel_stride`), as well as 4 and the GPU's
+// preferred transfer offset alignment. Returns whether successful.
+//
+// The contents of `region->data` must not be modified once an upload using it
+// has been issued. The region itself remains valid until the ring wraps back
+// around to the same chunk, i.e. after `num_chunks - 1` further chunks worth
+// of allocations, so all uploads from a region must have been issued by then.
+bool pl_upload_ring_get(struct pl_upload_ring *ring,
+                        struct pl_upload_region *region,
+                        size_t size, size_t align);
+
+// Like `pl_upload_plane`, but if `pl_plane_find_fmt` fails to find a matching
+// texture format (e.g. for packed 10-bit RGB, or for components which are
+// not aligned to the texture format's host bits), the raw bytes are instead
+// uploaded to a storage buffer and unpacked into a storable texture by a
+// compute shader dispatched on `dp`. This avoids having to repack such data
+// on the CPU. Requires PL_GPU_CAP_COMPUTE for the fallback to work.
+//
+// Some notes apply to the fallback path:
+//  - only UNORM and FLOAT (16 or 32 bit) components are supported, and no
+//    single component may be larger than 32 bits
+//  - the components are read from the pixel as a little-endian bit field
+//  - when uploading from a `pl_buf`, it must be of type PL_BUF_STORAGE
+//    instead of PL_BUF_TEX_TRANSFER
+//  - `rects` is ignored, the whole plane is always unpacked
+//
+// Formats that describe more than one pixel per `pixel_stride` (e.g. v210)
+// can't be expressed as a `pl_plane_data` and are therefore not supported.
+bool pl_upload_plane_compute(const struct pl_gpu *gpu, struct pl_dispatch *dp,
+                             struct pl_plane *out_plane,
+                             const struct pl_tex **tex,
+                             const struct pl_plane_data *data);
+
 #endif // LIBPLACEBO_UPLOAD_H_
@@ -35,6 +35,10 @@ struct pl_vk_inst {
     // extensions enabled by libplacebo internally. May contain duplicates.
     const char **extensions;
     int num_extensions;
+
+    // The vulkan API version the instance was created with. libplacebo
+    // requests vulkan 1.1 if the loader supports it, and 1.0 otherwise.
+    uint32_t api_version;
 };
 
 struct pl_vk_inst_params {
@@ -106,6 +110,13 @@ struct pl_vulkan_params {
     // May be NULL. Ignored if `instance` is set.
     const struct pl_vk_inst_params *instance_params;
 
+    // The maximum vulkan API version libplacebo may rely on. If `instance` is
+    // set, this must not exceed the `VkApplicationInfo.apiVersion` it was
+    // created with, and leaving it as 0 means VK_API_VERSION_1_0. Otherwise,
+    // it defaults to the version of the internally created instance. Some
+    // features (e.g. PL_GPU_CAP_SUBGROUPS) require at least vulkan 1.1.
+    uint32_t max_api_version;
+
     // When choosing the device, rule out all devices that don't support
     // presenting to this surface. When creating a device, enable all extensions
     // needed to ensure we can present to this surface. Optional. Only legal
@@ -144,6 +155,16 @@ struct pl_vulkan_params {
     // fragment shaders. Enabled by default.
     bool async_compute;
 
+    // Creates the device without any graphics queue, using only compute (and
+    // transfer) queues. This allows using compute-only devices, and avoids
+    // contending for the graphics queue with other users of the same GPU,
+    // e.g. on headless servers. The resulting `pl_gpu` has no renderable,
+    // blendable or blittable formats, and can't create raster passes or
+    // swapchains; `pl_dispatch` and `pl_renderer` transparently execute all
+    // of their shaders as compute shaders instead. Incompatible with
+    // `surface`, and requires PL_GPU_CAP_COMPUTE. Disabled by default.
+    bool compute_only;
+
     // Limits the number of queues to request. If left as 0, this will enable
     // as many queues as the device supports. Multiple queues can result in
     // improved efficiency when submitting multiple commands that can entirely
@@ -166,6 +187,34 @@ struct pl_vulkan_params {
     // for testing purposes
     pl_gpu_caps blacklist_caps; // capabilities to be excluded
     bool disable_events;        // disables usage of VkEvent completely
+
+    // If set, compiled SPIR-V is persisted to files inside this directory
+    // (which must already exist), and shaders found there are never
+    // compiled again. Entries are keyed by the shader source and compiler
+    // version, so the directory may be shared between processes and
+    // devices. Independently of this, identical shaders are only ever
+    // compiled once per `pl_gpu`.
+    const char *spirv_cache_dir;
+
+    // If enabled, the resulting `pl_gpu` may be used from multiple threads
+    // at the same time, e.g. to stream texture uploads from one thread while
+    // rendering from another. Every thread records into its own command
+    // buffers, and only the actual queue submission is serialized.
+    //
+    // Individual objects (textures, buffers, passes, timers, dispatch and
+    // renderer instances etc.) must still only be used by one thread at a
+    // time. Before handing an object over to another thread, the thread
+    // that last used it must call `pl_gpu_flush`, so its commands are
+    // ordered before those of the receiving thread. Disabled by default,
+    // since it adds some locking overhead.
+    bool thread_safe;
+
+    // If enabled, and the device supports VK_EXT_descriptor_indexing, all
+    // sampleable textures are additionally placed into a device-global
+    // descriptor heap, and PL_GPU_CAP_BINDLESS is exposed. `pl_dispatch`
+    // then binds textures by writing their heap index to a push constant,
+    // instead of updating a descriptor set for every pass.
+    bool bindless;
 };
 
 // Default/recommended parameters. Should generally be safe and efficient.
@@ -186,6 +235,21 @@ const struct pl_vulkan *pl_vulkan_create(struct pl_context *ctx,
 // destroyed by the user before calling this.
 void pl_vulkan_destroy(const struct pl_vulkan **vk);
 
+// Occupancy counters for a single queue, see `pl_vulkan_queue_load`
+struct pl_vulkan_queue_load {
+    int index;          // queue family index
+    int queue;          // queue index within the family
+    int pending;        // commands currently queued or executing
+    uint64_t submitted; // total number of commands submitted so far
+};
+
+// Retrieves the occupancy counters of all queues in use, e.g. to diagnose
+// the load balance between multiple independent streams sharing the same
+// `pl_gpu`. Writes at most `num` entries to `out`, and returns the total
+// number of queues. (So `num` may be 0 to query the required size)
+int pl_vulkan_queue_load(const struct pl_vulkan *vk,
+                         struct pl_vulkan_queue_load *out, int num);
+
 struct pl_vulkan_device_params {
     // The instance to use. Required!
     VkInstance instance;
@@ -230,6 +294,16 @@ struct pl_vulkan_swapchain_params {
     // Optional, defaults to 3.
     int swapchain_depth;
 
+    // Enables a low-latency mode, intended for interactive use cases. In this
+    // mode, VK_PRESENT_MODE_MAILBOX_KHR is used instead of `present_mode`
+    // whenever it's supported, and the number of in-flight frames is adjusted
+    // dynamically: it gets lowered (down to 1) while the GPU is keeping up
+    // with rendering, and raised again (up to `swapchain_depth`) as soon as
+    // `pl_swapchain_swap_buffers` starts spending a significant fraction of
+    // the frame time waiting for it. `pl_swapchain_latency` always reports
+    // the current depth.
+    bool low_latency;
+
     // This suppresses automatic recreation of the swapchain when any call
     // returns VK_SUBOPTIMAL_KHR. Normally, libplacebo will recreate the
     // swapchain internally on the next `pl_swapchain_start_frame`. If enabled,
@@ -17,6 +17,10 @@
 
 #include <lcms2.h>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "context.h"
 #include "lcms.h"
@@ -160,15 +164,192 @@ static void error_callback(cmsContext cms, cmsUInt32Number code,
     pl_err(ctx, "lcms2: [%d] %s", (int) code, msg);
 }
 
+// Upper bound on the number of worker threads used for a single LUT
+#define LUT_THREADS_MAX 16
+
+struct lut_slice {
+    cmsHTRANSFORM trafo;
+    float *out_data;
+    int s_r, s_g, s_b;
+    int b_start, b_end; // range of blue slices to compute, [start, end)
+};
+
+static void *compute_slices(void *arg)
+{
+    struct lut_slice *sl = arg;
+    uint16_t *tmp = talloc_array(NULL, uint16_t, sl->s_r * 3);
+    const int s_r = sl->s_r, s_g = sl->s_g, s_b = sl->s_b;
+
+    for (int b = sl->b_start; b < sl->b_end; b++) {
+        for (int g = 0; g < s_g; g++) {
+            // Fill in a single line of the temporary buffer
+            for (int r = 0; r < s_r; r++) {
+                tmp[r * 3 + 0] = r * 65535 / (s_r - 1);
+                tmp[r * 3 + 1] = g * 65535 / (s_g - 1);
+                tmp[r * 3 + 2] = b * 65535 / (s_b - 1);
+            }
+
+            // Transform this line into the right output position
+            size_t offset = (b * s_g + g) * s_r * 4;
+            cmsDoTransform(sl->trafo, tmp, sl->out_data + offset, s_r);
+        }
+    }
+
+    talloc_free(tmp);
+    return NULL;
+}
+
+// On-disk cache entries consist of this header, followed by the raw LUT data
+struct lut_cache_header {
+    char magic[4];
+    uint32_t api_ver;
+    uint32_t lcms_ver;
+    int32_t s_r, s_g, s_b;
+    struct pl_3dlut_result result;
+};
+
+static const char lut_cache_magic[4] = {'p', 'l', '3', 'd'};
+
+static uint64_t profile_hash(const struct pl_3dlut_profile *prof)
+{
+    struct {
+        uint64_t icc;
+        int32_t primaries;
+        int32_t transfer;
+        int32_t light;
+        float sig_peak;
+        float sig_avg;
+        float sig_scale;
+    } key;
+
+    // Zero the whole struct explicitly, so the hash is stable
+    memset(&key, 0, sizeof(key));
+    key.icc = prof->profile.len ? siphash64(prof->profile.data, prof->profile.len) : 0;
+    key.primaries = prof->color.primaries;
+    key.transfer = prof->color.transfer;
+    key.light = prof->color.light;
+    key.sig_peak = prof->color.sig_peak;
+    key.sig_avg = prof->color.sig_avg;
+    key.sig_scale = prof->color.sig_scale;
+    return siphash64((const uint8_t *) &key, sizeof(key));
+}
+
+static uint64_t lut_cache_key(enum pl_rendering_intent intent,
+                              const struct pl_3dlut_profile *src,
+                              const struct pl_3dlut_profile *dst,
+                              int s_r, int s_g, int s_b)
+{
+    struct {
+        uint64_t src;
+        uint64_t dst;
+        int32_t intent;
+        int32_t s_r, s_g, s_b;
+    } key;
+
+    memset(&key, 0, sizeof(key));
+    key.src = profile_hash(src);
+    key.dst = profile_hash(dst);
+    key.intent = intent;
+    key.s_r = s_r;
+    key.s_g = s_g;
+    key.s_b = s_b;
+    return siphash64((const uint8_t *) &key, sizeof(key));
+}
+
+static char *lut_cache_path(void *tactx, const char *cache_dir, uint64_t key)
+{
+    return talloc_asprintf(tactx, "%s/%016"PRIx64".3dlut", cache_dir, key);
+}
+
+static bool lut_cache_load(struct pl_context *ctx, const char *cache_dir,
+                           uint64_t key, float *out_data, int s_r, int s_g,
+                           int s_b, struct pl_3dlut_result *out)
+{
+    char *path = lut_cache_path(NULL, cache_dir, key);
+    FILE *f = fopen(path, "rb");
+    talloc_free(path);
+    if (!f)
+        return false;
+
+    struct lut_cache_header hdr;
+    size_t size = (size_t) s_r * s_g * s_b * 4 * sizeof(float);
+    bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = ok && memcmp(hdr.magic, lut_cache_magic, sizeof(hdr.magic)) == 0 &&
+         hdr.api_ver == PL_API_VER && hdr.lcms_ver == LCMS_VERSION &&
+         hdr.s_r == s_r && hdr.s_g == s_g && hdr.s_b == s_b;
+    ok = ok && fread(out_data, 1, size, f) == size;
+    fclose(f);
+
+    if (!ok) {
+        pl_warn(ctx, "Ignoring invalid 3DLUT cache entry %016"PRIx64, key);
+        return false;
+    }
+
+    *out = hdr.result;
+    return true;
+}
+
+static void lut_cache_save(struct pl_context *ctx, const char *cache_dir,
+                           uint64_t key, const float *data, int s_r, int s_g,
+                           int s_b, const struct pl_3dlut_result *res)
+{
+    struct lut_cache_header hdr = {
+        .api_ver = PL_API_VER,
+        .lcms_ver = LCMS_VERSION,
+        .s_r = s_r,
+        .s_g = s_g,
+        .s_b = s_b,
+        .result = *res,
+    };
+    memcpy(hdr.magic, lut_cache_magic, sizeof(hdr.magic));
+
+    // Write to a temporary file first, so that concurrent processes never
+    // observe partially written entries
+    char *path = lut_cache_path(NULL, cache_dir, key);
+    char *tmp = talloc_asprintf(path, "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!f) {
+        pl_warn(ctx, "Failed writing 3DLUT cache entry '%s'", tmp);
+        if (fd >= 0) {
+            close(fd);
+            remove(tmp);
+        }
+        goto done;
+    }
+
+    size_t size = (size_t) s_r * s_g * s_b * 4 * sizeof(float);
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok &= fwrite(data, 1, size, f) == size;
+    ok &= fclose(f) == 0;
+    if (!ok || rename(tmp, path) != 0) {
+        pl_warn(ctx, "Failed writing 3DLUT cache entry '%s'", path);
+        remove(tmp);
+    }
+
+done:
+    talloc_free(path);
+}
+
 bool pl_lcms_compute_lut(struct pl_context *ctx, enum pl_rendering_intent intent,
                          struct pl_3dlut_profile src, struct pl_3dlut_profile dst,
                          float *out_data, int s_r, int s_g, int s_b,
+                         int threads, const char *cache_dir,
                          struct pl_3dlut_result *out)
 {
     bool ret = false;
     cmsHPROFILE srcp = NULL, dstp = NULL;
     cmsHTRANSFORM trafo = NULL;
-    uint16_t *tmp = NULL;
+
+    pl_assert(s_r > 1 && s_g > 1 && s_b > 1);
+    uint64_t key = 0;
+    if (cache_dir) {
+        key = lut_cache_key(intent, &src, &dst, s_r, s_g, s_b);
+        if (lut_cache_load(ctx, cache_dir, key, out_data, s_r, s_g, s_b, out)) {
+            pl_debug(ctx, "Using cached 3DLUT %016"PRIx64" from disk", key);
+            return true;
+        }
+    }
 
     cmsContext cms = cmsCreateContext(NULL, ctx);
     if (!cms)
@@ -181,30 +362,53 @@ bool pl_lcms_compute_lut(struct pl_context *ctx, enum pl_rendering_intent intent
         goto error;
 
 
-    uint32_t flags = cmsFLAGS_HIGHRESPRECALC | cmsFLAGS_BLACKPOINTCOMPENSATION;
+    // The single-pixel cache is not thread safe, and pointless for a LUT
+    uint32_t flags = cmsFLAGS_HIGHRESPRECALC | cmsFLAGS_BLACKPOINTCOMPENSATION |
+                     cmsFLAGS_NOCACHE;
     trafo = cmsCreateTransformTHR(cms, srcp, TYPE_RGB_16, dstp, TYPE_RGBA_FLT,
                                   intent, flags);
     if (!trafo)
         goto error;
 
-    pl_assert(s_r > 1 && s_g > 1 && s_b > 1);
-    tmp = talloc_array(NULL, uint16_t, s_r * 3);
-
-    for (int b = 0; b < s_b; b++) {
-        for (int g = 0; g < s_g; g++) {
-            // Fill in a single line of the temporary buffer
-            for (int r = 0; r < s_r; r++) {
-                tmp[r * 3 + 0] = r * 65535 / (s_r - 1);
-                tmp[r * 3 + 1] = g * 65535 / (s_g - 1);
-                tmp[r * 3 + 2] = b * 65535 / (s_b - 1);
-            }
+    if (!threads) {
+#ifdef _SC_NPROCESSORS_ONLN
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    threads = PL_MAX(PL_MIN(PL_MIN(threads, LUT_THREADS_MAX), s_b), 1);
+
+    // Split the LUT into groups of blue slices, one per thread
+    struct lut_slice slices[LUT_THREADS_MAX];
+    pthread_t workers[LUT_THREADS_MAX];
+    for (int i = 0; i < threads; i++) {
+        slices[i] = (struct lut_slice) {
+            .trafo = trafo,
+            .out_data = out_data,
+            .s_r = s_r,
+            .s_g = s_g,
+            .s_b = s_b,
+            .b_start = i * s_b / threads,
+            .b_end = (i + 1) * s_b / threads,
+        };
+    }
 
-            // Transform this line into the right output position
-            size_t offset = (b * s_g + g) * s_r * 4;
-            cmsDoTransform(trafo, tmp, out_data + offset, s_r);
-        }
+    int spawned = 1;
+    for (; spawned < threads; spawned++) {
+        if (pthread_create(&workers[spawned], NULL, compute_slices, &slices[spawned]))
+            break;
     }
 
+    // The calling thread computes the first group itself, as well as any
+    // groups we failed spawning a thread for
+    compute_slices(&slices[0]);
+    for (int i = spawned; i < threads; i++)
+        compute_slices(&slices[i]);
+    for (int i = 1; i < spawned; i++)
+        pthread_join(workers[i], NULL);
+
+    if (cache_dir)
+        lut_cache_save(ctx, cache_dir, key, out_data, s_r, s_g, s_b, out);
+
     ret = true;
     // fall through
 
@@ -218,6 +422,5 @@ error:
     if (cms)
         cmsDeleteContext(cms);
 
-    TA_FREEP(&tmp);
     return ret;
 }
@@ -21,8 +21,11 @@
 
 // Compute a transformation from one color profile to another, and fill the
 // provided array by the resulting 3DLUT. The array must have room for four
-// components per sample.
+// components per sample. The work is split across up to `threads` threads
+// (0 for one per CPU). If `cache_dir` is set, the result is looked up in (and
+// otherwise saved to) an on-disk cache in that directory.
 bool pl_lcms_compute_lut(struct pl_context *ctx, enum pl_rendering_intent intent,
                          struct pl_3dlut_profile src, struct pl_3dlut_profile dst,
                          float *out_data, int s_r, int s_g, int s_b,
+                         int threads, const char *cache_dir,
                          struct pl_3dlut_result *out);
@@ -15,6 +15,7 @@
  * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include <math.h>
 
 #include "common.h"
@@ -53,8 +54,85 @@ enum {
 struct sampler {
     struct pl_shader_obj *upscaler_state;
     struct pl_shader_obj *downscaler_state;
-    const struct pl_tex *sep_fbo_up;
-    const struct pl_tex *sep_fbo_down;
+};
+
+// Intermediate FBOs are transient resources shared between all passes: an FBO
+// is held from the moment a pass renders to it until the pass sampling from it
+// gets dispatched, after which its memory can be reused by any later pass (of
+// the same or a future frame) that needs a texture of the same size. FBOs
+// which go unused for FBO_MAX_IDLE frames are released.
+//
+// To avoid reallocating FBOs whenever the image or output size changes (e.g.
+// while resizing a window), their dimensions are rounded up to size classes
+// (see `fbo_size_class`), and only the top left corner of each FBO actually
+// contains an image. This region is passed on to the samplers as the
+// `pl_sample_src.valid_rect`.
+#define FBO_MAX_IDLE 10
+
+// Minimum width of the overlay atlas. Overlays are packed into rows of this
+// width, and the height grows as needed (up to the maximum texture size)
+#define OVERLAY_ATLAS_WIDTH 1024
+
+// Margin (in source pixels) kept around the damaged region of the target when
+// cropping the image for partial re-rendering. This covers the radius of all
+// built-in scalers, including chroma upscaling of subsampled planes.
+#define DAMAGE_MARGIN 8
+
+struct fbo {
+    const struct pl_tex *tex;
+    bool held;
+    bool pinned; // stays held after being sampled, until explicitly released
+    int idle; // number of frames this FBO has gone unused
+};
+
+// Frames rendered (scaled and color converted) as part of a frame mix, which
+// can be reused as-is by subsequent mixes including the same source frame
+struct cached_frame {
+    uint64_t signature;
+    const struct pl_tex *tex;
+    int w, h;   // size of the image in `tex`, which may be larger
+    bool valid; // `tex` contains the result of rendering `signature`
+    bool used;  // part of the current mix
+};
+
+// Levels of automatic quality scaling, from best to worst. Each level
+// includes all of the degradations of the previous levels.
+enum {
+    QUALITY_FULL = 0,       // no degradation
+    QUALITY_ORTHO,          // polar scalers -> separable (ortho) scalers
+    QUALITY_BICUBIC,        // expensive ortho scalers -> bicubic
+    QUALITY_BILINEAR,       // all scalers -> built-in bilinear
+    QUALITY_NO_DEBAND,      // disable debanding
+    QUALITY_CHEAP_TONEMAP,  // cheaper tone mapping, disable sigmoidization
+    QUALITY_NO_PEAK_DETECT, // disable HDR peak detection
+    QUALITY_LEVELS,
+};
+
+// Tuning of the quality scaling heuristic, in frames
+#define QUALITY_OVER_FRAMES   3   // frames over budget before degrading
+#define QUALITY_UNDER_FRAMES  120 // frames with headroom before improving
+#define QUALITY_COOLDOWN      8   // frames to wait for new measurements
+#define QUALITY_STALE_FRAMES  1800 // age after which measurements are retried
+
+// Everything that determines the output of `pl_render_image`
+struct redraw_state {
+    struct pl_image image;
+    struct pl_render_target target; // without `fbo` and overlays
+    const struct pl_fmt *fmt;       // format of `target.fbo`
+    struct pl_render_params params;
+};
+
+struct stage_range {
+    uint64_t start, end; // dispatch markers, see `pl_dispatch_gpu_time`
+    enum pl_render_stage stage;
+};
+
+// State for `pl_render_params.color_map_3dlut_size`
+struct baked_lut {
+    struct pl_shader_obj *lut;
+    struct pl_color_space src, dst;
+    struct pl_color_map_params cmap;
+    bool ok; // result of the most recent bake
 };
 
 struct pl_renderer {
@@ -74,18 +152,74 @@ struct pl_renderer {
     bool disable_blending;      // disable blending for the target/fbofmt
     bool disable_overlay;       // disable rendering overlays
     bool disable_3dlut;         // disable usage of a 3DLUT
+    bool disable_baked_lut;     // disable baking the color map into a 3DLUT
     bool disable_peak_detect;   // disable peak detection shader
+    bool disable_quality;       // disable automatic quality scaling
+    bool disable_atlas;         // disable drawing overlays from an atlas
 
     // Shader resource objects and intermediate textures (FBOs)
     struct pl_shader_obj *peak_detect_state;
     struct pl_shader_obj *dither_state;
     struct pl_shader_obj *lut3d_state;
-    const struct pl_tex *main_scale_fbo;
-    const struct pl_tex *deband_fbos[PLANE_COUNT];
-    const struct pl_tex *output_fbo;
+    struct pl_shader_obj *tone_map_state;
+    struct baked_lut baked_lut;
+    struct fbo *fbos;
+    int num_fbos;
     struct sampler samplers[SCALER_COUNT];
     struct sampler *osd_samplers;
     int num_osd_samplers;
+
+    // Atlas texture for drawing overlays in batches (see `draw_overlay_atlas`)
+    const struct pl_tex *osd_atlas;
+    struct pl_rect2d *osd_quads; // position of each overlay inside the atlas
+
+    // Frame cache for `pl_render_image_mix`, plus the state it was rendered
+    // with. Any change to the latter invalidates all cached frames.
+    struct cached_frame *frames;
+    int num_frames;
+    struct pl_color_space mix_color;
+    struct pl_render_params mix_params;
+
+    // Set if the last `pl_render_image` had to use `fallback_params`, or
+    // skipped the ICC 3DLUT because it was still being computed
+    bool used_fallback;
+    bool lut3d_pending;
+
+    // Output cache for `pl_render_image`. `redraw_state` describes the most
+    // recently rendered frame, and `redraw_fbo` contains its output (minus
+    // the target overlays) if `redraw_valid` is set.
+    struct redraw_state redraw_state;
+    bool has_redraw_state;
+    const struct pl_tex *redraw_fbo;
+    bool redraw_valid;
+
+    // Automatic quality scaling (`pl_render_params.frame_budget`). `quality`
+    // is the current level of degradation (0 = none), and `quality_cost`
+    // records the most recently measured GPU time for each level, as well as
+    // the frame at which it was measured.
+    bool quality_enabled;
+    int quality;
+    uint64_t quality_mark;   // dispatch marker at the start of the last frame
+    uint64_t quality_frames; // number of frames rendered
+    int quality_over;        // consecutive frames spent over budget
+    int quality_under;       // consecutive frames spent well under budget
+    int quality_cooldown;    // frames to ignore after changing levels
+    uint64_t quality_cost[QUALITY_LEVELS];
+    uint64_t quality_cost_frame[QUALITY_LEVELS];
+    struct pl_color_map_params quality_cmap;
+
+    // Per-stage statistics (`pl_render_params.frame_stats`). During a frame,
+    // every dispatched pass is recorded as a range of dispatch markers tagged
+    // with the `stage` that was current at the time, and the totals are
+    // computed from these once the outermost render call returns.
+    bool stats_enabled;
+    bool disable_stats;
+    bool has_stats;
+    int stats_nesting;
+    enum pl_render_stage stage;
+    struct stage_range *stage_ranges;
+    int num_stage_ranges;
+    struct pl_render_stats stats;
 };
 
 static void find_fbo_format(struct pl_renderer *rr)
@@ -110,13 +244,23 @@ static void find_fbo_format(struct pl_renderer *rr)
         {PL_FMT_UNORM, 8, PL_FMT_CAP_SAMPLEABLE},
     };
 
-    for (int i = 0; i < PL_ARRAY_SIZE(configs); i++) {
-        const struct pl_fmt *fmt;
-        fmt = pl_find_fmt(rr->gpu, configs[i].type, 4, configs[i].depth, 0,
-                          configs[i].caps | PL_FMT_CAP_RENDERABLE);
-        if (fmt) {
-            rr->fbofmt = fmt;
-            break;
+    // Devices without graphics support (e.g. `pl_vulkan_params.compute_only`)
+    // have no renderable formats at all. In this case, fall back to storable
+    // FBOs, which `pl_dispatch_finish` draws to using compute shaders
+    static const enum pl_fmt_caps fbo_caps[] = {
+        PL_FMT_CAP_RENDERABLE,
+        PL_FMT_CAP_STORABLE,
+    };
+
+    for (int n = 0; n < PL_ARRAY_SIZE(fbo_caps) && !rr->fbofmt; n++) {
+        for (int i = 0; i < PL_ARRAY_SIZE(configs); i++) {
+            const struct pl_fmt *fmt;
+            fmt = pl_find_fmt(rr->gpu, configs[i].type, 4, configs[i].depth, 0,
+                              configs[i].caps | fbo_caps[n]);
+            if (fmt) {
+                rr->fbofmt = fmt;
+                break;
+            }
         }
     }
 
@@ -125,6 +269,9 @@ static void find_fbo_format(struct pl_renderer *rr)
         return;
     }
 
+    if (!(rr->fbofmt->caps & PL_FMT_CAP_RENDERABLE))
+        PL_INFO(rr, "Found no renderable FBO format; using compute shaders only");
+
     if (!(rr->fbofmt->caps & PL_FMT_CAP_STORABLE)) {
         PL_INFO(rr, "Found no storable FBO format; compute shaders disabled");
         rr->disable_compute = true;
@@ -162,8 +309,6 @@ static void sampler_destroy(struct pl_renderer *rr, struct sampler *sampler)
 {
     pl_shader_obj_destroy(&sampler->upscaler_state);
     pl_shader_obj_destroy(&sampler->downscaler_state);
-    pl_tex_destroy(rr->gpu, &sampler->sep_fbo_up);
-    pl_tex_destroy(rr->gpu, &sampler->sep_fbo_down);
 }
 
 void pl_renderer_destroy(struct pl_renderer **p_rr)
@@ -173,15 +318,15 @@ void pl_renderer_destroy(struct pl_renderer **p_rr)
         return;
 
     // Free all intermediate FBOs
-    pl_tex_destroy(rr->gpu, &rr->main_scale_fbo);
-    for (int i = 0; i < PL_ARRAY_SIZE(rr->deband_fbos); i++)
-        pl_tex_destroy(rr->gpu, &rr->deband_fbos[i]);
-    pl_tex_destroy(rr->gpu, &rr->output_fbo);
+    for (int i = 0; i < rr->num_fbos; i++)
+        pl_tex_destroy(rr->gpu, &rr->fbos[i].tex);
 
     // Free all shader resource objects
     pl_shader_obj_destroy(&rr->peak_detect_state);
     pl_shader_obj_destroy(&rr->dither_state);
     pl_shader_obj_destroy(&rr->lut3d_state);
+    pl_shader_obj_destroy(&rr->tone_map_state);
+    pl_shader_obj_destroy(&rr->baked_lut.lut);
 
     // Free all samplers
     for (int i = 0; i < PL_ARRAY_SIZE(rr->samplers); i++)
@@ -189,15 +334,38 @@ void pl_renderer_destroy(struct pl_renderer **p_rr)
     for (int i = 0; i < rr->num_osd_samplers; i++)
         sampler_destroy(rr, &rr->osd_samplers[i]);
 
+    // Free all cached frames
+    for (int i = 0; i < rr->num_frames; i++)
+        pl_tex_destroy(rr->gpu, &rr->frames[i].tex);
+    pl_tex_destroy(rr->gpu, &rr->redraw_fbo);
+    pl_tex_destroy(rr->gpu, &rr->osd_atlas);
+
     pl_dispatch_destroy(&rr->dp);
     TA_FREEP(p_rr);
 }
 
 void pl_renderer_flush_cache(struct pl_renderer *rr)
 {
+    for (int i = 0; i < rr->num_frames; i++)
+        pl_tex_destroy(rr->gpu, &rr->frames[i].tex);
+    rr->num_frames = 0;
+    pl_tex_destroy(rr->gpu, &rr->redraw_fbo);
+    rr->redraw_valid = rr->has_redraw_state = false;
+
     pl_shader_obj_destroy(&rr->peak_detect_state);
 }
 
+size_t pl_renderer_save(struct pl_renderer *rr, uint8_t *out)
+{
+    return pl_dispatch_save(rr->dp, out);
+}
+
+void pl_renderer_load(struct pl_renderer *rr, const uint8_t *cache,
+                      size_t size)
+{
+    pl_dispatch_load(rr->dp, cache, size);
+}
+
 const struct pl_render_params pl_render_default_params = {
     .upscaler           = &pl_filter_spline36,
     .downscaler         = &pl_filter_mitchell,
@@ -235,8 +403,8 @@ static inline struct pl_tex_params img_params(struct pl_renderer *rr,
             .h = img->h,
             .format = fmt,
             .sampleable = true,
-            .renderable = true,
             // Just enable what we can
+            .renderable = !!(fmt->caps & PL_FMT_CAP_RENDERABLE),
             .storable   = !!(fmt->caps & PL_FMT_CAP_STORABLE),
             .sample_mode = (fmt->caps & PL_FMT_CAP_LINEAR)
                                 ? PL_TEX_SAMPLE_LINEAR
@@ -244,26 +412,145 @@ static inline struct pl_tex_params img_params(struct pl_renderer *rr,
     };
 }
 
+// Rounds a texture dimension up to the next multiple of 1/8 of the largest
+// power of two below it (but at least 64), limited to `max`. This wastes at
+// most 12.5% in either dimension for large textures.
+static int fbo_size_class(int size, int max)
+{
+    int step = 64;
+    while (step * 16 <= size)
+        step <<= 1;
+    return PL_MIN(PL_ALIGN2(size, step), max);
+}
+
+// Returns `params` with the texture size rounded up to its size class
+static struct pl_tex_params fbo_params(struct pl_renderer *rr,
+                                       const struct pl_tex_params *params)
+{
+    int max = PL_MIN(rr->gpu->limits.max_tex_2d_dim, INT_MAX);
+    struct pl_tex_params fixed = *params;
+    fixed.w = fbo_size_class(params->w, max);
+    fixed.h = fbo_size_class(params->h, max);
+    return fixed;
+}
+
+// Acquires an FBO from the pool, reusing the memory of a released FBO of the
+// same size class if possible. The image of size `params->w` x `params->h`
+// must be rendered to (and sampled from) the top left corner of the FBO.
+static const struct pl_tex *get_fbo(struct pl_renderer *rr,
+                                    const struct pl_tex_params *params)
+{
+    struct pl_tex_params fixed = fbo_params(rr, params);
+    struct fbo *fbo = NULL;
+    for (int i = 0; i < rr->num_fbos; i++) {
+        const struct pl_tex *tex = rr->fbos[i].tex;
+        if (rr->fbos[i].held || !tex)
+            continue;
+        if (tex->params.w == fixed.w && tex->params.h == fixed.h &&
+            tex->params.format == fixed.format)
+        {
+            fbo = &rr->fbos[i];
+            break;
+        }
+    }
+
+    if (!fbo) {
+        TARRAY_GROW(rr, rr->fbos, rr->num_fbos);
+        fbo = &rr->fbos[rr->num_fbos++];
+        *fbo = (struct fbo) {0};
+    }
+
+    // For a reused FBO, this just invalidates the previous contents
+    if (!pl_tex_recreate(rr->gpu, &fbo->tex, &fixed))
+        return NULL;
+
+    fbo->held = true;
+    fbo->idle = 0;
+    return fbo->tex;
+}
+
+// Returns all pooled FBOs sampled by `sh` to the pool. Must only be called
+// right before `sh` gets dispatched or aborted.
+static void release_fbos(struct pl_renderer *rr, const struct pl_shader *sh)
+{
+    if (!sh)
+        return;
+
+    for (int i = 0; i < sh->res.num_descriptors; i++) {
+        const void *obj = sh->res.descriptors[i].object;
+        for (int n = 0; n < rr->num_fbos; n++) {
+            if (rr->fbos[n].tex == obj && !rr->fbos[n].pinned)
+                rr->fbos[n].held = false;
+        }
+    }
+}
+
+// Attributes all passes dispatched since `mark` to the current stage
+static void record_passes(struct pl_renderer *rr, uint64_t mark)
+{
+    uint64_t now = pl_dispatch_mark(rr->dp);
+    if (!rr->stats_enabled || now == mark)
+        return;
+
+    struct stage_range *last = NULL;
+    if (rr->num_stage_ranges)
+        last = &rr->stage_ranges[rr->num_stage_ranges - 1];
+
+    if (last && last->stage == rr->stage && last->end == mark) {
+        last->end = now;
+        return;
+    }
+
+    TARRAY_APPEND(rr, rr->stage_ranges, rr->num_stage_ranges,
+                  (struct stage_range) { mark, now, rr->stage });
+}
+
+// Wrapper around `pl_dispatch_finish` which releases the shader's FBOs
+static bool finish_pass(struct pl_renderer *rr, struct pl_shader **sh,
+                        const struct pl_tex *target, const struct pl_rect2d *rc,
+                        const struct pl_blend_params *blend)
+{
+    release_fbos(rr, *sh);
+    uint64_t mark = pl_dispatch_mark(rr->dp);
+    bool ok = pl_dispatch_finish(rr->dp, sh, target, rc, blend);
+    record_passes(rr, mark);
+    return ok;
+}
+
+// Called once per frame, to release FBOs that are no longer needed
+static void gc_fbos(struct pl_renderer *rr)
+{
+    for (int i = rr->num_fbos - 1; i >= 0; i--) {
+        struct fbo *fbo = &rr->fbos[i];
+        if (fbo->tex && ++fbo->idle <= FBO_MAX_IDLE)
+            continue;
+
+        pl_tex_destroy(rr->gpu, &fbo->tex);
+        TARRAY_REMOVE_AT(rr->fbos, rr->num_fbos, i);
+    }
+}
+
 static const struct pl_tex *finalize_img(struct pl_renderer *rr,
                                          struct img *img,
-                                         const struct pl_fmt *fmt,
-                                         const struct pl_tex **tex)
+                                         const struct pl_fmt *fmt)
 {
     struct pl_tex_params tex_params = img_params(rr, img, fmt);
-    bool ok = pl_tex_recreate(rr->gpu, tex, &tex_params);
-    if (!ok) {
+    const struct pl_tex *tex = get_fbo(rr, &tex_params);
+    if (!tex) {
         PL_ERR(rr, "Failed creating FBO texture! Disabling advanced rendering..");
         rr->fbofmt = NULL;
         pl_dispatch_abort(rr->dp, &img->sh);
         return NULL;
     }
 
-    if (!pl_dispatch_finish(rr->dp, &img->sh, *tex, NULL, NULL)) {
-        PL_ERR(rr, "Failed dispatching intermediate pass!");
+    struct pl_rect2d rc = { 0, 0, img->w, img->h };
+    if (!finish_pass(rr, &img->sh, tex, &rc, NULL)) {
+        if (!pl_dispatch_pending(rr->dp))
+            PL_ERR(rr, "Failed dispatching intermediate pass!");
         return NULL;
     }
 
-    return *tex;
+    return tex;
 }
 
 struct pass_state {
@@ -276,6 +563,7 @@ struct pass_state {
 enum sampler_type {
     SAMPLER_DIRECT, // texture()'s built in sampling
     SAMPLER_BICUBIC, // fast bicubic scaling
+    SAMPLER_NEAREST, // fast nearest neighbour scaling
     SAMPLER_COMPLEX, // complex custom filters
 };
 
@@ -326,16 +614,31 @@ static struct sampler_info sample_src_info(struct pl_renderer *rr,
                 info.type = SAMPLER_BICUBIC;
             if (is_linear && info.config == &pl_filter_triangle)
                 info.type = SAMPLER_DIRECT;
-            if (!is_linear && info.config == &pl_filter_box)
-                info.type = SAMPLER_DIRECT;
+            if (info.config == &pl_filter_box)
+                info.type = is_linear ? SAMPLER_NEAREST : SAMPLER_DIRECT;
+        }
+
+        // Box filtering by exactly 0.5x is just a single bilinear tap in
+        // between each group of 2x2 texels, provided they're aligned
+        bool aligned = src->rect.x0 == floorf(src->rect.x0) &&
+                       src->rect.y0 == floorf(src->rect.y0);
+        if (is_linear && info.config == &pl_filter_box && aligned &&
+            fabs(rx - 0.5) < 1e-6 && fabs(ry - 0.5) < 1e-6 &&
+            !params->disable_builtin_scalers)
+        {
+            info.type = SAMPLER_DIRECT;
         }
     }
 
     return info;
 }
 
+// If `no_compute` is set, the sampler avoids compute shaders. This is used
+// when the result gets dispatched to (or merged into a pass that renders to)
+// a non-storable target, since a compute shader would force an extra round
+// trip through an intermediate FBO in that case.
 static void dispatch_sampler(struct pl_renderer *rr, struct pl_shader *sh,
-                             struct sampler *sampler,
+                             struct sampler *sampler, bool no_compute,
                              const struct pl_render_params *params,
                              const struct pl_sample_src *src)
 {
@@ -344,17 +647,14 @@ static void dispatch_sampler(struct pl_renderer *rr, struct pl_shader *sh,
 
     struct sampler_info info = sample_src_info(rr, src, params);
     struct pl_shader_obj **lut = NULL;
-    const struct pl_tex **sep_fbo = NULL;
     switch (info.dir) {
     case SAMPLER_NOOP:
         goto fallback;
     case SAMPLER_DOWN:
         lut = &sampler->downscaler_state;
-        sep_fbo = &sampler->sep_fbo_down;
         break;
     case SAMPLER_UP:
         lut = &sampler->upscaler_state;
-        sep_fbo = &sampler->sep_fbo_up;
         break;
     }
 
@@ -364,24 +664,36 @@ static void dispatch_sampler(struct pl_renderer *rr, struct pl_shader *sh,
     case SAMPLER_BICUBIC:
         pl_shader_sample_bicubic(sh, src);
         return;
+    case SAMPLER_NEAREST:
+        pl_shader_sample_nearest(sh, src);
+        return;
     case SAMPLER_COMPLEX:
         break; // continue below
     }
 
-    pl_assert(lut && sep_fbo);
+    pl_assert(lut);
     struct pl_sample_filter_params fparams = {
         .filter      = *info.config,
         .lut_entries = params->lut_entries,
         .cutoff      = params->polar_cutoff,
         .antiring    = params->antiringing_strength,
-        .no_compute  = rr->disable_compute,
+        .no_compute  = rr->disable_compute || no_compute,
         .no_widening = params->skip_anti_aliasing,
         .lut         = lut,
     };
 
+    // For the main scaler, both separated passes can be performed by a single
+    // compute shader, which then also gets the output color pipeline merged
+    // into it, avoiding the intermediate FBO altogether
+    bool fuse = sampler == &rr->samplers[SCALER_MAIN] && !fparams.no_compute;
+
     bool ok;
     if (info.config->polar) {
         ok = pl_shader_sample_polar(sh, src, &fparams);
+    } else if (fuse && pl_shader_sample_ortho2d(sh, src, &fparams)) {
+        ok = true;
+    } else if (pl_shader_is_failed(sh)) {
+        ok = false; // don't try falling back on a failed shader
     } else {
         struct pl_shader *tsh = pl_dispatch_begin_ex(rr->dp, true);
         ok = pl_shader_sample_ortho(tsh, PL_SEP_VERT, src, &fparams);
@@ -390,18 +702,29 @@ static void dispatch_sampler(struct pl_renderer *rr, struct pl_shader *sh,
             goto done;
         }
 
+        // The first pass preserves the valid width of the source, but moves
+        // it to the left edge of the intermediate FBO
+        struct pl_rect2d bounds = src->valid_rect;
         struct img img = {
             .sh = tsh,
-            .w  = src->tex->params.w,
+            .w  = PL_DEF(pl_rect_w(bounds), src->tex->params.w),
             .h  = src->new_h,
         };
 
         struct pl_sample_src src2 = *src;
-        src2.tex = finalize_img(rr, &img, rr->fbofmt, sep_fbo);
+        src2.tex = finalize_img(rr, &img, rr->fbofmt);
+        src2.rect.x0 -= bounds.x0;
+        src2.rect.x1 -= bounds.x0;
+        src2.valid_rect = (struct pl_rect2d) { 0, 0, img.w, img.h };
         ok = src2.tex && pl_shader_sample_ortho(sh, PL_SEP_HORIZ, &src2, &fparams);
     }
 
 done:
+    if (!ok && pl_dispatch_pending(rr->dp)) {
+        PL_TRACE(rr, "Scaler still compiling, using fallback");
+        goto fallback;
+    }
+
     if (!ok) {
         PL_ERR(rr, "Failed dispatching scaler.. disabling");
         rr->disable_sampling = true;
@@ -415,6 +738,281 @@ fallback:
     pl_shader_sample_direct(sh, src);
 }
 
+static const struct pl_blend_params overlay_blend = {
+    .src_rgb = PL_BLEND_SRC_ALPHA,
+    .dst_rgb = PL_BLEND_ONE_MINUS_SRC_ALPHA,
+    .src_alpha = PL_BLEND_ONE,
+    .dst_alpha = PL_BLEND_ONE_MINUS_SRC_ALPHA,
+};
+
+static struct pl_rect2d overlay_rect(const struct pl_overlay *ol,
+                                     const struct pl_transform2x2 *scale)
+{
+    struct pl_rect2d rect = ol->rect;
+    if (scale) {
+        float v0[2] = { rect.x0, rect.y0 };
+        float v1[2] = { rect.x1, rect.y1 };
+        pl_transform2x2_apply(scale, v0);
+        pl_transform2x2_apply(scale, v1);
+        rect = (struct pl_rect2d) { v0[0], v0[1], v1[0], v1[1] };
+    }
+
+    return rect;
+}
+
+// Converts the sampled overlay texture (in `color`) to the output color,
+// given the (vec3) monochrome base color `base_color`.
+static void overlay_color(struct pl_shader *sh, const struct pl_overlay *ol,
+                          ident_t base_color, struct pl_color_space color,
+                          bool use_sigmoid, const struct pl_render_params *params)
+{
+    const struct pl_plane *plane = &ol->plane;
+    const struct pl_tex *tex = plane->texture;
+    int comps = ol->mode == PL_OVERLAY_MONOCHROME ? 1 : plane->components;
+
+    GLSL("vec4 osd_color;\n");
+    for (int c = 0; c < comps; c++) {
+        if (plane->component_mapping[c] < 0)
+            continue;
+        GLSL("osd_color[%d] = color[%d];\n", plane->component_mapping[c],
+             tex->params.format->sample_order[c]);
+    }
+
+    switch (ol->mode) {
+    case PL_OVERLAY_NORMAL:
+        GLSL("color = osd_color;\n");
+        break;
+    case PL_OVERLAY_MONOCHROME:
+        GLSL("color.a = osd_color[0];\n");
+        GLSL("color.rgb = %s;\n", base_color);
+        break;
+    default: abort();
+    }
+
+    struct pl_color_repr repr = ol->repr;
+    pl_shader_decode_color(sh, &repr, NULL);
+    pl_shader_color_map(sh, params->color_map_params, ol->color, color,
+                        NULL, false);
+
+    if (use_sigmoid)
+        pl_shader_sigmoidize(sh, params->sigmoid_params);
+}
+
+// Draws a single overlay using its own pass. Returns false on fatal errors.
+static bool draw_overlay(struct pl_renderer *rr, const struct pl_tex *fbo,
+                         const struct pl_overlay *ol, struct pl_rect2d rect,
+                         struct sampler *sampler, struct pl_color_space color,
+                         bool use_sigmoid, const struct pl_render_params *params)
+{
+    const struct pl_plane *plane = &ol->plane;
+    const struct pl_tex *tex = plane->texture;
+
+    struct pl_sample_src src = {
+        .tex        = tex,
+        .components = ol->mode == PL_OVERLAY_MONOCHROME ? 1 : plane->components,
+        .new_w      = abs(pl_rect_w(rect)),
+        .new_h      = abs(pl_rect_h(rect)),
+        .rect = {
+            -plane->shift_x,
+            -plane->shift_y,
+            tex->params.w - plane->shift_x,
+            tex->params.h - plane->shift_y,
+        },
+    };
+
+    if (params->disable_overlay_sampling)
+        sampler = NULL;
+
+    struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+    dispatch_sampler(rr, sh, sampler, !fbo->params.storable, params, &src);
+
+    ident_t base_color = NULL;
+    if (ol->mode == PL_OVERLAY_MONOCHROME) {
+        base_color = sh_var(sh, (struct pl_shader_var) {
+            .var  = pl_var_vec3("base_color"),
+            .data = &ol->base_color,
+            .dynamic = true,
+        });
+    }
+
+    overlay_color(sh, ol, base_color, color, use_sigmoid, params);
+
+    const struct pl_blend_params *blend = &overlay_blend;
+    if (rr->disable_blending)
+        blend = NULL;
+
+    if (!finish_pass(rr, &sh, fbo, &rect, blend)) {
+        if (pl_dispatch_pending(rr->dp))
+            return true; // try again next frame
+        PL_ERR(rr, "Failed rendering overlay texture!");
+        rr->disable_overlay = true;
+        return false;
+    }
+
+    return true;
+}
+
+// Whether an overlay can be drawn from the atlas, which requires it to be
+// copied there as-is, and drawn without any scaling
+static bool overlay_atlas_ok(const struct pl_overlay *ol, struct pl_rect2d rect)
+{
+    const struct pl_tex *tex = ol->plane.texture;
+    enum pl_fmt_caps caps = tex->params.format->caps;
+    return tex->params.blit_src && (caps & PL_FMT_CAP_BLITTABLE) &&
+           (caps & PL_FMT_CAP_SAMPLEABLE) &&
+           !ol->plane.shift_x && !ol->plane.shift_y &&
+           abs(pl_rect_w(rect)) == tex->params.w &&
+           abs(pl_rect_h(rect)) == tex->params.h;
+}
+
+// Whether two overlays can be drawn from the same atlas, using the same pass
+static bool overlay_atlas_compat(const struct pl_overlay *a,
+                                 const struct pl_overlay *b)
+{
+    const struct pl_plane *pa = &a->plane, *pb = &b->plane;
+    return pa->texture->params.format == pb->texture->params.format &&
+           a->mode == b->mode && pa->components == pb->components &&
+           !memcmp(pa->component_mapping, pb->component_mapping,
+                   sizeof(pa->component_mapping)) &&
+           pl_color_repr_equal(&a->repr, &b->repr) &&
+           pl_color_space_equal(&a->color, &b->color);
+}
+
+// Copies a run of compatible overlays into the atlas texture, and draws all of
+// them using a single pass. Returns the number of overlays consumed, which may
+// be less than `num` if they don't all fit into the atlas; or 0 if the atlas
+// could not be used at all.
+static int draw_overlay_atlas(struct pl_renderer *rr, const struct pl_tex *fbo,
+                              const struct pl_overlay *overlays, int num,
+                              struct pl_color_space color, bool use_sigmoid,
+                              const struct pl_transform2x2 *scale,
+                              const struct pl_render_params *params)
+{
+    const struct pl_gpu *gpu = rr->gpu;
+    int max_dim = gpu->limits.max_tex_2d_dim;
+
+    // Pack the overlays into rows ("shelves"), in order
+    int atlas_w = 0;
+    for (int n = 0; n < num; n++)
+        atlas_w = PL_MAX(atlas_w, overlays[n].plane.texture->params.w);
+    atlas_w = PL_MIN(PL_MAX(atlas_w, OVERLAY_ATLAS_WIDTH), max_dim);
+
+    TARRAY_GROW(rr, rr->osd_quads, num - 1);
+    int x = 0, y = 0, row_h = 0, count = 0;
+    for (; count < num; count++) {
+        const struct pl_tex *tex = overlays[count].plane.texture;
+        int w = tex->params.w, h = tex->params.h;
+        if (x + w > atlas_w) {
+            y += row_h;
+            x = row_h = 0;
+        }
+        if (y + h > max_dim)
+            break;
+
+        rr->osd_quads[count] = (struct pl_rect2d) { x, y, x + w, y + h };
+        x += w;
+        row_h = PL_MAX(row_h, h);
+    }
+
+    if (count < 2)
+        return 0;
+
+    // Only ever grow the atlas, to avoid re-creating it every frame
+    const struct pl_fmt *fmt = overlays[0].plane.texture->params.format;
+    const struct pl_tex *atlas = rr->osd_atlas;
+    int atlas_h = y + row_h;
+    if (atlas && atlas->params.format == fmt) {
+        atlas_w = PL_MAX(atlas_w, atlas->params.w);
+        atlas_h = PL_MAX(atlas_h, atlas->params.h);
+    }
+
+    bool ok = pl_tex_recreate(gpu, &rr->osd_atlas, &(struct pl_tex_params) {
+        .w              = atlas_w,
+        .h              = atlas_h,
+        .format         = fmt,
+        .sampleable     = true,
+        .blit_dst       = true,
+        .sample_mode    = PL_TEX_SAMPLE_NEAREST,
+    });
+
+    if (!ok) {
+        PL_WARN(rr, "Failed creating overlay atlas, drawing overlays "
+                "individually");
+        rr->disable_atlas = true;
+        return 0;
+    }
+
+    atlas = rr->osd_atlas;
+    const struct pl_overlay *ol = &overlays[0];
+    struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+    sh_describe(sh, "overlay atlas");
+
+    // All of the attribute values are replaced by `pl_dispatch_finish_quads`
+    static const struct pl_rect2df dummy = {0};
+    ident_t pos, tex = sh_bind(sh, atlas, "osd_atlas", NULL, &pos, NULL, NULL);
+    ident_t base_color = NULL;
+    if (ol->mode == PL_OVERLAY_MONOCHROME) {
+        // The base color is passed as two vec2 attributes (constant across
+        // each quad), since the dispatch only supports vec2 attributes
+        ident_t rg = sh_attr_vec2(sh, "base_rg", &dummy),
+                b  = sh_attr_vec2(sh, "base_b", &dummy);
+        base_color = sh_fresh(sh, "base_color");
+        GLSL("vec3 %s = vec3(%s, %s.x);\n", base_color, rg, b);
+    }
+
+    GLSL("vec4 color = %s(%s, %s);\n", sh_tex_fn(sh, atlas), tex, pos);
+    overlay_color(sh, ol, base_color, color, use_sigmoid, params);
+
+    int num_attrs = sh->res.num_vertex_attribs;
+    struct pl_rect2d *rects = talloc_array(NULL, struct pl_rect2d, count);
+    struct pl_rect2df *attrs = talloc_array(rects, struct pl_rect2df,
+                                            count * num_attrs);
+
+    pl_gpu_batch(gpu, true);
+    for (int n = 0; n < count; n++) {
+        const struct pl_tex *src = overlays[n].plane.texture;
+        const struct pl_rect2d *slot = &rr->osd_quads[n];
+        pl_tex_blit(gpu, atlas, src,
+                    (struct pl_rect3d) { slot->x0, slot->y0, 0, slot->x1, slot->y1, 1 },
+                    (struct pl_rect3d) { 0, 0, 0, src->params.w, src->params.h, 1 });
+
+        rects[n] = overlay_rect(&overlays[n], scale);
+        struct pl_rect2df *va = &attrs[n * num_attrs];
+        va[0] = (struct pl_rect2df) {
+            .x0 = (float) slot->x0 / atlas->params.w,
+            .y0 = (float) slot->y0 / atlas->params.h,
+            .x1 = (float) slot->x1 / atlas->params.w,
+            .y1 = (float) slot->y1 / atlas->params.h,
+        };
+
+        if (ol->mode == PL_OVERLAY_MONOCHROME) {
+            const float *c = overlays[n].base_color;
+            va[1] = (struct pl_rect2df) { c[0], c[1], c[0], c[1] };
+            va[2] = (struct pl_rect2df) { c[2], 0.0, c[2], 0.0 };
+        }
+    }
+
+    const struct pl_blend_params *blend = &overlay_blend;
+    if (rr->disable_blending)
+        blend = NULL;
+
+    release_fbos(rr, sh);
+    uint64_t mark = pl_dispatch_mark(rr->dp);
+    ok = pl_dispatch_finish_quads(rr->dp, &sh, fbo, rects, attrs, count, blend);
+    record_passes(rr, mark);
+    pl_gpu_batch(gpu, false);
+    talloc_free(rects);
+
+    if (!ok && !pl_dispatch_pending(rr->dp)) {
+        PL_WARN(rr, "Failed rendering overlay atlas, drawing overlays "
+                "individually");
+        rr->disable_atlas = true;
+        return 0;
+    }
+
+    return count;
+}
+
 static void draw_overlays(struct pl_renderer *rr, const struct pl_tex *fbo,
                           const struct pl_overlay *overlays, int num,
                           struct pl_color_space color, bool use_sigmoid,
@@ -424,8 +1022,11 @@ static void draw_overlays(struct pl_renderer *rr, const struct pl_tex *fbo,
     if (num <= 0 || rr->disable_overlay)
         return;
 
+    // Non-renderable targets are drawn to with compute shaders, which
+    // implement blending by themselves
     enum pl_fmt_caps caps = fbo->params.format->caps;
-    if (!rr->disable_blending && !(caps & PL_FMT_CAP_BLENDABLE)) {
+    bool blendable = (caps & PL_FMT_CAP_BLENDABLE) || !fbo->params.renderable;
+    if (!rr->disable_blending && !blendable) {
         PL_WARN(rr, "Trying to draw an overlay to a non-blendable target. "
                 "Alpha blending is disabled, results may be incorrect!");
         rr->disable_blending = true;
@@ -436,87 +1037,36 @@ static void draw_overlays(struct pl_renderer *rr, const struct pl_tex *fbo,
                       (struct sampler) {0});
     }
 
-    for (int n = 0; n < num; n++) {
+    for (int n = 0; n < num;) {
         const struct pl_overlay *ol = &overlays[n];
-        const struct pl_plane *plane = &ol->plane;
-        const struct pl_tex *tex = plane->texture;
-
-        struct pl_rect2d rect = ol->rect;
-        if (scale) {
-            float v0[2] = { rect.x0, rect.y0 };
-            float v1[2] = { rect.x1, rect.y1 };
-            pl_transform2x2_apply(scale, v0);
-            pl_transform2x2_apply(scale, v1);
-            rect = (struct pl_rect2d) { v0[0], v0[1], v1[0], v1[1] };
+        struct pl_rect2d rect = overlay_rect(ol, scale);
+
+        // Runs of compatible, unscaled overlays (e.g. subtitle glyphs) are
+        // drawn from a shared atlas texture in a single pass
+        int run = 1;
+        if (!rr->disable_atlas && overlay_atlas_ok(ol, rect)) {
+            while (n + run < num &&
+                   overlay_atlas_compat(ol, &overlays[n + run]) &&
+                   overlay_atlas_ok(&overlays[n + run],
+                                    overlay_rect(&overlays[n + run], scale)))
+            {
+                run++;
+            }
         }
 
-        struct pl_sample_src src = {
-            .tex        = tex,
-            .components = ol->mode == PL_OVERLAY_MONOCHROME ? 1 : plane->components,
-            .new_w      = abs(pl_rect_w(rect)),
-            .new_h      = abs(pl_rect_h(rect)),
-            .rect = {
-                -plane->shift_x,
-                -plane->shift_y,
-                tex->params.w - plane->shift_x,
-                tex->params.h - plane->shift_y,
-            },
-        };
-
-        struct sampler *sampler = &rr->osd_samplers[n];
-        if (params->disable_overlay_sampling)
-            sampler = NULL;
-
-        struct pl_shader *sh = pl_dispatch_begin(rr->dp);
-        dispatch_sampler(rr, sh, sampler, params, &src);
-
-        GLSL("vec4 osd_color;\n");
-        for (int c = 0; c < src.components; c++) {
-            if (plane->component_mapping[c] < 0)
+        if (run > 1) {
+            int done = draw_overlay_atlas(rr, fbo, ol, run, color, use_sigmoid,
+                                          scale, params);
+            if (done) {
+                n += done;
                 continue;
-            GLSL("osd_color[%d] = color[%d];\n", plane->component_mapping[c],
-                 tex->params.format->sample_order[c]);
-        }
-
-        switch (ol->mode) {
-        case PL_OVERLAY_NORMAL:
-            GLSL("color = osd_color;\n");
-            break;
-        case PL_OVERLAY_MONOCHROME:
-            GLSL("color.a = osd_color[0];\n");
-            GLSL("color.rgb = %s;\n", sh_var(sh, (struct pl_shader_var) {
-                .var  = pl_var_vec3("base_color"),
-                .data = &ol->base_color,
-                .dynamic = true,
-            }));
-            break;
-        default: abort();
+            }
         }
 
-        struct pl_color_repr repr = ol->repr;
-        pl_shader_decode_color(sh, &repr, NULL);
-        pl_shader_color_map(sh, params->color_map_params, ol->color, color,
-                            NULL, false);
-
-        if (use_sigmoid)
-            pl_shader_sigmoidize(sh, params->sigmoid_params);
-
-        static const struct pl_blend_params blend_params = {
-            .src_rgb = PL_BLEND_SRC_ALPHA,
-            .dst_rgb = PL_BLEND_ONE_MINUS_SRC_ALPHA,
-            .src_alpha = PL_BLEND_ONE,
-            .dst_alpha = PL_BLEND_ONE_MINUS_SRC_ALPHA,
-        };
-
-        const struct pl_blend_params *blend = &blend_params;
-        if (rr->disable_blending)
-            blend = NULL;
-
-        if (!pl_dispatch_finish(rr->dp, &sh, fbo, &rect, blend)) {
-            PL_ERR(rr, "Failed rendering overlay texture!");
-            rr->disable_overlay = true;
+        if (!draw_overlay(rr, fbo, ol, rect, &rr->osd_samplers[n], color,
+                          use_sigmoid, params))
             return;
-        }
+        n++;
     }
 }
 
@@ -528,8 +1078,7 @@ enum {
 };
 
 static int deband_src(struct pl_renderer *rr, struct pl_shader *psh,
-                      struct pl_sample_src *psrc, const struct pl_tex **fbo,
-                      const struct pl_image *image,
+                      struct pl_sample_src *psrc, const struct pl_image *image,
                       const struct pl_render_params *params)
 {
     if (rr->disable_debanding || !params->deband_params)
@@ -582,7 +1131,12 @@ static int deband_src(struct pl_renderer *rr, struct pl_shader *psh,
                 * image->color.sig_scale;
     dparams.grain /= scale;
 
-    pl_shader_deband(sh, src, &dparams);
+    // When debanding in a separate pass, prefer the compute shader version,
+    // which serves the randomized samples from shared memory
+    bool use_compute = sh != psh && !rr->disable_compute &&
+                       (rr->fbofmt->caps & PL_FMT_CAP_STORABLE);
+    if (!use_compute || !pl_shader_deband_compute(sh, src, &dparams))
+        pl_shader_deband(sh, src, &dparams);
 
     if (deband_scales)
         return DEBAND_SCALED;
@@ -593,7 +1147,12 @@ static int deband_src(struct pl_renderer *rr, struct pl_shader *psh,
         .h  = src->new_h,
     };
 
-    const struct pl_tex *new = finalize_img(rr, &img, rr->fbofmt, fbo);
+    enum pl_render_stage stage = rr->stage;
+    rr->stage = PL_RENDER_STAGE_DEBAND;
+    const struct pl_tex *new = finalize_img(rr, &img, rr->fbofmt);
+    rr->stage = stage;
+    if (!new && pl_dispatch_pending(rr->dp))
+        return DEBAND_NOOP;
     if (!new) {
         PL_ERR(rr, "Failed dispatching debanding shader.. disabling debanding!");
         rr->disable_debanding = true;
@@ -606,6 +1165,7 @@ static int deband_src(struct pl_renderer *rr, struct pl_shader *psh,
     psrc->rect.y0 -= src->rect.y0;
     psrc->rect.x1 -= src->rect.x0;
     psrc->rect.y1 -= src->rect.y0;
+    psrc->valid_rect = (struct pl_rect2d) { 0, 0, img.w, img.h };
     psrc->scale = 1.0;
     return DEBAND_NORMAL;
 }
@@ -650,6 +1210,7 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
                             const struct pl_image *image,
                             const struct pl_render_params *params)
 {
+    rr->stage = PL_RENDER_STAGE_READ;
     struct pl_shader *sh = pl_dispatch_begin_ex(rr->dp, true);
     sh_require(sh, PL_SHADER_SIG_NONE, 0, 0);
 
@@ -744,8 +1305,8 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
             },
         };
 
-        if (deband_src(rr, psh, &src, &rr->deband_fbos[i], image, params) != DEBAND_SCALED)
-            dispatch_sampler(rr, psh, &rr->samplers[i], params, &src);
+        if (deband_src(rr, psh, &src, image, params) != DEBAND_SCALED)
+            dispatch_sampler(rr, psh, &rr->samplers[i], false, params, &src);
 
         ident_t sub = sh_subpass(sh, psh);
         if (!sub) {
@@ -802,6 +1363,85 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
     return true;
 }
 
+// Returns the stage to attribute the pass reading the image to, which also
+// contains the peak detection if enabled (see `hdr_update_peak`)
+static enum pl_render_stage read_stage(const struct pl_renderer *rr)
+{
+    return rr->peak_detect_state ? PL_RENDER_STAGE_PEAK_DETECT
+                                 : PL_RENDER_STAGE_READ;
+}
+
+// Downscaling ratio below which to prefilter the image (see below)
+#define PREFILTER_RATIO 0.25
+
+// For extreme downscaling ratios, the main scaler's filter kernel would need
+// to be widened by the full inverse ratio, blowing up the number of taps. So
+// instead, first reduce the image with a mipmap-style pyramid of 2x2 box
+// filters (a single bilinear sample in between four texels each) until it's
+// within 2x of the target size. Updates `src` in-place.
+static bool prefilter_main(struct pl_renderer *rr, struct pl_sample_src *src,
+                           const struct pl_render_params *params)
+{
+    float w = pl_rect_w(src->rect), h = pl_rect_h(src->rect);
+    float rx = src->new_w / w, ry = src->new_h / h;
+    if (params->disable_downscaling_prefilter)
+        return true;
+    if (PL_MIN(rx, ry) >= PREFILTER_RATIO)
+        return true;
+
+    if (w < 0 || h < 0 || src->tex->params.sample_mode != PL_TEX_SAMPLE_LINEAR) {
+        PL_TRACE(rr, "Skipping downscaling prefilter (flipped or not linear)");
+        return true;
+    }
+
+    while (rx < 0.5 || ry < 0.5) {
+        int fx = rx < 0.5 ? 2 : 1, fy = ry < 0.5 ? 2 : 1;
+        struct img img = {
+            .w = ceilf(w / fx),
+            .h = ceilf(h / fy),
+        };
+
+        struct pl_tex_params tex_params = img_params(rr, &img, rr->fbofmt);
+        const struct pl_tex *fbo = get_fbo(rr, &tex_params);
+        if (!fbo) {
+            PL_ERR(rr, "Failed creating prefilter FBO!");
+            return false;
+        }
+
+        struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+        sh_describe(sh, "downscaling prefilter");
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) {
+            .tex        = src->tex,
+            .components = src->components,
+            .new_w      = img.w,
+            .new_h      = img.h,
+            .rect       = {
+                .x0 = src->rect.x0,
+                .y0 = src->rect.y0,
+                .x1 = src->rect.x0 + fx * img.w,
+                .y1 = src->rect.y0 + fy * img.h,
+            },
+            .valid_rect = src->valid_rect,
+        });
+
+        struct pl_rect2d rc = { 0, 0, img.w, img.h };
+        if (!finish_pass(rr, &sh, fbo, &rc, NULL)) {
+            PL_ERR(rr, "Failed dispatching downscaling prefilter!");
+            return false;
+        }
+
+        w /= fx;
+        h /= fy;
+        rx *= fx;
+        ry *= fy;
+        src->tex = fbo;
+        src->rect = (struct pl_rect2df) { 0, 0, w, h };
+        src->valid_rect = rc;
+    }
+
+    return true;
+}
+
 static bool pass_scale_main(struct pl_renderer *rr, struct pass_state *pass,
                             const struct pl_image *image,
                             const struct pl_render_target *target,
@@ -858,16 +1498,34 @@ static bool pass_scale_main(struct pl_renderer *rr, struct pass_state *pass,
     if (use_sigmoid)
         pl_shader_sigmoidize(img->sh, params->sigmoid_params);
 
-    src.tex = finalize_img(rr, img, rr->fbofmt, &rr->main_scale_fbo);
+    rr->stage = read_stage(rr);
+    src.tex = finalize_img(rr, img, rr->fbofmt);
     if (!src.tex)
         return false;
+    src.valid_rect = (struct pl_rect2d) { 0, 0, img->w, img->h };
 
     // Draw overlay on top of the intermediate image if needed
+    rr->stage = PL_RENDER_STAGE_OVERLAYS;
     draw_overlays(rr, src.tex, image->overlays, image->num_overlays,
                   img->color, use_sigmoid, NULL, params);
+    rr->stage = PL_RENDER_STAGE_SCALE;
+
+    if (info.dir == SAMPLER_DOWN && info.type == SAMPLER_COMPLEX &&
+        !prefilter_main(rr, &src, params))
+    {
+        return false;
+    }
+
+    // The main scaler always ends up merged into the output pass, so avoid
+    // compute shaders if that would prevent us from rendering to the target
+    // directly
+    bool no_compute = !target->fbo->params.storable;
+    if (no_compute)
+        PL_TRACE(rr, "Target not storable, avoiding compute for main scaler");
 
     struct pl_shader *sh = pl_dispatch_begin_ex(rr->dp, true);
-    dispatch_sampler(rr, sh, &rr->samplers[SCALER_MAIN], params, &src);
+    dispatch_sampler(rr, sh, &rr->samplers[SCALER_MAIN], no_compute, params,
+                     &src);
     pass->cur_img = (struct img) {
         .sh     = sh,
         .w      = src.new_w,
@@ -883,6 +1541,145 @@ static bool pass_scale_main(struct pl_renderer *rr, struct pass_state *pass,
     return true;
 }
 
+// Encodes the (fully color mapped) output color to the target representation,
+// including dithering
+static void encode_output(struct pl_renderer *rr, struct pl_shader *sh,
+                          const struct pl_render_target *target,
+                          const struct pl_render_params *params)
+{
+    pl_shader_encode_color(sh, &target->repr);
+
+    // FIXME: Technically we should try dithering before bit shifting if we're
+    // going to be encoding to a low bit depth, since the caller might end up
+    // discarding the extra bits. Ideally, we would pull the `bit_shift` out
+    // of the `target->repr` and apply it separately after dithering.
+
+    if (params->dither_params) {
+        // Just assume the first component's depth is canonical. This works
+        // in practice, since for cases like rgb565 we want to use the lower
+        // depth anyway. Plus, every format has at least one component.
+        int fmt_depth = target->fbo->params.format->component_depth[0];
+        int depth = PL_DEF(target->repr.bits.sample_depth, fmt_depth);
+
+        // Ignore dithering for >16-bit FBOs, since it's pretty pointless
+        if (depth <= 16)
+            pl_shader_dither(sh, depth, &rr->dither_state, params->dither_params);
+    }
+}
+
+static bool color_map_params_eq(const struct pl_color_map_params *a,
+                                const struct pl_color_map_params *b)
+{
+    return a->intent                == b->intent &&
+           a->tone_mapping_algo     == b->tone_mapping_algo &&
+           a->tone_mapping_param    == b->tone_mapping_param &&
+           a->desaturation_strength == b->desaturation_strength &&
+           a->desaturation_exponent == b->desaturation_exponent &&
+           a->desaturation_base     == b->desaturation_base &&
+           a->max_boost             == b->max_boost &&
+           a->gamut_warning         == b->gamut_warning;
+}
+
+// Evaluates the color mapping shader on the lattice points of the 3DLUT. The
+// lattice is laid out as `d` slices of `w`x`h` texels stacked on top of each
+// other, which directly matches the memory layout expected by `sh_lut`
+static void fill_baked_lut(void *priv, float *data, int w, int h, int d)
+{
+    struct pl_renderer *rr = priv;
+    struct baked_lut *bl = &rr->baked_lut;
+    const struct pl_gpu *gpu = rr->gpu;
+    bl->ok = false;
+
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 32, 32,
+                                           PL_FMT_CAP_RENDERABLE);
+    if (!fmt || h * d > gpu->limits.max_tex_2d_dim)
+        return;
+
+    const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = w,
+        .h = h * d,
+        .format = fmt,
+        .renderable = true,
+        .host_readable = true,
+    });
+
+    if (!tex)
+        return;
+
+    struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+    sh_require(sh, PL_SHADER_SIG_NONE, w, h * d);
+    sh_describe(sh, "3DLUT baking");
+    GLSL("vec4 color;                                                   \n"
+         "// fill_baked_lut                                             \n"
+         "{                                                             \n"
+         "ivec2 pos = ivec2(gl_FragCoord.xy);                           \n"
+         "vec3 idx = vec3(pos.x, pos.y %% %d, pos.y / %d);              \n"
+         "color = vec4(idx * vec3(1.0 / %f, 1.0 / %f, 1.0 / %f), 1.0);  \n"
+         "}                                                             \n",
+         h, h, w - 1.0, h - 1.0, d - 1.0);
+    pl_shader_color_map(sh, &bl->cmap, bl->src, bl->dst, NULL, false);
+
+    bl->ok = pl_dispatch_finish(rr->dp, &sh, tex, NULL, NULL);
+    bl->ok = bl->ok && pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = data,
+    });
+
+    pl_tex_destroy(gpu, &tex);
+}
+
+// Applies the color mapping from `src` to `dst` using a baked 3DLUT, if
+// enabled and possible. Returns false if the caller should fall back to
+// regular color mapping.
+static bool pass_baked_lut(struct pl_renderer *rr, struct pl_shader *sh,
+                           struct pl_color_space src, struct pl_color_space dst,
+                           const struct pl_color_map_params *cmap,
+                           const struct pl_render_params *params)
+{
+    int size = params->color_map_3dlut_size;
+    if (!size || rr->disable_baked_lut || rr->peak_detect_state)
+        return false;
+    if (src.transfer == PL_COLOR_TRC_LINEAR || dst.transfer == PL_COLOR_TRC_LINEAR)
+        return false;
+
+    size = PL_MAX(size, 2);
+    struct baked_lut *bl = &rr->baked_lut;
+    bool changed = !pl_color_space_equal(&bl->src, &src) ||
+                   !pl_color_space_equal(&bl->dst, &dst) ||
+                   !color_map_params_eq(&bl->cmap, cmap);
+
+    // The lattice is evaluated with the exact tone mapping curves
+    bl->src = src;
+    bl->dst = dst;
+    bl->cmap = *cmap;
+    bl->cmap.tone_mapping_lut_size = 0;
+    bl->cmap.tone_mapping_lut = NULL;
+
+    ident_t lut = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &bl->lut,
+        .method = SH_LUT_LINEAR,
+        .precision = SH_LUT_UNORM16,
+        .width = size,
+        .height = size,
+        .depth = size,
+        .comps = 4,
+        .update = changed,
+        .priv = rr,
+        .fill = fill_baked_lut,
+    });
+
+    if (!lut || !bl->ok) {
+        PL_WARN(rr, "Failed baking the color mapping into a 3DLUT, disabling..");
+        pl_shader_obj_destroy(&bl->lut);
+        rr->disable_baked_lut = true;
+        return false;
+    }
+
+    sh_describe(sh, "color mapping (3DLUT)");
+    GLSL("color.rgb = %s(color.rgb).rgb; \n", lut);
+    return true;
+}
+
 static bool pass_output_target(struct pl_renderer *rr, struct pass_state *pass,
                                const struct pl_image *image,
                                const struct pl_render_target *target,
@@ -899,6 +1696,12 @@ static bool pass_output_target(struct pl_renderer *rr, struct pass_state *pass,
     if (pass->cur_img.color.transfer == PL_COLOR_TRC_LINEAR)
         prelinearized = true;
 
+    // Provide the state object for the tone mapping LUT, if requested
+    struct pl_color_map_params cmap;
+    cmap = *PL_DEF(params->color_map_params, &pl_color_map_default_params);
+    if (cmap.tone_mapping_lut_size && !cmap.tone_mapping_lut)
+        cmap.tone_mapping_lut = &rr->tone_map_state;
+
     bool use_3dlut = image->profile.data || target->profile.data ||
                      params->force_3dlut;
     if (rr->disable_3dlut)
@@ -920,14 +1723,21 @@ static bool pass_output_target(struct pl_renderer *rr, struct pass_state *pass,
         struct pl_3dlut_result res;
         bool ok = pl_3dlut_update(sh, &src, &dst, &rr->lut3d_state, &res,
                                   params->lut3d_params);
-        if (!ok) {
+        if (!ok && res.pending) {
+            // Still being computed in the background, so just skip it for
+            // now and try again on the next frame
+            PL_TRACE(rr, "3DLUT still pending, rendering without it");
+            rr->lut3d_pending = true;
+            use_3dlut = false;
+            goto fallback;
+        } else if (!ok) {
             rr->disable_3dlut = true;
             use_3dlut = false;
             goto fallback;
         }
 
         // current -> 3DLUT in
-        pl_shader_color_map(sh, params->color_map_params, ref, res.src_color,
+        pl_shader_color_map(sh, &cmap, ref, res.src_color,
                             &rr->peak_detect_state, prelinearized);
         // 3DLUT in -> 3DLUT out
         pl_3dlut_apply(sh, &rr->lut3d_state);
@@ -949,9 +1759,11 @@ fallback:
 
 #endif
 
-    if (!use_3dlut) {
+    if (!use_3dlut && (prelinearized ||
+                       !pass_baked_lut(rr, sh, ref, target->color, &cmap, params)))
+    {
         // current -> target
-        pl_shader_color_map(sh, params->color_map_params, ref, target->color,
+        pl_shader_color_map(sh, &cmap, ref, target->color,
                             &rr->peak_detect_state, prelinearized);
     }
 
@@ -961,40 +1773,31 @@ fallback:
 
     bool is_comp = pl_shader_is_compute(sh);
     if (is_comp && !fbo->params.storable) {
-        bool ok = finalize_img(rr, &pass->cur_img, rr->fbofmt, &rr->output_fbo);
-        if (!ok) {
+        rr->stage = PL_RENDER_STAGE_COLOR_MAP;
+        const struct pl_tex *tex = finalize_img(rr, &pass->cur_img, rr->fbofmt);
+        if (!tex) {
             PL_ERR(rr, "Failed dispatching compute shader to intermediate FBO?");
             return false;
         }
 
-        sh = pass->cur_img.sh = pl_dispatch_begin(rr->dp);
+        struct img *img = &pass->cur_img;
+        struct pl_rect2d rc = { 0, 0, img->w, img->h };
+        sh = img->sh = pl_dispatch_begin(rr->dp);
         pl_shader_sample_direct(sh, &(struct pl_sample_src) {
-            .tex = rr->output_fbo,
+            .tex        = tex,
+            .valid_rect = rc,
         });
     }
 
-    pl_shader_encode_color(sh, &target->repr);
+    encode_output(rr, sh, target, params);
+    pl_assert(fbo->params.renderable || fbo->params.storable);
+    rr->stage = PL_RENDER_STAGE_OUTPUT;
+    return finish_pass(rr, &pass->cur_img.sh, fbo, &target->dst_rect, NULL);
+}
 
-    // FIXME: Technically we should try dithering before bit shifting if we're
-    // going to be encoding to a low bit depth, since the caller might end up
-    // discarding the extra bits. Ideally, we would pull the `bit_shift` out
-    // of the `target->repr` and apply it separately after dithering.
-
-    if (params->dither_params) {
-        // Just assume the first component's depth is canonical. This works
-        // in practice, since for cases like rgb565 we want to use the lower
-        // depth anyway. Plus, every format has at least one component.
-        int fmt_depth = fbo->params.format->component_depth[0];
-        int depth = PL_DEF(target->repr.bits.sample_depth, fmt_depth);
-
-        // Ignore dithering for >16-bit FBOs, since it's pretty pointless
-        if (depth <= 16)
-            pl_shader_dither(sh, depth, &rr->dither_state, params->dither_params);
-    }
-
-    pl_assert(fbo->params.renderable);
-    return pl_dispatch_finish(rr->dp, &pass->cur_img.sh, fbo,
-                              &target->dst_rect, NULL);
+static bool damage_unset(struct pl_rect2d rc)
+{
+    return (!rc.x0 && !rc.x1) || (!rc.y0 && !rc.y1);
 }
 
 static void fix_rects(struct pl_image *image, struct pl_render_target *target)
@@ -1031,11 +1834,559 @@ static void fix_rects(struct pl_image *image, struct pl_render_target *target)
     }
 }
 
-bool pl_render_image(struct pl_renderer *rr, const struct pl_image *pimage,
-                     const struct pl_render_target *ptarget,
-                     const struct pl_render_params *params)
+// Cheap parameters to render with while the shaders required for the real
+// parameters are still being compiled in the background
+static struct pl_render_params fallback_params(const struct pl_render_params *params)
 {
-    params = PL_DEF(params, &pl_render_default_params);
+    struct pl_render_params fparams = *params;
+    fparams.upscaler = NULL;
+    fparams.downscaler = NULL;
+    fparams.deband_params = NULL;
+    fparams.peak_detect_params = NULL;
+    fparams.force_3dlut = false;
+    fparams.color_map_3dlut_size = 0;
+    fparams.disable_overlay_sampling = true;
+    return fparams;
+}
+
+static void set_quality(struct pl_renderer *rr, int quality)
+{
+    rr->quality = quality;
+    rr->quality_over = rr->quality_under = 0;
+    rr->quality_cooldown = QUALITY_COOLDOWN;
+}
+
+static bool has_timers(const struct pl_renderer *rr)
+{
+    struct pl_timer *timer = pl_timer_create(rr->gpu);
+    bool ok = !!timer;
+    pl_timer_destroy(rr->gpu, &timer);
+    return ok;
+}
+
+// Pass timing is needed by both quality scaling and the frame statistics
+static void update_timing(struct pl_renderer *rr)
+{
+    pl_dispatch_set_timing(rr->dp, rr->quality_enabled || rr->stats_enabled);
+}
+
+// Updates the automatic quality scaling state based on the GPU time spent on
+// the previous frame
+static void update_quality(struct pl_renderer *rr,
+                           const struct pl_render_params *params)
+{
+    if (!rr->quality_enabled) {
+        if (!has_timers(rr)) {
+            PL_WARN(rr, "GPU does not support timer queries, disabling "
+                    "automatic quality scaling (`frame_budget`)");
+            rr->disable_quality = true;
+            return;
+        }
+
+        rr->quality_enabled = true;
+        update_timing(rr);
+        rr->quality_mark = pl_dispatch_mark(rr->dp);
+        return;
+    }
+
+    uint64_t mark = pl_dispatch_mark(rr->dp);
+    uint64_t cost = pl_dispatch_gpu_time(rr->dp, rr->quality_mark, mark);
+    rr->quality_mark = mark;
+    rr->quality_frames++;
+    if (!cost)
+        return; // no measurements (yet), or nothing rendered
+
+    if (rr->quality_cooldown) {
+        // The passes for the new level may not have been measured yet
+        rr->quality_cooldown--;
+        return;
+    }
+
+    int q = rr->quality;
+    rr->quality_cost[q] = cost;
+    rr->quality_cost_frame[q] = rr->quality_frames;
+
+    uint64_t budget = params->frame_budget * 1e6;
+    if (cost > budget) {
+        rr->quality_under = 0;
+        if (++rr->quality_over >= QUALITY_OVER_FRAMES && q + 1 < QUALITY_LEVELS) {
+            PL_INFO(rr, "Frame time %.2f ms exceeds budget of %.2f ms, "
+                    "reducing quality level to %d", cost / 1e6,
+                    params->frame_budget, q + 1);
+            set_quality(rr, q + 1);
+        }
+    } else if (q > 0 && cost * 10 < budget * 7) {
+        rr->quality_over = 0;
+        if (++rr->quality_under >= QUALITY_UNDER_FRAMES) {
+            // Avoid oscillating back to a level known to exceed the budget,
+            // unless that knowledge is outdated
+            uint64_t prev = rr->quality_cost[q - 1];
+            uint64_t age = rr->quality_frames - rr->quality_cost_frame[q - 1];
+            if (prev <= budget || age > QUALITY_STALE_FRAMES) {
+                PL_INFO(rr, "Frame time %.2f ms within budget of %.2f ms, "
+                        "raising quality level to %d", cost / 1e6,
+                        params->frame_budget, q - 1);
+                set_quality(rr, q - 1);
+            } else {
+                rr->quality_under = 0;
+            }
+        }
+    } else {
+        rr->quality_over = rr->quality_under = 0;
+    }
+}
+
+static const struct pl_filter_config *degrade_scaler(const struct pl_renderer *rr,
+                                                     const struct pl_filter_config *f)
+{
+    if (!f || rr->quality >= QUALITY_BILINEAR)
+        return NULL;
+    if (f->polar)
+        f = &pl_filter_lanczos;
+    if (rr->quality >= QUALITY_BICUBIC && f != &pl_filter_box &&
+        f != &pl_filter_triangle && f != &pl_filter_bicubic)
+    {
+        f = &pl_filter_bicubic;
+    }
+    return f;
+}
+
+// Applies automatic quality scaling to `params`, if enabled. Returns either
+// `params` itself or `tmp`, which is overwritten as needed.
+static const struct pl_render_params *adapt_quality(struct pl_renderer *rr,
+                                                    const struct pl_render_params *params,
+                                                    struct pl_render_params *tmp)
+{
+    if (!params->frame_budget) {
+        if (rr->quality_enabled) {
+            // Reset the state, for when the budget gets re-enabled later
+            rr->quality_enabled = false;
+            update_timing(rr);
+            rr->quality_frames = 0;
+            memset(rr->quality_cost, 0, sizeof(rr->quality_cost));
+            memset(rr->quality_cost_frame, 0, sizeof(rr->quality_cost_frame));
+            set_quality(rr, QUALITY_FULL);
+        }
+        return params;
+    }
+
+    if (rr->disable_quality)
+        return params;
+
+    update_quality(rr, params);
+
+    *tmp = *params;
+    tmp->frame_budget = 0; // avoid re-applying this for nested renders
+    if (rr->quality >= QUALITY_ORTHO) {
+        tmp->upscaler = degrade_scaler(rr, params->upscaler);
+        tmp->downscaler = degrade_scaler(rr, params->downscaler);
+    }
+
+    if (rr->quality >= QUALITY_NO_DEBAND)
+        tmp->deband_params = NULL;
+
+    if (rr->quality >= QUALITY_CHEAP_TONEMAP) {
+        rr->quality_cmap = *PL_DEF(params->color_map_params,
+                                   &pl_color_map_default_params);
+        rr->quality_cmap.tone_mapping_algo = PL_TONE_MAPPING_REINHARD;
+        rr->quality_cmap.tone_mapping_param = 0.0;
+        rr->quality_cmap.desaturation_strength = 0.0;
+        rr->quality_cmap.gamut_warning = false;
+        tmp->color_map_params = &rr->quality_cmap;
+        tmp->sigmoid_params = NULL;
+    }
+
+    if (rr->quality >= QUALITY_NO_PEAK_DETECT)
+        tmp->peak_detect_params = NULL;
+
+    return tmp;
+}
+
+// Called at the start of every (possibly nested) render call
+static void stats_begin(struct pl_renderer *rr,
+                        const struct pl_render_params *params)
+{
+    if (rr->stats_nesting++)
+        return;
+
+    bool enable = params->frame_stats && !rr->disable_stats;
+    if (enable && !rr->stats_enabled && !has_timers(rr)) {
+        PL_WARN(rr, "GPU does not support timer queries, disabling "
+                "frame statistics (`frame_stats`)");
+        rr->disable_stats = true;
+        enable = false;
+    }
+
+    if (enable != rr->stats_enabled) {
+        rr->stats_enabled = enable;
+        update_timing(rr);
+    }
+
+    rr->has_stats = false;
+    rr->num_stage_ranges = 0;
+    rr->stage = PL_RENDER_STAGE_READ;
+}
+
+// Called at the end of every (possibly nested) render call
+static void stats_end(struct pl_renderer *rr)
+{
+    pl_assert(rr->stats_nesting > 0);
+    if (--rr->stats_nesting || !rr->stats_enabled)
+        return;
+
+    rr->stats = (struct pl_render_stats) {0};
+    for (int i = 0; i < rr->num_stage_ranges; i++) {
+        const struct stage_range *range = &rr->stage_ranges[i];
+        struct pl_render_stage_stats *st = &rr->stats.stages[range->stage];
+        uint64_t time = pl_dispatch_gpu_time(rr->dp, range->start, range->end);
+        int passes = range->end - range->start;
+        st->gpu_time += time;
+        st->num_passes += passes;
+        rr->stats.gpu_time += time;
+        rr->stats.num_passes += passes;
+    }
+
+    rr->has_stats = true;
+}
+
+bool pl_renderer_get_stats(const struct pl_renderer *rr,
+                           struct pl_render_stats *out)
+{
+    if (!rr->has_stats)
+        return false;
+
+    *out = rr->stats;
+    return true;
+}
+
+bool pl_renderer_get_histogram(const struct pl_renderer *rr,
+                               struct pl_peak_histogram *out)
+{
+    const struct pl_shader_obj *state = rr->peak_detect_state;
+    return pl_get_detected_histogram(&state, out);
+}
+
+static bool render_image(struct pl_renderer *rr, struct pl_image *image,
+                         struct pl_render_target *target,
+                         const struct pl_render_params *params)
+{
+    pl_dispatch_reset_frame(rr->dp);
+    pl_dispatch_set_float16(rr->dp, params->float16 &&
+                            !pl_color_transfer_is_hdr(image->color.transfer));
+
+    // No shaders from previous attempts are still around to sample from them
+    for (int i = 0; i < rr->num_fbos; i++)
+        rr->fbos[i].held = rr->fbos[i].pinned = false;
+
+    struct pass_state pass = {0};
+    if (!pass_read_image(rr, &pass, image, params))
+        goto error;
+
+    if (!pass_scale_main(rr, &pass, image, target, params))
+        goto error;
+
+    if (!pass_output_target(rr, &pass, image, target, params))
+        goto error;
+
+    return true;
+
+error:
+    pl_dispatch_abort(rr->dp, &pass.cur_img.sh);
+    return false;
+}
+
+// Like `render_image`, but renders to multiple targets. The source image is
+// read (and decoded, debanded etc.) only once, into an intermediate FBO which
+// is then scaled and output separately for each target.
+static bool render_image_multi(struct pl_renderer *rr, struct pl_image *image,
+                               struct pl_render_target *targets, int num,
+                               const struct pl_render_params *params)
+{
+    pl_dispatch_reset_frame(rr->dp);
+    pl_dispatch_set_float16(rr->dp, params->float16 &&
+                            !pl_color_transfer_is_hdr(image->color.transfer));
+    for (int i = 0; i < rr->num_fbos; i++)
+        rr->fbos[i].held = rr->fbos[i].pinned = false;
+
+    struct pass_state pass = {0};
+    if (!pass_read_image(rr, &pass, image, params))
+        goto error;
+
+    struct img base = pass.cur_img;
+    rr->stage = read_stage(rr);
+    const struct pl_tex *tex = finalize_img(rr, &pass.cur_img, rr->fbofmt);
+    if (!tex)
+        goto error;
+
+    // Keep the shared FBO around until all targets have been rendered
+    for (int i = 0; i < rr->num_fbos; i++) {
+        if (rr->fbos[i].tex == tex)
+            rr->fbos[i].pinned = true;
+    }
+
+    for (int i = 0; i < num; i++) {
+        struct pl_render_target *target = &targets[i];
+        struct pl_shader *sh = pl_dispatch_begin_ex(rr->dp, true);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) {
+            .tex        = tex,
+            .components = tex->params.format->num_components,
+            .valid_rect = { 0, 0, base.w, base.h },
+        });
+
+        pass.cur_img = base;
+        pass.cur_img.sh = sh;
+
+        if (!damage_unset(target->damage))
+            pl_dispatch_set_clip(rr->dp, target->fbo, &target->damage);
+
+        bool ok = pass_scale_main(rr, &pass, image, target, params) &&
+                  pass_output_target(rr, &pass, image, target, params);
+        pl_dispatch_set_clip(rr->dp, NULL, NULL);
+        if (!ok)
+            goto error;
+    }
+
+    for (int i = 0; i < rr->num_fbos; i++)
+        rr->fbos[i].pinned = false;
+    return true;
+
+error:
+    for (int i = 0; i < rr->num_fbos; i++)
+        rr->fbos[i].pinned = false;
+    pl_dispatch_abort(rr->dp, &pass.cur_img.sh);
+    return false;
+}
+
+// Whether images rendered with `a` may be reused for `b`. This only compares
+// the options affecting the rendering of individual images, not frame mixing
+// or the final output encoding (dithering).
+static bool params_compat(const struct pl_render_params *a,
+                          const struct pl_render_params *b)
+{
+    return a->upscaler                  == b->upscaler &&
+           a->downscaler                == b->downscaler &&
+           a->lut_entries               == b->lut_entries &&
+           a->antiringing_strength      == b->antiringing_strength &&
+           a->deband_params             == b->deband_params &&
+           a->sigmoid_params            == b->sigmoid_params &&
+           a->color_adjustment          == b->color_adjustment &&
+           a->peak_detect_params        == b->peak_detect_params &&
+           a->color_map_params          == b->color_map_params &&
+           a->lut3d_params              == b->lut3d_params &&
+           a->cone_params               == b->cone_params &&
+           a->skip_anti_aliasing        == b->skip_anti_aliasing &&
+           a->polar_cutoff              == b->polar_cutoff &&
+           a->disable_overlay_sampling  == b->disable_overlay_sampling &&
+           a->allow_delayed_peak_detect == b->allow_delayed_peak_detect &&
+           a->disable_linear_scaling    == b->disable_linear_scaling &&
+           a->disable_builtin_scalers   == b->disable_builtin_scalers &&
+           a->disable_downscaling_prefilter == b->disable_downscaling_prefilter &&
+           a->force_3dlut               == b->force_3dlut &&
+           a->color_map_3dlut_size      == b->color_map_3dlut_size &&
+           a->float16                   == b->float16;
+}
+
+// Whether the rendering of `a` produces the same result as the rendering of `b`
+// (excluding the target overlays)
+static bool redraw_state_eq(const struct redraw_state *a,
+                            const struct redraw_state *b)
+{
+    const struct pl_image *ia = &a->image, *ib = &b->image;
+    const struct pl_render_target *ta = &a->target, *tb = &b->target;
+    return ia->signature == ib->signature &&
+           ia->width == ib->width && ia->height == ib->height &&
+           pl_rect2d_eq(ia->src_rect, ib->src_rect) &&
+           pl_color_repr_equal(&ia->repr, &ib->repr) &&
+           pl_color_space_equal(&ia->color, &ib->color) &&
+           pl_icc_profile_equal(&ia->profile, &ib->profile) &&
+           a->fmt == b->fmt &&
+           pl_rect2d_eq(ta->dst_rect, tb->dst_rect) &&
+           pl_color_repr_equal(&ta->repr, &tb->repr) &&
+           pl_color_space_equal(&ta->color, &tb->color) &&
+           pl_icc_profile_equal(&ta->profile, &tb->profile) &&
+           params_compat(&a->params, &b->params) &&
+           a->params.dither_params == b->params.dither_params;
+}
+
+// Whether the output of rendering to `target` can be cached in a texture and
+// blitted to the target
+static bool can_cache_output(struct pl_renderer *rr,
+                             const struct pl_render_target *target,
+                             const struct pl_render_params *params)
+{
+    const struct pl_tex *fbo = target->fbo;
+    struct pl_rect2d rc = target->dst_rect;
+    pl_rect2d_normalize(&rc);
+    return !params->skip_redraw_caching && fbo->params.blit_dst &&
+           (fbo->params.format->caps & PL_FMT_CAP_BLITTABLE) &&
+           rc.x0 >= 0 && rc.y0 >= 0 &&
+           rc.x1 <= fbo->params.w && rc.y1 <= fbo->params.h;
+}
+
+// Blits `src` to the (normalized) rect `dst_rc` of `dst`, with `src_x/y` being
+// the source coordinates corresponding to the origin of `dst_rc`. Only the
+// part of `dst_rc` inside `clip` is copied.
+static void blit_clipped(struct pl_renderer *rr, const struct pl_tex *dst,
+                         struct pl_rect2d dst_rc, const struct pl_tex *src,
+                         int src_x, int src_y, const struct pl_rect2d *clip)
+{
+    struct pl_rect2d rc = {
+        PL_MAX(dst_rc.x0, clip->x0), PL_MAX(dst_rc.y0, clip->y0),
+        PL_MIN(dst_rc.x1, clip->x1), PL_MIN(dst_rc.y1, clip->y1),
+    };
+
+    if (rc.x0 >= rc.x1 || rc.y0 >= rc.y1)
+        return;
+
+    src_x += rc.x0 - dst_rc.x0;
+    src_y += rc.y0 - dst_rc.y0;
+    pl_tex_blit(rr->gpu, dst, src,
+                (struct pl_rect3d) { rc.x0, rc.y0, 0, rc.x1, rc.y1, 1 },
+                (struct pl_rect3d) {
+                    src_x, src_y, 0,
+                    src_x + pl_rect_w(rc), src_y + pl_rect_h(rc), 1,
+                });
+}
+
+// Restricts the rendering of `image` to the part of `target` that is near the
+// `damage` rect, by cropping both the `src_rect` and the `dst_rect`. A margin
+// around the damaged region is kept, so that the pixels inside it still
+// receive the same contributions from neighbouring source pixels (scaling,
+// debanding) as if the entire image was rendered. Returns false if nothing
+// of the image is visible inside the damaged region.
+static bool crop_to_damage(struct pl_image *image, struct pl_render_target *target,
+                           struct pl_rect2d damage,
+                           const struct pl_render_params *params)
+{
+    struct pl_rect2df *src = &image->src_rect;
+    struct pl_rect2d *dst = &target->dst_rect;
+    struct pl_rect2d dn = *dst;
+    pl_rect2d_normalize(&dn);
+
+    float sx = pl_rect_w(*dst) / pl_rect_w(*src),
+          sy = pl_rect_h(*dst) / pl_rect_h(*src);
+
+    // The margin is given in source pixels, but must also cover the
+    // (target-sized) filter radius when downscaling
+    float margin = DAMAGE_MARGIN;
+    if (params->deband_params)
+        margin += params->deband_params->radius;
+    int mx = ceilf(margin * PL_MAX(fabsf(sx), 1.0)),
+        my = ceilf(margin * PL_MAX(fabsf(sy), 1.0));
+
+    struct pl_rect2d rc = {
+        PL_MAX(damage.x0 - mx, dn.x0), PL_MAX(damage.y0 - my, dn.y0),
+        PL_MIN(damage.x1 + mx, dn.x1), PL_MIN(damage.y1 + my, dn.y1),
+    };
+
+    if (rc.x0 >= damage.x1 || rc.x1 <= damage.x0 ||
+        rc.y0 >= damage.y1 || rc.y1 <= damage.y0)
+        return false;
+
+    if (pl_rect2d_eq(rc, dn))
+        return true; // nothing to crop
+
+    // Preserve the orientation of the dst_rect
+    if (dst->x0 > dst->x1)
+        PL_SWAP(rc.x0, rc.x1);
+    if (dst->y0 > dst->y1)
+        PL_SWAP(rc.y0, rc.y1);
+
+    *src = (struct pl_rect2df) {
+        .x0 = src->x0 + (rc.x0 - dst->x0) / sx,
+        .y0 = src->y0 + (rc.y0 - dst->y0) / sy,
+        .x1 = src->x0 + (rc.x1 - dst->x0) / sx,
+        .y1 = src->y0 + (rc.y1 - dst->y0) / sy,
+    };
+
+    *dst = rc;
+    return true;
+}
+
+// Attempts rendering `image` to `target` with a plain blit, which is possible
+// if the result would be an unmodified copy of the source texture. Returns
+// false if this is not the case, without touching the target.
+static bool pass_blit_identity(struct pl_renderer *rr,
+                               const struct pl_image *image,
+                               const struct pl_render_target *target,
+                               const struct pl_rect2d *damage,
+                               const struct pl_render_params *params)
+{
+    if (image->num_planes != 1 || image->num_overlays)
+        return false;
+
+    // Any processing that may modify the pixel values
+    const struct pl_color_adjustment *adj = params->color_adjustment;
+    if (params->deband_params || params->cone_params || params->force_3dlut)
+        return false;
+    if (adj && memcmp(adj, &pl_color_adjustment_neutral, sizeof(*adj)) != 0)
+        return false;
+    if (image->profile.data || target->profile.data)
+        return false;
+    if (!pl_color_repr_equal(&image->repr, &target->repr) ||
+        !pl_color_space_equal(&image->color, &target->color))
+        return false;
+
+    const struct pl_plane *plane = &image->planes[0];
+    const struct pl_tex *src = plane->texture, *dst = target->fbo;
+    const struct pl_fmt *fmt = dst->params.format;
+    if (src->params.format != fmt || !src->params.blit_src ||
+        !dst->params.blit_dst || !(fmt->caps & PL_FMT_CAP_BLITTABLE))
+        return false;
+
+    if (params->dither_params) {
+        // Mirrors the logic in `encode_output`
+        int depth = PL_DEF(target->repr.bits.sample_depth,
+                           fmt->component_depth[0]);
+        if (depth <= 16)
+            return false;
+    }
+
+    if (plane->components != fmt->num_components ||
+        plane->shift_x || plane->shift_y)
+        return false;
+    for (int c = 0; c < plane->components; c++) {
+        if (plane->component_mapping[c] != c)
+            return false;
+    }
+
+    // The source must map 1:1 to the (unflipped) destination pixels, and the
+    // plane must not be subsampled
+    struct pl_rect2df src_rect = image->src_rect;
+    struct pl_rect2d dst_rect = target->dst_rect;
+    if (src->params.w != image->width || src->params.h != image->height)
+        return false;
+    if (src_rect.x0 != floorf(src_rect.x0) || src_rect.y0 != floorf(src_rect.y0))
+        return false;
+    if (pl_rect_w(src_rect) != pl_rect_w(dst_rect) ||
+        pl_rect_h(src_rect) != pl_rect_h(dst_rect))
+        return false;
+
+    struct pl_rect3d src_rc = {
+        src_rect.x0, src_rect.y0, 0, src_rect.x1, src_rect.y1, 1,
+    };
+    struct pl_rect3d dst_rc = {
+        dst_rect.x0, dst_rect.y0, 0, dst_rect.x1, dst_rect.y1, 1,
+    };
+
+    if (src_rc.x0 < 0 || src_rc.y0 < 0 ||
+        src_rc.x1 > src->params.w || src_rc.y1 > src->params.h ||
+        dst_rc.x0 < 0 || dst_rc.y0 < 0 ||
+        dst_rc.x1 > dst->params.w || dst_rc.y1 > dst->params.h)
+        return false;
+
+    PL_TRACE(rr, "Rendering image as direct blit (no processing required)");
+    blit_clipped(rr, dst, dst_rect, src, src_rc.x0, src_rc.y0, damage);
+    return true;
+}
+
+static bool do_render_image(struct pl_renderer *rr,
+                            const struct pl_image *pimage,
+                            const struct pl_render_target *ptarget,
+                            const struct pl_render_params *params)
+{
+    struct pl_render_params qparams;
+    params = adapt_quality(rr, params, &qparams);
 
     struct pl_image image = *pimage;
     struct pl_render_target target = *ptarget;
@@ -1043,17 +2394,115 @@ bool pl_render_image(struct pl_renderer *rr, const struct pl_image *pimage,
     pl_color_space_infer(&image.color);
     pl_color_space_infer(&target.color);
 
-    // TODO: output caching
-    pl_dispatch_reset_frame(rr->dp);
+    const struct pl_tex *dst_fbo = target.fbo;
+    struct pl_rect2d dst_rect = target.dst_rect;
+    pl_rect2d_normalize(&dst_rect);
+
+    // Restrict all passes rendering to the target to the damaged region
+    struct pl_rect2d damage = {0, 0, dst_fbo->params.w, dst_fbo->params.h};
+    bool has_damage = !damage_unset(target.damage);
+    if (has_damage) {
+        struct pl_rect2d rc = target.damage;
+        pl_rect2d_normalize(&rc);
+        damage.x0 = PL_MAX(damage.x0, rc.x0);
+        damage.y0 = PL_MAX(damage.y0, rc.y0);
+        damage.x1 = PL_MIN(damage.x1, rc.x1);
+        damage.y1 = PL_MIN(damage.y1, rc.y1);
+        if (damage.x0 >= damage.x1 || damage.y0 >= damage.y1)
+            return true; // nothing to update
+        pl_dispatch_set_clip(rr->dp, dst_fbo, &damage);
+    }
 
-    struct pass_state pass = {0};
-    if (!pass_read_image(rr, &pass, &image, params))
-        goto error;
+    // Fast path for passthrough rendering, which needs no caching either
+    rr->used_fallback = false;
+    if (pass_blit_identity(rr, &image, &target, &damage, params))
+        goto overlays;
+
+    // Output caching: if the same frame gets rendered twice in a row (e.g.
+    // while paused), the second render goes to `redraw_fbo`, and all further
+    // renders are replaced by a blit from it, until anything changes. This
+    // avoids the extra blit for frames that are only ever rendered once.
+
+    bool to_cache = false;
+    if (can_cache_output(rr, &target, params)) {
+        struct redraw_state state = {
+            .image  = image,
+            .target = target,
+            .fmt    = target.fbo->params.format,
+            .params = *params,
+        };
+        state.target.fbo = NULL; // not relevant, and may go away
+        state.target.overlays = NULL;
+        state.target.num_overlays = 0;
+
+        if (rr->redraw_valid && redraw_state_eq(&state, &rr->redraw_state)) {
+            PL_TRACE(rr, "Frame unchanged, re-using cached output");
+            blit_clipped(rr, dst_fbo, dst_rect, rr->redraw_fbo, 0, 0, &damage);
+            goto overlays;
+        }
 
-    if (!pass_scale_main(rr, &pass, &image, &target, params))
-        goto error;
+        to_cache = rr->has_redraw_state &&
+                   redraw_state_eq(&state, &rr->redraw_state);
+        rr->redraw_state = state;
+        rr->has_redraw_state = true;
+        rr->redraw_valid = false;
+    }
+
+    if (to_cache) {
+        const struct pl_fmt *fmt = target.fbo->params.format;
+        struct pl_tex_params tex_params = fbo_params(rr, &(struct pl_tex_params) {
+            .w          = pl_rect_w(dst_rect),
+            .h          = pl_rect_h(dst_rect),
+            .format     = fmt,
+            .renderable = true,
+            .blit_src   = true,
+            .storable   = !!(fmt->caps & PL_FMT_CAP_STORABLE),
+        });
+
+        // Only the top left corner is used, see `fbo_size_class`
+        bool ok = pl_tex_recreate(rr->gpu, &rr->redraw_fbo, &tex_params);
+
+        if (ok) {
+            // Render into the cache instead, preserving any flips
+            target.fbo = rr->redraw_fbo;
+            target.dst_rect.x0 -= dst_rect.x0;
+            target.dst_rect.x1 -= dst_rect.x0;
+            target.dst_rect.y0 -= dst_rect.y0;
+            target.dst_rect.y1 -= dst_rect.y0;
+        } else {
+            PL_WARN(rr, "Failed creating output cache texture, disabling");
+            to_cache = false;
+        }
+    }
+
+    // The cache needs the full output, so only crop when not caching. Image
+    // overlays are drawn relative to the cropped source, and peak detection
+    // needs to see the entire frame, so those also prevent cropping.
+    bool peak_detect = params->peak_detect_params &&
+                       pl_color_space_is_hdr(image.color);
+    if (has_damage && !to_cache && !image.num_overlays && !peak_detect) {
+        if (!crop_to_damage(&image, &target, damage, params))
+            goto overlays;
+    }
+
+    gc_fbos(rr);
+    pl_dispatch_set_async(rr->dp, params->async_compile);
+    rr->lut3d_pending = false;
+    bool ok = render_image(rr, &image, &target, params);
+    rr->used_fallback = rr->lut3d_pending;
+    if (!ok && pl_dispatch_pending(rr->dp)) {
+        // Some shaders are still compiling, so render this frame using the
+        // fallback parameters instead. These are compiled synchronously,
+        // since they're cheap and we need *something* to show
+        PL_TRACE(rr, "Shaders still compiling, rendering with fallback params");
+        struct pl_render_params fparams = fallback_params(params);
+        pl_dispatch_set_async(rr->dp, false);
+        ok = render_image(rr, &image, &target, &fparams);
+        rr->used_fallback = true;
+    }
 
-    if (!pass_output_target(rr, &pass, &image, &target, params))
+    pl_dispatch_set_async(rr->dp, false);
+    if (!ok)
         goto error;
 
     // If we don't have FBOs available, simulate the on-image overlays at
@@ -1070,22 +2519,374 @@ bool pl_render_image(struct pl_renderer *rr, const struct pl_image *pimage,
             },
         };
 
+        rr->stage = PL_RENDER_STAGE_OVERLAYS;
         draw_overlays(rr, target.fbo, image.overlays, image.num_overlays,
                       target.color, false, &scale, params);
     }
 
+    if (to_cache) {
+        blit_clipped(rr, dst_fbo, dst_rect, rr->redraw_fbo, 0, 0, &damage);
+        rr->redraw_valid = !rr->used_fallback;
+    }
+
+overlays:
     // Draw the final output overlays
-    draw_overlays(rr, target.fbo, target.overlays, target.num_overlays,
+    rr->stage = PL_RENDER_STAGE_OVERLAYS;
+    draw_overlays(rr, dst_fbo, target.overlays, target.num_overlays,
                   target.color, false, NULL, params);
 
+    if (has_damage)
+        pl_dispatch_set_clip(rr->dp, NULL, NULL);
     return true;
 
 error:
-    pl_dispatch_abort(rr->dp, &pass.cur_img.sh);
+    if (has_damage)
+        pl_dispatch_set_clip(rr->dp, NULL, NULL);
     PL_ERR(rr, "Failed rendering image!");
     return false;
 }
 
+bool pl_render_image(struct pl_renderer *rr, const struct pl_image *pimage,
+                     const struct pl_render_target *ptarget,
+                     const struct pl_render_params *params)
+{
+    params = PL_DEF(params, &pl_render_default_params);
+    stats_begin(rr, params);
+    bool ok = do_render_image(rr, pimage, ptarget, params);
+    stats_end(rr);
+    return ok;
+}
+
+static bool do_render_image_multi(struct pl_renderer *rr,
+                                  const struct pl_image *pimage,
+                                  const struct pl_render_target *ptargets,
+                                  int num_targets,
+                                  const struct pl_render_params *params)
+{
+    pl_assert(num_targets > 0);
+
+    // Without FBOs, there is no intermediate result to share
+    if (num_targets == 1 || !rr->fbofmt) {
+        for (int i = 0; i < num_targets; i++) {
+            if (!pl_render_image(rr, pimage, &ptargets[i], params))
+                return false;
+        }
+        return true;
+    }
+
+    struct pl_render_params qparams;
+    params = adapt_quality(rr, params, &qparams);
+
+    struct pl_image image = *pimage;
+    struct pl_render_target *targets = talloc_array(NULL, struct pl_render_target,
+                                                    num_targets);
+    for (int i = 0; i < num_targets; i++) {
+        // Any flips of the src_rect get moved to every dst_rect, so use a
+        // fresh copy of the image for each target
+        struct pl_image tmp = *pimage;
+        targets[i] = ptargets[i];
+        fix_rects(&tmp, &targets[i]);
+        pl_color_space_infer(&targets[i].color);
+        image.src_rect = tmp.src_rect;
+    }
+    pl_color_space_infer(&image.color);
+
+    gc_fbos(rr);
+    pl_dispatch_set_async(rr->dp, params->async_compile);
+    rr->lut3d_pending = false;
+    bool ok = render_image_multi(rr, &image, targets, num_targets, params);
+    rr->used_fallback = rr->lut3d_pending;
+    if (!ok && pl_dispatch_pending(rr->dp)) {
+        PL_TRACE(rr, "Shaders still compiling, rendering with fallback params");
+        struct pl_render_params fparams = fallback_params(params);
+        pl_dispatch_set_async(rr->dp, false);
+        ok = render_image_multi(rr, &image, targets, num_targets, &fparams);
+        rr->used_fallback = true;
+    }
+
+    pl_dispatch_set_async(rr->dp, false);
+    if (!ok) {
+        PL_ERR(rr, "Failed rendering image to multiple targets!");
+        talloc_free(targets);
+        return false;
+    }
+
+    for (int i = 0; i < num_targets; i++) {
+        const struct pl_render_target *target = &targets[i];
+        if (!damage_unset(target->damage))
+            pl_dispatch_set_clip(rr->dp, target->fbo, &target->damage);
+        rr->stage = PL_RENDER_STAGE_OVERLAYS;
+        draw_overlays(rr, target->fbo, target->overlays, target->num_overlays,
+                      target->color, false, NULL, params);
+        pl_dispatch_set_clip(rr->dp, NULL, NULL);
+    }
+
+    talloc_free(targets);
+    return true;
+}
+
+bool pl_render_image_multi(struct pl_renderer *rr, const struct pl_image *pimage,
+                           const struct pl_render_target *ptargets, int num_targets,
+                           const struct pl_render_params *params)
+{
+    params = PL_DEF(params, &pl_render_default_params);
+    stats_begin(rr, params);
+    bool ok = do_render_image_multi(rr, pimage, ptargets, num_targets, params);
+    stats_end(rr);
+    return ok;
+}
+
+// Computes the (unnormalized) contribution of each frame in the mix
+static void mix_weights(const struct pl_image_mix *mix,
+                        const struct pl_render_params *params, float *weights)
+{
+    if (params->frame_mixer) {
+        for (int i = 0; i < mix->num_images; i++)
+            weights[i] = pl_filter_sample(params->frame_mixer, mix->distances[i]);
+        return;
+    }
+
+    // Built-in frame mixing: each frame is weighted by how much of the vsync
+    // interval it would cover on a zero-order-hold display, with frames being
+    // visible half-way to their neighbours
+    float vsync = mix->vsync_duration / 2;
+    for (int i = 0; i < mix->num_images; i++) {
+        float d = mix->distances[i];
+        float a = i > 0 ? (mix->distances[i - 1] + d) / 2 : d - 0.5;
+        float b = i + 1 < mix->num_images ? (d + mix->distances[i + 1]) / 2
+                                          : d + 0.5;
+        if (vsync > 0) {
+            weights[i] = PL_MAX(0.0, PL_MIN(b, vsync) - PL_MAX(a, -vsync));
+        } else {
+            weights[i] = a <= 0.0 && b > 0.0;
+        }
+    }
+}
+
+// Returns the cached frame containing `image`, or NULL if there is none
+static struct cached_frame *find_frame(struct pl_renderer *rr,
+                                       const struct pl_image *image,
+                                       const struct pl_render_params *params)
+{
+    if (params->skip_redraw_caching)
+        return NULL;
+
+    for (int i = 0; i < rr->num_frames; i++) {
+        struct cached_frame *f = &rr->frames[i];
+        if (f->valid && !f->used && f->signature == image->signature) {
+            PL_TRACE(rr, "Reusing cached frame 0x%"PRIx64, image->signature);
+            f->used = true;
+            return f;
+        }
+    }
+
+    return NULL;
+}
+
+// Renders `image` at `w`x`h` in the current `rr->mix_color` into a new cache
+// entry. Must only be called after all cache hits have been marked as used.
+static struct cached_frame *render_frame(struct pl_renderer *rr,
+                                         const struct pl_image *image,
+                                         int w, int h,
+                                         const struct pl_render_params *params)
+{
+    // Re-use the texture of a frame not needed by the current mix, or add a
+    // new one. This keeps the cache bounded by the number of mixed frames.
+    struct cached_frame *f = NULL;
+    for (int i = 0; i < rr->num_frames; i++) {
+        if (!rr->frames[i].used) {
+            f = &rr->frames[i];
+            break;
+        }
+    }
+
+    if (!f) {
+        TARRAY_GROW(rr, rr->frames, rr->num_frames);
+        f = &rr->frames[rr->num_frames++];
+        *f = (struct cached_frame) {0};
+    }
+
+    f->used = true;
+    f->valid = false;
+    struct img img = { .w = w, .h = h };
+    struct pl_tex_params tex_params = img_params(rr, &img, rr->fbofmt);
+    tex_params = fbo_params(rr, &tex_params);
+    if (!pl_tex_recreate(rr->gpu, &f->tex, &tex_params)) {
+        PL_ERR(rr, "Failed creating frame cache texture!");
+        return NULL;
+    }
+    f->w = w;
+    f->h = h;
+
+    // Frames are rendered without dithering or output overlays, since these
+    // get applied after mixing
+    struct pl_render_params fparams = *params;
+    fparams.dither_params = NULL;
+
+    struct pl_render_target target = {
+        .fbo      = f->tex,
+        .dst_rect = { 0, 0, w, h },
+        .repr     = pl_color_repr_rgb,
+        .color    = rr->mix_color,
+    };
+
+    if (!pl_render_image(rr, image, &target, &fparams))
+        return NULL;
+
+    // Don't cache frames rendered with the fallback params, so that they get
+    // redrawn properly once the real shaders are ready
+    f->signature = image->signature;
+    f->valid = !params->skip_redraw_caching && !rr->used_fallback;
+    return f;
+}
+
+static bool do_render_image_mix(struct pl_renderer *rr,
+                                const struct pl_image_mix *mix,
+                                const struct pl_render_target *ptarget,
+                                const struct pl_render_params *params)
+{
+    pl_assert(mix->num_images > 0);
+
+    struct pl_render_params qparams;
+    params = adapt_quality(rr, params, &qparams);
+
+    float *weights = talloc_array(NULL, float, mix->num_images);
+    mix_weights(mix, params, weights);
+
+    float wsum = 0.0;
+    int num_used = 0, best = 0;
+    for (int i = 0; i < mix->num_images; i++) {
+        wsum += weights[i];
+        num_used += weights[i] != 0.0;
+        if (fabs(weights[i]) > fabs(weights[best]))
+            best = i;
+    }
+
+    // If there's nothing to mix, just render the single relevant frame
+    // directly. The same goes for when we can't allocate intermediate FBOs.
+    if (num_used <= 1 || wsum <= 0.0 || !rr->fbofmt) {
+        talloc_free(weights);
+        PL_TRACE(rr, "Frame mix reduces to a single frame, rendering directly");
+        return pl_render_image(rr, &mix->images[best], ptarget, params);
+    }
+
+    struct pl_render_target target = *ptarget;
+    if ((!target.dst_rect.x0 && !target.dst_rect.x1) ||
+        (!target.dst_rect.y0 && !target.dst_rect.y1))
+    {
+        target.dst_rect = (struct pl_rect2d) {
+            0, 0, target.fbo->params.w, target.fbo->params.h,
+        };
+    }
+    pl_color_space_infer(&target.color);
+
+    // Invalidate all cached frames if the rendering configuration changed
+    int w = abs(pl_rect_w(target.dst_rect)), h = abs(pl_rect_h(target.dst_rect));
+    bool flush = !pl_color_space_equal(&rr->mix_color, &target.color) ||
+                 !params_compat(&rr->mix_params, params);
+    for (int i = 0; i < rr->num_frames; i++) {
+        struct cached_frame *f = &rr->frames[i];
+        f->used = false;
+        if (flush || !f->tex || f->w != w || f->h != h)
+            f->valid = false;
+    }
+
+    rr->mix_color = target.color;
+    rr->mix_params = *params;
+
+    // Reserve enough space up-front, so pointers into `rr->frames` stay valid
+    TARRAY_GROW(rr, rr->frames, rr->num_frames + mix->num_images);
+    struct cached_frame **frames = talloc_zero_array(weights, struct cached_frame *,
+                                                     mix->num_images);
+    for (int i = 0; i < mix->num_images; i++) {
+        if (weights[i])
+            frames[i] = find_frame(rr, &mix->images[i], params);
+    }
+
+    for (int i = 0; i < mix->num_images; i++) {
+        if (!weights[i] || frames[i])
+            continue;
+        frames[i] = render_frame(rr, &mix->images[i], w, h, params);
+        if (!frames[i])
+            goto error;
+    }
+
+    pl_dispatch_reset_frame(rr->dp);
+    struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+    sh_require(sh, PL_SHADER_SIG_NONE, w, h);
+    sh_describe(sh, "frame mixing");
+    GLSL("vec4 color = vec4(0.0);\n");
+
+    // All frames are of the same size class, so they can share `pos`
+    ident_t pos = NULL;
+    for (int i = 0; i < mix->num_images; i++) {
+        if (!frames[i])
+            continue;
+
+        ident_t tex = sh_bind(sh, frames[i]->tex, "frame",
+                              &(struct pl_rect2df) { 0, 0, w, h },
+                              pos ? NULL : &pos, NULL, NULL);
+        if (!tex) {
+            pl_dispatch_abort(rr->dp, &sh);
+            goto error;
+        }
+
+        GLSL("color += %s * %s(%s, %s);\n",
+             sh_var(sh, (struct pl_shader_var) {
+                 .var  = pl_var_float("weight"),
+                 .data = &(float) { weights[i] / wsum },
+                 .dynamic = true,
+             }), sh_tex_fn(sh, frames[i]->tex), tex, pos);
+    }
+
+    // Only the final output is restricted to the damaged region, since the
+    // cached frames are always rendered in full
+    if (!damage_unset(target.damage))
+        pl_dispatch_set_clip(rr->dp, target.fbo, &target.damage);
+
+    encode_output(rr, sh, &target, params);
+    rr->stage = PL_RENDER_STAGE_OUTPUT;
+    if (!finish_pass(rr, &sh, target.fbo, &target.dst_rect, NULL)) {
+        PL_ERR(rr, "Failed dispatching frame mixing shader!");
+        goto error;
+    }
+
+    // Drop the frames that weren't needed anymore
+    for (int i = rr->num_frames - 1; i >= 0; i--) {
+        if (rr->frames[i].used)
+            continue;
+        pl_tex_destroy(rr->gpu, &rr->frames[i].tex);
+        TARRAY_REMOVE_AT(rr->frames, rr->num_frames, i);
+    }
+
+    talloc_free(weights);
+
+    // Draw the final output overlays
+    rr->stage = PL_RENDER_STAGE_OVERLAYS;
+    draw_overlays(rr, target.fbo, target.overlays, target.num_overlays,
+                  target.color, false, NULL, params);
+
+    pl_dispatch_set_clip(rr->dp, NULL, NULL);
+    return true;
+
+error:
+    PL_ERR(rr, "Failed rendering frame mix!");
+    pl_dispatch_set_clip(rr->dp, NULL, NULL);
+    talloc_free(weights);
+    return false;
+}
+
+bool pl_render_image_mix(struct pl_renderer *rr, const struct pl_image_mix *mix,
+                         const struct pl_render_target *ptarget,
+                         const struct pl_render_params *params)
+{
+    params = PL_DEF(params, &pl_render_default_params);
+    stats_begin(rr, params);
+    bool ok = do_render_image_mix(rr, mix, ptarget, params);
+    stats_end(rr);
+    return ok;
+}
+
 void pl_render_target_from_swapchain(struct pl_render_target *out_target,
                                      const struct pl_swapchain_frame *frame)
 {
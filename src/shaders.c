@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "common.h"
 #include "context.h"
@@ -26,11 +27,13 @@ struct pl_shader *pl_shader_alloc(struct pl_context *ctx,
                                   const struct pl_shader_params *params)
 {
     pl_assert(ctx);
-    struct pl_shader *sh = talloc_ptrtype(ctx, sh);
+    // Allocated without a parent, so shaders can be allocated from different
+    // threads sharing the same context
+    struct pl_shader *sh = talloc_ptrtype(NULL, sh);
     *sh = (struct pl_shader) {
         .ctx = ctx,
+        .tmp = talloc_new_arena(sh),
         .mutable = true,
-        .tmp = talloc_ref_new(ctx),
     };
 
     if (params)
@@ -45,15 +48,16 @@ void pl_shader_free(struct pl_shader **psh)
     if (!sh)
         return;
 
-    talloc_ref_deref(&sh->tmp);
     TA_FREEP(psh);
 }
 
 void pl_shader_reset(struct pl_shader *sh, const struct pl_shader_params *params)
 {
+    talloc_arena_reset(sh->tmp);
+
     struct pl_shader new = {
         .ctx = sh->ctx,
-        .tmp = talloc_ref_new(sh->ctx),
+        .tmp = sh->tmp,
         .mutable = true,
 
         // Preserve array allocations
@@ -62,6 +66,7 @@ void pl_shader_reset(struct pl_shader *sh, const struct pl_shader_params *params
             .descriptors    = sh->res.descriptors,
             .vertex_attribs = sh->res.vertex_attribs,
         },
+        .steps = sh->steps,
     };
 
     if (params)
@@ -71,10 +76,95 @@ void pl_shader_reset(struct pl_shader *sh, const struct pl_shader_params *params
     for (int i = 0; i < PL_ARRAY_SIZE(new.buffers); i++)
         new.buffers[i] = (struct bstr) { .start = sh->buffers[i].start };
 
-    talloc_ref_deref(&sh->tmp);
     *sh = new;
 }
 
+// Allocates memory from the shader's arena, which is valid until the next
+// `pl_shader_reset`
+static void *sh_alloc(struct pl_shader *sh, size_t size)
+{
+    return talloc_arena_alloc(sh->tmp, size);
+}
+
+static void *sh_memdup(struct pl_shader *sh, const void *ptr, size_t size)
+{
+    return memcpy(sh_alloc(sh, size), ptr, size);
+}
+
+static char *sh_strdup(struct pl_shader *sh, const char *str)
+{
+    return sh_memdup(sh, str, strlen(str) + 1);
+}
+
+// Tags for the non-text contributions to the signature, which continue the
+// numbering of `enum pl_shader_buf`
+enum {
+    SH_SIG_SUBPASS = SH_BUF_COUNT,
+    SH_SIG_VAR,
+    SH_SIG_DESC,
+    SH_SIG_VA,
+};
+
+// Mixes the hash of a chunk of text appended to `buf` (or one of the SH_SIG_*
+// tags) into the running signature. Text that is moved between buffers later
+// on (e.g. by `sh_split`) is already accounted for by the original appends.
+static void sh_sig_mix(struct pl_shader *sh, int buf, uint64_t hash)
+{
+    uint64_t sig = sh->signature;
+    sig = (sig << 5 | sig >> 59) ^ hash ^ buf;
+    sh->signature = sig * 0x9E3779B97F4A7C15LLU;
+}
+
+static uint64_t sh_sig_pl_var(const struct pl_var *var)
+{
+    uint64_t cfg[] = { var->type, var->dim_v, var->dim_m, var->dim_a };
+    return siphash64((const uint8_t *) cfg, sizeof(cfg)) ^
+           bstr_hash64(bstr0(var->name));
+}
+
+// Mixes everything about a descriptor that affects the generated code into
+// the signature. (This excludes the bound object itself, which is allowed to
+// differ between compatible shaders, but includes e.g. its dimensions)
+static void sh_sig_desc(struct pl_shader *sh, const struct pl_shader_desc *sd)
+{
+    uint64_t cfg[4] = { sd->desc.type, sd->desc.access };
+    const char *format = NULL;
+
+    switch (sd->desc.type) {
+    case PL_DESC_SAMPLED_TEX:
+    case PL_DESC_STORAGE_IMG: {
+        const struct pl_tex *tex = sd->object;
+        cfg[2] = pl_tex_params_dimension(tex->params);
+        if (sd->desc.type == PL_DESC_STORAGE_IMG)
+            format = tex->params.format->glsl_format;
+        break;
+    }
+    case PL_DESC_BUF_TEXEL_STORAGE: {
+        const struct pl_buf *buf = sd->object;
+        format = buf->params.format->glsl_format;
+        break;
+    }
+    case PL_DESC_BUF_UNIFORM:
+    case PL_DESC_BUF_STORAGE:
+        for (int i = 0; i < sd->num_buffer_vars; i++) {
+            const struct pl_buffer_var *bv = &sd->buffer_vars[i];
+            uint64_t layout[] = {
+                bv->layout.offset, bv->layout.stride, bv->layout.size,
+            };
+            cfg[3] = (cfg[3] << 7 | cfg[3] >> 57) ^ sh_sig_pl_var(&bv->var) ^
+                     siphash64((const uint8_t *) layout, sizeof(layout));
+        }
+        break;
+    default: break;
+    }
+
+    uint64_t hash = siphash64((const uint8_t *) cfg, sizeof(cfg));
+    hash ^= bstr_hash64(bstr0(sd->desc.name));
+    if (format)
+        hash ^= bstr_hash64(bstr0(format)) * 3;
+    sh_sig_mix(sh, SH_SIG_DESC, hash);
+}
+
 bool pl_shader_is_failed(const struct pl_shader *sh)
 {
     return sh->failed;
@@ -91,6 +181,26 @@ struct pl_glsl_desc sh_glsl(const struct pl_shader *sh)
     return (struct pl_glsl_desc) { .version = 130 };
 }
 
+bool sh_float16(struct pl_shader *sh)
+{
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    if (!SH_PARAMS(sh).float16 || !gpu || !(gpu->caps & PL_GPU_CAP_FLOAT16))
+        return false;
+
+    sh->float16 = true;
+    return true;
+}
+
+bool sh_subgroups(struct pl_shader *sh)
+{
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    if (!sh->is_compute || !gpu || !(gpu->caps & PL_GPU_CAP_SUBGROUPS))
+        return false;
+
+    sh->subgroups = true;
+    return true;
+}
+
 bool sh_try_compute(struct pl_shader *sh, int bw, int bh, bool flex, size_t mem)
 {
     pl_assert(bw && bh);
@@ -142,6 +252,24 @@ bool sh_try_compute(struct pl_shader *sh, int bw, int bh, bool flex, size_t mem)
     return true;
 }
 
+bool sh_can_compute(const struct pl_shader *sh, int bw, int bh, bool flex,
+                    size_t mem)
+{
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    if (!gpu || !(gpu->caps & PL_GPU_CAP_COMPUTE))
+        return false;
+    if (sh->res.compute_shmem + mem > gpu->limits.max_shmem_size)
+        return false;
+
+    // Only two rigid shaders can conflict, see `sh_try_compute`
+    if (sh->is_compute && !sh->flexible_work_groups && !flex) {
+        return bw == sh->res.compute_group_size[0] &&
+               bh == sh->res.compute_group_size[1];
+    }
+
+    return true;
+}
+
 bool pl_shader_is_compute(const struct pl_shader *sh)
 {
     return sh->is_compute;
@@ -159,26 +287,38 @@ bool pl_shader_output_size(const struct pl_shader *sh, int *w, int *h)
 
 uint64_t pl_shader_signature(const struct pl_shader *sh)
 {
-    uint64_t res = 0;
-    for (int i = 0; i < PL_ARRAY_SIZE(sh->buffers); i++)
-        res ^= bstr_hash64(sh->buffers[i]);
+    return sh->signature;
+}
 
-    // FIXME: also hash in the configuration of the descriptors/variables
+void sh_describe(struct pl_shader *sh, const char *desc)
+{
+    if (sh->num_steps && strcmp(sh->steps[sh->num_steps - 1], desc) == 0)
+        return;
 
-    return res;
+    TARRAY_APPEND(sh, sh->steps, sh->num_steps, sh_strdup(sh, desc));
 }
 
 ident_t sh_fresh(struct pl_shader *sh, const char *name)
 {
-    return talloc_asprintf(sh->tmp, "_%s_%d_%u", PL_DEF(name, "var"),
-                           sh->fresh++, SH_PARAMS(sh).id);
+    name = PL_DEF(name, "var");
+    int fresh = sh->fresh++;
+    unsigned id = SH_PARAMS(sh).id;
+
+    int len = snprintf(NULL, 0, "_%s_%d_%u", name, fresh, id);
+    char *ident = sh_alloc(sh, len + 1);
+    snprintf(ident, len + 1, "_%s_%d_%u", name, fresh, id);
+    return ident;
 }
 
 ident_t sh_var(struct pl_shader *sh, struct pl_shader_var sv)
 {
     sv.var.name = sh_fresh(sh, sv.var.name);
-    sv.data = talloc_memdup(sh->tmp, sv.data, pl_var_host_layout(0, &sv.var).size);
+    sv.data = sh_memdup(sh, sv.data, pl_var_host_layout(0, &sv.var).size);
     TARRAY_APPEND(sh, sh->res.variables, sh->res.num_variables, sv);
+
+    // The flags affect the placement of the variable, and hence the code
+    uint64_t flags = sv.dynamic | sv.compile_time << 1;
+    sh_sig_mix(sh, SH_SIG_VAR, sh_sig_pl_var(&sv.var) ^ flags);
     return (ident_t) sv.var.name;
 }
 
@@ -201,6 +341,7 @@ ident_t sh_desc(struct pl_shader *sh, struct pl_shader_desc sd)
 
     sd.desc.name = sh_fresh(sh, sd.desc.name);
     TARRAY_APPEND(sh, sh->res.descriptors, sh->res.num_descriptors, sd);
+    sh_sig_desc(sh, &sd);
     return (ident_t) sd.desc.name;
 }
 
@@ -226,7 +367,7 @@ ident_t sh_attr_vec2(struct pl_shader *sh, const char *name,
         { rc->x1, rc->y1 },
     };
 
-    float *data = talloc_memdup(sh->tmp, &vals[0][0], sizeof(vals));
+    float *data = sh_memdup(sh, &vals[0][0], sizeof(vals));
     struct pl_shader_va va = {
         .attr = {
             .name     = sh_fresh(sh, name),
@@ -236,6 +377,8 @@ ident_t sh_attr_vec2(struct pl_shader *sh, const char *name,
     };
 
     TARRAY_APPEND(sh, sh->res.vertex_attribs, sh->res.num_vertex_attribs, va);
+    sh_sig_mix(sh, SH_SIG_VA, bstr_hash64(bstr0(va.attr.name)) ^
+                              bstr_hash64(bstr0(va.attr.fmt->name)));
     return (ident_t) va.attr.name;
 }
 
@@ -334,10 +477,23 @@ void pl_shader_append(struct pl_shader *sh, enum pl_shader_buf buf,
 {
     pl_assert(buf >= 0 && buf < SH_BUF_COUNT);
 
+    struct bstr *str = &sh->buffers[buf];
+    size_t start = str->len;
+
     va_list ap;
     va_start(ap, fmt);
-    bstr_xappend_vasprintf_c(sh, &sh->buffers[buf], fmt, ap);
+    bstr_xappend_vasprintf_c(sh, str, fmt, ap);
     va_end(ap);
+
+    sh_sig_mix(sh, buf, siphash64(str->start + start, str->len - start));
+}
+
+void pl_shader_append_bstr(struct pl_shader *sh, enum pl_shader_buf buf,
+                           struct bstr str)
+{
+    pl_assert(buf >= 0 && buf < SH_BUF_COUNT);
+    bstr_xappend(sh, &sh->buffers[buf], str);
+    sh_sig_mix(sh, buf, bstr_hash64(str));
 }
 
 static const char *outsigs[] = {
@@ -390,10 +546,14 @@ ident_t sh_subpass(struct pl_shader *sh, const struct pl_shader *sub)
 
     sh->output_w = res_w;
     sh->output_h = res_h;
+    sh->float16 |= sub->float16;
+    sh->subgroups |= sub->subgroups;
 
-    // Append the prelude and header
+    // Append the prelude and header. The text itself is already accounted
+    // for by the signature of `sub`
     bstr_xappend(sh, &sh->buffers[SH_BUF_PRELUDE], sub->buffers[SH_BUF_PRELUDE]);
     bstr_xappend(sh, &sh->buffers[SH_BUF_HEADER],  sub->buffers[SH_BUF_HEADER]);
+    sh_sig_mix(sh, SH_SIG_SUBPASS, sub->signature);
 
     // Append the body as a new header function
     ident_t name = sh_fresh(sh, "sub");
@@ -401,8 +561,12 @@ ident_t sh_subpass(struct pl_shader *sh, const struct pl_shader *sub)
     bstr_xappend(sh, &sh->buffers[SH_BUF_HEADER], sub->buffers[SH_BUF_BODY]);
     GLSLH("%s }\n", retvals[sub->res.output]);
 
-    // Copy over all of the descriptors etc.
-    talloc_ref_attach(sh->tmp, sub->tmp);
+    // Copy over all of the descriptors etc. Since `sub` may be reset before
+    // `sh`, everything allocated from its arena needs to be duplicated
+    int num_vars = sh->res.num_variables,
+        num_descs = sh->res.num_descriptors,
+        num_vas = sh->res.num_vertex_attribs;
+
 #define COPY(f) TARRAY_CONCAT(sh, sh->res.f, sh->res.num_##f, \
                               sub->res.f, sub->res.num_##f)
     COPY(variables);
@@ -410,6 +574,27 @@ ident_t sh_subpass(struct pl_shader *sh, const struct pl_shader *sub)
     COPY(vertex_attribs);
 #undef COPY
 
+    for (int i = num_vars; i < sh->res.num_variables; i++) {
+        struct pl_shader_var *sv = &sh->res.variables[i];
+        sv->var.name = sh_strdup(sh, sv->var.name);
+        sv->data = sh_memdup(sh, sv->data, pl_var_host_layout(0, &sv->var).size);
+    }
+
+    for (int i = num_descs; i < sh->res.num_descriptors; i++) {
+        struct pl_shader_desc *sd = &sh->res.descriptors[i];
+        sd->desc.name = sh_strdup(sh, sd->desc.name);
+    }
+
+    for (int i = num_vas; i < sh->res.num_vertex_attribs; i++) {
+        struct pl_shader_va *va = &sh->res.vertex_attribs[i];
+        va->attr.name = sh_strdup(sh, va->attr.name);
+        for (int n = 0; n < PL_ARRAY_SIZE(va->data); n++)
+            va->data[n] = sh_memdup(sh, va->data[n], va->attr.fmt->texel_size);
+    }
+
+    for (int i = 0; i < sub->num_steps; i++)
+        sh_describe(sh, sub->steps[i]);
+
     return name;
 }
 
@@ -608,11 +793,105 @@ static ident_t sh_lut_pos(struct pl_shader *sh, int lut_size)
     return name;
 }
 
+// LUT textures are shared between all LUT objects on the same GPU, keyed by
+// a hash of their contents. This avoids keeping around (and uploading)
+// multiple copies of the same LUT, e.g. when running multiple renderers
+// with the same scaler configuration.
+struct sh_lut_tex {
+    const struct pl_gpu *gpu;
+    uint64_t hash;
+    enum sh_lut_method method;
+    int width, height, depth, comps;
+    const struct pl_tex *tex;
+    int refcount;
+};
+
+static pthread_mutex_t lut_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sh_lut_tex **lut_cache;
+static int num_lut_cache;
+
+// Returns a reference to a shared LUT texture with the given contents,
+// creating it if needed. Returns NULL on failure.
+static struct sh_lut_tex *lut_tex_acquire(const struct pl_gpu *gpu,
+                                          enum sh_lut_method method,
+                                          int width, int height, int depth,
+                                          int comps, const float *data,
+                                          const struct pl_tex_params *params)
+{
+    size_t size = width * PL_DEF(height, 1) * PL_DEF(depth, 1) * comps;
+    uint64_t hash = siphash64((const uint8_t *) data, size * sizeof(float));
+    struct sh_lut_tex *entry = NULL;
+
+    pthread_mutex_lock(&lut_cache_lock);
+    for (int i = 0; i < num_lut_cache; i++) {
+        struct sh_lut_tex *e = lut_cache[i];
+        if (e->gpu == gpu && e->hash == hash && e->method == method &&
+            e->width == width && e->height == height && e->depth == depth &&
+            e->comps == comps && e->tex->params.format == params->format)
+        {
+            PL_TRACE(gpu, "Re-using shared LUT texture (hash 0x%llx)",
+                     (unsigned long long) hash);
+            entry = e;
+            entry->refcount++;
+            goto done;
+        }
+    }
+
+    const struct pl_tex *tex = pl_tex_create(gpu, params);
+    if (!tex)
+        goto done;
+
+    entry = talloc_ptrtype(NULL, entry);
+    *entry = (struct sh_lut_tex) {
+        .gpu = gpu,
+        .hash = hash,
+        .method = method,
+        .width = width,
+        .height = height,
+        .depth = depth,
+        .comps = comps,
+        .tex = tex,
+        .refcount = 1,
+    };
+
+    TARRAY_APPEND(NULL, lut_cache, num_lut_cache, entry);
+
+done:
+    pthread_mutex_unlock(&lut_cache_lock);
+    return entry;
+}
+
+static void lut_tex_release(struct sh_lut_tex **entry)
+{
+    struct sh_lut_tex *e = *entry;
+    if (!e)
+        return;
+
+    pthread_mutex_lock(&lut_cache_lock);
+    if (--e->refcount == 0) {
+        for (int i = 0; i < num_lut_cache; i++) {
+            if (lut_cache[i] == e) {
+                TARRAY_REMOVE_AT(lut_cache, num_lut_cache, i);
+                break;
+            }
+        }
+
+        if (!num_lut_cache)
+            TA_FREEP(&lut_cache);
+
+        pl_tex_destroy(e->gpu, &e->tex);
+        talloc_free(e);
+    }
+    pthread_mutex_unlock(&lut_cache_lock);
+    *entry = NULL;
+}
+
 struct sh_lut_obj {
     enum sh_lut_method method;
+    enum sh_lut_precision precision;
     int width, height, depth, comps;
     union {
-        const struct pl_tex *tex;
+        struct sh_lut_tex *tex;
         struct bstr str;
         float *data;
     } weights;
@@ -624,7 +903,7 @@ static void sh_lut_uninit(const struct pl_gpu *gpu, void *ptr)
     switch (lut->method) {
     case SH_LUT_TEXTURE:
     case SH_LUT_LINEAR:
-        pl_tex_destroy(gpu, &lut->weights.tex);
+        lut_tex_release(&lut->weights.tex);
         break;
     case SH_LUT_UNIFORM:
         talloc_free(lut->weights.data);
@@ -641,12 +920,86 @@ static void sh_lut_uninit(const struct pl_gpu *gpu, void *ptr)
 // Maximum number of floats to embed as a literal array (when using SH_LUT_AUTO)
 #define SH_LUT_MAX_LITERAL 256
 
-ident_t sh_lut(struct pl_shader *sh, struct pl_shader_obj **obj,
-               enum sh_lut_method method, int width, int height, int depth,
-               int comps, bool update, void *priv,
-               void (*fill)(void *priv, float *data, int w, int h, int d))
+// Converts a float to IEEE 754 half precision, rounding to nearest even
+static uint16_t float_to_half(float f)
+{
+    union { float f; uint32_t u; } v = { .f = f };
+    uint16_t sign = (v.u >> 16) & 0x8000;
+    int exp = (int) ((v.u >> 23) & 0xFF) - 127 + 15;
+    uint32_t mant = v.u & 0x7FFFFF;
+
+    if (((v.u >> 23) & 0xFF) == 0xFF) // infinity or NaN
+        return sign | 0x7C00 | (mant ? 0x200 : 0);
+    if (exp >= 0x1F) // overflow
+        return sign | 0x7C00;
+
+    int shift = 13;
+    uint32_t half = (exp << 10) | (mant >> 13);
+    if (exp <= 0) {
+        // Denormal (or zero) result, shift in the implicit leading bit
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        shift = 14 - exp;
+        half = mant >> shift;
+    }
+
+    // Round to nearest even. A carry into the exponent is still correct
+    uint32_t rem = mant & ((1u << shift) - 1), mid = 1u << (shift - 1);
+    if (rem > mid || (rem == mid && (half & 1)))
+        half++;
+
+    return sign | half;
+}
+
+// Finds the texture format to use for a LUT with the given precision, and
+// converts `data` to the corresponding host representation. Returns NULL if
+// no suitable format exists.
+static const struct pl_fmt *lut_tex_fmt(const struct pl_gpu *gpu, void *tactx,
+                                        enum sh_lut_precision prec, int comps,
+                                        enum pl_fmt_caps caps, const float *data,
+                                        size_t num, const void **out_data)
+{
+    const struct pl_fmt *fmt = NULL;
+    switch (prec) {
+    case SH_LUT_HALF:
+        fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, comps, 16, 16, caps);
+        break;
+    case SH_LUT_UNORM16:
+        fmt = pl_find_fmt(gpu, PL_FMT_UNORM, comps, 16, 16, caps);
+        break;
+    case SH_LUT_FULL:
+        break;
+    }
+
+    if (fmt) {
+        uint16_t *conv = talloc_array(tactx, uint16_t, num);
+        for (size_t i = 0; i < num; i++) {
+            float x = data[i];
+            if (prec == SH_LUT_HALF) {
+                conv[i] = float_to_half(x);
+            } else {
+                conv[i] = PL_MAX(0.0, PL_MIN(x, 1.0)) * 0xFFFF + 0.5;
+            }
+        }
+
+        *out_data = conv;
+        return fmt;
+    }
+
+    *out_data = data;
+    return pl_find_fmt(gpu, PL_FMT_FLOAT, comps, 16, 32, caps);
+}
+
+ident_t sh_lut(struct pl_shader *sh, const struct sh_lut_params *params)
 {
     const struct pl_gpu *gpu = SH_GPU(sh);
+    struct pl_shader_obj **obj = params->object;
+    enum sh_lut_method method = params->method;
+    enum sh_lut_precision prec = params->precision;
+    int width = params->width, height = params->height, depth = params->depth;
+    int comps = params->comps;
+    bool update = params->update;
     float *tmp = NULL;
     ident_t ret = NULL;
 
@@ -716,9 +1069,9 @@ next_dim: ; // `continue` out of the inner loop
 
     // Forcibly reinitialize the existing LUT if needed
     if (method != lut->method || width != lut->width || height != lut->height
-        || depth != lut->depth || comps != lut->comps)
+        || depth != lut->depth || comps != lut->comps || prec != lut->precision)
     {
-        PL_DEBUG(sh, "LUT method or size changed, reinitializing..");
+        PL_DEBUG(sh, "LUT method, size or precision changed, reinitializing..");
         update = true;
     }
 
@@ -726,7 +1079,7 @@ next_dim: ; // `continue` out of the inner loop
         sh_lut_uninit(gpu, lut);
 
         tmp = talloc_zero_size(NULL, size * comps * sizeof(float));
-        fill(priv, tmp, width, height, depth);
+        params->fill(params->priv, tmp, width, height, depth);
 
         switch (method) {
         case SH_LUT_TEXTURE:
@@ -744,15 +1097,19 @@ next_dim: ; // `continue` out of the inner loop
                 mode = PL_TEX_SAMPLE_LINEAR;
             }
 
+            const void *texdata;
             const struct pl_fmt *fmt;
-            fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, comps, 16, 32, caps);
+            fmt = lut_tex_fmt(gpu, tmp, prec, comps, caps, tmp, size * comps,
+                              &texdata);
             if (!fmt) {
                 SH_FAIL(sh, "Found no compatible texture format for LUT!");
                 goto error;
             }
 
             pl_assert(!lut->weights.tex);
-            lut->weights.tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+            lut->weights.tex = lut_tex_acquire(gpu, method, width, height,
+                                               depth, comps, tmp,
+                                               &(struct pl_tex_params) {
                 .w              = width,
                 .h              = PL_DEF(height, texdim >= 2 ? 1 : 0),
                 .d              = PL_DEF(depth,  texdim >= 3 ? 1 : 0),
@@ -760,7 +1117,7 @@ next_dim: ; // `continue` out of the inner loop
                 .sampleable     = true,
                 .sample_mode    = mode,
                 .address_mode   = PL_TEX_ADDRESS_CLAMP,
-                .initial_data   = tmp,
+                .initial_data   = texdata,
             });
 
             if (!lut->weights.tex) {
@@ -802,6 +1159,7 @@ next_dim: ; // `continue` out of the inner loop
         lut->height = height;
         lut->depth = depth;
         lut->comps = comps;
+        lut->precision = prec;
     }
 
     // Done updating, generate the GLSL
@@ -820,7 +1178,7 @@ next_dim: ; // `continue` out of the inner loop
                 .name = "weights",
                 .type = PL_DESC_SAMPLED_TEX,
             },
-            .object = lut->weights.tex,
+            .object = lut->weights.tex->tex,
         });
 
         GLSLH("#define %s(pos) (texelFetch(%s, %s(pos",
@@ -842,7 +1200,7 @@ next_dim: ; // `continue` out of the inner loop
                 .name = "weights",
                 .type = PL_DESC_SAMPLED_TEX,
             },
-            .object = lut->weights.tex,
+            .object = lut->weights.tex->tex,
         });
 
         ident_t pos_macros[PL_ARRAY_SIZE(sizes)] = {0};
@@ -850,7 +1208,7 @@ next_dim: ; // `continue` out of the inner loop
             pos_macros[i] = sh_lut_pos(sh, sizes[i]);
 
         GLSLH("#define %s(pos) (%s(%s, %s(\\\n",
-              name, sh_tex_fn(sh, lut->weights.tex), tex, types[texdim - 1]);
+              name, sh_tex_fn(sh, lut->weights.tex->tex), tex, types[texdim - 1]);
 
         for (int i = 0; i < texdim; i++) {
             char sep = i == 0 ? ' ' : ',';
@@ -881,7 +1239,7 @@ next_dim: ; // `continue` out of the inner loop
     case SH_LUT_LITERAL:
         arr_name = sh_fresh(sh, "weights");
         GLSLH("const %s %s[%d] = float[](\n  ", types[comps - 1], arr_name, size);
-        bstr_xappend(sh, &sh->buffers[SH_BUF_HEADER], lut->weights.str);
+        pl_shader_append_bstr(sh, SH_BUF_HEADER, lut->weights.str);
         GLSLH(");\n");
         break;
 
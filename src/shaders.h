@@ -39,7 +39,12 @@ enum pl_shader_buf {
 struct pl_shader {
     struct pl_context *ctx;
     struct pl_shader_res res; // for accumulating vertex_attribs etc.
-    struct xta_ref *tmp;
+    // Arena for the short-lived allocations of a shader (identifiers,
+    // variable contents, etc.). These only live until `pl_shader_reset`, but
+    // the underlying memory is retained, so that re-building a shader of
+    // similar complexity does not need to touch the heap at all.
+    void *tmp;
+    uint64_t signature; // accumulated as text is appended
     bool failed;
     bool mutable;
     int output_w;
@@ -47,7 +52,13 @@ struct pl_shader {
     struct bstr buffers[SH_BUF_COUNT];
     bool is_compute;
     bool flexible_work_groups;
+    bool float16; // uses 16-bit float arithmetic (see `sh_float16`)
+    bool subgroups; // uses subgroup operations (see `sh_subgroups`)
     int fresh;
+
+    // Human-readable descriptions of the steps making up this shader
+    const char **steps;
+    int num_steps;
 };
 
 // Helper functions for convenience
@@ -57,6 +68,18 @@ struct pl_shader {
 // Returns the GLSL description, defaulting to desktop 130.
 struct pl_glsl_desc sh_glsl(const struct pl_shader *sh);
 
+// Returns whether the shader may use 16-bit float arithmetic (`float16_t`,
+// `f16vec4` etc.), i.e. whether `pl_shader_params.float16` is set and the GPU
+// supports it. If true, the shader is marked as requiring the corresponding
+// GLSL extension, so only call this when actually planning on using it.
+bool sh_float16(struct pl_shader *sh);
+
+// Returns whether the shader may use basic and arithmetic subgroup operations
+// (`subgroupAdd`, `subgroupElect` etc.), i.e. whether it's a compute shader
+// and the GPU supports them. Like `sh_float16`, this marks the shader as
+// requiring the corresponding GLSL extensions.
+bool sh_subgroups(struct pl_shader *sh);
+
 #define SH_FAIL(sh, ...) do {    \
         sh->failed = true;       \
         PL_ERR(sh, __VA_ARGS__); \
@@ -65,11 +88,21 @@ struct pl_glsl_desc sh_glsl(const struct pl_shader *sh);
 // Attempt enabling compute shaders for this pass, if possible
 bool sh_try_compute(struct pl_shader *sh, int bw, int bh, bool flex, size_t mem);
 
+// Returns whether or not the corresponding `sh_try_compute` call would
+// succeed, without modifying the shader
+bool sh_can_compute(const struct pl_shader *sh, int bw, int bh, bool flex,
+                    size_t mem);
+
 // Attempt merging a secondary shader into the current shader. Returns NULL if
 // merging fails (e.g. incompatible signatures); otherwise returns an identifier
 // corresponding to the generated subpass function.
 ident_t sh_subpass(struct pl_shader *sh, const struct pl_shader *sub);
 
+// Append a human-readable description of the current step to the shader,
+// e.g. for the purposes of labelling passes in profiling output. Consecutive
+// duplicate descriptions are merged. The string is copied internally.
+void sh_describe(struct pl_shader *sh, const char *desc);
+
 // Helpers for adding new variables/descriptors/etc. with fresh, unique
 // identifier names. These will never conflcit with other identifiers, even
 // if the shaders are merged together.
@@ -116,6 +149,10 @@ void pl_shader_append(struct pl_shader *sh, enum pl_shader_buf buf,
                       const char *fmt, ...)
     PRINTF_ATTRIBUTE(3, 4);
 
+// Like `pl_shader_append`, but for pre-formatted text
+void pl_shader_append_bstr(struct pl_shader *sh, enum pl_shader_buf buf,
+                           struct bstr str);
+
 #define GLSLP(...) pl_shader_append(sh, SH_BUF_PRELUDE, __VA_ARGS__)
 #define GLSLH(...) pl_shader_append(sh, SH_BUF_HEADER, __VA_ARGS__)
 #define GLSL(...)  pl_shader_append(sh, SH_BUF_BODY, __VA_ARGS__)
@@ -136,6 +173,7 @@ enum pl_shader_obj_type {
     PL_SHADER_OBJ_3DLUT,
     PL_SHADER_OBJ_LUT,
     PL_SHADER_OBJ_AV1_GRAIN,
+    PL_SHADER_OBJ_TONE_MAP,
 };
 
 struct pl_shader_obj {
@@ -172,6 +210,26 @@ enum sh_lut_method {
     SH_LUT_LINEAR,   // upload as linearly-sampleable texture
 };
 
+// Precision hint for texture-based LUTs. If no texture format with the
+// requested precision is available, 32-bit floats are used instead.
+enum sh_lut_precision {
+    SH_LUT_FULL = 0, // 32-bit float
+    SH_LUT_HALF,     // 16-bit float, for values with a large dynamic range
+    SH_LUT_UNORM16,  // 16-bit normalized, for values clamped to [0,1]
+};
+
+struct sh_lut_params {
+    struct pl_shader_obj **object;
+    enum sh_lut_method method;
+    enum sh_lut_precision precision;
+    int width, height, depth, comps;
+    bool update;
+
+    // Called with a zero-initialized buffer of float values, see `sh_lut`
+    void *priv;
+    void (*fill)(void *priv, float *data, int w, int h, int d);
+};
+
 // Makes a table of float vecs values available as a shader variable, using an
 // a given method (falling back if needed). The resulting identifier can be
 // sampled directly as %s(pos), where pos is a vector with the right number of
@@ -184,12 +242,10 @@ enum sh_lut_method {
 // the caller)
 //
 // The `fill` function will be called with a zero-initialized buffer whenever
-// the data needs to be computed, which happens whenever the size is changed,
-// the shader object is invalidated, or `update` is set to true.
-ident_t sh_lut(struct pl_shader *sh, struct pl_shader_obj **obj,
-               enum sh_lut_method method, int width, int height, int depth,
-               int components, bool update, void *priv,
-               void (*fill)(void *priv, float *data, int w, int h, int d));
+// the data needs to be computed, which happens whenever the size or precision
+// is changed, the shader object is invalidated, or `update` is set to true.
+// For reduced precision LUTs, the values are converted after filling.
+ident_t sh_lut(struct pl_shader *sh, const struct sh_lut_params *params);
 
 // Returns a GLSL-version appropriate "bvec"-like type. For GLSL 130+, this
 // returns bvecN. For GLSL 120, this returns vecN instead. The intended use of
@@ -435,29 +435,33 @@ static void generate_grain_uv(float *out, int16_t buf[GRAIN_HEIGHT][GRAIN_WIDTH]
     }
 }
 
-static void generate_offsets(uint32_t *buf, int offsets_x, int offsets_y,
-                             const struct pl_grain_params *params)
+// The random offset of block `x` in row `y` is the upper byte of the row's
+// PRNG state after `x + 1` steps, where the PRNG state is initialized from
+// the `grain_seed` and `y`. Since the PRNG is a linear feedback shift
+// register, advancing it by `n` steps is a linear map over GF(2), so each bit
+// of the result is simply the parity of the initial state masked by some
+// constant. This generates the masks for the eight upper bits, for every
+// `n` from 1 to `w`, which allows the GPU to compute the offsets of any block
+// directly with no dependency on previous blocks (nor on the seed).
+static void generate_offset_masks(void *priv, float *data, int w, int h, int d)
 {
-    for (int y = 0; y < offsets_y; y++) {
-        uint16_t state = params->grain_seed;
-        state ^= ((y * 37 + 178) & 0xFF) << 8;
-        state ^= ((y * 173 + 105) & 0xFF);
-
-        for (int x = 0; x < offsets_x; x++) {
-            uint32_t *offsets = &buf[y * offsets_x + x];
-
-            uint8_t val = get_random_number(8, &state);
-            uint8_t val_l = x ? (offsets - 1)[0] : 0;
-            uint8_t val_t = y ? (offsets - offsets_x)[0] : 0;
-            uint8_t val_tl = x && y ? (offsets - offsets_x - 1)[0] : 0;
-
-            // Encode four offsets into a single 32-bit integer for
-            // the convenience of the GPU. That way only one SSBO read is
-            // required for the entire block.
-            *offsets = (val_tl << OFFSET_TL)
-                     | (val_t  << OFFSET_T)
-                     | (val_l  << OFFSET_L)
-                     | (val    << OFFSET_N);
+    pl_assert(h == 2);
+
+    // Track the state resulting from each individual bit of the input
+    uint16_t basis[16];
+    for (int i = 0; i < 16; i++)
+        basis[i] = 1 << i;
+
+    for (int n = 0; n < w; n++) {
+        for (int i = 0; i < 16; i++)
+            get_random_number(0, &basis[i]); // advance by one step
+
+        for (int b = 0; b < 8; b++) {
+            uint16_t mask = 0;
+            for (int i = 0; i < 16; i++)
+                mask |= ((basis[i] >> (8 + b)) & 1) << i;
+            // Row 0 holds bits 0-3, row 1 holds bits 4-7
+            data[((b / 4) * w + n) * 4 + b % 4] = mask;
         }
     }
 }
@@ -573,23 +577,67 @@ static void get_grain_for_channel(struct pl_shader *sh, enum pl_channel c,
     }
 }
 
+// Since the grain templates only depend on a subset of the grain parameters,
+// streams which repeat the same parameters (e.g. `update_grain = 0`) can
+// reuse previously generated SSBOs. This is the maximum number of distinct
+// templates kept around at any given time.
+#define GRAIN_CACHE_SIZE 4
+
+struct grain_buf {
+    const struct pl_buf *buf;
+    uint64_t key;      // hash of the parameters this buffer was generated for
+    uint64_t last_use; // for LRU eviction
+};
+
+static uint64_t grain_key(const struct pl_grain_params *params,
+                          bool has_luma, bool has_chroma)
+{
+    struct {
+        int32_t sub_x, sub_y;
+        int32_t sample_depth, color_depth, bit_shift;
+        int32_t has_luma, has_chroma;
+        int32_t grain_seed;
+        int32_t ar_coeff_lag;
+        int32_t ar_coeff_shift;
+        int32_t grain_scale_shift;
+        int8_t ar_coeffs_y[24];
+        int8_t ar_coeffs_uv[2][25];
+    } key;
+
+    // Zero the whole struct explicitly, so the hash is stable
+    memset(&key, 0, sizeof(key));
+    key.sub_x = params->sub_x;
+    key.sub_y = params->sub_y;
+    key.sample_depth = params->repr.bits.sample_depth;
+    key.color_depth = params->repr.bits.color_depth;
+    key.bit_shift = params->repr.bits.bit_shift;
+    key.has_luma = has_luma;
+    key.has_chroma = has_chroma;
+    key.grain_seed = params->grain_seed;
+    key.ar_coeff_lag = params->ar_coeff_lag;
+    key.ar_coeff_shift = params->ar_coeff_shift;
+    key.grain_scale_shift = params->grain_scale_shift;
+    memcpy(key.ar_coeffs_y, params->ar_coeffs_y, sizeof(key.ar_coeffs_y));
+    memcpy(key.ar_coeffs_uv, params->ar_coeffs_uv, sizeof(key.ar_coeffs_uv));
+    return siphash64((const uint8_t *) &key, sizeof(key));
+}
+
 struct sh_grain_obj {
-    // SSBO state and layout
-    struct pl_buf_pool ssbos;
+    // SSBO cache and layout
+    struct grain_buf bufs[GRAIN_CACHE_SIZE];
+    uint64_t use_count;
     struct pl_shader_desc desc;
     struct pl_var_layout layout_y;
     struct pl_var_layout layout_cb;
     struct pl_var_layout layout_cr;
-    struct pl_var_layout layout_off;
     void *tmp; // to hold `desc`'s contents
 
-    // LUT objects for the scaling luts
+    // LUT objects for the scaling luts, and the block offset masks
     struct pl_shader_obj *scaling[3];
+    struct pl_shader_obj *offset_masks;
 
     // Previous parameters used to check reusability
-    int num_offsets;
     int chroma_lut_size;
-    uint32_t *offsets;
     struct pl_grain_params params;
 
     // Space to store the temporary arrays, reused
@@ -601,9 +649,11 @@ struct sh_grain_obj {
 static void sh_grain_uninit(const struct pl_gpu *gpu, void *ptr)
 {
     struct sh_grain_obj *obj = ptr;
-    pl_buf_pool_uninit(gpu, &obj->ssbos);
+    for (int i = 0; i < GRAIN_CACHE_SIZE; i++)
+        pl_buf_destroy(gpu, &obj->bufs[i].buf);
     for (int i = 0; i < 3; i++)
         pl_shader_obj_destroy(&obj->scaling[i]);
+    pl_shader_obj_destroy(&obj->offset_masks);
     *obj = (struct sh_grain_obj) {0};
 }
 
@@ -656,17 +706,10 @@ void pl_shader_av1_grain(struct pl_shader *sh,
         return;
 
     int offsets_x = PL_ALIGN2(params->width,  128) / 32;
-    int offsets_y = PL_ALIGN2(params->height, 128) / 32;
 
     int chroma_lut_size = (GRAIN_WIDTH_LUT >> params->sub_x)
                         * (GRAIN_HEIGHT_LUT >> params->sub_y);
 
-    // Note: In theory we could check only the parameters related to
-    // luma or only related to chroma and skip updating parts of the SSBO,
-    // but this is probably not worth it since the grain_seed is expected
-    // to change per frame anyway.
-    bool needs_update = memcmp(params, &obj->params, sizeof(*params)) != 0;
-
     // For the scaling LUTs, we assume they'll be relatively constant
     // throughout the video so doing some extra work to avoid reinitializing
     // them constantly is probably worth it. Probably.
@@ -687,9 +730,7 @@ void pl_shader_av1_grain(struct pl_shader *sh,
         }
     }
 
-    if (offsets_x * offsets_y != obj->num_offsets ||
-        chroma_lut_size != obj->chroma_lut_size)
-    {
+    if (chroma_lut_size != obj->chroma_lut_size) {
         // (Re-)generate the SSBO layout
         if (obj->tmp) {
             talloc_free_children(obj->tmp);
@@ -726,49 +767,77 @@ void pl_shader_av1_grain(struct pl_shader *sh,
         ok &= sh_buf_desc_append(obj->tmp, SH_GPU(sh), &obj->desc,
                                  &obj->layout_cr, grain_cr);
 
-        struct pl_var offsets = pl_var_uint("offsets");
-        offsets.dim_a = offsets_x * offsets_y;
-        ok &= sh_buf_desc_append(obj->tmp, SH_GPU(sh), &obj->desc,
-                                 &obj->layout_off, offsets);
-
         if (!ok) {
             PL_ERR(sh, "Failed generating SSBO buffer placement: Either GPU "
                    "limits exceeded or width/height nonsensical?");
             return;
         }
 
-        obj->num_offsets = offsets_x * offsets_y;
         obj->chroma_lut_size = chroma_lut_size;
-        TARRAY_GROW(obj, obj->offsets, obj->num_offsets);
-        needs_update = true;
+
+        // The cached templates were generated for the old layout
+        for (int i = 0; i < GRAIN_CACHE_SIZE; i++)
+            obj->bufs[i].key = 0;
     }
 
-    const struct pl_buf *ssbo;
-    if (obj->desc.object && !needs_update) {
-        ssbo = obj->desc.object;
-    } else {
-        needs_update = true;
+    // Note: In theory we could cache the luma and chroma templates separately,
+    // but this is probably not worth it since the grain_seed is shared anyway.
+    uint64_t key = grain_key(params, has_luma, has_chroma);
+    struct grain_buf *entry = NULL;
+    for (int i = 0; i < GRAIN_CACHE_SIZE; i++) {
+        if (obj->bufs[i].buf && obj->bufs[i].key == key) {
+            entry = &obj->bufs[i];
+            break;
+        }
+    }
+
+    bool needs_update = !entry;
+    if (!entry) {
+        // Prefer empty slots, followed by the least recently used buffer that
+        // is not currently in use by the GPU. If all of them are busy, block
+        // on the oldest one instead of allocating without bound.
+        for (int i = 0; i < GRAIN_CACHE_SIZE; i++) {
+            struct grain_buf *e = &obj->bufs[i];
+            if (!e->buf) {
+                entry = e;
+                break;
+            }
+
+            if (pl_buf_poll(SH_GPU(sh), e->buf, 0))
+                continue;
+            if (!entry || e->last_use < entry->last_use)
+                entry = e;
+        }
+
+        if (!entry) {
+            entry = &obj->bufs[0];
+            for (int i = 1; i < GRAIN_CACHE_SIZE; i++) {
+                if (obj->bufs[i].last_use < entry->last_use)
+                    entry = &obj->bufs[i];
+            }
+            while (pl_buf_poll(SH_GPU(sh), entry->buf, UINT64_MAX))
+                ; // do nothing
+        }
 
-        // Get the next free SSBO buffer, regenerate if necessary
         struct pl_buf_params ssbo_params = {
             .type = PL_BUF_STORAGE,
             .size = sh_buf_desc_size(&obj->desc),
             .host_writable = true,
         };
 
-        const struct pl_buf *last_buf = obj->desc.object;
-        if (last_buf && last_buf->params.size > ssbo_params.size)
-            ssbo_params.size = last_buf->params.size;
-
-        ssbo = pl_buf_pool_get(SH_GPU(sh), &obj->ssbos, &ssbo_params);
-        if (!ssbo) {
+        // Invalidate the entry before recreating it, so a failure can't
+        // leave behind a stale template under the old key
+        entry->key = 0;
+        if (!pl_buf_recreate(SH_GPU(sh), &entry->buf, &ssbo_params)) {
             PL_ERR(sh, "Failed creating/getting SSBO buffer for AV1 grain!");
             return;
         }
-
-        obj->desc.object = ssbo;
     }
 
+    const struct pl_buf *ssbo = entry->buf;
+    entry->last_use = ++obj->use_count;
+    obj->desc.object = ssbo;
+
     if (needs_update) {
         // This is needed even for chroma
         generate_grain_y(obj->grain, obj->grain_tmp_y, params);
@@ -793,14 +862,11 @@ void pl_shader_av1_grain(struct pl_shader *sh,
                          sizeof(float) * chroma_lut_size);
         }
 
-        generate_offsets(obj->offsets, offsets_x, offsets_y, params);
-        pl_assert(obj->layout_off.stride == sizeof(uint32_t));
-        pl_buf_write(SH_GPU(sh), ssbo, obj->layout_off.offset, obj->offsets,
-                     obj->num_offsets * obj->layout_off.stride);
-
-        obj->params = *params;
+        entry->key = key;
     }
 
+    obj->params = *params;
+
     // Update the scaling LUTs
     ident_t scaling[3] = {0};
     for (int i = 0; i < 3; i++) {
@@ -820,9 +886,18 @@ void pl_shader_av1_grain(struct pl_shader *sh,
         }
 
         if (priv.num > 0) {
-            scaling[i] = sh_lut(sh, &obj->scaling[i], SH_LUT_LINEAR,
-                                SCALING_LUT_SIZE, 0, 0, 1, scaling_changed,
-                                &priv, generate_scaling);
+            // The scaling values are multiples of 2^-scaling_shift, which
+            // FP16 represents exactly
+            scaling[i] = sh_lut(sh, &(struct sh_lut_params) {
+                .object = &obj->scaling[i],
+                .method = SH_LUT_LINEAR,
+                .precision = SH_LUT_HALF,
+                .width = SCALING_LUT_SIZE,
+                .comps = 1,
+                .update = scaling_changed,
+                .priv = &priv,
+                .fill = generate_scaling,
+            });
 
             if (!scaling[i]) {
                 PL_ERR(sh, "Failed generating/uploading scaling LUTs!");
@@ -831,9 +906,55 @@ void pl_shader_av1_grain(struct pl_shader *sh,
         }
     }
 
+    // The offset masks only depend on the number of blocks per row
+    ident_t masks = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &obj->offset_masks,
+        .width = offsets_x,
+        .height = 2,
+        .comps = 4,
+        .fill = generate_offset_masks,
+    });
+    if (!masks) {
+        PL_ERR(sh, "Failed generating/uploading offset LUT!");
+        return;
+    }
+
+    ident_t seed = sh_var(sh, (struct pl_shader_var) {
+        .var = pl_var_uint("grain_seed"),
+        .data = &(unsigned int) { params->grain_seed },
+        .dynamic = true,
+    });
+
+    // Computes the offset of block `x` in a row, given the row's initial
+    // PRNG state, see `generate_offset_masks`
+    ident_t offset_fn = sh_fresh(sh, "grain_offset");
+    GLSLH("uint %s(uint state, uint x) {                        \n"
+          "    int n = int(min(x, %du));                         \n"
+          "    uvec4 lo = uvec4(%s(ivec2(n, 0))) & uvec4(state); \n"
+          "    uvec4 hi = uvec4(%s(ivec2(n, 1))) & uvec4(state); \n"
+          // Reduce each masked state to its parity
+          "    lo ^= lo >> 8u; hi ^= hi >> 8u;                   \n"
+          "    lo ^= lo >> 4u; hi ^= hi >> 4u;                   \n"
+          "    lo ^= lo >> 2u; hi ^= hi >> 2u;                   \n"
+          "    lo ^= lo >> 1u; hi ^= hi >> 1u;                   \n"
+          "    lo = (lo & uvec4(1u)) << uvec4(0u, 1u, 2u, 3u);   \n"
+          "    hi = (hi & uvec4(1u)) << uvec4(4u, 5u, 6u, 7u);   \n"
+          "    return lo.x | lo.y | lo.z | lo.w                  \n"
+          "         | hi.x | hi.y | hi.z | hi.w;                 \n"
+          "}                                                     \n",
+          offset_fn, offsets_x - 1, masks, masks);
+
+    ident_t row_fn = sh_fresh(sh, "grain_row_state");
+    GLSLH("uint %s(uint y) {                                     \n"
+          "    return %s ^ (((y * 37u + 178u) & 0xFFu) << 8u)     \n"
+          "              ^ ((y * 173u + 105u) & 0xFFu);           \n"
+          "}                                                     \n",
+          row_fn, seed);
+
     // Attach the SSBO
     sh_desc(sh, obj->desc);
 
+    sh_describe(sh, "AV1 film grain");
     GLSL("// pl_shader_av1_grain \n"
          "{                      \n"
          "uvec2 offset;          \n"
@@ -852,8 +973,20 @@ void pl_shader_av1_grain(struct pl_shader *sh,
              bw, bh, bw, bh);
     }
 
-    // Load the data vector which holds the offsets
-    GLSL("uint data = offsets[block_id.y * %d + block_id.x]; \n", offsets_x);
+    // Compute the data vector which holds the offsets of this block and its
+    // neighbours, encoded into a single integer
+    GLSL("uint state = %s(block_id.y);                                   \n"
+         "uint data = %s(state, block_id.x) << %du;                      \n"
+         "if (block_id.x > 0u)                                          \n"
+         "    data |= %s(state, block_id.x - 1u) << %du;                 \n"
+         "if (block_id.y > 0u) {                                        \n"
+         "    state = %s(block_id.y - 1u);                               \n"
+         "    data |= %s(state, block_id.x) << %du;                      \n"
+         "    if (block_id.x > 0u)                                      \n"
+         "        data |= %s(state, block_id.x - 1u) << %du;             \n"
+         "}                                                             \n",
+         row_fn, offset_fn, OFFSET_N, offset_fn, OFFSET_L,
+         row_fn, offset_fn, OFFSET_T, offset_fn, OFFSET_TL);
 
     // If we need access to the external luma plane, load it now
     if (is_chroma) {
@@ -17,6 +17,7 @@
 
 #include <math.h>
 #include "shaders.h"
+#include "colorspace.h"
 
 void pl_shader_decode_color(struct pl_shader *sh, struct pl_color_repr *repr,
                             const struct pl_color_adjustment *params)
@@ -24,6 +25,7 @@ void pl_shader_decode_color(struct pl_shader *sh, struct pl_color_repr *repr,
     if (!sh_require(sh, PL_SHADER_SIG_COLOR, 0, 0))
         return;
 
+    sh_describe(sh, "color decoding");
     GLSL("// pl_shader_decode_color \n"
          "{ \n");
 
@@ -109,7 +111,8 @@ void pl_shader_decode_color(struct pl_shader *sh, struct pl_color_repr *repr,
                                         ? PL_COLOR_TRC_PQ
                                         : PL_COLOR_TRC_HLG;
 
-        // Inverted from the matrix in the spec, transposed to column major
+        // Inverted from the matrix in the spec, transposed to column major.
+        // Must match `pl_bt2100_lms2rgb`
         static const char *bt2100_lms2rgb = "mat3("
             "  3.43661,  -0.79133, -0.0259499, "
             " -2.50645,    1.9836, -0.0989137, "
@@ -153,6 +156,7 @@ void pl_shader_encode_color(struct pl_shader *sh,
     if (!sh_require(sh, PL_SHADER_SIG_COLOR, 0, 0))
         return;
 
+    sh_describe(sh, "color encoding");
     GLSL("// pl_shader_encode_color \n"
          "{ \n");
 
@@ -182,31 +186,6 @@ void pl_shader_encode_color(struct pl_shader *sh,
     GLSL("}\n");
 }
 
-// Common constants for SMPTE ST.2084 (PQ)
-static const float PQ_M1 = 2610./4096 * 1./4,
-                   PQ_M2 = 2523./4096 * 128,
-                   PQ_C1 = 3424./4096,
-                   PQ_C2 = 2413./4096 * 32,
-                   PQ_C3 = 2392./4096 * 32;
-
-// Common constants for ARIB STD-B67 (HLG)
-static const float HLG_A = 0.17883277,
-                   HLG_B = 0.28466892,
-                   HLG_C = 0.55991073;
-
-// Common constants for Panasonic V-Log
-static const float VLOG_B = 0.00873,
-                   VLOG_C = 0.241514,
-                   VLOG_D = 0.598206;
-
-// Common constants for Sony S-Log
-static const float SLOG_A = 0.432699,
-                   SLOG_B = 0.037584,
-                   SLOG_C = 0.616596 + 0.03,
-                   SLOG_P = 3.538813,
-                   SLOG_Q = 0.030001,
-                   SLOG_K2 = 155.0 / 219.0;
-
 void pl_shader_linearize(struct pl_shader *sh, enum pl_color_transfer trc)
 {
     if (!sh_require(sh, PL_SHADER_SIG_COLOR, 0, 0))
@@ -422,6 +401,7 @@ static ident_t sh_luma_coeffs(struct pl_shader *sh, enum pl_color_primaries prim
     return sh_var(sh, (struct pl_shader_var) {
         .var = pl_var_vec3("luma_coeffs"),
         .data = rgb2xyz.m[1], // RGB->Y vector
+        .compile_time = true, // only depends on the primaries
     });
 }
 
@@ -515,19 +495,85 @@ const struct pl_peak_detect_params pl_peak_detect_default_params = {
     .scene_threshold_high   = 10.0,
 };
 
+// Signal level range covered by the histogram, in log2 units. This goes from
+// roughly 0.1 cd/m^2 up to ~12800 cd/m^2
+#define HIST_MIN_LOG2 -10.0
+#define HIST_MAX_LOG2 7.0
+
+// Each frame writes its histogram results into the next of these buffers, so
+// the results of previous frames can be read back without stalling the GPU
+#define HIST_READBACK_DEPTH 4
+
 struct sh_peak_obj {
     const struct pl_gpu *gpu;
     const struct pl_buf *buf;
     struct pl_shader_desc desc;
+
+    // Histogram state, only used if `num_bins` is nonzero
+    int num_bins;
+    struct pl_shader_desc rb_desc;
+    struct pl_var_layout rb_average, rb_frame, rb_delta, rb_bins;
+    const struct pl_buf *readback[HIST_READBACK_DEPTH];
+    bool rb_pending[HIST_READBACK_DEPTH];
+    int rb_idx;
+    uint8_t *rb_data; // scratch space for reading back results
+    uint32_t *bins;   // bins of `result`
+    struct pl_peak_histogram result;
 };
 
 static void sh_peak_uninit(const struct pl_gpu *gpu, void *ptr)
 {
     struct sh_peak_obj *obj = ptr;
     pl_buf_destroy(obj->gpu, &obj->buf);
+    for (int i = 0; i < HIST_READBACK_DEPTH; i++)
+        pl_buf_destroy(obj->gpu, &obj->readback[i]);
+    talloc_free(obj->desc.buffer_vars);
+    talloc_free(obj->rb_desc.buffer_vars);
+    talloc_free(obj->rb_data);
+    talloc_free(obj->bins);
     *obj = (struct sh_peak_obj) {0};
 }
 
+static bool peak_hist_init(struct sh_peak_obj *obj, const struct pl_gpu *gpu)
+{
+    int n = obj->num_bins;
+    struct pl_var bins = pl_var_uint("hist_bins");
+    bins.dim_a = n;
+
+    obj->rb_desc = (struct pl_shader_desc) {
+        .desc = {
+            .name   = "PeakReadback",
+            .type   = PL_DESC_BUF_STORAGE,
+            .access = PL_DESC_ACCESS_WRITEONLY,
+        },
+    };
+
+    bool ok = true;
+    ok &= sh_buf_desc_append(obj, gpu, &obj->rb_desc, &obj->rb_average, pl_var_vec2("hist_average"));
+    ok &= sh_buf_desc_append(obj, gpu, &obj->rb_desc, &obj->rb_frame, pl_var_uint("hist_frame"));
+    ok &= sh_buf_desc_append(obj, gpu, &obj->rb_desc, &obj->rb_delta, pl_var_float("hist_delta"));
+    ok &= sh_buf_desc_append(obj, gpu, &obj->rb_desc, &obj->rb_bins, bins);
+    if (!ok)
+        return false;
+
+    size_t size = sh_buf_desc_size(&obj->rb_desc);
+    obj->rb_data = talloc_zero_size(obj, size);
+    obj->bins = talloc_zero_array(obj, uint32_t, n);
+    for (int i = 0; i < HIST_READBACK_DEPTH; i++) {
+        obj->readback[i] = pl_buf_create(gpu, &(struct pl_buf_params) {
+            .type = PL_BUF_STORAGE,
+            .size = size,
+            .host_readable = true,
+            .initial_data = obj->rb_data,
+        });
+
+        if (!obj->readback[i])
+            return false;
+    }
+
+    return true;
+}
+
 static inline float iir_coeff(float rate)
 {
     float a = 1.0 - cos(1.0 / rate);
@@ -543,7 +589,14 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
     if (!sh_require(sh, PL_SHADER_SIG_COLOR, 0, 0))
         return false;
 
-    if (!sh_try_compute(sh, 8, 8, true, 2 * sizeof(int32_t))) {
+    int num_bins = params->histogram_bins;
+    if (num_bins < 0 || num_bins > PL_PEAK_HISTOGRAM_MAX_BINS) {
+        PL_ERR(sh, "Invalid number of histogram bins: %d", num_bins);
+        return false;
+    }
+
+    size_t shmem = 2 * sizeof(int32_t) + num_bins * sizeof(uint32_t);
+    if (!sh_try_compute(sh, 8, 8, true, shmem)) {
         PL_ERR(sh, "HDR peak detection requires compute shaders!");
         return false;
     }
@@ -555,9 +608,15 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
         return false;
 
     const struct pl_gpu *gpu = SH_GPU(sh);
+    if (obj->buf && obj->num_bins != num_bins) {
+        // The buffer layout depends on the number of bins, so start over
+        sh_peak_uninit(gpu, obj);
+    }
+
     obj->gpu = gpu;
 
     if (!obj->buf) {
+        obj->num_bins = num_bins;
         obj->desc = (struct pl_shader_desc) {
             .desc = {
                 .name   = "PeakDetect",
@@ -570,6 +629,12 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
         ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, pl_var_int("frame_sum"));
         ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, pl_var_int("frame_max"));
         ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, pl_var_uint("counter"));
+        if (num_bins) {
+            struct pl_var frame_hist = pl_var_uint("frame_hist");
+            frame_hist.dim_a = num_bins;
+            ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, pl_var_uint("frames"));
+            ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, frame_hist);
+        }
 
         if (!ok) {
             PL_ERR(sh, "HDR peak detection exhausts device limits!");
@@ -586,6 +651,12 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
         });
         obj->desc.object = obj->buf;
         talloc_free(data);
+
+        if (obj->buf && num_bins && !peak_hist_init(obj, gpu)) {
+            PL_ERR(sh, "Failed creating peak detection histogram buffers!");
+            sh_peak_uninit(gpu, obj);
+            return false;
+        }
     }
 
     if (!obj->buf) {
@@ -596,6 +667,14 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
     // Attach the SSBO and perform the peak detection logic
     obj->desc.desc.access = PL_DESC_ACCESS_READWRITE;
     sh_desc(sh, obj->desc);
+    if (num_bins) {
+        obj->rb_idx = (obj->rb_idx + 1) % HIST_READBACK_DEPTH;
+        obj->rb_desc.object = obj->readback[obj->rb_idx];
+        obj->rb_pending[obj->rb_idx] = true;
+        sh_desc(sh, obj->rb_desc);
+    }
+
+    sh_describe(sh, "peak detection");
     GLSL("// pl_shader_detect_peak \n"
          "{                        \n"
          "vec4 color_orig = color; \n");
@@ -610,25 +689,73 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
     ident_t wg_sum = sh_fresh(sh, "wg_sum"), wg_max = sh_fresh(sh, "wg_max");
     GLSLH("shared int %s;   \n", wg_sum);
     GLSLH("shared int %s;   \n", wg_max);
-    GLSL("%s = 0; %s = 0;   \n"
-         "barrier();        \n",
-         wg_sum, wg_max);
+    GLSL("%s = 0; %s = 0;   \n", wg_sum, wg_max);
+
+    // The histogram bins are spread across all threads of the work group
+    ident_t wg_hist = NULL;
+    if (num_bins) {
+        wg_hist = sh_fresh(sh, "wg_hist");
+        GLSLH("shared uint %s[%d]; \n", wg_hist, num_bins);
+        GLSL("for (uint i = gl_LocalInvocationIndex; i < %du;       \n"
+             "     i += gl_WorkGroupSize.x * gl_WorkGroupSize.y)    \n"
+             "    %s[i] = 0u;                                       \n",
+             num_bins, wg_hist);
+    }
+
+    GLSL("barrier(); \n");
 
     // Chosen to avoid overflowing on an 8K buffer
     const float log_min = 1e-3, log_scale = 400.0, sig_scale = 10000.0;
 
-    // Have each thread update the work group sum with the local value
     GLSL("float sig_max = max(max(color.r, color.g), color.b);  \n"
          "float sig_log = log(max(sig_max, %f));                \n"
-         "atomicAdd(%s, int(sig_log * %f));                     \n"
-         "atomicMax(%s, int(sig_max * %f));                     \n"
-         "memoryBarrierShared();                                \n"
-         "barrier();                                            \n"
-         "color = color_orig;                                   \n"
-         "}                                                     \n",
-         log_min,
-         wg_sum, log_scale,
-         wg_max, sig_scale);
+         "int t_sum = int(sig_log * %f);                        \n"
+         "int t_max = int(sig_max * %f);                        \n",
+         log_min, log_scale, sig_scale);
+
+    if (sh_subgroups(sh)) {
+        // Reduce within the subgroup first, so only one thread per subgroup
+        // has to touch the shared atomics
+        GLSL("t_sum = subgroupAdd(t_sum);           \n"
+             "t_max = subgroupMax(t_max);           \n"
+             "if (subgroupElect()) {                \n"
+             "    atomicAdd(%s, t_sum);             \n"
+             "    atomicMax(%s, t_max);             \n"
+             "}                                     \n",
+             wg_sum, wg_max);
+    } else {
+        // Have each thread update the work group sum with the local value
+        GLSL("atomicAdd(%s, t_sum); \n"
+             "atomicMax(%s, t_max); \n",
+             wg_sum, wg_max);
+    }
+
+    if (num_bins) {
+        GLSL("float hist_pos = log2(max(sig_max, 1e-6)) - %f;         \n"
+             "int hist_idx = clamp(int(hist_pos * %f), 0, %d);        \n"
+             "atomicAdd(%s[hist_idx], 1u);                            \n",
+             HIST_MIN_LOG2, num_bins / (HIST_MAX_LOG2 - HIST_MIN_LOG2),
+             num_bins - 1, wg_hist);
+    }
+
+    GLSL("memoryBarrierShared();    \n"
+         "barrier();                \n");
+
+    if (num_bins) {
+        // Merge the work group histogram into the frame histogram
+        GLSL("for (uint i = gl_LocalInvocationIndex; i < %du;       \n"
+             "     i += gl_WorkGroupSize.x * gl_WorkGroupSize.y)    \n"
+             "{                                                     \n"
+             "    if (%s[i] > 0u)                                   \n"
+             "        atomicAdd(frame_hist[i], %s[i]);              \n"
+             "}                                                     \n"
+             "memoryBarrierBuffer();                                \n"
+             "barrier();                                            \n",
+             num_bins, wg_hist, wg_hist);
+    }
+
+    GLSL("color = color_orig;       \n"
+         "}                         \n");
 
     // Have one thread per work group update the global atomics. Do this
     // at the end of the shader to avoid clobbering `average`, in case the
@@ -653,12 +780,16 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
     GLSLF("        if (average.y == 0.0) \n"
           "            average = cur;    \n");
 
+    float log_db = 10.0 / log(10.0);
+    if (num_bins) {
+        GLSLF("        float scene_delta = abs(log(cur.x / average.x)); \n");
+    }
+
     // Use an IIR low-pass filter to smooth out the detected values
     GLSLF("        average += %f * (cur - average); \n",
           iir_coeff(PL_DEF(params->smoothing_period, 100.0)));
 
     // Scene change hysteresis
-    float log_db = 10.0 / log(10.0);
     if (params->scene_threshold_low > 0 && params->scene_threshold_high > 0) {
         GLSLF("    float delta = abs(log(cur.x / average.x));               \n"
               "    average = mix(average, cur, smoothstep(%f, %f, delta));  \n",
@@ -666,6 +797,20 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
               params->scene_threshold_high / log_db);
     }
 
+    // Publish the completed histogram, together with the final state, into
+    // this frame's readback buffer
+    if (num_bins) {
+        GLSLF("        frames++;                              \n"
+              "        hist_average = average;                \n"
+              "        hist_frame = frames;                   \n"
+              "        hist_delta = scene_delta * %f;         \n"
+              "        for (int i = 0; i < %d; i++) {         \n"
+              "            hist_bins[i] = frame_hist[i];      \n"
+              "            frame_hist[i] = 0u;                \n"
+              "        }                                      \n",
+              log_db, num_bins);
+    }
+
     // Reset SSBO state for the next frame
     GLSLF("        frame_sum = 0;            \n"
           "        frame_max = 0;            \n"
@@ -677,6 +822,84 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
     return true;
 }
 
+bool pl_get_detected_histogram(const struct pl_shader_obj **state,
+                               struct pl_peak_histogram *out)
+{
+    if (!state || !*state || (*state)->type != PL_SHADER_OBJ_PEAK_DETECT)
+        return false;
+
+    struct sh_peak_obj *obj = (*state)->priv;
+    if (!obj->buf || !obj->num_bins)
+        return false;
+
+    size_t size = sh_buf_desc_size(&obj->rb_desc);
+    for (int i = 0; i < HIST_READBACK_DEPTH; i++) {
+        const struct pl_buf *buf = obj->readback[i];
+        if (!obj->rb_pending[i] || pl_buf_poll(obj->gpu, buf, 0))
+            continue;
+        if (!pl_buf_read(obj->gpu, buf, 0, obj->rb_data, size))
+            continue;
+
+        // Buffers which were attached to a shader that has not been
+        // dispatched (yet) still contain older results, so just skip them
+        uint32_t frame;
+        memcpy(&frame, obj->rb_data + obj->rb_frame.offset, sizeof(frame));
+        if (frame <= obj->result.frame)
+            continue;
+
+        float average[2], delta;
+        memcpy(average, obj->rb_data + obj->rb_average.offset, sizeof(average));
+        memcpy(&delta, obj->rb_data + obj->rb_delta.offset, sizeof(delta));
+        memcpy(obj->bins, obj->rb_data + obj->rb_bins.offset,
+               obj->num_bins * sizeof(uint32_t));
+
+        obj->rb_pending[i] = false;
+        obj->result = (struct pl_peak_histogram) {
+            .frame = frame,
+            .avg = average[0],
+            .peak = average[1],
+            .scene_delta = delta,
+            .min_level = exp2(HIST_MIN_LOG2),
+            .max_level = exp2(HIST_MAX_LOG2),
+            .bins = obj->bins,
+            .num_bins = obj->num_bins,
+        };
+
+        for (int n = 0; n < obj->num_bins; n++)
+            obj->result.total += obj->bins[n];
+    }
+
+    if (!obj->result.frame)
+        return false;
+
+    *out = obj->result;
+    return true;
+}
+
+float pl_peak_histogram_percentile(const struct pl_peak_histogram *hist,
+                                   float percentile)
+{
+    if (!hist->total)
+        return 0.0;
+
+    double frac = PL_MAX(PL_MIN(percentile / 100.0, 1.0), 0.0);
+    double target = frac * hist->total;
+    double log_min = log2(hist->min_level);
+    double log_range = log2(hist->max_level) - log_min;
+    uint64_t sum = 0;
+
+    for (int i = 0; i < hist->num_bins; i++) {
+        uint32_t count = hist->bins[i];
+        if (count && sum + count >= target) {
+            double pos = (i + (target - sum) / count) / hist->num_bins;
+            return exp2(log_min + pos * log_range);
+        }
+        sum += count;
+    }
+
+    return hist->max_level;
+}
+
 const struct pl_color_map_params pl_color_map_default_params = {
     .intent                 = PL_INTENT_RELATIVE_COLORIMETRIC,
     .tone_mapping_algo      = PL_TONE_MAPPING_HABLE,
@@ -685,6 +908,77 @@ const struct pl_color_map_params pl_color_map_default_params = {
     .desaturation_base      = 0.18,
 };
 
+struct sh_tone_map_obj {
+    struct pl_shader_obj *lut;
+
+    // Configuration of the curve the LUT was generated for
+    enum pl_tone_mapping_algorithm algo;
+    float param;
+    float peak;
+    float slope;
+};
+
+static void sh_tone_map_uninit(const struct pl_gpu *gpu, void *ptr)
+{
+    struct sh_tone_map_obj *obj = ptr;
+    pl_shader_obj_destroy(&obj->lut);
+    *obj = (struct sh_tone_map_obj) {0};
+}
+
+static void fill_tone_map_lut(void *priv, float *data, int w, int h, int d)
+{
+    const struct sh_tone_map_obj *obj = priv;
+    for (int i = 0; i < w; i++) {
+        // The LUT is indexed by sqrt(sig / peak), to spend more of the
+        // entries on the dark end of the curve
+        float pos = (float) i / (w - 1);
+        float x = pos * pos * obj->peak;
+        float y = pl_tone_map_curve(obj->algo, obj->param, obj->slope * x,
+                                    obj->slope * obj->peak);
+        data[i] = PL_MIN(y, 1.01);
+    }
+}
+
+// Returns the LUT for the current tone mapping curve, or NULL if unavailable.
+// `peak` is the (normalized) signal peak before scaling by `slope`
+static ident_t tone_map_lut(struct pl_shader *sh, float peak, float slope,
+                            const struct pl_color_map_params *params)
+{
+    if (!SH_GPU(sh))
+        return NULL;
+
+    struct sh_tone_map_obj *obj;
+    obj = SH_OBJ(sh, params->tone_mapping_lut, PL_SHADER_OBJ_TONE_MAP,
+                 struct sh_tone_map_obj, sh_tone_map_uninit);
+    if (!obj)
+        return NULL;
+
+    // Ignore tiny changes in the peak (e.g. from rounding of the metadata),
+    // which don't warrant regenerating the LUT
+    bool update = obj->algo != params->tone_mapping_algo ||
+                  obj->param != params->tone_mapping_param ||
+                  fabs(obj->peak - peak) > 1e-3 * peak ||
+                  fabs(obj->slope - slope) > 1e-3 * slope;
+
+    if (update) {
+        obj->algo = params->tone_mapping_algo;
+        obj->param = params->tone_mapping_param;
+        obj->peak = peak;
+        obj->slope = slope;
+    }
+
+    return sh_lut(sh, &(struct sh_lut_params) {
+        .object = &obj->lut,
+        .method = SH_LUT_LINEAR,
+        .precision = SH_LUT_HALF,
+        .width = PL_MAX(params->tone_mapping_lut_size, 2),
+        .comps = 1,
+        .update = update,
+        .priv = obj,
+        .fill = fill_tone_map_lut,
+    });
+}
+
 static void pl_shader_tone_map(struct pl_shader *sh, struct pl_color_space src,
                                struct pl_color_space dst,
                                struct pl_shader_obj **peak_detect_state,
@@ -705,6 +999,7 @@ static void pl_shader_tone_map(struct pl_shader *sh, struct pl_color_space src,
          src.sig_avg * src.sig_scale);
 
     // Update the variables based on values from the peak detection buffer
+    bool dynamic_peak = false;
     if (peak_detect_state) {
         struct sh_peak_obj *obj;
         obj = SH_OBJ(sh, peak_detect_state, PL_SHADER_OBJ_PEAK_DETECT,
@@ -714,6 +1009,7 @@ static void pl_shader_tone_map(struct pl_shader *sh, struct pl_color_space src,
             sh_desc(sh, obj->desc);
             GLSL("sig_avg  = average.x; \n"
                  "sig_peak = average.y; \n");
+            dynamic_peak = true;
         }
     }
 
@@ -731,6 +1027,25 @@ static void pl_shader_tone_map(struct pl_shader *sh, struct pl_color_space src,
     GLSL("vec3 sig = color.rgb; \n"
          "vec3 sig_orig = sig;  \n");
 
+    // If the curve is known ahead of time, just sample it from a LUT
+    if (params->tone_mapping_lut_size && params->tone_mapping_lut && !dynamic_peak) {
+        float peak = src.sig_peak * src.sig_scale;
+        if (dst_range > 1.0)
+            peak /= dst_range;
+        float slope = PL_MIN(PL_DEF(params->max_boost, 1.0),
+                             dst.sig_avg * dst.sig_scale /
+                             (src.sig_avg * src.sig_scale));
+
+        ident_t lut = tone_map_lut(sh, peak, slope, params);
+        if (lut) {
+            GLSL("vec3 lut_pos = sqrt(sig * vec3(1.0 / %f));    \n"
+                 "sig = vec3(%s(lut_pos.r), %s(lut_pos.g),      \n"
+                 "           %s(lut_pos.b));                    \n",
+                 peak, lut, lut, lut);
+            goto curve_done;
+        }
+    }
+
     // Scale the signal to compensate for differences in the average brightness
     GLSL("float slope = min(%f, %f / sig_avg); \n"
          "sig *= slope;                        \n"
@@ -803,6 +1118,7 @@ static void pl_shader_tone_map(struct pl_shader *sh, struct pl_color_space src,
         abort();
     }
 
+curve_done:
     GLSL("sig = min(sig, 1.01);                                         \n"
          "vec3 sig_lin = sig_orig * (sig[sig_idx] / sig_orig[sig_idx]); \n");
 
@@ -834,44 +1150,12 @@ void pl_shader_color_map(struct pl_shader *sh,
     if (!sh_require(sh, PL_SHADER_SIG_COLOR, 0, 0))
         return;
 
+    sh_describe(sh, "color mapping");
     GLSL("// pl_shader_color_map\n");
     GLSL("{\n");
     params = PL_DEF(params, &pl_color_map_default_params);
 
-    // Default the source color space to reasonable values
-    pl_color_space_infer(&src);
-
-    // To be as conservative as possible, color mapping is disabled by default
-    // except for special cases which are considered to be "sufficiently
-    // different" from the source space. For primaries, this means anything
-    // wide gamut; and for transfers, this means anything radically different
-    // from the typical SDR curves.
-    if (!dst.primaries) {
-        dst.primaries = src.primaries;
-        if (pl_color_primaries_is_wide_gamut(dst.primaries))
-            dst.primaries = PL_COLOR_PRIM_BT_709;
-    }
-
-    if (!dst.transfer) {
-        dst.transfer = src.transfer;
-        if (pl_color_transfer_is_hdr(dst.transfer) ||
-            dst.transfer == PL_COLOR_TRC_LINEAR)
-        {
-            dst.transfer = PL_COLOR_TRC_GAMMA22;
-        }
-    }
-
-    // Defaults the dest average based on the source average, unless the source
-    // is HDR and the destination is not
-    if (!dst.sig_avg) {
-        bool src_hdr = pl_color_space_is_hdr(src);
-        bool dst_hdr = pl_color_space_is_hdr(dst);
-        if (!(src_hdr && !dst_hdr))
-            dst.sig_avg = src.sig_avg;
-    }
-
-    // Infer the remaining fields after making the above choices
-    pl_color_space_infer(&dst);
+    pl_color_map_infer(&src, &dst);
 
     // All operations from here on require linear light as a starting point,
     // so we linearize even if src.transfer == dst.transfer when one of the other
@@ -935,6 +1219,7 @@ void pl_shader_cone_distort(struct pl_shader *sh, struct pl_color_space csp,
     if (!sh_require(sh, PL_SHADER_SIG_COLOR, 0, 0))
         return;
 
+    sh_describe(sh, "cone distortion");
     GLSL("// pl_shader_cone_distort\n");
     GLSL("{\n");
 
@@ -964,9 +1249,31 @@ static void sh_dither_uninit(const struct pl_gpu *gpu, void *ptr)
     *obj = (struct sh_dither_obj) {0};
 }
 
+// Turns the single blue noise matrix in the first layer of `data` into `d`
+// frames, each one toroidally shifted along the R2 sequence (to decorrelate
+// them spatially) and offset in value along the golden ratio sequence (so
+// the values seen by each pixel over time are evenly distributed)
+static void fill_temporal_frames(float *data, int w, int h, int d)
+{
+    const double phi = 0.61803398874989484820; // golden ratio - 1
+    const double r2x = 0.75487766624669276005, r2y = 0.56984029099805326591;
+    const float *base = data;
+
+    for (int z = d - 1; z > 0; z--) {
+        float *frame = data + z * w * h;
+        int ox = (int) (z * r2x * w) % w, oy = (int) (z * r2y * h) % h;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                float v = base[((y + oy) % h) * w + (x + ox) % w] + z * phi;
+                frame[y * w + x] = v - floorf(v);
+            }
+        }
+    }
+}
+
 static void fill_dither_matrix(void *priv, float *data, int w, int h, int d)
 {
-    pl_assert(w > 0 && h > 0 && d == 0);
+    pl_assert(w > 0 && h > 0 && d >= 0);
 
     const struct sh_dither_obj *obj = priv;
     switch (obj->method) {
@@ -977,6 +1284,8 @@ static void fill_dither_matrix(void *priv, float *data, int w, int h, int d)
 
     case PL_DITHER_BLUE_NOISE:
         pl_generate_blue_noise(data, w);
+        if (d > 1)
+            fill_temporal_frames(data, w, h, d);
         break;
 
     default: abort();
@@ -1008,6 +1317,7 @@ void pl_shader_dither(struct pl_shader *sh, int new_depth,
         return;
     }
 
+    sh_describe(sh, "dithering");
     GLSL("// pl_shader_dither \n"
         "{                    \n"
         "float bias;          \n");
@@ -1018,10 +1328,16 @@ void pl_shader_dither(struct pl_shader *sh, int new_depth,
         return;
     }
 
+    if (params->temporal_frames < 0 || params->temporal_frames > 64) {
+        SH_FAIL(sh, "Invalid `temporal_frames` specified: %d",
+                params->temporal_frames);
+        return;
+    }
+
     enum pl_dither_method method = params->method;
     bool can_fixed = sh_glsl(sh).version >= 130;
     ident_t lut = NULL;
-    int lut_size = 0;
+    int lut_size = 0, lut_frames = 0;
 
     if (method == PL_DITHER_ORDERED_FIXED && !can_fixed) {
         PL_WARN(sh, "PL_DITHER_ORDERED_FIXED requires glsl version >= 130.."
@@ -1046,8 +1362,19 @@ void pl_shader_dither(struct pl_shader *sh, int new_depth,
         obj->method = method;
 
         lut_size = 1 << PL_DEF(params->lut_size, 6);
-        lut = sh_lut(sh, &obj->lut, SH_LUT_AUTO, lut_size, lut_size, 0, 1,
-                     changed, obj, fill_dither_matrix);
+        if (params->temporal && method == PL_DITHER_BLUE_NOISE)
+            lut_frames = params->temporal_frames;
+        lut = sh_lut(sh, &(struct sh_lut_params) {
+            .object = &obj->lut,
+            .precision = SH_LUT_UNORM16,
+            .width = lut_size,
+            .height = lut_size,
+            .depth = lut_frames,
+            .comps = 1,
+            .update = changed,
+            .priv = obj,
+            .fill = fill_dither_matrix,
+        });
         if (!lut)
             goto fallback;
     }
@@ -1071,7 +1398,7 @@ done: ;
         // Transform the screen position to the cyclic range [0,1)
         GLSL("vec2 pos = fract(gl_FragCoord.xy * 1.0/%d.0);\n", size);
 
-        if (params->temporal) {
+        if (params->temporal && !lut_frames) {
             int phase = SH_PARAMS(sh).index % 8;
             float r = phase * (M_PI / 2); // rotate
             float m = phase < 4 ? 1 : -1; // mirror
@@ -1115,7 +1442,16 @@ done: ;
 
     default: // LUT-based methods
         pl_assert(lut);
-        GLSL("bias = %s(ivec2(pos * %d));\n", lut, lut_size);
+        if (lut_frames) {
+            ident_t frame = sh_var(sh, (struct pl_shader_var) {
+                .var  = pl_var_int("dither_frame"),
+                .data = &(int) { SH_PARAMS(sh).index % lut_frames },
+                .dynamic = true,
+            });
+            GLSL("bias = %s(ivec3(ivec2(pos * %d), %s));\n", lut, lut_size, frame);
+        } else {
+            GLSL("bias = %s(ivec2(pos * %d));\n", lut, lut_size);
+        }
         break;
     }
 
@@ -1134,22 +1470,123 @@ const struct pl_dither_params pl_dither_default_params = {
 
 #if PL_HAVE_LCMS
 
+#include <pthread.h>
+
 #include "lcms.h"
 
+// A 3DLUT being computed in the background, for `pl_3dlut_params.async`. All
+// inputs are owned by the job, since they may outlive the caller's copies
+struct lut3d_job {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    bool done; // protected by `lock`
+
+    struct pl_context *ctx;
+    enum pl_rendering_intent intent;
+    struct pl_3dlut_profile src, dst;
+    int s_r, s_g, s_b;
+    int threads;
+    char *cache_dir;
+
+    // Only valid once `done` is set
+    float *data;
+    struct pl_3dlut_result result;
+    bool ok;
+};
+
 struct sh_3dlut_obj {
     struct pl_context *ctx;
     enum pl_rendering_intent intent;
     struct pl_3dlut_profile src, dst;
+    size_t s_r, s_g, s_b;
+    int threads;
+    const char *cache_dir;
+    bool tetrahedral;
     struct pl_3dlut_result result;
     struct pl_shader_obj *lut_obj;
+    struct lut3d_job *job; // in-flight background computation, if any
+    const float *data;     // precomputed LUT contents for `fill_3dlut`
     bool updated; // to detect misuse of the API
     bool ok;
     ident_t lut;
 };
 
+static void *lut3d_job_run(void *arg)
+{
+    struct lut3d_job *job = arg;
+    struct pl_context *ctx = job->ctx;
+    job->ok = pl_lcms_compute_lut(ctx, job->intent, job->src, job->dst,
+                                  job->data, job->s_r, job->s_g, job->s_b,
+                                  job->threads, job->cache_dir, &job->result);
+    if (!job->ok)
+        pl_err(ctx, "Failed computing 3DLUT!");
+
+    pthread_mutex_lock(&job->lock);
+    job->done = true;
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+static bool lut3d_job_done(struct lut3d_job *job)
+{
+    pthread_mutex_lock(&job->lock);
+    bool done = job->done;
+    pthread_mutex_unlock(&job->lock);
+    return done;
+}
+
+static void lut3d_job_free(struct lut3d_job **job)
+{
+    if (!*job)
+        return;
+
+    // Blocks if the job is still running
+    pthread_join((*job)->thread, NULL);
+    pthread_mutex_destroy(&(*job)->lock);
+    TA_FREEP(job);
+}
+
+static struct pl_3dlut_profile copy_profile(void *tactx,
+                                            const struct pl_3dlut_profile *prof)
+{
+    struct pl_3dlut_profile ret = *prof;
+    if (ret.profile.data)
+        ret.profile.data = talloc_memdup(tactx, ret.profile.data, ret.profile.len);
+    return ret;
+}
+
+static struct lut3d_job *lut3d_job_start(struct sh_3dlut_obj *obj)
+{
+    struct pl_context *ctx = obj->ctx;
+    struct lut3d_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct lut3d_job) {
+        .ctx = ctx,
+        .intent = obj->intent,
+        .src = copy_profile(job, &obj->src),
+        .dst = copy_profile(job, &obj->dst),
+        .s_r = obj->s_r,
+        .s_g = obj->s_g,
+        .s_b = obj->s_b,
+        .threads = obj->threads,
+        .cache_dir = obj->cache_dir ? talloc_strdup(job, obj->cache_dir) : NULL,
+    };
+
+    job->data = talloc_array(job, float, job->s_r * job->s_g * job->s_b * 4);
+    pthread_mutex_init(&job->lock, NULL);
+    if (pthread_create(&job->thread, NULL, lut3d_job_run, job)) {
+        pl_err(ctx, "Failed spawning 3DLUT computation thread!");
+        pthread_mutex_destroy(&job->lock);
+        talloc_free(job);
+        return NULL;
+    }
+
+    return job;
+}
+
 static void sh_3dlut_uninit(const struct pl_gpu *gpu, void *ptr)
 {
     struct sh_3dlut_obj *obj = ptr;
+    lut3d_job_free(&obj->job);
     pl_shader_obj_destroy(&obj->lut_obj);
     *obj = (struct sh_3dlut_obj) {0};
 }
@@ -1159,8 +1596,15 @@ static void fill_3dlut(void *priv, float *data, int s_r, int s_g, int s_b)
     struct sh_3dlut_obj *obj = priv;
     struct pl_context *ctx = obj->ctx;
 
+    if (obj->data) {
+        memcpy(data, obj->data, s_r * s_g * s_b * 4 * sizeof(float));
+        obj->ok = true;
+        return;
+    }
+
     obj->ok = pl_lcms_compute_lut(ctx, obj->intent, obj->src, obj->dst,
-                                  data, s_r, s_g, s_b, &obj->result);
+                                  data, s_r, s_g, s_b, obj->threads,
+                                  obj->cache_dir, &obj->result);
 
     if (!obj->ok)
         pl_err(ctx, "Failed computing 3DLUT!");
@@ -1173,6 +1617,15 @@ static bool color_profile_eq(const struct pl_3dlut_profile *a,
            pl_color_space_equal(&a->color, &b->color);
 }
 
+static bool lut3d_job_matches(const struct lut3d_job *job,
+                              const struct sh_3dlut_obj *obj)
+{
+    return color_profile_eq(&job->src, &obj->src) &&
+           color_profile_eq(&job->dst, &obj->dst) &&
+           job->intent == obj->intent &&
+           job->s_r == obj->s_r && job->s_g == obj->s_g && job->s_b == obj->s_b;
+}
+
 bool pl_3dlut_update(struct pl_shader *sh,
                      const struct pl_3dlut_profile *src,
                      const struct pl_3dlut_profile *dst,
@@ -1180,9 +1633,10 @@ bool pl_3dlut_update(struct pl_shader *sh,
                      const struct pl_3dlut_params *params)
 {
     params = PL_DEF(params, &pl_3dlut_default_params);
-    size_t s_r = PL_DEF(params->size_r, 64),
-           s_g = PL_DEF(params->size_g, 64),
-           s_b = PL_DEF(params->size_b, 64);
+    const size_t def_size = params->tetrahedral ? 33 : 64;
+    size_t s_r = PL_DEF(params->size_r, def_size),
+           s_g = PL_DEF(params->size_g, def_size),
+           s_b = PL_DEF(params->size_b, def_size);
 
     struct sh_3dlut_obj *obj;
     obj = SH_OBJ(sh, lut3d, PL_SHADER_OBJ_3DLUT,
@@ -1192,15 +1646,70 @@ bool pl_3dlut_update(struct pl_shader *sh,
 
     bool changed = !color_profile_eq(&obj->src, src) ||
                    !color_profile_eq(&obj->dst, dst) ||
-                   obj->intent != params->intent;
+                   obj->intent != params->intent ||
+                   obj->s_r != s_r || obj->s_g != s_g || obj->s_b != s_b;
 
     // Update the object, since we need this information from `fill_3dlut`
     obj->ctx = sh->ctx;
     obj->intent = params->intent;
     obj->src = *src;
     obj->dst = *dst;
-    obj->lut = sh_lut(sh, &obj->lut_obj, SH_LUT_LINEAR, s_r, s_g, s_b, 4,
-                      changed, obj, fill_3dlut);
+    obj->s_r = s_r;
+    obj->s_g = s_g;
+    obj->s_b = s_b;
+    obj->threads = params->threads;
+    obj->cache_dir = params->cache_dir;
+    obj->tetrahedral = params->tetrahedral;
+    out->pending = false;
+
+    struct lut3d_job *job = NULL;
+    if (params->async && (changed || obj->job)) {
+        // Only one job is ever in flight. If the desired LUT changed in the
+        // meantime, its result is discarded once done and a new job started
+        if (obj->job && !lut3d_job_done(obj->job)) {
+            out->pending = true;
+            return false;
+        }
+
+        if (obj->job && lut3d_job_matches(obj->job, obj)) {
+            job = obj->job;
+            obj->job = NULL;
+            if (!job->ok) {
+                lut3d_job_free(&job);
+                obj->ok = false;
+                return false;
+            }
+
+            // Upload the finished result below
+            obj->data = job->data;
+            obj->result = job->result;
+            changed = true;
+        } else {
+            lut3d_job_free(&obj->job);
+            obj->job = lut3d_job_start(obj);
+            if (!obj->job)
+                return false;
+
+            out->pending = true;
+            return false;
+        }
+    }
+
+    obj->lut = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &obj->lut_obj,
+        .method = SH_LUT_LINEAR,
+        .precision = SH_LUT_UNORM16,
+        .width = s_r,
+        .height = s_g,
+        .depth = s_b,
+        .comps = 4,
+        .update = changed,
+        .priv = obj,
+        .fill = fill_3dlut,
+    });
+
+    obj->data = NULL;
+    lut3d_job_free(&job);
     if (!obj->lut || !obj->ok)
         return false;
 
@@ -1222,9 +1731,40 @@ void pl_3dlut_apply(struct pl_shader *sh, struct pl_shader_obj **lut3d)
         return;
     }
 
+    sh_describe(sh, "3DLUT");
     GLSL("// pl_shader_3dlut\n");
-    GLSL("color.rgba = %s(color.rgb);\n", obj->lut);
+    if (!obj->tetrahedral) {
+        GLSL("color.rgba = %s(color.rgb);\n", obj->lut);
+        goto done;
+    }
 
+    // Split the lattice cell containing the color into six tetrahedra, and
+    // interpolate between the four vertices of the one it falls into. The
+    // vertices are sampled at exact texel centers, so the hardware filtering
+    // does not contribute anything. `o1` and `o2` are the offsets of the two
+    // inner vertices, which are given by the ordering of the fractional part
+    GLSL("{\n"
+         "vec3 size = vec3(%d.0, %d.0, %d.0);\n"
+         "vec3 pos = clamp(color.rgb, 0.0, 1.0) * size;\n"
+         "vec3 base = min(floor(pos), size - vec3(1.0));\n"
+         "vec3 f = pos - base;\n"
+         "vec3 a = step(f.yzx, f);\n"
+         "vec3 b = vec3(1.0) - a.zxy;\n"
+         "vec3 o1 = min(a, b);\n"
+         "vec3 o2 = max(a, b);\n"
+         "float fmax = max(f.x, max(f.y, f.z));\n"
+         "float fmin = min(f.x, min(f.y, f.z));\n"
+         "float fmid = f.x + f.y + f.z - fmax - fmin;\n"
+         "vec3 scale = vec3(1.0) / size;\n"
+         "color.rgba = (1.0 - fmax) * %s(base * scale)\n"
+         "           + (fmax - fmid) * %s((base + o1) * scale)\n"
+         "           + (fmid - fmin) * %s((base + o2) * scale)\n"
+         "           + fmin * %s((base + vec3(1.0)) * scale);\n"
+         "}\n",
+         (int) obj->s_r - 1, (int) obj->s_g - 1, (int) obj->s_b - 1,
+         obj->lut, obj->lut, obj->lut, obj->lut);
+
+done:
     obj->updated = false;
 }
 
@@ -25,17 +25,43 @@ const struct pl_deband_params pl_deband_default_params = {
     .grain      = 6.0,
 };
 
-// Helper function to compute the src/dst sizes and upscaling ratios
+// Returns the part of `src->tex` which may be sampled from
+static struct pl_rect2d src_bounds(const struct pl_sample_src *src)
+{
+    struct pl_rect2d rc = src->valid_rect;
+    if (!pl_rect_w(rc) || !pl_rect_h(rc))
+        return (struct pl_rect2d) { 0, 0, src->tex->params.w, src->tex->params.h };
+
+    pl_rect2d_normalize(&rc);
+    return rc;
+}
+
+// Whether texture lookups need to be clamped to `src_bounds`, because it
+// doesn't cover the entire texture
+static bool src_clamped(const struct pl_sample_src *src)
+{
+    struct pl_rect2d rc = src_bounds(src);
+    return rc.x0 > 0 || rc.y0 > 0 ||
+           rc.x1 < src->tex->params.w || rc.y1 < src->tex->params.h;
+}
+
+// Helper function to compute the src/dst sizes and upscaling ratios. The
+// returned `fn` clamps all lookups to the valid region of the texture, which
+// gives the same results as PL_TEX_ADDRESS_CLAMP at its edges (for both
+// nearest and linear sampling).
 static bool setup_src(struct pl_shader *sh, const struct pl_sample_src *src,
                       ident_t *src_tex, ident_t *pos, ident_t *size, ident_t *pt,
                       float *ratio_x, float *ratio_y, int *components,
                       float *scale, bool resizeable, const char **fn)
 {
     pl_assert(pl_tex_params_dimension(src->tex->params) == 2);
+    struct pl_rect2d bounds = src_bounds(src);
     float src_w = pl_rect_w(src->rect);
     float src_h = pl_rect_h(src->rect);
-    src_w = PL_DEF(src_w, src->tex->params.w);
-    src_h = PL_DEF(src_h, src->tex->params.h);
+    float src_x = src_w ? src->rect.x0 : bounds.x0;
+    float src_y = src_h ? src->rect.y0 : bounds.y0;
+    src_w = PL_DEF(src_w, pl_rect_w(bounds));
+    src_h = PL_DEF(src_h, pl_rect_h(bounds));
 
     int out_w = PL_DEF(src->new_w, fabs(src_w));
     int out_h = PL_DEF(src->new_h, fabs(src_h));
@@ -58,77 +84,84 @@ static bool setup_src(struct pl_shader *sh, const struct pl_sample_src *src,
         return false;
 
     struct pl_rect2df rect = {
-        .x0 = src->rect.x0,
-        .y0 = src->rect.y0,
-        .x1 = src->rect.x0 + src_w,
-        .y1 = src->rect.y0 + src_h,
+        .x0 = src_x,
+        .y0 = src_y,
+        .x1 = src_x + src_w,
+        .y1 = src_y + src_h,
     };
 
     if (fn)
         *fn = sh_tex_fn(sh, src->tex);
 
+    if (fn && src_clamped(src)) {
+        float tw = src->tex->params.w, th = src->tex->params.h;
+        ident_t lim = sh_var(sh, (struct pl_shader_var) {
+            .var  = pl_var_vec4("tex_limits"),
+            .data = &(float[4]) {
+                (bounds.x0 + 0.5) / tw, (bounds.y0 + 0.5) / th,
+                (bounds.x1 - 0.5) / tw, (bounds.y1 - 0.5) / th,
+            },
+        });
+
+        ident_t clamped = sh_fresh(sh, "tex_clamped");
+        GLSLH("#define %s(t, p) (%s(t, clamp(p, %s.xy, %s.zw)))\n",
+              clamped, *fn, lim, lim);
+        *fn = clamped;
+    }
+
     *src_tex = sh_bind(sh, src->tex, "src_tex", &rect, pos, size, pt);
     return true;
 }
 
-void pl_shader_deband(struct pl_shader *sh, const struct pl_sample_src *src,
-                      const struct pl_deband_params *params)
+// Emits the main debanding loop, operating on `vec4 color` at `vec2 pos`.
+// `sample` is a function (or macro) returning the source color at a given
+// position, and positions are offset by `pt` per texel
+static void deband_core(struct pl_shader *sh,
+                        const struct pl_deband_params *params,
+                        ident_t sample, const char *pt, float scale)
 {
-    if (src->tex->params.sample_mode != PL_TEX_SAMPLE_LINEAR) {
-        SH_FAIL(sh, "Debanding requires sample_mode = PL_TEX_SAMPLE_LINEAR!");
-        return;
-    }
-
-    float scale;
-    ident_t tex, pos, pt;
-    const char *fn;
-    if (!setup_src(sh, src, &tex, &pos, NULL, &pt, NULL, NULL, NULL, &scale, true, &fn))
-        return;
-
-    GLSL("vec4 color;\n");
-    GLSL("// pl_shader_deband\n");
-    GLSL("{\n");
-    params = PL_DEF(params, &pl_deband_default_params);
-
     ident_t prng, state;
     prng = sh_prng(sh, true, &state);
 
-    GLSL("vec2 pos = %s;       \n"
-         "vec4 avg, diff;      \n"
-         "color = %s(%s, pos); \n",
-         pos, fn, tex);
+    // The PRNG itself needs full precision, but the averaging and
+    // thresholding is fine with 16-bit floats
+    const char *vec4 = "vec4";
+    if (params->iterations > 0 && sh_float16(sh))
+        vec4 = "f16vec4";
 
     // Helper function: Compute a stochastic approximation of the avg color
     // around a pixel, given a specified radius
     ident_t average = sh_fresh(sh, "average");
-    GLSLH("vec4 %s(vec2 pos, float range, inout float %s) {     \n"
+    GLSLH("%s %s(vec2 pos, float range, inout float %s) {       \n"
           // Compute a random angle and distance
           "    float dist = %s * range;                         \n"
           "    float dir  = %s * %f;                            \n"
           "    vec2 o = dist * vec2(cos(dir), sin(dir));        \n"
           // Sample at quarter-turn intervals around the source pixel
-          "    vec4 sum = vec4(0.0);                            \n"
-          "    sum += %s(%s, pos + %s * vec2( o.x,  o.y)); \n"
-          "    sum += %s(%s, pos + %s * vec2(-o.x,  o.y)); \n"
-          "    sum += %s(%s, pos + %s * vec2(-o.x, -o.y)); \n"
-          "    sum += %s(%s, pos + %s * vec2( o.x, -o.y)); \n"
+          "    %s sum = %s(0.0);                                \n"
+          "    sum += %s(%s(pos + %s * vec2( o.x,  o.y)));      \n"
+          "    sum += %s(%s(pos + %s * vec2(-o.x,  o.y)));      \n"
+          "    sum += %s(%s(pos + %s * vec2(-o.x, -o.y)));      \n"
+          "    sum += %s(%s(pos + %s * vec2( o.x, -o.y)));      \n"
           // Return the (normalized) average
-          "    return 0.25 * sum;                               \n"
+          "    return %s(0.25) * sum;                           \n"
           "}\n",
-          average, state, prng, prng, M_PI * 2,
-          fn, tex, pt, fn, tex, pt, fn, tex, pt, fn, tex, pt);
+          vec4, average, state, prng, prng, M_PI * 2, vec4, vec4,
+          vec4, sample, pt, vec4, sample, pt, vec4, sample, pt,
+          vec4, sample, pt, vec4);
 
     // For each iteration, compute the average at a given distance and
     // pick it instead of the color if the difference is below the threshold.
+    GLSL("%s avg, diff, cur = %s(color); \n", vec4, vec4);
     for (int i = 1; i <= params->iterations; i++) {
-        GLSL("avg = %s(pos, %f, %s);                                    \n"
-             "diff = abs(color - avg);                                  \n"
-             "color = mix(avg, color, %s(greaterThan(diff, vec4(%f)))); \n",
+        GLSL("avg = %s(pos, %f, %s);                                \n"
+             "diff = abs(cur - avg);                                \n"
+             "cur = mix(avg, cur, %s(greaterThan(diff, %s(%f))));   \n",
              average, i * params->radius, state,
-             sh_bvec(sh, 4), params->threshold / (1000 * i * scale));
+             sh_bvec(sh, 4), vec4, params->threshold / (1000 * i * scale));
     }
 
-    GLSL("color *= vec4(%f);\n", scale);
+    GLSL("color = vec4(%f) * vec4(cur);\n", scale);
 
     // Add some random noise to smooth out residual differences
     if (params->grain > 0) {
@@ -136,10 +169,147 @@ void pl_shader_deband(struct pl_shader *sh, const struct pl_sample_src *src,
              "color.rgb += %f * (noise - vec3(0.5)); \n",
              prng, prng, prng, params->grain / 1000.0);
     }
+}
+
+void pl_shader_deband(struct pl_shader *sh, const struct pl_sample_src *src,
+                      const struct pl_deband_params *params)
+{
+    if (src->tex->params.sample_mode != PL_TEX_SAMPLE_LINEAR) {
+        SH_FAIL(sh, "Debanding requires sample_mode = PL_TEX_SAMPLE_LINEAR!");
+        return;
+    }
+
+    float scale;
+    ident_t tex, pos, pt;
+    const char *fn;
+    if (!setup_src(sh, src, &tex, &pos, NULL, &pt, NULL, NULL, NULL, &scale, true, &fn))
+        return;
+
+    GLSL("vec4 color;\n");
+    sh_describe(sh, "debanding");
+    GLSL("// pl_shader_deband\n");
+    GLSL("{\n");
+    params = PL_DEF(params, &pl_deband_default_params);
+
+    ident_t sample = sh_fresh(sh, "sample");
+    GLSLH("#define %s(pos) (%s(%s, pos))\n", sample, fn, tex);
+
+    GLSL("vec2 pos = %s;       \n"
+         "color = %s(%s, pos); \n",
+         pos, fn, tex);
 
+    deband_core(sh, params, sample, pt, scale);
     GLSL("}\n");
 }
 
+bool pl_shader_deband_compute(struct pl_shader *sh,
+                              const struct pl_sample_src *src,
+                              const struct pl_deband_params *params)
+{
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    const struct pl_tex *tex = src->tex;
+    pl_assert(gpu && tex);
+
+    if (!(gpu->caps & PL_GPU_CAP_COMPUTE))
+        return false;
+    if (tex->params.sample_mode != PL_TEX_SAMPLE_LINEAR)
+        return false;
+
+    // Only support exact, texel-aligned crops without any scaling
+    struct pl_rect2d bounds = src_bounds(src);
+    float src_w = PL_DEF(pl_rect_w(src->rect), pl_rect_w(bounds)),
+          src_h = PL_DEF(pl_rect_h(src->rect), pl_rect_h(bounds));
+    if (src_w < 0 || src_h < 0)
+        return false;
+    if (PL_DEF(src->new_w, src_w) != src_w || PL_DEF(src->new_h, src_h) != src_h)
+        return false;
+    if (src->rect.x0 != floorf(src->rect.x0) || src->rect.y0 != floorf(src->rect.y0))
+        return false;
+
+    params = PL_DEF(params, &pl_deband_default_params);
+    int comps = PL_DEF(src->components, tex->params.format->num_components);
+
+    // Each work group loads its block plus a margin of the maximum radius
+    // (and one extra texel for the bilinear interpolation) into shmem, so
+    // that all of the random samples can be served from there
+    const int bw = 32, bh = 8;
+    int margin = (int) ceilf(params->iterations * params->radius) + 1;
+    int iw = bw + 2 * margin, ih = bh + 2 * margin;
+    size_t shmem_req = iw * ih * comps * sizeof(float);
+    if (!sh_try_compute(sh, bw, bh, false, shmem_req)) {
+        PL_TRACE(sh, "Deband radius too large for compute shader");
+        return false;
+    }
+
+    float scale;
+    ident_t src_tex, pos, size, pt;
+    const char *fn;
+    if (!setup_src(sh, src, &src_tex, &pos, &size, &pt, NULL, NULL, NULL,
+                   &scale, false, &fn))
+    {
+        return false;
+    }
+
+    sh_describe(sh, "debanding");
+    GLSL("// pl_shader_deband_compute                                     \n"
+         "vec4 color;                                                     \n"
+         "{                                                               \n"
+         "vec2 size = %s, pt = %s;                                        \n"
+         "vec2 wpos = %s_map(gl_WorkGroupID * gl_WorkGroupSize);          \n"
+         "ivec2 wbase = ivec2(floor(wpos * size - vec2(0.5))) - ivec2(%d); \n"
+         "vec4 c;                                                         \n",
+         size, pt, pos, margin);
+
+    // Load all relevant texels into shmem
+    ident_t in = sh_fresh(sh, "in");
+    for (int c = 0; c < comps; c++)
+        GLSLH("shared float %s%d[%d];\n", in, c, ih * iw);
+
+    GLSL("for (int y = int(gl_LocalInvocationID.y); y < %d; y += %d) {   \n"
+         "for (int x = int(gl_LocalInvocationID.x); x < %d; x += %d) {   \n"
+         "c = %s(%s, (vec2(wbase + ivec2(x, y)) + vec2(0.5)) * pt);      \n",
+         ih, bh, iw, bw, fn, src_tex);
+    for (int c = 0; c < comps; c++)
+        GLSL("%s%d[%d * y + x] = c[%d];\n", in, c, iw, c);
+    GLSL("}}                    \n"
+         "groupMemoryBarrier(); \n"
+         "barrier();            \n");
+
+    // Helper functions to sample from the tile, with bilinear interpolation
+    ident_t fetch = sh_fresh(sh, "fetch"), sample = sh_fresh(sh, "sample");
+    GLSLH("vec4 %s(ivec2 p) {       \n"
+          "    int i = %d * p.y + p.x;  \n"
+          "    return vec4(",
+          fetch, iw);
+    for (int c = 0; c < 4; c++) {
+        if (c < comps) {
+            GLSLH("%s%s%d[i]", c ? ", " : "", in, c);
+        } else {
+            GLSLH("%s0.0", c ? ", " : "");
+        }
+    }
+    GLSLH(");\n"
+          "}\n"
+          "vec4 %s(vec2 p) {                                        \n"
+          "    p -= vec2(0.5);                                      \n"
+          "    ivec2 i = ivec2(floor(p));                           \n"
+          "    vec2 f = fract(p);                                   \n"
+          "    return mix(mix(%s(i), %s(i + ivec2(1, 0)), f.x),     \n"
+          "               mix(%s(i + ivec2(0, 1)), %s(i + ivec2(1, 1)), f.x), \n"
+          "               f.y);                                     \n"
+          "}\n",
+          sample, fetch, fetch, fetch, fetch);
+
+    // Positions are relative to the tile, in texels
+    GLSL("vec2 pos = %s * size - vec2(wbase); \n"
+         "color = %s(%s, %s);                 \n",
+         pos, fn, src_tex, pos);
+
+    deband_core(sh, params, sample, "1.0", scale);
+    GLSL("}\n");
+    return true;
+}
+
 bool pl_shader_sample_direct(struct pl_shader *sh, const struct pl_sample_src *src)
 {
     float scale;
@@ -148,12 +318,32 @@ bool pl_shader_sample_direct(struct pl_shader *sh, const struct pl_sample_src *s
     if (!setup_src(sh, src, &tex, &pos, NULL, NULL, NULL, NULL, NULL, &scale, true, &fn))
         return false;
 
+    sh_describe(sh, "direct sampling");
     GLSL("// pl_shader_sample_direct          \n"
          "vec4 color = vec4(%f) * %s(%s, %s); \n",
          scale, fn, tex, pos);
     return true;
 }
 
+bool pl_shader_sample_nearest(struct pl_shader *sh, const struct pl_sample_src *src)
+{
+    float scale;
+    ident_t tex, pos, size, pt;
+    const char *fn;
+    if (!setup_src(sh, src, &tex, &pos, &size, &pt, NULL, NULL, NULL, &scale, true, &fn))
+        return false;
+
+    sh_describe(sh, "nearest");
+    GLSL("// pl_shader_sample_nearest                               \n"
+         "vec4 color;                                               \n"
+         "{                                                         \n"
+         "vec2 pos = (floor(%s * %s) + vec2(0.5)) * %s;             \n"
+         "color = vec4(%f) * %s(%s, pos);                           \n"
+         "}                                                         \n",
+         pos, size, pt, scale, fn, tex);
+    return true;
+}
+
 static void bicubic_calcweights(struct pl_shader *sh, const char *t, const char *s)
 {
     // Explanation of how bicubic scaling with only 4 texel fetches is done:
@@ -191,6 +381,7 @@ bool pl_shader_sample_bicubic(struct pl_shader *sh, const struct pl_sample_src *
                  "will most likely result in nasty aliasing!");
     }
 
+    sh_describe(sh, "bicubic scaling");
     GLSL("// pl_shader_sample_bicubic                   \n"
          "vec4 color = vec4(0.0);                       \n"
          "{                                             \n"
@@ -237,33 +428,145 @@ static bool filter_compat(const struct pl_filter *filter, float inv_scale,
     return pl_filter_config_eq(&filter->params.config, params);
 }
 
+// Maximum number of distinct subpixel phases (per axis) for which to
+// precompute the polar weights, as well as the maximum number of taps
+#define POLAR_MAX_PHASES 8
+#define POLAR_MAX_TAPS 256
+
+struct sh_sampler_obj {
+    const struct pl_filter *filter;
+    struct pl_shader_obj *lut;
+    struct pl_shader_obj *pass2; // for pl_shader_sample_ortho
+
+    // Precomputed per-phase weights, for pl_shader_sample_polar
+    struct pl_shader_obj *phase_lut;
+    int phases[2];      // number of distinct phases in each direction
+    float phase_off[2]; // offset of the first phase, in units of 1/phases
+    int bound;          // tap bound the table was generated for
+};
+
+// Returns the number of output pixels after which the subpixel offsets of the
+// output pixels repeat, or 0 if this number is too large (or nonexistent).
+// This is the case whenever the ratio in question is a rational number with a
+// small numerator, e.g. 2.0 or 1.5.
+static int ratio_phases(float ratio)
+{
+    for (int p = 1; p <= POLAR_MAX_PHASES; p++) {
+        float q = p / ratio;
+        if (roundf(q) >= 1 && fabs(q - roundf(q)) < 1e-4)
+            return p;
+    }
+
+    return 0;
+}
+
+// Subpixel offset of the given phase, relative to the base texel
+static inline float phase_coord(const struct sh_sampler_obj *obj, int c, int k)
+{
+    return (k + obj->phase_off[c]) / obj->phases[c];
+}
+
+static inline int phase_tap(const struct sh_sampler_obj *obj, int x, int y)
+{
+    return (y + obj->bound - 1) * 2 * obj->bound + (x + obj->bound - 1);
+}
+
+// Returns whether the texel at offset (x, y) contributes to any phase
+static bool phase_tap_used(const struct sh_sampler_obj *obj, int x, int y)
+{
+    for (int ky = 0; ky < obj->phases[1]; ky++) {
+        for (int kx = 0; kx < obj->phases[0]; kx++) {
+            float dx = x - phase_coord(obj, 0, kx),
+                  dy = y - phase_coord(obj, 1, ky);
+            if (sqrtf(dx * dx + dy * dy) < obj->filter->radius_cutoff)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static void fill_phase_lut(void *priv, float *data, int w, int h, int d)
+{
+    const struct sh_sampler_obj *obj = priv;
+    const struct pl_filter *filt = obj->filter;
+    const int entries = filt->params.lut_entries;
+    const int bound = obj->bound;
+    pl_assert(w == 4 * bound * bound);
+    pl_assert(h == obj->phases[0] * obj->phases[1]);
+
+    for (int ky = 0; ky < obj->phases[1]; ky++) {
+        for (int kx = 0; kx < obj->phases[0]; kx++) {
+            float *row = &data[(ky * obj->phases[0] + kx) * w];
+            float fx = phase_coord(obj, 0, kx),
+                  fy = phase_coord(obj, 1, ky);
+            float wsum = 0.0;
+
+            for (int y = 1 - bound; y <= bound; y++) {
+                for (int x = 1 - bound; x <= bound; x++) {
+                    float dist = sqrtf((x - fx) * (x - fx) + (y - fy) * (y - fy));
+                    float wt = 0.0;
+                    if (dist < filt->radius_cutoff) {
+                        // Linearly interpolate the LUT, the same way the
+                        // GPU would when sampling it directly
+                        float pos = PL_MIN(dist / filt->radius, 1.0) * (entries - 1);
+                        int i = PL_MIN((int) pos, entries - 2);
+                        float fpos = pos - i;
+                        wt = (1 - fpos) * filt->weights[i] +
+                             fpos * filt->weights[i + 1];
+                    }
+
+                    row[phase_tap(obj, x, y)] = wt;
+                    wsum += wt;
+                }
+            }
+
+            // Normalize the weights in advance, so the shader doesn't have to
+            for (int i = 0; i < w; i++)
+                row[i] /= wsum;
+        }
+    }
+}
+
 // Subroutine for computing and adding an individual texel contribution
 // If `in` is NULL, samples directly
 // If `in` is set, takes the pixel from inX[idx] where X is the component,
 // `in` is the given identifier, and `idx` must be defined by the caller
-static void polar_sample(struct pl_shader *sh, const struct pl_filter *filter,
-                         const char *fn, ident_t tex, ident_t lut, int x, int y,
-                         int comps, ident_t in)
+// If `phases` is set, the weights are fetched from this pre-normalized
+// per-phase table instead of being computed from the distance
+static void polar_sample(struct pl_shader *sh, const struct sh_sampler_obj *obj,
+                         const char *fn, ident_t tex, ident_t lut,
+                         ident_t phases, int x, int y, int comps, ident_t in)
 {
-    // Since we can't know the subpixel position in advance, assume a
-    // worst case scenario
-    int yy = y > 0 ? y-1 : y;
-    int xx = x > 0 ? x-1 : x;
-    float dmax = sqrt(xx*xx + yy*yy);
-    // Skip samples definitely outside the radius
-    if (dmax >= filter->radius_cutoff)
-        return;
+    const struct pl_filter *filter = obj->filter;
+    bool maybe_skippable = false;
 
-    GLSL("d = length(vec2(%d.0, %d.0) - fcoord);\n", x, y);
-    // Check for samples that might be skippable
-    bool maybe_skippable = dmax >= filter->radius_cutoff - M_SQRT2;
-    if (maybe_skippable)
-        GLSL("if (d < %f) {\n", filter->radius_cutoff);
+    if (phases) {
+        if (!phase_tap_used(obj, x, y))
+            return;
 
-    // Get the weight for this pixel
-    GLSL("w = %s(d * 1.0/%f); \n"
-         "wsum += w;          \n",
-         lut, filter->radius);
+        GLSL("w = %s(ivec2(%d, phase)); \n", phases, phase_tap(obj, x, y));
+    } else {
+        // Since we can't know the subpixel position in advance, assume a
+        // worst case scenario
+        int yy = y > 0 ? y-1 : y;
+        int xx = x > 0 ? x-1 : x;
+        float dmax = sqrt(xx*xx + yy*yy);
+        // Skip samples definitely outside the radius
+        if (dmax >= filter->radius_cutoff)
+            return;
+
+        GLSL("d = length(vec2(%d.0, %d.0) - fcoord);\n", x, y);
+        // Check for samples that might be skippable
+        maybe_skippable = dmax >= filter->radius_cutoff - M_SQRT2;
+        if (maybe_skippable)
+            GLSL("if (d < %f) {\n", filter->radius_cutoff);
+
+        // Get the weight for this pixel
+        GLSL("w = %s(d * 1.0/%f); \n"
+             "wsum += w;          \n",
+             lut, filter->radius);
+    }
 
     if (in) {
         for (int n = 0; n < comps; n++)
@@ -278,17 +581,12 @@ static void polar_sample(struct pl_shader *sh, const struct pl_filter *filter,
         GLSL("}\n");
 }
 
-struct sh_sampler_obj {
-    const struct pl_filter *filter;
-    struct pl_shader_obj *lut;
-    struct pl_shader_obj *pass2; // for pl_shader_sample_ortho
-};
-
 static void sh_sampler_uninit(const struct pl_gpu *gpu, void *ptr)
 {
     struct sh_sampler_obj *obj = ptr;
     pl_shader_obj_destroy(&obj->lut);
     pl_shader_obj_destroy(&obj->pass2);
+    pl_shader_obj_destroy(&obj->phase_lut);
     pl_filter_free(&obj->filter);
     *obj = (struct sh_sampler_obj) {0};
 }
@@ -366,25 +664,93 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
         }
     }
 
-    ident_t lut = sh_lut(sh, &obj->lut, SH_LUT_LINEAR, lut_entries, 0, 0, 1,
-                         update, obj, fill_polar_lut);
+    // The weights are normalized by the shader, so FP16 is plenty
+    ident_t lut = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &obj->lut,
+        .method = SH_LUT_LINEAR,
+        .precision = SH_LUT_HALF,
+        .width = lut_entries,
+        .comps = 1,
+        .update = update,
+        .priv = obj,
+        .fill = fill_polar_lut,
+    });
     if (!lut) {
         SH_FAIL(sh, "Failed initializing polar LUT!");
         return false;
     }
 
+    int bound   = ceil(obj->filter->radius_cutoff);
+
+    // For rational scaling ratios, the subpixel offsets repeat every few
+    // pixels, so we can precompute the normalized weights for every possible
+    // offset and skip the distance calculations and renormalization
+    ident_t phases = NULL;
+    int px = flipped ? 0 : ratio_phases(rx),
+        py = flipped ? 0 : ratio_phases(ry);
+    if (px && py && 4 * bound * bound <= POLAR_MAX_TAPS) {
+        // Offset of the first phase, relative to the base texel
+        float offx = ((src->rect.x0 - 0.5) + 0.5 / rx) * px,
+              offy = ((src->rect.y0 - 0.5) + 0.5 / ry) * py;
+        offx -= floorf(offx);
+        offy -= floorf(offy);
+
+        bool phase_update = update || obj->bound != bound ||
+                            obj->phases[0] != px || obj->phases[1] != py ||
+                            fabs(obj->phase_off[0] - offx) > 1e-3 ||
+                            fabs(obj->phase_off[1] - offy) > 1e-3;
+
+        obj->bound = bound;
+        obj->phases[0] = px;
+        obj->phases[1] = py;
+        obj->phase_off[0] = offx;
+        obj->phase_off[1] = offy;
+
+        phases = sh_lut(sh, &(struct sh_lut_params) {
+            .object = &obj->phase_lut,
+            .precision = SH_LUT_FULL,
+            .width = 4 * bound * bound,
+            .height = px * py,
+            .comps = 1,
+            .update = phase_update,
+            .priv = obj,
+            .fill = fill_phase_lut,
+        });
+
+        if (!phases) {
+            // Not fatal, we can always fall back to the slow path
+            PL_TRACE(sh, "Failed initializing polar phase LUT, ignoring");
+            obj->phases[0] = obj->phases[1] = 0;
+        }
+    }
+
+    sh_describe(sh, "polar scaling");
     GLSL("// pl_shader_sample_polar                     \n"
          "vec4 color = vec4(0.0);                       \n"
          "{                                             \n"
-         "vec2 pos = %s, size = %s, pt = %s;            \n"
-         "vec2 fcoord = fract(pos * size - vec2(0.5));  \n"
-         "vec2 base = pos - pt * fcoord;                \n"
-         "float w, d, wsum = 0.0;                       \n"
-         "int idx;                                      \n"
-         "vec4 c;                                       \n",
+         "vec2 pos = %s, size = %s, pt = %s;            \n",
          pos, size, pt);
 
-    int bound   = ceil(obj->filter->radius_cutoff);
+    if (phases) {
+        // Snap the subpixel offset to the nearest phase, since the table only
+        // contains the weights for these
+        GLSL("const vec2 nph = vec2(%d.0, %d.0);                            \n"
+             "const vec2 off = vec2(%f, %f);                                \n"
+             "vec2 kph = mod(floor((pos * size - vec2(0.5)) * nph - off     \n"
+             "                     + vec2(0.5)), nph);                      \n"
+             "int phase = int(kph.y) * %d + int(kph.x);                     \n"
+             "vec2 fcoord = (kph + off) / nph;                              \n"
+             "float w, wsum = 1.0;                                          \n",
+             px, py, obj->phase_off[0], obj->phase_off[1], px);
+    } else {
+        GLSL("vec2 fcoord = fract(pos * size - vec2(0.5));  \n"
+             "float w, d, wsum = 0.0;                       \n");
+    }
+
+    GLSL("vec2 base = pos - pt * fcoord;                \n"
+         "int idx;                                      \n"
+         "vec4 c;                                       \n");
+
     int offset  = bound - 1; // padding top/left
     int padding = offset + bound; // total padding
 
@@ -433,7 +799,8 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
             for (int x = 1 - bound; x <= bound; x++) {
                 GLSL("idx = %d * rel.y + rel.x + %d;\n",
                      iw, iw * (y + offset) + x + offset);
-                polar_sample(sh, obj->filter, fn, src_tex, lut, x, y, comps, in);
+                polar_sample(sh, obj, fn, src_tex, lut, phases,
+                             x, y, comps, in);
             }
         }
     } else {
@@ -459,11 +826,14 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
                 use_gather &= PL_MAX(x, y) <= gpu->limits.max_gather_offset;
                 use_gather &= PL_MIN(x, y) >= gpu->limits.min_gather_offset;
 
+                // Gathering bypasses the clamping done by `fn`
+                use_gather &= !src_clamped(src);
+
                 if (!use_gather) {
                     // Switch to direct sampling instead
                     for (int yy = y; yy <= bound && yy <= y + 1; yy++) {
                         for (int xx = x; xx <= bound && xx <= x + 1; xx++) {
-                            polar_sample(sh, obj->filter, fn, src_tex, lut,
+                            polar_sample(sh, obj, fn, src_tex, lut, phases,
                                          xx, yy, comps, NULL);
                         }
                     }
@@ -486,7 +856,7 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
                         continue; // next subpixel
 
                     GLSL("idx = %d;\n", p);
-                    polar_sample(sh, obj->filter, fn, src_tex, lut,
+                    polar_sample(sh, obj, fn, src_tex, lut, phases,
                                  x+xo[p], y+yo[p], comps, "in");
                 }
             }
@@ -508,6 +878,101 @@ static void fill_ortho_lut(void *priv, float *data, int w, int h, int d)
     memcpy(data, filt->weights, w * h * 4 * sizeof(float));
 }
 
+struct ortho_filter {
+    const struct pl_filter *filter;
+    ident_t lut;
+    int N;     // number of samples to convolve
+    int width; // width of the LUT texture
+};
+
+// Generates (or re-uses) the filter for a single orthogonal pass, given the
+// sampler object for that pass and its scaling ratio. Sets `update` if the
+// LUT needs to be updated.
+static bool ortho_filter_gen(struct pl_shader *sh, struct sh_sampler_obj *obj,
+                             float ratio,
+                             const struct pl_sample_filter_params *params,
+                             bool *update)
+{
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    float inv_scale = 1.0 / ratio;
+    inv_scale = PL_MAX(inv_scale, 1.0);
+
+    if (params->no_widening)
+        inv_scale = 1.0;
+
+    int lut_entries = PL_DEF(params->lut_entries, 64);
+    *update = !filter_compat(obj->filter, inv_scale, lut_entries, 0.0,
+                             &params->filter);
+
+    if (*update) {
+        pl_filter_free(&obj->filter);
+        obj->filter = pl_filter_generate(sh->ctx, &(struct pl_filter_params) {
+            .config             = params->filter,
+            .lut_entries        = lut_entries,
+            .filter_scale       = inv_scale,
+            .max_row_size       = gpu->limits.max_tex_2d_dim / 4,
+            .row_stride_align   = 4,
+        });
+
+        if (!obj->filter) {
+            // This should never happen, but just in case ..
+            SH_FAIL(sh, "Failed initializing separated filter!");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Creates the LUT for a filter previously generated by `ortho_filter_gen`
+static bool ortho_filter_lut(struct pl_shader *sh, struct sh_sampler_obj *obj,
+                             const struct pl_sample_filter_params *params,
+                             bool update, struct ortho_filter *out)
+{
+    int lut_entries = PL_DEF(params->lut_entries, 64);
+    out->filter = obj->filter;
+    out->N = obj->filter->row_size;
+    out->width = obj->filter->row_stride / 4;
+    out->lut = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &obj->lut,
+        .method = SH_LUT_LINEAR,
+        .width = out->width,
+        .height = lut_entries,
+        .comps = 4,
+        .update = update,
+        .priv = obj,
+        .fill = fill_ortho_lut,
+    });
+
+    if (!out->lut) {
+        SH_FAIL(sh, "Failed initializing separated LUT!");
+        return false;
+    }
+
+    return true;
+}
+
+// Loads the weight for sample `n` into `weight`, given the subpixel offset
+// `fcoord`. Every 4th weight requires fetching another LUT entry into `ws`
+static void ortho_weight(struct pl_shader *sh, const struct ortho_filter *f,
+                         const char *fcoord, int n)
+{
+    if (n % 4 == 0) {
+        float denom = PL_MAX(1, f->width - 1); // avoid division by zero
+        GLSL("ws = %s(vec2(%f, %s));\n", f->lut, (n / 4) / denom, fcoord);
+    }
+    GLSL("weight = ws[%d];\n", n % 4);
+}
+
+// Emits the antiringing bookkeeping for sample `n` of an `N`-tap filter
+static void ortho_antiring(struct pl_shader *sh, int n, int N)
+{
+    if (n == N / 2 - 1 || n == N / 2) {
+        GLSL("lo = min(lo, c); \n"
+             "hi = max(hi, c); \n");
+    }
+}
+
 bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
                             const struct pl_sample_src *src,
                             const struct pl_sample_filter_params *params)
@@ -522,15 +987,18 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
     const struct pl_tex *tex = src->tex;
     pl_assert(gpu && tex);
 
+    struct pl_rect2d bounds = src_bounds(src);
     struct pl_sample_src srcfix = *src;
     switch (pass) {
     case PL_SEP_VERT:
-        srcfix.rect.x0 = 0;
-        srcfix.rect.x1 = srcfix.new_w = tex->params.w;
+        srcfix.rect.x0 = bounds.x0;
+        srcfix.rect.x1 = bounds.x1;
+        srcfix.new_w = pl_rect_w(bounds);
         break;
     case PL_SEP_HORIZ:
-        srcfix.rect.y0 = 0;
-        srcfix.rect.y1 = srcfix.new_h = tex->params.h;
+        srcfix.rect.y0 = bounds.y0;
+        srcfix.rect.y1 = bounds.y1;
+        srcfix.new_h = pl_rect_h(bounds);
         break;
     case PL_SEP_PASSES:
     default:
@@ -567,47 +1035,21 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
         assert(obj);
     }
 
-    float inv_scale = 1.0 / ratio[pass];
-    inv_scale = PL_MAX(inv_scale, 1.0);
-
-    if (params->no_widening)
-        inv_scale = 1.0;
-
-    int lut_entries = PL_DEF(params->lut_entries, 64);
-    bool update = !filter_compat(obj->filter, inv_scale, lut_entries, 0.0,
-                                 &params->filter);
-
-    if (update) {
-        pl_filter_free(&obj->filter);
-        obj->filter = pl_filter_generate(sh->ctx, &(struct pl_filter_params) {
-            .config             = params->filter,
-            .lut_entries        = lut_entries,
-            .filter_scale       = inv_scale,
-            .max_row_size       = gpu->limits.max_tex_2d_dim / 4,
-            .row_stride_align   = 4,
-        });
-
-        if (!obj->filter) {
-            // This should never happen, but just in case ..
-            SH_FAIL(sh, "Failed initializing separated filter!");
-            return false;
-        }
-    }
-
-    int N = obj->filter->row_size; // number of samples to convolve
-    int width = obj->filter->row_stride / 4; // width of the LUT texture
-    ident_t lut = sh_lut(sh, &obj->lut, SH_LUT_LINEAR, width, lut_entries, 0, 4,
-                         update, obj, fill_ortho_lut);
-    if (!lut) {
-        SH_FAIL(sh, "Failed initializing separated LUT!");
+    bool update;
+    struct ortho_filter f;
+    if (!ortho_filter_gen(sh, obj, ratio[pass], params, &update))
         return false;
-    }
+    if (!ortho_filter_lut(sh, obj, params, update, &f))
+        return false;
+
+    int N = f.N;
 
     const float dir[PL_SEP_PASSES][2] = {
         [PL_SEP_HORIZ] = {1.0, 0.0},
         [PL_SEP_VERT]  = {0.0, 1.0},
     };
 
+    sh_describe(sh, "separable scaling");
     GLSL("// pl_shader_sample_ortho                        \n"
          "vec4 color = vec4(0.0);                          \n"
          "{                                                \n"
@@ -629,28 +1071,33 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
              "vec4 lo = vec4(1e9); \n");
     }
 
+    // The weighted sum itself is precision-tolerant, so accumulate it using
+    // 16-bit floats where possible
+    bool f16 = sh_float16(sh);
+    if (f16)
+        GLSL("f16vec4 acc = f16vec4(0.0);\n");
+
     // Dispatch all of the samples
     GLSL("// scaler samples\n");
     for (int n = 0; n < N; n++) {
-        // Load the right weight for this instance. For every 4th weight, we
-        // need to fetch another LUT entry. Otherwise, just use the previous
-        if (n % 4 == 0) {
-            float denom = PL_MAX(1, width - 1); // avoid division by zero
-            GLSL("ws = %s(vec2(%f, fcoord));\n", lut, (n / 4) / denom);
-        }
-        GLSL("weight = ws[%d];\n", n % 4);
+        // Load the right weight for this instance
+        ortho_weight(sh, &f, "fcoord", n);
 
         // Load the input texel and add it to the running sum
-        GLSL("c = %s(%s, base + pt * vec2(%d.0)); \n"
-             "color += vec4(weight) * c;          \n",
-             fn, src_tex, n);
-
-        if (use_ar && (n == N / 2 - 1 || n == N / 2)) {
-            GLSL("lo = min(lo, c); \n"
-                 "hi = max(hi, c); \n");
+        GLSL("c = %s(%s, base + pt * vec2(%d.0)); \n", fn, src_tex, n);
+        if (f16) {
+            GLSL("acc += float16_t(weight) * f16vec4(c);\n");
+        } else {
+            GLSL("color += vec4(weight) * c;\n");
         }
+
+        if (use_ar)
+            ortho_antiring(sh, n, N);
     }
 
+    if (f16)
+        GLSL("color = vec4(acc);\n");
+
     if (use_ar) {
         GLSL("color = mix(color, clamp(color, lo, hi), %f);\n",
              params->antiring);
@@ -660,3 +1107,207 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
     GLSL("}\n");
     return true;
 }
+
+bool pl_shader_sample_ortho2d(struct pl_shader *sh,
+                              const struct pl_sample_src *src,
+                              const struct pl_sample_filter_params *params)
+{
+    pl_assert(params);
+    if (params->filter.polar) {
+        SH_FAIL(sh, "Trying to use separated sampling with a polar filter?");
+        return false;
+    }
+
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    const struct pl_tex *tex = src->tex;
+    pl_assert(gpu && tex);
+
+    if (!(gpu->caps & PL_GPU_CAP_COMPUTE) || params->no_compute)
+        return false;
+    if (src->rect.x0 > src->rect.x1 || src->rect.y0 > src->rect.y1)
+        return false;
+
+    // Everything that may reject this configuration happens up-front, before
+    // the shader is touched, so the caller can still fall back to two passes
+    struct pl_rect2d bounds = src_bounds(src);
+    float src_w = PL_DEF(pl_rect_w(src->rect), pl_rect_w(bounds)),
+          src_h = PL_DEF(pl_rect_h(src->rect), pl_rect_h(bounds));
+    float rx = PL_DEF(src->new_w, src_w) / src_w,
+          ry = PL_DEF(src->new_h, src_h) / src_h;
+
+    // Re-use the sampler objects of `pl_shader_sample_ortho`, so switching
+    // between the two does not require regenerating the filters
+    struct sh_sampler_obj *objv, *objh;
+    objv = SH_OBJ(sh, params->lut, PL_SHADER_OBJ_SAMPLER,
+                  struct sh_sampler_obj, sh_sampler_uninit);
+    if (!objv)
+        return false;
+    objh = SH_OBJ(sh, &objv->pass2, PL_SHADER_OBJ_SAMPLER,
+                  struct sh_sampler_obj, sh_sampler_uninit);
+    assert(objh);
+
+    bool updv, updh;
+    if (!ortho_filter_gen(sh, objv, ry, params, &updv))
+        return false;
+    if (!ortho_filter_gen(sh, objh, rx, params, &updh))
+        return false;
+
+    int comps = PL_DEF(src->components, tex->params.format->num_components);
+    int Nv = objv->filter->row_size, Nh = objh->filter->row_size;
+
+    // Each work group loads the input tile covering its output block (plus
+    // the filter margins) into shmem, runs the vertical pass on that, writes
+    // the result back into the same shmem array, and finally runs the
+    // horizontal pass per pixel.
+    //
+    // The margins grow with the filter radius (and the tile itself with the
+    // downscaling ratio), so for large filters, progressively shrink the
+    // block size until everything fits into shmem. Smaller blocks waste more
+    // texel fetches on the margins, but are still much cheaper than a
+    // separate pass through an intermediate texture.
+    static const int blocks[][2] = {{32, 8}, {16, 8}, {8, 8}, {8, 4}};
+    int bw = 0, bh = 0, iw = 0, ih = 0;
+    size_t shmem_req = 0;
+    for (int i = 0; i < PL_ARRAY_SIZE(blocks); i++) {
+        int w = blocks[i][0], h = blocks[i][1];
+        iw = (int) ceil(w / rx) + Nh + 1;
+        ih = (int) ceil(h / ry) + Nv + 1;
+        shmem_req = PL_MAX(ih, h) * iw * comps * sizeof(float);
+        if (sh_can_compute(sh, w, h, false, shmem_req)) {
+            bw = w;
+            bh = h;
+            break;
+        }
+    }
+
+    if (!bw) {
+        PL_TRACE(sh, "Filter too large for single-pass separable scaling");
+        return false;
+    }
+
+    // Past this point, any failure is a genuine error, which leaves the
+    // shader in a failed state
+    struct ortho_filter fv, fh;
+    if (!ortho_filter_lut(sh, objv, params, updv, &fv))
+        return false;
+    if (!ortho_filter_lut(sh, objh, params, updh, &fh))
+        return false;
+
+    if (!sh_try_compute(sh, bw, bh, false, shmem_req)) {
+        SH_FAIL(sh, "Failed enabling compute shader for separable scaling!");
+        return false;
+    }
+
+    ident_t src_tex, pos, size, pt;
+    float scale;
+    const char *fn;
+    if (!setup_src(sh, src, &src_tex, &pos, &size, &pt, NULL, NULL, NULL,
+                   &scale, false, &fn))
+    {
+        return false;
+    }
+
+    sh_describe(sh, "separable scaling");
+    GLSL("// pl_shader_sample_ortho2d                             \n"
+         "vec4 color = vec4(0.0);                                 \n"
+         "{                                                       \n"
+         "vec2 size = %s, pt = %s;                                \n"
+         "vec2 fpos = %s * size - vec2(0.5);                      \n"
+         "vec2 wpos = %s_map(gl_WorkGroupID * gl_WorkGroupSize);  \n"
+         "ivec2 margin = ivec2(%d, %d);                           \n"
+         "ivec2 wbase = ivec2(floor(wpos * size - vec2(0.5))) - margin; \n"
+         "ivec2 rel = ivec2(floor(fpos)) - margin - wbase;        \n"
+         "vec2 fcoord = fract(fpos);                              \n"
+         "int idx, row = int(gl_LocalInvocationID.y);             \n"
+         "float weight;                                           \n"
+         "vec4 ws, c;                                             \n",
+         size, pt, pos, pos, Nh / 2 - 1, Nv / 2 - 1);
+
+    // Load all relevant texels into shmem
+    ident_t in = sh_fresh(sh, "in");
+    for (int i = 0; i < comps; i++)
+        GLSLH("shared float %s%d[%d];\n", in, i, PL_MAX(ih, bh) * iw);
+
+    GLSL("for (int y = int(gl_LocalInvocationID.y); y < %d; y += %d) {  \n"
+         "for (int x = int(gl_LocalInvocationID.x); x < %d; x += %d) {  \n"
+         "c = %s(%s, pt * (vec2(wbase + ivec2(x, y)) + vec2(0.5)));     \n",
+         ih, bh, iw, bw, fn, src_tex);
+    for (int i = 0; i < comps; i++)
+        GLSL("%s%d[%d * y + x] = c[%d];\n", in, i, iw, i);
+    GLSL("}}                    \n"
+         "groupMemoryBarrier(); \n"
+         "barrier();            \n");
+
+    // Vertical pass, for every column of the tile at this thread's row. All
+    // threads in a row share the same vertical subpixel offset, so the
+    // weights only need to be loaded once. The results are kept in registers
+    // until all threads are done reading the input tile
+    bool use_ar = params->antiring > 0;
+    int cols = (iw + bw - 1) / bw;
+    GLSL("float wv[%d];  \n"
+         "vec4 vsum[%d]; \n",
+         Nv, cols);
+    for (int n = 0; n < Nv; n++) {
+        ortho_weight(sh, &fv, "fcoord.y", n);
+        GLSL("wv[%d] = weight;\n", n);
+    }
+
+    GLSL("for (int k = 0; k < %d; k++) {                                \n"
+         "int x = int(gl_LocalInvocationID.x) + k * %d;                 \n"
+         "vec4 sum = vec4(0.0);                                         \n"
+         "c = vec4(0.0);                                                \n"
+         "if (x < %d) {                                                 \n",
+         cols, bw, iw);
+    if (use_ar) {
+        GLSL("vec4 hi = vec4(0.0); \n"
+             "vec4 lo = vec4(1e9); \n");
+    }
+    for (int n = 0; n < Nv; n++) {
+        GLSL("idx = %d * (rel.y + %d) + x;\n", iw, n);
+        for (int i = 0; i < comps; i++)
+            GLSL("c[%d] = %s%d[idx];\n", i, in, i);
+        GLSL("sum += vec4(wv[%d]) * c;\n", n);
+        if (use_ar)
+            ortho_antiring(sh, n, Nv);
+    }
+    if (use_ar)
+        GLSL("sum = mix(sum, clamp(sum, lo, hi), %f);\n", params->antiring);
+    GLSL("}                     \n"
+         "vsum[k] = sum;        \n"
+         "}                     \n"
+         "groupMemoryBarrier(); \n"
+         "barrier();            \n");
+
+    // Store the intermediate rows, re-using the input tile's memory
+    GLSL("for (int k = 0; k < %d; k++) {                                \n"
+         "int x = int(gl_LocalInvocationID.x) + k * %d;                 \n"
+         "if (x < %d) {                                                 \n",
+         cols, bw, iw);
+    for (int i = 0; i < comps; i++)
+        GLSL("%s%d[%d * row + x] = vsum[k][%d];\n", in, i, iw, i);
+    GLSL("}}                    \n"
+         "groupMemoryBarrier(); \n"
+         "barrier();            \n");
+
+    // Horizontal pass, for this thread's output pixel
+    GLSL("c = vec4(0.0);\n");
+    if (use_ar) {
+        GLSL("vec4 hi = vec4(0.0); \n"
+             "vec4 lo = vec4(1e9); \n");
+    }
+    for (int n = 0; n < Nh; n++) {
+        ortho_weight(sh, &fh, "fcoord.x", n);
+        GLSL("idx = %d * row + rel.x + %d;\n", iw, n);
+        for (int i = 0; i < comps; i++)
+            GLSL("c[%d] = %s%d[idx];\n", i, in, i);
+        GLSL("color += vec4(weight) * c;\n");
+        if (use_ar)
+            ortho_antiring(sh, n, Nh);
+    }
+    if (use_ar)
+        GLSL("color = mix(color, clamp(color, lo, hi), %f);\n", params->antiring);
+
+    GLSL("color *= vec4(%f);\n", scale);
+    GLSL("}\n");
+    return true;
+}
@@ -15,6 +15,11 @@
  * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+
 #include "spirv.h"
 
 extern const struct spirv_compiler_fns pl_spirv_shaderc;
@@ -29,18 +34,22 @@ static const struct spirv_compiler_fns *compilers[] = {
 #endif
 };
 
-struct spirv_compiler *spirv_compiler_create(struct pl_context *ctx)
+struct spirv_compiler *spirv_compiler_create(struct pl_context *ctx,
+                                             const char *cache_dir,
+                                             uint32_t api_version)
 {
     for (int i = 0; i < PL_ARRAY_SIZE(compilers); i++) {
         const struct spirv_compiler_fns *impl = compilers[i];
         pl_info(ctx, "Initializing SPIR-V compiler '%s'", impl->name);
-        struct spirv_compiler *spirv = impl->create(ctx);
+        struct spirv_compiler *spirv = impl->create(ctx, api_version);
         if (!spirv)
             continue;
 
         spirv->ctx = ctx;
         spirv->impl = impl;
         strncpy(spirv->name, impl->name, sizeof(spirv->name) - 1);
+        spirv->cache_dir = cache_dir ? talloc_strdup(spirv, cache_dir) : NULL;
+        pthread_mutex_init(&spirv->lock, NULL);
         return spirv;
     }
 
@@ -54,5 +63,155 @@ void spirv_compiler_destroy(struct spirv_compiler **spirv)
     if (!*spirv)
         return;
 
+    pthread_mutex_destroy(&(*spirv)->lock);
     (*spirv)->impl->destroy(*spirv);
 }
+
+// Upper bound on the number of memoized shaders kept in memory
+#define SPIRV_CACHE_MAX 1024
+
+static uint64_t cache_key(const struct spirv_compiler *spirv,
+                          enum glsl_shader_stage type, const char *glsl,
+                          enum pl_shader_opt opt)
+{
+    struct {
+        uint64_t source;
+        char name[SPIRV_NAME_MAX_LEN];
+        int32_t compiler_version;
+        int32_t type;
+        int32_t opt;
+        uint32_t api_version;
+    } key;
+
+    // Zero the whole struct explicitly, so the hash is stable
+    memset(&key, 0, sizeof(key));
+    key.source = siphash64((const uint8_t *) glsl, strlen(glsl));
+    memcpy(key.name, spirv->name, sizeof(key.name));
+    key.compiler_version = spirv->compiler_version;
+    key.type = type;
+    key.opt = opt;
+    key.api_version = spirv->api_version;
+    return siphash64((const uint8_t *) &key, sizeof(key));
+}
+
+static char *cache_path(void *tactx, const struct spirv_compiler *spirv,
+                        uint64_t key)
+{
+    return talloc_asprintf(tactx, "%s/%016"PRIx64".spv", spirv->cache_dir, key);
+}
+
+static bool cache_load(struct spirv_compiler *spirv, void *tactx, uint64_t key,
+                       struct bstr *out)
+{
+    char *path = cache_path(NULL, spirv, key);
+    FILE *f = fopen(path, "rb");
+    talloc_free(path);
+    if (!f)
+        return false;
+
+    struct bstr data = {0};
+    bool ok = !fseek(f, 0, SEEK_END);
+    long len = ok ? ftell(f) : -1;
+    ok = len >= 4 && len % 4 == 0 && !fseek(f, 0, SEEK_SET);
+    if (ok) {
+        data.start = talloc_size(tactx, len);
+        data.len = fread(data.start, 1, len, f);
+        ok = data.len == len;
+    }
+    fclose(f);
+
+    // Sanity check the SPIR-V magic number, to reject truncated or foreign
+    // files instead of handing them to the driver
+    static const uint32_t spirv_magic = 0x07230203;
+    ok = ok && memcmp(data.start, &spirv_magic, sizeof(spirv_magic)) == 0;
+    if (!ok) {
+        PL_WARN(spirv, "Ignoring invalid SPIR-V cache entry %016"PRIx64, key);
+        talloc_free(data.start);
+        return false;
+    }
+
+    *out = data;
+    return true;
+}
+
+static void cache_save(struct spirv_compiler *spirv, uint64_t key,
+                       struct bstr data)
+{
+    // Write to a temporary file first, so that concurrent writers (in this
+    // or any other process) never observe partially written entries. The
+    // name is unique per writer, so these can't clobber each other either
+    char *path = cache_path(NULL, spirv, key);
+    char *tmp = talloc_asprintf(path, "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!f) {
+        PL_WARN(spirv, "Failed writing SPIR-V cache entry '%s'", tmp);
+        if (fd >= 0) {
+            close(fd);
+            remove(tmp);
+        }
+        goto done;
+    }
+
+    bool ok = fwrite(data.start, 1, data.len, f) == data.len;
+    ok &= fclose(f) == 0;
+    if (!ok || rename(tmp, path) != 0) {
+        PL_WARN(spirv, "Failed writing SPIR-V cache entry '%s'", path);
+        remove(tmp);
+    }
+
+done:
+    talloc_free(path);
+}
+
+bool spirv_compile_glsl(struct spirv_compiler *spirv, void *tactx,
+                        enum glsl_shader_stage type, const char *glsl,
+                        enum pl_shader_opt opt, struct bstr *out_spirv)
+{
+    uint64_t key = cache_key(spirv, type, glsl, opt);
+
+    pthread_mutex_lock(&spirv->lock);
+    for (int i = 0; i < spirv->num_cache; i++) {
+        const struct spirv_cache_entry *e = &spirv->cache[i];
+        if (e->key == key) {
+            out_spirv->start = talloc_memdup(tactx, e->spirv.start, e->spirv.len);
+            out_spirv->len = e->spirv.len;
+            pthread_mutex_unlock(&spirv->lock);
+            PL_DEBUG(spirv, "Using memoized SPIR-V %016"PRIx64, key);
+            return true;
+        }
+    }
+    pthread_mutex_unlock(&spirv->lock);
+
+    bool from_disk = false;
+    if (spirv->cache_dir && cache_load(spirv, tactx, key, out_spirv)) {
+        PL_DEBUG(spirv, "Using cached SPIR-V %016"PRIx64" from disk", key);
+        from_disk = true;
+    } else if (!spirv->impl->compile_glsl(spirv, tactx, type, glsl, opt, out_spirv)) {
+        return false;
+    }
+
+    // Write the result to disk without holding the lock, since this may
+    // be slow and other threads could otherwise only compile one at a time
+    if (spirv->cache_dir && !from_disk)
+        cache_save(spirv, key, *out_spirv);
+
+    pthread_mutex_lock(&spirv->lock);
+    if (spirv->num_cache == SPIRV_CACHE_MAX) {
+        // Evict the oldest entry
+        talloc_free(spirv->cache[0].spirv.start);
+        TARRAY_REMOVE_AT(spirv->cache, spirv->num_cache, 0);
+    }
+
+    struct spirv_cache_entry entry = {
+        .key = key,
+        .spirv = {
+            .start = talloc_memdup(spirv, out_spirv->start, out_spirv->len),
+            .len = out_spirv->len,
+        },
+    };
+
+    TARRAY_APPEND(spirv, spirv->cache, spirv->num_cache, entry);
+    pthread_mutex_unlock(&spirv->lock);
+    return true;
+}
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <pthread.h>
+
 #include "common.h"
 #include "context.h"
 
@@ -28,6 +30,10 @@ enum glsl_shader_stage {
 
 #define SPIRV_NAME_MAX_LEN 32
 
+// Target environment versions, encoded the same way as VK_MAKE_VERSION
+#define SPIRV_VULKAN_1_0 (1 << 22)
+#define SPIRV_VULKAN_1_1 ((1 << 22) | (1 << 12))
+
 struct spirv_compiler {
     char name[SPIRV_NAME_MAX_LEN]; // for cache invalidation
     struct pl_context *ctx;
@@ -36,21 +42,49 @@ struct spirv_compiler {
     // implementation-specific fields
     struct pl_glsl_desc glsl;      // supported GLSL capabilities
     int compiler_version;          // for cache invalidation, may be left as 0
+    uint32_t api_version;          // targeted vulkan version (SPIRV_VULKAN_*)
+
+    // memoized compilation results, see `spirv_compile_glsl`
+    const char *cache_dir;         // optional on-disk cache directory
+    pthread_mutex_t lock;
+    struct spirv_cache_entry *cache;
+    int num_cache;
+};
+
+struct spirv_cache_entry {
+    uint64_t key;
+    struct bstr spirv;
 };
 
 struct spirv_compiler_fns {
     const char *name;
 
-    // Compile GLSL to SPIR-V, under GL_KHR_vulkan_glsl semantics.
+    // Compile GLSL to SPIR-V, under GL_KHR_vulkan_glsl semantics. `opt`
+    // selects the optimization passes run on the result, where
+    // PL_SHADER_OPT_DEFAULT is up to the implementation.
     bool (*compile_glsl)(struct spirv_compiler *spirv, void *tactx,
                          enum glsl_shader_stage type, const char *glsl,
-                         struct bstr *out_spirv);
+                         enum pl_shader_opt opt, struct bstr *out_spirv);
 
-    // Only needs to initialize the implementation-specific fields
-    struct spirv_compiler *(*create)(struct pl_context *ctx);
+    // Only needs to initialize the implementation-specific fields. The
+    // compiler should target the highest version it supports, up to
+    // `api_version`.
+    struct spirv_compiler *(*create)(struct pl_context *ctx, uint32_t api_version);
     void (*destroy)(struct spirv_compiler *spirv);
 };
 
-// Initialize a SPIR-V compiler instance, or returns NULL on failure.
-struct spirv_compiler *spirv_compiler_create(struct pl_context *ctx);
+// Initialize a SPIR-V compiler instance, or returns NULL on failure. If
+// `cache_dir` is set, compiled shaders are additionally persisted there.
+// `api_version` is the maximum vulkan version the generated SPIR-V may
+// require, see `spirv_compiler.api_version` for the actual target.
+struct spirv_compiler *spirv_compiler_create(struct pl_context *ctx,
+                                             const char *cache_dir,
+                                             uint32_t api_version);
 void spirv_compiler_destroy(struct spirv_compiler **spirv);
+
+// Compile GLSL to SPIR-V, going through the compiler's cache. Results are
+// keyed by a hash of the source, stage, optimization level, compiler and
+// target version, so each distinct shader body is only compiled once. Thread-safe.
+bool spirv_compile_glsl(struct spirv_compiler *spirv, void *tactx,
+                        enum glsl_shader_stage type, const char *glsl,
+                        enum pl_shader_opt opt, struct bstr *out_spirv);
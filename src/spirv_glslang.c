@@ -24,7 +24,8 @@ static void glslang_destroy(struct spirv_compiler *spirv)
     talloc_free(spirv);
 }
 
-static struct spirv_compiler *glslang_create(struct pl_context *ctx)
+static struct spirv_compiler *glslang_create(struct pl_context *ctx,
+                                             uint32_t api_version)
 {
     if (!pl_glslang_init()) {
         pl_fatal(ctx, "Failed initializing glslang SPIR-V compiler!");
@@ -33,6 +34,9 @@ static struct spirv_compiler *glslang_create(struct pl_context *ctx)
 
     struct spirv_compiler *spirv = talloc_zero(NULL, struct spirv_compiler);
     spirv->compiler_version = pl_glslang_version();
+    spirv->api_version = SPIRV_VULKAN_1_0;
+    if (api_version >= SPIRV_VULKAN_1_1)
+        spirv->api_version = SPIRV_VULKAN_1_1;
     spirv->glsl = (struct pl_glsl_desc) {
         .version = 450,
         .vulkan  = true,
@@ -42,7 +46,7 @@ static struct spirv_compiler *glslang_create(struct pl_context *ctx)
 
 static bool glslang_compile(struct spirv_compiler *spirv, void *tactx,
                             enum glsl_shader_stage type, const char *glsl,
-                            struct bstr *out_spirv)
+                            enum pl_shader_opt opt, struct bstr *out_spirv)
 {
     static const enum pl_glslang_stage stages[] = {
         [GLSL_SHADER_VERTEX]   = PL_GLSLANG_VERTEX,
@@ -50,7 +54,17 @@ static bool glslang_compile(struct spirv_compiler *spirv, void *tactx,
         [GLSL_SHADER_COMPUTE]  = PL_GLSLANG_COMPUTE,
     };
 
-    struct pl_glslang_res *res = pl_glslang_compile(glsl, stages[type]);
+    // glslang only runs the SPIRV-Tools optimizer on request, so leave the
+    // default at no optimization to keep pass creation fast
+    static const enum pl_glslang_opt opts[] = {
+        [PL_SHADER_OPT_DEFAULT]     = PL_GLSLANG_OPT_NONE,
+        [PL_SHADER_OPT_NONE]        = PL_GLSLANG_OPT_NONE,
+        [PL_SHADER_OPT_SIZE]        = PL_GLSLANG_OPT_SIZE,
+        [PL_SHADER_OPT_PERFORMANCE] = PL_GLSLANG_OPT_PERFORMANCE,
+    };
+
+    struct pl_glslang_res *res;
+    res = pl_glslang_compile(glsl, spirv->api_version, stages[type], opts[opt]);
     if (!res || !res->success) {
         PL_ERR(spirv, "glslang failed: %s", res ? res->error_msg : "(null)");
         talloc_free(res);
@@ -22,18 +22,20 @@
 
 struct priv {
     shaderc_compiler_t compiler;
-    shaderc_compile_options_t opts;
+    shaderc_compile_options_t opts[PL_SHADER_OPT_COUNT];
 };
 
 static void shaderc_destroy(struct spirv_compiler *spirv)
 {
     struct priv *p = TA_PRIV(spirv);
-    shaderc_compile_options_release(p->opts);
+    for (int i = 0; i < PL_ARRAY_SIZE(p->opts); i++)
+        shaderc_compile_options_release(p->opts[i]);
     shaderc_compiler_release(p->compiler);
     talloc_free(spirv);
 }
 
-static struct spirv_compiler *shaderc_create(struct pl_context *ctx)
+static struct spirv_compiler *shaderc_create(struct pl_context *ctx,
+                                             uint32_t api_version)
 {
     struct spirv_compiler *spirv = talloc_ptrtype_priv(NULL, spirv, struct priv);
     struct priv *p = TA_PRIV(spirv);
@@ -43,17 +45,34 @@ static struct spirv_compiler *shaderc_create(struct pl_context *ctx)
     if (!p->compiler)
         goto error;
 
-    p->opts = shaderc_compile_options_initialize();
-    if (!p->opts)
-        goto error;
-
+    static const shaderc_optimization_level levels[] = {
 #ifdef SHADERC_HAS_PERF
-    shaderc_compile_options_set_optimization_level(p->opts,
-            shaderc_optimization_level_performance);
+        [PL_SHADER_OPT_DEFAULT]     = shaderc_optimization_level_performance,
+        [PL_SHADER_OPT_PERFORMANCE] = shaderc_optimization_level_performance,
 #else
-    shaderc_compile_options_set_optimization_level(p->opts,
-            shaderc_optimization_level_size);
+        [PL_SHADER_OPT_DEFAULT]     = shaderc_optimization_level_size,
+        [PL_SHADER_OPT_PERFORMANCE] = shaderc_optimization_level_size,
 #endif
+        [PL_SHADER_OPT_NONE]        = shaderc_optimization_level_zero,
+        [PL_SHADER_OPT_SIZE]        = shaderc_optimization_level_size,
+    };
+
+    spirv->api_version = SPIRV_VULKAN_1_0;
+    if (api_version >= SPIRV_VULKAN_1_1)
+        spirv->api_version = SPIRV_VULKAN_1_1;
+
+    // Compile options are immutable once in use, so keep one set per level
+    for (int i = 0; i < PL_ARRAY_SIZE(p->opts); i++) {
+        p->opts[i] = shaderc_compile_options_initialize();
+        if (!p->opts[i])
+            goto error;
+        shaderc_compile_options_set_optimization_level(p->opts[i], levels[i]);
+        if (spirv->api_version >= SPIRV_VULKAN_1_1) {
+            shaderc_compile_options_set_target_env(p->opts[i],
+                                                   shaderc_target_env_vulkan,
+                                                   shaderc_env_version_vulkan_1_1);
+        }
+    }
 
     int ver, rev;
     shaderc_get_spv_version(&ver, &rev);
@@ -71,7 +90,8 @@ error:
 
 static shaderc_compilation_result_t compile(struct priv *p,
                                             enum glsl_shader_stage type,
-                                            const char *glsl, bool debug)
+                                            const char *glsl,
+                                            enum pl_shader_opt opt, bool debug)
 {
     static const shaderc_shader_kind kinds[] = {
         [GLSL_SHADER_VERTEX]   = shaderc_glsl_vertex_shader,
@@ -81,20 +101,20 @@ static shaderc_compilation_result_t compile(struct priv *p,
 
     if (debug) {
         return shaderc_compile_into_spv_assembly(p->compiler, glsl, strlen(glsl),
-                                        kinds[type], "input", "main", p->opts);
+                                        kinds[type], "input", "main", p->opts[opt]);
     } else {
         return shaderc_compile_into_spv(p->compiler, glsl, strlen(glsl),
-                                        kinds[type], "input", "main", p->opts);
+                                        kinds[type], "input", "main", p->opts[opt]);
     }
 }
 
 static bool shaderc_compile(struct spirv_compiler *spirv, void *tactx,
                             enum glsl_shader_stage type, const char *glsl,
-                            struct bstr *out_spirv)
+                            enum pl_shader_opt opt, struct bstr *out_spirv)
 {
     struct priv *p = TA_PRIV(spirv);
 
-    shaderc_compilation_result_t res = compile(p, type, glsl, false);
+    shaderc_compilation_result_t res = compile(p, type, glsl, opt, false);
     int errs = shaderc_result_get_num_errors(res),
         warn = shaderc_result_get_num_warnings(res);
 
@@ -131,7 +151,7 @@ static bool shaderc_compile(struct spirv_compiler *spirv, void *tactx,
     // there doesn't seem to be a way to get this except compiling the shader
     // a second time..
     if (pl_msg_test(spirv->ctx, PL_LOG_TRACE)) {
-        shaderc_compilation_result_t dis = compile(p, type, glsl, true);
+        shaderc_compilation_result_t dis = compile(p, type, glsl, opt, true);
         PL_TRACE(spirv, "Generated SPIR-V:\n%.*s",
                  (int) shaderc_result_get_length(dis),
                  shaderc_result_get_bytes(dis));
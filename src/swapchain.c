@@ -67,3 +67,13 @@ void pl_swapchain_swap_buffers(const struct pl_swapchain *sw)
 {
     sw->impl->swap_buffers(sw);
 }
+
+bool pl_swapchain_timing(const struct pl_swapchain *sw,
+                         struct pl_swapchain_timing *out)
+{
+    *out = (struct pl_swapchain_timing) {0};
+    if (!sw->impl->timing)
+        return false;
+
+    return sw->impl->timing(sw, out);
+}
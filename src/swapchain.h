@@ -29,5 +29,6 @@ struct pl_sw_fns {
     SW_PFN(start_frame);
     SW_PFN(submit_frame);
     SW_PFN(swap_buffers);
+    SW_PFN(timing); // optional
 };
 #undef SW_PFN
@@ -1,10 +1,78 @@
 #include "tests.h"
-#include <sys/time.h>
+#include "shaders.h"
+
+#if PL_HAVE_LCMS
+#include "lcms.h"
+#endif
 
 #define TEX_SIZE 2048
 #define CUBE_SIZE 64
 #define NUM_FBOS 16
 #define BENCH_DUR 3
+#define MAX_BENCHES 64
+
+// Usage: bench [--json <out>] [--baseline <in>] [--threshold <percent>]
+//
+// The GPU benchmarks measure the CPU time spent generating and dispatching each
+// frame, as well as the GPU execution time of the pass (using timer queries),
+// separately. With --json, the results are also written to a file as JSON,
+// with one benchmark per line. Such a file can then be passed back as
+// --baseline to a later run, in which case any benchmark whose GPU time (or
+// frame time, if the GPU lacks timers) regressed by more than the threshold
+// (default: 5%) makes the run fail.
+//
+// The CPU benchmarks only measure the time spent on the host, for the
+// individual operations that make up the per-frame overhead of the renderer
+// (shader text assembly and generation, pass lookup, filter and LUT
+// generation).
+
+struct bench_stats {
+    int num;
+    double mean, p50, p90, p99; // in microseconds
+};
+
+struct bench_result {
+    const char *name;
+    unsigned long frames;
+    double ms_frame;
+    struct bench_stats cpu, gpu;
+};
+
+static struct bench_result results[MAX_BENCHES];
+static int num_results;
+
+static int cmp_u64(const void *pa, const void *pb)
+{
+    uint64_t a = *(const uint64_t *) pa, b = *(const uint64_t *) pb;
+    return (a > b) - (a < b);
+}
+
+static struct bench_stats compute_stats(uint64_t *samples, int num)
+{
+    struct bench_stats st = { .num = num };
+    if (!num)
+        return st;
+
+    qsort(samples, num, sizeof(uint64_t), cmp_u64);
+    for (int i = 0; i < num; i++)
+        st.mean += samples[i];
+    st.mean /= num * 1e3;
+    st.p50 = samples[(num - 1) * 50 / 100] / 1e3;
+    st.p90 = samples[(num - 1) * 90 / 100] / 1e3;
+    st.p99 = samples[(num - 1) * 99 / 100] / 1e3;
+    return st;
+}
+
+static void append_sample(uint64_t **samples, int *num, int *size, uint64_t ns)
+{
+    if (*num == *size) {
+        *size = PL_MAX(*size * 2, 1024);
+        *samples = realloc(*samples, *size * sizeof(uint64_t));
+        REQUIRE(*samples);
+    }
+
+    (*samples)[(*num)++] = ns;
+}
 
 static const struct pl_tex *create_test_img(const struct pl_gpu *gpu)
 {
@@ -61,9 +129,39 @@ static void run_bench(const struct pl_gpu *gpu, struct pl_dispatch *dp,
     pl_dispatch_finish(dp, &sh, fbo, NULL, NULL);
 }
 
+static void print_result(const struct bench_result *res, double secs)
+{
+    printf("'%s':\t%4lu frames in %1.6f seconds => %2.6f ms/frame (%5.2f FPS)\n",
+          res->name, res->frames, secs, res->ms_frame, res->frames / secs);
+    printf("\tcpu: %8.2f us/frame (p50 %8.2f, p90 %8.2f, p99 %8.2f)\n",
+           res->cpu.mean, res->cpu.p50, res->cpu.p90, res->cpu.p99);
+    if (res->gpu.num) {
+        printf("\tgpu: %8.2f us/frame (p50 %8.2f, p90 %8.2f, p99 %8.2f, "
+               "%d samples)\n", res->gpu.mean, res->gpu.p50, res->gpu.p90,
+               res->gpu.p99, res->gpu.num);
+    }
+}
+
+// Records the GPU time of the pass, if a new measurement completed since the
+// last call. Only the most recent measurement is available, so when several
+// complete at once (e.g. after a flush), the others are skipped
+static void poll_gpu_time(struct pl_dispatch *dp, int *count, uint64_t **samples,
+                          int *num, int *size)
+{
+    struct pl_dispatch_timing t;
+    if (pl_dispatch_timings(dp, &t, 1) && t.count > *count) {
+        append_sample(samples, num, size, t.last);
+        *count = t.count;
+    }
+}
+
 static void benchmark(const struct pl_gpu *gpu, const char *name, bench_fn bench)
 {
-    struct pl_dispatch *dp = pl_dispatch_create(gpu->ctx, gpu);
+    struct pl_dispatch *dp = pl_dispatch_create_ex(gpu->ctx, gpu,
+        &(struct pl_dispatch_params) {
+            .max_passes = pl_dispatch_default_params.max_passes,
+            .timing     = true,
+        });
     struct pl_shader_obj *state = NULL;
     const struct pl_tex *src = create_test_img(gpu);
 
@@ -89,29 +187,50 @@ static void benchmark(const struct pl_gpu *gpu, const char *name, bench_fn bench
     run_bench(gpu, dp, &state, src, fbos[0], bench);
     pl_gpu_finish(gpu);
 
+    // Skip the measurements of the warm-up run
+    struct pl_dispatch_timing t;
+    int gpu_count = pl_dispatch_timings(dp, &t, 1) ? t.count : 0;
+
     // Perform the actual benchmark
-    struct timeval start = {0}, stop = {0};
+    uint64_t *cpu_samples = NULL, *gpu_samples = NULL;
+    int num_cpu = 0, num_gpu = 0, size_cpu = 0, size_gpu = 0;
     unsigned long frames = 0;
     int index = 0;
 
-    gettimeofday(&start, NULL);
+    uint64_t start = pl_clock_ns(), stop;
     do {
         frames++;
+        uint64_t before = pl_clock_ns();
         run_bench(gpu, dp, &state, src, fbos[index++], bench);
+        stop = pl_clock_ns();
+        append_sample(&cpu_samples, &num_cpu, &size_cpu, stop - before);
+
         index %= NUM_FBOS;
         if (index == 0)
             pl_gpu_flush(gpu);
-        gettimeofday(&stop, NULL);
-    } while (stop.tv_sec - start.tv_sec < BENCH_DUR);
+        poll_gpu_time(dp, &gpu_count, &gpu_samples, &num_gpu, &size_gpu);
+    } while (stop - start < BENCH_DUR * 1000000000LLU);
 
     // Force the GPU to finish execution and re-measure the final stop time
     pl_gpu_finish(gpu);
-    gettimeofday(&stop, NULL);
+    stop = pl_clock_ns();
+    poll_gpu_time(dp, &gpu_count, &gpu_samples, &num_gpu, &size_gpu);
 
-    float secs = (float) (stop.tv_sec - start.tv_sec) +
-                 1e-6 * (stop.tv_usec - start.tv_usec);
-    printf("'%s':\t%4lu frames in %1.6f seconds => %2.6f ms/frame (%5.2f FPS)\n",
-          name, frames, secs, 1000 * secs / frames, frames / secs);
+    double secs = (stop - start) / 1e9;
+    REQUIRE(num_results < MAX_BENCHES);
+    struct bench_result *res = &results[num_results++];
+    *res = (struct bench_result) {
+        .name = name,
+        .frames = frames,
+        .ms_frame = 1000 * secs / frames,
+        .cpu = compute_stats(cpu_samples, num_cpu),
+        .gpu = compute_stats(gpu_samples, num_gpu),
+    };
+
+    print_result(res, secs);
+
+    free(cpu_samples);
+    free(gpu_samples);
 
     pl_shader_obj_destroy(&state);
     pl_dispatch_destroy(&dp);
@@ -299,11 +418,550 @@ static void bench_av1_grain_lap(struct pl_shader *sh, struct pl_shader_obj **sta
     pl_shader_av1_grain(sh, state, (enum pl_channel[]){0, 1, 2}, NULL, &params);
 }
 
-int main()
+// CPU micro-benchmarks. Each iteration of `bench` is timed individually. If
+// `gpu` is set, it is drained before taking the final time, so that the frame
+// time reflects the throughput of any GPU work submitted by `bench`.
+typedef void (*cpu_bench_fn)(void *priv, int iter);
+
+static void cpu_benchmark(const struct pl_gpu *gpu, const char *name,
+                          cpu_bench_fn bench, void *priv)
+{
+    uint64_t *samples = NULL;
+    int num = 0, size = 0;
+    unsigned long iters = 0;
+
+    uint64_t start = pl_clock_ns(), stop;
+    do {
+        uint64_t before = pl_clock_ns();
+        bench(priv, iters++);
+        stop = pl_clock_ns();
+        append_sample(&samples, &num, &size, stop - before);
+    } while (stop - start < BENCH_DUR * 1000000000LLU);
+
+    if (gpu) {
+        pl_gpu_finish(gpu);
+        stop = pl_clock_ns();
+    }
+
+    double secs = (stop - start) / 1e9;
+    REQUIRE(num_results < MAX_BENCHES);
+    struct bench_result *res = &results[num_results++];
+    *res = (struct bench_result) {
+        .name = name,
+        .frames = iters,
+        .ms_frame = 1000 * secs / iters,
+        .cpu = compute_stats(samples, num),
+    };
+
+    print_result(res, secs);
+    free(samples);
+}
+
+struct dispatch_bench {
+    const struct pl_gpu *gpu;
+    struct pl_dispatch *dp;
+    const struct pl_tex *src;
+    const struct pl_tex *fbo;
+    int num_passes; // number of distinct passes cycled through
+};
+
+static void bench_cpu_dispatch(void *priv, int iter)
+{
+    struct dispatch_bench *b = priv;
+    struct pl_shader *sh = pl_dispatch_begin(b->dp);
+    pl_shader_sample_bicubic(sh, &(struct pl_sample_src) { .tex = b->src });
+    if (b->num_passes > 1)
+        GLSL("color.a += %d.0 * 1e-9; \n", iter % b->num_passes);
+    REQUIRE(pl_dispatch_finish(b->dp, &sh, b->fbo, NULL, NULL));
+
+    // Avoid queuing up unbounded amounts of work on the GPU
+    if (iter % NUM_FBOS == NUM_FBOS - 1)
+        pl_gpu_flush(b->gpu);
+}
+
+// Measures the CPU cost of generating and dispatching an already compiled
+// pass, out of a pass cache containing `num_passes` passes
+static void benchmark_dispatch(const struct pl_gpu *gpu, const char *name,
+                               int num_passes)
+{
+    const struct pl_fmt *fmt;
+    fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 4, 8, 0, PL_FMT_CAP_RENDERABLE);
+    REQUIRE(fmt);
+
+    struct dispatch_bench b = {
+        .gpu = gpu,
+        .dp = pl_dispatch_create(gpu->ctx, gpu),
+        .src = create_test_img(gpu),
+        .num_passes = num_passes,
+        .fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .format     = fmt,
+            .w          = 64,
+            .h          = 64,
+            .renderable = true,
+        }),
+    };
+    REQUIRE(b.fbo);
+
+    // Compile all of the passes up-front
+    for (int i = 0; i < num_passes; i++)
+        bench_cpu_dispatch(&b, i);
+    pl_gpu_finish(gpu);
+
+    cpu_benchmark(gpu, name, bench_cpu_dispatch, &b);
+
+    pl_dispatch_destroy(&b.dp);
+    pl_tex_destroy(gpu, &b.src);
+    pl_tex_destroy(gpu, &b.fbo);
+}
+
+struct shader_bench {
+    struct pl_shader *sh;
+    struct pl_shader_params params;
+    struct pl_shader_obj *lut;
+    const struct pl_tex *src;
+    uint64_t sig;
+};
+
+// Generates a fairly complex shader, without dispatching it
+static void bench_cpu_shader(void *priv, int iter)
+{
+    struct shader_bench *b = priv;
+    pl_shader_reset(b->sh, &b->params);
+    pl_shader_sample_polar(b->sh, &(struct pl_sample_src) { .tex = b->src },
+        &(struct pl_sample_filter_params) {
+            .filter = pl_filter_ewa_lanczos,
+            .no_compute = true,
+            .lut = &b->lut,
+        });
+    pl_shader_color_map(b->sh, NULL, pl_color_space_hdr10,
+                        pl_color_space_monitor, NULL, false);
+    b->sig += pl_shader_signature(b->sh);
+}
+
+static void benchmark_shader(const struct pl_gpu *gpu, const char *name)
+{
+    struct shader_bench b = {
+        .params = { .gpu = gpu },
+        .src = create_test_img(gpu),
+    };
+
+    b.sh = pl_shader_alloc(gpu->ctx, &b.params);
+    cpu_benchmark(NULL, name, bench_cpu_shader, &b);
+    pl_shader_free(&b.sh);
+    pl_shader_obj_destroy(&b.lut);
+    pl_tex_destroy(gpu, &b.src);
+}
+
+// Emits a mix of GLSL lines typical for the generated shaders, to measure the
+// cost of the shader text assembly itself
+static void bench_cpu_glsl(void *priv, int iter)
+{
+    struct pl_shader *sh = priv;
+    pl_shader_reset(sh, NULL);
+    for (int i = 0; i < 100; i++) {
+        GLSL("// pl_shader_sample_polar               \n"
+             "vec4 color = vec4(0.0);                  \n"
+             "{                                        \n"
+             "vec2 pos = %s, size = vec2(textureSize(%s, 0)); \n",
+             "_pos_0", "_src_tex_0");
+        GLSL("float w, d, wsum = 0.0;                  \n"
+             "int idx;                                 \n");
+        GLSL("offset = ivec2(%d, %d); \n", i % 8 - 4, i / 8);
+        GLSL("d = length(vec2(offset) - fcoord) * %f; \n", 1.0 / (i + 1));
+        GLSL("color += vec4(%f) * w;                   \n"
+             "}                                        \n", i * 0.25);
+    }
+}
+
+struct filter_bench {
+    struct pl_context *ctx;
+    const struct pl_filter_config *config;
+};
+
+static void bench_cpu_filter(void *priv, int iter)
+{
+    struct filter_bench *b = priv;
+
+    // Vary the scale slightly, to defeat the filter cache
+    const struct pl_filter *filter = pl_filter_generate(b->ctx,
+        &(struct pl_filter_params) {
+            .config         = *b->config,
+            .lut_entries    = 64,
+            .filter_scale   = 1.0 + (iter % 1000) * 1e-4,
+            .cutoff         = b->config->polar ? 0.001 : 0.0,
+        });
+
+    REQUIRE(filter);
+    pl_filter_free(&filter);
+}
+
+struct noise_bench {
+    float *data;
+    int size;
+};
+
+static void bench_cpu_blue_noise(void *priv, int iter)
+{
+    struct noise_bench *b = priv;
+    pl_generate_blue_noise(b->data, b->size);
+}
+
+#if PL_HAVE_LCMS
+struct lcms_bench {
+    struct pl_context *ctx;
+    float *data;
+    int size;
+};
+
+static void bench_cpu_lcms(void *priv, int iter)
+{
+    struct lcms_bench *b = priv;
+    struct pl_3dlut_profile src = { .color = pl_color_space_bt709 };
+    struct pl_3dlut_profile dst = { .color = pl_color_space_srgb };
+    struct pl_3dlut_result out;
+    REQUIRE(pl_lcms_compute_lut(b->ctx, PL_INTENT_RELATIVE_COLORIMETRIC, src,
+                                dst, b->data, b->size, b->size, b->size, 0,
+                                NULL, &out));
+}
+#endif
+
+// End-to-end benchmarks, covering complete `pl_render_image` calls and
+// texture transfers. These measure the CPU time per frame, and the overall
+// frame time (throughput) including the GPU work.
+#define SRC_W 1920
+#define SRC_H 1080
+
+// Uploads a plane of `comps` components of `depth` bits each, filled with
+// random data
+static struct pl_plane upload_plane(const struct pl_gpu *gpu, int w, int h,
+                                    int comps, int depth, int first_comp)
+{
+    int bytes = depth / 8;
+    size_t size = (size_t) w * h * comps * bytes;
+    uint8_t *data = malloc(size);
+    REQUIRE(data);
+    for (size_t i = 0; i < size; i++)
+        data[i] = rand();
+
+    struct pl_plane_data pd = {
+        .type = PL_FMT_UNORM,
+        .width = w,
+        .height = h,
+        .pixel_stride = comps * bytes,
+        .pixels = data,
+    };
+
+    for (int c = 0; c < comps; c++) {
+        pd.component_size[c] = depth;
+        pd.component_map[c] = first_comp + c;
+    }
+
+    struct pl_plane plane = {0};
+    const struct pl_tex *tex = NULL;
+    REQUIRE(pl_upload_plane(gpu, &plane, &tex, &pd));
+    free(data);
+    return plane;
+}
+
+struct render_bench {
+    const struct pl_gpu *gpu;
+    struct pl_renderer *rr;
+    struct pl_image image;
+    struct pl_render_target target;
+    struct pl_render_params params;
+    struct pl_overlay overlays[4];
+};
+
+static void bench_render(void *priv, int iter)
+{
+    struct render_bench *b = priv;
+    b->image.signature = iter; // every frame is considered a new frame
+    REQUIRE(pl_render_image(b->rr, &b->image, &b->target, &b->params));
+    pl_gpu_flush(b->gpu);
+}
+
+enum render_test {
+    RENDER_SDR_UPSCALE,   // 1080p RGB -> 4K with ewa_lanczos
+    RENDER_HDR_TONEMAP,   // 1080p HDR10 -> SDR with peak detection
+    RENDER_YUV420_DEBAND, // 1080p 4:2:0 YCbCr with debanding
+    RENDER_OVERLAYS,      // 1080p RGB with a few overlays on top
+};
+
+static void benchmark_render(const struct pl_gpu *gpu, const char *name,
+                             enum render_test test)
+{
+    const struct pl_fmt *fmt;
+    fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 4, 8, 0, PL_FMT_CAP_RENDERABLE);
+    REQUIRE(fmt);
+
+    bool upscale = test == RENDER_SDR_UPSCALE;
+    const struct pl_tex *fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .format     = fmt,
+        .w          = upscale ? 2 * SRC_W : SRC_W,
+        .h          = upscale ? 2 * SRC_H : SRC_H,
+        .renderable = true,
+        .storable   = !!(fmt->caps & PL_FMT_CAP_STORABLE),
+    });
+    REQUIRE(fbo);
+
+    struct render_bench b = {
+        .gpu = gpu,
+        .rr = pl_renderer_create(gpu->ctx, gpu),
+        .params = pl_render_default_params,
+        .image = {
+            .num_planes = 1,
+            .repr       = pl_color_repr_rgb,
+            .color      = pl_color_space_srgb,
+            .width      = SRC_W,
+            .height     = SRC_H,
+            .src_rect   = {0, 0, SRC_W, SRC_H},
+        },
+        .target = {
+            .fbo        = fbo,
+            .dst_rect   = {0, 0, fbo->params.w, fbo->params.h},
+            .repr       = pl_color_repr_rgb,
+            .color      = pl_color_space_srgb,
+        },
+    };
+
+    switch (test) {
+    case RENDER_SDR_UPSCALE:
+        b.image.planes[0] = upload_plane(gpu, SRC_W, SRC_H, 3, 8, 0);
+        b.params.upscaler = &pl_filter_ewa_lanczos;
+        break;
+    case RENDER_HDR_TONEMAP:
+        b.image.planes[0] = upload_plane(gpu, SRC_W, SRC_H, 3, 16, 0);
+        b.image.color = pl_color_space_hdr10;
+        b.params.peak_detect_params = &pl_peak_detect_default_params;
+        break;
+    case RENDER_YUV420_DEBAND:
+        b.image.num_planes = 3;
+        b.image.planes[0] = upload_plane(gpu, SRC_W, SRC_H, 1, 8, 0);
+        b.image.planes[1] = upload_plane(gpu, SRC_W / 2, SRC_H / 2, 1, 8, 1);
+        b.image.planes[2] = upload_plane(gpu, SRC_W / 2, SRC_H / 2, 1, 8, 2);
+        b.image.repr = (struct pl_color_repr) {
+            .sys    = PL_COLOR_SYSTEM_BT_709,
+            .levels = PL_COLOR_LEVELS_TV,
+        };
+        b.image.color = pl_color_space_bt709;
+        b.params.deband_params = &pl_deband_default_params;
+        break;
+    case RENDER_OVERLAYS:
+        b.image.planes[0] = upload_plane(gpu, SRC_W, SRC_H, 3, 8, 0);
+        for (int i = 0; i < PL_ARRAY_SIZE(b.overlays); i++) {
+            b.overlays[i] = (struct pl_overlay) {
+                .plane  = upload_plane(gpu, 256, 128, 4, 8, 0),
+                .rect   = {64 + 320 * i, 64, 64 + 320 * i + 256, 64 + 128},
+                .mode   = PL_OVERLAY_NORMAL,
+                .repr   = pl_color_repr_rgb,
+                .color  = pl_color_space_srgb,
+            };
+            b.overlays[i].repr.alpha = PL_ALPHA_INDEPENDENT;
+        }
+        b.image.overlays = b.overlays;
+        b.image.num_overlays = PL_ARRAY_SIZE(b.overlays);
+        break;
+    }
+
+    // Render and flush+block once to force shader compilation etc.
+    bench_render(&b, 0);
+    pl_gpu_finish(gpu);
+
+    cpu_benchmark(gpu, name, bench_render, &b);
+
+    pl_renderer_destroy(&b.rr);
+    for (int i = 0; i < b.image.num_planes; i++)
+        pl_tex_destroy(gpu, &b.image.planes[i].texture);
+    for (int i = 0; i < b.image.num_overlays; i++)
+        pl_tex_destroy(gpu, &b.overlays[i].plane.texture);
+    pl_tex_destroy(gpu, &fbo);
+}
+
+struct transfer_bench {
+    const struct pl_gpu *gpu;
+    const struct pl_tex *tex;
+    void *data;
+    bool download;
+};
+
+static void bench_transfer(void *priv, int iter)
+{
+    struct transfer_bench *b = priv;
+    struct pl_tex_transfer_params params = {
+        .tex = b->tex,
+        .ptr = b->data,
+    };
+
+    if (b->download) {
+        REQUIRE(pl_tex_download(b->gpu, &params));
+    } else {
+        REQUIRE(pl_tex_upload(b->gpu, &params));
+        pl_gpu_flush(b->gpu);
+    }
+}
+
+// Measures the throughput of transferring a 4K RGBA8 frame from host memory
+// to a texture or back
+static void benchmark_transfer(const struct pl_gpu *gpu, const char *name,
+                               bool download)
+{
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 4, 8, 8, 0);
+    REQUIRE(fmt);
+
+    struct transfer_bench b = {
+        .gpu = gpu,
+        .download = download,
+        .tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .format         = fmt,
+            .w              = 2 * SRC_W,
+            .h              = 2 * SRC_H,
+            .host_writable  = !download,
+            .host_readable  = download,
+        }),
+    };
+    REQUIRE(b.tex);
+
+    size_t size = b.tex->params.w * b.tex->params.h * fmt->texel_size;
+    b.data = calloc(1, size);
+    REQUIRE(b.data);
+
+    bench_transfer(&b, 0);
+    pl_gpu_finish(gpu);
+
+    cpu_benchmark(gpu, name, bench_transfer, &b);
+    const struct bench_result *res = &results[num_results - 1];
+    printf("\t=> %.2f MB/s\n", size / (res->ms_frame * 1e3));
+
+    pl_tex_destroy(gpu, &b.tex);
+    free(b.data);
+}
+
+static void write_stats(FILE *f, const char *prefix, const struct bench_stats *st)
+{
+    if (!st->num) {
+        fprintf(f, ", \"%s\": null", prefix);
+        return;
+    }
+
+    fprintf(f, ", \"%s\": {\"samples\": %d, \"mean_us\": %.3f, \"p50_us\": %.3f, "
+            "\"p90_us\": %.3f, \"p99_us\": %.3f}", prefix, st->num, st->mean,
+            st->p50, st->p90, st->p99);
+}
+
+static bool write_json(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    fprintf(f, "{\"benchmarks\": [\n");
+    for (int i = 0; i < num_results; i++) {
+        const struct bench_result *res = &results[i];
+        fprintf(f, "  {\"name\": \"%s\", \"frames\": %lu, \"ms_frame\": %.6f",
+                res->name, res->frames, res->ms_frame);
+        write_stats(f, "cpu", &res->cpu);
+        write_stats(f, "gpu", &res->gpu);
+        fprintf(f, "}%s\n", i + 1 < num_results ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    return fclose(f) == 0;
+}
+
+// Returns the number found after `"key": ` in `str`, or a negative value
+static double json_number(const char *str, const char *key)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *pos = strstr(str, pattern);
+    if (!pos)
+        return -1.0;
+
+    char *end;
+    double val = strtod(pos + strlen(pattern), &end);
+    return end == pos + strlen(pattern) ? -1.0 : val;
+}
+
+// Compares the results against a file previously written by `write_json`.
+// This only understands files in exactly that format (one benchmark per
+// line). Returns the number of regressions found.
+static int compare_baseline(const char *path, double threshold)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed opening baseline '%s'\n", path);
+        return 1;
+    }
+
+    int regressions = 0;
+    char line[1024];
+    printf("= Comparing against baseline (threshold %.1f%%) =\n", threshold);
+    while (fgets(line, sizeof(line), f)) {
+        const char *name = strstr(line, "\"name\": \"");
+        if (!name)
+            continue;
+        name += strlen("\"name\": \"");
+
+        const struct bench_result *res = NULL;
+        for (int i = 0; i < num_results; i++) {
+            size_t len = strlen(results[i].name);
+            if (strncmp(name, results[i].name, len) == 0 && name[len] == '"') {
+                res = &results[i];
+                break;
+            }
+        }
+
+        if (!res)
+            continue;
+
+        // Prefer the GPU time, since this is not affected by CPU load
+        const char *gpu = strstr(line, "\"gpu\": {");
+        double old, new;
+        const char *metric;
+        if (gpu && res->gpu.num) {
+            old = json_number(gpu, "p50_us");
+            new = res->gpu.p50;
+            metric = "gpu p50";
+        } else {
+            old = json_number(line, "ms_frame");
+            new = res->ms_frame;
+            metric = "ms/frame";
+        }
+
+        if (old <= 0)
+            continue;
+
+        double change = 100.0 * (new - old) / old;
+        bool regressed = change > threshold;
+        printf("'%s':\t%s %12.6f -> %12.6f (%+6.2f%%)%s\n", res->name, metric,
+               old, new, change, regressed ? " REGRESSION" : "");
+        regressions += regressed;
+    }
+
+    fclose(f);
+    return regressions;
+}
+
+int main(int argc, char **argv)
 {
     setbuf(stdout, NULL);
     setbuf(stderr, NULL);
 
+    const char *json = NULL, *baseline = NULL;
+    double threshold = 5.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--json <out>] [--baseline <in>] "
+                    "[--threshold <percent>]\n", argv[0]);
+            return 1;
+        }
+    }
+
     struct pl_context *ctx;
     ctx = pl_context_create(PL_API_VER, &(struct pl_context_params) {
         .log_cb     = isatty(fileno(stdout)) ? pl_log_color : pl_log_simple,
@@ -348,5 +1006,74 @@ int main()
     benchmark(vk->gpu, "av1_grain", bench_av1_grain);
     benchmark(vk->gpu, "av1_grain_lap", bench_av1_grain_lap);
 
+    printf("= Running end-to-end benchmarks =\n");
+    benchmark_render(vk->gpu, "render_sdr_upscale", RENDER_SDR_UPSCALE);
+    benchmark_render(vk->gpu, "render_hdr_tonemap", RENDER_HDR_TONEMAP);
+    benchmark_render(vk->gpu, "render_yuv420_deband", RENDER_YUV420_DEBAND);
+    benchmark_render(vk->gpu, "render_overlays", RENDER_OVERLAYS);
+
+    benchmark_transfer(vk->gpu, "upload_4k", false);
+    benchmark_transfer(vk->gpu, "download_4k", true);
+
+    // Repeat the transfers using the dedicated transfer queues, if any
+    const struct pl_vulkan *vk_async;
+    vk_async = pl_vulkan_create(ctx, &(struct pl_vulkan_params) {
+        .allow_software = true,
+        .async_transfer = true,
+    });
+
+    if (vk_async) {
+        benchmark_transfer(vk_async->gpu, "upload_4k_async", false);
+        benchmark_transfer(vk_async->gpu, "download_4k_async", true);
+        pl_vulkan_destroy(&vk_async);
+    }
+
+    printf("= Running CPU benchmarks =\n");
+    benchmark_dispatch(vk->gpu, "cpu_dispatch", 1);
+    benchmark_dispatch(vk->gpu, "cpu_dispatch_many", 200);
+    benchmark_shader(vk->gpu, "cpu_shader_gen");
+
+    struct pl_shader *glsl = pl_shader_alloc(ctx, NULL);
+    cpu_benchmark(NULL, "cpu_glsl_append", bench_cpu_glsl, glsl);
+    pl_shader_free(&glsl);
+
+    cpu_benchmark(NULL, "cpu_filter_polar", bench_cpu_filter, &(struct filter_bench) {
+        .ctx = ctx,
+        .config = &pl_filter_ewa_lanczos,
+    });
+
+    cpu_benchmark(NULL, "cpu_filter_ortho", bench_cpu_filter, &(struct filter_bench) {
+        .ctx = ctx,
+        .config = &pl_filter_spline36,
+    });
+
+    // Size 64 is served from a precomputed table, all others are generated
+    struct noise_bench noise = { .data = malloc(128 * 128 * sizeof(float)) };
+    REQUIRE(noise.data);
+    noise.size = 64;
+    cpu_benchmark(NULL, "cpu_blue_noise_64", bench_cpu_blue_noise, &noise);
+    noise.size = 128;
+    cpu_benchmark(NULL, "cpu_blue_noise_128", bench_cpu_blue_noise, &noise);
+    free(noise.data);
+
+#if PL_HAVE_LCMS
+    struct lcms_bench lcms = {
+        .ctx = ctx,
+        .size = pl_3dlut_default_params.size_r,
+    };
+    lcms.data = malloc(lcms.size * lcms.size * lcms.size * sizeof(float[4]));
+    REQUIRE(lcms.data);
+    cpu_benchmark(NULL, "cpu_lcms_lut", bench_cpu_lcms, &lcms);
+    free(lcms.data);
+#endif
+
+    if (json && !write_json(json)) {
+        fprintf(stderr, "Failed writing results to '%s'\n", json);
+        return 1;
+    }
+
+    if (baseline && compare_baseline(baseline, threshold))
+        return 1;
+
     return 0;
 }
@@ -304,4 +304,109 @@ int main()
 
     // These models should round-trip green
     TEST_CONE(pl_vision_normal, green);
+
+    // Test the CPU color conversion against the decoding matrix
+    struct pl_context *ctx = pl_test_context();
+    enum { CONV_W = 67, CONV_H = 5 }; // odd size to test the remainders
+    static float ycbcr[3][CONV_H][CONV_W], rgb[3][CONV_H][CONV_W];
+    static uint16_t rgb16[3][CONV_H][CONV_W];
+    for (int c = 0; c < 3; c++) {
+        for (int row = 0; row < CONV_H; row++) {
+            for (int col = 0; col < CONV_W; col++)
+                ycbcr[c][row][col] = RANDOM;
+        }
+    }
+
+    struct pl_convert_plane conv_src[3], conv_dst[3], conv_dst16[3];
+    for (int c = 0; c < 3; c++) {
+        conv_src[c] = (struct pl_convert_plane) {
+            .type = PL_CONVERT_FLOAT,
+            .data = ycbcr[c],
+            .stride = sizeof(ycbcr[c][0]),
+        };
+        conv_dst[c] = (struct pl_convert_plane) {
+            .type = PL_CONVERT_FLOAT,
+            .data = rgb[c],
+            .stride = sizeof(rgb[c][0]),
+        };
+        conv_dst16[c] = (struct pl_convert_plane) {
+            .type = PL_CONVERT_U16,
+            .data = rgb16[c],
+            .stride = sizeof(rgb16[c][0]),
+        };
+    }
+
+    struct pl_convert_params conv = {
+        .repr = tv_repr,
+        .src = pl_color_space_bt709,
+        .dst = pl_color_space_bt709,
+        .threads = 2,
+    };
+
+    conv.repr.bits = (struct pl_bit_encoding) {0};
+    struct pl_color_repr conv_repr = conv.repr;
+    struct pl_transform3x3 conv_tr = pl_color_repr_decode(&conv_repr, NULL);
+    REQUIRE(pl_convert_planes(ctx, &conv, conv_src, conv_dst, CONV_W, CONV_H));
+    REQUIRE(pl_convert_planes(ctx, &conv, conv_src, conv_dst16, CONV_W, CONV_H));
+    for (int row = 0; row < CONV_H; row++) {
+        for (int col = 0; col < CONV_W; col++) {
+            float px[3] = { ycbcr[0][row][col], ycbcr[1][row][col], ycbcr[2][row][col] };
+            pl_transform3x3_apply(&conv_tr, px);
+            for (int c = 0; c < 3; c++) {
+                REQUIRE(fabs(rgb[c][row][col] - px[c]) < 1e-5);
+                float clamped = PL_MIN(PL_MAX(px[c], 0.0), 1.0);
+                REQUIRE(fabs(rgb16[c][row][col] / 65535.0 - clamped) < 1e-4);
+            }
+        }
+    }
+
+    // Round-trip through linear light
+    for (int c = 0; c < 3; c++)
+        conv_src[c].data = rgb[c];
+    conv.repr = pc_repr;
+    conv.repr.bits = (struct pl_bit_encoding) {0};
+    conv.src = conv.dst = pl_color_space_srgb;
+    conv.dst.transfer = PL_COLOR_TRC_LINEAR;
+    static float rgb_orig[3][CONV_H][CONV_W];
+    for (int c = 0; c < 3; c++) {
+        for (int row = 0; row < CONV_H; row++) {
+            for (int col = 0; col < CONV_W; col++)
+                rgb[c][row][col] = rgb_orig[c][row][col] = RANDOM;
+        }
+    }
+
+    REQUIRE(pl_convert_planes(ctx, &conv, conv_src, conv_dst, CONV_W, CONV_H));
+    REQUIRE(fabs(rgb[0][0][0] - powf((rgb_orig[0][0][0] + 0.055) / 1.055, 2.4)) < 1e-4 ||
+            rgb_orig[0][0][0] <= 0.04045);
+    conv.src = conv.dst;
+    conv.dst.transfer = PL_COLOR_TRC_SRGB;
+    REQUIRE(pl_convert_planes(ctx, &conv, conv_src, conv_dst, CONV_W, CONV_H));
+    for (int c = 0; c < 3; c++) {
+        for (int row = 0; row < CONV_H; row++) {
+            for (int col = 0; col < CONV_W; col++)
+                REQUIRE(fabs(rgb[c][row][col] - rgb_orig[c][row][col]) < 1e-4);
+        }
+    }
+
+    // Tone mapping must not depend on the number of threads
+    static float hdr[3][CONV_H][CONV_W];
+    memcpy(hdr, rgb_orig, sizeof(hdr));
+    for (int c = 0; c < 3; c++)
+        conv_src[c].data = hdr[c];
+    conv.src = pl_color_space_hdr10;
+    conv.dst = pl_color_space_bt709;
+    conv.threads = 1;
+    REQUIRE(pl_convert_planes(ctx, &conv, conv_src, conv_dst, CONV_W, CONV_H));
+    memcpy(rgb_orig, rgb, sizeof(rgb));
+    conv.threads = 3;
+    REQUIRE(pl_convert_planes(ctx, &conv, conv_src, conv_dst, CONV_W, CONV_H));
+    REQUIRE(memcmp(rgb, rgb_orig, sizeof(rgb)) == 0);
+    for (int c = 0; c < 3; c++) {
+        for (int row = 0; row < CONV_H; row++) {
+            for (int col = 0; col < CONV_W; col++)
+                REQUIRE(isfinite(rgb[c][row][col]) && rgb[c][row][col] >= 0.0);
+        }
+    }
+
+    pl_context_destroy(&ctx);
 }
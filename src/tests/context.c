@@ -1,14 +1,103 @@
 #include "tests.h"
+#include "context.h"
+
+#include <pthread.h>
 
 static int irand()
 {
     return rand() - RAND_MAX / 2;
 }
 
+struct log_state {
+    pthread_t caller;
+    int count;
+    int dropped;
+    int last;
+    bool ordered;
+    bool async;
+};
+
+static void log_cb(void *priv, enum pl_log_level lev, const char *msg)
+{
+    struct log_state *st = priv;
+    int num;
+    if (lev == PL_LOG_WARN && sscanf(msg, "Dropped %d", &num) == 1) {
+        st->dropped += num;
+        return;
+    }
+
+    num = atoi(msg);
+    st->ordered &= num > st->last;
+    st->last = num;
+    st->async &= !pthread_equal(pthread_self(), st->caller);
+    st->count++;
+}
+
+static int expensive_calls;
+
+static int expensive(void)
+{
+    return ++expensive_calls;
+}
+
 int main()
 {
     struct pl_context *ctx = pl_test_context();
     pl_context_update(ctx, NULL);
+
+    // Filtered messages must not evaluate their arguments
+    pl_trace(ctx, "%d", expensive());
+    REQUIRE(expensive_calls == 0);
+
+    // Asynchronous logging, including an overflowing queue
+    struct log_state st = {
+        .caller = pthread_self(),
+        .last = -1,
+        .ordered = true,
+        .async = true,
+    };
+
+    pl_context_update(ctx, &(struct pl_context_params) {
+        .log_cb    = log_cb,
+        .log_priv  = &st,
+        .log_level = PL_LOG_INFO,
+        .log_async = true,
+    });
+
+    const int num_msgs = 10000;
+    pl_debug(ctx, "%d", expensive());
+    for (int i = 0; i < num_msgs; i++)
+        pl_info(ctx, "%d", i);
+    pl_context_update(ctx, NULL);
+    REQUIRE(expensive_calls == 0);
+    REQUIRE(st.count + st.dropped == num_msgs);
+    REQUIRE(st.count > 0);
+    REQUIRE(st.ordered);
+    REQUIRE(st.async);
+
+    // Tracing, with spans outside of the trace being ignored
+    REQUIRE(!pl_span_end(ctx, "ignored", pl_span_begin(ctx)));
+    pl_context_trace_start(ctx);
+    uint64_t start = pl_span_begin(ctx);
+    REQUIRE(start);
+    REQUIRE(pl_span_end(ctx, "cpu span", start) >= start);
+    pl_span_add(ctx, "gpu track", "gpu span", start, start + 1000);
+
+    FILE *f = tmpfile();
+    REQUIRE(f);
+    REQUIRE(pl_context_trace_stop(ctx, f));
+    pl_span_add(ctx, "gpu track", "ignored", start, start + 1000);
+
+    char buf[4096] = {0};
+    rewind(f);
+    REQUIRE(fread(buf, 1, sizeof(buf) - 1, f) > 0);
+    fclose(f);
+    REQUIRE(strstr(buf, "\"traceEvents\""));
+    REQUIRE(strstr(buf, "{\"name\":\"cpu span\",\"ph\":\"X\""));
+    REQUIRE(strstr(buf, "{\"name\":\"gpu span\",\"ph\":\"X\""));
+    REQUIRE(strstr(buf, "{\"name\":\"thread_name\",\"ph\":\"M\""));
+    REQUIRE(strstr(buf, "\"args\":{\"name\":\"gpu track\"}"));
+    REQUIRE(!strstr(buf, "ignored"));
     pl_context_destroy(&ctx);
 
     // Test some misc helper functions
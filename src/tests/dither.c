@@ -1,4 +1,5 @@
 #include "tests.h"
+#include "dither.h"
 
 #define SHIFT 4
 #define SIZE (1 << SHIFT)
@@ -21,4 +22,25 @@ int main()
             printf(" %3d", (int)(data[y][x] * SIZE * SIZE));
         printf("\n");
     }
+
+    // Every value must occur exactly once, both for generated matrices and
+    // for the precomputed one
+    static float noise[64 * 64];
+    for (int size = 16; size <= 64; size *= 4) {
+        pl_generate_blue_noise(noise, size);
+        static bool seen[64 * 64];
+        memset(seen, 0, sizeof(seen));
+        for (int i = 0; i < size * size; i++) {
+            int v = noise[i] * size * size;
+            REQUIRE(v >= 0 && v < size * size && !seen[v]);
+            seen[v] = true;
+        }
+    }
+
+    // The precomputed matrix must match what the generator produces
+    static float ref[64 * 64];
+    pl_generate_blue_noise(noise, 64);
+    pl_compute_blue_noise(ref, 64);
+    for (int i = 0; i < 64 * 64; i++)
+        REQUIRE(noise[i] == ref[i]);
 }
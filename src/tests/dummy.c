@@ -5,6 +5,7 @@ int main()
     struct pl_context *ctx = pl_test_context();
     const struct pl_gpu *gpu = pl_gpu_dummy_create(ctx, NULL);
     pl_texture_tests(gpu);
+    pl_upload_tests(gpu);
 
     // Attempt creating a shader and accessing the resulting LUT
     const struct pl_tex *dummy = pl_tex_dummy_create(gpu, &(struct pl_tex_params) {
@@ -51,5 +52,180 @@ int main()
     pl_shader_obj_destroy(&lut);
     pl_tex_destroy(gpu, &dummy);
     pl_gpu_dummy_destroy(&gpu);
+
+    // Run the renderer against a dummy GPU accepting passes, and make sure
+    // all of the submitted work gets accounted for
+    struct pl_gpu_dummy_params params = pl_gpu_dummy_default_params;
+    params.accept_passes = true;
+    gpu = pl_gpu_dummy_create(ctx, &params);
+
+    static uint8_t pixels[64 * 64 * 4];
+    const struct pl_plane_data plane_data = {
+        .type = PL_FMT_UNORM,
+        .width = 64,
+        .height = 64,
+        .component_size = {8, 8, 8, 8},
+        .component_map = {0, 1, 2, 3},
+        .pixel_stride = 4,
+        .pixels = pixels,
+    };
+
+    struct pl_plane plane;
+    const struct pl_tex *tex = NULL;
+    REQUIRE(pl_upload_plane(gpu, &plane, &tex, &plane_data));
+
+    const struct pl_tex *fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 128,
+        .h = 128,
+        .format = pl_find_named_fmt(gpu, "rgba8"),
+        .renderable = true,
+        .storable = true,
+        .host_readable = true,
+    });
+    REQUIRE(fbo);
+
+    struct pl_gpu_dummy_stats stats;
+    pl_gpu_dummy_get_stats(gpu, &stats);
+    REQUIRE(stats.tex_uploads == 1);
+    REQUIRE(stats.bytes_uploaded == sizeof(pixels));
+
+    // Packed layouts without any matching texture format get unpacked by a
+    // compute shader instead
+    struct pl_dispatch *dp = pl_dispatch_create(ctx, gpu);
+    struct pl_plane unpacked_plane;
+    const struct pl_tex *unpacked = NULL;
+    REQUIRE(pl_upload_plane_compute(gpu, dp, &unpacked_plane, &unpacked,
+        &(struct pl_plane_data) {
+            .type           = PL_FMT_UNORM,
+            .width          = 64,
+            .height         = 64,
+            .pixel_stride   = sizeof(uint32_t),
+            .component_size = {10, 10, 10},
+            .component_pad  = {2, 0, 0},
+            .component_map  = {0, 1, 2},
+            .pixels         = pixels,
+    }));
+    REQUIRE(unpacked_plane.components == 3);
+    pl_gpu_dummy_get_stats(gpu, &stats);
+    REQUIRE(stats.pass_runs == 1);
+    pl_tex_destroy(gpu, &unpacked);
+
+    // Truncated or empty cache blobs must be ignored without reading past
+    // the end of the buffer
+    size_t cache_size = pl_dispatch_save(dp, NULL);
+    uint8_t *cache = malloc(cache_size);
+    REQUIRE(cache);
+    REQUIRE(pl_dispatch_save(dp, cache) == cache_size);
+    pl_dispatch_load(dp, cache, 0);
+    pl_dispatch_load(dp, cache, cache_size - 1);
+    pl_dispatch_load(dp, cache, cache_size);
+    REQUIRE(pl_dispatch_save(dp, NULL) == cache_size);
+    free(cache);
+    pl_dispatch_destroy(&dp);
+    pl_gpu_dummy_reset_stats(gpu);
+
+    struct pl_renderer *rr = pl_renderer_create(ctx, gpu);
+    struct pl_image image = {
+        .num_planes = 1,
+        .planes     = { plane },
+        .repr       = pl_color_repr_rgb,
+        .color      = pl_color_space_srgb,
+        .width      = 64,
+        .height     = 64,
+    };
+
+    struct pl_render_target target = {
+        .fbo        = fbo,
+        .repr       = pl_color_repr_rgb,
+        .color      = pl_color_space_srgb,
+    };
+
+    REQUIRE(pl_render_image(rr, &image, &target, &pl_render_default_params));
+    pl_gpu_dummy_get_stats(gpu, &stats);
+    REQUIRE(stats.pass_creates > 0);
+    REQUIRE(stats.pass_runs >= stats.pass_creates);
+    REQUIRE(stats.desc_bindings > 0);
+    printf("dummy render: %"PRIu64" passes created, %"PRIu64" runs, "
+           "%"PRIu64" descriptors, %"PRIu64" var updates\n", stats.pass_creates,
+           stats.pass_runs, stats.desc_bindings, stats.var_updates);
+
+    // Re-rendering must re-use all of the passes
+    pl_gpu_dummy_reset_stats(gpu);
+    REQUIRE(pl_render_image(rr, &image, &target, &pl_render_default_params));
+    pl_gpu_dummy_get_stats(gpu, &stats);
+    REQUIRE(stats.pass_creates == 0);
+    REQUIRE(stats.pass_runs > 0);
+
+    struct pl_gpu_stats gstats;
+    REQUIRE(pl_gpu_stats(gpu, &gstats));
+    REQUIRE(gstats.passes_created == 0);
+    REQUIRE(gstats.pass_runs == stats.pass_runs);
+    REQUIRE(gstats.desc_updates == stats.desc_bindings);
+
+    // Small changes to the output size must not reallocate any intermediate
+    // textures (here: between the two passes of the separable upscaler,
+    // since the target is not storable), nor recompile any passes
+    const struct pl_tex *fbo2 = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 128,
+        .h = 128,
+        .format = pl_find_named_fmt(gpu, "rgba8"),
+        .renderable = true,
+    });
+    REQUIRE(fbo2);
+
+    target.fbo = fbo2;
+    target.dst_rect = (struct pl_rect2d) { 0, 0, 100, 100 };
+    REQUIRE(pl_render_image(rr, &image, &target, &pl_render_default_params));
+    for (int i = 0; i < 8; i++) {
+        pl_gpu_dummy_reset_stats(gpu);
+        target.dst_rect.x1 = target.dst_rect.y1 = 101 + i;
+        REQUIRE(pl_render_image(rr, &image, &target, &pl_render_default_params));
+        pl_gpu_dummy_get_stats(gpu, &stats);
+        REQUIRE(stats.tex_creates == 0);
+        REQUIRE(stats.pass_creates == 0);
+        REQUIRE(stats.bytes_uploaded == 0); // no vertex data either
+    }
+
+    // Tone mapping involves compile-time constants (e.g. the luma
+    // coefficients), which have to be hard-coded into the shader as literals
+    // on GPUs without specialization constants
+    image.color = pl_color_space_bt2020_hlg;
+    REQUIRE(pl_render_image(rr, &image, &target, &pl_render_default_params));
+    target.fbo = fbo;
+    REQUIRE(pl_render_image(rr, &image, &target, &pl_render_default_params));
+
+    pl_renderer_destroy(&rr);
+    pl_tex_destroy(gpu, &fbo2);
+    pl_tex_destroy(gpu, &fbo);
+    pl_tex_destroy(gpu, &tex);
+    pl_gpu_dummy_destroy(&gpu);
+
+    // Sampled textures are read from the global texture heap on GPUs with
+    // support for bindless textures
+    params.caps |= PL_GPU_CAP_BINDLESS;
+    params.limits.max_bindless_tex = 1024;
+    gpu = pl_gpu_dummy_create(ctx, &params);
+    REQUIRE(pl_upload_plane(gpu, &plane, &tex, &plane_data));
+    REQUIRE(tex->bindless_index);
+    image.planes[0] = plane;
+    image.color = pl_color_space_srgb;
+
+    fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 128,
+        .h = 128,
+        .format = pl_find_named_fmt(gpu, "rgba8"),
+        .renderable = true,
+    });
+    REQUIRE(fbo);
+
+    rr = pl_renderer_create(ctx, gpu);
+    target.fbo = fbo;
+    target.dst_rect = (struct pl_rect2d) {0};
+    REQUIRE(pl_render_image(rr, &image, &target, &pl_render_default_params));
+
+    pl_renderer_destroy(&rr);
+    pl_tex_destroy(gpu, &fbo);
+    pl_tex_destroy(gpu, &tex);
+    pl_gpu_dummy_destroy(&gpu);
     pl_context_destroy(&ctx);
 }
@@ -33,7 +33,17 @@ int main()
             }
         }
 
+        // Identical filters should be shared, and survive freeing the other
+        const struct pl_filter *dup = pl_filter_generate(ctx, &params);
+        REQUIRE(dup == flt);
         pl_filter_free(&flt);
+        REQUIRE(!flt);
+        params.lut_entries = 64;
+        flt = pl_filter_generate(ctx, &params);
+        REQUIRE(flt && flt != dup);
+        pl_filter_free(&flt);
+        pl_filter_free(&dup);
     }
+
     pl_context_destroy(&ctx);
 }
@@ -1,6 +1,11 @@
 #include "tests.h"
 #include "shaders.h"
 
+static void pl_test_download_done(void *priv)
+{
+    *(bool *) priv = true;
+}
+
 static void pl_test_roundtrip(const struct pl_gpu *gpu, const struct pl_tex *tex,
                               uint8_t *src, uint8_t *dst)
 {
@@ -36,6 +41,22 @@ static void pl_test_roundtrip(const struct pl_gpu *gpu, const struct pl_tex *tex
     } else {
         REQUIRE(memcmp(src, dst, bytes) == 0);
     }
+
+    // Repeat the download asynchronously
+    bool done = false;
+    uint8_t *dst2 = malloc(bytes);
+    REQUIRE(dst2);
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params){
+        .tex = tex,
+        .ptr = dst2,
+        .callback = pl_test_download_done,
+        .priv = &done,
+    }));
+
+    pl_gpu_finish(gpu);
+    REQUIRE(done);
+    REQUIRE(memcmp(dst, dst2, bytes) == 0);
+    free(dst2);
 }
 
 static uint8_t test_src[16*16*16 * 4 * sizeof(double)] = {0};
@@ -82,6 +103,229 @@ static void pl_texture_tests(const struct pl_gpu *gpu)
     }
 }
 
+static void pl_planar_tests(const struct pl_gpu *gpu)
+{
+    for (int i = 0; i < gpu->num_formats; i++) {
+        const struct pl_fmt *fmt = gpu->formats[i];
+        if (!fmt->num_planes)
+            continue;
+
+        printf("testing planar texture roundtrip for format %s\n", fmt->name);
+        const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .w = 16,
+            .h = 16,
+            .format = fmt,
+            .sampleable = true,
+            .host_writable = true,
+            .host_readable = true,
+        });
+
+        REQUIRE(tex);
+        REQUIRE(tex->num_planes == fmt->num_planes);
+
+        size_t bytes = 0, plane_offset = 0, plane_size = 0;
+        for (int p = 0; p < tex->num_planes; p++) {
+            const struct pl_tex *plane = tex->planes[p];
+            REQUIRE(plane->params.w == 16 >> fmt->planes[p].shift_x);
+            REQUIRE(plane->params.h == 16 >> fmt->planes[p].shift_y);
+            size_t size = plane->params.w * plane->params.h *
+                          plane->params.format->texel_size;
+            if (p == 1) {
+                plane_offset = bytes;
+                plane_size = size;
+            }
+            bytes += size;
+        }
+
+        for (size_t n = 0; n < bytes; n++)
+            test_src[n] = RANDOM * 256;
+        memset(test_dst, 0, bytes);
+
+        // Upload all planes at once, and read them back individually as well
+        REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+            .tex = tex,
+            .ptr = test_src,
+        }));
+
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = tex,
+            .ptr = test_dst,
+        }));
+        REQUIRE(memcmp(test_src, test_dst, bytes) == 0);
+
+        memset(test_dst, 0, bytes);
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = tex->planes[1],
+            .ptr = test_dst,
+        }));
+        REQUIRE(memcmp(test_src + plane_offset, test_dst, plane_size) == 0);
+
+        pl_tex_destroy(gpu, &tex);
+    }
+}
+
+static void pl_upload_tests(const struct pl_gpu *gpu)
+{
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 1, 8, 8,
+                                           PL_FMT_CAP_SAMPLEABLE);
+    if (!fmt)
+        return;
+
+    // Pre-create the texture to be able to read it back afterwards
+    const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 16,
+        .h = 16,
+        .format = fmt,
+        .sampleable = true,
+        .host_writable = true,
+        .host_readable = true,
+        .blit_src = !!(fmt->caps & PL_FMT_CAP_BLITTABLE),
+        .address_mode = PL_TEX_ADDRESS_CLAMP,
+        .sample_mode = (fmt->caps & PL_FMT_CAP_LINEAR)
+                            ? PL_TEX_SAMPLE_LINEAR
+                            : PL_TEX_SAMPLE_NEAREST,
+    });
+    REQUIRE(tex);
+
+    static uint8_t ref[16 * 16], src[16 * 16], dst[16 * 16];
+    for (int n = 0; n < sizeof(ref); n++)
+        ref[n] = RANDOM * 256;
+    REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = ref,
+    }));
+
+    // Only the damaged regions should make it into the texture
+    const struct pl_rect2d rects[] = {
+        {1, 2, 4, 5},
+        {15, 16, 10, 12}, // flipped
+        {-4, -4, 2, 1},   // partially out of bounds
+        {20, 20, 24, 24}, // fully out of bounds
+    };
+
+    for (int n = 0; n < sizeof(src); n++)
+        src[n] = RANDOM * 256;
+    REQUIRE(pl_upload_plane(gpu, NULL, &tex, &(struct pl_plane_data) {
+        .type = PL_FMT_UNORM,
+        .width = 16,
+        .height = 16,
+        .pixel_stride = 1,
+        .component_size = {8},
+        .component_map = {0},
+        .pixels = src,
+        .rects = rects,
+        .num_rects = PL_ARRAY_SIZE(rects),
+    }));
+
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = dst,
+    }));
+
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            bool damaged = false;
+            for (int i = 0; i < PL_ARRAY_SIZE(rects); i++) {
+                struct pl_rect2d rc = rects[i];
+                pl_rect2d_normalize(&rc);
+                damaged |= x >= rc.x0 && x < rc.x1 && y >= rc.y0 && y < rc.y1;
+            }
+            REQUIRE(dst[y * 16 + x] == (damaged ? src : ref)[y * 16 + x]);
+        }
+    }
+
+    pl_tex_destroy(gpu, &tex);
+
+    // Upload a subsampled three-plane image in one go
+    static uint8_t planes[3][16 * 16], planes_dst[16 * 16];
+    const struct pl_tex *ptex[3] = {0};
+    struct pl_plane_data pdata[3];
+    for (int i = 0; i < 3; i++) {
+        int w = i ? 8 : 16, h = i ? 8 : 16;
+        for (int n = 0; n < w * h; n++)
+            planes[i][n] = RANDOM * 256;
+        pdata[i] = (struct pl_plane_data) {
+            .type = PL_FMT_UNORM,
+            .width = w,
+            .height = h,
+            .pixel_stride = 1,
+            .component_size = {8},
+            .component_map = {i},
+            .pixels = planes[i],
+        };
+
+        // Pre-create the textures to be able to read them back afterwards
+        ptex[i] = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .w = w,
+            .h = h,
+            .format = fmt,
+            .sampleable = true,
+            .host_writable = true,
+            .host_readable = true,
+            .blit_src = !!(fmt->caps & PL_FMT_CAP_BLITTABLE),
+            .address_mode = PL_TEX_ADDRESS_CLAMP,
+            .sample_mode = (fmt->caps & PL_FMT_CAP_LINEAR)
+                                ? PL_TEX_SAMPLE_LINEAR
+                                : PL_TEX_SAMPLE_NEAREST,
+        });
+        REQUIRE(ptex[i]);
+    }
+
+    struct pl_plane out_planes[3];
+    REQUIRE(pl_upload_planes(gpu, out_planes, ptex, pdata, 3));
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(out_planes[i].texture == ptex[i]);
+        REQUIRE(out_planes[i].component_mapping[0] == i);
+        REQUIRE(ptex[i]->params.w == pdata[i].width);
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = ptex[i],
+            .ptr = planes_dst,
+        }));
+        REQUIRE(memcmp(planes_dst, planes[i], pdata[i].width * pdata[i].height) == 0);
+    }
+
+    // Upload directly from regions of an upload ring, wrapping around it
+    // a few times
+    struct pl_upload_ring *ring = NULL;
+    if (gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS) {
+        ring = pl_upload_ring_create(gpu, &(struct pl_upload_ring_params) {
+            .chunk_size = 2 * sizeof(src) + 1,
+            .num_chunks = 2,
+        });
+        REQUIRE(ring);
+    }
+
+    for (int n = 0; ring && n < 8; n++) {
+        struct pl_upload_region region;
+        REQUIRE(pl_upload_ring_get(ring, &region, sizeof(src), 1));
+        REQUIRE(region.offset % 4 == 0);
+        REQUIRE(region.offset + sizeof(src) <= region.buf->params.size);
+        for (int i = 0; i < sizeof(src); i++)
+            region.data[i] = src[i] = RANDOM * 256;
+
+        REQUIRE(pl_upload_plane(gpu, NULL, &ptex[0], &(struct pl_plane_data) {
+            .type = PL_FMT_UNORM,
+            .width = 16,
+            .height = 16,
+            .pixel_stride = 1,
+            .component_size = {8},
+            .component_map = {0},
+            .buf = region.buf,
+            .buf_offset = region.offset,
+        }));
+
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = ptex[0],
+            .ptr = dst,
+        }));
+        REQUIRE(memcmp(src, dst, sizeof(src)) == 0);
+    }
+
+    pl_upload_ring_destroy(&ring);
+    for (int i = 0; i < 3; i++)
+        pl_tex_destroy(gpu, &ptex[i]);
+}
+
 static void pl_shader_tests(const struct pl_gpu *gpu)
 {
     if (gpu->glsl.version < 410)
@@ -247,6 +491,179 @@ static void pl_shader_tests(const struct pl_gpu *gpu)
         }
     }
 
+    // Test that the compute shader debanding matches the normal version
+    if (fbo->params.storable) {
+        static float ref[FBO_H * FBO_W * 4];
+        const struct pl_deband_params dparams = {
+            .iterations = 2,
+            .radius     = 4.0,
+            .threshold  = 1000.0, // always pick the average
+        };
+
+        const struct pl_sample_src dsrc = { .tex = src };
+        struct pl_shader *sh = pl_dispatch_begin(dp);
+        if (pl_shader_deband_compute(sh, &dsrc, &dparams)) {
+            REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+            REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+                .tex = fbo,
+                .ptr = data,
+            }));
+
+            sh = pl_dispatch_begin(dp);
+            pl_shader_deband(sh, &dsrc, &dparams);
+            REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+            REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+                .tex = fbo,
+                .ptr = ref,
+            }));
+
+            for (int i = 0; i < FBO_H * FBO_W * 4; i++)
+                REQUIRE(fabs(data[i] - ref[i]) < 1e-2);
+        } else {
+            pl_dispatch_abort(dp, &sh);
+        }
+    }
+
+    // Test unpacking a packed 10-bit format with the padding bits in front,
+    // which doesn't directly match any texture format
+    if (gpu->caps & PL_GPU_CAP_COMPUTE) {
+        static uint32_t packed[FBO_H * FBO_W];
+        for (int y = 0; y < FBO_H; y++) {
+            for (int x = 0; x < FBO_W; x++) {
+                uint32_t r = x * 1023 / (FBO_W - 1), g = y * 1023 / (FBO_H - 1);
+                packed[y * FBO_W + x] = 0x3 | r << 2 | g << 12 | 512u << 22;
+            }
+        }
+
+        const struct pl_tex *unpacked = NULL;
+        struct pl_plane plane;
+        REQUIRE(pl_upload_plane_compute(gpu, dp, &plane, &unpacked,
+            &(struct pl_plane_data) {
+                .type           = PL_FMT_UNORM,
+                .width          = FBO_W,
+                .height         = FBO_H,
+                .pixel_stride   = sizeof(uint32_t),
+                .component_size = {10, 10, 10},
+                .component_pad  = {2, 0, 0},
+                .component_map  = {0, 1, 2},
+                .pixels         = packed,
+        }));
+        REQUIRE(plane.components == 3);
+
+        struct pl_shader *sh = pl_dispatch_begin(dp);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = unpacked });
+        REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = fbo,
+            .ptr = data,
+        }));
+
+        for (int y = 0; y < FBO_H; y++) {
+            for (int x = 0; x < FBO_W; x++) {
+                float *color = &data[(y * FBO_W + x) * 4];
+                REQUIRE(fabs(color[0] - (x * 1023 / (FBO_W - 1)) / 1023.0) < 1e-3);
+                REQUIRE(fabs(color[1] - (y * 1023 / (FBO_H - 1)) / 1023.0) < 1e-3);
+                REQUIRE(fabs(color[2] - 512 / 1023.0) < 1e-3);
+            }
+        }
+
+        pl_tex_destroy(gpu, &unpacked);
+    }
+
+    // Test the pass cache eviction by alternating between more distinct
+    // shaders than the cache has room for
+    struct pl_dispatch *dp_small = pl_dispatch_create_ex(gpu->ctx, gpu,
+        &(struct pl_dispatch_params) {
+            .max_passes = 2,
+        });
+
+    for (int i = 0; i < 9; i++) {
+        struct pl_shader *sh = pl_dispatch_begin(dp_small);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+        pl_shader_linearize(sh, (enum pl_color_transfer[]) {
+            PL_COLOR_TRC_GAMMA22, PL_COLOR_TRC_PQ, PL_COLOR_TRC_HLG,
+        }[i % 3]);
+        REQUIRE(pl_dispatch_finish(dp_small, &sh, fbo, NULL, NULL));
+    }
+
+    pl_dispatch_destroy(&dp_small);
+
+    // Test asynchronous compilation, by retrying until the pass is ready
+    struct pl_dispatch *dp_async = pl_dispatch_create_ex(gpu->ctx, gpu,
+        &(struct pl_dispatch_params) {
+            .async_compile = true,
+        });
+
+    bool async_ok = false;
+    for (int i = 0; i < 1000 && !async_ok; i++) {
+        struct pl_shader *sh = pl_dispatch_begin(dp_async);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+        pl_shader_delinearize(sh, PL_COLOR_TRC_GAMMA22);
+        async_ok = pl_dispatch_finish(dp_async, &sh, fbo, NULL, NULL);
+        if (!async_ok)
+            usleep(10000);
+    }
+    REQUIRE(async_ok);
+    pl_dispatch_destroy(&dp_async);
+
+    // Test batching a chain of passes
+    pl_dispatch_batch_begin(dp);
+    for (int i = 0; i < 4; i++) {
+        struct pl_shader *sh = pl_dispatch_begin(dp);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+        REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+    }
+    pl_dispatch_batch_end(dp);
+
+    // Test compile-time constants, which must result in distinct passes
+    for (int i = 0; i < 4; i++) {
+        float scale[3] = { 1.0 / (1 + i % 2), 1.0, 1.0 };
+        struct pl_shader *sh = pl_dispatch_begin(dp);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+        GLSL("color.rgb *= %s;\n", sh_var(sh, (struct pl_shader_var) {
+            .var = pl_var_vec3("scale"),
+            .data = scale,
+            .compile_time = true,
+        }));
+        REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+
+        pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = fbo,
+            .ptr = data,
+        });
+
+        for (int y = 0; y < FBO_H; y++) {
+            for (int x = 0; x < FBO_W; x++) {
+                float *color = &data[(y * FBO_W + x) * 4];
+                REQUIRE(feq(color[0], scale[0] * (x + 0.5) / FBO_W));
+            }
+        }
+    }
+
+    // Test per-pass timing, if supported by the GPU
+    struct pl_timer *timer = pl_timer_create(gpu);
+    if (timer) {
+        pl_timer_destroy(gpu, &timer);
+        struct pl_dispatch *dp_timed = pl_dispatch_create_ex(gpu->ctx, gpu,
+            &(struct pl_dispatch_params) {
+                .timing = true,
+            });
+
+        for (int i = 0; i < 4; i++) {
+            struct pl_shader *sh = pl_dispatch_begin(dp_timed);
+            pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+            REQUIRE(pl_dispatch_finish(dp_timed, &sh, fbo, NULL, NULL));
+        }
+
+        pl_gpu_finish(gpu);
+        struct pl_dispatch_timing timing;
+        REQUIRE(pl_dispatch_timings(dp_timed, &timing, 1) == 1);
+        REQUIRE(timing.count == 4);
+        REQUIRE(timing.peak >= timing.average && timing.average > 0);
+        REQUIRE(strcmp(timing.label, "direct sampling") == 0);
+        pl_dispatch_destroy(&dp_timed);
+    }
+
     struct pl_shader *sh;
 
 #if PL_HAVE_LCMS
@@ -265,17 +682,52 @@ static void pl_shader_tests(const struct pl_gpu *gpu)
     }
 
     pl_dispatch_abort(dp, &sh);
+
+    // Test asynchronous generation, which must eventually succeed
+    struct pl_3dlut_params lut_params = pl_3dlut_default_params;
+    lut_params.size_r = lut_params.size_g = lut_params.size_b = 17;
+    lut_params.async = true;
+    for (int i = 0; i < 10000; i++) {
+        sh = pl_dispatch_begin(dp);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+        bool ok = pl_3dlut_update(sh, &src_color, &dst_color, &lut3d, &out,
+                                  &lut_params);
+        if (ok) {
+            pl_3dlut_apply(sh, &lut3d);
+            REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+            break;
+        }
+
+        pl_dispatch_abort(dp, &sh);
+        if (!out.pending)
+            break;
+        usleep(1000);
+    }
+
+    // Test tetrahedral interpolation
+    lut_params.async = false;
+    lut_params.tetrahedral = true;
+    sh = pl_dispatch_begin(dp);
+    pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+    if (pl_3dlut_update(sh, &src_color, &dst_color, &lut3d, &out, &lut_params)) {
+        pl_3dlut_apply(sh, &lut3d);
+        REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+    }
+
+    pl_dispatch_abort(dp, &sh);
+
     pl_shader_obj_destroy(&lut3d);
 #endif
 
     // Test AV1 grain synthesis
     struct pl_shader_obj *grain = NULL;
-    for (int i = 0; i < 2; i++) {
+    uint16_t grain_seed = rand();
+    for (int i = 0; i < 4; i++) {
         struct pl_grain_params grain_params = av1_grain_params;
         grain_params.width = FBO_W;
         grain_params.height = FBO_H;
-        grain_params.grain_seed = rand();
-        grain_params.overlap = !!i;
+        grain_params.grain_seed = i < 2 ? rand() : grain_seed; // test reuse
+        grain_params.overlap = !!(i & 1);
         sh = pl_dispatch_begin(dp);
         pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
         pl_shader_av1_grain(sh, &grain, (enum pl_channel[]){0, 1, 2}, NULL,
@@ -284,11 +736,93 @@ static void pl_shader_tests(const struct pl_gpu *gpu)
     }
     pl_shader_obj_destroy(&grain);
 
+    // Test the serialization of the dispatch cache
+    size_t cache_size = pl_dispatch_save(dp, NULL);
+    uint8_t *cache = malloc(cache_size);
+    REQUIRE(cache);
+    REQUIRE(pl_dispatch_save(dp, cache) == cache_size);
+    pl_dispatch_destroy(&dp);
+
+    dp = pl_dispatch_create(gpu->ctx, gpu);
+    size_t empty_size = pl_dispatch_save(dp, NULL);
+    pl_dispatch_load(dp, cache, 0);
+    pl_dispatch_load(dp, cache, cache_size - 1); // truncated
+    REQUIRE(pl_dispatch_save(dp, NULL) == empty_size);
+    pl_dispatch_load(dp, cache, cache_size);
+    sh = pl_dispatch_begin(dp);
+    pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+    pl_shader_linearize(sh, PL_COLOR_TRC_GAMMA22);
+    REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+    REQUIRE(pl_dispatch_save(dp, NULL) >= cache_size);
+    free(cache);
+
     pl_dispatch_destroy(&dp);
     pl_tex_destroy(gpu, &src);
     pl_tex_destroy(gpu, &fbo);
 }
 
+// Compares `pl_shader_sample_ortho2d` against two `pl_shader_sample_ortho`
+// passes through an intermediate texture. Returns the number of threads per
+// work group used by the former, or 0 if it rejected the configuration.
+static int pl_test_ortho2d(const struct pl_gpu *gpu, struct pl_dispatch *dp,
+                           const struct pl_fmt *tmp_fmt,
+                           const struct pl_sample_src *src,
+                           struct pl_sample_filter_params fparams,
+                           const struct pl_tex *fbo)
+{
+    const struct pl_tex *tmp = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = src->tex->params.w,
+        .h              = fbo->params.h,
+        .format         = tmp_fmt,
+        .renderable     = true,
+        .sampleable     = true,
+        .sample_mode    = PL_TEX_SAMPLE_LINEAR,
+        .address_mode   = PL_TEX_ADDRESS_CLAMP,
+    });
+    REQUIRE(tmp);
+
+    struct pl_shader *sh = pl_dispatch_begin(dp);
+    fparams.no_compute = true;
+    REQUIRE(pl_shader_sample_ortho(sh, PL_SEP_VERT, src, &fparams));
+    REQUIRE(pl_dispatch_finish(dp, &sh, tmp, NULL, NULL));
+
+    struct pl_sample_src src2 = *src;
+    src2.tex = tmp;
+    sh = pl_dispatch_begin(dp);
+    REQUIRE(pl_shader_sample_ortho(sh, PL_SEP_HORIZ, &src2, &fparams));
+    REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+
+    size_t size = fbo->params.w * fbo->params.h * sizeof(float);
+    float *ref_data = malloc(size), *fused_data = malloc(size);
+    REQUIRE(ref_data && fused_data);
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex            = fbo,
+        .ptr            = ref_data,
+    }));
+
+    int threads = 0;
+    sh = pl_dispatch_begin(dp);
+    fparams.no_compute = false;
+    if (pl_shader_sample_ortho2d(sh, src, &fparams)) {
+        threads = sh->res.compute_group_size[0] * sh->res.compute_group_size[1];
+        REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex            = fbo,
+            .ptr            = fused_data,
+        }));
+
+        for (int i = 0; i < fbo->params.w * fbo->params.h; i++)
+            REQUIRE(fabs(fused_data[i] - ref_data[i]) < 1e-2);
+    } else {
+        pl_dispatch_abort(dp, &sh);
+    }
+
+    free(ref_data);
+    free(fused_data);
+    pl_tex_destroy(gpu, &tmp);
+    return threads;
+}
+
 static void pl_scaler_tests(const struct pl_gpu *gpu)
 {
     const struct pl_fmt *src_fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 1, 16, 32,
@@ -364,6 +898,125 @@ static void pl_scaler_tests(const struct pl_gpu *gpu)
         printf("\n");
     }
 
+    // Test that polar scaling by a rational ratio (which uses precomputed
+    // per-phase weights) preserves flat areas
+    static float flat_5x5[5][5];
+    for (int y = 0; y < 5; y++) {
+        for (int x = 0; x < 5; x++)
+            flat_5x5[y][x] = 0.5;
+    }
+
+    const struct pl_tex *flat = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = 5,
+        .h              = 5,
+        .format         = src_fmt,
+        .sampleable     = true,
+        .sample_mode    = PL_TEX_SAMPLE_LINEAR,
+        .address_mode   = PL_TEX_ADDRESS_CLAMP,
+        .initial_data   = &flat_5x5[0][0],
+    });
+    REQUIRE(flat);
+
+    for (int i = 0; i < 2; i++) {
+        // 2.0x resp. 1.5x upscaling
+        const int size = i ? 4 : 5, scaled = i ? 6 : 10;
+        sh = pl_dispatch_begin(dp);
+        REQUIRE(pl_shader_sample_polar(sh,
+            &(struct pl_sample_src) {
+                .tex        = flat,
+                .rect       = { 0.5, 0.5, 0.5 + size, 0.5 + size },
+                .new_w      = scaled,
+                .new_h      = scaled,
+            },
+            &(struct pl_sample_filter_params) {
+                .filter     = pl_filter_ewa_lanczos,
+                .lut        = &lut,
+                .no_compute = !fbo->params.storable,
+            }
+        ));
+
+        // Render into the top left corner of the FBO
+        REQUIRE(pl_dispatch_finish(dp, &sh, fbo, &(struct pl_rect2d) {
+            0, 0, scaled, scaled,
+        }, NULL));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex            = fbo,
+            .ptr            = fbo_data,
+        }));
+
+        for (int y = 0; y < scaled; y++) {
+            for (int x = 0; x < scaled; x++)
+                REQUIRE(fabs(fbo_data[y * fbo->params.w + x] - 0.5) < 1e-3);
+        }
+    }
+
+    pl_tex_destroy(gpu, &flat);
+
+    // Test that nearest neighbour sampling doesn't interpolate, even though
+    // the source texture uses linear sampling
+    sh = pl_dispatch_begin(dp);
+    REQUIRE(pl_shader_sample_nearest(sh, &(struct pl_sample_src) {
+        .tex        = dot5x5,
+        .new_w      = fbo->params.w,
+        .new_h      = fbo->params.h,
+    }));
+    REQUIRE(pl_dispatch_finish(dp, &sh, fbo, NULL, NULL));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex            = fbo,
+        .ptr            = fbo_data,
+    }));
+
+    for (int y = 0; y < fbo->params.h; y++) {
+        for (int x = 0; x < fbo->params.w; x++) {
+            float ref = data_5x5[y * 5 / fbo->params.h][x * 5 / fbo->params.w];
+            REQUIRE(fabs(fbo_data[y * fbo->params.w + x] - ref) < 1e-6);
+        }
+    }
+
+    // Test that single-pass orthogonal scaling matches the two-pass version
+    const struct pl_fmt *tmp_fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 1, 16, 32,
+                                               PL_FMT_CAP_RENDERABLE |
+                                               PL_FMT_CAP_LINEAR);
+    if (fbo->params.storable && tmp_fmt) {
+        struct pl_sample_src src = {
+            .tex        = dot5x5,
+            .new_w      = fbo->params.w,
+            .new_h      = fbo->params.h,
+        };
+
+        struct pl_sample_filter_params fparams = {
+            .filter     = pl_filter_spline36,
+            .lut        = &lut,
+        };
+
+        pl_test_ortho2d(gpu, dp, tmp_fmt, &src, fparams, fbo);
+
+        // Strong downscaling never fits the tile for the full 32x8 work group
+        // into shmem, which exercises the smaller block sizes
+        const int big_w = 8 * fbo->params.w, big_h = 8 * fbo->params.h;
+        float *noise = malloc(big_w * big_h * sizeof(float));
+        REQUIRE(noise);
+        for (int i = 0; i < big_w * big_h; i++)
+            noise[i] = RANDOM;
+
+        const struct pl_tex *big = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .w              = big_w,
+            .h              = big_h,
+            .format         = src_fmt,
+            .sampleable     = true,
+            .sample_mode    = PL_TEX_SAMPLE_LINEAR,
+            .address_mode   = PL_TEX_ADDRESS_CLAMP,
+            .initial_data   = noise,
+        });
+        free(noise);
+        REQUIRE(big);
+
+        src.tex = big;
+        int threads = pl_test_ortho2d(gpu, dp, tmp_fmt, &src, fparams, fbo);
+        REQUIRE(threads < 32 * 8);
+        pl_tex_destroy(gpu, &big);
+    }
+
 error:
     free(fbo_data);
     pl_shader_obj_destroy(&lut);
@@ -488,6 +1141,9 @@ static void pl_render_tests(const struct pl_gpu *gpu)
     TEST_PARAMS(color_map, intent, PL_INTENT_ABSOLUTE_COLORIMETRIC);
     TEST_PARAMS(color_map, gamut_warning, 1);
     TEST_PARAMS(dither, method, PL_DITHER_WHITE_NOISE);
+    struct pl_dither_params temporal_dither = pl_dither_default_params;
+    temporal_dither.temporal = true;
+    TEST(dither_params, pl_dither_params, temporal_dither, temporal_frames, 16);
     TEST(cone_params, pl_cone_params, pl_vision_deuteranomaly, strength, 0);
 
     // Test HDR stuff
@@ -495,8 +1151,31 @@ static void pl_render_tests(const struct pl_gpu *gpu)
     target.color.sig_scale = 2.0;
     TEST_PARAMS(color_map, tone_mapping_algo, PL_TONE_MAPPING_LINEAR);
     TEST_PARAMS(color_map, desaturation_strength, 1);
+    TEST_PARAMS(color_map, tone_mapping_lut_size, 256);
     image.color.sig_scale = target.color.sig_scale = 0.0;
 
+    // Test the peak detection histogram, which is read back asynchronously
+    struct pl_render_params hist_params = pl_render_default_params;
+    hist_params.peak_detect_params = &(struct pl_peak_detect_params) {
+        .smoothing_period = 100.0,
+        .histogram_bins = 64,
+    };
+
+    struct pl_image hdr_image = image;
+    hdr_image.color = pl_color_space_hdr10;
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(pl_render_image(rr, &hdr_image, &target, &hist_params));
+        pl_gpu_finish(gpu);
+    }
+
+    struct pl_peak_histogram hist;
+    if (pl_renderer_get_histogram(rr, &hist)) {
+        REQUIRE(hist.frame >= 1 && hist.num_bins == 64);
+        REQUIRE(hist.total > 0);
+        float level = pl_peak_histogram_percentile(&hist, 99.0);
+        REQUIRE(level >= hist.min_level && level <= hist.max_level);
+    }
+
     // Test some misc stuff
     struct pl_render_params params = pl_render_default_params;
     params.color_adjustment = &(struct pl_color_adjustment) {
@@ -508,6 +1187,359 @@ static void pl_render_tests(const struct pl_gpu *gpu)
 
     REQUIRE(pl_render_image(rr, &image, &target, &params));
 
+    // Test 16-bit float arithmetic (if supported)
+    params = pl_render_default_params;
+    params.float16 = true;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+
+    // Test baking the color mapping into a 3DLUT
+    params = pl_render_default_params;
+    params.color_map_3dlut_size = 17;
+    params.peak_detect_params = NULL;
+    REQUIRE(pl_render_image(rr, &hdr_image, &target, &params));
+
+    // Test extreme downscaling, with and without prefiltering
+    struct pl_render_target small = target;
+    small.dst_rect = (struct pl_rect2d) {0, 0, 1, 1};
+    for (int i = 0; i < 2; i++) {
+        params = pl_render_default_params;
+        params.disable_downscaling_prefilter = i;
+        REQUIRE(pl_render_image(rr, &image, &small, &params));
+    }
+
+    // Test that partial re-rendering only touches the damaged region, and
+    // matches a full render inside of it
+    params = pl_render_default_params;
+    params.dither_params = NULL;
+    params.skip_redraw_caching = true;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex            = fbo,
+        .ptr            = fbo_data,
+    }));
+
+    float *damaged_data = malloc(fbo->params.w * fbo->params.h * sizeof(float[4]));
+    struct pl_render_target damaged = target;
+    damaged.damage = (struct pl_rect2d) {10, 12, 20, 30};
+    pl_tex_clear(gpu, fbo, (float[4]){ -1.0, -1.0, -1.0, -1.0 });
+    REQUIRE(pl_render_image(rr, &image, &damaged, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex            = fbo,
+        .ptr            = damaged_data,
+    }));
+
+    for (int y = 0; y < fbo->params.h; y++) {
+        for (int x = 0; x < fbo->params.w; x++) {
+            bool inside = x >= 10 && x < 20 && y >= 12 && y < 30;
+            for (int c = 0; c < 4; c++) {
+                int idx = (y * fbo->params.w + x) * 4 + c;
+                float ref = inside ? fbo_data[idx] : -1.0;
+                REQUIRE(fabs(damaged_data[idx] - ref) < 1e-4);
+            }
+        }
+    }
+    free(damaged_data);
+
+    // Test rendering to multiple targets at once
+    struct pl_render_target targets[3] = { target, target, target };
+    targets[1].dst_rect = (struct pl_rect2d) {0, 0, 10, 10};
+    targets[2].dst_rect = (struct pl_rect2d) {40, 40, 10, 20};
+    REQUIRE(pl_render_image_multi(rr, &image, targets, 3, NULL));
+    REQUIRE(pl_render_image_multi(rr, &image, targets, 3, &params));
+
+    // Test drawing a large number of overlays, which should get batched
+    const struct pl_fmt *osd_fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 1, 8, 8,
+                                               PL_FMT_CAP_SAMPLEABLE |
+                                               PL_FMT_CAP_BLITTABLE);
+    if (osd_fmt) {
+        enum { NUM_OSD = 64 };
+        const struct pl_tex *osd_tex[NUM_OSD] = {0};
+        struct pl_overlay osd[NUM_OSD];
+        static const uint8_t glyph[4 * 6] = {
+            0, 255, 255, 0, 255, 0, 0, 255, 255, 255, 255, 255,
+            255, 0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255,
+        };
+
+        for (int i = 0; i < NUM_OSD; i++) {
+            osd_tex[i] = pl_tex_create(gpu, &(struct pl_tex_params) {
+                .w              = 4,
+                .h              = 6,
+                .format         = osd_fmt,
+                .sampleable     = true,
+                .blit_src       = true,
+                .host_writable  = true,
+                .initial_data   = glyph,
+            });
+            REQUIRE(osd_tex[i]);
+
+            int x = (i % 8) * 5, y = (i / 8) * 5;
+            osd[i] = (struct pl_overlay) {
+                .plane = {
+                    .texture            = osd_tex[i],
+                    .components         = 1,
+                    .component_mapping  = {0},
+                },
+                .rect       = {x, y, x + 4, y + 6},
+                .mode       = PL_OVERLAY_MONOCHROME,
+                .base_color = {i / 64.0, 1.0, 0.5},
+                .repr       = target.repr,
+                .color      = target.color,
+            };
+        }
+
+        struct pl_render_target osd_target = target;
+        osd_target.overlays = osd;
+        osd_target.num_overlays = NUM_OSD;
+        REQUIRE(pl_render_image(rr, &image, &osd_target, NULL));
+        pl_gpu_finish(gpu);
+
+        for (int i = 0; i < NUM_OSD; i++)
+            pl_tex_destroy(gpu, &osd_tex[i]);
+    }
+
+    // Test automatic quality scaling, with a budget that every frame exceeds
+    params = pl_render_default_params;
+    params.upscaler = &pl_filter_ewa_lanczos;
+    params.deband_params = &pl_deband_default_params;
+    params.frame_budget = 1e-6;
+    params.skip_redraw_caching = true;
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+        pl_gpu_flush(gpu);
+    }
+    params.frame_budget = 0;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+
+    // Test that redraws served from the output cache match a full render
+    params = pl_render_default_params;
+    params.dither_params = NULL;
+    params.skip_redraw_caching = true;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex            = fbo,
+        .ptr            = fbo_data,
+    }));
+
+    float *cached_data = malloc(fbo->params.w * fbo->params.h * sizeof(float[4]));
+    params.skip_redraw_caching = false;
+    for (int i = 0; i < 3; i++) {
+        pl_tex_clear(gpu, fbo, (float[4]){0});
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex            = fbo,
+            .ptr            = cached_data,
+        }));
+        REQUIRE(memcmp(fbo_data, cached_data,
+                       fbo->params.w * fbo->params.h * sizeof(float[4])) == 0);
+    }
+    free(cached_data);
+
+    // Test that passthrough rendering produces an exact copy
+    const struct pl_tex *src = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = fbo->params.w,
+        .h              = fbo->params.h,
+        .format         = fbo_fmt,
+        .sampleable     = true,
+        .blit_src       = true,
+        .host_writable  = true,
+    });
+
+    if (src) {
+        size_t size = fbo->params.w * fbo->params.h * sizeof(float[4]);
+        float *src_data = malloc(size);
+        for (int i = 0; i < fbo->params.w * fbo->params.h * 4; i++)
+            src_data[i] = (i % 256) / 255.0;
+        REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+            .tex        = src,
+            .ptr        = src_data,
+        }));
+
+        struct pl_image passthrough = {
+            .num_planes = 1,
+            .planes     = {{
+                .texture           = src,
+                .components        = 4,
+                .component_mapping = {0, 1, 2, 3},
+            }},
+            .repr       = target.repr,
+            .color      = target.color,
+            .width      = fbo->params.w,
+            .height     = fbo->params.h,
+        };
+
+        struct pl_render_target full = target;
+        full.dst_rect = (struct pl_rect2d) {0};
+        params = pl_render_default_params;
+        params.dither_params = NULL;
+        REQUIRE(pl_render_image(rr, &passthrough, &full, &params));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex        = fbo,
+            .ptr        = fbo_data,
+        }));
+        REQUIRE(memcmp(fbo_data, src_data, size) == 0);
+        free(src_data);
+        pl_tex_destroy(gpu, &src);
+    }
+
+    // Test the per-stage frame statistics
+    params = pl_render_default_params;
+    params.frame_stats = true;
+    struct pl_render_stats stats;
+    for (int i = 0; i < 5; i++) {
+        image.signature++;
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+        if (!pl_renderer_get_stats(rr, &stats))
+            continue;
+
+        uint64_t time = 0;
+        int passes = 0;
+        for (int s = 0; s < PL_RENDER_STAGE_COUNT; s++) {
+            time += stats.stages[s].gpu_time;
+            passes += stats.stages[s].num_passes;
+        }
+        REQUIRE(time == stats.gpu_time);
+        REQUIRE(passes == stats.num_passes);
+        REQUIRE(stats.stages[PL_RENDER_STAGE_OUTPUT].num_passes > 0);
+    }
+
+    params.frame_stats = false;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    REQUIRE(!pl_renderer_get_stats(rr, &stats));
+
+    // Test streaming frames through a render queue, and make sure they come
+    // out in order and match a direct render
+    struct pl_render_queue *queue = pl_render_queue_create(gpu->ctx, gpu, rr, 2);
+    REQUIRE(queue);
+
+    struct pl_render_queue_frame qframe = {
+        .planes     = &(struct pl_plane_data) {
+            .type           = PL_FMT_FLOAT,
+            .width          = width,
+            .height         = height,
+            .component_size = { 8 * sizeof(float) },
+            .component_map  = { 0 },
+            .pixel_stride   = sizeof(float),
+            .pixels         = &data_5x5,
+        },
+        .num_planes = 1,
+        .image      = image,
+        .out_fmt    = fbo_fmt,
+        .out_w      = fbo->params.w,
+        .out_h      = fbo->params.h,
+        .target     = target,
+    };
+
+    qframe.target.dst_rect = (struct pl_rect2d) {0};
+    params = pl_render_default_params;
+    params.dither_params = NULL;
+    qframe.params = &params;
+
+    struct pl_render_target full_target = qframe.target;
+    full_target.fbo = fbo;
+    REQUIRE(pl_render_image(rr, &image, &full_target, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex            = fbo,
+        .ptr            = fbo_data,
+    }));
+
+    int frames_out = 0;
+    struct pl_render_queue_result qres;
+    for (intptr_t i = 0; i < 5; i++) {
+        while (pl_render_queue_full(queue)) {
+            REQUIRE(pl_render_queue_pop(queue, &qres, UINT64_MAX));
+            REQUIRE((intptr_t) qres.priv == frames_out++);
+        }
+
+        qframe.priv = (void *) i;
+        REQUIRE(pl_render_queue_push(queue, &qframe));
+    }
+
+    while (pl_render_queue_pop(queue, &qres, UINT64_MAX)) {
+        REQUIRE((intptr_t) qres.priv == frames_out++);
+        REQUIRE(qres.w == fbo->params.w);
+        for (int y = 0; y < qres.h; y++) {
+            const uint8_t *row = qres.data + y * qres.row_stride;
+            size_t row_size = qres.w * fbo_fmt->texel_size;
+            REQUIRE(memcmp(row, (uint8_t *) fbo_data + y * row_size, row_size) == 0);
+        }
+    }
+
+    REQUIRE(frames_out == 5);
+    REQUIRE(pl_render_queue_pending(queue) == 0);
+    pl_render_queue_destroy(&queue);
+
+    // Test distributing streams and bands of a frame across "multiple" GPUs
+    struct pl_multi_gpu *mg;
+    mg = pl_multi_gpu_create(gpu->ctx, &(struct pl_multi_gpu_params) {
+        .gpus       = (const struct pl_gpu *[]) { gpu, gpu },
+        .num_gpus   = 2,
+        .weights    = (float[]) { 1.0, 3.0 },
+    });
+    REQUIRE(mg);
+
+    struct pl_multi_stream streams[3];
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(pl_multi_gpu_open_stream(mg, &streams[i]));
+        REQUIRE(streams[i].gpu == gpu && streams[i].rr);
+    }
+    REQUIRE(streams[0].index == 1);
+    REQUIRE(streams[1].index == 1);
+    REQUIRE(streams[2].index == 0);
+    for (int i = 0; i < 3; i++)
+        pl_multi_gpu_close_stream(mg, &streams[i]);
+
+    size_t fbo_size = fbo->params.w * fbo->params.h * sizeof(float[4]);
+    float *split_data = malloc(fbo_size);
+    REQUIRE(split_data);
+    REQUIRE(pl_multi_gpu_render_split(mg, &(struct pl_multi_gpu_frame) {
+        .planes     = qframe.planes,
+        .num_planes = qframe.num_planes,
+        .image      = image,
+        .out_type   = PL_FMT_FLOAT,
+        .out_comps  = 4,
+        .out_depth  = 32,
+        .out_w      = fbo->params.w,
+        .out_h      = fbo->params.h,
+        .out_data   = split_data,
+        .out_stride = fbo->params.w * sizeof(float[4]),
+        .target     = qframe.target,
+        .params     = &params,
+    }));
+
+    for (int i = 0; i < fbo_size / sizeof(float); i++)
+        REQUIRE(fabs(split_data[i] - fbo_data[i]) < 1e-3);
+
+    free(split_data);
+    pl_multi_gpu_destroy(&mg);
+
+    // Test frame mixing, advancing the mix by a fraction of a frame each time
+    // so that most frames get re-used from the cache
+    struct pl_image images[4];
+    float distances[4];
+    for (int i = 0; i < 4; i++)
+        images[i] = image;
+
+    for (int f = 0; f < 10; f++) {
+        float pts = f * 0.4;
+        int base = (int) pts;
+        for (int i = 0; i < 4; i++) {
+            images[i].signature = base + i;
+            distances[i] = base + i - 1 - pts;
+        }
+
+        struct pl_image_mix mix = {
+            .num_images = 4,
+            .images = images,
+            .distances = distances,
+            .vsync_duration = 0.4,
+        };
+
+        params = pl_render_default_params;
+        REQUIRE(pl_render_image_mix(rr, &mix, &target, &params));
+        params.frame_mixer = &pl_filter_mitchell;
+        REQUIRE(pl_render_image_mix(rr, &mix, &target, &params));
+    }
+
 error:
     free(fbo_data);
     pl_renderer_destroy(&rr);
@@ -518,6 +1550,8 @@ error:
 static void gpu_tests(const struct pl_gpu *gpu)
 {
     pl_texture_tests(gpu);
+    pl_planar_tests(gpu);
+    pl_upload_tests(gpu);
     pl_shader_tests(gpu);
     pl_scaler_tests(gpu);
     pl_render_tests(gpu);
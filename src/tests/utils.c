@@ -1,6 +1,13 @@
 #include "tests.h"
 #include "gpu.h"
 
+static int arena_dtors;
+
+static void arena_dtor(void *ptr)
+{
+    arena_dtors++;
+}
+
 int main()
 {
     struct pl_plane_data data = {0};
@@ -85,4 +92,44 @@ int main()
     REQUIRE(layout.offset == 6 * sizeof(float));
     REQUIRE(layout.stride == 2 * sizeof(float));
     REQUIRE(layout.size == 20 * 2 * 2 * sizeof(float));
+
+    // Test the talloc arena
+    void *arena = talloc_new_arena(NULL);
+    for (int frame = 0; frame < 3; frame++) {
+        void *tmp = talloc_new(arena);
+        talloc_set_destructor(tmp, arena_dtor);
+        int *arr = NULL;
+        int num = 0;
+        for (int i = 0; i < 100000; i++)
+            TARRAY_APPEND(tmp, arr, num, i);
+        for (int i = 0; i < num; i++)
+            REQUIRE(arr[i] == i);
+
+        char *str = talloc_strdup(tmp, "hello");
+        uint8_t *raw = talloc_arena_alloc(arena, 17);
+        memset(raw, 0xFF, 17);
+        REQUIRE(strcmp(str, "hello") == 0);
+        REQUIRE(talloc_get_size(str) == 6);
+        REQUIRE(talloc_parent(str) == tmp);
+
+        // Heap allocations may be moved into the arena, too
+        talloc_steal(tmp, talloc_strdup(NULL, "heap"));
+        talloc_arena_reset(arena);
+        REQUIRE(arena_dtors == frame + 1);
+    }
+    talloc_free(arena);
+
+    // Test the locale-invariant formatter
+    struct bstr fmt = {0};
+    bstr_xappend_asprintf_c(NULL, &fmt, "vec4 color; \n");
+    REQUIRE(strcmp((char *) fmt.start, "vec4 color; \n") == 0);
+    fmt.len = 0;
+    bstr_xappend_asprintf_c(NULL, &fmt, "%s_%d[%zu] = %f%c%%",
+                            "_lut", -42, (size_t) 1 << 40, -0.25, ';');
+    REQUIRE(strcmp((char *) fmt.start, "_lut_-42[1099511627776] = -0.250000;%") == 0);
+    for (int i = 0; i < 1000; i++)
+        bstr_xappend_asprintf_c(NULL, &fmt, "%d ", i);
+    REQUIRE(strlen((char *) fmt.start) == fmt.len);
+    REQUIRE(bstr_endswith0(fmt, "998 999 "));
+    talloc_free(fmt.start);
 }
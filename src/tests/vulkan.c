@@ -82,6 +82,14 @@ static void vulkan_test_export_import(const struct pl_vulkan *pl_vk,
     REQUIRE(export);
     REQUIRE(export->shared_mem.handle.fd > -1);
 
+    if (handle_type == PL_HANDLE_DMA_BUF && fmt->num_modifiers) {
+        bool found = false;
+        for (int i = 0; i < fmt->num_modifiers; i++)
+            found |= fmt->modifiers[i] == export->shared_mem.drm_format_mod;
+        REQUIRE(found);
+        REQUIRE(export->shared_mem.pitch >= 32 * fmt->texel_size);
+    }
+
     const struct pl_tex *import = pl_tex_create(gpu, &(struct pl_tex_params) {
         .w = 32,
         .h = 32,
@@ -95,6 +103,160 @@ static void vulkan_test_export_import(const struct pl_vulkan *pl_vk,
     pl_tex_destroy(gpu, &export);
 }
 
+static void vulkan_bindless_tests(const struct pl_vulkan *pl_vk)
+{
+    const struct pl_gpu *gpu = pl_vk->gpu;
+    REQUIRE(gpu->limits.max_bindless_tex);
+
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 4, 8, 8,
+                                           PL_FMT_CAP_SAMPLEABLE);
+    if (!fmt)
+        return;
+
+    struct pl_tex_params params = {
+        .w = 16,
+        .h = 16,
+        .format = fmt,
+        .sampleable = true,
+    };
+
+    const struct pl_tex *a = pl_tex_create(gpu, &params);
+    const struct pl_tex *b = pl_tex_create(gpu, &params);
+    REQUIRE(a && b);
+    REQUIRE(a->bindless_index && b->bindless_index);
+    REQUIRE(a->bindless_index != b->bindless_index);
+    pl_tex_destroy(gpu, &a);
+    pl_tex_destroy(gpu, &b);
+
+    // Run everything again, this time with all sampled textures read from
+    // the texture heap
+    gpu_tests(gpu);
+}
+
+static void vulkan_host_ptr_tests(const struct pl_vulkan *pl_vk)
+{
+    const struct pl_gpu *gpu = pl_vk->gpu;
+    if (!(gpu->import_caps.buf & PL_HANDLE_HOST_PTR))
+        return;
+
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 1, 8, 8, 0);
+    if (!fmt)
+        return;
+
+    size_t align = gpu->limits.align_host_ptr;
+    REQUIRE(align);
+
+    static const int w = 64, h = 64;
+    size_t size = PL_ALIGN(w * h, align);
+    uint8_t *mem = NULL, dst[64 * 64];
+    REQUIRE(posix_memalign((void **) &mem, align, size) == 0);
+    for (int i = 0; i < w * h; i++)
+        mem[i] = i * 7;
+
+    const struct pl_buf *buf = pl_buf_create(gpu, &(struct pl_buf_params) {
+        .type = PL_BUF_TEX_TRANSFER,
+        .size = w * h,
+        .import_handle = PL_HANDLE_HOST_PTR,
+        .shared_mem = {
+            .handle.ptr = mem,
+            .size = size,
+        },
+    });
+
+    const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = w,
+        .h = h,
+        .format = fmt,
+        .host_writable = true,
+        .host_readable = true,
+    });
+
+    REQUIRE(buf && tex);
+    REQUIRE(buf->data == mem);
+    REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .buf = buf,
+    }));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = dst,
+    }));
+    REQUIRE(memcmp(mem, dst, w * h) == 0);
+
+    pl_tex_destroy(gpu, &tex);
+    pl_buf_destroy(gpu, &buf);
+    free(mem);
+}
+
+static void vulkan_compute_only_tests(const struct pl_vulkan *pl_vk)
+{
+    const struct pl_gpu *gpu = pl_vk->gpu;
+    REQUIRE(gpu->caps & PL_GPU_CAP_COMPUTE);
+    for (int i = 0; i < gpu->num_formats; i++)
+        REQUIRE(!(gpu->formats[i]->caps & PL_FMT_CAP_RENDERABLE));
+
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 16, 32,
+                                           PL_FMT_CAP_STORABLE);
+    if (!fmt)
+        return;
+
+    static float src[16 * 16];
+    for (int i = 0; i < PL_ARRAY_SIZE(src); i++)
+        src[i] = (i % 16) / 15.0;
+
+    struct pl_plane plane;
+    const struct pl_tex *tex = NULL;
+    REQUIRE(pl_upload_plane(gpu, &plane, &tex, &(struct pl_plane_data) {
+        .type = PL_FMT_FLOAT,
+        .width = 16,
+        .height = 16,
+        .component_size = { 8 * sizeof(float) },
+        .component_map  = { 0 },
+        .pixel_stride = sizeof(float),
+        .pixels = src,
+    }));
+
+    const struct pl_tex *fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 32,
+        .h = 32,
+        .format = fmt,
+        .storable = true,
+        .host_readable = true,
+    });
+    REQUIRE(fbo);
+
+    struct pl_renderer *rr = pl_renderer_create(gpu->ctx, gpu);
+    REQUIRE(pl_render_image(rr, &(struct pl_image) {
+        .num_planes = 1,
+        .planes     = { plane },
+        .repr       = pl_color_repr_rgb,
+        .color      = pl_color_space_srgb,
+        .width      = 16,
+        .height     = 16,
+    }, &(struct pl_render_target) {
+        .fbo        = fbo,
+        .repr       = pl_color_repr_rgb,
+        .color      = pl_color_space_srgb,
+    }, NULL));
+
+    static float dst[32 * 32 * 4];
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = fbo,
+        .ptr = dst,
+    }));
+
+    // The horizontal gradient (in the red channel) must survive the upscale
+    for (int y = 0; y < 32; y++) {
+        const float *row = &dst[y * 32 * 4];
+        REQUIRE(row[0] < 0.1 && row[31 * 4] > 0.9);
+        REQUIRE(row[16 * 4] > row[8 * 4]);
+    }
+
+    pl_renderer_destroy(&rr);
+    pl_tex_destroy(gpu, &fbo);
+    pl_tex_destroy(gpu, &tex);
+}
+
 int main()
 {
     struct pl_context *ctx = pl_test_context();
@@ -152,6 +314,9 @@ int main()
             continue;
 
         gpu_tests(vk->gpu);
+#ifdef VK_HAVE_UNIX
+        vulkan_host_ptr_tests(vk);
+#endif
 
         // Run these tests last because they disable some validation layers
 #ifdef VK_HAVE_UNIX
@@ -164,6 +329,21 @@ int main()
         vulkan_interop_tests(vk, PL_HANDLE_WIN32_KMT);
 #endif
         pl_vulkan_destroy(&vk);
+
+        params.bindless = true;
+        vk = pl_vulkan_create(ctx, &params);
+        if (vk && (vk->gpu->caps & PL_GPU_CAP_BINDLESS))
+            vulkan_bindless_tests(vk);
+        pl_vulkan_destroy(&vk);
+        params.bindless = false;
+
+        if (!(params.blacklist_caps & PL_GPU_CAP_COMPUTE)) {
+            params.compute_only = true;
+            vk = pl_vulkan_create(ctx, &params);
+            if (vk)
+                vulkan_compute_only_tests(vk);
+            pl_vulkan_destroy(&vk);
+        }
     }
 
     pl_vk_inst_destroy(&inst);
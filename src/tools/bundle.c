@@ -0,0 +1,291 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Generates a precompiled shader bundle, by rendering a single frame for
+// every combination of a (configurable) matrix of common renderer settings,
+// and saving the resulting pass cache with `pl_renderer_save`. Applications
+// can hand the result to `pl_renderer_load` on startup to avoid compiling
+// any of these shaders at runtime.
+//
+// Note: The bundle is tied to the GPU it was generated on (see
+// `pl_dispatch_save`), so this must be run on the target hardware, e.g. as
+// part of the image build for a given device.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libplacebo/renderer.h>
+#include <libplacebo/vulkan.h>
+
+#define SRC_W 64
+#define SRC_H 36
+#define MAX_FILTERS 16
+#define ARRAY_SIZE(s) (sizeof(s) / sizeof((s)[0]))
+
+enum src_layout {
+    SRC_RGB,        // packed RGB, single plane
+    SRC_YUV420,     // planar YCbCr 4:2:0, 8 bit
+    SRC_YUV420P10,  // planar YCbCr 4:2:0, 10 bit in 16 bit containers
+    SRC_LAYOUT_COUNT,
+};
+
+struct source {
+    struct pl_image image;
+    const struct pl_tex *tex[3];
+};
+
+static bool create_source(const struct pl_gpu *gpu, enum src_layout layout,
+                          const struct pl_color_space *csp, struct source *src)
+{
+    *src = (struct source) {
+        .image = {
+            .width = SRC_W,
+            .height = SRC_H,
+            .color = *csp,
+            .src_rect = {0, 0, SRC_W, SRC_H},
+        },
+    };
+
+    const struct pl_fmt *fmt = NULL;
+    int num_comps = layout == SRC_RGB ? 4 : 1;
+    int depth = layout == SRC_YUV420P10 ? 16 : 8;
+    fmt = pl_find_fmt(gpu, PL_FMT_UNORM, num_comps, depth, depth,
+                      PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_LINEAR);
+    if (!fmt)
+        return false;
+
+    if (layout == SRC_RGB) {
+        src->image.repr = pl_color_repr_rgb;
+        src->image.num_planes = 1;
+        src->image.planes[0] = (struct pl_plane) {
+            .components = 3,
+            .component_mapping = {0, 1, 2},
+        };
+    } else {
+        src->image.repr = csp->transfer == PL_COLOR_TRC_PQ ? pl_color_repr_uhdtv
+                                                           : pl_color_repr_hdtv;
+        if (layout == SRC_YUV420P10) {
+            src->image.repr.bits = (struct pl_bit_encoding) {
+                .sample_depth = 16,
+                .color_depth = 10,
+            };
+        }
+
+        src->image.num_planes = 3;
+        for (int i = 0; i < 3; i++) {
+            src->image.planes[i] = (struct pl_plane) {
+                .components = 1,
+                .component_mapping = {i},
+            };
+        }
+    }
+
+    for (int i = 0; i < src->image.num_planes; i++) {
+        bool chroma = i > 0;
+        src->tex[i] = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .w = chroma ? SRC_W / 2 : SRC_W,
+            .h = chroma ? SRC_H / 2 : SRC_H,
+            .format = fmt,
+            .sampleable = true,
+            .sample_mode = PL_TEX_SAMPLE_LINEAR,
+        });
+
+        if (!src->tex[i])
+            return false;
+        src->image.planes[i].texture = src->tex[i];
+    }
+
+    return true;
+}
+
+static void destroy_source(const struct pl_gpu *gpu, struct source *src)
+{
+    for (int i = 0; i < ARRAY_SIZE(src->tex); i++)
+        pl_tex_destroy(gpu, &src->tex[i]);
+}
+
+static const struct pl_filter_config *find_filter(const char *name)
+{
+    if (strcmp(name, "none") == 0)
+        return NULL;
+
+    const struct pl_named_filter_config *f = pl_find_named_filter(name);
+    if (!f) {
+        fprintf(stderr, "Unknown filter '%s'!\n", name);
+        exit(1);
+    }
+
+    return f->filter;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s -o <output> [-u <upscaler>]... [-d <downscaler>]... [-H]\n"
+        "\n"
+        "  -o   file to write the shader bundle to\n"
+        "  -u   upscaler to include (may be repeated, default: spline36)\n"
+        "  -d   downscaler to include (may be repeated, default: mitchell)\n"
+        "  -H   also include HDR10 (PQ/BT.2020) sources\n"
+        "\n"
+        "Filter names are as in `pl_named_filters`. `none` selects the\n"
+        "built-in GPU sampling.\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    const char *upscalers[MAX_FILTERS], *downscalers[MAX_FILTERS];
+    int num_up = 0, num_down = 0;
+    bool hdr = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:u:d:H")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 'u':
+            if (num_up == MAX_FILTERS)
+                usage(argv[0]);
+            upscalers[num_up++] = optarg;
+            break;
+        case 'd':
+            if (num_down == MAX_FILTERS)
+                usage(argv[0]);
+            downscalers[num_down++] = optarg;
+            break;
+        case 'H': hdr = true; break;
+        default: usage(argv[0]);
+        }
+    }
+
+    if (!out_path)
+        usage(argv[0]);
+    if (!num_up)
+        upscalers[num_up++] = "spline36";
+    if (!num_down)
+        downscalers[num_down++] = "mitchell";
+
+    struct pl_context *ctx;
+    ctx = pl_context_create(PL_API_VER, &(struct pl_context_params) {
+        .log_cb     = isatty(fileno(stderr)) ? pl_log_color : pl_log_simple,
+        .log_level  = PL_LOG_WARN,
+    });
+
+    const struct pl_vulkan *vk = pl_vulkan_create(ctx, &pl_vulkan_default_params);
+    if (!vk) {
+        fprintf(stderr, "Failed creating vulkan device!\n");
+        return 1;
+    }
+
+    const struct pl_gpu *gpu = vk->gpu;
+    struct pl_renderer *rr = pl_renderer_create(ctx, gpu);
+
+    const struct pl_fmt *fbo_fmt = pl_find_named_fmt(gpu, "rgba8");
+    const struct pl_tex *fbo = NULL;
+    if (fbo_fmt) {
+        fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .w = SRC_W * 2,
+            .h = SRC_H * 2,
+            .format = fbo_fmt,
+            .renderable = true,
+        });
+    }
+
+    if (!fbo) {
+        fprintf(stderr, "Failed creating render target!\n");
+        return 1;
+    }
+
+    // Render the target at twice and half the source size, to cover both
+    // the upscaling and the downscaling code paths
+    const struct pl_rect2d rects[] = {
+        {0, 0, SRC_W * 2, SRC_H * 2},
+        {0, 0, SRC_W / 2, SRC_H / 2},
+    };
+
+    const struct pl_color_space *csps[] = {
+        &pl_color_space_bt709,
+        &pl_color_space_hdr10,
+    };
+
+    int num_frames = 0, num_failed = 0;
+    for (int c = 0; c < (hdr ? 2 : 1); c++) {
+        for (enum src_layout l = 0; l < SRC_LAYOUT_COUNT; l++) {
+            struct source src;
+            if (!create_source(gpu, l, csps[c], &src)) {
+                fprintf(stderr, "Skipping unsupported source layout %d\n", l);
+                destroy_source(gpu, &src);
+                continue;
+            }
+
+            for (int u = 0; u < num_up; u++) {
+                for (int d = 0; d < num_down; d++) {
+                    struct pl_render_params params = pl_render_default_params;
+                    params.upscaler = find_filter(upscalers[u]);
+                    params.downscaler = find_filter(downscalers[d]);
+
+                    for (int r = 0; r < ARRAY_SIZE(rects); r++) {
+                        struct pl_render_target target = {
+                            .fbo = fbo,
+                            .dst_rect = rects[r],
+                            .repr = pl_color_repr_rgb,
+                            .color = pl_color_space_monitor,
+                        };
+
+                        num_frames++;
+                        if (!pl_render_image(rr, &src.image, &target, &params))
+                            num_failed++;
+                    }
+                }
+            }
+
+            destroy_source(gpu, &src);
+        }
+    }
+
+    size_t size = pl_renderer_save(rr, NULL);
+    uint8_t *data = malloc(size);
+    int ret = 1;
+    if (!data)
+        goto done;
+    pl_renderer_save(rr, data);
+
+    FILE *f = fopen(out_path, "wb");
+    if (!f || fwrite(data, 1, size, f) != size) {
+        fprintf(stderr, "Failed writing '%s'!\n", out_path);
+        if (f)
+            fclose(f);
+        goto done;
+    }
+
+    if (fclose(f) == 0) {
+        printf("Wrote %zu bytes to '%s' (%d frames, %d failed)\n",
+               size, out_path, num_frames, num_failed);
+        ret = num_failed ? 1 : 0;
+    }
+
+done:
+    free(data);
+    pl_tex_destroy(gpu, &fbo);
+    pl_renderer_destroy(&rr);
+    pl_vulkan_destroy(&vk);
+    pl_context_destroy(&ctx);
+    return ret;
+}
@@ -0,0 +1,647 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "context.h"
+#include "colorspace.h"
+
+// Every stage of the conversion is applied to a whole chunk of pixels at a
+// time, stored as separate arrays per channel. This keeps the inner loops free
+// of branches on the parameters, so the compiler can vectorize them.
+#define CHUNK 256
+
+// Upper bound on the number of worker threads used for a single conversion
+#define CONVERT_THREADS_MAX 16
+
+// Pre-computed state, shared by all threads
+struct convert_state {
+    // Color decoding
+    enum pl_color_system sys;
+    float xyz_scale;
+    struct pl_transform3x3 decode;
+
+    // Color mapping
+    const struct pl_color_map_params *map;
+    struct pl_color_space src, dst;
+    float src_luma[3], dst_luma[3];
+    bool need_linear;
+    bool tone_map;
+    bool cms;
+    struct pl_matrix3x3 cms_mat;
+};
+
+struct convert_slice {
+    const struct convert_state *st;
+    const struct pl_convert_plane *src, *dst;
+    int w;
+    int y_start, y_end; // range of rows to convert, [start, end)
+};
+
+typedef float chunk_t[3][CHUNK];
+
+static void load_plane(const struct pl_convert_plane *p, int x, int y,
+                       int n, float *restrict out)
+{
+    const uint8_t *row = (const uint8_t *) p->data + y * p->stride;
+    switch (p->type) {
+    case PL_CONVERT_FLOAT: {
+        const float *in = (const float *) row + x;
+        for (int i = 0; i < n; i++)
+            out[i] = in[i];
+        return;
+    }
+    case PL_CONVERT_U16: {
+        const uint16_t *in = (const uint16_t *) row + x;
+        for (int i = 0; i < n; i++)
+            out[i] = in[i] * (1.0f / 65535);
+        return;
+    }
+    }
+
+    abort();
+}
+
+static void store_plane(const struct pl_convert_plane *p, int x, int y,
+                        int n, const float *restrict in)
+{
+    uint8_t *row = (uint8_t *) p->data + y * p->stride;
+    switch (p->type) {
+    case PL_CONVERT_FLOAT: {
+        float *out = (float *) row + x;
+        for (int i = 0; i < n; i++)
+            out[i] = in[i];
+        return;
+    }
+    case PL_CONVERT_U16: {
+        uint16_t *out = (uint16_t *) row + x;
+        for (int i = 0; i < n; i++)
+            out[i] = PL_MIN(PL_MAX(in[i], 0.0f), 1.0f) * 65535 + 0.5f;
+        return;
+    }
+    }
+
+    abort();
+}
+
+static void apply_matrix(const struct pl_matrix3x3 *mat, const float c[3],
+                         chunk_t px, int n)
+{
+    const float (*m)[3] = mat->m;
+    float *restrict r = px[0], *restrict g = px[1], *restrict b = px[2];
+    for (int i = 0; i < n; i++) {
+        float x = r[i], y = g[i], z = b[i];
+        r[i] = m[0][0] * x + m[0][1] * y + m[0][2] * z + c[0];
+        g[i] = m[1][0] * x + m[1][1] * y + m[1][2] * z + c[1];
+        b[i] = m[2][0] * x + m[2][1] * y + m[2][2] * z + c[2];
+    }
+}
+
+static void clamp_black(float *restrict x, int n)
+{
+    for (int i = 0; i < n; i++)
+        x[i] = PL_MAX(x[i], 0.0f);
+}
+
+static void scale(float *restrict x, int n, float s)
+{
+    for (int i = 0; i < n; i++)
+        x[i] *= s;
+}
+
+static void power(float *restrict x, int n, float e)
+{
+    for (int i = 0; i < n; i++)
+        x[i] = powf(x[i], e);
+}
+
+// Equivalent to `pl_shader_linearize`, for a single channel
+static void linearize(enum pl_color_transfer trc, float *restrict x, int n)
+{
+    if (trc == PL_COLOR_TRC_LINEAR)
+        return;
+
+    clamp_black(x, n);
+
+    switch (trc) {
+    case PL_COLOR_TRC_SRGB:
+        for (int i = 0; i < n; i++) {
+            x[i] = x[i] > 0.04045f ? powf((x[i] + 0.055f) / 1.055f, 2.4f)
+                                   : x[i] * (1.0f / 12.92f);
+        }
+        return;
+    case PL_COLOR_TRC_BT_1886:
+        power(x, n, 2.4f);
+        return;
+    case PL_COLOR_TRC_GAMMA18:
+        power(x, n, 1.8f);
+        return;
+    case PL_COLOR_TRC_UNKNOWN:
+    case PL_COLOR_TRC_GAMMA22:
+        power(x, n, 2.2f);
+        return;
+    case PL_COLOR_TRC_GAMMA28:
+        power(x, n, 2.8f);
+        return;
+    case PL_COLOR_TRC_PRO_PHOTO:
+        for (int i = 0; i < n; i++)
+            x[i] = x[i] > 0.03125f ? powf(x[i], 1.8f) : x[i] * (1.0f / 16.0f);
+        return;
+    case PL_COLOR_TRC_PQ:
+        for (int i = 0; i < n; i++) {
+            float v = powf(x[i], 1.0f / PQ_M2);
+            v = PL_MAX(v - PQ_C1, 0.0f) / (PQ_C2 - PQ_C3 * v);
+            x[i] = powf(v, 1.0f / PQ_M1) * (10000 / PL_COLOR_REF_WHITE);
+        }
+        return;
+    case PL_COLOR_TRC_HLG:
+        for (int i = 0; i < n; i++) {
+            x[i] = x[i] > 0.5f ? expf((x[i] - HLG_C) * (1.0f / HLG_A)) + HLG_B
+                               : 4.0f * x[i] * x[i];
+        }
+        return;
+    case PL_COLOR_TRC_V_LOG:
+        for (int i = 0; i < n; i++) {
+            x[i] = x[i] >= 0.181f
+                ? powf(10.0f, (x[i] - VLOG_D) * (1.0f / VLOG_C)) - VLOG_B
+                : (x[i] - 0.125f) * (1.0f / 5.6f);
+        }
+        return;
+    case PL_COLOR_TRC_S_LOG1:
+        for (int i = 0; i < n; i++)
+            x[i] = powf(10.0f, (x[i] - SLOG_C) * (1.0f / SLOG_A)) - SLOG_B;
+        return;
+    case PL_COLOR_TRC_S_LOG2:
+        for (int i = 0; i < n; i++) {
+            x[i] = x[i] >= SLOG_Q
+                ? (powf(10.0f, (x[i] - SLOG_C) * (1.0f / SLOG_A)) - SLOG_B)
+                    * (1.0f / SLOG_K2)
+                : (x[i] - SLOG_Q) * (1.0f / SLOG_P);
+        }
+        return;
+    default:
+        abort();
+    }
+}
+
+// Equivalent to `pl_shader_delinearize`, for a single channel
+static void delinearize(enum pl_color_transfer trc, float *restrict x, int n)
+{
+    if (trc == PL_COLOR_TRC_LINEAR)
+        return;
+
+    clamp_black(x, n);
+
+    switch (trc) {
+    case PL_COLOR_TRC_SRGB:
+        for (int i = 0; i < n; i++) {
+            x[i] = x[i] >= 0.0031308f ? 1.055f * powf(x[i], 1.0f / 2.4f) - 0.055f
+                                      : x[i] * 12.92f;
+        }
+        return;
+    case PL_COLOR_TRC_BT_1886:
+        power(x, n, 1.0f / 2.4f);
+        return;
+    case PL_COLOR_TRC_GAMMA18:
+        power(x, n, 1.0f / 1.8f);
+        return;
+    case PL_COLOR_TRC_UNKNOWN:
+    case PL_COLOR_TRC_GAMMA22:
+        power(x, n, 1.0f / 2.2f);
+        return;
+    case PL_COLOR_TRC_GAMMA28:
+        power(x, n, 1.0f / 2.8f);
+        return;
+    case PL_COLOR_TRC_PRO_PHOTO:
+        for (int i = 0; i < n; i++)
+            x[i] = x[i] >= 0.001953f ? powf(x[i], 1.0f / 1.8f) : x[i] * 16.0f;
+        return;
+    case PL_COLOR_TRC_PQ:
+        for (int i = 0; i < n; i++) {
+            float v = powf(x[i] * (PL_COLOR_REF_WHITE / 10000), PQ_M1);
+            v = (PQ_C1 + PQ_C2 * v) / (1.0f + PQ_C3 * v);
+            x[i] = powf(v, PQ_M2);
+        }
+        return;
+    case PL_COLOR_TRC_HLG:
+        for (int i = 0; i < n; i++) {
+            x[i] = x[i] > 1.0f ? HLG_A * logf(x[i] - HLG_B) + HLG_C
+                               : 0.5f * sqrtf(x[i]);
+        }
+        return;
+    case PL_COLOR_TRC_V_LOG:
+        for (int i = 0; i < n; i++) {
+            x[i] = x[i] >= 0.01f
+                ? (VLOG_C / M_LN10) * logf(x[i] + VLOG_B) + VLOG_D
+                : 5.6f * x[i] + 0.125f;
+        }
+        return;
+    case PL_COLOR_TRC_S_LOG1:
+        for (int i = 0; i < n; i++)
+            x[i] = (SLOG_A / M_LN10) * logf(x[i] + SLOG_B) + SLOG_C;
+        return;
+    case PL_COLOR_TRC_S_LOG2:
+        for (int i = 0; i < n; i++) {
+            x[i] = x[i] >= 0.0f
+                ? (SLOG_A / M_LN10) * logf(SLOG_K2 * x[i] + SLOG_B) + SLOG_C
+                : SLOG_P * x[i] + SLOG_Q;
+        }
+        return;
+    default:
+        abort();
+    }
+}
+
+// Equivalent to `pl_shader_decode_color`
+static void decode(const struct convert_state *st, chunk_t px, int n)
+{
+    if (st->sys == PL_COLOR_SYSTEM_XYZ) {
+        for (int c = 0; c < 3; c++) {
+            scale(px[c], n, st->xyz_scale);
+            clamp_black(px[c], n);
+            power(px[c], n, 2.6f);
+        }
+    }
+
+    apply_matrix(&st->decode.mat, st->decode.c, px, n);
+
+    switch (st->sys) {
+    case PL_COLOR_SYSTEM_BT_2020_C: {
+        float *restrict r = px[0], *restrict g = px[1], *restrict b = px[2];
+        for (int i = 0; i < n; i++) {
+            b[i] = b[i] * (b[i] <= 0.0f ? 1.9404f : 1.5816f) + g[i];
+            r[i] = r[i] * (r[i] <= 0.0f ? 1.7184f : 0.9936f) + g[i];
+        }
+
+        for (int i = 0; i < n; i++) {
+            float lin[3];
+            for (int c = 0; c < 3; c++) {
+                float v = px[c][i];
+                lin[c] = v >= 0.08145f
+                    ? powf((v + 0.0993f) * (1.0f / 1.0993f), 1.0f / 0.45f)
+                    : v * (1.0f / 4.5f);
+            }
+
+            float y = (lin[1] - 0.2627f * lin[0] - 0.0593f * lin[2]) * (1.0f / 0.6780f);
+            g[i] = y >= 0.0181f ? 1.0993f * powf(y, 0.45f) - 0.0993f : y * 4.5f;
+        }
+        return;
+    }
+
+    case PL_COLOR_SYSTEM_BT_2100_PQ:
+    case PL_COLOR_SYSTEM_BT_2100_HLG: {
+        enum pl_color_transfer trc = st->sys == PL_COLOR_SYSTEM_BT_2100_PQ
+                                        ? PL_COLOR_TRC_PQ
+                                        : PL_COLOR_TRC_HLG;
+
+        static const float zero[3] = {0};
+        for (int c = 0; c < 3; c++)
+            linearize(trc, px[c], n);
+        apply_matrix(&pl_bt2100_lms2rgb, zero, px, n);
+        for (int c = 0; c < 3; c++)
+            delinearize(trc, px[c], n);
+        return;
+    }
+
+    default:
+        return;
+    }
+}
+
+static float hlg_gamma(const struct pl_color_space *csp)
+{
+    float gamma = 1.2 + 0.42 * log10(csp->sig_peak * PL_COLOR_REF_WHITE / 1000.0);
+    return PL_MAX(gamma, 1.0);
+}
+
+// Equivalent to `pl_shader_ootf`
+static void ootf(const struct pl_color_space *csp, const float luma[3],
+                 chunk_t px, int n)
+{
+    if (csp->sig_scale != 1.0) {
+        for (int c = 0; c < 3; c++)
+            scale(px[c], n, csp->sig_scale);
+    }
+
+    if (!csp->light || csp->light == PL_COLOR_LIGHT_DISPLAY)
+        return;
+
+    for (int c = 0; c < 3; c++)
+        clamp_black(px[c], n);
+
+    switch (csp->light) {
+    case PL_COLOR_LIGHT_SCENE_HLG: {
+        float gamma = hlg_gamma(csp);
+        float s = csp->sig_peak / powf(12, gamma);
+        for (int i = 0; i < n; i++) {
+            float y = luma[0] * px[0][i] + luma[1] * px[1][i] + luma[2] * px[2][i];
+            float k = s * powf(y, gamma - 1.0f);
+            for (int c = 0; c < 3; c++)
+                px[c][i] *= k;
+        }
+        return;
+    }
+    case PL_COLOR_LIGHT_SCENE_709_1886:
+        for (int c = 0; c < 3; c++) {
+            float *restrict x = px[c];
+            for (int i = 0; i < n; i++) {
+                float v = x[i] > 0.0181f ? 1.0993f * powf(x[i], 0.45f) - 0.0993f
+                                         : x[i] * 4.5f;
+                x[i] = powf(v, 2.4f);
+            }
+        }
+        return;
+    case PL_COLOR_LIGHT_SCENE_1_2:
+        for (int c = 0; c < 3; c++)
+            power(px[c], n, 1.2f);
+        return;
+    default:
+        abort();
+    }
+}
+
+// Equivalent to `pl_shader_inverse_ootf`
+static void inverse_ootf(const struct pl_color_space *csp, const float luma[3],
+                         chunk_t px, int n)
+{
+    if (!csp->light || csp->light == PL_COLOR_LIGHT_DISPLAY)
+        goto skip;
+
+    for (int c = 0; c < 3; c++)
+        clamp_black(px[c], n);
+
+    switch (csp->light) {
+    case PL_COLOR_LIGHT_SCENE_HLG: {
+        float gamma = hlg_gamma(csp);
+        float s = powf(12, gamma) / csp->sig_peak;
+        for (int i = 0; i < n; i++) {
+            for (int c = 0; c < 3; c++)
+                px[c][i] *= s;
+            float y = luma[0] * px[0][i] + luma[1] * px[1][i] + luma[2] * px[2][i];
+            float k = 1.0f / PL_MAX(1e-6f, powf(y, (gamma - 1.0f) / gamma));
+            for (int c = 0; c < 3; c++)
+                px[c][i] *= k;
+        }
+        break;
+    }
+    case PL_COLOR_LIGHT_SCENE_709_1886:
+        for (int c = 0; c < 3; c++) {
+            float *restrict x = px[c];
+            for (int i = 0; i < n; i++) {
+                float v = powf(x[i], 1.0f / 2.4f);
+                x[i] = v > 0.08145f
+                    ? powf((v + 0.0993f) * (1.0f / 1.0993f), 1.0f / 0.45f)
+                    : v * (1.0f / 4.5f);
+            }
+        }
+        break;
+    case PL_COLOR_LIGHT_SCENE_1_2:
+        for (int c = 0; c < 3; c++)
+            power(px[c], n, 1.0f / 1.2f);
+        break;
+    default:
+        abort();
+    }
+
+skip:
+    if (csp->sig_scale != 1.0) {
+        for (int c = 0; c < 3; c++)
+            scale(px[c], n, 1.0f / csp->sig_scale);
+    }
+}
+
+// Equivalent to `pl_shader_tone_map`, without peak detection or LUT
+static void tone_map(const struct convert_state *st, chunk_t px, int n)
+{
+    const struct pl_color_map_params *params = st->map;
+    const struct pl_color_space *src = &st->src, *dst = &st->dst;
+    float peak = src->sig_peak * src->sig_scale;
+    float avg = src->sig_avg * src->sig_scale;
+
+    float dst_range = dst->sig_peak * dst->sig_scale;
+    if (dst_range > 1.0) {
+        for (int c = 0; c < 3; c++)
+            scale(px[c], n, 1.0f / dst_range);
+        peak /= dst_range;
+    }
+
+    float slope = PL_MIN(PL_DEF(params->max_boost, 1.0),
+                         dst->sig_avg * dst->sig_scale / avg);
+    peak *= slope;
+
+    for (int i = 0; i < n; i++) {
+        float orig[3] = { px[0][i], px[1][i], px[2][i] };
+        int idx = 0;
+        if (orig[1] > orig[idx]) idx = 1;
+        if (orig[2] > orig[idx]) idx = 2;
+
+        float sig[3];
+        for (int c = 0; c < 3; c++) {
+            sig[c] = pl_tone_map_curve(params->tone_mapping_algo,
+                                       params->tone_mapping_param,
+                                       orig[c] * slope, peak);
+            sig[c] = PL_MIN(sig[c], 1.01f);
+        }
+
+        float ratio = orig[idx] > 0.0f ? sig[idx] / orig[idx] : 0.0f;
+        float coeff = 0.0f;
+        if (params->desaturation_strength > 0.0) {
+            coeff = PL_MAX(sig[idx] - params->desaturation_base, 1e-6f) /
+                    PL_MAX(sig[idx], 1.0f);
+            coeff = params->desaturation_strength *
+                    powf(coeff, params->desaturation_exponent);
+        }
+
+        for (int c = 0; c < 3; c++) {
+            float lin = orig[c] * ratio;
+            px[c][i] = lin + (sig[c] - lin) * coeff;
+        }
+    }
+
+    if (dst_range > 1.0) {
+        for (int c = 0; c < 3; c++)
+            scale(px[c], n, dst_range);
+    }
+}
+
+static void gamut_warning(const struct convert_state *st, chunk_t px, int n)
+{
+    float hi = st->dst.sig_peak * st->dst.sig_scale + 0.005f;
+    float inv = st->src.sig_peak * st->src.sig_scale;
+    for (int i = 0; i < n; i++) {
+        bool out = false;
+        for (int c = 0; c < 3; c++)
+            out |= px[c][i] > hi || px[c][i] < -0.005f;
+        if (!out)
+            continue;
+        for (int c = 0; c < 3; c++)
+            px[c][i] = inv - px[c][i];
+    }
+}
+
+// Equivalent to `pl_shader_color_map`
+static void color_map(const struct convert_state *st, chunk_t px, int n)
+{
+    if (!st->need_linear)
+        return;
+
+    for (int c = 0; c < 3; c++)
+        linearize(st->src.transfer, px[c], n);
+    ootf(&st->src, st->src_luma, px, n);
+
+    if (st->tone_map)
+        tone_map(st, px, n);
+
+    if (st->cms) {
+        static const float zero[3] = {0};
+        apply_matrix(&st->cms_mat, zero, px, n);
+    }
+
+    if (st->map->gamut_warning)
+        gamut_warning(st, px, n);
+
+    inverse_ootf(&st->dst, st->dst_luma, px, n);
+    for (int c = 0; c < 3; c++)
+        delinearize(st->dst.transfer, px[c], n);
+}
+
+static void *convert_rows(void *arg)
+{
+    const struct convert_slice *sl = arg;
+    const struct convert_state *st = sl->st;
+    chunk_t px;
+
+    for (int y = sl->y_start; y < sl->y_end; y++) {
+        for (int x = 0; x < sl->w; x += CHUNK) {
+            int n = PL_MIN(sl->w - x, CHUNK);
+            for (int c = 0; c < 3; c++)
+                load_plane(&sl->src[c], x, y, n, px[c]);
+
+            decode(st, px, n);
+            color_map(st, px, n);
+
+            for (int c = 0; c < 3; c++)
+                store_plane(&sl->dst[c], x, y, n, px[c]);
+        }
+    }
+
+    return NULL;
+}
+
+static void luma_coeffs(enum pl_color_primaries prim, float out[3])
+{
+    struct pl_matrix3x3 rgb2xyz;
+    rgb2xyz = pl_get_rgb2xyz_matrix(pl_raw_primaries_get(prim));
+    for (int i = 0; i < 3; i++)
+        out[i] = rgb2xyz.m[1][i]; // RGB->Y vector
+}
+
+bool pl_convert_planes(struct pl_context *ctx,
+                       const struct pl_convert_params *params,
+                       const struct pl_convert_plane src[3],
+                       const struct pl_convert_plane dst[3],
+                       int w, int h)
+{
+    for (int i = 0; i < 3; i++) {
+        if (!src[i].data || !dst[i].data) {
+            pl_err(ctx, "pl_convert_planes: all three planes are required!");
+            return false;
+        }
+
+        size_t bytes = (src[i].type == PL_CONVERT_U16 ? 2 : 4) * (size_t) w;
+        size_t bytes_out = (dst[i].type == PL_CONVERT_U16 ? 2 : 4) * (size_t) w;
+        if (src[i].stride < bytes || dst[i].stride < bytes_out) {
+            pl_err(ctx, "pl_convert_planes: plane stride too small!");
+            return false;
+        }
+    }
+
+    struct convert_state st = {
+        .map = PL_DEF(params->color_map_params, &pl_color_map_default_params),
+        .src = params->src,
+        .dst = params->dst,
+    };
+
+    struct pl_color_repr repr = params->repr;
+    st.sys = repr.sys;
+    if (repr.sys == PL_COLOR_SYSTEM_XYZ)
+        st.xyz_scale = pl_color_repr_normalize(&repr);
+    st.decode = pl_color_repr_decode(&repr, params->adjustment);
+
+    // Mirrors the decisions made by `pl_shader_color_map`
+    pl_color_map_infer(&st.src, &st.dst);
+    st.need_linear = st.src.transfer != st.dst.transfer ||
+                     st.src.primaries != st.dst.primaries ||
+                     st.src.sig_peak > st.dst.sig_peak ||
+                     st.src.sig_avg != st.dst.sig_avg ||
+                     st.src.sig_scale != st.dst.sig_scale ||
+                     st.src.light != st.dst.light;
+    st.tone_map = st.src.sig_peak * st.src.sig_scale >
+                  st.dst.sig_peak * st.dst.sig_scale + 1e-6;
+
+    if (st.src.primaries != st.dst.primaries) {
+        st.cms = true;
+        st.cms_mat = pl_get_color_mapping_matrix(
+                pl_raw_primaries_get(st.src.primaries),
+                pl_raw_primaries_get(st.dst.primaries),
+                st.map->intent);
+    }
+
+    luma_coeffs(st.src.primaries, st.src_luma);
+    luma_coeffs(st.dst.primaries, st.dst_luma);
+
+    int threads = params->threads;
+    if (!threads) {
+#ifdef _SC_NPROCESSORS_ONLN
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    threads = PL_MAX(PL_MIN(PL_MIN(threads, CONVERT_THREADS_MAX), h), 1);
+
+    // Split the image into groups of rows, one per thread
+    struct convert_slice slices[CONVERT_THREADS_MAX];
+    pthread_t workers[CONVERT_THREADS_MAX];
+    for (int i = 0; i < threads; i++) {
+        slices[i] = (struct convert_slice) {
+            .st = &st,
+            .src = src,
+            .dst = dst,
+            .w = w,
+            .y_start = i * h / threads,
+            .y_end = (i + 1) * h / threads,
+        };
+    }
+
+    int spawned = 1;
+    for (; spawned < threads; spawned++) {
+        if (pthread_create(&workers[spawned], NULL, convert_rows, &slices[spawned]))
+            break;
+    }
+
+    // The calling thread converts the first group itself, as well as any
+    // groups we failed spawning a thread for
+    convert_rows(&slices[0]);
+    for (int i = spawned; i < threads; i++)
+        convert_rows(&slices[i]);
+    for (int i = 1; i < spawned; i++)
+        pthread_join(workers[i], NULL);
+
+    return true;
+}
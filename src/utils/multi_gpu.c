@@ -0,0 +1,350 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <pthread.h>
+
+#include "context.h"
+#include "common.h"
+#include "gpu.h"
+
+struct gpu_state {
+    const struct pl_gpu *gpu;
+    float weight;
+    int num_streams;
+    uint8_t *cache; // last saved renderer cache for this GPU, or NULL
+    size_t cache_size;
+
+    // Resources for `pl_multi_gpu_render_split`
+    struct pl_renderer *rr;
+    const struct pl_tex *tex_in[4];
+    const struct pl_tex *fbo;
+    const struct pl_buf *buf;
+    int y0, y1;     // the band rendered by this GPU
+    size_t stride;  // row stride of `buf`
+};
+
+struct pl_multi_gpu {
+    struct pl_context *ctx;
+    pthread_mutex_t lock; // protects the stream counts and caches
+    struct gpu_state *gpus;
+    int num_gpus;
+};
+
+struct pl_multi_gpu *pl_multi_gpu_create(struct pl_context *ctx,
+                                         const struct pl_multi_gpu_params *params)
+{
+    if (params->num_gpus <= 0) {
+        pl_err(ctx, "Creating a multi-GPU context requires at least one GPU!");
+        return NULL;
+    }
+
+    struct pl_multi_gpu *mg = talloc_ptrtype(NULL, mg);
+    *mg = (struct pl_multi_gpu) {
+        .ctx = ctx,
+        .num_gpus = params->num_gpus,
+    };
+
+    pthread_mutex_init(&mg->lock, NULL);
+    mg->gpus = talloc_zero_array(mg, struct gpu_state, mg->num_gpus);
+    for (int i = 0; i < mg->num_gpus; i++) {
+        mg->gpus[i].gpu = params->gpus[i];
+        mg->gpus[i].weight = params->weights ? params->weights[i] : 1.0;
+        if (!(mg->gpus[i].weight > 0)) {
+            PL_ERR(mg, "Invalid weight %f for GPU %d!", mg->gpus[i].weight, i);
+            pl_multi_gpu_destroy(&mg);
+            return NULL;
+        }
+    }
+
+    return mg;
+}
+
+void pl_multi_gpu_destroy(struct pl_multi_gpu **ptr)
+{
+    struct pl_multi_gpu *mg = *ptr;
+    if (!mg)
+        return;
+
+    for (int i = 0; i < mg->num_gpus; i++) {
+        struct gpu_state *g = &mg->gpus[i];
+        if (g->num_streams)
+            PL_ERR(mg, "Destroying multi-GPU context with open streams!");
+
+        pl_renderer_destroy(&g->rr);
+        for (int p = 0; p < PL_ARRAY_SIZE(g->tex_in); p++)
+            pl_tex_destroy(g->gpu, &g->tex_in[p]);
+        pl_tex_destroy(g->gpu, &g->fbo);
+        pl_buf_destroy(g->gpu, &g->buf);
+    }
+
+    pthread_mutex_destroy(&mg->lock);
+    talloc_free(mg);
+    *ptr = NULL;
+}
+
+// Creates a renderer for the given GPU, preloaded with its shader cache.
+// Must be called with the lock held.
+static struct pl_renderer *create_renderer(struct pl_multi_gpu *mg,
+                                           struct gpu_state *g)
+{
+    struct pl_renderer *rr = pl_renderer_create(mg->ctx, g->gpu);
+    if (rr && g->cache)
+        pl_renderer_load(rr, g->cache, g->cache_size);
+    return rr;
+}
+
+// Must be called with the lock held
+static void save_renderer(struct pl_multi_gpu *mg, struct gpu_state *g,
+                          struct pl_renderer *rr)
+{
+    g->cache_size = pl_renderer_save(rr, NULL);
+    g->cache = talloc_realloc_size(mg, g->cache, g->cache_size);
+    pl_renderer_save(rr, g->cache);
+}
+
+bool pl_multi_gpu_open_stream(struct pl_multi_gpu *mg,
+                              struct pl_multi_stream *out)
+{
+    pthread_mutex_lock(&mg->lock);
+
+    // Pick the GPU which would end up with the lowest load
+    int best = 0;
+    for (int i = 1; i < mg->num_gpus; i++) {
+        const struct gpu_state *g = &mg->gpus[i], *b = &mg->gpus[best];
+        if ((g->num_streams + 1) / g->weight < (b->num_streams + 1) / b->weight)
+            best = i;
+    }
+
+    struct gpu_state *g = &mg->gpus[best];
+    struct pl_renderer *rr = create_renderer(mg, g);
+    if (rr)
+        g->num_streams++;
+    pthread_mutex_unlock(&mg->lock);
+
+    if (!rr) {
+        PL_ERR(mg, "Failed creating renderer for stream on GPU %d!", best);
+        return false;
+    }
+
+    PL_DEBUG(mg, "Opened stream on GPU %d (%d streams)", best, g->num_streams);
+    *out = (struct pl_multi_stream) {
+        .index = best,
+        .gpu = g->gpu,
+        .rr = rr,
+    };
+
+    return true;
+}
+
+void pl_multi_gpu_close_stream(struct pl_multi_gpu *mg,
+                               struct pl_multi_stream *stream)
+{
+    if (!stream->rr)
+        return;
+
+    pl_assert(stream->index >= 0 && stream->index < mg->num_gpus);
+    pthread_mutex_lock(&mg->lock);
+    struct gpu_state *g = &mg->gpus[stream->index];
+    save_renderer(mg, g, stream->rr);
+    pl_assert(g->num_streams > 0);
+    g->num_streams--;
+    pthread_mutex_unlock(&mg->lock);
+
+    pl_renderer_destroy(&stream->rr);
+    *stream = (struct pl_multi_stream) {0};
+}
+
+// Uploads the frame, and renders and starts downloading the band assigned to
+// this GPU, without waiting for the result
+static bool render_band(struct pl_multi_gpu *mg, struct gpu_state *g,
+                        const struct pl_multi_gpu_frame *frame,
+                        const struct pl_render_params *params)
+{
+    const struct pl_gpu *gpu = g->gpu;
+    const struct pl_fmt *fmt;
+    fmt = pl_find_fmt(gpu, frame->out_type, frame->out_comps, frame->out_depth,
+                      frame->out_depth, PL_FMT_CAP_RENDERABLE);
+    if (!fmt) {
+        // e.g. compute-only devices
+        fmt = pl_find_fmt(gpu, frame->out_type, frame->out_comps,
+                          frame->out_depth, frame->out_depth,
+                          PL_FMT_CAP_STORABLE);
+    }
+
+    if (!fmt) {
+        PL_ERR(mg, "No suitable output format for split-frame rendering!");
+        return false;
+    }
+
+    if (!g->rr) {
+        pthread_mutex_lock(&mg->lock);
+        g->rr = create_renderer(mg, g);
+        pthread_mutex_unlock(&mg->lock);
+        if (!g->rr)
+            return false;
+    }
+
+    struct pl_image image = frame->image;
+    for (int i = 0; i < frame->num_planes; i++) {
+        struct pl_plane plane;
+        if (!pl_upload_plane(gpu, &plane, &g->tex_in[i], &frame->planes[i]))
+            return false;
+
+        image.planes[i].texture = plane.texture;
+        image.planes[i].components = plane.components;
+        for (int c = 0; c < PL_ARRAY_SIZE(plane.component_mapping); c++)
+            image.planes[i].component_mapping[c] = plane.component_mapping[c];
+    }
+
+    // Map the band onto the corresponding part of the source rect. Sampling
+    // still has access to the rest of the image, so the scalers produce the
+    // same results at the band edges as they would for the full frame
+    struct pl_rect2df src = image.src_rect;
+    if ((!src.x0 && !src.x1) || (!src.y0 && !src.y1))
+        src = (struct pl_rect2df) { 0, 0, image.width, image.height };
+
+    float sh = src.y1 - src.y0;
+    image.src_rect = (struct pl_rect2df) {
+        .x0 = src.x0,
+        .x1 = src.x1,
+        .y0 = src.y0 + sh * g->y0 / frame->out_h,
+        .y1 = src.y0 + sh * g->y1 / frame->out_h,
+    };
+
+    int h = g->y1 - g->y0;
+    bool ok = pl_tex_recreate(gpu, &g->fbo, &(struct pl_tex_params) {
+        .w              = frame->out_w,
+        .h              = h,
+        .format         = fmt,
+        .renderable     = !!(fmt->caps & PL_FMT_CAP_RENDERABLE),
+        .storable       = !!(fmt->caps & PL_FMT_CAP_STORABLE),
+        .host_readable  = true,
+    });
+
+    if (!ok) {
+        PL_ERR(mg, "Failed creating split-frame output texture!");
+        return false;
+    }
+
+    struct pl_render_target target = frame->target;
+    target.fbo = g->fbo;
+    target.dst_rect = (struct pl_rect2d) { 0, 0, frame->out_w, h };
+    if (!pl_render_image(g->rr, &image, &target, params))
+        return false;
+
+    // Align the stride to the optimal transfer stride, if possible
+    size_t row = fmt->texel_size * frame->out_w;
+    g->stride = PL_ALIGN(row, gpu->limits.align_tex_xfer_stride);
+    if (g->stride % fmt->texel_size)
+        g->stride = row;
+
+    bool mapped = gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS;
+    ok = pl_buf_recreate(gpu, &g->buf, &(struct pl_buf_params) {
+        .type           = PL_BUF_TEX_TRANSFER,
+        .size           = g->stride * h,
+        .host_mapped    = mapped,
+        .host_readable  = !mapped,
+        .memory_type    = PL_BUF_MEM_HOST,
+    });
+
+    if (!ok) {
+        PL_ERR(mg, "Failed creating split-frame download buffer!");
+        return false;
+    }
+
+    ok = pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex        = g->fbo,
+        .stride_w   = g->stride / fmt->texel_size,
+        .buf        = g->buf,
+    });
+
+    if (!ok)
+        return false;
+
+    // Kick off the work, so this GPU can get going while we submit the
+    // bands of the other GPUs
+    pl_gpu_flush(gpu);
+    return true;
+}
+
+bool pl_multi_gpu_render_split(struct pl_multi_gpu *mg,
+                               const struct pl_multi_gpu_frame *frame)
+{
+    if (frame->num_planes != frame->image.num_planes ||
+        frame->num_planes > PL_ARRAY_SIZE(frame->image.planes))
+    {
+        PL_ERR(mg, "Mismatched number of planes in split-frame render!");
+        return false;
+    }
+
+    if (frame->out_w <= 0 || frame->out_h <= 0 || frame->out_depth % 8) {
+        PL_ERR(mg, "Invalid output size or depth for split-frame render!");
+        return false;
+    }
+
+    struct pl_render_params params;
+    params = *PL_DEF(frame->params, &pl_render_default_params);
+    params.peak_detect_params = NULL;
+
+    // Distribute the rows proportionally to the weights
+    float total = 0.0, sum = 0.0;
+    for (int i = 0; i < mg->num_gpus; i++)
+        total += mg->gpus[i].weight;
+
+    int y = 0;
+    for (int i = 0; i < mg->num_gpus; i++) {
+        struct gpu_state *g = &mg->gpus[i];
+        sum += g->weight;
+        g->y0 = y;
+        g->y1 = y = i == mg->num_gpus - 1 ? frame->out_h
+                                          : lrintf(frame->out_h * sum / total);
+    }
+
+    bool ok = true;
+    for (int i = 0; i < mg->num_gpus && ok; i++) {
+        struct gpu_state *g = &mg->gpus[i];
+        if (g->y1 > g->y0)
+            ok = render_band(mg, g, frame, &params);
+    }
+
+    if (!ok)
+        return false;
+
+    size_t row = frame->out_w * frame->out_comps * frame->out_depth / 8;
+    for (int i = 0; i < mg->num_gpus; i++) {
+        struct gpu_state *g = &mg->gpus[i];
+        if (g->y1 <= g->y0)
+            continue;
+
+        while (pl_buf_poll(g->gpu, g->buf, UINT64_MAX))
+            ; // wait for this band to finish downloading
+
+        uint8_t *out = (uint8_t *) frame->out_data + g->y0 * frame->out_stride;
+        for (int r = 0; r < g->y1 - g->y0; r++) {
+            uint8_t *dst = out + r * frame->out_stride;
+            if (g->buf->data) {
+                memcpy(dst, g->buf->data + r * g->stride, row);
+            } else if (!pl_buf_read(g->gpu, g->buf, r * g->stride, dst, row)) {
+                PL_ERR(mg, "Failed reading back split-frame band!");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,225 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "context.h"
+#include "common.h"
+#include "gpu.h"
+
+#define DEFAULT_DEPTH 4
+
+// Each entry owns all of the resources used by a single frame, so that frames
+// in flight never have to wait on each other's textures
+struct entry {
+    const struct pl_tex *tex_in[4];
+    const struct pl_tex *fbo;
+    const struct pl_buf *buf;
+    uint8_t *host; // for GPUs without mapped buffers
+    struct pl_render_queue_result result;
+};
+
+struct pl_render_queue {
+    struct pl_context *ctx;
+    const struct pl_gpu *gpu;
+    struct pl_renderer *rr;
+
+    struct entry *entries;
+    int depth;
+    int idx_out; // index of the oldest frame in flight
+    int count;   // number of frames in flight
+};
+
+struct pl_render_queue *pl_render_queue_create(struct pl_context *ctx,
+                                               const struct pl_gpu *gpu,
+                                               struct pl_renderer *rr,
+                                               int depth)
+{
+    struct pl_render_queue *queue = talloc_ptrtype(NULL, queue);
+    *queue = (struct pl_render_queue) {
+        .ctx = ctx,
+        .gpu = gpu,
+        .rr = rr,
+        .depth = PL_DEF(depth, DEFAULT_DEPTH),
+    };
+
+    queue->entries = talloc_zero_array(queue, struct entry, queue->depth);
+    return queue;
+}
+
+void pl_render_queue_destroy(struct pl_render_queue **ptr)
+{
+    struct pl_render_queue *queue = *ptr;
+    if (!queue)
+        return;
+
+    const struct pl_gpu *gpu = queue->gpu;
+    for (int i = 0; i < queue->depth; i++) {
+        struct entry *e = &queue->entries[i];
+        for (int p = 0; p < PL_ARRAY_SIZE(e->tex_in); p++)
+            pl_tex_destroy(gpu, &e->tex_in[p]);
+        pl_tex_destroy(gpu, &e->fbo);
+        pl_buf_destroy(gpu, &e->buf);
+    }
+
+    talloc_free(queue);
+    *ptr = NULL;
+}
+
+bool pl_render_queue_full(const struct pl_render_queue *queue)
+{
+    return queue->count == queue->depth;
+}
+
+int pl_render_queue_pending(const struct pl_render_queue *queue)
+{
+    return queue->count;
+}
+
+bool pl_render_queue_push(struct pl_render_queue *queue,
+                          const struct pl_render_queue_frame *frame)
+{
+    const struct pl_gpu *gpu = queue->gpu;
+    const struct pl_fmt *fmt = frame->out_fmt;
+
+    if (pl_render_queue_full(queue)) {
+        PL_ERR(queue, "Pushing frame into a full render queue!");
+        return false;
+    }
+
+    if (frame->num_planes != frame->image.num_planes ||
+        frame->num_planes > PL_ARRAY_SIZE(frame->image.planes))
+    {
+        PL_ERR(queue, "Mismatched number of planes in render queue frame!");
+        return false;
+    }
+
+    if (!fmt || fmt->opaque || fmt->num_planes ||
+        !(fmt->caps & (PL_FMT_CAP_RENDERABLE | PL_FMT_CAP_STORABLE)))
+    {
+        PL_ERR(queue, "Render queue output format must be renderable (or "
+               "storable) and non-opaque!");
+        return false;
+    }
+
+    int idx = (queue->idx_out + queue->count) % queue->depth;
+    struct entry *e = &queue->entries[idx];
+
+    struct pl_image image = frame->image;
+    for (int i = 0; i < frame->num_planes; i++) {
+        struct pl_plane plane;
+        if (!pl_upload_plane(gpu, &plane, &e->tex_in[i], &frame->planes[i]))
+            return false;
+
+        image.planes[i].texture = plane.texture;
+        image.planes[i].components = plane.components;
+        for (int c = 0; c < PL_ARRAY_SIZE(plane.component_mapping); c++)
+            image.planes[i].component_mapping[c] = plane.component_mapping[c];
+    }
+
+    bool ok = pl_tex_recreate(gpu, &e->fbo, &(struct pl_tex_params) {
+        .w              = frame->out_w,
+        .h              = frame->out_h,
+        .format         = fmt,
+        .renderable     = !!(fmt->caps & PL_FMT_CAP_RENDERABLE),
+        .host_readable  = true,
+        .blit_dst       = !!(fmt->caps & PL_FMT_CAP_BLITTABLE),
+        .storable       = !!(fmt->caps & PL_FMT_CAP_STORABLE),
+    });
+
+    if (!ok) {
+        PL_ERR(queue, "Failed creating render queue output texture!");
+        return false;
+    }
+
+    struct pl_render_target target = frame->target;
+    target.fbo = e->fbo;
+    if (!pl_render_image(queue->rr, &image, &target, frame->params))
+        return false;
+
+    // Align the stride to the optimal transfer stride, if possible
+    size_t row = fmt->texel_size * frame->out_w;
+    size_t stride = PL_ALIGN(row, gpu->limits.align_tex_xfer_stride);
+    if (stride % fmt->texel_size)
+        stride = row;
+
+    bool mapped = gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS;
+    ok = pl_buf_recreate(gpu, &e->buf, &(struct pl_buf_params) {
+        .type           = PL_BUF_TEX_TRANSFER,
+        .size           = stride * frame->out_h,
+        .host_mapped    = mapped,
+        .host_readable  = !mapped,
+        .memory_type    = PL_BUF_MEM_HOST,
+    });
+
+    if (!ok) {
+        PL_ERR(queue, "Failed creating render queue download buffer!");
+        return false;
+    }
+
+    ok = pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex        = e->fbo,
+        .stride_w   = stride / fmt->texel_size,
+        .buf        = e->buf,
+    });
+
+    if (!ok)
+        return false;
+
+    // Kick off the work for this frame, so the GPU can start processing it
+    // while we prepare the next one
+    pl_gpu_flush(gpu);
+
+    e->result = (struct pl_render_queue_result) {
+        .priv       = frame->priv,
+        .w          = frame->out_w,
+        .h          = frame->out_h,
+        .fmt        = fmt,
+        .row_stride = stride,
+        .size       = stride * frame->out_h,
+    };
+
+    queue->count++;
+    return true;
+}
+
+bool pl_render_queue_pop(struct pl_render_queue *queue,
+                         struct pl_render_queue_result *out, uint64_t timeout)
+{
+    const struct pl_gpu *gpu = queue->gpu;
+    if (!queue->count)
+        return false;
+
+    struct entry *e = &queue->entries[queue->idx_out];
+    if (pl_buf_poll(gpu, e->buf, timeout))
+        return false;
+
+    queue->idx_out = (queue->idx_out + 1) % queue->depth;
+    queue->count--;
+
+    if (e->buf->data) {
+        e->result.data = e->buf->data;
+    } else {
+        e->host = talloc_realloc_size(queue, e->host, e->result.size);
+        if (!pl_buf_read(gpu, e->buf, 0, e->host, e->result.size)) {
+            PL_ERR(queue, "Failed reading back rendered frame!");
+            return false;
+        }
+        e->result.data = e->host;
+    }
+
+    *out = e->result;
+    return true;
+}
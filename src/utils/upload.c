@@ -20,6 +20,7 @@
 #include "context.h"
 #include "common.h"
 #include "gpu.h"
+#include "shaders.h"
 
 struct comp {
     int order; // e.g. 0, 1, 2, 3 for RGBA
@@ -116,8 +117,30 @@ next_fmt: ; // acts as `continue`
     return NULL;
 }
 
-bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
-                     const struct pl_tex **tex, const struct pl_plane_data *data)
+static void fill_plane(struct pl_plane *out_plane, const struct pl_tex *tex,
+                       const int out_map[4])
+{
+    if (!out_plane)
+        return;
+
+    *out_plane = (struct pl_plane) { .texture = tex };
+    for (int i = 0; i < 4; i++) {
+        out_plane->component_mapping[i] = out_map[i];
+        if (out_map[i] >= 0)
+            out_plane->components = i+1;
+    }
+}
+
+static bool upload_plane_unpack(const struct pl_gpu *gpu,
+                                struct pl_dispatch *dp,
+                                struct pl_plane *out_plane,
+                                const struct pl_tex **tex,
+                                const struct pl_plane_data *data,
+                                size_t row_stride);
+
+static bool upload_plane(const struct pl_gpu *gpu, struct pl_dispatch *dp,
+                         struct pl_plane *out_plane, const struct pl_tex **tex,
+                         const struct pl_plane_data *data)
 {
     pl_assert(!data->buf ^ !data->pixels); // exactly one
 
@@ -135,14 +158,15 @@ bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
 
     int out_map[4];
     const struct pl_fmt *fmt = pl_plane_find_fmt(gpu, out_map, data);
+    if (!fmt && dp)
+        return upload_plane_unpack(gpu, dp, out_plane, tex, data, row_stride);
+
     if (!fmt) {
         PL_ERR(gpu, "Failed picking any compatible texture format for a plane!");
         return false;
-
-        // TODO: try soft-converting to a supported format using e.g zimg?
     }
 
-    bool ok = pl_tex_recreate(gpu, tex, &(struct pl_tex_params) {
+    struct pl_tex_params params = {
         .w = data->width,
         .h = data->height,
         .format = fmt,
@@ -153,27 +177,496 @@ bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
         .sample_mode = (fmt->caps & PL_FMT_CAP_LINEAR)
                             ? PL_TEX_SAMPLE_LINEAR
                             : PL_TEX_SAMPLE_NEAREST,
-    });
+    };
 
-    if (!ok) {
+    // Partial updates require the previous contents, so avoid going through
+    // `pl_tex_recreate` (which invalidates the texture) if it's unchanged
+    const struct pl_tex *old = *tex;
+    bool partial = data->num_rects && old &&
+                   old->params.w == params.w &&
+                   old->params.h == params.h &&
+                   old->params.format == params.format &&
+                   old->params.sampleable &&
+                   old->params.host_writable &&
+                   old->params.blit_src == params.blit_src &&
+                   old->params.address_mode == params.address_mode &&
+                   old->params.sample_mode == params.sample_mode;
+
+    if (!partial && !pl_tex_recreate(gpu, tex, &params)) {
         PL_ERR(gpu, "Failed initializing plane texture!");
         return false;
     }
 
-    if (out_plane) {
-        *out_plane = (struct pl_plane) { .texture = *tex };
-        for (int i = 0; i < PL_ARRAY_SIZE(out_map); i++) {
-            out_plane->component_mapping[i] = out_map[i];
-            if (out_map[i] >= 0)
-                out_plane->components = i+1;
-        }
-    }
+    fill_plane(out_plane, *tex, out_map);
 
-    return pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+    struct pl_tex_transfer_params tparams = {
         .tex        = *tex,
         .stride_w   = stride_texels,
         .ptr        = (void *) data->pixels,
         .buf        = data->buf,
         .buf_offset = data->buf_offset,
+    };
+
+    // If the damaged area is most of the plane anyway, a single full upload
+    // is cheaper than many small ones
+    struct pl_rect2d *rects = NULL;
+    int num_rects = 0;
+    size_t area = 0;
+    for (int i = 0; partial && i < data->num_rects; i++) {
+        struct pl_rect2d rc = data->rects[i];
+        pl_rect2d_normalize(&rc);
+        rc.x0 = PL_MAX(rc.x0, 0);
+        rc.y0 = PL_MAX(rc.y0, 0);
+        rc.x1 = PL_MIN(rc.x1, data->width);
+        rc.y1 = PL_MIN(rc.y1, data->height);
+        if (rc.x1 <= rc.x0 || rc.y1 <= rc.y0)
+            continue;
+
+        TARRAY_APPEND(NULL, rects, num_rects, rc);
+        area += (size_t) pl_rect_w(rc) * pl_rect_h(rc);
+    }
+
+    if (!partial || area * 2 > (size_t) data->width * data->height) {
+        talloc_free(rects);
+        return pl_tex_upload(gpu, &tparams);
+    }
+
+    // Record all of the updates into as few commands as possible
+    bool ok = true;
+    pl_gpu_batch(gpu, true);
+    for (int i = 0; i < num_rects; i++) {
+        struct pl_rect2d rc = rects[i];
+        size_t offset = rc.y0 * row_stride + rc.x0 * data->pixel_stride;
+        struct pl_tex_transfer_params rparams = tparams;
+        rparams.rc = (struct pl_rect3d) { rc.x0, rc.y0, 0, rc.x1, rc.y1, 1 };
+        if (data->pixels) {
+            rparams.ptr = (uint8_t *) data->pixels + offset;
+        } else {
+            rparams.buf_offset += offset;
+        }
+
+        ok &= pl_tex_upload(gpu, &rparams);
+    }
+    pl_gpu_batch(gpu, false);
+
+    talloc_free(rects);
+    return ok;
+}
+
+bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
+                     const struct pl_tex **tex, const struct pl_plane_data *data)
+{
+    return upload_plane(gpu, NULL, out_plane, tex, data);
+}
+
+bool pl_upload_plane_compute(const struct pl_gpu *gpu, struct pl_dispatch *dp,
+                             struct pl_plane *out_plane,
+                             const struct pl_tex **tex,
+                             const struct pl_plane_data *data)
+{
+    return upload_plane(gpu, dp, out_plane, tex, data);
+}
+
+static size_t gcd(size_t a, size_t b)
+{
+    while (b) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static size_t lcm(size_t a, size_t b)
+{
+    return a / gcd(a, b) * b;
+}
+
+bool pl_upload_planes(const struct pl_gpu *gpu, struct pl_plane out_planes[],
+                      const struct pl_tex *tex[],
+                      const struct pl_plane_data data[], int num_planes)
+{
+    // Lay out all of the host memory planes in a single staging buffer
+    size_t *offsets = talloc_array(NULL, size_t, num_planes);
+    size_t size = 0;
+    for (int i = 0; i < num_planes; i++) {
+        pl_assert(!data[i].buf ^ !data[i].pixels); // exactly one
+        if (data[i].buf)
+            continue;
+
+        // The offset must satisfy the requirements of `pl_upload_plane` as
+        // well as the GPU's preferred alignment
+        size_t align = lcm(4, data[i].pixel_stride);
+        if (gpu->limits.align_tex_xfer_offset)
+            align = lcm(align, gpu->limits.align_tex_xfer_offset);
+
+        size_t row_stride = PL_DEF(data[i].row_stride,
+                                   data[i].pixel_stride * data[i].width);
+        offsets[i] = PL_ALIGN(size, align);
+        size = offsets[i] + row_stride * (data[i].height - 1) +
+               data[i].pixel_stride * data[i].width;
+    }
+
+    const struct pl_buf *buf = NULL;
+    bool ok = true;
+    if (size) {
+        bool mapped = gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS;
+        buf = pl_buf_create(gpu, &(struct pl_buf_params) {
+            .type = PL_BUF_TEX_TRANSFER,
+            .size = size,
+            .host_mapped = mapped,
+            .host_writable = !mapped,
+            .memory_type = PL_BUF_MEM_HOST,
+        });
+
+        if (!buf) {
+            PL_ERR(gpu, "Failed creating staging buffer for plane upload!");
+            ok = false;
+            goto done;
+        }
+
+        for (int i = 0; i < num_planes; i++) {
+            if (data[i].buf)
+                continue;
+
+            size_t row_stride = PL_DEF(data[i].row_stride,
+                                       data[i].pixel_stride * data[i].width);
+            size_t plane_size = row_stride * (data[i].height - 1) +
+                                data[i].pixel_stride * data[i].width;
+            if (buf->data) {
+                memcpy(buf->data + offsets[i], data[i].pixels, plane_size);
+            } else {
+                pl_buf_write(gpu, buf, offsets[i], data[i].pixels, plane_size);
+            }
+        }
+    }
+
+    // Record all of the copies into as few commands as possible
+    pl_gpu_batch(gpu, true);
+    for (int i = 0; i < num_planes; i++) {
+        struct pl_plane_data plane = data[i];
+        if (!plane.buf) {
+            plane.pixels = NULL;
+            plane.buf = buf;
+            plane.buf_offset = offsets[i];
+        }
+
+        struct pl_plane *out = out_planes ? &out_planes[i] : NULL;
+        ok &= upload_plane(gpu, NULL, out, &tex[i], &plane);
+    }
+    pl_gpu_batch(gpu, false);
+
+done:
+    pl_buf_destroy(gpu, &buf);
+    talloc_free(offsets);
+    return ok;
+}
+
+#define DEFAULT_RING_CHUNKS 4
+
+struct pl_upload_ring {
+    const struct pl_gpu *gpu;
+    size_t chunk_size;
+    const struct pl_buf **chunks;
+    int num_chunks;
+    int idx;    // index of the chunk currently being allocated from
+    size_t pos; // offset of the first free byte in the current chunk
+};
+
+struct pl_upload_ring *pl_upload_ring_create(const struct pl_gpu *gpu,
+                                             const struct pl_upload_ring_params *params)
+{
+    if (!(gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS)) {
+        PL_ERR(gpu, "pl_upload_ring requires PL_GPU_CAP_MAPPED_BUFFERS!");
+        return NULL;
+    }
+
+    if (!params->chunk_size || params->chunk_size > gpu->limits.max_xfer_size) {
+        PL_ERR(gpu, "Invalid upload ring chunk size %zu!", params->chunk_size);
+        return NULL;
+    }
+
+    struct pl_upload_ring *ring = talloc_ptrtype(NULL, ring);
+    *ring = (struct pl_upload_ring) {
+        .gpu = gpu,
+        .chunk_size = params->chunk_size,
+        .num_chunks = PL_DEF(params->num_chunks, DEFAULT_RING_CHUNKS),
+    };
+
+    ring->chunks = talloc_zero_array(ring, const struct pl_buf *, ring->num_chunks);
+    return ring;
+}
+
+void pl_upload_ring_destroy(struct pl_upload_ring **ptr)
+{
+    struct pl_upload_ring *ring = *ptr;
+    if (!ring)
+        return;
+
+    for (int i = 0; i < ring->num_chunks; i++)
+        pl_buf_destroy(ring->gpu, &ring->chunks[i]);
+
+    talloc_free(ring);
+    *ptr = NULL;
+}
+
+bool pl_upload_ring_get(struct pl_upload_ring *ring,
+                        struct pl_upload_region *region,
+                        size_t size, size_t align)
+{
+    const struct pl_gpu *gpu = ring->gpu;
+    align = lcm(4, PL_DEF(align, 1));
+    if (gpu->limits.align_tex_xfer_offset)
+        align = lcm(align, gpu->limits.align_tex_xfer_offset);
+
+    if (size > ring->chunk_size) {
+        PL_ERR(gpu, "Upload ring region of size %zu exceeds the chunk size "
+               "(%zu)!", size, ring->chunk_size);
+        return false;
+    }
+
+    const struct pl_buf *buf = ring->chunks[ring->idx];
+    size_t pos = PL_ALIGN(ring->pos, align);
+    if (!buf || pos + size > ring->chunk_size) {
+        if (buf) {
+            // Move on to the next chunk, which the GPU may still be using
+            // for any uploads from the previous time around
+            ring->idx = (ring->idx + 1) % ring->num_chunks;
+            buf = ring->chunks[ring->idx];
+            if (buf) {
+                while (pl_buf_poll(gpu, buf, UINT64_MAX))
+                    ; // do nothing
+            }
+        }
+
+        if (!buf) {
+            buf = ring->chunks[ring->idx] = pl_buf_create(gpu, &(struct pl_buf_params) {
+                .type = PL_BUF_TEX_TRANSFER,
+                .size = ring->chunk_size,
+                .host_mapped = true,
+                .memory_type = PL_BUF_MEM_HOST,
+            });
+
+            if (!buf) {
+                PL_ERR(gpu, "Failed creating upload ring buffer!");
+                return false;
+            }
+        }
+
+        pos = 0;
+    }
+
+    *region = (struct pl_upload_region) {
+        .buf = buf,
+        .offset = pos,
+        .data = buf->data + pos,
+        .size = size,
+    };
+
+    ring->pos = pos + size;
+    return true;
+}
+
+// Picks the texture format to unpack `num` components of at least `depth`
+// bits into, or NULL if none is available
+static const struct pl_fmt *find_unpack_fmt(const struct pl_gpu *gpu,
+                                            enum pl_fmt_type type,
+                                            int num, int depth)
+{
+    // Integers which don't fit into 16-bit UNORM textures are unpacked into
+    // floats instead, which still represent up to 24 bits exactly
+    if (type == PL_FMT_UNORM && depth > 16) {
+        type = PL_FMT_FLOAT;
+        depth = 32;
+    }
+
+    // Storage images with fewer components are often not supported, so
+    // also try padding the texture with unused components
+    enum pl_fmt_caps caps = PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_STORABLE;
+    for (int n = num; n <= 4; n++) {
+        const struct pl_fmt *fmt = pl_find_fmt(gpu, type, n, depth, 0, caps);
+        if (fmt && fmt->glsl_format)
+            return fmt;
+    }
+
+    return NULL;
+}
+
+static bool upload_plane_unpack(const struct pl_gpu *gpu,
+                                struct pl_dispatch *dp,
+                                struct pl_plane *out_plane,
+                                const struct pl_tex **tex,
+                                const struct pl_plane_data *data,
+                                size_t row_stride)
+{
+    if (data->type != PL_FMT_UNORM && data->type != PL_FMT_FLOAT) {
+        PL_ERR(gpu, "Unpacking planes in a compute shader is only supported "
+               "for UNORM and FLOAT data!");
+        return false;
+    }
+
+    if (data->buf && data->buf->params.type != PL_BUF_STORAGE) {
+        PL_ERR(gpu, "Unpacking planes from a `pl_buf` requires the buffer to "
+               "be of type PL_BUF_STORAGE!");
+        return false;
+    }
+
+    // Work out the position of every component, in memory order
+    struct comp comps[4];
+    int num = 0, depth = 0, offset = 0;
+    int out_map[4] = {-1, -1, -1, -1};
+    for (int i = 0; i < PL_ARRAY_SIZE(data->component_size); i++) {
+        int size = data->component_size[i];
+        offset += data->component_pad[i];
+        if (!size)
+            continue;
+
+        if (size > 32 || (data->type == PL_FMT_FLOAT && size != 16 && size != 32)) {
+            PL_ERR(gpu, "Unsupported component size %d for unpacking!", size);
+            return false;
+        }
+
+        out_map[num] = data->component_map[i];
+        comps[num++] = (struct comp) {
+            .order = data->component_map[i],
+            .size = size,
+            .shift = offset,
+        };
+        depth = PL_MAX(depth, size);
+        offset += size;
+    }
+
+    if (!num || offset > data->pixel_stride * 8) {
+        PL_ERR(gpu, "Plane components don't fit into the pixel stride!");
+        return false;
+    }
+
+    const struct pl_fmt *fmt = find_unpack_fmt(gpu, data->type, num, depth);
+    if (!fmt || !(gpu->caps & PL_GPU_CAP_COMPUTE)) {
+        PL_ERR(gpu, "Failed picking any compatible texture format for a plane, "
+               "or unpacking it in a compute shader!");
+        return false;
+    }
+
+    bool ok = pl_tex_recreate(gpu, tex, &(struct pl_tex_params) {
+        .w = data->width,
+        .h = data->height,
+        .format = fmt,
+        .sampleable = true,
+        .storable = true,
+        .blit_src = !!(fmt->caps & PL_FMT_CAP_BLITTABLE),
+        .address_mode = PL_TEX_ADDRESS_CLAMP,
+        .sample_mode = (fmt->caps & PL_FMT_CAP_LINEAR)
+                            ? PL_TEX_SAMPLE_LINEAR
+                            : PL_TEX_SAMPLE_NEAREST,
     });
+
+    if (!ok) {
+        PL_ERR(gpu, "Failed initializing plane texture!");
+        return false;
+    }
+
+    fill_plane(out_plane, *tex, out_map);
+
+    // Get the raw bytes onto the GPU, as-is
+    const struct pl_buf *buf = data->buf, *tmp = NULL;
+    size_t buf_offset = data->buf_offset;
+    if (!buf) {
+        size_t size = row_stride * (data->height - 1) +
+                      data->pixel_stride * data->width;
+        tmp = buf = pl_buf_create(gpu, &(struct pl_buf_params) {
+            .type = PL_BUF_STORAGE,
+            .size = PL_ALIGN2(size, 4),
+            .host_writable = true,
+        });
+
+        if (!buf) {
+            PL_ERR(gpu, "Failed creating buffer for unpacking plane!");
+            return false;
+        }
+
+        pl_buf_write(gpu, buf, 0, data->pixels, size);
+        buf_offset = 0;
+    }
+
+    struct pl_shader *sh = pl_dispatch_begin(dp);
+    void *tactx = talloc_new(NULL);
+    struct pl_shader_desc desc = {
+        .desc = {
+            .name   = "UnpackBuf",
+            .type   = PL_DESC_BUF_STORAGE,
+            .access = PL_DESC_ACCESS_READONLY,
+        },
+        .object = buf,
+    };
+
+    struct pl_var words = pl_var_uint("unpack_words");
+    words.dim_a = buf->params.size / sizeof(uint32_t);
+    struct pl_var_layout layout;
+    ok = sh_buf_desc_append(tactx, gpu, &desc, &layout, words);
+
+    const int bw = 32, bh = 8;
+    if (!ok || !sh_try_compute(sh, bw, bh, false, 0)) {
+        PL_ERR(gpu, "Failed generating compute shader for unpacking plane!");
+        pl_dispatch_abort(dp, &sh);
+        goto done;
+    }
+
+    sh_desc(sh, desc);
+    ident_t img = sh_desc(sh, (struct pl_shader_desc) {
+        .desc = {
+            .name   = "image",
+            .type   = PL_DESC_STORAGE_IMG,
+            .access = PL_DESC_ACCESS_WRITEONLY,
+        },
+        .object = *tex,
+    });
+
+    GLSL("ivec2 pos = ivec2(gl_GlobalInvocationID.xy);                \n"
+         "if (pos.x < %d && pos.y < %d) {                             \n"
+         "    uint base = %zuu + uint(pos.y) * %zuu + uint(pos.x) * %zuu; \n"
+         "    vec4 color = vec4(0.0, 0.0, 0.0, 1.0);                  \n"
+         "    uint idx, bit, v;                                       \n",
+         data->width, data->height, buf_offset, row_stride, data->pixel_stride);
+
+    for (int i = 0; i < num; i++) {
+        // Components may straddle two words, e.g. for pixel strides which
+        // are not a multiple of 4 bytes
+        GLSL("    bit = (base & 3u) * 8u + %du;                     \n"
+             "    idx = (base >> 2) + (bit >> 5);                   \n"
+             "    bit &= 31u;                                       \n"
+             "    v = unpack_words[idx] >> bit;                     \n"
+             "    if (bit + %du > 32u)                              \n"
+             "        v |= unpack_words[idx + 1u] << (32u - bit);   \n",
+             comps[i].shift, comps[i].size);
+
+        if (comps[i].size < 32)
+            GLSL("    v &= %zuu; \n", ((size_t) 1 << comps[i].size) - 1);
+
+        if (data->type == PL_FMT_FLOAT && comps[i].size == 16) {
+            GLSL("    color[%d] = unpackHalf2x16(v).x; \n", i);
+        } else if (data->type == PL_FMT_FLOAT) {
+            GLSL("    color[%d] = uintBitsToFloat(v); \n", i);
+        } else {
+            GLSL("    color[%d] = float(v) / %f; \n", i,
+                 (double) ((UINT64_C(1) << comps[i].size) - 1));
+        }
+    }
+
+    GLSL("    imageStore(%s, pos, color); \n"
+         "}                               \n", img);
+
+    int groups[3] = {
+        (data->width  + bw - 1) / bw,
+        (data->height + bh - 1) / bh,
+        1,
+    };
+
+    ok = pl_dispatch_compute(dp, &sh, groups);
+    // fall through
+
+done:
+    talloc_free(tactx);
+    pl_buf_destroy(gpu, &tmp);
+    return ok;
 }
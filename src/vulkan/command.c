@@ -18,13 +18,86 @@
 #include "command.h"
 #include "utils.h"
 
-// returns VK_SUCCESS (completed), VK_TIMEOUT (not yet completed) or an error
+// returns VK_SUCCESS (reached), VK_TIMEOUT (not yet reached) or an error.
+// Must be called with `vk->lock` held, which is released while blocking
+static VkResult vk_timeline_poll(struct vk_ctx *vk, struct vk_timeline *tl,
+                                 uint64_t value, uint64_t timeout)
+{
+    if (tl->done >= value)
+        return VK_SUCCESS;
+
+#ifdef VK_KHR_timeline_semaphore
+    VkResult res;
+    if (!timeout) {
+        uint64_t cur;
+        res = vk->vkGetSemaphoreCounterValueKHR(vk->dev, tl->sem, &cur);
+        if (res != VK_SUCCESS)
+            return res;
+        tl->done = PL_MAX(tl->done, cur);
+        return tl->done >= value ? VK_SUCCESS : VK_TIMEOUT;
+    }
+
+    VkSemaphoreWaitInfoKHR winfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+        .semaphoreCount = 1,
+        .pSemaphores = &tl->sem,
+        .pValues = &value,
+    };
+
+    // Don't prevent other threads from submitting commands in the meantime
+    pthread_mutex_unlock(&vk->lock);
+    res = vk->vkWaitSemaphoresKHR(vk->dev, &winfo, timeout);
+    pthread_mutex_lock(&vk->lock);
+    if (res == VK_SUCCESS)
+        tl->done = PL_MAX(tl->done, value);
+    return res;
+#else
+    abort();
+#endif
+}
+
+// returns VK_SUCCESS (completed), VK_TIMEOUT (not yet completed) or an error.
+// Must be called with `vk->lock` held. Note that waiting on a fence keeps
+// holding the lock, since the fence gets reset when the command is reused.
 static VkResult vk_cmd_poll(struct vk_ctx *vk, struct vk_cmd *cmd,
                             uint64_t timeout)
 {
+    if (!cmd->submitted)
+        return VK_SUCCESS;
+    if (cmd->timeline)
+        return vk_timeline_poll(vk, cmd->timeline, cmd->value, timeout);
+
     return vkWaitForFences(vk->dev, 1, &cmd->fence, false, timeout);
 }
 
+bool vk_sync_point_wait(struct vk_ctx *vk, struct vk_sync_point point,
+                        uint64_t timeout)
+{
+    struct vk_cmd *cmd = point.cmd;
+    if (!cmd)
+        return true;
+
+    bool ret = true;
+    pthread_mutex_lock(&vk->lock);
+    if (cmd->gen != point.gen)
+        goto done; // already completed
+
+    ret = false;
+    if (!cmd->submitted)
+        goto done; // still being recorded, nothing to wait on
+
+    // Make sure the command was actually submitted to the GPU
+    if (timeout)
+        vk_flush_commands(vk);
+
+    ret = vk_cmd_poll(vk, cmd, timeout) == VK_SUCCESS;
+    ret |= cmd->gen != point.gen; // completed while the lock was released
+
+done:
+    pthread_mutex_unlock(&vk->lock);
+    return ret;
+}
+
 static void vk_cmd_reset(struct vk_ctx *vk, struct vk_cmd *cmd)
 {
     for (int i = 0; i < cmd->num_callbacks; i++) {
@@ -35,6 +108,11 @@ static void vk_cmd_reset(struct vk_ctx *vk, struct vk_cmd *cmd)
     cmd->num_callbacks = 0;
     cmd->num_deps = 0;
     cmd->num_sigs = 0;
+    cmd->value = 0;
+    if (cmd->submitted)
+        cmd->pool->queue_pending[cmd->qidx]--;
+    cmd->submitted = false;
+    cmd->gen++; // invalidates all sync points referring to this use
 
     // also make sure to reset vk->last_cmd in case this was the last command
     if (vk->last_cmd == cmd)
@@ -46,28 +124,34 @@ static void vk_cmd_destroy(struct vk_ctx *vk, struct vk_cmd *cmd)
     if (!cmd)
         return;
 
-    vk_cmd_poll(vk, cmd, UINT64_MAX);
+    pl_assert(!cmd->submitted);
     vk_cmd_reset(vk, cmd);
     vkDestroyFence(vk->dev, cmd->fence, VK_ALLOC);
-    vkFreeCommandBuffers(vk->dev, cmd->pool->pool, 1, &cmd->buf);
+    vkFreeCommandBuffers(vk->dev, cmd->alloc->pool, 1, &cmd->buf);
 
     talloc_free(cmd);
 }
 
-static struct vk_cmd *vk_cmd_create(struct vk_ctx *vk, struct vk_cmdpool *pool)
+static struct vk_cmd *vk_cmd_create(struct vk_ctx *vk, struct vk_cmdpool *pool,
+                                    struct vk_cmdalloc *alloc)
 {
     struct vk_cmd *cmd = talloc_zero(NULL, struct vk_cmd);
     cmd->pool = pool;
+    cmd->alloc = alloc;
 
     VkCommandBufferAllocateInfo ainfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = pool->pool,
+        .commandPool = alloc->pool,
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = 1,
     };
 
     VK(vkAllocateCommandBuffers(vk->dev, &ainfo, &cmd->buf));
 
+    // Completion is tracked by the queue's timeline semaphore instead
+    if (pool->timelines)
+        return cmd;
+
     VkFenceCreateInfo finfo = {
         .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
         .flags = VK_FENCE_CREATE_SIGNALED_BIT,
@@ -83,15 +167,26 @@ error:
     return NULL;
 }
 
+// Returns a command to the allocator it came from. Must be called with
+// `vk->lock` held.
+static void vk_cmd_recycle(struct vk_cmd *cmd)
+{
+    struct vk_cmdalloc *alloc = cmd->alloc;
+    TARRAY_APPEND(alloc, alloc->cmds, alloc->num_cmds, cmd);
+}
+
 void vk_dev_callback(struct vk_ctx *vk, vk_cb callback,
                      const void *priv, const void *arg)
 {
+    // Callbacks always run with the lock held, including this one
+    pthread_mutex_lock(&vk->lock);
     if (vk->last_cmd) {
         vk_cmd_callback(vk->last_cmd, callback, priv, arg);
     } else {
         // The device was already idle, so we can just immediately call it
         callback((void *) priv, (void *) arg);
     }
+    pthread_mutex_unlock(&vk->lock);
 }
 
 void vk_cmd_callback(struct vk_cmd *cmd, vk_cb callback,
@@ -129,7 +224,10 @@ struct vk_signal *vk_cmd_signal(struct vk_ctx *vk, struct vk_cmd *cmd,
                                 VkPipelineStageFlags stage)
 {
     struct vk_signal *sig = NULL;
-    if (TARRAY_POP(vk->signals, vk->num_signals, &sig))
+    pthread_mutex_lock(&vk->lock);
+    bool found = TARRAY_POP(vk->signals, vk->num_signals, &sig);
+    pthread_mutex_unlock(&vk->lock);
+    if (found)
         goto done;
 
     // no available signal => initialize a new one
@@ -232,7 +330,11 @@ enum vk_wait_type vk_cmd_wait(struct vk_ctx *vk, struct vk_cmd *cmd,
     if (!sig)
         return VK_WAIT_NONE;
 
-    if (sig->source == cmd->queue && unsignal(vk, cmd, sig->semaphore)) {
+    pthread_mutex_lock(&vk->lock);
+    bool unsignaled = sig->source == cmd->queue && unsignal(vk, cmd, sig->semaphore);
+    pthread_mutex_unlock(&vk->lock);
+
+    if (unsignaled) {
         // If we can remove the semaphore signal operation from the history and
         // pretend it never happened, then we get to use the more efficient
         // synchronization primitives. However, this requires that we're still
@@ -277,19 +379,40 @@ struct vk_cmdpool *vk_cmdpool_create(struct vk_ctx *vk,
         .qf = qinfo.queueFamilyIndex,
         .queues = talloc_array(pool, VkQueue, qinfo.queueCount),
         .num_queues = qinfo.queueCount,
+        .queue_pending = talloc_zero_array(pool, int, qinfo.queueCount),
+        .queue_submitted = talloc_zero_array(pool, uint64_t, qinfo.queueCount),
     };
 
+    if (vk->thread_safe && pthread_key_create(&pool->key, NULL) != 0) {
+        PL_ERR(vk, "Failed creating thread-local storage key!");
+        talloc_free(pool);
+        vk->failed = true;
+        return NULL;
+    }
+
     for (int n = 0; n < pool->num_queues; n++)
         vkGetDeviceQueue(vk->dev, pool->qf, n, &pool->queues[n]);
 
-    VkCommandPoolCreateInfo cinfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
-                 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        .queueFamilyIndex = pool->qf,
-    };
+#ifdef VK_KHR_timeline_semaphore
+    if (vk->has_timeline) {
+        pool->timelines = talloc_zero_array(pool, struct vk_timeline,
+                                            pool->num_queues);
+
+        VkSemaphoreTypeCreateInfoKHR stinfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+            .initialValue = 0,
+        };
 
-    VK(vkCreateCommandPool(vk->dev, &cinfo, VK_ALLOC, &pool->pool));
+        VkSemaphoreCreateInfo sinfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &stinfo,
+        };
+
+        for (int n = 0; n < pool->num_queues; n++)
+            VK(vkCreateSemaphore(vk->dev, &sinfo, VK_ALLOC, &pool->timelines[n].sem));
+    }
+#endif
 
     return pool;
 
@@ -304,13 +427,64 @@ void vk_cmdpool_destroy(struct vk_ctx *vk, struct vk_cmdpool *pool)
     if (!pool)
         return;
 
-    for (int i = 0; i < pool->num_cmds; i++)
-        vk_cmd_destroy(vk, pool->cmds[i]);
+    for (int i = 0; i < pool->num_allocs; i++) {
+        struct vk_cmdalloc *alloc = pool->allocs[i];
+        for (int n = 0; n < alloc->num_cmds; n++)
+            vk_cmd_destroy(vk, alloc->cmds[n]);
+        vkDestroyCommandPool(vk->dev, alloc->pool, VK_ALLOC);
+    }
+
+    for (int i = 0; pool->timelines && i < pool->num_queues; i++)
+        vkDestroySemaphore(vk->dev, pool->timelines[i].sem, VK_ALLOC);
 
-    vkDestroyCommandPool(vk->dev, pool->pool, VK_ALLOC);
+    if (vk->thread_safe)
+        pthread_key_delete(pool->key);
     talloc_free(pool);
 }
 
+// Returns the vk_cmdalloc owned by the calling thread, creating it if needed
+static struct vk_cmdalloc *vk_cmdalloc_get(struct vk_ctx *vk,
+                                           struct vk_cmdpool *pool)
+{
+    struct vk_cmdalloc *alloc = NULL;
+    if (vk->thread_safe) {
+        alloc = pthread_getspecific(pool->key);
+    } else if (pool->num_allocs) {
+        alloc = pool->allocs[0];
+    }
+
+    if (alloc)
+        return alloc;
+
+    VkCommandPoolCreateInfo cinfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = pool->qf,
+    };
+
+    VkCommandPool cmdpool;
+    VK(vkCreateCommandPool(vk->dev, &cinfo, VK_ALLOC, &cmdpool));
+
+    // Allocators are only freed together with the vk_cmdpool, so any
+    // command buffers left over by threads that have since exited simply
+    // stay unused until then
+    pthread_mutex_lock(&vk->lock);
+    alloc = talloc_zero(pool, struct vk_cmdalloc);
+    alloc->pool = cmdpool;
+    TARRAY_APPEND(pool, pool->allocs, pool->num_allocs, alloc);
+    pthread_mutex_unlock(&vk->lock);
+
+    if (vk->thread_safe)
+        pthread_setspecific(pool->key, alloc);
+
+    PL_DEBUG(vk, "Created command pool %d for QF %d", pool->num_allocs, pool->qf);
+    return alloc;
+
+error:
+    return NULL;
+}
+
 struct vk_cmd *vk_cmd_begin(struct vk_ctx *vk, struct vk_cmdpool *pool)
 {
     // garbage collect the cmdpool first, to increase the chances of getting
@@ -318,11 +492,18 @@ struct vk_cmd *vk_cmd_begin(struct vk_ctx *vk, struct vk_cmdpool *pool)
     vk_poll_commands(vk, 0);
 
     struct vk_cmd *cmd = NULL;
-    if (TARRAY_POP(pool->cmds, pool->num_cmds, &cmd))
+    struct vk_cmdalloc *alloc = vk_cmdalloc_get(vk, pool);
+    if (!alloc)
+        goto error;
+
+    pthread_mutex_lock(&vk->lock);
+    bool found = TARRAY_POP(alloc->cmds, alloc->num_cmds, &cmd);
+    pthread_mutex_unlock(&vk->lock);
+    if (found)
         goto done;
 
     // No free command buffers => allocate another one
-    cmd = vk_cmd_create(vk, pool);
+    cmd = vk_cmd_create(vk, pool, alloc);
     if (!cmd)
         goto error;
 
@@ -335,7 +516,13 @@ done: ;
 
     VK(vkBeginCommandBuffer(cmd->buf, &binfo));
 
+    pthread_mutex_lock(&vk->lock);
+    cmd->qidx = pool->idx_queues;
     cmd->queue = pool->queues[pool->idx_queues];
+    if (pool->timelines)
+        cmd->timeline = &pool->timelines[pool->idx_queues];
+    pthread_mutex_unlock(&vk->lock);
+
     return cmd;
 
 error:
@@ -347,11 +534,18 @@ error:
 
 bool vk_cmd_queue(struct vk_ctx *vk, struct vk_cmd *cmd)
 {
-    struct vk_cmdpool *pool = cmd->pool;
-
     VK(vkEndCommandBuffer(cmd->buf));
 
-    VK(vkResetFences(vk->dev, 1, &cmd->fence));
+    if (cmd->fence)
+        VK(vkResetFences(vk->dev, 1, &cmd->fence));
+
+    pthread_mutex_lock(&vk->lock);
+    // Commands are submitted in the order they are queued, so this keeps the
+    // values monotonic per queue
+    if (cmd->timeline)
+        cmd->value = ++cmd->timeline->value;
+    cmd->submitted = true;
+    cmd->pool->queue_pending[cmd->qidx]++;
     TARRAY_APPEND(vk->ta, vk->cmds_queued, vk->num_cmds_queued, cmd);
     vk->last_cmd = cmd;
 
@@ -361,32 +555,41 @@ bool vk_cmd_queue(struct vk_ctx *vk, struct vk_cmd *cmd)
         vk_flush_commands(vk);
     }
 
+    pthread_mutex_unlock(&vk->lock);
     return true;
 
 error:
+    pthread_mutex_lock(&vk->lock);
     vk_cmd_reset(vk, cmd);
-    TARRAY_APPEND(pool, pool->cmds, pool->num_cmds, cmd);
+    vk_cmd_recycle(cmd);
     vk->failed = true;
+    pthread_mutex_unlock(&vk->lock);
     return false;
 }
 
 bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout)
 {
     bool ret = false;
+    uint64_t start = timeout ? pl_span_begin(vk->ctx) : 0;
+    pthread_mutex_lock(&vk->lock);
 
     if (timeout)
         vk_flush_commands(vk);
 
     while (vk->num_cmds_pending > 0) {
         struct vk_cmd *cmd = vk->cmds_pending[0];
-        struct vk_cmdpool *pool = cmd->pool;
         VkResult res = vk_cmd_poll(vk, cmd, timeout);
         if (res == VK_TIMEOUT)
             break;
+        if (!vk->num_cmds_pending || vk->cmds_pending[0] != cmd) {
+            // Another thread processed this command while we were waiting
+            timeout = 0;
+            continue;
+        }
         PL_TRACE(vk, "VkFence signalled: %p", (void *) cmd->fence);
         vk_cmd_reset(vk, cmd);
         TARRAY_REMOVE_AT(vk->cmds_pending, vk->num_cmds_pending, 0);
-        TARRAY_APPEND(pool, pool->cmds, pool->num_cmds, cmd);
+        vk_cmd_recycle(cmd);
         ret = true;
 
         // If we've successfully spent some time waiting for at least one
@@ -397,47 +600,123 @@ bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout)
         timeout = 0;
     }
 
+    pthread_mutex_unlock(&vk->lock);
+    pl_span_end(vk->ctx, "vk_poll_commands (wait)", start);
     return ret;
 }
 
-bool vk_flush_commands(struct vk_ctx *vk)
+// Fills in the submission info for a single command. `tinfo` must outlive
+// the submission, since it gets linked into `sinfo`
+static void prepare_submit(struct vk_ctx *vk, struct vk_cmd *cmd,
+                           VkSubmitInfo *sinfo, void *tinfo)
 {
-    bool ret = true;
-
-    for (int i = 0; i < vk->num_cmds_queued; i++) {
-        struct vk_cmd *cmd = vk->cmds_queued[i];
-        struct vk_cmdpool *pool = cmd->pool;
-
-        VkSubmitInfo sinfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &cmd->buf,
-            .waitSemaphoreCount = cmd->num_deps,
-            .pWaitSemaphores = cmd->deps,
-            .pWaitDstStageMask = cmd->depstages,
-            .signalSemaphoreCount = cmd->num_sigs,
-            .pSignalSemaphores = cmd->sigs,
+    const void *pnext = NULL;
+
+#ifdef VK_KHR_timeline_semaphore
+    if (cmd->timeline) {
+        // The values of binary semaphores are ignored, so only the last
+        // entry (the timeline itself) matters
+        vk_cmd_sig(cmd, cmd->timeline->sem);
+        TARRAY_GROW(cmd, cmd->sig_values, cmd->num_sigs - 1);
+        for (int n = 0; n < cmd->num_sigs - 1; n++)
+            cmd->sig_values[n] = 0;
+        cmd->sig_values[cmd->num_sigs - 1] = cmd->value;
+
+        *(VkTimelineSemaphoreSubmitInfoKHR *) tinfo = (VkTimelineSemaphoreSubmitInfoKHR) {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+            .signalSemaphoreValueCount = cmd->num_sigs,
+            .pSignalSemaphoreValues = cmd->sig_values,
         };
+        pnext = tinfo;
+    }
+#endif
+
+    *sinfo = (VkSubmitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = pnext,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd->buf,
+        .waitSemaphoreCount = cmd->num_deps,
+        .pWaitSemaphores = cmd->deps,
+        .pWaitDstStageMask = cmd->depstages,
+        .signalSemaphoreCount = cmd->num_sigs,
+        .pSignalSemaphores = cmd->sigs,
+    };
 
-        if (pl_msg_test(vk->ctx, PL_LOG_TRACE)) {
-            PL_TRACE(vk, "Submitting command on queue %p (QF %d):",
-                     (void *)cmd->queue, pool->qf);
-            for (int n = 0; n < cmd->num_deps; n++)
-                PL_TRACE(vk, "    waits on semaphore %p", (void *) cmd->deps[n]);
-            for (int n = 0; n < cmd->num_sigs; n++)
-                PL_TRACE(vk, "    signals semaphore %p", (void *) cmd->sigs[n]);
+    if (pl_msg_test(vk->ctx, PL_LOG_TRACE)) {
+        PL_TRACE(vk, "Submitting command on queue %p (QF %d):",
+                 (void *)cmd->queue, cmd->pool->qf);
+        for (int n = 0; n < cmd->num_deps; n++)
+            PL_TRACE(vk, "    waits on semaphore %p", (void *) cmd->deps[n]);
+        for (int n = 0; n < cmd->num_sigs; n++)
+            PL_TRACE(vk, "    signals semaphore %p", (void *) cmd->sigs[n]);
+        if (cmd->timeline) {
+            PL_TRACE(vk, "    signals timeline value %"PRIu64,
+                     cmd->value);
+        } else {
             PL_TRACE(vk, "    signals fence %p", (void *) cmd->fence);
         }
+    }
+}
 
-        VK(vkQueueSubmit(cmd->queue, 1, &sinfo, cmd->fence));
-        TARRAY_APPEND(vk->ta, vk->cmds_pending, vk->num_cmds_pending, cmd);
-        continue;
+bool vk_flush_commands(struct vk_ctx *vk)
+{
+    bool ret = true;
+    uint64_t start = pl_span_begin(vk->ctx);
+    pthread_mutex_lock(&vk->lock);
+
+    int num_queued = vk->num_cmds_queued;
+    TARRAY_GROW(vk->ta, vk->submits, num_queued);
+#ifdef VK_KHR_timeline_semaphore
+    TARRAY_GROW(vk->ta, vk->timeline_submits, num_queued);
+#endif
+
+    for (int i = 0; i < num_queued;) {
+        // Coalesce all consecutive commands targeting the same queue into a
+        // single vkQueueSubmit, since these are expensive on some drivers.
+        // The submissions are still executed in order, and each one keeps
+        // its own semaphores. However, a VkFence can only signal the
+        // completion of the entire batch, so a fenced command ends it.
+        VkQueue queue = vk->cmds_queued[i]->queue;
+        VkFence fence = VK_NULL_HANDLE;
+        int num = 0;
+        while (i + num < num_queued && !fence) {
+            struct vk_cmd *cmd = vk->cmds_queued[i + num];
+            if (cmd->queue != queue)
+                break;
+
+            void *tinfo = NULL;
+#ifdef VK_KHR_timeline_semaphore
+            tinfo = &vk->timeline_submits[i + num];
+#endif
+            prepare_submit(vk, cmd, &vk->submits[i + num], tinfo);
+            fence = cmd->fence;
+            num++;
+        }
 
-error:
-        vk_cmd_reset(vk, cmd);
-        TARRAY_APPEND(pool, pool->cmds, pool->num_cmds, cmd);
-        vk->failed = true;
-        ret = false;
+        PL_TRACE(vk, "vkQueueSubmit with %d command(s)", num);
+        VkResult res = vkQueueSubmit(queue, num, &vk->submits[i], fence);
+        vk->num_submits++;
+        vk->num_cmds_submitted += num;
+        if (res != VK_SUCCESS) {
+            PL_ERR(vk, "Failed submitting %d command(s) to queue %p: %s",
+                   num, (void *) queue, vk_res_str(res));
+            vk->failed = true;
+            ret = false;
+        }
+
+        for (int n = 0; n < num; n++) {
+            struct vk_cmd *cmd = vk->cmds_queued[i + n];
+            if (res == VK_SUCCESS) {
+                TARRAY_APPEND(vk->ta, vk->cmds_pending, vk->num_cmds_pending, cmd);
+                cmd->pool->queue_submitted[cmd->qidx]++;
+            } else {
+                vk_cmd_reset(vk, cmd);
+                vk_cmd_recycle(cmd);
+            }
+        }
+
+        i += num;
     }
 
     vk->num_cmds_queued = 0;
@@ -446,17 +725,31 @@ error:
     while (vk->num_cmds_pending > PL_VK_MAX_PENDING_CMDS)
         vk_poll_commands(vk, UINT64_MAX);
 
+    pthread_mutex_unlock(&vk->lock);
+    pl_span_end(vk->ctx, "vk_flush_commands", start);
     return ret;
 }
 
 void vk_rotate_queues(struct vk_ctx *vk)
 {
-    // Rotate the queues to ensure good parallelism across frames
+    // Rotate the queues to ensure good parallelism across frames. Rather
+    // than blindly cycling, skip over queues that are still busier than
+    // others (e.g. due to other threads or streams using the same pl_gpu)
+    pthread_mutex_lock(&vk->lock);
     for (int i = 0; i < vk->num_pools; i++) {
         struct vk_cmdpool *pool = vk->pools[i];
-        pool->idx_queues = (pool->idx_queues + 1) % pool->num_queues;
-        PL_TRACE(vk, "QF %d: %d/%d", pool->qf, pool->idx_queues, pool->num_queues);
+        int best = -1;
+        for (int n = 1; n <= pool->num_queues; n++) {
+            int idx = (pool->idx_queues + n) % pool->num_queues;
+            if (best < 0 || pool->queue_pending[idx] < pool->queue_pending[best])
+                best = idx;
+        }
+
+        pool->idx_queues = best;
+        PL_TRACE(vk, "QF %d: %d/%d (%d pending)", pool->qf, pool->idx_queues,
+                 pool->num_queues, pool->queue_pending[best]);
     }
+    pthread_mutex_unlock(&vk->lock);
 }
 
 void vk_wait_idle(struct vk_ctx *vk)
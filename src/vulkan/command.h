@@ -35,13 +35,33 @@ struct vk_callback {
 void vk_dev_callback(struct vk_ctx *vk, vk_cb callback,
                      const void *priv, const void *arg);
 
+// A timeline semaphore tracking the completion of all commands submitted to a
+// single VkQueue. Every command signals the next value on completion, so
+// polling for any number of commands is just a single counter read.
+struct vk_timeline {
+    VkSemaphore sem;
+    uint64_t value; // last value assigned to a command
+    uint64_t done;  // last value known to be reached (cached)
+};
+
 // Helper wrapper around command buffers that also track dependencies,
 // callbacks and synchronization primitives
 struct vk_cmd {
-    struct vk_cmdpool *pool; // pool it was allocated from
-    VkQueue queue;           // the submission queue (for recording/pending)
-    VkCommandBuffer buf;     // the command buffer itself
-    VkFence fence;           // the fence guards cmd buffer reuse
+    struct vk_cmdpool *pool;   // pool it was allocated from
+    struct vk_cmdalloc *alloc; // VkCommandPool it was allocated from
+    VkQueue queue;             // the submission queue (for recording/pending)
+    int qidx;                  // index of `queue` inside `pool->queues`
+    VkCommandBuffer buf;       // the command buffer itself
+    VkFence fence;             // the fence guards cmd buffer reuse (or NULL)
+    // If timeline semaphores are supported, these replace the fence. The
+    // value is only assigned once the command is queued, since commands
+    // recorded by different threads may be queued in any order.
+    struct vk_timeline *timeline;
+    uint64_t value;
+    // Whether the command is currently queued or pending execution
+    bool submitted;
+    // Incremented every time the command completes (see `vk_sync_point`)
+    uint64_t gen;
     // The semaphores represent dependencies that need to complete before
     // this command can be executed. These are *not* owned by the vk_cmd
     VkSemaphore *deps;
@@ -50,6 +70,7 @@ struct vk_cmd {
     // The signals represent semaphores that fire once the command finishes
     // executing. These are also not owned by the vk_cmd
     VkSemaphore *sigs;
+    uint64_t *sig_values; // scratch space for VkTimelineSemaphoreSubmitInfo
     int num_sigs;
     // Since VkFences are useless, we have to manually track "callbacks"
     // to fire once the VkFence completes. These are used for multiple purposes,
@@ -108,18 +129,55 @@ enum vk_wait_type vk_cmd_wait(struct vk_ctx *vk, struct vk_cmd *cmd,
 // longer relevant.
 void vk_signal_destroy(struct vk_ctx *vk, struct vk_signal **sig);
 
+// Refers to the completion of a command. Unlike a plain reference to the
+// vk_cmd, this remains valid after the command completes and gets recycled.
+struct vk_sync_point {
+    struct vk_cmd *cmd;
+    uint64_t gen;
+};
+
+static inline struct vk_sync_point vk_cmd_sync_point(const struct vk_cmd *cmd)
+{
+    return (struct vk_sync_point) { (struct vk_cmd *) cmd, cmd->gen };
+}
+
+// Block until the sync point is reached, for at most `timeout` nanoseconds.
+// Returns whether the sync point was reached, which is never the case while
+// the corresponding command is still being recorded. Note that this does
+// not process any callbacks.
+bool vk_sync_point_wait(struct vk_ctx *vk, struct vk_sync_point point,
+                        uint64_t timeout);
+
+// A VkCommandPool, together with the command buffers allocated from it that
+// are available for re-recording. Since recording requires exclusive access
+// to the VkCommandPool, every recording thread gets its own instance.
+struct vk_cmdalloc {
+    VkCommandPool pool;
+    struct vk_cmd **cmds;
+    int num_cmds;
+};
+
 // Command pool / queue family hybrid abstraction
 struct vk_cmdpool {
     VkQueueFamilyProperties props;
     int qf; // queue family index
-    VkCommandPool pool;
     VkQueue *queues;
+    struct vk_timeline *timelines; // one per queue, if `vk->has_timeline`
     int num_queues;
     int idx_queues;
-    // Command buffers associated with this queue. These are available for
-    // re-recording
-    struct vk_cmd **cmds;
-    int num_cmds;
+    // Occupancy counters, one per queue: the number of commands queued or
+    // executing, and the total number of commands ever submitted
+    int *queue_pending;
+    uint64_t *queue_submitted;
+    // All command allocators created for this queue family. Unless
+    // `vk->thread_safe`, there is only ever one of these.
+    struct vk_cmdalloc **allocs;
+    int num_allocs;
+    pthread_key_t key; // per-thread vk_cmdalloc (if `vk->thread_safe`)
+    // Estimated offset from GPU timestamps (in nanoseconds) on this queue
+    // family to `pl_clock_ns`, for tracing. Guarded by `vk->lock`
+    int64_t ts_offset;
+    bool ts_calibrated;
 };
 
 // Set up a vk_cmdpool corresponding to a queue family.
@@ -130,7 +188,8 @@ struct vk_cmdpool *vk_cmdpool_create(struct vk_ctx *vk,
 void vk_cmdpool_destroy(struct vk_ctx *vk, struct vk_cmdpool *pool);
 
 // Fetch a command buffer from a command pool and begin recording to it.
-// Returns NULL on failure.
+// Returns NULL on failure. The command must be recorded and queued by the
+// calling thread.
 struct vk_cmd *vk_cmd_begin(struct vk_ctx *vk, struct vk_cmdpool *pool);
 
 // Finish recording a command buffer and queue it for execution. This function
@@ -148,7 +207,8 @@ bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout);
 // commands will be implicitly dropped.
 bool vk_flush_commands(struct vk_ctx *vk);
 
-// Rotate through queues in each command pool. Call this once per frame, after
+// Switch each command pool to its least occupied queue, preferring the next
+// queue in round-robin order on ties. Call this once per frame, after
 // submitting all of the command buffers for that frame. Calling this more
 // often than that is possible but bad for performance.
 void vk_rotate_queues(struct vk_ctx *vk);
@@ -55,12 +55,26 @@ struct vk_ctx {
     VkPhysicalDevice physd;
     VkPhysicalDeviceLimits limits;
     VkPhysicalDeviceFeatures features;
+    uint32_t api_version; // usable API version, i.e. min(instance, device)
     VkExtent3D transfer_alignment; // for pool_transfer
     VkDevice dev;
 
     // Generic error flag for catching "failed" devices
     bool failed;
 
+    // If set, the device was created without any graphics queue (see
+    // `pl_vulkan_params.compute_only`). In this case, `pool_graphics` is the
+    // same as `pool_compute`, and must only ever be used for compute and
+    // transfer commands.
+    bool compute_only;
+
+    // If set, the pl_gpu may be used from multiple threads at the same time
+    // (see `pl_vulkan_params.thread_safe`). In this case, every thread
+    // records into its own VkCommandPool, and `lock` is always taken before
+    // touching any of the shared state below.
+    bool thread_safe;
+    pthread_mutex_t lock; // protects everything below, and all vk_cmdpools
+
     // Enabled extensions
     const char **exts;
     int num_exts;
@@ -69,7 +83,7 @@ struct vk_ctx {
     int num_pools;
 
     // Pointers into *pools
-    struct vk_cmdpool *pool_graphics; // required
+    struct vk_cmdpool *pool_graphics; // required (compute-only: see below)
     struct vk_cmdpool *pool_compute;  // optional
     struct vk_cmdpool *pool_transfer; // optional
 
@@ -80,6 +94,16 @@ struct vk_ctx {
     int num_cmds_queued;
     int num_cmds_pending;
 
+    // Counters for `pl_gpu_stats`
+    uint64_t num_submits;     // calls to vkQueueSubmit
+    uint64_t num_cmds_submitted;
+
+    // Scratch space for vk_flush_commands
+    VkSubmitInfo *submits;
+#ifdef VK_KHR_timeline_semaphore
+    VkTimelineSemaphoreSubmitInfoKHR *timeline_submits;
+#endif
+
     // A dynamic reference to the most recently submitted command that has not
     // yet completed. Used to implement vk_dev_callback. Gets cleared when
     // the command completes.
@@ -90,17 +114,52 @@ struct vk_ctx {
     int num_signals;
     bool disable_events;
 
+    // Whether to use timeline semaphores instead of fences for tracking
+    // command completion (VK_KHR_timeline_semaphore)
+    bool has_timeline;
+
+    // Whether the device supports the global texture heap, and it was
+    // requested by the user (VK_EXT_descriptor_indexing)
+    bool has_bindless;
+
+    // Whether multi-planar formats are usable (VK_KHR_sampler_ycbcr_conversion)
+    bool has_planar;
+
+    // Whether shaders may use 16-bit float arithmetic (VK_KHR_shader_float16_int8)
+    bool has_float16;
+    // Optional on-disk SPIR-V cache (for pl_gpu_create_vk)
+    const char *spirv_cache_dir;
+
     // Instance-level function pointers
     VK_FUN(vkGetPhysicalDeviceProperties2KHR);
     VK_FUN(vkGetPhysicalDeviceImageFormatProperties2KHR);
     VK_FUN(vkGetPhysicalDeviceExternalBufferPropertiesKHR);
     VK_FUN(vkGetPhysicalDeviceExternalSemaphorePropertiesKHR);
+    VK_FUN(vkGetPhysicalDeviceMemoryProperties2KHR); // only if memory_budget
+#ifdef VK_EXT_image_drm_format_modifier
+    VK_FUN(vkGetPhysicalDeviceFormatProperties2KHR); // only if drm modifiers
+#endif
 
     // Device-level function pointers
     VK_FUN(vkCmdPushDescriptorSetKHR);
     VK_FUN(vkGetMemoryFdKHR);
     VK_FUN(vkGetMemoryFdPropertiesKHR);
+#ifdef VK_EXT_external_memory_host
+    VK_FUN(vkGetMemoryHostPointerPropertiesEXT);
+#endif
+#ifdef VK_EXT_image_drm_format_modifier
+    VK_FUN(vkGetImageDrmFormatModifierPropertiesEXT);
+#endif
+    VK_FUN(vkGetImageMemoryRequirements2KHR);
     VK_FUN(vkGetSemaphoreFdKHR);
+#ifdef VK_KHR_timeline_semaphore
+    VK_FUN(vkGetSemaphoreCounterValueKHR);
+    VK_FUN(vkWaitSemaphoresKHR);
+#endif
+#ifdef VK_GOOGLE_display_timing
+    VK_FUN(vkGetRefreshCycleDurationGOOGLE); // only if display_timing
+    VK_FUN(vkGetPastPresentationTimingGOOGLE);
+#endif
 #ifdef VK_HAVE_WIN32
     VK_FUN(vkGetMemoryWin32HandleKHR);
     VK_FUN(vkGetSemaphoreWin32HandleKHR);
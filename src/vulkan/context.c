@@ -31,6 +31,7 @@ struct vk_ext_fun {
 struct vk_ext {
     const char *name;
     struct vk_ext_fun *funs;
+    bool swapchain; // requires VK_KHR_swapchain
 };
 
 #define VK_INST_FUN(N)                      \
@@ -84,6 +85,14 @@ static const struct vk_ext vk_device_extensions[] = {
             VK_DEV_FUN(vkGetMemoryFdPropertiesKHR),
             {0},
         },
+#ifdef VK_EXT_external_memory_host
+    }, {
+        .name = VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            VK_DEV_FUN(vkGetMemoryHostPointerPropertiesEXT),
+            {0},
+        },
+#endif
 #ifdef VK_HAVE_WIN32
     }, {
         .name = VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME,
@@ -111,6 +120,99 @@ static const struct vk_ext vk_device_extensions[] = {
             VK_DEV_FUN(vkGetSemaphoreWin32HandleKHR),
             {0},
         },
+#endif
+    }, {
+        .name = VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            VK_DEV_FUN(vkGetImageMemoryRequirements2KHR),
+            {0},
+        },
+    }, {
+        // Requires VK_KHR_get_memory_requirements2
+        .name = VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            {0},
+        },
+#ifdef VK_KHR_timeline_semaphore
+    }, {
+        .name = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            VK_DEV_FUN(vkGetSemaphoreCounterValueKHR),
+            VK_DEV_FUN(vkWaitSemaphoresKHR),
+            {0},
+        },
+#endif
+#ifdef VK_KHR_sampler_ycbcr_conversion
+    }, {
+        .name = VK_KHR_BIND_MEMORY_2_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            {0},
+        },
+    }, {
+        .name = VK_KHR_MAINTENANCE1_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            {0},
+        },
+    }, {
+        // Requires VK_KHR_maintenance1, VK_KHR_bind_memory2 and
+        // VK_KHR_get_memory_requirements2. Needed for planar formats
+        .name = VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            {0},
+        },
+#endif
+#ifdef VK_EXT_image_drm_format_modifier
+    }, {
+        .name = VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            {0},
+        },
+    }, {
+        // Requires VK_KHR_image_format_list and VK_KHR_sampler_ycbcr_conversion
+        .name = VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            VK_INST_FUN(vkGetPhysicalDeviceFormatProperties2KHR),
+            VK_DEV_FUN(vkGetImageDrmFormatModifierPropertiesEXT),
+            {0},
+        },
+#endif
+#ifdef VK_EXT_descriptor_indexing
+    }, {
+        .name = VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            {0},
+        },
+    }, {
+        // Requires VK_KHR_maintenance3
+        .name = VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            {0},
+        },
+#endif
+#ifdef VK_EXT_memory_budget
+    }, {
+        .name = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            VK_INST_FUN(vkGetPhysicalDeviceMemoryProperties2KHR),
+            {0},
+        },
+#endif
+#ifdef VK_KHR_shader_float16_int8
+    }, {
+        .name = VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME,
+        .funs = (struct vk_ext_fun[]) {
+            {0},
+        },
+#endif
+#ifdef VK_GOOGLE_display_timing
+    }, {
+        .name = VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME,
+        .swapchain = true,
+        .funs = (struct vk_ext_fun[]) {
+            VK_DEV_FUN(vkGetRefreshCycleDurationGOOGLE),
+            VK_DEV_FUN(vkGetPastPresentationTimingGOOGLE),
+            {0},
+        },
 #endif
     }
 };
@@ -180,8 +282,28 @@ const struct pl_vk_inst *pl_vk_inst_create(struct pl_context *ctx,
     const char **exts = NULL;
     int num_exts = 0;
 
+    // Request vulkan 1.1 where the loader supports it, since some features
+    // (e.g. subgroup operations) are only exposed by 1.1 devices
+    uint32_t api_ver = VK_API_VERSION_1_0;
+#ifdef VK_API_VERSION_1_1
+    VK_LOAD_FUN(NULL, vkEnumerateInstanceVersion)
+    if (vkEnumerateInstanceVersion && vkEnumerateInstanceVersion(&api_ver) == VK_SUCCESS) {
+        api_ver = PL_MIN(VK_MAKE_VERSION(VK_VERSION_MAJOR(api_ver),
+                                         VK_VERSION_MINOR(api_ver), 0),
+                         VK_API_VERSION_1_1);
+    } else {
+        api_ver = VK_API_VERSION_1_0;
+    }
+#endif
+
+    VkApplicationInfo app_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .apiVersion = api_ver,
+    };
+
     VkInstanceCreateInfo info = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
     };
 
     // Enumerate all supported extensions
@@ -266,7 +388,9 @@ layers_done:
     info.ppEnabledExtensionNames = exts;
     info.enabledExtensionCount = num_exts;
 
-    pl_info(ctx, "Creating vulkan instance%s", num_exts ? " with extensions:" : "");
+    pl_info(ctx, "Creating vulkan %d.%d instance%s",
+            (int) VK_VERSION_MAJOR(api_ver), (int) VK_VERSION_MINOR(api_ver),
+            num_exts ? " with extensions:" : "");
     for (int i = 0; i < num_exts; i++)
         pl_info(ctx, "    %s", exts[i]);
 
@@ -302,6 +426,7 @@ layers_done:
         .instance = inst,
         .extensions = exts,
         .num_extensions = num_exts,
+        .api_version = api_ver,
     };
 
     struct priv *p = TA_PRIV(pl_vk);
@@ -345,9 +470,35 @@ void pl_vulkan_destroy(const struct pl_vulkan **pl_vk)
     }
 
     pl_vk_inst_destroy(&vk->internal_instance);
+    pthread_mutex_destroy(&vk->lock);
     TA_FREEP((void **) pl_vk);
 }
 
+int pl_vulkan_queue_load(const struct pl_vulkan *pl_vk,
+                         struct pl_vulkan_queue_load *out, int num)
+{
+    struct vk_ctx *vk = TA_PRIV(pl_vk);
+    int total = 0;
+
+    pthread_mutex_lock(&vk->lock);
+    for (int i = 0; i < vk->num_pools; i++) {
+        const struct vk_cmdpool *pool = vk->pools[i];
+        for (int n = 0; n < pool->num_queues; n++, total++) {
+            if (total >= num)
+                continue;
+            out[total] = (struct pl_vulkan_queue_load) {
+                .index = pool->qf,
+                .queue = n,
+                .pending = pool->queue_pending[n],
+                .submitted = pool->queue_submitted[n],
+            };
+        }
+    }
+    pthread_mutex_unlock(&vk->lock);
+
+    return total;
+}
+
 static bool supports_surf(struct pl_context *ctx, VkPhysicalDevice physd,
                           VkSurfaceKHR surf)
 {
@@ -503,11 +654,40 @@ static bool device_init(struct vk_ctx *vk, const struct pl_vulkan_params *params
     }
 
     int idx_gfx = -1, idx_comp = -1, idx_tf = -1;
+    if (params->async_transfer)
+        idx_tf = find_qf(qfs, qfnum, VK_QUEUE_TRANSFER_BIT);
+
+    if (params->compute_only) {
+        if (params->surface) {
+            PL_FATAL(vk, "Compute-only devices can't present to a surface!");
+            goto error;
+        }
+
+        if (params->blacklist_caps & PL_GPU_CAP_COMPUTE) {
+            PL_FATAL(vk, "Compute-only devices require PL_GPU_CAP_COMPUTE!");
+            goto error;
+        }
+
+        // The compute queue takes over the role of the primary queue, so
+        // everything that would normally go to the graphics queue ends up
+        // on it instead. Since `find_qf` prefers the most specialized queue
+        // family, this also avoids occupying the graphics queue on devices
+        // that have dedicated compute queues.
+        idx_comp = find_qf(qfs, qfnum, VK_QUEUE_COMPUTE_BIT);
+        if (idx_comp < 0) {
+            PL_FATAL(vk, "Device has no queue family supporting compute!");
+            goto error;
+        }
+
+        idx_gfx = idx_comp;
+        vk->compute_only = true;
+        PL_INFO(vk, "Using compute queue (QF %d), no graphics", idx_comp);
+        goto queues_done;
+    }
+
     idx_gfx = find_qf(qfs, qfnum, VK_QUEUE_GRAPHICS_BIT);
     if (params->async_compute)
         idx_comp = find_qf(qfs, qfnum, VK_QUEUE_COMPUTE_BIT);
-    if (params->async_transfer)
-        idx_tf = find_qf(qfs, qfnum, VK_QUEUE_TRANSFER_BIT);
 
     // Vulkan requires at least one GRAPHICS queue, so if this fails something
     // is horribly wrong.
@@ -535,6 +715,7 @@ static bool device_init(struct vk_ctx *vk, const struct pl_vulkan_params *params
         idx_comp = -1;
     }
 
+queues_done:
     if (idx_tf >= 0 && idx_tf != idx_gfx)
         PL_INFO(vk, "Using async transfer (QF %d)", idx_tf);
     if (idx_comp >= 0 && idx_comp != idx_gfx)
@@ -576,6 +757,8 @@ static bool device_init(struct vk_ctx *vk, const struct pl_vulkan_params *params
     // Add all optional device-level extensions extensions
     for (int i = 0; i < PL_ARRAY_SIZE(vk_device_extensions); i++) {
         const struct vk_ext *ext = &vk_device_extensions[i];
+        if (ext->swapchain && !params->surface)
+            continue;
         for (int n = 0; n < num_exts_avail; n++) {
             if (strcmp(ext->name, exts_avail[n].extensionName) == 0) {
                 TARRAY_APPEND(vk->ta, *exts, *num_exts, ext->name);
@@ -607,6 +790,7 @@ static bool device_init(struct vk_ctx *vk, const struct pl_vulkan_params *params
     vk->features = (VkPhysicalDeviceFeatures) {
         FEATURE(shaderImageGatherExtended),
         FEATURE(shaderStorageImageExtendedFormats),
+        FEATURE(shaderSampledImageArrayDynamicIndexing),
     };
 #undef FEATURE
 
@@ -619,6 +803,123 @@ static bool device_init(struct vk_ctx *vk, const struct pl_vulkan_params *params
         .pEnabledFeatures = &vk->features,
     };
 
+#ifdef VK_KHR_timeline_semaphore
+    // Timeline semaphores additionally need to be enabled as a feature
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_feature = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+    };
+
+    for (int i = 0; i < *num_exts; i++) {
+        if (strcmp((*exts)[i], VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) != 0)
+            continue;
+
+        VK_LOAD_FUN(vk->inst, vkGetPhysicalDeviceFeatures2KHR)
+        VkPhysicalDeviceFeatures2KHR features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+            .pNext = &timeline_feature,
+        };
+
+        vkGetPhysicalDeviceFeatures2KHR(vk->physd, &features2);
+        if (timeline_feature.timelineSemaphore) {
+            dinfo.pNext = &timeline_feature;
+            vk->has_timeline = true;
+        }
+    }
+#endif
+
+#ifdef VK_KHR_sampler_ycbcr_conversion
+    // Planar formats can only be used with YCbCr conversions enabled, even
+    // though we only ever sample from the individual planes
+    VkPhysicalDeviceSamplerYcbcrConversionFeaturesKHR ycbcr_feature = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES_KHR,
+    };
+
+    for (int i = 0; i < *num_exts; i++) {
+        if (strcmp((*exts)[i], VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME) != 0)
+            continue;
+
+        VK_LOAD_FUN(vk->inst, vkGetPhysicalDeviceFeatures2KHR)
+        VkPhysicalDeviceFeatures2KHR features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+            .pNext = &ycbcr_feature,
+        };
+
+        vkGetPhysicalDeviceFeatures2KHR(vk->physd, &features2);
+        if (ycbcr_feature.samplerYcbcrConversion) {
+            ycbcr_feature.pNext = (void *) dinfo.pNext;
+            dinfo.pNext = &ycbcr_feature;
+            vk->has_planar = true;
+        }
+    }
+#endif
+
+#ifdef VK_EXT_descriptor_indexing
+    // The global texture heap only needs a small subset of the descriptor
+    // indexing features, so enable exactly those
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_feature = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+    };
+
+    for (int i = 0; params->bindless && i < *num_exts; i++) {
+        if (strcmp((*exts)[i], VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) != 0)
+            continue;
+
+        VK_LOAD_FUN(vk->inst, vkGetPhysicalDeviceFeatures2KHR)
+        VkPhysicalDeviceFeatures2KHR features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+            .pNext = &indexing_feature,
+        };
+
+        vkGetPhysicalDeviceFeatures2KHR(vk->physd, &features2);
+        if (vk->features.shaderSampledImageArrayDynamicIndexing &&
+            indexing_feature.descriptorBindingSampledImageUpdateAfterBind &&
+            indexing_feature.descriptorBindingUpdateUnusedWhilePending &&
+            indexing_feature.descriptorBindingPartiallyBound)
+        {
+            indexing_feature = (VkPhysicalDeviceDescriptorIndexingFeaturesEXT) {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+                .pNext = (void *) dinfo.pNext,
+                .descriptorBindingSampledImageUpdateAfterBind = true,
+                .descriptorBindingUpdateUnusedWhilePending = true,
+                .descriptorBindingPartiallyBound = true,
+            };
+
+            dinfo.pNext = &indexing_feature;
+            vk->has_bindless = true;
+        }
+    }
+#endif
+
+#ifdef VK_KHR_shader_float16_int8
+    // 16-bit float arithmetic in shaders, for `pl_shader_params.float16`
+    VkPhysicalDeviceShaderFloat16Int8FeaturesKHR float16_feature = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR,
+    };
+
+    for (int i = 0; i < *num_exts; i++) {
+        if (strcmp((*exts)[i], VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME) != 0)
+            continue;
+
+        VK_LOAD_FUN(vk->inst, vkGetPhysicalDeviceFeatures2KHR)
+        VkPhysicalDeviceFeatures2KHR features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+            .pNext = &float16_feature,
+        };
+
+        vkGetPhysicalDeviceFeatures2KHR(vk->physd, &features2);
+        if (float16_feature.shaderFloat16) {
+            float16_feature = (VkPhysicalDeviceShaderFloat16Int8FeaturesKHR) {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR,
+                .pNext = (void *) dinfo.pNext,
+                .shaderFloat16 = true,
+            };
+
+            dinfo.pNext = &float16_feature;
+            vk->has_float16 = true;
+        }
+    }
+#endif
+
     PL_INFO(vk, "Creating vulkan device%s", *num_exts ? " with extensions:" : "");
     for (int i = 0; i < *num_exts; i++)
         PL_INFO(vk, "    %s", (*exts)[i]);
@@ -672,6 +973,15 @@ const struct pl_vulkan *pl_vulkan_create(struct pl_context *ctx,
     vk->ta = pl_vk;
     vk->ctx = ctx;
     vk->inst = params->instance;
+    vk->thread_safe = params->thread_safe;
+
+    // Recursive, since callbacks run with the lock held may themselves
+    // e.g. destroy signals or register further callbacks
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&vk->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
 
     if (!vk->inst) {
         pl_assert(!params->surface);
@@ -683,6 +993,15 @@ const struct pl_vulkan *pl_vulkan_create(struct pl_context *ctx,
         vk->inst = vk->internal_instance->instance;
     }
 
+    // Never rely on a newer API version than the instance was created with
+    if (params->instance) {
+        vk->api_version = PL_DEF(params->max_api_version, VK_API_VERSION_1_0);
+    } else {
+        vk->api_version = vk->internal_instance->api_version;
+        if (params->max_api_version)
+            vk->api_version = PL_MIN(vk->api_version, params->max_api_version);
+    }
+
     // Choose the physical device
     if (params->device) {
         PL_DEBUG(vk, "Using specified VkPhysicalDevice");
@@ -715,10 +1034,18 @@ const struct pl_vulkan *pl_vulkan_create(struct pl_context *ctx,
             (int) VK_VERSION_MINOR(prop.apiVersion),
             (int) VK_VERSION_PATCH(prop.apiVersion));
 
+    // The device may support an older API version than the instance
+    vk->api_version = PL_MIN(vk->api_version,
+                             VK_MAKE_VERSION(VK_VERSION_MAJOR(prop.apiVersion),
+                                             VK_VERSION_MINOR(prop.apiVersion), 0));
+
     // Finally, initialize the logical device and the rest of the vk_ctx
     if (!device_init(vk, params))
         goto error;
 
+    if (params->spirv_cache_dir)
+        vk->spirv_cache_dir = talloc_strdup(vk->ta, params->spirv_cache_dir);
+
     pl_vk->gpu = pl_gpu_create_vk(vk);
     if (!pl_vk->gpu)
         goto error;
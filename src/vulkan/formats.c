@@ -30,6 +30,18 @@
         .sample_order    = idx,                 \
     }
 
+// Planar formats are opaque, the host representation is given by the planes
+#define PLANARFMT(_name, planes, size, bits)    \
+    (struct pl_fmt) {                           \
+        .name = _name,                          \
+        .type = PL_FMT_UNORM,                   \
+        .num_components  = 3,                   \
+        .component_depth = {bits, bits, bits},  \
+        .internal_size   = size,                \
+        .opaque          = true,                \
+        .num_planes      = planes,              \
+    }
+
 #define IDX(...)  {__VA_ARGS__}
 #define BITS(...) {__VA_ARGS__}
 
@@ -176,10 +188,35 @@ const struct vk_format vk_formats[] = {
     {VK_FORMAT_R4G4B4A4_UNORM_PACK16, REGFMT("rgba4",    4,  4, UNORM)},
     {VK_FORMAT_R5G6B5_UNORM_PACK16,   FMT("rgb565",      3,  2, UNORM, BITS(5,  6,  5),     IDX(0, 1, 2))},
     {VK_FORMAT_R5G5B5A1_UNORM_PACK16, FMT("rgb5a1",      4,  2, UNORM, BITS(5,  5,  5,  1), IDX(0, 1, 2, 3))},
+
+#ifdef VK_KHR_sampler_ycbcr_conversion
+    // Planar formats (these must come after all of their plane formats)
+    {VK_FORMAT_G8_B8R8_2PLANE_420_UNORM_KHR, PLANARFMT("g8_br8_420", 2, 3, 8),
+        .pfmt = {{VK_FORMAT_R8_UNORM}, {VK_FORMAT_R8G8_UNORM, 1, 1}}},
+    {VK_FORMAT_G8_B8R8_2PLANE_422_UNORM_KHR, PLANARFMT("g8_br8_422", 2, 3, 8),
+        .pfmt = {{VK_FORMAT_R8_UNORM}, {VK_FORMAT_R8G8_UNORM, 1, 0}}},
+    {VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM_KHR, PLANARFMT("g8_b8_r8_420", 3, 3, 8),
+        .pfmt = {{VK_FORMAT_R8_UNORM}, {VK_FORMAT_R8_UNORM, 1, 1}, {VK_FORMAT_R8_UNORM, 1, 1}}},
+    {VK_FORMAT_G8_B8_R8_3PLANE_422_UNORM_KHR, PLANARFMT("g8_b8_r8_422", 3, 3, 8),
+        .pfmt = {{VK_FORMAT_R8_UNORM}, {VK_FORMAT_R8_UNORM, 1, 0}, {VK_FORMAT_R8_UNORM, 1, 0}}},
+    {VK_FORMAT_G8_B8_R8_3PLANE_444_UNORM_KHR, PLANARFMT("g8_b8_r8_444", 3, 3, 8),
+        .pfmt = {{VK_FORMAT_R8_UNORM}, {VK_FORMAT_R8_UNORM}, {VK_FORMAT_R8_UNORM}}},
+    {VK_FORMAT_G16_B16R16_2PLANE_420_UNORM_KHR, PLANARFMT("g16_br16_420", 2, 6, 16),
+        .pfmt = {{VK_FORMAT_R16_UNORM}, {VK_FORMAT_R16G16_UNORM, 1, 1}}},
+    {VK_FORMAT_G16_B16R16_2PLANE_422_UNORM_KHR, PLANARFMT("g16_br16_422", 2, 6, 16),
+        .pfmt = {{VK_FORMAT_R16_UNORM}, {VK_FORMAT_R16G16_UNORM, 1, 0}}},
+    {VK_FORMAT_G16_B16_R16_3PLANE_420_UNORM_KHR, PLANARFMT("g16_b16_r16_420", 3, 6, 16),
+        .pfmt = {{VK_FORMAT_R16_UNORM}, {VK_FORMAT_R16_UNORM, 1, 1}, {VK_FORMAT_R16_UNORM, 1, 1}}},
+    {VK_FORMAT_G16_B16_R16_3PLANE_422_UNORM_KHR, PLANARFMT("g16_b16_r16_422", 3, 6, 16),
+        .pfmt = {{VK_FORMAT_R16_UNORM}, {VK_FORMAT_R16_UNORM, 1, 0}, {VK_FORMAT_R16_UNORM, 1, 0}}},
+    {VK_FORMAT_G16_B16_R16_3PLANE_444_UNORM_KHR, PLANARFMT("g16_b16_r16_444", 3, 6, 16),
+        .pfmt = {{VK_FORMAT_R16_UNORM}, {VK_FORMAT_R16_UNORM}, {VK_FORMAT_R16_UNORM}}},
+#endif
     {0}
 };
 
 #undef BITS
 #undef IDX
 #undef REGFMT
+#undef PLANARFMT
 #undef FMT
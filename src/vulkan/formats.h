@@ -26,6 +26,8 @@ struct vk_format {
     int icomps;        // internal component count (or 0 to infer from `fmt`)
     VkFormat bfmt;     // vulkan format for use as buffers (or 0 to use `tfmt`)
     const struct vk_format *emufmt; // alternate format for emulation
+    // for planar formats: the vulkan format and subsampling of each plane
+    struct { VkFormat fmt; int sx, sy; } pfmt[4];
 };
 
 extern const struct vk_format vk_formats[];
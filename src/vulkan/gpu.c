@@ -21,6 +21,8 @@
 #include "malloc.h"
 #include "spirv.h"
 
+#include <pthread.h>
+
 #ifdef VK_HAVE_UNIX
 #include <unistd.h>
 #endif
@@ -33,6 +35,31 @@ enum queue_type {
     TRANSFER,
 };
 
+// Command recording state, which is tracked separately for every thread
+// using the pl_gpu (if `vk->thread_safe`)
+struct vk_rec {
+    // The "currently recording" command. This will be queued and replaced by
+    // a new command every time we need to "switch" between queue families.
+    struct vk_cmd *cmd;
+
+    // Nesting depth of `pl_gpu_batch`. While non-zero, passes are not
+    // submitted individually.
+    int batch_depth;
+
+    // Barriers collected in between `vk_barrier_begin` and `vk_barrier_flush`
+    bool collect_barriers;
+    VkPipelineStageFlags barrier_src, barrier_dst;
+    VkImageMemoryBarrier *img_barriers;
+    int num_img_barriers;
+    VkBufferMemoryBarrier *buf_barriers;
+    int num_buf_barriers;
+
+    // Counters for `pl_gpu_stats`, summed over all threads. The counters
+    // tracked by `vk_ctx` itself (i.e. the queue submissions) are left as 0
+    struct pl_gpu_stats stats;
+    int transfer_depth; // to only count the outermost (user) transfer calls
+};
+
 // For gpu.priv
 struct pl_vk {
     struct pl_gpu_fns impl;
@@ -43,26 +70,92 @@ struct pl_vk {
     // Some additional cached device limits
     uint32_t max_push_descriptors;
     size_t min_texel_alignment;
+    uint64_t timestamp_mask; // 0 if timer queries are unsupported
+    bool host_local; // large host-visible device-local heap (ReBAR or UMA)
 
     // This is a pl_dispatch used (on ourselves!) for the purposes of
     // dispatching compute shaders for performing various emulation tasks
     // (e.g. partial clears, blits or emulated texture transfers).
     // Warning: Care must be taken to avoid recursive calls.
     struct pl_dispatch *dp;
-
-    // The "currently recording" command. This will be queued and replaced by
-    // a new command every time we need to "switch" between queue families.
-    struct vk_cmd *cmd;
+    pthread_mutex_t dp_lock;
+
+    // Command recording state of the calling thread, see `vk_get_rec`
+    struct vk_rec rec;     // the only instance, unless `vk->thread_safe`
+    pthread_key_t rec_key; // per-thread instances, if `vk->thread_safe`
+    struct vk_rec **recs;  // all per-thread instances (guarded by `vk->lock`)
+    int num_recs;
+
+    uint64_t last_ident; // see `vk_new_ident` (guarded by `vk->lock`)
+
+    // Counted outside of `rec`, since `vk_pass_create` may be called from
+    // any thread (guarded by `vk->lock`)
+    uint64_t passes_created;
+    uint64_t pass_compile_ns;
+
+    // Global texture heap (if PL_GPU_CAP_BINDLESS), with one binding per
+    // texture dimension. Slot 0 is never handed out, so that a zero
+    // `pl_tex.bindless_index` can signal the absence of a slot.
+    VkDescriptorSetLayout heap_layout;
+    VkDescriptorPool heap_pool;
+    VkDescriptorSet heap_set;
+    uint32_t heap_next;  // first never-used slot (guarded by `vk->lock`)
+    uint32_t *heap_free; // previously used slots (guarded by `vk->lock`)
+    int num_heap_free;
+
+    // Timestamp queries for tracing GPU work, see `vk_trace_begin`. Created
+    // on first use, and guarded by `vk->lock`
+    VkQueryPool trace_pool; // 2 queries per slot: start, stop
+    struct vk_trace_slot *trace_slots;
+    int trace_next;
 };
 
+// Returns a unique, nonzero identifier for a newly created texture or buffer.
+// Unlike the vulkan handles, these are never reused for different objects.
+static uint64_t vk_new_ident(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    pthread_mutex_lock(&p->vk->lock);
+    uint64_t ident = ++p->last_ident;
+    pthread_mutex_unlock(&p->vk->lock);
+    return ident;
+}
+
+static struct vk_rec *vk_get_rec(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    if (!vk->thread_safe)
+        return &p->rec;
+
+    struct vk_rec *rec = pthread_getspecific(p->rec_key);
+    if (rec)
+        return rec;
+
+    pthread_mutex_lock(&vk->lock);
+    rec = talloc_zero((void *) gpu, struct vk_rec);
+    TARRAY_APPEND((void *) gpu, p->recs, p->num_recs, rec);
+    pthread_mutex_unlock(&vk->lock);
+
+    pthread_setspecific(p->rec_key, rec);
+    return rec;
+}
+
+// Returns the command currently being recorded by this thread, or NULL
+static inline struct vk_cmd *vk_cur_cmd(const struct pl_gpu *gpu)
+{
+    return vk_get_rec(gpu)->cmd;
+}
+
 static void vk_submit(const struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
+    struct vk_rec *rec = vk_get_rec(gpu);
 
-    if (p->cmd) {
-        vk_cmd_queue(vk, p->cmd);
-        p->cmd = NULL;
+    if (rec->cmd) {
+        vk_cmd_queue(vk, rec->cmd);
+        rec->cmd = NULL;
     }
 }
 
@@ -90,40 +183,311 @@ static struct vk_cmd *vk_require_cmd(const struct pl_gpu *gpu,
     }
 
     pl_assert(pool);
-    if (p->cmd && p->cmd->pool == pool)
-        return p->cmd;
+    struct vk_rec *rec = vk_get_rec(gpu);
+    if (rec->cmd && rec->cmd->pool == pool)
+        return rec->cmd;
 
     vk_submit(gpu);
-    p->cmd = vk_cmd_begin(vk, pool);
-    return p->cmd;
+    rec->cmd = vk_cmd_begin(vk, pool);
+    return rec->cmd;
 }
 
 #define MAKE_LAZY_DESTRUCTOR(fun, argtype)                                  \
     static void fun##_lazy(const struct pl_gpu *gpu, const argtype *arg) {  \
         struct pl_vk *p = TA_PRIV(gpu);                                     \
         struct vk_ctx *vk = p->vk;                                          \
-        if (p->cmd) {                                                       \
-            vk_cmd_callback(p->cmd, (vk_cb) fun, gpu, (void *) arg);        \
+        struct vk_cmd *cmd = vk_cur_cmd(gpu);                               \
+        if (cmd) {                                                          \
+            vk_cmd_callback(cmd, (vk_cb) fun, gpu, (void *) arg);           \
         } else {                                                            \
             vk_dev_callback(vk, (vk_cb) fun, gpu, (void *) arg);            \
         }                                                                   \
     }
 
+// Number of GPU spans that can be in flight at once while tracing
+#define VK_TRACE_SLOTS 256
+
+// Maximum number of additional slots reset per traced command, see below
+#define VK_TRACE_MAX_RESETS 16
+
+// Queries need to be reset before every use, but transfer-only queues can't
+// reset queries themselves. So queries are also reset in advance by commands
+// on the other queues, and handed out to transfer commands once ready.
+enum vk_trace_state {
+    TRACE_DIRTY = 0, // needs to be reset before use
+    TRACE_RESETTING, // reset by a command which has not yet completed
+    TRACE_READY,     // reset, but not currently in use
+    TRACE_BUSY,      // recorded into a command which has not yet completed
+};
+
+struct vk_trace_slot {
+    enum vk_trace_state state;
+    const char *name;
+    const char *track;
+    struct vk_cmdpool *pool;
+};
+
+static const char *vk_trace_track(struct vk_ctx *vk, struct vk_cmdpool *pool)
+{
+    if (pool == vk->pool_graphics)
+        return "graphics queue";
+    if (pool == vk->pool_compute)
+        return "compute queue";
+    if (pool == vk->pool_transfer)
+        return "transfer queue";
+    return "other queue";
+}
+
+static void trace_reset_done(const struct pl_gpu *gpu, uintptr_t idx)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    p->trace_slots[idx].state = TRACE_READY;
+}
+
+static void trace_done(const struct pl_gpu *gpu, uintptr_t idx)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    struct vk_trace_slot *slot = &p->trace_slots[idx];
+    slot->state = TRACE_DIRTY;
+
+    uint64_t ts[2];
+    VkResult res = vkGetQueryPoolResults(vk->dev, p->trace_pool, 2 * idx, 2,
+                                         sizeof(ts), &ts[0], sizeof(uint64_t),
+                                         VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS)
+        return; // e.g. the command was never actually executed
+
+    double period = vk->limits.timestampPeriod;
+    int64_t start = (ts[0] & p->timestamp_mask) * period;
+    int64_t end = (ts[1] & p->timestamp_mask) * period;
+    if (end < start)
+        return; // the timestamps wrapped around in between
+
+    // The command has completed by the time this callback runs, so this
+    // gives an upper bound on the offset between the two clocks. Keep the
+    // tightest bound seen so far, which converges on the real offset as soon
+    // as the CPU happens to be waiting on a traced command
+    struct vk_cmdpool *pool = slot->pool;
+    int64_t offset = (int64_t) pl_clock_ns() - end;
+    if (!pool->ts_calibrated || offset < pool->ts_offset) {
+        pool->ts_offset = offset;
+        pool->ts_calibrated = true;
+    }
+
+    pl_span_add(vk->ctx, slot->track, slot->name, start + pool->ts_offset,
+                end + pool->ts_offset);
+}
+
+// Starts a GPU span on `cmd` if tracing, returning the slot to pass to
+// `vk_trace_end`, or -1 if this span should be skipped. Since this may reset
+// queries, it must not be called inside a render pass.
+static int vk_trace_begin(const struct pl_gpu *gpu, struct vk_cmd *cmd,
+                          const char *name)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    if (!vk->ctx->tracing || !p->timestamp_mask ||
+        !cmd->pool->props.timestampValidBits)
+    {
+        return -1;
+    }
+
+    VkQueueFlags reset_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    bool can_reset = cmd->pool->props.queueFlags & reset_flags;
+    int idx = -1;
+
+    pthread_mutex_lock(&vk->lock);
+    if (!p->trace_pool) {
+        VkQueryPoolCreateInfo qinfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2 * VK_TRACE_SLOTS,
+        };
+
+        VK(vkCreateQueryPool(vk->dev, &qinfo, VK_ALLOC, &p->trace_pool));
+        p->trace_slots = talloc_zero_array((void *) gpu, struct vk_trace_slot,
+                                           VK_TRACE_SLOTS);
+    }
+
+    for (int n = 0; n < VK_TRACE_SLOTS; n++) {
+        int i = (p->trace_next + n) % VK_TRACE_SLOTS;
+        enum vk_trace_state state = p->trace_slots[i].state;
+        if (state == TRACE_READY || (can_reset && state == TRACE_DIRTY)) {
+            idx = i;
+            break;
+        }
+    }
+
+    if (idx < 0) {
+        PL_TRACE(gpu, "GPU trace queries exhausted, skipping span");
+        goto error;
+    }
+
+    struct vk_trace_slot *slot = &p->trace_slots[idx];
+    if (slot->state == TRACE_DIRTY)
+        vkCmdResetQueryPool(cmd->buf, p->trace_pool, 2 * idx, 2);
+
+    *slot = (struct vk_trace_slot) {
+        .state = TRACE_BUSY,
+        .name = name,
+        .track = vk_trace_track(vk, cmd->pool),
+        .pool = cmd->pool,
+    };
+
+    p->trace_next = (idx + 1) % VK_TRACE_SLOTS;
+    vk_cmd_callback(cmd, (vk_cb) trace_done, gpu, (void *)(uintptr_t) idx);
+
+    // Reset some more slots for the benefit of the transfer queue
+    for (int i = 0, num = 0; can_reset && i < VK_TRACE_SLOTS; i++) {
+        if (num == VK_TRACE_MAX_RESETS)
+            break;
+        if (p->trace_slots[i].state != TRACE_DIRTY)
+            continue;
+        vkCmdResetQueryPool(cmd->buf, p->trace_pool, 2 * i, 2);
+        vk_cmd_callback(cmd, (vk_cb) trace_reset_done, gpu, (void *)(uintptr_t) i);
+        p->trace_slots[i].state = TRACE_RESETTING;
+        num++;
+    }
+
+    vkCmdWriteTimestamp(cmd->buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        p->trace_pool, 2 * idx);
+
+    // fall through
+error:
+    pthread_mutex_unlock(&vk->lock);
+    return idx;
+}
+
+static void vk_trace_end(const struct pl_gpu *gpu, struct vk_cmd *cmd, int idx)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    if (idx < 0)
+        return;
+
+    vkCmdWriteTimestamp(cmd->buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        p->trace_pool, 2 * idx + 1);
+}
+
 static void vk_destroy_gpu(const struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
 
     pl_dispatch_destroy(&p->dp);
-    vk_submit(gpu);
+
+    // Queue whatever every thread left behind
+    struct vk_rec *single = &p->rec;
+    struct vk_rec **recs = vk->thread_safe ? p->recs : &single;
+    int num_recs = vk->thread_safe ? p->num_recs : 1;
+    for (int i = 0; i < num_recs; i++) {
+        if (recs[i]->cmd)
+            vk_cmd_queue(vk, recs[i]->cmd);
+    }
     vk_wait_idle(vk);
 
+    vkDestroyDescriptorPool(vk->dev, p->heap_pool, VK_ALLOC);
+    vkDestroyDescriptorSetLayout(vk->dev, p->heap_layout, VK_ALLOC);
+    vkDestroyQueryPool(vk->dev, p->trace_pool, VK_ALLOC);
     vk_malloc_destroy(&p->alloc);
     spirv_compiler_destroy(&p->spirv);
+    if (vk->thread_safe)
+        pthread_key_delete(p->rec_key);
+    pthread_mutex_destroy(&p->dp_lock);
 
     talloc_free((void *) gpu);
 }
 
+#ifdef VK_EXT_image_drm_format_modifier
+// Fills in the DRM format modifiers that can be used for sampling from
+// (single-plane) imported dmabufs of this format
+static void vk_setup_modifiers(struct pl_gpu *gpu, struct pl_fmt *fmt,
+                               VkFormat vkfmt)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    if (!vk->vkGetImageDrmFormatModifierPropertiesEXT || fmt->emulated)
+        return;
+
+    VkDrmFormatModifierPropertiesListEXT mods = {
+        .sType = VK_STRUCTURE_TYPE_DRM_FORMAT_MODIFIER_PROPERTIES_LIST_EXT,
+    };
+
+    VkFormatProperties2KHR prop = {
+        .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2_KHR,
+        .pNext = &mods,
+    };
+
+    vk->vkGetPhysicalDeviceFormatProperties2KHR(vk->physd, vkfmt, &prop);
+    if (!mods.drmFormatModifierCount)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    mods.pDrmFormatModifierProperties = talloc_array(tmp,
+            VkDrmFormatModifierPropertiesEXT, mods.drmFormatModifierCount);
+    vk->vkGetPhysicalDeviceFormatProperties2KHR(vk->physd, vkfmt, &prop);
+
+    uint64_t *list = NULL;
+    for (int i = 0; i < mods.drmFormatModifierCount; i++) {
+        const VkDrmFormatModifierPropertiesEXT *mod;
+        mod = &mods.pDrmFormatModifierProperties[i];
+        if (mod->drmFormatModifierPlaneCount != 1)
+            continue;
+        if (!(mod->drmFormatModifierTilingFeatures &
+              VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+            continue;
+        TARRAY_APPEND(fmt, list, fmt->num_modifiers, mod->drmFormatModifier);
+    }
+
+    fmt->modifiers = list;
+    talloc_free(tmp);
+}
+#endif
+
+// Planar formats are only exposed if all of their planes are (natively)
+// supported, since the planes are used as regular textures
+static void vk_setup_planar(struct pl_gpu *gpu, const struct vk_format *vk_fmt)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    VkFormatProperties prop;
+    vkGetPhysicalDeviceFormatProperties(vk->physd, vk_fmt->tfmt, &prop);
+    if (!(prop.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+        return;
+
+    struct pl_fmt *fmt = talloc_ptrtype_priv(gpu, fmt, vk_fmt);
+    const struct vk_format **fmtp = TA_PRIV(fmt);
+    *fmt = vk_fmt->fmt;
+    *fmtp = vk_fmt;
+    fmt->caps = PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_LINEAR;
+
+    for (int i = 0; i < fmt->num_planes; i++) {
+        const struct pl_fmt *pfmt = NULL;
+        for (int n = 0; n < gpu->num_formats; n++) {
+            const struct vk_format **pvk = TA_PRIV(gpu->formats[n]);
+            if ((*pvk)->tfmt == vk_fmt->pfmt[i].fmt && !gpu->formats[n]->emulated) {
+                pfmt = gpu->formats[n];
+                break;
+            }
+        }
+
+        if (!pfmt || !(pfmt->caps & PL_FMT_CAP_SAMPLEABLE)) {
+            talloc_free(fmt);
+            return;
+        }
+
+        fmt->planes[i] = (struct pl_fmt_plane) {
+            .format = pfmt,
+            .shift_x = vk_fmt->pfmt[i].sx,
+            .shift_y = vk_fmt->pfmt[i].sy,
+        };
+        fmt->caps &= pfmt->caps;
+    }
+
+    TARRAY_APPEND(gpu, gpu->formats, gpu->num_formats, fmt);
+}
+
 static void vk_setup_formats(struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
@@ -135,6 +499,12 @@ static void vk_setup_formats(struct pl_gpu *gpu)
     for (const struct vk_format *pvk_fmt = vk_formats; pvk_fmt->tfmt; pvk_fmt++) {
         const struct vk_format *vk_fmt = pvk_fmt;
 
+        if (vk_fmt->fmt.num_planes) {
+            if (vk->has_planar)
+                vk_setup_planar(gpu, vk_fmt);
+            continue;
+        }
+
         // Skip formats with innately emulated representation if unsupported
         if (vk_fmt->fmt.emulated && !has_emu)
             continue;
@@ -214,6 +584,12 @@ static void vk_setup_formats(struct pl_gpu *gpu)
         if (!(gpu->caps & PL_GPU_CAP_COMPUTE))
             fmt->caps &= ~(PL_FMT_CAP_STORABLE | PL_FMT_CAP_TEXEL_STORAGE);
 
+        // Rendering, blending and blitting all require a graphics queue
+        if (vk->compute_only) {
+            fmt->caps &= ~(PL_FMT_CAP_RENDERABLE | PL_FMT_CAP_BLENDABLE |
+                           PL_FMT_CAP_BLITTABLE);
+        }
+
         enum pl_fmt_caps storable = PL_FMT_CAP_STORABLE | PL_FMT_CAP_TEXEL_STORAGE;
         if (fmt->caps & storable) {
             int real_comps = PL_DEF(vk_fmt->icomps, fmt->num_components);
@@ -225,6 +601,10 @@ static void vk_setup_formats(struct pl_gpu *gpu)
             }
         }
 
+#ifdef VK_EXT_image_drm_format_modifier
+        vk_setup_modifiers(gpu, fmt, vk_fmt->tfmt);
+#endif
+
         TARRAY_APPEND(gpu, gpu->formats, gpu->num_formats, fmt);
     }
 
@@ -272,6 +652,8 @@ static pl_handle_caps vk_tex_handle_caps(struct vk_ctx *vk, bool import)
 
     for (int i = 0; vk_mem_handle_list[i]; i++) {
         enum pl_handle_type handle_type = vk_mem_handle_list[i];
+        if (handle_type == PL_HANDLE_HOST_PTR)
+            continue; // only supported for buffers
 
         // Query whether creation of a "basic" dummy texture would work
         VkPhysicalDeviceExternalImageFormatInfoKHR ext_pinfo = {
@@ -312,6 +694,111 @@ static pl_handle_caps vk_tex_handle_caps(struct vk_ctx *vk, bool import)
     return caps;
 }
 
+#ifdef VK_EXT_descriptor_indexing
+// Upper bound on the number of slots in the global texture heap
+#define PL_VK_HEAP_SIZE 4096
+
+// Creates the global texture heap, and enables PL_GPU_CAP_BINDLESS if this
+// succeeds. Failure is not fatal, since passes can always bind textures
+// the normal way instead.
+static void vk_init_heap(struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT idx_props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+    };
+
+    VkPhysicalDeviceProperties2KHR props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+        .pNext = &idx_props,
+    };
+
+    vk->vkGetPhysicalDeviceProperties2KHR(vk->physd, &props);
+
+    // Every slot exists once per texture dimension, and the regular
+    // per-pass descriptors count towards the same limits, so leave some
+    // headroom for those
+    uint32_t size = PL_VK_HEAP_SIZE;
+    size = PL_MIN(size, idx_props.maxPerStageDescriptorUpdateAfterBindSampledImages / 4);
+    size = PL_MIN(size, idx_props.maxPerStageDescriptorUpdateAfterBindSamplers / 4);
+    size = PL_MIN(size, idx_props.maxPerStageUpdateAfterBindResources / 4);
+    size = PL_MIN(size, idx_props.maxDescriptorSetUpdateAfterBindSampledImages / 4);
+    size = PL_MIN(size, idx_props.maxDescriptorSetUpdateAfterBindSamplers / 4);
+    if (size < 16) {
+        PL_INFO(gpu, "Descriptor indexing limits too low (%u), disabling "
+                "the global texture heap", (unsigned) size);
+        return;
+    }
+
+    VkDescriptorSetLayoutBinding bindings[3];
+    VkDescriptorBindingFlagsEXT flags[3];
+    for (int i = 0; i < PL_ARRAY_SIZE(bindings); i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = size,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT |
+                          VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+
+        // Textures are added to and removed from the heap while passes
+        // using other slots are still pending
+        flags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                   VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+                   VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT finfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+        .bindingCount = PL_ARRAY_SIZE(flags),
+        .pBindingFlags = flags,
+    };
+
+    VkDescriptorSetLayoutCreateInfo dinfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &finfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+        .bindingCount = PL_ARRAY_SIZE(bindings),
+        .pBindings = bindings,
+    };
+
+    VK(vkCreateDescriptorSetLayout(vk->dev, &dinfo, VK_ALLOC, &p->heap_layout));
+
+    VkDescriptorPoolCreateInfo pinfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &(VkDescriptorPoolSize) {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = PL_ARRAY_SIZE(bindings) * size,
+        },
+    };
+
+    VK(vkCreateDescriptorPool(vk->dev, &pinfo, VK_ALLOC, &p->heap_pool));
+
+    VkDescriptorSetAllocateInfo ainfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = p->heap_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &p->heap_layout,
+    };
+
+    VK(vkAllocateDescriptorSets(vk->dev, &ainfo, &p->heap_set));
+
+    p->heap_next = 1; // slot 0 is reserved
+    gpu->caps |= PL_GPU_CAP_BINDLESS;
+    gpu->limits.max_bindless_tex = size;
+    PL_DEBUG(gpu, "Global texture heap: %u slots", (unsigned) size);
+    return;
+
+error:
+    p->heap_set = VK_NULL_HANDLE;
+}
+#endif
+
 const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
 {
     pl_assert(vk->dev);
@@ -323,7 +810,15 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
     p->impl = pl_fns_vk;
     p->vk = vk;
 
-    p->spirv = spirv_compiler_create(vk->ctx);
+    if (vk->thread_safe && pthread_key_create(&p->rec_key, NULL) != 0) {
+        PL_ERR(gpu, "Failed creating thread-local storage key!");
+        talloc_free(gpu);
+        return NULL;
+    }
+    pthread_mutex_init(&p->dp_lock, NULL);
+
+    p->spirv = spirv_compiler_create(vk->ctx, vk->spirv_cache_dir,
+                                     vk->api_version);
     p->alloc = vk_malloc_create(vk);
     if (!p->alloc || !p->spirv)
         goto error;
@@ -342,6 +837,7 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
         .max_gather_offset = vk->limits.maxTexelGatherOffset,
         .align_tex_xfer_stride = vk->limits.optimalBufferCopyRowPitchAlignment,
         .align_tex_xfer_offset = pl_lcm(vk->limits.optimalBufferCopyOffsetAlignment, 4),
+        .align_ubo_offset  = vk->limits.minUniformBufferOffsetAlignment,
     };
 
     gpu->export_caps.buf = vk_malloc_handle_caps(p->alloc, false);
@@ -351,6 +847,24 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
     gpu->export_caps.sync = vk_sync_handle_caps(vk);
     gpu->import_caps.sync = 0; // Not supported yet
 
+#ifdef VK_EXT_external_memory_host
+    if (gpu->import_caps.buf & PL_HANDLE_HOST_PTR) {
+        VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_props = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT,
+        };
+
+        VkPhysicalDeviceProperties2KHR props = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+            .pNext = &host_props,
+        };
+
+        vk->vkGetPhysicalDeviceProperties2KHR(vk->physd, &props);
+        gpu->limits.align_host_ptr = host_props.minImportedHostPointerAlignment;
+        if (!gpu->limits.align_host_ptr)
+            gpu->import_caps.buf &= ~PL_HANDLE_HOST_PTR;
+    }
+#endif
+
     if (pl_gpu_supports_interop(gpu)) {
         VkPhysicalDeviceIDPropertiesKHR id_props = {
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR,
@@ -380,9 +894,34 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
         p->max_push_descriptors = pushd.maxPushDescriptors;
     }
 
+    // Timer queries are only supported if all of the queue families we
+    // dispatch passes on can record timestamps
+    int ts_bits = vk->pool_graphics->props.timestampValidBits;
+    if (vk->pool_compute)
+        ts_bits = PL_MIN(ts_bits, vk->pool_compute->props.timestampValidBits);
+    if (ts_bits && vk->limits.timestampPeriod > 0) {
+        p->timestamp_mask = ts_bits >= 64 ? UINT64_MAX : (1ULL << ts_bits) - 1;
+        PL_DEBUG(gpu, "Timestamp period: %f ns, valid bits: %d",
+                 vk->limits.timestampPeriod, ts_bits);
+    }
+
+    // Small (typically 256 MiB) host-visible device-local heaps are commonly
+    // exposed even without resizable BAR, and are too scarce to be spent on
+    // textures, so only consider the larger ones
+    p->host_local = vk_malloc_has_memtype(p->alloc, 0,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                          256 << 20);
+    if (p->host_local)
+        PL_DEBUG(gpu, "Device-local memory is host-visible, using direct "
+                 "texture uploads where possible");
+
     // We ostensibly support this, although it can still fail on buffer
     // creation (for certain combinations of buffers)
     gpu->caps |= PL_GPU_CAP_MAPPED_BUFFERS;
+    gpu->caps |= PL_GPU_CAP_SPEC_CONSTANTS;
+    if (vk->has_float16)
+        gpu->caps |= PL_GPU_CAP_FLOAT16;
 
     if (vk->pool_compute) {
         gpu->caps |= PL_GPU_CAP_COMPUTE;
@@ -397,6 +936,33 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
         // want to be using them. (This seems mostly relevant for AMD)
         if (vk->pool_compute->num_queues > vk->pool_graphics->num_queues)
             gpu->caps |= PL_GPU_CAP_PARALLEL_COMPUTE;
+
+#ifdef VK_API_VERSION_1_1
+        if (vk->api_version >= VK_API_VERSION_1_1 &&
+            p->spirv->api_version >= VK_API_VERSION_1_1)
+        {
+            VkPhysicalDeviceSubgroupProperties sg_props = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+            };
+
+            VkPhysicalDeviceProperties2KHR props = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+                .pNext = &sg_props,
+            };
+
+            vk->vkGetPhysicalDeviceProperties2KHR(vk->physd, &props);
+            const VkSubgroupFeatureFlags sg_ops = VK_SUBGROUP_FEATURE_BASIC_BIT |
+                                                  VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+            if ((sg_props.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+                (sg_props.supportedOperations & sg_ops) == sg_ops &&
+                sg_props.subgroupSize)
+            {
+                gpu->caps |= PL_GPU_CAP_SUBGROUPS;
+                gpu->limits.subgroup_size = sg_props.subgroupSize;
+                PL_DEBUG(gpu, "Subgroup size: %d", (int) sg_props.subgroupSize);
+            }
+        }
+#endif
     }
 
     if (!vk->features.shaderImageGatherExtended) {
@@ -404,6 +970,11 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
         gpu->limits.max_gather_offset = 0;
     }
 
+#ifdef VK_EXT_descriptor_indexing
+    if (vk->has_bindless)
+        vk_init_heap(gpu);
+#endif
+
     vk_setup_formats(gpu);
 
     // Compute the correct minimum texture alignment
@@ -469,13 +1040,22 @@ struct pl_tex_vk {
     enum queue_type transfer_queue;
     VkImageType type;
     VkImage img;
+    VkImageAspectFlags aspect;
     struct vk_memslice mem;
+    // for the planes of planar textures, which share the VkImage (and all
+    // of the layout and synchronization state below) with their parent
+    const struct pl_tex *parent;
+    // for linear images in host-visible memory, written to directly by
+    // vk_tex_upload. These are kept in VK_IMAGE_LAYOUT_GENERAL at all times.
+    bool direct;
+    VkSubresourceLayout direct_layout;
     // cached properties
     VkFormat img_fmt;
     VkImageUsageFlags usage_flags;
     // for sampling
     VkImageView view;
     VkSampler sampler;
+    uint64_t ident; // see `vk_new_ident`
     // for rendering
     VkFramebuffer framebuffer;
     // for transfers
@@ -488,6 +1068,7 @@ struct pl_tex_vk {
     // "current" metadata, can change during the course of execution
     VkImageLayout current_layout;
     VkAccessFlags current_access;
+    struct vk_sync_point last_use; // for direct host writes
     // the signal guards reuse, and can be NULL
     struct vk_signal *sig;
     VkPipelineStageFlags sig_stage;
@@ -508,6 +1089,80 @@ void pl_tex_vk_external_dep(const struct pl_gpu *gpu, const struct pl_tex *tex,
 
 static void vk_sync_deref(const struct pl_gpu *gpu, const struct pl_sync *sync);
 
+// Start collecting pipeline barriers instead of recording them right away.
+// All barriers required by an operation on several resources (e.g. all
+// descriptors of a pass) can then be recorded with a single call to
+// vkCmdPipelineBarrier, by calling `vk_barrier_flush` before the operation.
+static void vk_barrier_begin(const struct pl_gpu *gpu)
+{
+    struct vk_rec *rec = vk_get_rec(gpu);
+    pl_assert(!rec->collect_barriers);
+    rec->collect_barriers = true;
+}
+
+static void vk_barrier_flush(const struct pl_gpu *gpu, struct vk_cmd *cmd)
+{
+    struct vk_rec *rec = vk_get_rec(gpu);
+    if (rec->num_img_barriers || rec->num_buf_barriers) {
+        vkCmdPipelineBarrier(cmd->buf, rec->barrier_src, rec->barrier_dst, 0,
+                             0, NULL, rec->num_buf_barriers, rec->buf_barriers,
+                             rec->num_img_barriers, rec->img_barriers);
+        rec->stats.barriers += rec->num_img_barriers + rec->num_buf_barriers;
+    }
+
+    rec->collect_barriers = false;
+    rec->barrier_src = rec->barrier_dst = 0;
+    rec->num_img_barriers = rec->num_buf_barriers = 0;
+}
+
+// Records a pipeline barrier, or adds it to the current batch (if any)
+static void vk_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
+                       VkPipelineStageFlags src, VkPipelineStageFlags dst,
+                       const VkBufferMemoryBarrier *buf,
+                       const VkImageMemoryBarrier *img)
+{
+    struct vk_rec *rec = vk_get_rec(gpu);
+    if (!rec->collect_barriers) {
+        vkCmdPipelineBarrier(cmd->buf, src, dst, 0, 0, NULL, !!buf, buf,
+                             !!img, img);
+        rec->stats.barriers += !!buf + !!img;
+        return;
+    }
+
+    // Barriers within a single call are unordered, so two barriers for the
+    // same resource would conflict. (This is rare, e.g. the same texture
+    // being bound to a pass twice)
+    bool conflict = false;
+    for (int i = 0; img && i < rec->num_img_barriers; i++)
+        conflict |= rec->img_barriers[i].image == img->image;
+    for (int i = 0; buf && i < rec->num_buf_barriers; i++)
+        conflict |= rec->buf_barriers[i].buffer == buf->buffer;
+    if (conflict) {
+        vk_barrier_flush(gpu, cmd);
+        rec->collect_barriers = true;
+    }
+
+    if (img)
+        TARRAY_APPEND((void *) gpu, rec->img_barriers, rec->num_img_barriers, *img);
+    if (buf)
+        TARRAY_APPEND((void *) gpu, rec->buf_barriers, rec->num_buf_barriers, *buf);
+    rec->barrier_src |= src;
+    rec->barrier_dst |= dst;
+}
+
+// Access flags which imply a write to the resource. Consecutive accesses
+// without any of these (e.g. sampling the same texture repeatedly) don't
+// need to be separated by a memory barrier.
+static const VkAccessFlags vk_write_access =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+    VK_ACCESS_MEMORY_WRITE_BIT;
+
+static inline bool vk_access_compatible(VkAccessFlags old, VkAccessFlags new)
+{
+    return old == new || !((old | new) & vk_write_access);
+}
+
 // Small helper to ease image barrier creation. if `discard` is set, the contents
 // of the image will be undefined after the barrier
 static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
@@ -518,7 +1173,20 @@ static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
+    struct pl_tex_vk *plane_vk = NULL;
+    if (tex_vk->parent) {
+        // Barriers on non-disjoint planar images must cover all planes
+        plane_vk = tex_vk;
+        tex_vk = TA_PRIV(tex_vk->parent);
+    }
+
     pl_assert(!tex_vk->held);
+    tex_vk->last_use = vk_cmd_sync_point(cmd);
+
+    // Host writes require either of these layouts, so stick to the (only
+    // moderately slower, for linear images) general layout
+    if (tex_vk->direct && newLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+        newLayout = VK_IMAGE_LAYOUT_GENERAL;
 
     for (int i = 0; i < tex_vk->num_ext_deps; i++)
         vk_cmd_dep(cmd, tex_vk->ext_deps[i], stage);
@@ -558,7 +1226,7 @@ static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     enum vk_wait_type type = vk_cmd_wait(vk, cmd, &tex_vk->sig, stage, &event);
 
     bool need_trans = tex_vk->current_layout != newLayout ||
-                      tex_vk->current_access != newAccess ||
+                      !vk_access_compatible(tex_vk->current_access, newAccess) ||
                       (imgBarrier.srcQueueFamilyIndex !=
                        imgBarrier.dstQueueFamilyIndex);
 
@@ -570,13 +1238,12 @@ static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
             // No synchronization required, so we can safely transition out of
             // VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
             imgBarrier.srcAccessMask = 0;
-            vkCmdPipelineBarrier(cmd->buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                                 stage, 0, 0, NULL, 0, NULL, 1, &imgBarrier);
+            vk_barrier(gpu, cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, stage,
+                       NULL, &imgBarrier);
             break;
         case VK_WAIT_BARRIER:
             // Regular pipeline barrier is required
-            vkCmdPipelineBarrier(cmd->buf, tex_vk->sig_stage, stage, 0, 0, NULL,
-                                 0, NULL, 1, &imgBarrier);
+            vk_barrier(gpu, cmd, tex_vk->sig_stage, stage, NULL, &imgBarrier);
             break;
         case VK_WAIT_EVENT:
             // We can/should use the VkEvent for synchronization
@@ -588,6 +1255,10 @@ static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
 
     tex_vk->current_layout = newLayout;
     tex_vk->current_access = newAccess;
+    if (plane_vk) {
+        plane_vk->current_layout = newLayout;
+        plane_vk->current_access = newAccess;
+    }
 }
 
 static void tex_signal(const struct pl_gpu *gpu, struct vk_cmd *cmd,
@@ -596,12 +1267,73 @@ static void tex_signal(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     struct pl_vk *p = TA_PRIV(gpu);
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
     struct vk_ctx *vk = p->vk;
+    if (tex_vk->parent)
+        tex_vk = TA_PRIV(tex_vk->parent);
     pl_assert(!tex_vk->sig);
 
     tex_vk->sig = vk_cmd_signal(vk, cmd, stage);
     tex_vk->sig_stage = stage;
 }
 
+// Places a sampleable texture into a free slot of the global texture heap, if
+// there is one
+static void vk_heap_add(const struct pl_gpu *gpu, struct pl_tex *tex)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    struct pl_tex_vk *tex_vk = TA_PRIV(tex);
+    if (!p->heap_set || !tex->params.sampleable)
+        return;
+
+    uint32_t idx = 0;
+    pthread_mutex_lock(&vk->lock);
+    if (!TARRAY_POP(p->heap_free, p->num_heap_free, &idx) &&
+        p->heap_next < gpu->limits.max_bindless_tex)
+    {
+        idx = p->heap_next++;
+    }
+
+    if (idx) {
+        VkWriteDescriptorSet wds = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = p->heap_set,
+            .dstBinding = pl_tex_params_dimension(tex->params) - 1,
+            .dstArrayElement = idx,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &(VkDescriptorImageInfo) {
+                .sampler = tex_vk->sampler,
+                .imageView = tex_vk->view,
+                .imageLayout = tex_vk->direct ? VK_IMAGE_LAYOUT_GENERAL
+                                : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            },
+        };
+
+        vkUpdateDescriptorSets(vk->dev, 1, &wds, 0, NULL);
+    } else {
+        PL_TRACE(gpu, "Global texture heap exhausted!");
+    }
+    pthread_mutex_unlock(&vk->lock);
+
+    tex->bindless_index = idx;
+}
+
+static void vk_heap_remove(const struct pl_gpu *gpu, struct pl_tex *tex)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    if (!tex->bindless_index)
+        return;
+
+    // The texture is no longer in use by any commands at this point, and
+    // stale slots are never accessed, so they can be re-used right away
+    pthread_mutex_lock(&vk->lock);
+    TARRAY_APPEND((void *) gpu, p->heap_free, p->num_heap_free,
+                  tex->bindless_index);
+    pthread_mutex_unlock(&vk->lock);
+    tex->bindless_index = 0;
+}
+
 static void vk_tex_destroy(const struct pl_gpu *gpu, struct pl_tex *tex)
 {
     if (!tex)
@@ -611,6 +1343,10 @@ static void vk_tex_destroy(const struct pl_gpu *gpu, struct pl_tex *tex)
     struct vk_ctx *vk = p->vk;
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
 
+    for (int i = 0; i < tex->num_planes; i++)
+        vk_tex_destroy(gpu, (struct pl_tex *) tex->planes[i]);
+
+    vk_heap_remove(gpu, tex);
     pl_buf_pool_uninit(gpu, &tex_vk->tmp_write);
     pl_buf_pool_uninit(gpu, &tex_vk->tmp_read);
     pl_buf_pool_uninit(gpu, &tex_vk->pbo_write);
@@ -648,6 +1384,8 @@ static bool vk_init_image(const struct pl_gpu *gpu, const struct pl_tex *tex)
     tex_vk->current_layout = VK_IMAGE_LAYOUT_UNDEFINED;
     tex_vk->current_access = 0;
     tex_vk->transfer_queue = GRAPHICS;
+    if (!tex_vk->aspect)
+        tex_vk->aspect = VK_IMAGE_ASPECT_COLOR_BIT;
 
     // Always use the transfer pool if available, for efficiency
     if ((params->host_writable || params->host_readable) && vk->pool_transfer)
@@ -676,7 +1414,7 @@ static bool vk_init_image(const struct pl_gpu *gpu, const struct pl_tex *tex)
             .viewType = viewType[tex_vk->type],
             .format = tex_vk->img_fmt,
             .subresourceRange = {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .aspectMask = tex_vk->aspect,
                 .levelCount = 1,
                 .layerCount = 1,
             },
@@ -703,6 +1441,7 @@ static bool vk_init_image(const struct pl_gpu *gpu, const struct pl_tex *tex)
         };
 
         VK(vkCreateSampler(vk->dev, &sinfo, VK_ALLOC, &tex_vk->sampler));
+        vk_heap_add(gpu, (struct pl_tex *) tex);
     }
 
     if (params->renderable) {
@@ -746,6 +1485,90 @@ error:
     return ret;
 }
 
+// Returns whether a texture can be backed by a linear image in host-visible
+// device memory, for direct uploads. This is restricted to plain sampled 2D
+// textures, since linear images are generally a poor fit for anything else.
+static bool vk_tex_direct_ok(const struct pl_gpu *gpu,
+                             const struct pl_tex_params *params,
+                             const VkImageCreateInfo *iinfo)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    if (!p->host_local || !params->host_writable || !params->sampleable)
+        return false;
+    if (iinfo->imageType != VK_IMAGE_TYPE_2D || params->renderable ||
+        params->storable || params->blit_src || params->blit_dst ||
+        params->format->emulated || params->format->num_planes ||
+        params->export_handle || params->import_handle)
+    {
+        return false;
+    }
+
+    VkFormatFeatureFlags feats = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    if (params->sample_mode == PL_TEX_SAMPLE_LINEAR)
+        feats |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    VkFormatProperties fprops;
+    vkGetPhysicalDeviceFormatProperties(vk->physd, iinfo->format, &fprops);
+    if ((fprops.linearTilingFeatures & feats) != feats)
+        return false;
+
+    VkImageFormatProperties props;
+    VkResult res = vkGetPhysicalDeviceImageFormatProperties(vk->physd,
+                        iinfo->format, iinfo->imageType, VK_IMAGE_TILING_LINEAR,
+                        iinfo->usage, iinfo->flags, &props);
+    if (res != VK_SUCCESS)
+        return false;
+
+    return iinfo->extent.width <= props.maxExtent.width &&
+           iinfo->extent.height <= props.maxExtent.height;
+}
+
+// Creates the textures wrapping the individual planes of a planar texture
+static bool vk_tex_create_planes(const struct pl_gpu *gpu, struct pl_tex *tex,
+                                 const struct pl_tex_params *params)
+{
+    struct pl_tex_vk *tex_vk = TA_PRIV(tex);
+    const struct pl_fmt *fmt = params->format;
+
+    for (int i = 0; i < fmt->num_planes; i++) {
+        const struct pl_fmt_plane *plane = &fmt->planes[i];
+        const struct vk_format **pfmt = TA_PRIV(plane->format);
+
+        struct pl_tex *ptex = talloc_zero_priv(tex, struct pl_tex, struct pl_tex_vk);
+        ptex->params = (struct pl_tex_params) {
+            .w = params->w >> plane->shift_x,
+            .h = params->h >> plane->shift_y,
+            .format = plane->format,
+            .sampleable = params->sampleable,
+            .host_writable = params->host_writable,
+            .host_readable = params->host_readable,
+            .sample_mode = params->sample_mode,
+            .address_mode = params->address_mode,
+            .user_data = params->user_data,
+        };
+
+        struct pl_tex_vk *ptex_vk = TA_PRIV(ptex);
+        *ptex_vk = (struct pl_tex_vk) {
+            .external_img = true,
+            .parent = tex,
+            .type = VK_IMAGE_TYPE_2D,
+            .img = tex_vk->img,
+            .aspect = VK_IMAGE_ASPECT_PLANE_0_BIT_KHR << i,
+            .img_fmt = (*pfmt)->tfmt,
+            .usage_flags = tex_vk->usage_flags,
+            .ident = vk_new_ident(gpu),
+        };
+
+        tex->planes[tex->num_planes++] = ptex;
+        if (!vk_init_image(gpu, ptex))
+            return false;
+    }
+
+    return true;
+}
+
 static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
                                           const struct pl_tex_params *params)
 {
@@ -761,6 +1584,7 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
 
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
     const struct vk_format **fmt = TA_PRIV(params->format);
+    tex_vk->ident = vk_new_ident(gpu);
     tex_vk->img_fmt = (*fmt)->tfmt;
 
     switch (pl_tex_params_dimension(*params)) {
@@ -831,9 +1655,15 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
         .handleTypes = vk_mem_handle_type(handle_type),
     };
 
+    // The planes of planar images are viewed with their own formats
+    VkImageCreateFlags iflags = 0;
+    if (params->format->num_planes)
+        iflags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+
     VkImageCreateInfo iinfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .pNext = handle_type ? &ext_info : NULL,
+        .flags = iflags,
         .imageType = tex_vk->type,
         .format = tex_vk->img_fmt,
         .extent = (VkExtent3D) {
@@ -879,6 +1709,75 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
     };
 
     VkResult res;
+
+    // For dmabufs, the memory layout is communicated by the DRM format
+    // modifier, if supported. Imports use the explicitly given modifier and
+    // plane layout, exports let the driver pick from all usable modifiers.
+    bool drm_mods = handle_type == PL_HANDLE_DMA_BUF &&
+                    params->format->num_modifiers;
+#ifdef VK_EXT_image_drm_format_modifier
+    const struct pl_shared_mem *shmem = &params->shared_mem;
+    VkSubresourceLayout plane = {
+        .offset = shmem->offset,
+        .rowPitch = PL_DEF(shmem->pitch, params->w * params->format->texel_size),
+    };
+
+    VkImageDrmFormatModifierExplicitCreateInfoEXT drm_explicit = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT,
+        .drmFormatModifier = shmem->drm_format_mod,
+        .drmFormatModifierPlaneCount = 1,
+        .pPlaneLayouts = &plane,
+    };
+
+    VkImageDrmFormatModifierListCreateInfoEXT drm_list = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_LIST_CREATE_INFO_EXT,
+    };
+
+    VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_pinfo = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT,
+        .drmFormatModifier = shmem->drm_format_mod,
+        .sharingMode = iinfo.sharingMode,
+        .queueFamilyIndexCount = iinfo.queueFamilyIndexCount,
+        .pQueueFamilyIndices = qfs,
+    };
+
+    if (drm_mods) {
+        iinfo.tiling = pinfo.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+        ext_pinfo.pNext = &drm_pinfo;
+        ext_info.pNext = &drm_explicit;
+    }
+
+    if (drm_mods && params->export_handle) {
+        // Restrict the list to the modifiers compatible with our usage
+        uint64_t *mods = NULL;
+        int num_mods = 0;
+        for (int i = 0; i < params->format->num_modifiers; i++) {
+            drm_pinfo.drmFormatModifier = params->format->modifiers[i];
+            res = vk->vkGetPhysicalDeviceImageFormatProperties2KHR(vk->physd,
+                                                                   &pinfo, &props);
+            if (res == VK_SUCCESS &&
+                vk_external_mem_check(&ext_props.externalMemoryProperties,
+                                      handle_type, false))
+            {
+                TARRAY_APPEND(tex, mods, num_mods, drm_pinfo.drmFormatModifier);
+            }
+        }
+
+        if (num_mods) {
+            drm_list.drmFormatModifierCount = num_mods;
+            drm_list.pDrmFormatModifiers = mods;
+            drm_pinfo.drmFormatModifier = mods[0];
+            ext_info.pNext = &drm_list;
+        } else {
+            // Fall back to the driver's internal layout
+            iinfo.tiling = pinfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            ext_pinfo.pNext = NULL;
+            ext_info.pNext = NULL;
+            drm_mods = false;
+        }
+    }
+#endif
+
     res = vk->vkGetPhysicalDeviceImageFormatProperties2KHR(vk->physd, &pinfo, &props);
     if (res == VK_ERROR_FORMAT_NOT_SUPPORTED) {
         goto error;
@@ -908,44 +1807,104 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
         }
     }
 
-    VK(vkCreateImage(vk->dev, &iinfo, VK_ALLOC, &tex_vk->img));
-    tex_vk->usage_flags = iinfo.usage;
-
+    struct vk_memslice *mem = &tex_vk->mem;
     VkMemoryPropertyFlags memFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     VkMemoryRequirements reqs;
-    vkGetImageMemoryRequirements(vk->dev, tex_vk->img, &reqs);
 
-    struct vk_memslice *mem = &tex_vk->mem;
+    if (vk_tex_direct_ok(gpu, params, &iinfo)) {
+        VkImageCreateInfo linfo = iinfo;
+        linfo.tiling = VK_IMAGE_TILING_LINEAR;
+        linfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+        VK(vkCreateImage(vk->dev, &linfo, VK_ALLOC, &tex_vk->img));
+        vkGetImageMemoryRequirements(vk->dev, tex_vk->img, &reqs);
+
+        VkMemoryPropertyFlags flags = memFlags | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        tex_vk->direct = vk_malloc_has_memtype(p->alloc, reqs.memoryTypeBits,
+                                               flags, 256 << 20) &&
+                         vk_malloc_generic(p->alloc, reqs, flags, 0,
+                                           tex_vk->img, mem);
+
+        if (!tex_vk->direct) {
+            // Fall back to a regular (optimally tiled) image
+            vkDestroyImage(vk->dev, tex_vk->img, VK_ALLOC);
+            tex_vk->img = VK_NULL_HANDLE;
+        }
+    }
+
+    if (!tex_vk->direct) {
+        VK(vkCreateImage(vk->dev, &iinfo, VK_ALLOC, &tex_vk->img));
+        vkGetImageMemoryRequirements(vk->dev, tex_vk->img, &reqs);
+    }
+    tex_vk->usage_flags = iinfo.usage;
+
     if (params->import_handle) {
         if (!vk_malloc_import(p->alloc, params->import_handle,
-                              &params->shared_mem, mem))
+                              &params->shared_mem, reqs,
+                              drm_mods ? tex_vk->img : VK_NULL_HANDLE, mem))
         {
             goto error;
         }
-        // Currently, we know that attempting to bind imported memory may generate
-        // validation errors because there's no way to communicate the memory
-        // layout; the validation layer will rely on the expected Vulkan layout
-        // for the image. As long as the driver can handle the image, we'll be ok
-        // so we don't want these validation errors to fire and create false
-        // positives.
-        vk->ctx->suppress_errors_for_object = (uint64_t)tex_vk->img;
-    } else {
-        if (!vk_malloc_generic(p->alloc, reqs, memFlags, params->export_handle, mem))
+        // Without DRM format modifiers, we know that attempting to bind
+        // imported memory may generate validation errors because there's no
+        // way to communicate the memory layout; the validation layer will rely
+        // on the expected Vulkan layout for the image. As long as the driver
+        // can handle the image, we'll be ok so we don't want these validation
+        // errors to fire and create false positives.
+        if (!drm_mods)
+            vk->ctx->suppress_errors_for_object = (uint64_t)tex_vk->img;
+    } else if (!tex_vk->direct) {
+        if (!vk_malloc_generic(p->alloc, reqs, memFlags, params->export_handle,
+                               tex_vk->img, mem))
             goto error;
     }
     VK(vkBindImageMemory(vk->dev, tex_vk->img, mem->vkmem, mem->offset));
     if (params->import_handle)
         vk->ctx->suppress_errors_for_object = VK_NULL_HANDLE;
 
+    // Planar images are only ever sampled from through their planes
+    if (params->format->num_planes)
+        tex->params.sampleable = false;
+
     if (!vk_init_image(gpu, tex))
         goto error;
 
+    if (params->format->num_planes && !vk_tex_create_planes(gpu, tex, params))
+        goto error;
+
+    if (tex_vk->direct) {
+        VkImageSubresource subres = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT };
+        vkGetImageSubresourceLayout(vk->dev, tex_vk->img, &subres,
+                                    &tex_vk->direct_layout);
+        tex_vk->current_layout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+    }
+
     if (params->export_handle) {
         tex->shared_mem = tex_vk->mem.shared_mem;
         // Texture is not initially exported;
         // pl_vulkan_hold must be used to export it.
     }
 
+#ifdef VK_EXT_image_drm_format_modifier
+    if (drm_mods && params->export_handle) {
+        VkImageDrmFormatModifierPropertiesEXT drm_props = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_PROPERTIES_EXT,
+        };
+
+        VK(vk->vkGetImageDrmFormatModifierPropertiesEXT(vk->dev, tex_vk->img,
+                                                        &drm_props));
+
+        VkSubresourceLayout layout;
+        VkImageSubresource subres = {
+            .aspectMask = VK_IMAGE_ASPECT_MEMORY_PLANE_0_BIT_EXT,
+        };
+        vkGetImageSubresourceLayout(vk->dev, tex_vk->img, &subres, &layout);
+
+        tex->shared_mem.drm_format_mod = drm_props.drmFormatModifier;
+        tex->shared_mem.offset += layout.offset;
+        tex->shared_mem.pitch = layout.rowPitch;
+    }
+#endif
+
     if (params->initial_data) {
         struct pl_tex_transfer_params ul_params = {
             .tex = tex,
@@ -975,7 +1934,11 @@ error:
 static void vk_tex_invalidate(const struct pl_gpu *gpu, const struct pl_tex *tex)
 {
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
-    tex_vk->may_invalidate = true;
+
+    // Planes can't be invalidated individually, since they share the layout
+    // of the whole image
+    if (!tex_vk->parent)
+        tex_vk->may_invalidate = true;
 }
 
 static void vk_tex_clear(const struct pl_gpu *gpu, const struct pl_tex *tex,
@@ -1002,8 +1965,10 @@ static void vk_tex_clear(const struct pl_gpu *gpu, const struct pl_tex *tex,
         .layerCount = 1,
     };
 
+    int trace = vk_trace_begin(gpu, cmd, "tex_clear");
     vkCmdClearColorImage(cmd->buf, tex_vk->img, tex_vk->current_layout,
                          &clearColor, 1, &range);
+    vk_trace_end(gpu, cmd, trace);
 
     tex_signal(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT);
 }
@@ -1019,6 +1984,7 @@ static void vk_tex_blit(const struct pl_gpu *gpu,
     if (!cmd)
         return;
 
+    vk_barrier_begin(gpu);
     tex_barrier(gpu, cmd, src, VK_PIPELINE_STAGE_TRANSFER_BIT,
                 VK_ACCESS_TRANSFER_READ_BIT,
                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -1028,12 +1994,15 @@ static void vk_tex_blit(const struct pl_gpu *gpu,
                 VK_ACCESS_TRANSFER_WRITE_BIT,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 false);
+    vk_barrier_flush(gpu, cmd);
 
     static const VkImageSubresourceLayers layers = {
         .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
         .layerCount = 1,
     };
 
+    int trace = vk_trace_begin(gpu, cmd, "tex_blit");
+
     // When the blit operation doesn't require scaling, we can use the more
     // efficient vkCmdCopyImage instead of vkCmdBlitImage
     if (pl_rect3d_eq(src_rc, dst_rc)) {
@@ -1069,6 +2038,7 @@ static void vk_tex_blit(const struct pl_gpu *gpu,
                        filters[src->params.sample_mode]);
     }
 
+    vk_trace_end(gpu, cmd, trace);
     tex_signal(gpu, cmd, src, VK_PIPELINE_STAGE_TRANSFER_BIT);
     tex_signal(gpu, cmd, dst, VK_PIPELINE_STAGE_TRANSFER_BIT);
 }
@@ -1111,6 +2081,7 @@ const struct pl_tex *pl_vulkan_wrap(const struct pl_gpu *gpu,
     };
 
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
+    tex_vk->ident = vk_new_ident(gpu);
     tex_vk->type = VK_IMAGE_TYPE_2D;
     tex_vk->external_img = true;
     tex_vk->held = true;
@@ -1194,6 +2165,7 @@ struct pl_buf_vk {
     int refcount; // 1 = object allocated but not in use, > 1 = in use
     enum queue_type update_queue;
     VkBufferView view; // for texel buffers
+    uint64_t ident; // see `vk_new_ident`
     // "current" metadata, can change during course of execution
     VkAccessFlags current_access;
     bool exported;
@@ -1201,10 +2173,20 @@ struct pl_buf_vk {
     // the signal guards reuse, and can be NULL
     struct vk_signal *sig;
     VkPipelineStageFlags sig_stage;
+    // completion of the last command using this buffer (if supported)
+    struct vk_sync_point last_use;
 };
 
 #define PL_VK_BUF_VERTEX PL_BUF_PRIVATE
 
+static inline int vk_buf_refs(struct vk_ctx *vk, struct pl_buf_vk *buf_vk)
+{
+    pthread_mutex_lock(&vk->lock);
+    int refcount = buf_vk->refcount;
+    pthread_mutex_unlock(&vk->lock);
+    return refcount;
+}
+
 static void vk_buf_deref(const struct pl_gpu *gpu, struct pl_buf *buf)
 {
     if (!buf)
@@ -1214,7 +2196,10 @@ static void vk_buf_deref(const struct pl_gpu *gpu, struct pl_buf *buf)
     struct vk_ctx *vk = p->vk;
     struct pl_buf_vk *buf_vk = TA_PRIV(buf);
 
-    if (--buf_vk->refcount == 0) {
+    pthread_mutex_lock(&vk->lock);
+    bool last = --buf_vk->refcount == 0;
+    pthread_mutex_unlock(&vk->lock);
+    if (last) {
         vk_signal_destroy(vk, &buf_vk->sig);
         vkDestroyBufferView(vk->dev, buf_vk->view, VK_ALLOC);
         vk_free_memslice(p->alloc, buf_vk->slice.mem);
@@ -1284,7 +2269,7 @@ static void buf_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         buf_vk->needs_flush = false;
     }
 
-    if (buffBarrier.srcAccessMask != buffBarrier.dstAccessMask ||
+    if (!vk_access_compatible(buffBarrier.srcAccessMask, buffBarrier.dstAccessMask) ||
         buffBarrier.srcQueueFamilyIndex != buffBarrier.dstQueueFamilyIndex)
     {
         switch (type) {
@@ -1293,13 +2278,12 @@ static void buf_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
             // VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
             buffBarrier.srcAccessMask = 0;
             src_stages |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            vkCmdPipelineBarrier(cmd->buf, src_stages, stage, 0, 0, NULL,
-                                 1, &buffBarrier, 0, NULL);
+            vk_barrier(gpu, cmd, src_stages, stage, &buffBarrier, NULL);
             break;
         case VK_WAIT_BARRIER:
             // Regular pipeline barrier is required
-            vkCmdPipelineBarrier(cmd->buf, buf_vk->sig_stage | src_stages,
-                                 stage, 0, 0, NULL, 1, &buffBarrier, 0, NULL);
+            vk_barrier(gpu, cmd, buf_vk->sig_stage | src_stages, stage,
+                       &buffBarrier, NULL);
             break;
         case VK_WAIT_EVENT:
             // We can/should use the VkEvent for synchronization
@@ -1312,7 +2296,12 @@ static void buf_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
 
     buf_vk->current_access = newAccess;
     buf_vk->exported = export;
+    buf_vk->last_use = vk_cmd_sync_point(cmd);
+
+    // Dereferenced by callbacks, which may run on any thread
+    pthread_mutex_lock(&vk->lock);
     buf_vk->refcount++;
+    pthread_mutex_unlock(&vk->lock);
     vk_cmd_callback(cmd, (vk_cb) vk_buf_deref, gpu, buf);
 }
 
@@ -1374,6 +2363,7 @@ static void buf_flush(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     vkCmdPipelineBarrier(cmd->buf, buf_vk->sig_stage,
                          VK_PIPELINE_STAGE_HOST_BIT, 0,
                          0, NULL, 1, &buffBarrier, 0, NULL);
+    vk_get_rec(gpu)->stats.barriers++;
 
     // Invalidate the mapped memory as soon as this barrier completes
     if (buf_vk->slice.mem.data && !buf_vk->slice.mem.coherent)
@@ -1456,7 +2446,7 @@ static bool vk_buf_export(const struct pl_gpu *gpu, const struct pl_buf *buf)
     if (buf_vk->exported)
         return true;
 
-    struct vk_cmd *cmd = PL_DEF(p->cmd, vk_require_cmd(gpu, GRAPHICS));
+    struct vk_cmd *cmd = PL_DEF(vk_cur_cmd(gpu), vk_require_cmd(gpu, GRAPHICS));
     if (!cmd) {
         PL_ERR(gpu, "Failed exporting buffer!");
         return false;
@@ -1482,6 +2472,7 @@ static const struct pl_buf *vk_buf_create(const struct pl_gpu *gpu,
     buf->params.initial_data = NULL;
 
     struct pl_buf_vk *buf_vk = TA_PRIV(buf);
+    buf_vk->ident = vk_new_ident(gpu);
     buf_vk->current_access = 0;
     buf_vk->refcount = 1;
 
@@ -1509,6 +2500,7 @@ static const struct pl_buf *vk_buf_create(const struct pl_gpu *gpu,
         break;
     case PL_BUF_STORAGE:
         bufFlags |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        bufFlags |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT; // for compute_indirect
         mem_type = PL_BUF_MEM_DEVICE;
         align = pl_lcm(align, vk->limits.minStorageBufferOffsetAlignment);
         buf_vk->update_queue = vk->pool_compute ? COMPUTE : GRAPHICS;
@@ -1549,7 +2541,10 @@ static const struct pl_buf *vk_buf_create(const struct pl_gpu *gpu,
     }
 
     if (params->host_mapped || params->host_readable) {
-        memFlags |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        // Uniform buffers are never read back by the host, and cached memory
+        // is rarely device local, so don't require it for them
+        if (params->type != PL_BUF_UNIFORM)
+            memFlags |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
         host_mapped = true;
     }
 
@@ -1576,9 +2571,18 @@ static const struct pl_buf *vk_buf_create(const struct pl_gpu *gpu,
         size = PL_ALIGN(size, vk->limits.nonCoherentAtomSize);
     }
 
-    if (!vk_malloc_buffer(p->alloc, bufFlags, memFlags, size, align,
-                          params->handle_type, &buf_vk->slice))
+    if (params->import_handle) {
+        if (!vk_malloc_import_buffer(p->alloc, bufFlags, params->import_handle,
+                                     &params->shared_mem, &buf_vk->slice))
+            goto error;
+
+        // Imported host memory is inherently mapped
+        buf->data = buf_vk->slice.mem.data;
+    } else if (!vk_malloc_buffer(p->alloc, bufFlags, memFlags, size, align,
+                                 params->handle_type, &buf_vk->slice))
+    {
         goto error;
+    }
 
     if (params->host_mapped)
         buf->data = buf_vk->slice.mem.data;
@@ -1620,16 +2624,33 @@ static bool vk_buf_poll(const struct pl_gpu *gpu, const struct pl_buf *buf,
 
     // Opportunistically check if we can re-use this buffer without flush
     vk_poll_commands(vk, 0);
-    if (buf_vk->refcount == 1)
+    if (vk_buf_refs(vk, buf_vk) == 1)
         return false;
 
     // Otherwise, we're force to submit all queued commands so that the
     // user is guaranteed to see progress eventually, even if they call
     // this in a tight loop
     vk_submit(gpu);
-    vk_poll_commands(vk, timeout);
+    if (vk->has_timeline) {
+        // Wait for exactly the command we need, rather than whatever
+        // happens to be the oldest pending command
+        if (vk_sync_point_wait(vk, buf_vk->last_use, timeout))
+            vk_poll_commands(vk, 0);
+    } else {
+        vk_poll_commands(vk, timeout);
+    }
+
+    return vk_buf_refs(vk, buf_vk) > 1;
+}
 
-    return buf_vk->refcount > 1;
+// Buffer offsets of image copies must be multiples of both 4 and the texel
+// size. Our own allocations are always suitably aligned, but the offsets of
+// imported buffers are up to the user, so check the effective offset.
+static bool vk_xfer_unaligned(const struct pl_tex_transfer_params *params)
+{
+    const struct pl_buf_vk *buf_vk = TA_PRIV(params->buf);
+    VkDeviceSize offset = buf_vk->slice.mem.offset + params->buf_offset;
+    return offset % 4 || offset % params->tex->params.format->texel_size;
 }
 
 static enum queue_type vk_img_copy_queue(const struct pl_gpu *gpu,
@@ -1682,15 +2703,95 @@ static enum queue_type vk_img_copy_queue(const struct pl_gpu *gpu,
     }
 }
 
+// Wrapper around `pl_buf_pool_get` for the staging buffers used by texture
+// transfers, which accounts for them in `pl_gpu_stats`
+static const struct pl_buf *vk_staging_get(const struct pl_gpu *gpu,
+                                           struct pl_buf_pool *pool,
+                                           const struct pl_buf_params *params)
+{
+    struct pl_buf_pool_stats old = pool->stats;
+    const struct pl_buf *buf = pl_buf_pool_get(gpu, pool, params);
+    struct vk_rec *rec = vk_get_rec(gpu);
+    rec->stats.staging_allocs += pool->stats.misses - old.misses;
+    rec->stats.staging_blocks += pool->stats.blocks - old.blocks;
+    return buf;
+}
+
+// Writes the data straight into the memory backing a `direct` texture.
+// Returns false if the texture is still in use by the GPU, in which case the
+// upload must be ordered against that use with a regular copy instead.
+static bool vk_tex_upload_direct(const struct pl_gpu *gpu,
+                                 const struct pl_tex_transfer_params *params)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    const struct pl_tex *tex = params->tex;
+    struct pl_tex_vk *tex_vk = TA_PRIV(tex);
+
+    if (tex_vk->held || tex_vk->num_ext_deps)
+        return false;
+    if (!vk_sync_point_wait(vk, tex_vk->last_use, 0))
+        return false;
+
+    const struct pl_rect3d rc = params->rc;
+    const size_t texel_size = tex->params.format->texel_size;
+    const size_t row_size = (rc.x1 - rc.x0) * texel_size;
+    const VkSubresourceLayout *layout = &tex_vk->direct_layout;
+    uint8_t *dst = (uint8_t *) tex_vk->mem.data + layout->offset;
+    const uint8_t *src = params->ptr;
+
+    for (int y = rc.y0; y < rc.y1; y++) {
+        memcpy(dst + y * layout->rowPitch + rc.x0 * texel_size,
+               src + (y - rc.y0) * params->stride_w * texel_size, row_size);
+    }
+
+    if (!tex_vk->mem.coherent) {
+        VK(vkFlushMappedMemoryRanges(vk->dev, 1, &(VkMappedMemoryRange) {
+            .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .memory = tex_vk->mem.vkmem,
+            .offset = tex_vk->mem.offset,
+            .size = tex_vk->mem.size,
+        }));
+
+        // Ignore errors (after logging), nothing useful we can do anyway
+    error: ;
+    }
+
+    // Host writes made before a submission are implicitly visible to it, so
+    // there is nothing left to synchronize. This also overrides any pending
+    // invalidation, since the contents are now defined.
+    tex_vk->current_access = 0;
+    tex_vk->may_invalidate = false;
+    return true;
+}
+
 static bool vk_tex_upload(const struct pl_gpu *gpu,
-                          const struct pl_tex_transfer_params *params)
+                          const struct pl_tex_transfer_params *params);
+static bool vk_tex_download(const struct pl_gpu *gpu,
+                            const struct pl_tex_transfer_params *params);
+
+static bool vk_tex_upload_internal(const struct pl_gpu *gpu,
+                                   const struct pl_tex_transfer_params *params)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     const struct pl_tex *tex = params->tex;
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
 
-    if (!params->buf)
+    if (!params->buf) {
+        if (tex_vk->direct && vk_tex_upload_direct(gpu, params))
+            return true;
         return pl_tex_upload_pbo(gpu, &tex_vk->pbo_write, params);
+    }
+
+    if (tex->num_planes) {
+        // Record the copies of all planes from the same buffer
+        for (int i = 0; i < tex->num_planes; i++) {
+            struct pl_tex_transfer_params plane = pl_tex_transfer_plane(params, i);
+            if (!vk_tex_upload(gpu, &plane))
+                return false;
+        }
+        return true;
+    }
 
     pl_assert(params->buf);
     const struct pl_buf *buf = params->buf;
@@ -1699,13 +2800,13 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
     size_t size = pl_tex_transfer_size(params);
 
     bool emulated = tex->params.format->emulated;
-    bool unaligned = params->buf_offset % 4 != 0;
+    bool unaligned = vk_xfer_unaligned(params);
 
     if (emulated || unaligned) {
 
         // Copy the source data buffer into an intermediate buffer
         const struct pl_buf *tbuf;
-        tbuf = pl_buf_pool_get(gpu, &tex_vk->tmp_write, &(struct pl_buf_params) {
+        tbuf = vk_staging_get(gpu, &tex_vk->tmp_write, &(struct pl_buf_params) {
             .type = emulated ? PL_BUF_TEXEL_UNIFORM : PL_BUF_TEX_TRANSFER,
             .size = size,
             .memory_type = PL_BUF_MEM_DEVICE,
@@ -1731,11 +2832,13 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
             .size = size,
         };
 
+        vk_barrier_begin(gpu);
         buf_barrier(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_READ_BIT, params->buf_offset, size,
                     false);
         buf_barrier(gpu, cmd, tbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_WRITE_BIT, 0, size, false);
+        vk_barrier_flush(gpu, cmd);
         vkCmdCopyBuffer(cmd->buf, buf_vk->slice.buf, tbuf_vk->slice.buf,
                         1, &region);
 
@@ -1746,8 +2849,13 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
         fixed.buf = tbuf;
         fixed.buf_offset = 0;
 
-        return emulated ? pl_tex_upload_texel(gpu, p->dp, &fixed)
-                        : pl_tex_upload(gpu, &fixed);
+        if (!emulated)
+            return pl_tex_upload(gpu, &fixed);
+
+        pthread_mutex_lock(&p->dp_lock);
+        bool ok = pl_tex_upload_texel(gpu, p->dp, &fixed);
+        pthread_mutex_unlock(&p->dp_lock);
+        return ok;
 
     } else {
 
@@ -1758,7 +2866,7 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
             .imageOffset = { rc.x0, rc.y0, rc.z0 },
             .imageExtent = { rc.x1, rc.y1, rc.z1 },
             .imageSubresource = {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .aspectMask = tex_vk->aspect,
                 .layerCount = 1,
             },
         };
@@ -1768,14 +2876,18 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
         if (!cmd)
             goto error;
 
+        vk_barrier_begin(gpu);
         buf_barrier(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_READ_BIT, params->buf_offset, size,
                     false);
         tex_barrier(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_WRITE_BIT,
                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, false);
+        vk_barrier_flush(gpu, cmd);
+        int trace = vk_trace_begin(gpu, cmd, "tex_upload");
         vkCmdCopyBufferToImage(cmd->buf, buf_vk->slice.buf, tex_vk->img,
                                tex_vk->current_layout, 1, &region);
+        vk_trace_end(gpu, cmd, trace);
         buf_signal(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT);
         tex_signal(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT);
     }
@@ -1786,15 +2898,94 @@ error:
     return false;
 }
 
-static bool vk_tex_download(const struct pl_gpu *gpu,
-                            const struct pl_tex_transfer_params *params)
+struct vk_download_cb {
+    void (*callback)(void *priv);
+    void *priv;
+    // For downloads to host memory: staging buffer to copy the data out of
+    const struct pl_buf *staging;
+    void *ptr;
+    size_t size;
+};
+
+static void vk_download_done(const struct pl_gpu *gpu,
+                             struct vk_download_cb *cb)
+{
+    if (cb->staging) {
+        vk_buf_read(gpu, cb->staging, 0, cb->ptr, cb->size);
+        vk_buf_deref(gpu, (struct pl_buf *) cb->staging);
+    }
+
+    cb->callback(cb->priv);
+    talloc_free(cb);
+}
+
+// Fires `params->callback` once `cmd` completes
+static void vk_download_callback(const struct pl_gpu *gpu, struct vk_cmd *cmd,
+                                 const struct pl_tex_transfer_params *params,
+                                 const struct pl_buf *staging, void *ptr)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_download_cb *cb = talloc_ptrtype(NULL, cb);
+    *cb = (struct vk_download_cb) {
+        .callback = params->callback,
+        .priv = params->priv,
+        .staging = staging,
+        .ptr = ptr,
+        .size = pl_tex_transfer_size(params),
+    };
+
+    if (staging) {
+        // Hold on to the staging buffer so the pool can't hand it out again
+        // before the data was copied out of it
+        struct pl_buf_vk *staging_vk = TA_PRIV(staging);
+        pthread_mutex_lock(&p->vk->lock);
+        staging_vk->refcount++;
+        pthread_mutex_unlock(&p->vk->lock);
+    }
+
+    vk_cmd_callback(cmd, (vk_cb) vk_download_done, gpu, cb);
+}
+
+static bool vk_tex_download_internal(const struct pl_gpu *gpu,
+                                     const struct pl_tex_transfer_params *params)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     const struct pl_tex *tex = params->tex;
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
+    const struct pl_buf *staging = NULL;
+    struct pl_tex_transfer_params staged;
+    void *ptr = params->ptr;
+
+    if (!params->buf) {
+        if (!params->callback)
+            return pl_tex_download_pbo(gpu, &tex_vk->pbo_read, params);
+
+        // Asynchronous download to host memory, go through a pooled
+        // host-mapped buffer and copy the result out on completion
+        staging = vk_staging_get(gpu, &tex_vk->pbo_read, &(struct pl_buf_params) {
+            .type = PL_BUF_TEX_TRANSFER,
+            .size = pl_tex_transfer_size(params),
+            .host_readable = true,
+        });
+
+        if (!staging)
+            goto error;
+
+        staged = *params;
+        staged.buf = staging;
+        staged.buf_offset = 0;
+        staged.ptr = NULL;
+        params = &staged;
+    }
 
-    if (!params->buf)
-        return pl_tex_download_pbo(gpu, &tex_vk->pbo_read, params);
+    if (tex->num_planes) {
+        for (int i = 0; i < tex->num_planes; i++) {
+            struct pl_tex_transfer_params plane = pl_tex_transfer_plane(params, i);
+            if (!vk_tex_download(gpu, &plane))
+                return false;
+        }
+        return true;
+    }
 
     pl_assert(params->buf);
     const struct pl_buf *buf = params->buf;
@@ -1803,13 +2994,13 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
     size_t size = pl_tex_transfer_size(params);
 
     bool emulated = tex->params.format->emulated;
-    bool unaligned = params->buf_offset % 4 != 0;
+    bool unaligned = vk_xfer_unaligned(params);
 
     if (emulated || unaligned) {
 
         // Download into an intermediate buffer first
         const struct pl_buf *tbuf;
-        tbuf = pl_buf_pool_get(gpu, &tex_vk->tmp_read, &(struct pl_buf_params) {
+        tbuf = vk_staging_get(gpu, &tex_vk->tmp_read, &(struct pl_buf_params) {
             .type = emulated ? PL_BUF_TEXEL_STORAGE : PL_BUF_TEX_TRANSFER,
             .size = size,
             .memory_type = PL_BUF_MEM_DEVICE,
@@ -1824,9 +3015,16 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
         struct pl_tex_transfer_params fixed = *params;
         fixed.buf = tbuf;
         fixed.buf_offset = 0;
+        fixed.callback = NULL;
 
-        bool ok = emulated ? pl_tex_download_texel(gpu, p->dp, &fixed)
-                           : pl_tex_download(gpu, &fixed);
+        bool ok;
+        if (emulated) {
+            pthread_mutex_lock(&p->dp_lock);
+            ok = pl_tex_download_texel(gpu, p->dp, &fixed);
+            pthread_mutex_unlock(&p->dp_lock);
+        } else {
+            ok = pl_tex_download(gpu, &fixed);
+        }
         if (!ok)
             goto error;
 
@@ -1841,16 +3039,20 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
             .size = size,
         };
 
+        vk_barrier_begin(gpu);
         buf_barrier(gpu, cmd, tbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_READ_BIT, 0, size, false);
         buf_barrier(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_WRITE_BIT, params->buf_offset, size,
                     false);
+        vk_barrier_flush(gpu, cmd);
         vkCmdCopyBuffer(cmd->buf, tbuf_vk->slice.buf, buf_vk->slice.buf,
                         1, &region);
         buf_signal(gpu, cmd, tbuf, VK_PIPELINE_STAGE_TRANSFER_BIT);
         buf_signal(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT);
         buf_flush(gpu, cmd, buf, params->buf_offset, size);
+        if (params->callback)
+            vk_download_callback(gpu, cmd, params, staging, ptr);
 
     } else {
 
@@ -1861,7 +3063,7 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
             .imageOffset = { rc.x0, rc.y0, rc.z0 },
             .imageExtent = { rc.x1, rc.y1, rc.z1 },
             .imageSubresource = {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .aspectMask = tex_vk->aspect,
                 .layerCount = 1,
             },
         };
@@ -1871,17 +3073,23 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
         if (!cmd)
             goto error;
 
+        vk_barrier_begin(gpu);
         buf_barrier(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_WRITE_BIT, params->buf_offset, size,
                     false);
         tex_barrier(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_READ_BIT,
                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false);
+        vk_barrier_flush(gpu, cmd);
+        int trace = vk_trace_begin(gpu, cmd, "tex_download");
         vkCmdCopyImageToBuffer(cmd->buf, tex_vk->img, tex_vk->current_layout,
                                buf_vk->slice.buf, 1, &region);
+        vk_trace_end(gpu, cmd, trace);
         buf_signal(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT);
         tex_signal(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT);
         buf_flush(gpu, cmd, buf, params->buf_offset, size);
+        if (params->callback)
+            vk_download_callback(gpu, cmd, params, staging, ptr);
     }
 
     return true;
@@ -1890,12 +3098,48 @@ error:
     return false;
 }
 
+// Wrappers which only count the outermost calls, since the internal functions
+// may recurse (e.g. per plane, or via an intermediate buffer)
+static bool vk_tex_upload(const struct pl_gpu *gpu,
+                          const struct pl_tex_transfer_params *params)
+{
+    struct vk_rec *rec = vk_get_rec(gpu);
+    if (!rec->transfer_depth++) {
+        rec->stats.tex_uploads++;
+        rec->stats.bytes_uploaded += pl_tex_transfer_size(params);
+    }
+
+    bool ok = vk_tex_upload_internal(gpu, params);
+    rec->transfer_depth--;
+    return ok;
+}
+
+static bool vk_tex_download(const struct pl_gpu *gpu,
+                            const struct pl_tex_transfer_params *params)
+{
+    struct vk_rec *rec = vk_get_rec(gpu);
+    if (!rec->transfer_depth++) {
+        rec->stats.tex_downloads++;
+        rec->stats.bytes_downloaded += pl_tex_transfer_size(params);
+    }
+
+    bool ok = vk_tex_download_internal(gpu, params);
+    rec->transfer_depth--;
+    return ok;
+}
+
 static int vk_desc_namespace(const struct pl_gpu *gpu, enum pl_desc_type type)
 {
     return 0;
 }
 
 // For pl_pass.priv
+// Identifies the contents of a single descriptor
+struct vk_desc_key {
+    uint64_t ident; // of the bound texture or buffer, 0 = never written
+    uint64_t extra; // image layout or buffer offset
+};
+
 struct pl_pass_vk {
     // Pipeline / render pass
     VkPipeline pipe;
@@ -1911,6 +3155,9 @@ struct pl_pass_vk {
     // allocate a fixed number and use a bitmask of all available sets.
     VkDescriptorSet dss[16];
     uint16_t dmask;
+    // The contents last written to each of the descriptor sets, as an array
+    // of `num_descriptors` entries per set. Used to skip redundant updates.
+    struct vk_desc_key *dskeys;
     // Vertex buffers (vertices)
     struct pl_buf_pool vbo;
     const struct pl_buf *cached_vert;
@@ -1944,6 +3191,15 @@ static void vk_pass_destroy(const struct pl_gpu *gpu, struct pl_pass *pass)
 
 MAKE_LAZY_DESTRUCTOR(vk_pass_destroy, struct pl_pass);
 
+static void vk_pass_release(const struct pl_gpu *gpu, const struct pl_pass *pass)
+{
+    // Counted here rather than in `vk_pass_destroy`, since the latter may run
+    // from an arbitrary thread (as part of a command callback)
+    if (pass)
+        vk_get_rec(gpu)->stats.passes_destroyed++;
+    vk_pass_destroy_lazy(gpu, pass);
+}
+
 static const VkDescriptorType dsType[] = {
     [PL_DESC_SAMPLED_TEX] = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
     [PL_DESC_STORAGE_IMG] = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
@@ -1954,13 +3210,14 @@ static const VkDescriptorType dsType[] = {
 };
 
 static const char vk_cache_magic[4] = {'R','A','V','K'};
-static const int vk_cache_version = 2;
+static const int vk_cache_version = 3;
 
 struct vk_cache_header {
     char magic[sizeof(vk_cache_magic)];
     int cache_version;
     char compiler[SPIRV_NAME_MAX_LEN];
     int compiler_version;
+    int optimize;
     size_t vert_spirv_len;
     size_t frag_spirv_len;
     size_t comp_spirv_len;
@@ -1993,6 +3250,8 @@ static bool vk_use_cached_program(const struct pl_pass_params *params,
         return false;
     if (header->compiler_version != spirv->compiler_version)
         return false;
+    if (header->optimize != params->optimize)
+        return false;
 
 #define GET(ptr) \
         if (cache.len < header->ptr##_len)                  \
@@ -2009,7 +3268,7 @@ static bool vk_use_cached_program(const struct pl_pass_params *params,
 
 static VkResult vk_compile_glsl(const struct pl_gpu *gpu, void *tactx,
                                 enum glsl_shader_stage type, const char *glsl,
-                                struct bstr *spirv)
+                                enum pl_shader_opt opt, struct bstr *spirv)
 {
     struct pl_vk *p = TA_PRIV(gpu);
 
@@ -2022,7 +3281,7 @@ static VkResult vk_compile_glsl(const struct pl_gpu *gpu, void *tactx,
     PL_DEBUG(gpu, "%s shader source:", shader_names[type]);
     pl_msg_source(gpu->ctx, PL_LOG_DEBUG, glsl);
 
-    if (!p->spirv->impl->compile_glsl(p->spirv, tactx, type, glsl, spirv)) {
+    if (!spirv_compile_glsl(p->spirv, tactx, type, glsl, opt, spirv)) {
         pl_msg_source(gpu->ctx, PL_LOG_ERR, glsl);
         return VK_ERROR_INITIALIZATION_FAILED;
     }
@@ -2035,11 +3294,14 @@ static const VkShaderStageFlags stageFlags[] = {
     [PL_PASS_COMPUTE] = VK_SHADER_STAGE_COMPUTE_BIT,
 };
 
+// This may be called from any thread (see `pl_dispatch_params.async_compile`),
+// so it must not touch any shared mutable state without holding `vk->lock`
 static const struct pl_pass *vk_pass_create(const struct pl_gpu *gpu,
                                             const struct pl_pass_params *params)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
+    uint64_t start = pl_clock_ns();
     bool success = false;
 
     struct pl_pass *pass = talloc_zero_priv(NULL, struct pl_pass, struct pl_pass_vk);
@@ -2056,17 +3318,21 @@ static const struct pl_pass *vk_pass_create(const struct pl_gpu *gpu,
     VkShaderModule frag_shader = VK_NULL_HANDLE;
     VkShaderModule comp_shader = VK_NULL_HANDLE;
 
+    // Bindless passes always need a descriptor set layout for set 0, even if
+    // it ends up empty, since the texture heap is bound as set 1
     int num_desc = params->num_descriptors;
-    if (!num_desc)
+    if (!num_desc && !params->bindless)
         goto no_descriptors;
 
     pass_vk->dswrite = talloc_array(pass, VkWriteDescriptorSet, num_desc);
+    pass_vk->dskeys = talloc_zero_array(pass, struct vk_desc_key,
+                                        num_desc * PL_ARRAY_SIZE(pass_vk->dss));
     pass_vk->dsiinfo = talloc_array(pass, VkDescriptorImageInfo, num_desc);
     pass_vk->dsbinfo = talloc_array(pass, VkDescriptorBufferInfo, num_desc);
 
 #define NUM_DS (PL_ARRAY_SIZE(pass_vk->dss))
 
-    static int dsSize[PL_DESC_TYPE_COUNT] = {0};
+    int dsSize[PL_DESC_TYPE_COUNT] = {0};
     VkDescriptorSetLayoutBinding *bindings =
         talloc_array(tmp, VkDescriptorSetLayoutBinding, num_desc);
 
@@ -2142,10 +3408,11 @@ static const struct pl_pass *vk_pass_create(const struct pl_gpu *gpu,
 
 no_descriptors: ;
 
+    VkDescriptorSetLayout setLayouts[] = { pass_vk->dsLayout, p->heap_layout };
     VkPipelineLayoutCreateInfo linfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = num_desc ? 1 : 0,
-        .pSetLayouts = &pass_vk->dsLayout,
+        .setLayoutCount = params->bindless ? 2 : num_desc ? 1 : 0,
+        .pSetLayouts = setLayouts,
         .pushConstantRangeCount = params->push_constants_size ? 1 : 0,
         .pPushConstantRanges = &(VkPushConstantRange){
             .stageFlags = stageFlags[params->type],
@@ -2165,14 +3432,14 @@ no_descriptors: ;
         switch (params->type) {
         case PL_PASS_RASTER:
             VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_VERTEX,
-                               params->vertex_shader, &vert));
+                               params->vertex_shader, params->optimize, &vert));
             VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_FRAGMENT,
-                               params->glsl_shader, &frag));
+                               params->glsl_shader, params->optimize, &frag));
             comp.len = 0;
             break;
         case PL_PASS_COMPUTE:
             VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_COMPUTE,
-                               params->glsl_shader, &comp));
+                               params->glsl_shader, params->optimize, &comp));
             frag.len = 0;
             vert.len = 0;
             break;
@@ -2192,6 +3459,29 @@ no_descriptors: ;
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
     };
 
+    // Specialization constants only ever apply to the main shader stage
+    VkSpecializationInfo specInfo = {
+        .mapEntryCount = params->num_constants,
+        .pData = params->constant_data,
+    };
+
+    VkSpecializationMapEntry *entries = talloc_array(tmp,
+            VkSpecializationMapEntry, params->num_constants);
+
+    for (int i = 0; i < params->num_constants; i++) {
+        const struct pl_constant *cons = &params->constants[i];
+        entries[i] = (VkSpecializationMapEntry) {
+            .constantID = cons->id,
+            .offset = cons->offset,
+            .size = sizeof(uint32_t),
+        };
+        specInfo.dataSize = PL_MAX(specInfo.dataSize,
+                                   cons->offset + sizeof(uint32_t));
+    }
+
+    specInfo.pMapEntries = entries;
+    const VkSpecializationInfo *pSpecInfo = params->num_constants ? &specInfo : NULL;
+
     switch (params->type) {
     case PL_PASS_RASTER: {
         sinfo.pCode = (uint32_t *) vert.start;
@@ -2298,11 +3588,12 @@ no_descriptors: ;
                     .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
                     .module = frag_shader,
                     .pName = "main",
+                    .pSpecializationInfo = pSpecInfo,
                 }
             },
             .pVertexInputState = &(VkPipelineVertexInputStateCreateInfo) {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-                .vertexBindingDescriptionCount = 1,
+                .vertexBindingDescriptionCount = params->num_vertex_attribs ? 1 : 0,
                 .pVertexBindingDescriptions = &(VkVertexInputBindingDescription) {
                     .binding = 0,
                     .stride = params->vertex_stride,
@@ -2363,6 +3654,7 @@ no_descriptors: ;
                 .stage = VK_SHADER_STAGE_COMPUTE_BIT,
                 .module = comp_shader,
                 .pName = "main",
+                .pSpecializationInfo = pSpecInfo,
             },
             .layout = pass_vk->pipeLayout,
         };
@@ -2383,6 +3675,7 @@ no_descriptors: ;
     struct vk_cache_header header = {
         .cache_version = vk_cache_version,
         .compiler_version = p->spirv->compiler_version,
+        .optimize = params->optimize,
         .vert_spirv_len = vert.len,
         .frag_spirv_len = frag.len,
         .comp_spirv_len = comp.len,
@@ -2414,6 +3707,11 @@ error:
         pass = NULL;
     }
 
+    pthread_mutex_lock(&vk->lock);
+    p->passes_created += success;
+    p->pass_compile_ns += pl_clock_ns() - start;
+    pthread_mutex_unlock(&vk->lock);
+
 #undef NUM_DS
 
     vkDestroyShaderModule(vk->dev, vert_shader, VK_ALLOC);
@@ -2429,10 +3727,12 @@ static const VkPipelineStageFlags passStages[] = {
     [PL_PASS_COMPUTE] = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 };
 
-static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
-                                 const struct pl_pass *pass,
-                                 struct pl_desc_binding db,
-                                 VkDescriptorSet ds, int idx)
+// Returns the key identifying the resulting descriptor contents
+static struct vk_desc_key vk_update_descriptor(const struct pl_gpu *gpu,
+                                               struct vk_cmd *cmd,
+                                               const struct pl_pass *pass,
+                                               struct pl_desc_binding db,
+                                               VkDescriptorSet ds, int idx)
 {
     struct pl_pass_vk *pass_vk = TA_PRIV(pass);
     struct pl_desc *desc = &pass->params.descriptors[idx];
@@ -2473,7 +3773,7 @@ static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         };
 
         wds->pImageInfo = iinfo;
-        break;
+        return (struct vk_desc_key) { tex_vk->ident, tex_vk->current_layout };
     }
     case PL_DESC_STORAGE_IMG: {
         const struct pl_tex *tex = db.object;
@@ -2489,7 +3789,7 @@ static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         };
 
         wds->pImageInfo = iinfo;
-        break;
+        return (struct vk_desc_key) { tex_vk->ident, tex_vk->current_layout };
     }
     case PL_DESC_BUF_UNIFORM:
     case PL_DESC_BUF_STORAGE: {
@@ -2502,12 +3802,12 @@ static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         VkDescriptorBufferInfo *binfo = &pass_vk->dsbinfo[idx];
         *binfo = (VkDescriptorBufferInfo) {
             .buffer = buf_vk->slice.buf,
-            .offset = buf_vk->slice.mem.offset,
-            .range = buf->params.size,
+            .offset = buf_vk->slice.mem.offset + db.buf_offset,
+            .range = buf->params.size - db.buf_offset,
         };
 
         wds->pBufferInfo = binfo;
-        break;
+        return (struct vk_desc_key) { buf_vk->ident, db.buf_offset };
     }
     case PL_DESC_BUF_TEXEL_UNIFORM:
     case PL_DESC_BUF_TEXEL_STORAGE: {
@@ -2518,7 +3818,7 @@ static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
                     access, 0, buf->params.size, false);
 
         wds->pTexelBufferView = &buf_vk->view;
-        break;
+        return (struct vk_desc_key) { buf_vk->ident, 0 };
     }
     default: abort();
     }
@@ -2556,6 +3856,131 @@ static void set_ds(struct pl_pass_vk *pass_vk, uintptr_t dsbit)
     pass_vk->dmask |= dsbit;
 }
 
+// `dmask` is updated by callbacks, so it's guarded by `vk->lock`
+static inline uint16_t vk_pass_dmask(struct vk_ctx *vk,
+                                     struct pl_pass_vk *pass_vk)
+{
+    pthread_mutex_lock(&vk->lock);
+    uint16_t dmask = pass_vk->dmask;
+    pthread_mutex_unlock(&vk->lock);
+    return dmask;
+}
+
+// Number of measurements a single timer can have in flight at once
+#define VK_TIMER_QUERIES 16
+
+struct pl_timer {
+    VkQueryPool qpool; // 2 queries per measurement: start, stop
+    int index_write;   // next measurement slot to record into
+    int index_read;    // oldest measurement slot not yet queried
+    int num_pending;   // number of measurements recorded but not queried
+    uint32_t done;     // bitmask of measurement slots known to be complete
+};
+
+static void timer_done(struct pl_timer *timer, uintptr_t bit)
+{
+    timer->done |= bit;
+}
+
+static void vk_timer_destroy(const struct pl_gpu *gpu, struct pl_timer *timer)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    vkDestroyQueryPool(vk->dev, timer->qpool, VK_ALLOC);
+    talloc_free(timer);
+}
+
+MAKE_LAZY_DESTRUCTOR(vk_timer_destroy, struct pl_timer);
+
+static struct pl_timer *vk_timer_create(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    if (!p->timestamp_mask)
+        return NULL;
+
+    struct pl_timer *timer = talloc_zero(NULL, struct pl_timer);
+
+    VkQueryPoolCreateInfo qinfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * VK_TIMER_QUERIES,
+    };
+
+    VK(vkCreateQueryPool(vk->dev, &qinfo, VK_ALLOC, &timer->qpool));
+    return timer;
+
+error:
+    vk_timer_destroy(gpu, timer);
+    return NULL;
+}
+
+static uint64_t vk_timer_query(const struct pl_gpu *gpu, struct pl_timer *timer)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    uint32_t bit = 1u << timer->index_read;
+    if (!timer->num_pending)
+        return 0;
+
+    // Only query slots whose command is known to have completed, since
+    // otherwise we may end up reading back stale results from a previous
+    // measurement whose reset has not been executed yet. (`done` is updated
+    // by callbacks, so it's guarded by `vk->lock`)
+    pthread_mutex_lock(&vk->lock);
+    if (!(timer->done & bit)) {
+        vk_poll_commands(vk, 0);
+        if (!(timer->done & bit)) {
+            pthread_mutex_unlock(&vk->lock);
+            return 0;
+        }
+    }
+    timer->done &= ~bit;
+    pthread_mutex_unlock(&vk->lock);
+
+    uint64_t ts[2];
+    VkResult res = vkGetQueryPoolResults(vk->dev, timer->qpool,
+                                         2 * timer->index_read, 2, sizeof(ts),
+                                         &ts[0], sizeof(uint64_t),
+                                         VK_QUERY_RESULT_64_BIT);
+
+    timer->index_read = (timer->index_read + 1) % VK_TIMER_QUERIES;
+    timer->num_pending--;
+    if (res != VK_SUCCESS) {
+        PL_ERR(gpu, "Failed querying timer: %s", vk_res_str(res));
+        return 0;
+    }
+
+    uint64_t ticks = (ts[1] - ts[0]) & p->timestamp_mask;
+    return PL_MAX(1, (uint64_t) (ticks * vk->limits.timestampPeriod));
+}
+
+// Returns the query index to use for the stop timestamp, or -1 if this
+// measurement should be skipped
+static int vk_timer_begin(const struct pl_gpu *gpu, struct vk_cmd *cmd,
+                          struct pl_timer *timer)
+{
+    if (!timer || !cmd->pool->props.timestampValidBits)
+        return -1;
+
+    if (timer->num_pending == VK_TIMER_QUERIES) {
+        PL_TRACE(gpu, "Timer queries exhausted, skipping measurement");
+        return -1;
+    }
+
+    int idx = 2 * timer->index_write;
+    vk_cmd_callback(cmd, (vk_cb) timer_done, timer,
+                    (void *)(uintptr_t) (1u << timer->index_write));
+    timer->index_write = (timer->index_write + 1) % VK_TIMER_QUERIES;
+    timer->num_pending++;
+
+    vkCmdResetQueryPool(cmd->buf, timer->qpool, idx, 2);
+    vkCmdWriteTimestamp(cmd->buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        timer->qpool, idx);
+    return idx + 1;
+}
+
 static void vk_pass_run(const struct pl_gpu *gpu,
                         const struct pl_pass_run_params *params)
 {
@@ -2564,16 +3989,31 @@ static void vk_pass_run(const struct pl_gpu *gpu,
     const struct pl_pass *pass = params->pass;
     struct pl_pass_vk *pass_vk = TA_PRIV(pass);
 
+    struct vk_rec *rec = vk_get_rec(gpu);
+    rec->stats.pass_runs++;
+    rec->stats.desc_updates += pass->params.num_descriptors;
+    rec->stats.var_updates += params->num_var_updates;
+
     static const enum queue_type types[] = {
         [PL_PASS_RASTER]  = GRAPHICS,
         [PL_PASS_COMPUTE] = COMPUTE,
     };
 
+    // While batching, prefer keeping compute passes on the graphics queue
+    // (if possible), to avoid splitting the batch on every queue switch
+    enum queue_type queue = types[pass->params.type];
+    struct vk_rec *rec = vk_get_rec(gpu);
+    if (rec->batch_depth && queue == COMPUTE &&
+        (vk->pool_graphics->props.queueFlags & VK_QUEUE_COMPUTE_BIT))
+    {
+        queue = GRAPHICS;
+    }
+
     // Update the vertex buffer before dispatching the pass, do this
     // before vk_require_cmd since it can trigger its own commands
     const struct pl_buf *vert = NULL;
     struct pl_buf_vk *vert_vk = NULL;
-    if (pass->params.type == PL_PASS_RASTER) {
+    if (pass->params.type == PL_PASS_RASTER && params->vertex_data) {
         size_t size = params->vertex_count * pass->params.vertex_stride;
         if (pass_vk->cached_vert && pass_vk->cached_size == size &&
             memcmp(params->vertex_data, pass_vk->cached_data, size) == 0)
@@ -2615,41 +4055,70 @@ static void vk_pass_run(const struct pl_gpu *gpu,
 
     if (!pass_vk->use_pushd) {
         // Wait for a free descriptor set
-        while (!pass_vk->dmask) {
+        while (!vk_pass_dmask(vk, pass_vk)) {
             PL_TRACE(gpu, "No free descriptor sets! ...blocking (slow path)");
             vk_submit(gpu);
             vk_poll_commands(vk, 10000000); // 10 ms
         }
     }
 
-    struct vk_cmd *cmd = vk_require_cmd(gpu, types[pass->params.type]);
+    struct vk_cmd *cmd = vk_require_cmd(gpu, queue);
     if (!cmd)
         goto error;
 
     // Find a descriptor set to use
     VkDescriptorSet ds = VK_NULL_HANDLE;
+    struct vk_desc_key *dskeys = NULL;
     if (!pass_vk->use_pushd) {
+        pthread_mutex_lock(&vk->lock);
         for (int i = 0; i < PL_ARRAY_SIZE(pass_vk->dss); i++) {
             uint16_t dsbit = 1u << i;
             if (pass_vk->dmask & dsbit) {
                 ds = pass_vk->dss[i];
+                dskeys = &pass_vk->dskeys[i * pass->params.num_descriptors];
                 pass_vk->dmask &= ~dsbit; // unset
                 vk_cmd_callback(cmd, (vk_cb) set_ds, pass_vk,
                                 (void *)(uintptr_t) dsbit);
                 break;
             }
         }
+        pthread_mutex_unlock(&vk->lock);
     }
 
-    // Update the dswrite structure with all of the new values
-    for (int i = 0; i < pass->params.num_descriptors; i++)
-        vk_update_descriptor(gpu, cmd, pass, params->desc_bindings[i], ds, i);
+    // All barriers needed by this pass are recorded together, right before
+    // the actual draw/dispatch call
+    vk_barrier_begin(gpu);
+
+    // Update the dswrite structure with all of the new values. Since
+    // descriptor sets retain their contents, only the descriptors that
+    // changed since this set was last used actually need to be written,
+    // which for static render graphs is usually none of them
+    int num_writes = 0;
+    for (int i = 0; i < pass->params.num_descriptors; i++) {
+        if (pass->params.bindless &&
+            pass->params.descriptors[i].type == PL_DESC_SAMPLED_TEX)
+        {
+            // Already present in the texture heap, so this only needs to
+            // synchronize access to the texture
+            tex_barrier(gpu, cmd, params->desc_bindings[i].object,
+                        passStages[pass->params.type], VK_ACCESS_SHADER_READ_BIT,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false);
+            continue;
+        }
 
-    if (!pass_vk->use_pushd) {
-        vkUpdateDescriptorSets(vk->dev, pass->params.num_descriptors,
-                               pass_vk->dswrite, 0, NULL);
+        struct vk_desc_key key;
+        key = vk_update_descriptor(gpu, cmd, pass, params->desc_bindings[i], ds, i);
+        if (dskeys) {
+            if (dskeys[i].ident == key.ident && dskeys[i].extra == key.extra)
+                continue;
+            dskeys[i] = key;
+        }
+        pass_vk->dswrite[num_writes++] = pass_vk->dswrite[i];
     }
 
+    if (!pass_vk->use_pushd && num_writes)
+        vkUpdateDescriptorSets(vk->dev, num_writes, pass_vk->dswrite, 0, NULL);
+
     // Bind the pipeline, descriptor set, etc.
     static const VkPipelineBindPoint bindPoint[] = {
         [PL_PASS_RASTER]  = VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -2663,13 +4132,18 @@ static void vk_pass_run(const struct pl_gpu *gpu,
                                 pass_vk->pipeLayout, 0, 1, &ds, 0, NULL);
     }
 
-    if (pass_vk->use_pushd) {
+    if (pass_vk->use_pushd && num_writes) {
         vk->vkCmdPushDescriptorSetKHR(cmd->buf, bindPoint[pass->params.type],
-                                      pass_vk->pipeLayout, 0,
-                                      pass->params.num_descriptors,
+                                      pass_vk->pipeLayout, 0, num_writes,
                                       pass_vk->dswrite);
     }
 
+    if (pass->params.bindless) {
+        vkCmdBindDescriptorSets(cmd->buf, bindPoint[pass->params.type],
+                                pass_vk->pipeLayout, 1, 1, &p->heap_set,
+                                0, NULL);
+    }
+
     if (pass->params.push_constants_size) {
         vkCmdPushConstants(cmd->buf, pass_vk->pipeLayout,
                            stageFlags[pass->params.type], 0,
@@ -2677,17 +4151,23 @@ static void vk_pass_run(const struct pl_gpu *gpu,
                            params->push_constants);
     }
 
+    int timer_stop = vk_timer_begin(gpu, cmd, params->timer);
+    int trace = vk_trace_begin(gpu, cmd, pass->params.type == PL_PASS_RASTER
+                                         ? "raster pass" : "compute pass");
+
     switch (pass->params.type) {
     case PL_PASS_RASTER: {
         const struct pl_tex *tex = params->target;
         struct pl_tex_vk *tex_vk = TA_PRIV(tex);
 
-        buf_barrier(gpu, cmd, vert, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, vert->params.size,
-                    false);
+        if (vert) {
+            buf_barrier(gpu, cmd, vert, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, vert->params.size,
+                        false);
 
-        vkCmdBindVertexBuffers(cmd->buf, 0, 1, &vert_vk->slice.buf,
-                               &vert_vk->slice.mem.offset);
+            vkCmdBindVertexBuffers(cmd->buf, 0, 1, &vert_vk->slice.buf,
+                                   &vert_vk->slice.mem.offset);
+        }
 
         tex_barrier(gpu, cmd, tex, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
@@ -2715,32 +4195,60 @@ static void vk_pass_run(const struct pl_gpu *gpu,
             .renderArea = (VkRect2D){{0, 0}, {tex->params.w, tex->params.h}},
         };
 
+        vk_barrier_flush(gpu, cmd);
         vkCmdBeginRenderPass(cmd->buf, &binfo, VK_SUBPASS_CONTENTS_INLINE);
         vkCmdDraw(cmd->buf, params->vertex_count, 1, 0, 0);
         vkCmdEndRenderPass(cmd->buf);
 
-        buf_signal(gpu, cmd, vert, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        if (vert)
+            buf_signal(gpu, cmd, vert, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
         // The renderPass implicitly transitions the texture to this layout
         tex_vk->current_layout = pass_vk->finalLayout;
         tex_signal(gpu, cmd, tex, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
         break;
     }
-    case PL_PASS_COMPUTE:
+    case PL_PASS_COMPUTE: {
+        const struct pl_buf *indirect = params->compute_indirect;
+        if (indirect) {
+            struct pl_buf_vk *indirect_vk = TA_PRIV(indirect);
+            size_t offset = params->compute_indirect_offset;
+            buf_barrier(gpu, cmd, indirect, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT, offset,
+                        sizeof(VkDispatchIndirectCommand), false);
+
+            vk_barrier_flush(gpu, cmd);
+            vkCmdDispatchIndirect(cmd->buf, indirect_vk->slice.buf,
+                                  indirect_vk->slice.mem.offset + offset);
+
+            buf_signal(gpu, cmd, indirect, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+            break;
+        }
+
+        vk_barrier_flush(gpu, cmd);
         vkCmdDispatch(cmd->buf, params->compute_groups[0],
                       params->compute_groups[1],
                       params->compute_groups[2]);
         break;
+    }
     default: abort();
     };
 
+    if (timer_stop >= 0) {
+        vkCmdWriteTimestamp(cmd->buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                            params->timer->qpool, timer_stop);
+    }
+
+    vk_trace_end(gpu, cmd, trace);
+
     for (int i = 0; i < pass->params.num_descriptors; i++)
         vk_release_descriptor(gpu, cmd, pass, params->desc_bindings[i], i);
 
     // flush the work so far into its own command buffer, for better
-    // intra-frame granularity
-    pl_assert(cmd == p->cmd); // make sure this is still the case
-    vk_submit(gpu);
+    // intra-frame granularity (unless batching)
+    pl_assert(cmd == rec->cmd); // make sure this is still the case
+    if (!rec->batch_depth)
+        vk_submit(gpu);
 
 error:
     return;
@@ -2790,8 +4298,12 @@ static void vk_sync_deref(const struct pl_gpu *gpu, const struct pl_sync *sync)
     if (!sync)
         return;
 
+    struct pl_vk *p = TA_PRIV(gpu);
     struct pl_sync_vk *sync_vk = TA_PRIV(sync);
-    if (--sync_vk->refcount == 0)
+    pthread_mutex_lock(&p->vk->lock);
+    bool last = --sync_vk->refcount == 0;
+    pthread_mutex_unlock(&p->vk->lock);
+    if (last)
         vk_sync_destroy(gpu, (struct pl_sync *) sync);
 }
 
@@ -2823,6 +4335,7 @@ static const struct pl_sync *vk_sync_create(const struct pl_gpu *gpu,
         sync->signal_handle.handle = NULL;
         break;
     case PL_HANDLE_DMA_BUF:
+    case PL_HANDLE_HOST_PTR:
         abort();
     }
 
@@ -2893,7 +4406,7 @@ static bool vk_tex_export(const struct pl_gpu *gpu, const struct pl_tex *tex,
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
     struct pl_sync_vk *sync_vk = TA_PRIV(sync);
 
-    struct vk_cmd *cmd = p->cmd ? p->cmd : vk_require_cmd(gpu, GRAPHICS);
+    struct vk_cmd *cmd = PL_DEF(vk_cur_cmd(gpu), vk_require_cmd(gpu, GRAPHICS));
     if (!cmd)
         goto error;
 
@@ -2907,7 +4420,9 @@ static bool vk_tex_export(const struct pl_gpu *gpu, const struct pl_tex *tex,
 
     // Remember the other dependency and hold on to the sync object
     pl_tex_vk_external_dep(gpu, tex, sync_vk->signal);
+    pthread_mutex_lock(&vk->lock);
     sync_vk->refcount++;
+    pthread_mutex_unlock(&vk->lock);
     tex_vk->ext_sync = sync;
     return true;
 
@@ -2916,6 +4431,19 @@ error:
     return false;
 }
 
+static void vk_gpu_batch(const struct pl_gpu *gpu, bool begin)
+{
+    struct vk_rec *rec = vk_get_rec(gpu);
+    if (begin) {
+        rec->batch_depth++;
+        return;
+    }
+
+    pl_assert(rec->batch_depth > 0);
+    if (--rec->batch_depth == 0)
+        vk_submit(gpu);
+}
+
 static void vk_gpu_flush(const struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
@@ -2923,6 +4451,25 @@ static void vk_gpu_flush(const struct pl_gpu *gpu)
     vk_submit(gpu);
     vk_flush_commands(vk);
     vk_rotate_queues(vk);
+    vk_malloc_garbage_collect(p->alloc, false);
+}
+
+static void vk_gpu_trim(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    vk_submit(gpu);
+    vk_flush_commands(vk);
+    vk_poll_commands(vk, 0); // run pending deferred destructors
+    vk_malloc_garbage_collect(p->alloc, true);
+}
+
+static bool vk_gpu_memory_stats(const struct pl_gpu *gpu,
+                                struct pl_gpu_memory_stats *out)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    vk_malloc_stats(p->alloc, out);
+    return true;
 }
 
 static void vk_gpu_finish(const struct pl_gpu *gpu)
@@ -2935,12 +4482,53 @@ static void vk_gpu_finish(const struct pl_gpu *gpu)
 
 struct vk_cmd *pl_vk_steal_cmd(const struct pl_gpu *gpu)
 {
-    struct pl_vk *p = TA_PRIV(gpu);
     struct vk_cmd *cmd = vk_require_cmd(gpu, GRAPHICS);
-    p->cmd = NULL;
+    vk_get_rec(gpu)->cmd = NULL;
     return cmd;
 }
 
+static bool vk_gpu_stats(const struct pl_gpu *gpu, struct pl_gpu_stats *out)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    pthread_mutex_lock(&vk->lock);
+    struct vk_rec **recs = p->recs;
+    int num_recs = p->num_recs;
+    struct vk_rec *rec = &p->rec;
+    if (!vk->thread_safe) {
+        recs = &rec;
+        num_recs = 1;
+    }
+
+    // The per-thread counters are updated without holding any lock, so the
+    // counts of other threads may lag behind slightly
+    *out = (struct pl_gpu_stats) {
+        .queue_submits = vk->num_submits,
+        .cmd_buffers = vk->num_cmds_submitted,
+        .passes_created = p->passes_created,
+        .pass_compile_ns = p->pass_compile_ns,
+    };
+
+    for (int i = 0; i < num_recs; i++) {
+        const struct pl_gpu_stats *s = &recs[i]->stats;
+        out->passes_destroyed += s->passes_destroyed;
+        out->pass_runs += s->pass_runs;
+        out->desc_updates += s->desc_updates;
+        out->var_updates += s->var_updates;
+        out->tex_uploads += s->tex_uploads;
+        out->tex_downloads += s->tex_downloads;
+        out->bytes_uploaded += s->bytes_uploaded;
+        out->bytes_downloaded += s->bytes_downloaded;
+        out->staging_allocs += s->staging_allocs;
+        out->staging_blocks += s->staging_blocks;
+        out->barriers += s->barriers;
+    }
+
+    pthread_mutex_unlock(&vk->lock);
+    return true;
+}
+
 static const struct pl_gpu_fns pl_fns_vk = {
     .destroy                = vk_destroy_gpu,
     .tex_create             = vk_tex_create,
@@ -2958,11 +4546,18 @@ static const struct pl_gpu_fns pl_fns_vk = {
     .buf_poll               = vk_buf_poll,
     .desc_namespace         = vk_desc_namespace,
     .pass_create            = vk_pass_create,
-    .pass_destroy           = vk_pass_destroy_lazy,
+    .pass_destroy           = vk_pass_release,
     .pass_run               = vk_pass_run,
+    .timer_create           = vk_timer_create,
+    .timer_destroy          = vk_timer_destroy_lazy,
+    .timer_query            = vk_timer_query,
     .sync_create            = vk_sync_create,
     .sync_destroy           = vk_sync_deref,
     .tex_export             = vk_tex_export,
+    .gpu_batch              = vk_gpu_batch,
     .gpu_flush              = vk_gpu_flush,
     .gpu_finish             = vk_gpu_finish,
+    .gpu_trim               = vk_gpu_trim,
+    .gpu_memory_stats       = vk_gpu_memory_stats,
+    .gpu_stats              = vk_gpu_stats,
 };
@@ -41,19 +41,42 @@
 // device. (Default: 512 MB)
 #define PLVK_HEAP_MAXIMUM_SLAB_SIZE (1 << 29)
 
-// Controls the minimum free region size, to reduce thrashing the free space
-// map with lots of small buffers during uninit. (Default: 1 KB)
-#define PLVK_HEAP_MINIMUM_REGION_SIZE (1 << 10)
-
-// Represents a region of available memory
-struct vk_region {
-    size_t start; // first offset in region
-    size_t end;   // first offset *not* in region
+// Allocations at least this large are always given their own device memory
+// instead of being sub-allocated, since rounding them up to a slab would
+// waste lots of memory. Smaller images may also get a dedicated allocation,
+// if the driver prefers it (VK_KHR_dedicated_allocation). (Default: 64 MB)
+#define PLVK_HEAP_DEDICATED_SIZE (1 << 26)
+
+// Controls how long empty slabs are kept around before being released back to
+// the device, to avoid thrashing memory allocations when usage fluctuates.
+// (Default: 5 seconds)
+#define PLVK_HEAP_IDLE_TIMEOUT_NS 5000000000LLU
+
+// The free space of each slab is organized into segregated free lists, one per
+// size class. Size classes are split into power-of-two ranges (first level),
+// each of which is further subdivided linearly into 2^PLVK_SL_BITS classes
+// (second level). Together with a bitmap of non-empty classes, this allows
+// finding a fitting free block in constant time.
+#define PLVK_SL_BITS  2
+#define PLVK_SL_COUNT (1 << PLVK_SL_BITS)
+#define PLVK_FL_COUNT 64
+
+// Represents a block of memory inside a slab. The blocks of a slab are either
+// free or in use, and together cover the whole slab. Adjacent free blocks are
+// always coalesced.
+struct vk_block {
+    struct vk_slab *slab;
+    size_t start;                 // first offset in block
+    size_t end;                   // first offset *not* in block
+    struct vk_block *prev, *next; // neighbouring blocks, by offset
+    struct vk_block *free_prev;   // free list of this block's size class
+    struct vk_block *free_next;   // (also links the slab's spare blocks)
+    bool free;
 };
 
-static inline size_t region_len(struct vk_region r)
+static inline size_t block_len(const struct vk_block *b)
 {
-    return r.end - r.start;
+    return b->end - b->start;
 }
 
 // A single slab represents a contiguous region of allocated memory. Actual
@@ -63,11 +86,15 @@ struct vk_slab {
     VkDeviceMemory mem;   // underlying device allocation
     size_t size;          // total size of `slab`
     size_t used;          // number of bytes actually in use (for GC accounting)
+    uint64_t idle_since;  // time at which `used` last dropped to 0
+    int heap_index;       // VkMemoryHeap index (for accounting), or -1
     bool dedicated;       // slab is allocated specifically for one object
     bool imported;        // slab represents an imported memory allocation
-    // free space map: a sorted list of memory regions that are available
-    struct vk_region *regions;
-    int num_regions;
+    // free space map, see `PLVK_SL_BITS`
+    struct vk_block *free_lists[PLVK_FL_COUNT][PLVK_SL_COUNT];
+    uint64_t fl_mask;                // first level classes with free blocks
+    uint8_t sl_mask[PLVK_FL_COUNT];  // second level classes with free blocks
+    struct vk_block *spare;          // unused block structs, for recycling
     // optional, depends on the memory type:
     VkBuffer buffer;        // buffer spanning the entire slab
     void *data;             // mapped memory corresponding to `mem`
@@ -82,7 +109,8 @@ struct vk_slab {
 // occur, and others will generally be the same for the same objects.
 //
 // Note: `vk_heap` addresses are not immutable, so we musn't expose any dangling
-// references to a `vk_heap` from e.g. `vk_memslice.priv = vk_slab`.
+// references to a `vk_heap` from e.g. `vk_memslice.priv = vk_block` (which
+// only refers to its `vk_slab`).
 struct vk_heap {
     VkBufferUsageFlags usage;    // the buffer usage type (or 0)
     VkMemoryPropertyFlags flags; // the memory type flags (or 0)
@@ -92,24 +120,48 @@ struct vk_heap {
     int num_slabs;
 };
 
+// Usage statistics, per VkMemoryHeap
+struct vk_heap_stats {
+    size_t reserved;  // total size of all slabs
+    size_t used;      // total size of all slices
+    size_t dedicated; // total size of all dedicated slabs
+    int num_slabs;
+    int num_dedicated;
+};
+
 // The overall state of the allocator, which keeps track of a vk_heap for each
 // memory type.
 struct vk_malloc {
     struct vk_ctx *vk;
+    pthread_mutex_t lock; // guards everything below
     VkPhysicalDeviceMemoryProperties props;
+    struct vk_heap_stats stats[VK_MAX_MEMORY_HEAPS];
+    bool has_budget; // VK_EXT_memory_budget is enabled
+    bool has_dedicated; // VK_KHR_dedicated_allocation is enabled
+
     struct vk_heap *heaps;
     int num_heaps;
 };
 
-static void slab_free(struct vk_ctx *vk, struct vk_slab *slab)
+static void slab_free(struct vk_malloc *ma, struct vk_slab *slab)
 {
+    struct vk_ctx *vk = ma->vk;
     if (!slab)
         return;
 
     pl_assert(slab->used == 0);
-    if (!slab->imported) {
-        vkDestroyBuffer(vk->dev, slab->buffer, VK_ALLOC);
+    if (slab->heap_index >= 0) {
+        struct vk_heap_stats *stats = &ma->stats[slab->heap_index];
+        stats->reserved -= slab->size;
+        stats->num_slabs--;
+        if (slab->dedicated) {
+            stats->dedicated -= slab->size;
+            stats->num_dedicated--;
+        }
+    }
 
+    vkDestroyBuffer(vk->dev, slab->buffer, VK_ALLOC);
+    if (!slab->imported) {
         switch (slab->handle_type) {
         case PL_HANDLE_FD:
         case PL_HANDLE_DMA_BUF:
@@ -127,9 +179,14 @@ static void slab_free(struct vk_ctx *vk, struct vk_slab *slab)
         case PL_HANDLE_WIN32_KMT:
             // PL_HANDLE_WIN32_KMT is just an identifier. It doesn't get closed.
             break;
+        case PL_HANDLE_HOST_PTR:
+            abort(); // import only
         }
 
         PL_INFO(vk, "Freed slab of size %zu", (size_t) slab->size);
+    } else if (slab->handle_type == PL_HANDLE_HOST_PTR) {
+        PL_DEBUG(vk, "Unimporting slab of size %zu from ptr: %p",
+                 (size_t) slab->size, slab->handle.ptr);
     } else {
         PL_DEBUG(vk, "Unimporting slab of size %zu from fd: %d",
                  (size_t) slab->size, slab->handle.fd);
@@ -141,28 +198,89 @@ static void slab_free(struct vk_ctx *vk, struct vk_slab *slab)
     talloc_free(slab);
 }
 
+// Queries the driver's current memory budget and usage for each heap.
+// Returns false if unsupported.
+static bool query_budget(struct vk_malloc *ma, VkDeviceSize budget[],
+                         VkDeviceSize usage[])
+{
+#ifdef VK_EXT_memory_budget
+    struct vk_ctx *vk = ma->vk;
+    if (!ma->has_budget)
+        return false;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT bprops = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+
+    VkPhysicalDeviceMemoryProperties2KHR props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR,
+        .pNext = &bprops,
+    };
+
+    vk->vkGetPhysicalDeviceMemoryProperties2KHR(vk->physd, &props);
+    for (int i = 0; i < ma->props.memoryHeapCount; i++) {
+        budget[i] = bprops.heapBudget[i];
+        usage[i] = bprops.heapUsage[i];
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 static bool find_best_memtype(struct vk_malloc *ma, uint32_t typeBits,
-                              VkMemoryPropertyFlags flags,
+                              VkMemoryPropertyFlags flags, size_t size,
                               VkMemoryType *out_type, int *out_index)
 {
     struct vk_ctx *vk = ma->vk;
+    VkDeviceSize budget[VK_MAX_MEMORY_HEAPS], usage[VK_MAX_MEMORY_HEAPS];
+    bool check_budget = query_budget(ma, budget, usage);
 
     // The vulkan spec requires memory types to be sorted in the "optimal"
     // order, so the first matching type we find will be the best/fastest one.
+    // If the driver reports a memory budget, prefer types whose heap can
+    // still accommodate the allocation, and only fall back to exceeding the
+    // budget if there is no other choice.
+    for (int pass = check_budget ? 0 : 1; pass < 2; pass++) {
+        for (int i = 0; i < ma->props.memoryTypeCount; i++) {
+            // The memory type flags must include our properties
+            if ((ma->props.memoryTypes[i].propertyFlags & flags) != flags)
+                continue;
+            // The memory type must be supported by the requirements (bitfield)
+            if (typeBits && !(typeBits & (1 << i)))
+                continue;
+            int heap = ma->props.memoryTypes[i].heapIndex;
+            if (pass == 0 && usage[heap] + size > budget[heap])
+                continue;
+            if (pass == 1 && check_budget) {
+                PL_WARN(vk, "Allocation of size %zu exceeds the memory budget "
+                        "of heap %d!", size, heap);
+            }
+            *out_type = ma->props.memoryTypes[i];
+            *out_index = i;
+            return true;
+        }
+    }
+
+    PL_ERR(vk, "Found no memory type matching property flags 0x%x and type "
+           "bits 0x%x!", (unsigned)flags, (unsigned)typeBits);
+    return false;
+}
+
+bool vk_malloc_has_memtype(struct vk_malloc *ma, uint32_t typeBits,
+                           VkMemoryPropertyFlags flags,
+                           VkDeviceSize min_heap_size)
+{
     for (int i = 0; i < ma->props.memoryTypeCount; i++) {
-        // The memory type flags must include our properties
-        if ((ma->props.memoryTypes[i].propertyFlags & flags) != flags)
+        VkMemoryType type = ma->props.memoryTypes[i];
+        if ((type.propertyFlags & flags) != flags)
             continue;
-        // The memory type must be supported by the requirements (bitfield)
         if (typeBits && !(typeBits & (1 << i)))
             continue;
-        *out_type = ma->props.memoryTypes[i];
-        *out_index = i;
-        return true;
+        if (ma->props.memoryHeaps[type.heapIndex].size > min_heap_size)
+            return true;
     }
 
-    PL_ERR(vk, "Found no memory type matching property flags 0x%x and type "
-           "bits 0x%x!", (unsigned)flags, (unsigned)typeBits);
     return false;
 }
 
@@ -175,6 +293,15 @@ static bool buf_external_check(struct vk_ctx *vk, VkBufferUsageFlags usage,
     if (!vk->vkGetPhysicalDeviceExternalBufferPropertiesKHR)
         return false;
 
+    if (handle_type == PL_HANDLE_HOST_PTR) {
+#ifdef VK_EXT_external_memory_host
+        if (!import || !vk->vkGetMemoryHostPointerPropertiesEXT)
+            return false;
+#else
+        return false;
+#endif
+    }
+
     VkPhysicalDeviceExternalBufferInfoKHR info = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_BUFFER_INFO_KHR,
         .usage = usage,
@@ -190,20 +317,227 @@ static bool buf_external_check(struct vk_ctx *vk, VkBufferUsageFlags usage,
                                  import);
 }
 
+static inline int ilog2(size_t x)
+{
+    return (int) (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(x);
+}
+
+// Maps a block length to its size class
+static void size_class(size_t len, int *fl, int *sl)
+{
+    pl_assert(len);
+    *fl = ilog2(len);
+    *sl = *fl < PLVK_SL_BITS ? 0 : (len >> (*fl - PLVK_SL_BITS)) & (PLVK_SL_COUNT - 1);
+}
+
+static struct vk_block *block_new(struct vk_slab *slab, size_t start, size_t end)
+{
+    struct vk_block *b = slab->spare;
+    if (b) {
+        slab->spare = b->free_next;
+    } else {
+        b = talloc_ptrtype(slab, b);
+    }
+
+    *b = (struct vk_block) {
+        .slab = slab,
+        .start = start,
+        .end = end,
+    };
+    return b;
+}
+
+static void block_recycle(struct vk_slab *slab, struct vk_block *b)
+{
+    b->free_next = slab->spare;
+    slab->spare = b;
+}
+
+static void block_insert_free(struct vk_slab *slab, struct vk_block *b)
+{
+    int fl, sl;
+    size_class(block_len(b), &fl, &sl);
+
+    b->free = true;
+    b->free_prev = NULL;
+    b->free_next = slab->free_lists[fl][sl];
+    if (b->free_next)
+        b->free_next->free_prev = b;
+    slab->free_lists[fl][sl] = b;
+    slab->fl_mask |= 1ULL << fl;
+    slab->sl_mask[fl] |= 1 << sl;
+}
+
+static void block_remove_free(struct vk_slab *slab, struct vk_block *b)
+{
+    int fl, sl;
+    size_class(block_len(b), &fl, &sl);
+
+    pl_assert(b->free);
+    b->free = false;
+    if (b->free_next)
+        b->free_next->free_prev = b->free_prev;
+    if (b->free_prev) {
+        b->free_prev->free_next = b->free_next;
+    } else {
+        slab->free_lists[fl][sl] = b->free_next;
+        if (!b->free_next) {
+            slab->sl_mask[fl] &= ~(1 << sl);
+            if (!slab->sl_mask[fl])
+                slab->fl_mask &= ~(1ULL << fl);
+        }
+    }
+}
+
+static inline bool block_fits(const struct vk_block *b, size_t size, size_t align)
+{
+    return PL_ALIGN(b->start, align) + size <= b->end;
+}
+
+// Finds a free block that can hold `size` bytes at the given alignment, or
+// NULL if there is none. This only looks at the heads of the free lists, and
+// therefore runs in constant time.
+static struct vk_block *slab_find_free(struct vk_slab *slab, size_t size,
+                                       size_t align)
+{
+    int fl, sl;
+
+    // Try the head of the exact size class first, since it may well fit
+    // despite not being guaranteed to
+    size_class(size, &fl, &sl);
+    struct vk_block *b = slab->free_lists[fl][sl];
+    if (b && block_fits(b, size, align))
+        return b;
+
+    // Otherwise, round the request (including the worst case alignment
+    // padding) up to the next size class, so that every block in the classes
+    // at or above it is guaranteed to fit
+    size_t need = size + align - 1;
+    int f = ilog2(need);
+    if (f < PLVK_SL_BITS) {
+        fl = f + 1;
+        sl = 0;
+    } else {
+        need += ((size_t) 1 << (f - PLVK_SL_BITS)) - 1;
+        size_class(need, &fl, &sl);
+    }
+
+    if (fl >= PLVK_FL_COUNT)
+        return NULL;
+
+    unsigned sl_map = slab->sl_mask[fl] & (~0U << sl);
+    if (!sl_map) {
+        uint64_t fl_map = fl + 1 < PLVK_FL_COUNT ? slab->fl_mask & (~0ULL << (fl + 1)) : 0;
+        if (!fl_map)
+            return NULL;
+        fl = __builtin_ctzll(fl_map);
+        sl_map = slab->sl_mask[fl];
+    }
+
+    b = slab->free_lists[fl][__builtin_ctz(sl_map)];
+    pl_assert(b && block_fits(b, size, align));
+    return b;
+}
+
+// Returns the size of the largest free block in the slab, or 0 if full. Only
+// the highest non-empty size class needs to be scanned.
+static size_t slab_largest_free(const struct vk_slab *slab)
+{
+    if (!slab->fl_mask)
+        return 0;
+
+    int fl = 63 - __builtin_clzll(slab->fl_mask);
+    int sl = ilog2(slab->sl_mask[fl]);
+    size_t largest = 0;
+    for (struct vk_block *b = slab->free_lists[fl][sl]; b; b = b->free_next)
+        largest = PL_MAX(largest, block_len(b));
+    return largest;
+}
+
+// Returns the single free block of a newly allocated slab
+static struct vk_block *slab_first_block(struct vk_slab *slab)
+{
+    int fl, sl;
+    size_class(slab->size, &fl, &sl);
+    pl_assert(slab->free_lists[fl][sl]);
+    return slab->free_lists[fl][sl];
+}
+
+// Marks the free block `b` as used for `[offset, offset + size)`, splitting off
+// the alignment padding and the unused tail as new free blocks. Since free
+// blocks are always coalesced, their other neighbours must be in use, so these
+// never need to be merged.
+static void block_take(struct vk_slab *slab, struct vk_block *b,
+                       size_t offset, size_t size)
+{
+    pl_assert(offset >= b->start && offset + size <= b->end);
+    block_remove_free(slab, b);
+
+    if (offset > b->start) {
+        struct vk_block *pad = block_new(slab, b->start, offset);
+        pad->prev = b->prev;
+        pad->next = b;
+        if (pad->prev)
+            pad->prev->next = pad;
+        b->prev = pad;
+        b->start = offset;
+        block_insert_free(slab, pad);
+    }
+
+    if (offset + size < b->end) {
+        struct vk_block *tail = block_new(slab, offset + size, b->end);
+        tail->prev = b;
+        tail->next = b->next;
+        if (tail->next)
+            tail->next->prev = tail;
+        b->next = tail;
+        b->end = offset + size;
+        block_insert_free(slab, tail);
+    }
+}
+
+// Returns a used block to the free space map, coalescing it with its
+// neighbours where possible
+static void block_release(struct vk_slab *slab, struct vk_block *b)
+{
+    pl_assert(!b->free);
+    struct vk_block *prev = b->prev, *next = b->next;
+    if (prev && prev->free) {
+        block_remove_free(slab, prev);
+        b->start = prev->start;
+        b->prev = prev->prev;
+        if (b->prev)
+            b->prev->next = b;
+        block_recycle(slab, prev);
+    }
+
+    if (next && next->free) {
+        block_remove_free(slab, next);
+        b->end = next->end;
+        b->next = next->next;
+        if (b->next)
+            b->next->prev = b;
+        block_recycle(slab, next);
+    }
+
+    block_insert_free(slab, b);
+}
+
+// If `dedicated` is true, the slab is allocated for a single object, which
+// may be `image` (if set) or otherwise the slab's own buffer.
 static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
-                                  size_t size)
+                                  size_t size, bool dedicated, VkImage image)
 {
     struct vk_ctx *vk = ma->vk;
     struct vk_slab *slab = talloc_ptrtype(NULL, slab);
     *slab = (struct vk_slab) {
         .size = size,
+        .heap_index = -1,
+        .dedicated = dedicated,
         .handle_type = heap->handle_type,
     };
 
-    TARRAY_APPEND(slab, slab->regions, slab->num_regions, (struct vk_region) {
-        .start = 0,
-        .end   = slab->size,
-    });
+    block_insert_free(slab, block_new(slab, 0, slab->size));
 
     switch (slab->handle_type) {
     case PL_HANDLE_FD:
@@ -214,6 +548,8 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
     case PL_HANDLE_WIN32_KMT:
         slab->handle.handle = NULL;
         break;
+    case PL_HANDLE_HOST_PTR:
+        abort(); // import only
     }
 
     VkExportMemoryAllocateInfoKHR ext_info = {
@@ -267,9 +603,21 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
         typeBits &= reqs.memoryTypeBits;  // this can restrict the types
     }
 
+    VkMemoryDedicatedAllocateInfoKHR ded_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR,
+        .image = image,
+        .buffer = image ? VK_NULL_HANDLE : slab->buffer,
+    };
+
+    if (dedicated && ma->has_dedicated && (ded_info.image || ded_info.buffer)) {
+        ded_info.pNext = minfo.pNext;
+        minfo.pNext = &ded_info;
+    }
+
     VkMemoryType type;
     int index;
-    if (!find_best_memtype(ma, typeBits, heap->flags, &type, &index))
+    if (!find_best_memtype(ma, typeBits, heap->flags, minfo.allocationSize,
+                           &type, &index))
         goto error;
 
     PL_INFO(vk, "Allocating %zu memory of type 0x%x (id %d) in heap %d",
@@ -278,6 +626,14 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
 
     minfo.memoryTypeIndex = index;
     VK(vkAllocateMemory(vk->dev, &minfo, VK_ALLOC, &slab->mem));
+    slab->heap_index = type.heapIndex;
+    struct vk_heap_stats *stats = &ma->stats[slab->heap_index];
+    stats->reserved += slab->size;
+    stats->num_slabs++;
+    if (slab->dedicated) {
+        stats->dedicated += slab->size;
+        stats->num_dedicated++;
+    }
 
     if (heap->flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
         VK(vkMapMemory(vk->dev, slab->mem, 0, VK_WHOLE_SIZE, 0, &slab->data));
@@ -319,66 +675,14 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
     return slab;
 
 error:
-    slab_free(vk, slab);
+    slab_free(ma, slab);
     return NULL;
 }
 
-static void insert_region(struct vk_slab *slab, struct vk_region region)
-{
-    if (region.start == region.end)
-        return;
-
-    bool big_enough = region_len(region) >= PLVK_HEAP_MINIMUM_REGION_SIZE;
-
-    // Find the index of the first region that comes after this
-    for (int i = 0; i < slab->num_regions; i++) {
-        struct vk_region *r = &slab->regions[i];
-
-        // Check for a few special cases which can be coalesced
-        if (r->end == region.start) {
-            // The new region is at the tail of this region. In addition to
-            // modifying this region, we also need to coalesce all the following
-            // regions for as long as possible
-            r->end = region.end;
-
-            struct vk_region *next = &slab->regions[i+1];
-            while (i+1 < slab->num_regions && r->end == next->start) {
-                r->end = next->end;
-                TARRAY_REMOVE_AT(slab->regions, slab->num_regions, i+1);
-            }
-            return;
-        }
-
-        if (r->start == region.end) {
-            // The new region is at the head of this region. We don't need to
-            // do anything special here - because if this could be further
-            // coalesced backwards, the previous loop iteration would already
-            // have caught it.
-            r->start = region.start;
-            return;
-        }
-
-        if (r->start > region.start) {
-            // The new region comes somewhere before this region, so insert
-            // it into this index in the array.
-            if (big_enough) {
-                TARRAY_INSERT_AT(slab, slab->regions, slab->num_regions,
-                                    i, region);
-            }
-            return;
-        }
-    }
-
-    // If we've reached the end of this loop, then all of the regions
-    // come before the new region, and are disconnected - so append it
-    if (big_enough)
-        TARRAY_APPEND(slab, slab->regions, slab->num_regions, region);
-}
-
-static void heap_uninit(struct vk_ctx *vk, struct vk_heap *heap)
+static void heap_uninit(struct vk_malloc *ma, struct vk_heap *heap)
 {
     for (int i = 0; i < heap->num_slabs; i++)
-        slab_free(vk, heap->slabs[i]);
+        slab_free(ma, heap->slabs[i]);
 
     talloc_free(heap->slabs);
     *heap = (struct vk_heap){0};
@@ -388,8 +692,19 @@ struct vk_malloc *vk_malloc_create(struct vk_ctx *vk)
 {
     struct vk_malloc *ma = talloc_zero(NULL, struct vk_malloc);
     vkGetPhysicalDeviceMemoryProperties(vk->physd, &ma->props);
+    pthread_mutex_init(&ma->lock, NULL);
     ma->vk = vk;
 
+    // Only loaded if VK_EXT_memory_budget is enabled
+    ma->has_budget = vk->vkGetPhysicalDeviceMemoryProperties2KHR;
+    if (ma->has_budget)
+        PL_INFO(vk, "Using driver-reported memory budget");
+
+    for (int i = 0; i < vk->num_exts; i++) {
+        if (strcmp(vk->exts[i], VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME) == 0)
+            ma->has_dedicated = vk->vkGetImageMemoryRequirements2KHR;
+    }
+
     PL_INFO(vk, "Memory heaps supported by device:");
     for (int i = 0; i < ma->props.memoryHeapCount; i++) {
         VkMemoryHeap heap = ma->props.memoryHeaps[i];
@@ -414,11 +729,50 @@ void vk_malloc_destroy(struct vk_malloc **ma_ptr)
         return;
 
     for (int i = 0; i < ma->num_heaps; i++)
-        heap_uninit(ma->vk, &ma->heaps[i]);
+        heap_uninit(ma, &ma->heaps[i]);
 
+    pthread_mutex_destroy(&ma->lock);
     TA_FREEP(ma_ptr);
 }
 
+void vk_malloc_stats(struct vk_malloc *ma, struct pl_gpu_memory_stats *out)
+{
+    VkDeviceSize budget[VK_MAX_MEMORY_HEAPS], usage[VK_MAX_MEMORY_HEAPS];
+    bool has_budget = query_budget(ma, budget, usage);
+
+    *out = (struct pl_gpu_memory_stats) {
+        .num_heaps = PL_MIN(ma->props.memoryHeapCount, PL_GPU_MAX_HEAPS),
+    };
+
+    pthread_mutex_lock(&ma->lock);
+    for (int i = 0; i < out->num_heaps; i++) {
+        VkMemoryHeap heap = ma->props.memoryHeaps[i];
+        out->heaps[i] = (struct pl_gpu_mem_heap) {
+            .device_local = heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT,
+            .size = heap.size,
+            .budget = has_budget ? budget[i] : 0,
+            .driver_usage = has_budget ? usage[i] : 0,
+            .reserved = ma->stats[i].reserved,
+            .used = ma->stats[i].used,
+            .num_slabs = ma->stats[i].num_slabs,
+            .dedicated = ma->stats[i].dedicated,
+            .num_dedicated = ma->stats[i].num_dedicated,
+        };
+    }
+
+    for (int i = 0; i < ma->num_heaps; i++) {
+        const struct vk_heap *heap = &ma->heaps[i];
+        for (int n = 0; n < heap->num_slabs; n++) {
+            const struct vk_slab *slab = heap->slabs[n];
+            if (slab->heap_index < 0 || slab->heap_index >= out->num_heaps)
+                continue;
+            size_t *largest = &out->heaps[slab->heap_index].largest_free;
+            *largest = PL_MAX(*largest, slab_largest_free(slab));
+        }
+    }
+    pthread_mutex_unlock(&ma->lock);
+}
+
 pl_handle_caps vk_malloc_handle_caps(struct vk_malloc *ma, bool import)
 {
     struct vk_ctx *vk = ma->vk;
@@ -440,12 +794,16 @@ pl_handle_caps vk_malloc_handle_caps(struct vk_malloc *ma, bool import)
 void vk_free_memslice(struct vk_malloc *ma, struct vk_memslice slice)
 {
     struct vk_ctx *vk = ma->vk;
-    struct vk_slab *slab = slice.priv;
-    if (!slab)
+    struct vk_block *block = slice.priv;
+    if (!block)
         return;
 
+    pthread_mutex_lock(&ma->lock);
+    struct vk_slab *slab = block->slab;
     pl_assert(slab->used >= slice.size);
     slab->used -= slice.size;
+    if (slab->heap_index >= 0)
+        ma->stats[slab->heap_index].used -= slice.size;
 
     PL_DEBUG(vk, "Freeing slice %zu + %zu from slab with size %zu",
              (size_t) slice.offset, (size_t) slice.size, (size_t) slab->size);
@@ -453,16 +811,44 @@ void vk_free_memslice(struct vk_malloc *ma, struct vk_memslice slice)
     if (slab->dedicated) {
         // If the slab was purpose-allocated for this memslice, we can just
         // free it here
-        slab_free(vk, slab);
+        slab_free(ma, slab);
     } else {
         // Return the allocation to the free space map
-        insert_region(slab, (struct vk_region) {
-            .start = slice.offset,
-            .end   = slice.offset + slice.size,
-        });
+        block_release(slab, block);
+        if (!slab->used)
+            slab->idle_since = pl_clock_ns();
+    }
+
+    pthread_mutex_unlock(&ma->lock);
+}
+
+static void garbage_collect(struct vk_malloc *ma, bool all)
+{
+    struct vk_ctx *vk = ma->vk;
+    uint64_t now = pl_clock_ns();
+
+    for (int i = 0; i < ma->num_heaps; i++) {
+        struct vk_heap *heap = &ma->heaps[i];
+        for (int n = heap->num_slabs - 1; n >= 0; n--) {
+            struct vk_slab *slab = heap->slabs[n];
+            if (slab->used)
+                continue;
+            if (!all && now - slab->idle_since < PLVK_HEAP_IDLE_TIMEOUT_NS)
+                continue;
+
+            slab_free(ma, slab);
+            TARRAY_REMOVE_AT(heap->slabs, heap->num_slabs, n);
+        }
     }
 }
 
+void vk_malloc_garbage_collect(struct vk_malloc *ma, bool all)
+{
+    pthread_mutex_lock(&ma->lock);
+    garbage_collect(ma, all);
+    pthread_mutex_unlock(&ma->lock);
+}
+
 // reqs: can be NULL
 static struct vk_heap *find_heap(struct vk_malloc *ma, VkBufferUsageFlags usage,
                                  VkMemoryPropertyFlags flags,
@@ -496,27 +882,21 @@ static struct vk_heap *find_heap(struct vk_malloc *ma, VkBufferUsageFlags usage,
     return heap;
 }
 
-static inline bool region_fits(struct vk_region r, size_t size, size_t align)
-{
-    return PL_ALIGN(r.start, align) + size <= r.end;
-}
-
-// Finds the best-fitting region in a heap. If the heap is too small or too
+// Finds a fitting free block in a heap. If the heap is too small or too
 // fragmented, a new slab will be allocated under the hood.
-static bool heap_get_region(struct vk_malloc *ma, struct vk_heap *heap,
-                            size_t size, size_t align,
-                            struct vk_slab **out_slab, int *out_index)
+static struct vk_block *heap_get_block(struct vk_malloc *ma, struct vk_heap *heap,
+                                       size_t size, size_t align,
+                                       bool dedicated, VkImage image)
 {
     struct vk_slab *slab = NULL;
 
     // If the allocation is very big, serve it directly instead of bothering
     // with the heap
-    if (size > PLVK_HEAP_MAXIMUM_SLAB_SIZE) {
-        slab = slab_alloc(ma, heap, size);
-        slab->dedicated = true;
-        *out_slab = slab;
-        *out_index = 0;
-        return !!slab;
+    if (dedicated || size >= PLVK_HEAP_DEDICATED_SIZE) {
+        slab = slab_alloc(ma, heap, size, true, image);
+        if (!slab)
+            return NULL;
+        return slab_first_block(slab);
     }
 
     for (int i = 0; i < heap->num_slabs; i++) {
@@ -524,60 +904,49 @@ static bool heap_get_region(struct vk_malloc *ma, struct vk_heap *heap,
         if (slab->size < size)
             continue;
 
-        // Attempt a best fit search
-        int best = -1;
-        for (int n = 0; n < slab->num_regions; n++) {
-            struct vk_region r = slab->regions[n];
-            if (!region_fits(r, size, align))
-                continue;
-            if (best >= 0 && region_len(r) > region_len(slab->regions[best]))
-                continue;
-            best = n;
-        }
-
-        if (best >= 0) {
-            *out_slab = slab;
-            *out_index = best;
-            return true;
-        }
+        struct vk_block *b = slab_find_free(slab, size, align);
+        if (b)
+            return b;
     }
 
-    // Otherwise, allocate a new vk_slab and append it to the list.
+    // Otherwise, allocate a new vk_slab and append it to the list. Before
+    // doing so, release expired idle slabs, which evidently didn't fit
+    garbage_collect(ma, false);
+    slab = heap->num_slabs ? heap->slabs[heap->num_slabs - 1] : NULL;
     size_t cur_size = PL_MAX(size, slab ? slab->size : 0);
     size_t slab_size = PLVK_HEAP_SLAB_GROWTH_RATE * cur_size;
     slab_size = PL_MAX(PLVK_HEAP_MINIMUM_SLAB_SIZE, slab_size);
     slab_size = PL_MIN(PLVK_HEAP_MAXIMUM_SLAB_SIZE, slab_size);
     pl_assert(slab_size >= size);
-    slab = slab_alloc(ma, heap, slab_size);
+    slab = slab_alloc(ma, heap, slab_size, false, VK_NULL_HANDLE);
     if (!slab)
-        return false;
+        return NULL;
     TARRAY_APPEND(NULL, heap->slabs, heap->num_slabs, slab);
 
-    // Return the only region there is in a newly allocated slab
-    pl_assert(slab->num_regions == 1);
-    *out_slab = slab;
-    *out_index = 0;
-    return true;
+    // Return the only block there is in a newly allocated slab
+    return slab_first_block(slab);
 }
 
 static bool slice_heap(struct vk_malloc *ma, struct vk_heap *heap, size_t size,
-                       size_t alignment, struct vk_memslice *out)
+                       size_t alignment, bool dedicated, VkImage image,
+                       struct vk_memslice *out)
 {
     struct vk_ctx *vk = ma->vk;
-    struct vk_slab *slab;
-    int index;
     alignment = pl_lcm(alignment, vk->limits.bufferImageGranularity);
-    if (!heap_get_region(ma, heap, size, alignment, &slab, &index))
+    struct vk_block *b = heap_get_block(ma, heap, size, alignment, dedicated,
+                                        image);
+    if (!b)
         return false;
 
-    struct vk_region reg = slab->regions[index];
-    TARRAY_REMOVE_AT(slab->regions, slab->num_regions, index);
-    VkDeviceSize offset = PL_ALIGN(reg.start, alignment);
+    struct vk_slab *slab = b->slab;
+    VkDeviceSize offset = PL_ALIGN(b->start, alignment);
+    block_take(slab, b, offset, size);
+
     *out = (struct vk_memslice) {
         .vkmem = slab->mem,
         .offset = offset,
         .size = size,
-        .priv = slab,
+        .priv = b,
         .shared_mem = {
             .handle = slab->handle,
             .offset = offset,
@@ -593,21 +962,45 @@ static bool slice_heap(struct vk_malloc *ma, struct vk_heap *heap, size_t size,
     PL_DEBUG(vk, "Sub-allocating slice %zu + %zu from slab with size %zu",
              (size_t) out->offset, (size_t) out->size, (size_t) slab->size);
 
-    size_t out_end = out->offset + out->size;
-    insert_region(slab, (struct vk_region) { reg.start, out->offset });
-    insert_region(slab, (struct vk_region) { out_end, reg.end });
-
     slab->used += size;
+    ma->stats[slab->heap_index].used += size;
     return true;
 }
 
 bool vk_malloc_generic(struct vk_malloc *ma, VkMemoryRequirements reqs,
                        VkMemoryPropertyFlags flags,
-                       enum pl_handle_type handle_type,
+                       enum pl_handle_type handle_type, VkImage image,
                        struct vk_memslice *out)
 {
+    struct vk_ctx *vk = ma->vk;
+    bool dedicated = false;
+
+    if (image && ma->has_dedicated) {
+        VkMemoryDedicatedRequirementsKHR ded_reqs = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR,
+        };
+
+        VkMemoryRequirements2KHR reqs2 = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR,
+            .pNext = &ded_reqs,
+        };
+
+        VkImageMemoryRequirementsInfo2KHR info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR,
+            .image = image,
+        };
+
+        vk->vkGetImageMemoryRequirements2KHR(vk->dev, &info, &reqs2);
+        reqs = reqs2.memoryRequirements;
+        dedicated = ded_reqs.prefersDedicatedAllocation ||
+                    ded_reqs.requiresDedicatedAllocation;
+    }
+
+    pthread_mutex_lock(&ma->lock);
     struct vk_heap *heap = find_heap(ma, 0, flags, handle_type, &reqs);
-    return slice_heap(ma, heap, reqs.size, reqs.alignment, out);
+    bool ok = slice_heap(ma, heap, reqs.size, reqs.alignment, dedicated, image, out);
+    pthread_mutex_unlock(&ma->lock);
+    return ok;
 }
 
 bool vk_malloc_buffer(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
@@ -615,18 +1008,22 @@ bool vk_malloc_buffer(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
                       VkDeviceSize alignment, enum pl_handle_type handle_type,
                       struct vk_bufslice *out)
 {
+    pthread_mutex_lock(&ma->lock);
     struct vk_heap *heap = find_heap(ma, bufFlags, memFlags, handle_type, NULL);
-    if (!slice_heap(ma, heap, size, alignment, &out->mem))
+    bool ok = slice_heap(ma, heap, size, alignment, false, VK_NULL_HANDLE, &out->mem);
+    pthread_mutex_unlock(&ma->lock);
+    if (!ok)
         return false;
 
-    struct vk_slab *slab = out->mem.priv;
-    out->buf = slab->buffer;
+    struct vk_block *b = out->mem.priv;
+    out->buf = b->slab->buffer;
 
     return true;
 }
 
 bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
                       const struct pl_shared_mem *shared_mem,
+                      VkMemoryRequirements reqs, VkImage image,
                       struct vk_memslice *out)
 {
     struct vk_ctx *vk = ma->vk;
@@ -660,7 +1057,7 @@ bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
 
     // We pick the first compatible memory type because we have no other basis
     // for choosing if there is more than one available.
-    int first_mem_type = ffs(fdprops.memoryTypeBits);
+    int first_mem_type = ffs(fdprops.memoryTypeBits & reqs.memoryTypeBits);
     if (!first_mem_type) {
        PL_ERR(vk, "No compatible memory types offered for imported memory");
        return false;
@@ -675,9 +1072,16 @@ bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
         return false;
     }
 
+    // Images with explicit DRM format modifiers generally need to be bound
+    // to a dedicated allocation
+    VkMemoryDedicatedAllocateInfoKHR ded_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR,
+        .image = image,
+    };
+
     const VkImportMemoryFdInfoKHR iinfo = {
         .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
-        .pNext = NULL,
+        .pNext = (image && ma->has_dedicated) ? &ded_info : NULL,
         .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
         .fd = fd,
     };
@@ -695,6 +1099,7 @@ bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
     struct vk_slab *slab = talloc_ptrtype(NULL, slab);
     *slab = (struct vk_slab) {
         .mem = vkmem,
+        .heap_index = -1,
         .dedicated = true,
         .imported = true,
         .size = shared_mem->size,
@@ -707,9 +1112,9 @@ bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
     *out = (struct vk_memslice) {
         .vkmem = vkmem,
         .size = shared_mem->size,
-        .offset = shared_mem->offset,
+        .offset = image ? 0 : shared_mem->offset,
         .shared_mem = *shared_mem,
-        .priv = slab,
+        .priv = block_new(slab, 0, shared_mem->size),
     };
 
     PL_DEBUG(vk, "Importing %zu of memory from fd: %d",
@@ -724,3 +1129,144 @@ error:
 
 #endif // VK_HAVE_UNIX
 }
+
+bool vk_malloc_import_buffer(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
+                             enum pl_handle_type handle_type,
+                             const struct pl_shared_mem *shared_mem,
+                             struct vk_bufslice *out)
+{
+    struct vk_ctx *vk = ma->vk;
+
+#ifndef VK_EXT_external_memory_host
+
+    PL_ERR(vk, "Importing buffer memory requires %s.",
+           "VK_EXT_external_memory_host");
+    return false;
+
+#else
+
+    if (handle_type != PL_HANDLE_HOST_PTR) {
+        PL_ERR(vk, "Importing buffer memory is only supported for PL_HANDLE_HOST_PTR.");
+        return false;
+    } else if (!vk->vkGetMemoryHostPointerPropertiesEXT) {
+        PL_ERR(vk, "Importing buffer memory requires %s.",
+               VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        return false;
+    }
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory vkmem = VK_NULL_HANDLE;
+    VkMemoryHostPointerPropertiesEXT hprops = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT,
+    };
+
+    VK(vk->vkGetMemoryHostPointerPropertiesEXT(vk->dev,
+                                               vk_mem_handle_type(handle_type),
+                                               shared_mem->handle.ptr,
+                                               &hprops));
+
+    uint32_t qfs[3] = {0};
+    for (int i = 0; i < vk->num_pools; i++)
+        qfs[i] = vk->pools[i]->qf;
+
+    VkExternalMemoryBufferCreateInfoKHR ext_info = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO_KHR,
+        .handleTypes = vk_mem_handle_type(handle_type),
+    };
+
+    VkBufferCreateInfo binfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = &ext_info,
+        .size  = shared_mem->size,
+        .usage = bufFlags,
+        .sharingMode = vk->num_pools > 1 ? VK_SHARING_MODE_CONCURRENT
+                                         : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = vk->num_pools,
+        .pQueueFamilyIndices = qfs,
+    };
+
+    if (!buf_external_check(vk, binfo.usage, handle_type, true)) {
+        PL_ERR(vk, "Failed importing host memory: the buffer usage is not "
+               "supported for this handle type!");
+        return false;
+    }
+
+    VK(vkCreateBuffer(vk->dev, &binfo, VK_ALLOC, &buffer));
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(vk->dev, buffer, &reqs);
+
+    uint32_t typeBits = reqs.memoryTypeBits & hprops.memoryTypeBits;
+    if (!typeBits) {
+        PL_ERR(vk, "No compatible memory types offered for imported memory");
+        goto error;
+    }
+
+    // Only consider coherent memory types, so that neither the user nor our
+    // own barriers need to bother with flushing the host pointer
+    VkMemoryType type;
+    int index;
+    if (!find_best_memtype(ma, typeBits,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           shared_mem->size, &type, &index))
+        goto error;
+
+    VkImportMemoryHostPointerInfoEXT iinfo = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+        .handleType = ext_info.handleTypes,
+        .pHostPointer = shared_mem->handle.ptr,
+    };
+
+    VkMemoryAllocateInfo ainfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &iinfo,
+        .allocationSize = shared_mem->size,
+        .memoryTypeIndex = index,
+    };
+
+    VK(vkAllocateMemory(vk->dev, &ainfo, VK_ALLOC, &vkmem));
+    VK(vkBindBufferMemory(vk->dev, buffer, vkmem, 0));
+
+    struct vk_slab *slab = talloc_ptrtype(NULL, slab);
+    *slab = (struct vk_slab) {
+        .mem = vkmem,
+        .heap_index = -1,
+        .dedicated = true,
+        .imported = true,
+        .size = shared_mem->size,
+        .used = shared_mem->size,
+        .buffer = buffer,
+        .data = shared_mem->handle.ptr,
+        .coherent = true,
+        .handle = {
+            .ptr = shared_mem->handle.ptr,
+        },
+        .handle_type = handle_type,
+    };
+
+    *out = (struct vk_bufslice) {
+        .buf = buffer,
+        .mem = {
+            .vkmem = vkmem,
+            .size = shared_mem->size,
+            .offset = shared_mem->offset,
+            .shared_mem = *shared_mem,
+            .data = (uint8_t *) shared_mem->handle.ptr + shared_mem->offset,
+            .coherent = true,
+            .priv = block_new(slab, 0, shared_mem->size),
+        },
+    };
+
+    PL_DEBUG(vk, "Importing %zu of memory from ptr: %p",
+             (size_t) slab->size, shared_mem->handle.ptr);
+
+    return true;
+
+error:
+    vkFreeMemory(vk->dev, vkmem, VK_ALLOC);
+    vkDestroyBuffer(vk->dev, buffer, VK_ALLOC);
+    return false;
+
+#endif // VK_EXT_external_memory_host
+}
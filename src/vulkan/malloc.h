@@ -20,10 +20,19 @@
 #include "common.h"
 
 // All memory allocated from a vk_malloc MUST be explicitly released by
-// the caller before vk_malloc_destroy is called.
+// the caller before vk_malloc_destroy is called. Apart from that, all of the
+// functions below may be called from any thread.
 struct vk_malloc *vk_malloc_create(struct vk_ctx *vk);
 void vk_malloc_destroy(struct vk_malloc **ma);
 
+// Release empty slabs back to the device. If `all` is false, only slabs which
+// have been idle for a grace period are released, so this is cheap enough to
+// call regularly.
+void vk_malloc_garbage_collect(struct vk_malloc *ma, bool all);
+
+// Fill in the per-heap usage statistics
+void vk_malloc_stats(struct vk_malloc *ma, struct pl_gpu_memory_stats *out);
+
 // Get the supported handle types for this malloc instance
 pl_handle_caps vk_malloc_handle_caps(struct vk_malloc *ma, bool import);
 
@@ -41,11 +50,20 @@ struct vk_memslice {
 };
 
 void vk_free_memslice(struct vk_malloc *ma, struct vk_memslice slice);
+// If `image` is set, the memory is intended to be bound to this image, which
+// is used to decide whether a dedicated allocation is preferred.
 bool vk_malloc_generic(struct vk_malloc *ma, VkMemoryRequirements reqs,
                        VkMemoryPropertyFlags flags,
-                       enum pl_handle_type handle_type,
+                       enum pl_handle_type handle_type, VkImage image,
                        struct vk_memslice *out);
 
+// Returns whether there is a memory type matching `typeBits` (or any type, if
+// 0) that includes all of the given property flags, and whose heap is larger
+// than `min_heap_size`.
+bool vk_malloc_has_memtype(struct vk_malloc *ma, uint32_t typeBits,
+                           VkMemoryPropertyFlags flags,
+                           VkDeviceSize min_heap_size);
+
 // Represents a single "slice" of a larger buffer
 struct vk_bufslice {
     struct vk_memslice mem; // must be freed by the user when done
@@ -64,6 +82,19 @@ bool vk_malloc_buffer(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
 // Import and track external memory. This can be called repeatedly for the
 // same external memory allocation and it will be imported again and tracked
 // separately each time. This is explicitly allowed by the Vulkan spec.
+//
+// The memory type is restricted to those allowed by `reqs`. If `image` is
+// set, the memory is imported as a dedicated allocation for this image, which
+// must then be bound at offset 0.
 bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
                       const struct pl_shared_mem *shared_mem,
+                      VkMemoryRequirements reqs, VkImage image,
                       struct vk_memslice *out);
+
+// Import external memory as a buffer, spanning the entire allocation. The
+// slice `out->mem` refers to the part starting at `shared_mem->offset`.
+// Currently only supports PL_HANDLE_HOST_PTR.
+bool vk_malloc_import_buffer(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
+                             enum pl_handle_type handle_type,
+                             const struct pl_shared_mem *shared_mem,
+                             struct vk_bufslice *out);
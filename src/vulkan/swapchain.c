@@ -32,8 +32,9 @@ struct priv {
     VkSwapchainKHR swapchain;
     VkSwapchainKHR old_swapchain;
     int cur_width, cur_height;
-    int swapchain_depth;
-    int frames_in_flight;   // number of frames currently queued
+    int swapchain_depth;    // maximum number of frames in flight
+    int cur_depth;          // current limit, may be lower if `low_latency`
+    int frames_in_flight;   // number of frames currently queued (`vk->lock`)
     bool suboptimal;        // true once VK_SUBOPTIMAL_KHR is returned
     struct pl_color_repr color_repr;
     struct pl_color_space color_space;
@@ -46,10 +47,32 @@ struct priv {
     int num_sems;           // size of `sems_in` / `sems_out`
     int idx_sems;           // index of next free semaphore pair
     int last_imgidx;        // the image index last acquired (for submit)
+
+    // low latency mode statistics (see `adapt_depth`):
+    uint64_t last_swap;     // time of the previous `swap_buffers` call
+    uint64_t wait_total;    // time spent waiting during the current window
+    uint64_t frame_total;   // total frame time during the current window
+    int window;             // number of frames in the current window
+    int window_size;        // number of frames after which to lower the depth
+
+    // presentation timing feedback (VK_GOOGLE_display_timing):
+    bool has_timing;
+    uint64_t present_id;    // id of the most recently presented frame
+    uint64_t last_id;       // id of the most recent frame with feedback
+    uint64_t last_time;     // `actualPresentTime` of `last_id`
+    struct pl_swapchain_timing timing;
+    struct pl_swapchain_frame_timing *timings;
+    int num_timings;
 };
 
 static struct pl_sw_fns vulkan_swapchain;
 
+// Number of frames rendering has to keep up for before the low latency mode
+// lowers the swapchain depth. This gets doubled (up to the maximum) every time
+// the depth needs to be raised again, to avoid oscillating between two depths
+#define LOW_LATENCY_WINDOW 60
+#define LOW_LATENCY_WINDOW_MAX 960
+
 static bool vk_map_color_space(VkColorSpaceKHR space, struct pl_color_space *out)
 {
     switch (space) {
@@ -151,7 +174,8 @@ static bool pick_surf_format(const struct pl_gpu *gpu, const struct vk_ctx *vk,
                              struct pl_color_space *space)
 {
     VkSurfaceFormatKHR *formats = NULL;
-    int num = 0;
+    int num = 0, best = -1;
+    bool best_storable = false;
 
     // Specific format requested by user
     if (out_format->format) {
@@ -233,11 +257,35 @@ static bool pick_surf_format(const struct pl_gpu *gpu, const struct vk_ctx *vk,
             if ((plfmt->caps & render_caps) != render_caps)
                 continue;
 
-            // format valid, use it
-            *out_format = formats[i];
-            talloc_free(formats);
-            return true;
+            // Format valid. Prefer the first one in the list, unless a later
+            // format in the same color space is storable and the first isn't.
+            // Storable swapchain images let the renderer dispatch its final
+            // compute shader directly to the image, instead of having to go
+            // through an extra pass.
+            bool storable = plfmt->caps & PL_FMT_CAP_STORABLE;
+            if (best < 0) {
+                best = i;
+                best_storable = storable;
+            } else if (storable && !best_storable &&
+                       formats[i].colorSpace == formats[best].colorSpace)
+            {
+                best = i;
+                best_storable = true;
+            }
+            break;
         }
+
+        if (best >= 0 && best_storable)
+            break;
+    }
+
+    if (best >= 0) {
+        *out_format = formats[best];
+        vk_map_color_space(out_format->colorSpace, space);
+        PL_DEBUG(gpu, "Picked surface format 0x%x (storable: %d)",
+                 (unsigned int) out_format->format, best_storable);
+        talloc_free(formats);
+        return true;
     }
 
     // fall through
@@ -253,6 +301,11 @@ const struct pl_swapchain *pl_vulkan_create_swapchain(const struct pl_vulkan *pl
     struct vk_ctx *vk = TA_PRIV(plvk);
     const struct pl_gpu *gpu = plvk->gpu;
 
+    if (vk->compute_only) {
+        PL_ERR(vk, "Can't create a swapchain on a compute-only device!");
+        return NULL;
+    }
+
     VkSurfaceFormatKHR sfmt = params->surface_format;
     struct pl_color_space csp;
     if (!pick_surf_format(gpu, vk, params->surface, &sfmt, &csp))
@@ -269,6 +322,11 @@ const struct pl_swapchain *pl_vulkan_create_swapchain(const struct pl_vulkan *pl
     p->surf = params->surface;
     p->swapchain_depth = PL_DEF(params->swapchain_depth, 3);
     pl_assert(p->swapchain_depth > 0);
+    p->cur_depth = p->swapchain_depth;
+    p->window_size = LOW_LATENCY_WINDOW;
+#ifdef VK_GOOGLE_display_timing
+    p->has_timing = vk->vkGetPastPresentationTimingGOOGLE;
+#endif
     p->protoInfo = (VkSwapchainCreateInfoKHR) {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .surface = p->surf,
@@ -297,11 +355,19 @@ const struct pl_swapchain *pl_vulkan_create_swapchain(const struct pl_vulkan *pl
     VK(vkGetPhysicalDeviceSurfacePresentModesKHR(vk->physd, p->surf,
                                                  &num_modes, modes));
 
-    bool supported = false;
-    for (int i = 0; i < num_modes; i++)
+    bool supported = false, mailbox = false;
+    for (int i = 0; i < num_modes; i++) {
         supported |= (modes[i] == p->protoInfo.presentMode);
+        mailbox |= (modes[i] == VK_PRESENT_MODE_MAILBOX_KHR);
+    }
     TA_FREEP(&modes);
 
+    if (params->low_latency && mailbox) {
+        PL_DEBUG(vk, "Using VK_PRESENT_MODE_MAILBOX_KHR for low latency mode");
+        p->protoInfo.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        supported = true;
+    }
+
     if (!supported) {
         PL_WARN(vk, "Requested swap mode unsupported by this device, falling "
                 "back to VK_PRESENT_MODE_FIFO_KHR");
@@ -338,7 +404,7 @@ static void vk_sw_destroy(const struct pl_swapchain *sw)
 static int vk_sw_latency(const struct pl_swapchain *sw)
 {
     struct priv *p = TA_PRIV(sw);
-    return p->swapchain_depth;
+    return p->cur_depth;
 }
 
 static bool update_swapchain_info(struct priv *p, VkSwapchainCreateInfoKHR *info,
@@ -501,6 +567,7 @@ static bool vk_sw_recreate(const struct pl_swapchain *sw, int w, int h)
     VK(vkCreateSwapchainKHR(vk->dev, &sinfo, VK_ALLOC, &p->swapchain));
 
     p->suboptimal = false;
+    p->last_time = 0; // feedback doesn't carry over to the new swapchain
     p->cur_width = sinfo.imageExtent.width;
     p->cur_height = sinfo.imageExtent.height;
 
@@ -594,8 +661,10 @@ static bool vk_sw_start_frame(const struct pl_swapchain *sw,
 
     for (int attempts = 0; attempts < 2; attempts++) {
         uint32_t imgidx = 0;
+        uint64_t start = pl_span_begin(vk->ctx);
         VkResult res = vkAcquireNextImageKHR(vk->dev, p->swapchain, UINT64_MAX,
                                              sem_in, VK_NULL_HANDLE, &imgidx);
+        pl_span_end(vk->ctx, "vkAcquireNextImageKHR", start);
 
         switch (res) {
         case VK_SUBOPTIMAL_KHR:
@@ -610,6 +679,7 @@ static bool vk_sw_start_frame(const struct pl_swapchain *sw,
                 .flipped = false,
                 .color_repr = p->color_repr,
                 .color_space = p->color_space,
+                .id = p->present_id + 1,
             };
             return true;
 
@@ -655,7 +725,9 @@ static bool vk_sw_submit_frame(const struct pl_swapchain *sw)
     if (!cmd)
         return false;
 
+    pthread_mutex_lock(&vk->lock);
     p->frames_in_flight++;
+    pthread_mutex_unlock(&vk->lock);
     vk_cmd_callback(cmd, (vk_cb) present_cb, p, NULL);
 
     vk_cmd_queue(vk, cmd);
@@ -668,6 +740,8 @@ static bool vk_sw_submit_frame(const struct pl_swapchain *sw)
     // same queue as we're rendering from, in a multi-queue scenario. Safest
     // option is to flush the commands first and then submit to the next queue.
     // We can drop this hack in the future, I suppose.
+    // Presentation also needs exclusive access to the queue
+    pthread_mutex_lock(&vk->lock);
     struct vk_cmdpool *pool = vk->pool_graphics;
     VkQueue queue = pool->queues[pool->idx_queues];
 
@@ -680,8 +754,28 @@ static bool vk_sw_submit_frame(const struct pl_swapchain *sw)
         .pImageIndices = &p->last_imgidx,
     };
 
+    p->present_id++;
+#ifdef VK_GOOGLE_display_timing
+    VkPresentTimeGOOGLE ptime = {
+        .presentID = p->present_id,
+        .desiredPresentTime = 0, // as soon as possible
+    };
+
+    VkPresentTimesInfoGOOGLE ptimes = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+        .swapchainCount = 1,
+        .pTimes = &ptime,
+    };
+
+    if (p->has_timing)
+        pinfo.pNext = &ptimes;
+#endif
+
     PL_TRACE(vk, "vkQueuePresentKHR waits on %p", (void *) sem_out);
+    uint64_t start = pl_span_begin(vk->ctx);
     VkResult res = vkQueuePresentKHR(queue, &pinfo);
+    pl_span_end(vk->ctx, "vkQueuePresentKHR", start);
+    pthread_mutex_unlock(&vk->lock);
     switch (res) {
     case VK_SUBOPTIMAL_KHR:
         p->suboptimal = true;
@@ -701,12 +795,64 @@ static bool vk_sw_submit_frame(const struct pl_swapchain *sw)
     }
 }
 
+// Adjusts `cur_depth` based on how long `swap_buffers` had to wait for the
+// GPU, relative to the total frame time
+static void adapt_depth(const struct pl_swapchain *sw, uint64_t waited,
+                        uint64_t now)
+{
+    struct priv *p = TA_PRIV(sw);
+    uint64_t frame = now - p->last_swap;
+    bool first = !p->last_swap;
+    p->last_swap = now;
+    if (first)
+        return;
+
+    // Rendering is falling behind, raise the depth immediately
+    if (waited * 4 > frame && p->cur_depth < p->swapchain_depth) {
+        p->cur_depth++;
+        p->window_size = PL_MIN(p->window_size * 2, LOW_LATENCY_WINDOW_MAX);
+        PL_DEBUG(sw, "Raising swapchain depth to %d", p->cur_depth);
+        goto reset;
+    }
+
+    p->wait_total += waited;
+    p->frame_total += frame;
+    if (++p->window < p->window_size)
+        return;
+
+    // Rendering has been keeping up comfortably, try lowering the depth
+    if (p->wait_total * 20 < p->frame_total && p->cur_depth > 1) {
+        p->cur_depth--;
+        PL_DEBUG(sw, "Lowering swapchain depth to %d", p->cur_depth);
+    }
+
+    // fall through
+reset:
+    p->window = 0;
+    p->wait_total = p->frame_total = 0;
+}
+
 static void vk_sw_swap_buffers(const struct pl_swapchain *sw)
 {
     struct priv *p = TA_PRIV(sw);
+    struct vk_ctx *vk = p->vk;
+    uint64_t span = pl_span_begin(vk->ctx);
+    uint64_t start = p->params.low_latency ? pl_clock_ns() : 0;
+
+    while (true) {
+        pthread_mutex_lock(&vk->lock);
+        bool full = p->frames_in_flight >= p->cur_depth;
+        pthread_mutex_unlock(&vk->lock);
+        if (!full)
+            break;
+        vk_poll_commands(vk, UINT64_MAX);
+    }
 
-    while (p->frames_in_flight >= p->swapchain_depth)
-        vk_poll_commands(p->vk, UINT64_MAX);
+    pl_span_end(vk->ctx, "swap_buffers (wait)", span);
+    if (p->params.low_latency) {
+        uint64_t now = pl_clock_ns();
+        adapt_depth(sw, now - start, now);
+    }
 }
 
 static bool vk_sw_resize(const struct pl_swapchain *sw, int *width, int *height)
@@ -722,6 +868,70 @@ static bool vk_sw_resize(const struct pl_swapchain *sw, int *width, int *height)
     return ok;
 }
 
+static bool vk_sw_timing(const struct pl_swapchain *sw,
+                         struct pl_swapchain_timing *out)
+{
+    struct priv *p = TA_PRIV(sw);
+    struct vk_ctx *vk = p->vk;
+    if (!p->has_timing)
+        return false;
+
+    p->num_timings = 0;
+
+#ifdef VK_GOOGLE_display_timing
+    VkPastPresentationTimingGOOGLE *past = NULL;
+    if (!p->swapchain)
+        goto done;
+
+    VkRefreshCycleDurationGOOGLE refresh;
+    VK(vk->vkGetRefreshCycleDurationGOOGLE(vk->dev, p->swapchain, &refresh));
+    p->timing.refresh_duration = refresh.refreshDuration;
+
+    uint32_t num = 0;
+    VK(vk->vkGetPastPresentationTimingGOOGLE(vk->dev, p->swapchain, &num, NULL));
+    past = talloc_array(NULL, VkPastPresentationTimingGOOGLE, num);
+    VkResult res = vk->vkGetPastPresentationTimingGOOGLE(vk->dev, p->swapchain,
+                                                         &num, past);
+    if (res != VK_INCOMPLETE) // more frames may have arrived in the meantime
+        VK_ASSERT(res, "vkGetPastPresentationTimingGOOGLE");
+
+    TARRAY_GROW(sw, p->timings, num);
+    uint64_t vsync = p->timing.refresh_duration;
+    for (int i = 0; i < num; i++) {
+        uint64_t id = past[i].presentID, time = past[i].actualPresentTime;
+
+        // Only consecutive frames tell us whether a frame was repeated
+        if (vsync && p->last_time && id == p->last_id + 1 && time > p->last_time) {
+            uint64_t vsyncs = (time - p->last_time + vsync / 2) / vsync;
+            if (vsyncs > 1) {
+                PL_TRACE(sw, "Frame %"PRIu64" missed %"PRIu64" vsync(s)",
+                         id, vsyncs - 1);
+                p->timing.missed_vsyncs += vsyncs - 1;
+            }
+        }
+
+        p->last_id = id;
+        p->last_time = time;
+        p->timing.frames_presented++;
+        p->timings[p->num_timings++] = (struct pl_swapchain_frame_timing) {
+            .id = id,
+            .present_time = time,
+            .present_margin = past[i].presentMargin,
+        };
+    }
+
+    // fall through
+error:
+done:
+    talloc_free(past);
+#endif
+
+    *out = p->timing;
+    out->frames = p->timings;
+    out->num_frames = p->num_timings;
+    return true;
+}
+
 bool pl_vulkan_swapchain_suboptimal(const struct pl_vulkan *vk)
 {
     struct priv *p = TA_PRIV(vk);
@@ -735,4 +945,5 @@ static struct pl_sw_fns vulkan_swapchain = {
     .start_frame  = vk_sw_start_frame,
     .submit_frame = vk_sw_submit_frame,
     .swap_buffers = vk_sw_swap_buffers,
+    .timing       = vk_sw_timing,
 };
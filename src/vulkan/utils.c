@@ -137,6 +137,12 @@ vk_mem_handle_type(enum pl_handle_type handle_type)
         return VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_KMT_BIT_KHR;
     case PL_HANDLE_DMA_BUF:
         return VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+    case PL_HANDLE_HOST_PTR:
+#ifdef VK_EXT_external_memory_host
+        return VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+#else
+        break;
+#endif
     }
 
     abort();
@@ -155,7 +161,8 @@ vk_sync_handle_type(enum pl_handle_type handle_type)
         return VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_BIT_KHR;
     case PL_HANDLE_WIN32_KMT:
         return VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_KMT_BIT_KHR;
-    case PL_HANDLE_DMA_BUF: abort();
+    case PL_HANDLE_DMA_BUF:
+    case PL_HANDLE_HOST_PTR: abort();
     }
 
     abort();
@@ -194,6 +201,9 @@ const enum pl_handle_type vk_mem_handle_list[] = {
 #ifdef VK_HAVE_WIN32
         PL_HANDLE_WIN32,
         PL_HANDLE_WIN32_KMT,
+#endif
+#ifdef VK_EXT_external_memory_host
+        PL_HANDLE_HOST_PTR,
 #endif
         0
 };
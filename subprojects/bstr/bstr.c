@@ -295,6 +295,11 @@ void bstr_xappend(void *talloc_ctx, bstr *s, bstr append)
     s->start[s->len] = '\0';
 }
 
+void bstr_xreserve(void *talloc_ctx, bstr *s, size_t len)
+{
+    resize_append(talloc_ctx, s, len + 1);
+}
+
 void bstr_xappend_asprintf(void *talloc_ctx, bstr *s, const char *fmt, ...)
 {
     va_list ap;
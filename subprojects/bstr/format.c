@@ -41,44 +41,83 @@ void bstr_xappend_asprintf_c(void *tactx, bstr *s, const char *fmt, ...)
     va_end(ap);
 }
 
+// Room reserved for the result of a single numeric conversion, including the
+// \0 written by the ccStrPrint* functions
+#define NUM_BUFSIZE 32
+
+// Makes sure `len` more bytes (plus the terminating \0) fit into `s`. `cap`
+// caches the allocated size of `s->start`, so it doesn't have to be looked up
+// again for every fragment of the format string.
+static inline void reserve(void *tactx, bstr *s, size_t *cap, size_t len)
+{
+    if (len >= *cap - s->len) {
+        bstr_xreserve(tactx, s, len);
+        *cap = talloc_get_size(s->start);
+    }
+}
+
+static inline void append(void *tactx, bstr *s, size_t *cap,
+                          const char *str, size_t len)
+{
+    reserve(tactx, s, cap, len);
+    memcpy(s->start + s->len, str, len);
+    s->len += len;
+}
+
 void bstr_xappend_vasprintf_c(void *tactx, bstr *s, const char *fmt,
                               va_list ap)
 {
-    for (const char *c; (c = strchr(fmt, '%')) != NULL; fmt = c + 1) {
+    size_t fmt_len = strlen(fmt);
+    const char *end = fmt + fmt_len;
+    const char *c = memchr(fmt, '%', fmt_len);
+    if (!c) {
+        // Fast path for literal-only strings, which are the vast majority
+        bstr_xappend(tactx, s, (struct bstr) { (unsigned char *) fmt, fmt_len });
+        return;
+    }
+
+    // Preallocate enough room for the literal parts plus one conversion, so
+    // the common case doesn't have to grow the string more than once
+    size_t cap = talloc_get_size(s->start);
+    reserve(tactx, s, &cap, fmt_len + NUM_BUFSIZE);
+
+    for (; c; fmt = c + 1, c = memchr(fmt, '%', end - fmt)) {
         // Append the preceding string literal
-        bstr_xappend(tactx, s, (struct bstr) { (char *) fmt, c - fmt });
+        append(tactx, s, &cap, fmt, c - fmt);
         c++; // skip '%'
 
-        char buf[32];
-        int len;
-
-        // The format character follows the % sign
+        // The format character follows the % sign. Numbers are printed
+        // directly into the string, after making room for them.
+        char *dst;
         switch (c[0]) {
         case '%':
-            bstr_xappend(tactx, s, bstr0("%"));
+            append(tactx, s, &cap, "%", 1);
             continue;
         case 'c':
-            buf[0] = (char) va_arg(ap, int);
-            bstr_xappend(tactx, s, (struct bstr) { buf, 1 });
+            reserve(tactx, s, &cap, 1);
+            s->start[s->len++] = (char) va_arg(ap, int);
             continue;
         case 's': {
             const char *arg = va_arg(ap, const char *);
-            bstr_xappend(tactx, s, bstr0(arg));
+            append(tactx, s, &cap, arg, strlen(arg));
             continue;
         }
         case 'd':
-            len = ccStrPrintInt32(buf, va_arg(ap, int));
-            bstr_xappend(tactx, s, (struct bstr) { buf, len });
+            reserve(tactx, s, &cap, NUM_BUFSIZE);
+            dst = (char *) s->start + s->len;
+            s->len += ccStrPrintInt32(dst, va_arg(ap, int));
             continue;
         case 'z':
             assert(c[1] == 'u');
-            len = ccStrPrintUint64(buf, va_arg(ap, size_t));
-            bstr_xappend(tactx, s, (struct bstr) { buf, len });
+            reserve(tactx, s, &cap, NUM_BUFSIZE);
+            dst = (char *) s->start + s->len;
+            s->len += ccStrPrintUint64(dst, va_arg(ap, size_t));
             c++;
             continue;
         case 'f':
-            len = ccStrPrintDouble(buf, sizeof(buf), 6, va_arg(ap, double));
-            bstr_xappend(tactx, s, (struct bstr) { buf, len });
+            reserve(tactx, s, &cap, NUM_BUFSIZE);
+            dst = (char *) s->start + s->len;
+            s->len += ccStrPrintDouble(dst, NUM_BUFSIZE, 6, va_arg(ap, double));
             continue;
         default:
             fprintf(stderr, "Invalid conversion character: '%c'!\n", c[0]);
@@ -87,7 +126,8 @@ void bstr_xappend_vasprintf_c(void *tactx, bstr *s, const char *fmt,
     }
 
     // Append the remaining string literal
-    bstr_xappend(tactx, s, bstr0(fmt));
+    append(tactx, s, &cap, fmt, end - fmt);
+    s->start[s->len] = '\0';
 }
 
 /* *****************************************************************************
@@ -100,6 +100,10 @@ static inline struct bstr bstr_getline(struct bstr str, struct bstr *rest)
 struct bstr bstr_strip_linebreaks(struct bstr str);
 
 void bstr_xappend(void *talloc_ctx, bstr *s, bstr append);
+
+// Make sure at least `len` more bytes (plus the implicit \0) can be appended
+// to s without reallocating.
+void bstr_xreserve(void *talloc_ctx, bstr *s, size_t len);
 void bstr_xappend_asprintf(void *talloc_ctx, bstr *s, const char *fmt, ...)
     PRINTF_ATTRIBUTE(3, 4);
 void bstr_xappend_vasprintf(void *talloc_ctx, bstr *s, const char *fmt, va_list va)
@@ -39,6 +39,9 @@
 #define talloc_steal                    xta_xsteal
 #define talloc_realloc_size             xta_xrealloc_size
 #define talloc_new                      xta_xnew_context
+#define talloc_new_arena                xta_xnew_arena
+#define talloc_arena_reset              xta_arena_reset
+#define talloc_arena_alloc              xta_xarena_alloc
 #define talloc_set_destructor           xta_xset_destructor
 #define talloc_parent                   xta_find_parent
 #define talloc_enable_leak_report       xta_enable_leak_report
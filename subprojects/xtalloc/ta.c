@@ -30,7 +30,7 @@
 #endif
 
 struct xta_header {
-    size_t size;                // size of the user allocation
+    size_t size;                // size of the user allocation (| ARENA_FLAG)
     struct xta_header *prev;    // ring list containing siblings
     struct xta_header *next;
     struct xta_ext_header *ext;
@@ -58,18 +58,137 @@ union aligned_header {
 #define PTR_TO_HEADER(ptr) (&((union aligned_header *)(ptr) - 1)->ta)
 #define PTR_FROM_HEADER(h) ((void *)((union aligned_header *)(h) + 1))
 
-#define MAX_ALLOC (((size_t)-1) - sizeof(union aligned_header))
+// Set in xta_header.size for allocations carved out of an arena (see
+// xta_new_arena). These are preceded by a pointer to the arena they belong to.
+#define ARENA_FLAG ((size_t)1 << (sizeof(size_t) * 8 - 1))
+
+union arena_prefix {
+    struct xta_arena *arena;
+    char align_min[MIN_ALIGN];
+};
+
+#define HEADER_ARENA(h) (((union arena_prefix *)(h) - 1)->arena)
+
+#define MAX_ALLOC ((ARENA_FLAG - 1) - sizeof(union aligned_header) - \
+                   sizeof(union arena_prefix))
 
 // Needed for non-leaf allocations, or extended features such as destructors.
 struct xta_ext_header {
     struct xta_header *header;  // points back to normal header
     struct xta_header children; // list of children, with this as sentinel
     void (*destructor)(void *);
+    struct xta_arena *arena;    // arena new children are allocated from
 };
 
 // xta_ext_header.children.size is set to this
 #define CHILDREN_SENTINEL ((size_t)-1)
 
+// A block of memory owned by an arena, followed by the actual data
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+};
+
+union aligned_block {
+    struct arena_block b;
+    char align_min[(sizeof(struct arena_block) + MIN_ALIGN - 1) & ~(MIN_ALIGN - 1)];
+};
+
+// Default size of the blocks allocated by an arena
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// The user data of an arena context
+struct xta_arena {
+    struct arena_block *blocks; // the first block is the one being filled
+    char *pos, *end;            // remaining space in the current block
+    size_t total;               // total size of all blocks
+};
+
+#define ALIGN_UP(x) (((x) + MIN_ALIGN - 1) & ~(size_t)(MIN_ALIGN - 1))
+
+static bool in_arena(const struct xta_header *h)
+{
+    return h->size != CHILDREN_SENTINEL && (h->size & ARENA_FLAG);
+}
+
+static size_t header_size(const struct xta_header *h)
+{
+    return h->size & ~ARENA_FLAG;
+}
+
+// Returns size bytes (aligned to MIN_ALIGN) of memory from the arena
+static void *arena_alloc(struct xta_arena *a, size_t size)
+{
+    size = ALIGN_UP(size);
+    if (size <= (size_t)(a->end - a->pos)) {
+        void *ptr = a->pos;
+        a->pos += size;
+        return ptr;
+    }
+
+    // Allocations which would waste a good part of a fresh block get a block
+    // of their own, behind the current one, so the latter can still be used
+    bool own = size > ARENA_BLOCK_SIZE / 4;
+    size_t bsize = own ? size : ARENA_BLOCK_SIZE;
+    struct arena_block *b = malloc(sizeof(union aligned_block) + bsize);
+    if (!b)
+        return NULL;
+    b->size = bsize;
+    a->total += bsize;
+    char *data = (char *)((union aligned_block *) b + 1);
+    if (own && a->blocks) {
+        b->next = a->blocks->next;
+        a->blocks->next = b;
+        return data;
+    }
+
+    b->next = a->blocks;
+    a->blocks = b;
+    a->pos = data + size;
+    a->end = data + bsize;
+    return data;
+}
+
+static void arena_free_blocks(struct xta_arena *a)
+{
+    while (a->blocks) {
+        struct arena_block *next = a->blocks->next;
+        free(a->blocks);
+        a->blocks = next;
+    }
+    *a = (struct xta_arena) {0};
+}
+
+// Allocates a new header with size bytes of user data, either from the
+// arena (if not NULL) or from the heap
+static struct xta_header *alloc_header(struct xta_arena *arena, size_t size,
+                                       bool zero)
+{
+    if (size >= MAX_ALLOC)
+        return NULL;
+
+    struct xta_header *h;
+    if (arena) {
+        union arena_prefix *pre = arena_alloc(arena, sizeof(union arena_prefix) +
+                                              sizeof(union aligned_header) + size);
+        if (!pre)
+            return NULL;
+        pre->arena = arena;
+        h = (struct xta_header *)(pre + 1);
+        if (zero)
+            memset(PTR_FROM_HEADER(h), 0, size);
+    } else if (zero) {
+        h = calloc(1, sizeof(union aligned_header) + size);
+    } else {
+        h = malloc(sizeof(union aligned_header) + size);
+    }
+
+    if (!h)
+        return NULL;
+    *h = (struct xta_header) {.size = arena ? size | ARENA_FLAG : size};
+    return h;
+}
+
 static void xta_dbg_add(struct xta_header *h);
 static void xta_dbg_check_header(struct xta_header *h);
 static void xta_dbg_remove(struct xta_header *h);
@@ -87,7 +206,13 @@ static struct xta_ext_header *get_or_alloc_ext_header(void *ptr)
     if (!h)
         return NULL;
     if (!h->ext) {
-        h->ext = malloc(sizeof(struct xta_ext_header));
+        // Children of arena allocations are allocated from the same arena
+        struct xta_arena *arena = in_arena(h) ? HEADER_ARENA(h) : NULL;
+        if (arena) {
+            h->ext = arena_alloc(arena, sizeof(struct xta_ext_header));
+        } else {
+            h->ext = malloc(sizeof(struct xta_ext_header));
+        }
         if (!h->ext)
             return NULL;
         *h->ext = (struct xta_ext_header) {
@@ -99,11 +224,23 @@ static struct xta_ext_header *get_or_alloc_ext_header(void *ptr)
                 .size = CHILDREN_SENTINEL,
                 .ext = h->ext,
             },
+            .arena = arena,
         };
     }
     return h->ext;
 }
 
+// Returns the arena that children of ptr should be allocated from, if any
+static struct xta_arena *get_arena(void *ptr)
+{
+    struct xta_header *h = get_header(ptr);
+    if (!h)
+        return NULL;
+    if (h->ext)
+        return h->ext->arena;
+    return in_arena(h) ? HEADER_ARENA(h) : NULL;
+}
+
 /* Set the parent allocation of ptr. If parent==NULL, remove the parent.
  * Setting parent==NULL (with ptr!=NULL) always succeeds, and unsets the
  * parent of ptr. Operations ptr==NULL always succeed and do nothing.
@@ -112,12 +249,16 @@ static struct xta_ext_header *get_or_alloc_ext_header(void *ptr)
  * Warning: if xta_parent is a direct or indirect child of ptr, things will go
  *          wrong. The function will apparently succeed, but creates circular
  *          parent links, which are not allowed.
+ *
+ * Allocations made from an arena can only be moved to other parents within
+ * the same arena, since their memory is released together with the arena.
  */
 bool xta_set_parent(void *ptr, void *xta_parent)
 {
     struct xta_header *ch = get_header(ptr);
     if (!ch)
         return true;
+    assert(!in_arena(ch) || get_arena(xta_parent) == HEADER_ARENA(ch));
     struct xta_ext_header *parent_eh = get_or_alloc_ext_header(xta_parent);
     if (xta_parent && !parent_eh) // do nothing on OOM
         return false;
@@ -141,16 +282,15 @@ bool xta_set_parent(void *ptr, void *xta_parent)
 /* Allocate size bytes of memory. If xta_parent is not NULL, this is used as
  * parent allocation (if xta_parent is freed, this allocation is automatically
  * freed as well). size==0 allocates a block of size 0 (i.e. returns non-NULL).
+ * If xta_parent is (directly or indirectly) allocated from an arena, the
+ * memory is taken from the same arena.
  * Returns NULL on OOM.
  */
 void *xta_alloc_size(void *xta_parent, size_t size)
 {
-    if (size >= MAX_ALLOC)
-        return NULL;
-    struct xta_header *h = malloc(sizeof(union aligned_header) + size);
+    struct xta_header *h = alloc_header(get_arena(xta_parent), size, false);
     if (!h)
         return NULL;
-    *h = (struct xta_header) {.size = size};
     xta_dbg_add(h);
     void *ptr = PTR_FROM_HEADER(h);
     if (!xta_set_parent(ptr, xta_parent)) {
@@ -165,12 +305,9 @@ void *xta_alloc_size(void *xta_parent, size_t size)
  */
 void *xta_zalloc_size(void *xta_parent, size_t size)
 {
-    if (size >= MAX_ALLOC)
-        return NULL;
-    struct xta_header *h = calloc(1, sizeof(union aligned_header) + size);
+    struct xta_header *h = alloc_header(get_arena(xta_parent), size, true);
     if (!h)
         return NULL;
-    *h = (struct xta_header) {.size = size};
     xta_dbg_add(h);
     void *ptr = PTR_FROM_HEADER(h);
     if (!xta_set_parent(ptr, xta_parent)) {
@@ -204,14 +341,40 @@ void *xta_realloc_size(void *xta_parent, void *ptr, size_t size)
         return xta_alloc_size(xta_parent, size);
     struct xta_header *h = get_header(ptr);
     struct xta_header *old_h = h;
-    if (h->size == size)
+    size_t old_size = header_size(h);
+    if (old_size == size)
         return ptr;
-    xta_dbg_remove(h);
-    h = realloc(h, sizeof(union aligned_header) + size);
-    xta_dbg_add(h ? h : old_h);
-    if (!h)
-        return NULL;
-    h->size = size;
+    if (in_arena(h)) {
+        // Resize in place if this is the most recent allocation (or if
+        // shrinking), otherwise move to a new chunk. The old one is simply
+        // abandoned until the arena is reset.
+        struct xta_arena *arena = HEADER_ARENA(h);
+        char *data = PTR_FROM_HEADER(h);
+        if (data + ALIGN_UP(old_size) == arena->pos &&
+            ALIGN_UP(size) <= (size_t)(arena->end - data))
+        {
+            arena->pos = data + ALIGN_UP(size);
+            h->size = size | ARENA_FLAG;
+            return ptr;
+        }
+        if (size < old_size) {
+            h->size = size | ARENA_FLAG;
+            return ptr;
+        }
+        h = alloc_header(arena, size, false);
+        if (!h)
+            return NULL;
+        xta_dbg_remove(old_h);
+        memcpy(h, old_h, sizeof(union aligned_header) + old_size);
+        xta_dbg_add(h);
+    } else {
+        xta_dbg_remove(h);
+        h = realloc(h, sizeof(union aligned_header) + size);
+        xta_dbg_add(h ? h : old_h);
+        if (!h)
+            return NULL;
+    }
+    h->size = in_arena(h) ? size | ARENA_FLAG : size;
     if (h != old_h) {
         if (h->next) {
             // Relink siblings
@@ -235,7 +398,7 @@ void *xta_realloc_size(void *xta_parent, void *ptr, size_t size)
 size_t xta_get_size(void *ptr)
 {
     struct xta_header *h = get_header(ptr);
-    return h ? h->size : 0;
+    return h ? header_size(h) : 0;
 }
 
 /* Free all allocations that (recursively) have ptr as parent allocation, but
@@ -264,16 +427,97 @@ void xta_free(void *ptr)
     if (h->ext && h->ext->destructor)
         h->ext->destructor(ptr);
     xta_free_children(ptr);
+    if (h->ext && h->ext->arena == ptr)
+        arena_free_blocks(ptr); // ptr is the arena itself
     if (h->next) {
         // Unlink from sibling list
         h->next->prev = h->prev;
         h->prev->next = h->next;
     }
     xta_dbg_remove(h);
+    if (in_arena(h))
+        return; // memory is released together with the arena
     free(h->ext);
     free(h);
 }
 
+/* Create an arena context. This works like a plain context (see
+ * xta_new_context), except that all of its direct and indirect children are
+ * bump-allocated from large blocks owned by the arena, instead of each
+ * being a separate heap allocation. Freeing (or shrinking) a child does not
+ * make its memory available again; this only happens once the arena is
+ * reset with xta_arena_reset, or freed. This makes arenas well suited as the
+ * parent for many short-lived allocations, such as per-frame temporaries.
+ *
+ * Arena children must not be moved outside of the arena (see
+ * xta_set_parent). Arenas are not thread-safe.
+ *
+ * Returns NULL on OOM.
+ */
+void *xta_new_arena(void *xta_parent)
+{
+    // The arena itself is always allocated from the heap, even within
+    // another arena, since it may be freed individually
+    struct xta_header *h = alloc_header(NULL, sizeof(struct xta_arena), true);
+    if (!h)
+        return NULL;
+    xta_dbg_add(h);
+    void *ptr = PTR_FROM_HEADER(h);
+    struct xta_ext_header *eh = get_or_alloc_ext_header(ptr);
+    if (!eh || !xta_set_parent(ptr, xta_parent)) {
+        xta_free(ptr);
+        return NULL;
+    }
+    eh->arena = ptr;
+    return ptr;
+}
+
+/* Free all children of the arena, and make all of the memory available for
+ * re-use. If the arena had to allocate more than one block since the last
+ * reset, they are merged into a single block large enough to hold all of
+ * them, so that a similar set of allocations afterwards needs no further
+ * heap allocations at all.
+ */
+void xta_arena_reset(void *ptr)
+{
+    struct xta_header *h = get_header(ptr);
+    if (!h)
+        return;
+    assert(h->ext && h->ext->arena == ptr);
+    xta_free_children(ptr);
+
+    struct xta_arena *a = ptr;
+    if (a->blocks && a->blocks->next) {
+        size_t total = a->total;
+        arena_free_blocks(a);
+        struct arena_block *b = malloc(sizeof(union aligned_block) + total);
+        if (!b)
+            return; // not fatal, blocks are allocated on demand
+        *b = (struct arena_block) {.size = total};
+        a->blocks = b;
+        a->total = total;
+    }
+
+    if (a->blocks) {
+        a->pos = (char *)((union aligned_block *) a->blocks + 1);
+        a->end = a->pos + a->blocks->size;
+    }
+}
+
+/* Allocate size bytes of raw memory from the arena given by ptr. Unlike
+ * xta_alloc_size, this has no TA header at all, so the result can't be freed,
+ * resized, or used as a parent. It remains valid until the arena is reset or
+ * freed. This is the cheapest way to allocate many small objects.
+ * Returns NULL on OOM.
+ */
+void *xta_arena_alloc(void *ptr, size_t size)
+{
+    assert(ptr && get_arena(ptr) == ptr);
+    if (size >= MAX_ALLOC)
+        return NULL;
+    return arena_alloc(ptr, size);
+}
+
 /* Set a destructor that is to be called when the given allocation is freed.
  * (Whether the allocation is directly freed with xta_free() or indirectly by
  * freeing its parent does not matter.) There is only one destructor. If an
@@ -358,7 +602,7 @@ static size_t get_children_size(struct xta_header *h)
     if (h->ext) {
         struct xta_header *s;
         for (s = h->ext->children.next; s != &h->ext->children; s = s->next)
-            size += s->size + get_children_size(s);
+            size += header_size(s) + get_children_size(s);
     }
     return size;
 }
@@ -385,16 +629,16 @@ void xta_print_leak_report(void)
                     snprintf(name, sizeof(name), "%s", cur->name);
                 if (cur->name == &allocation_is_string) {
                     snprintf(name, sizeof(name), "'%.*s'",
-                             (int)cur->size, (char *)PTR_FROM_HEADER(cur));
+                             (int)header_size(cur), (char *)PTR_FROM_HEADER(cur));
                 }
                 for (int n = 0; n < sizeof(name); n++) {
                     if (name[n] && name[n] < 0x20)
                         name[n] = '.';
                 }
                 fprintf(stderr, "  %-20p %10zu %10zu  %s\n",
-                        cur, cur->size, c_size, name);
+                        cur, header_size(cur), c_size, name);
             }
-            size += cur->size;
+            size += header_size(cur);
             num_blocks += 1;
             // Unlink, and don't confuse valgrind by leaving live pointers.
             assert(cur->leak_next && cur->leak_prev);
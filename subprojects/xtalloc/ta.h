@@ -53,6 +53,9 @@ void xta_free_children(void *ptr);
 bool xta_set_destructor(void *ptr, void (*destructor)(void *));
 bool xta_set_parent(void *ptr, void *xta_parent);
 void *xta_find_parent(void *ptr);
+void *xta_new_arena(void *xta_parent);
+void xta_arena_reset(void *ptr);
+void *xta_arena_alloc(void *ptr, size_t size);
 
 // Utility functions
 size_t xta_calc_array_size(size_t element_size, size_t count);
@@ -109,6 +112,8 @@ bool xta_vasprintf_append_buffer(char **str, const char *fmt, va_list ap) TA_PRF
 #define xta_xset_destructor(...)         xta_oom_b(xta_set_destructor(__VA_ARGS__))
 #define xta_xset_parent(...)             xta_oom_b(xta_set_parent(__VA_ARGS__))
 #define xta_xnew_context(...)            xta_oom_p(xta_new_context(__VA_ARGS__))
+#define xta_xnew_arena(...)              xta_oom_p(xta_new_arena(__VA_ARGS__))
+#define xta_xarena_alloc(...)            xta_oom_p(xta_arena_alloc(__VA_ARGS__))
 #define xta_xstrdup_append(...)          xta_oom_b(xta_strdup_append(__VA_ARGS__))
 #define xta_xstrdup_append_buffer(...)   xta_oom_b(xta_strdup_append_buffer(__VA_ARGS__))
 #define xta_xstrndup_append(...)         xta_oom_b(xta_strndup_append(__VA_ARGS__))